@@ -0,0 +1,31 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef AMQP_STATISTICS_H
+#define AMQP_STATISTICS_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif /* __cplusplus */
+
+/* Counters kept by connection, session and link for connection_get_statistics, session_get_statistics and link_get_statistics.
+   Building with UAMQP_NO_STATISTICS removes the counters from the instances and the increments from the code,
+   the getters then fail. */
+
+/* performative counters are indexed by descriptor code - AMQP_OPEN, in the order OPEN, BEGIN, ATTACH, FLOW, TRANSFER, DISPOSITION, DETACH, END, CLOSE */
+#define AMQP_PERFORMATIVE_COUNT 9
+
+#ifdef UAMQP_NO_STATISTICS
+#define AMQP_STATISTICS_ADD(counter, value)
+#define AMQP_STATISTICS_SUBTRACT(counter, value)
+#else
+#define AMQP_STATISTICS_ADD(counter, value) ((counter) += (value))
+#define AMQP_STATISTICS_SUBTRACT(counter, value) ((counter) -= (value))
+#endif /* UAMQP_NO_STATISTICS */
+
+#define AMQP_STATISTICS_INCREMENT(counter) AMQP_STATISTICS_ADD(counter, 1)
+#define AMQP_STATISTICS_DECREMENT(counter) AMQP_STATISTICS_SUBTRACT(counter, 1)
+
+#endif /* AMQP_STATISTICS_H */
@@ -2,16 +2,25 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #ifndef AMQPVALUE_TO_STRING_H
+#define AMQPVALUE_TO_STRING_H
 
 #include "azure_uamqp_c/amqpvalue.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
 
+/* size of the stack buffers traced values are formatted into, cut there so that tracing a large frame does not stall the I/O thread */
+#define TRACE_STRING_BUFFER_SIZE 1024
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
 	MOCKABLE_FUNCTION(, char*, amqpvalue_to_string, AMQP_VALUE, amqp_value);
 
+	/* Both stop formatting once the output reaches max_length characters (buffer_size - 1 for the buffer variant),
+	   in which case it ends with "...". The buffer variant does not allocate, which makes it suitable for tracing frames. */
+	MOCKABLE_FUNCTION(, char*, amqpvalue_to_string_bounded, AMQP_VALUE, amqp_value, size_t, max_length);
+	MOCKABLE_FUNCTION(, int, amqpvalue_to_string_buffer, AMQP_VALUE, amqp_value, char*, buffer, size_t, buffer_size);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
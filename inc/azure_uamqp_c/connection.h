@@ -9,6 +9,8 @@
 #include <stdint.h>
 #include "azure_uamqp_c/amqp_frame_codec.h"
 #include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/amqp_statistics.h"
+#include "azure_uamqp_c/timer_wheel.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,6 +69,18 @@ extern "C" {
         CONNECTION_STATE_ERROR
     } CONNECTION_STATE;
 
+    typedef struct CONNECTION_STATISTICS_TAG
+    {
+        uint64_t frames_received;
+        uint64_t frames_sent;
+        uint64_t empty_frames_received;
+        uint64_t empty_frames_sent;
+        uint64_t bytes_received;
+        uint64_t bytes_sent;
+        uint64_t performatives_received[AMQP_PERFORMATIVE_COUNT];
+        uint64_t performatives_sent[AMQP_PERFORMATIVE_COUNT];
+    } CONNECTION_STATISTICS;
+
     typedef void(*ON_ENDPOINT_FRAME_RECEIVED)(void* context, AMQP_VALUE performative, uint32_t frame_payload_size, const unsigned char* payload_bytes);
     typedef void(*ON_CONNECTION_STATE_CHANGED)(void* context, CONNECTION_STATE new_connection_state, CONNECTION_STATE previous_connection_state);
     typedef bool(*ON_NEW_ENDPOINT)(void* context, ENDPOINT_HANDLE new_endpoint);
@@ -91,6 +105,18 @@ extern "C" {
     MOCKABLE_FUNCTION(, int, connection_endpoint_get_incoming_channel, ENDPOINT_HANDLE, endpoint, uint16_t*, incoming_channel);
     MOCKABLE_FUNCTION(, void, connection_destroy_endpoint, ENDPOINT_HANDLE, endpoint);
     MOCKABLE_FUNCTION(, int, connection_encode_frame, ENDPOINT_HANDLE, endpoint, const AMQP_VALUE, performative, PAYLOAD*, payloads, size_t, payload_count, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
+
+    /* Send coalescing copies the encoded frames into a buffer of max_coalesced_bytes and hands them to the io in one
+       xio_send; 0 bytes turns it off. The buffer is sent when it is full, before a frame that does not fit and:
+       - with a max_coalescing_delay of 0, at the end of connection_dowork for the frames encoded during it, and right away
+         for frames encoded outside of it once connection_handle_deadlines is called;
+       - otherwise max_coalescing_delay ms after its first byte, reported as a deadline by connection_handle_deadlines.
+       On a timer wheel (connection_set_timer_wheel), frames encoded outside connection_dowork, e.g. from another
+       connection of the same reactor, are flushed by a timer firing max_coalescing_delay ms later. */
+    MOCKABLE_FUNCTION(, int, connection_set_send_coalescing, CONNECTION_HANDLE, connection, uint32_t, max_coalesced_bytes, milliseconds, max_coalescing_delay);
+    MOCKABLE_FUNCTION(, int, connection_set_timer_wheel, CONNECTION_HANDLE, connection, TIMER_WHEEL_HANDLE, timer_wheel);
+    MOCKABLE_FUNCTION(, int, connection_set_frame_capture, CONNECTION_HANDLE, connection, FRAME_CAPTURE_HANDLE, frame_capture);
+    MOCKABLE_FUNCTION(, int, connection_get_statistics, CONNECTION_HANDLE, connection, CONNECTION_STATISTICS*, statistics);
     MOCKABLE_FUNCTION(, void, connection_set_trace, CONNECTION_HANDLE, connection, bool, trace_on);
 
 #ifdef __cplusplus
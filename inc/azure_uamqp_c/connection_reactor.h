@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef CONNECTION_REACTOR_H
+#define CONNECTION_REACTOR_H
+
+#include <stdint.h>
+#include "azure_uamqp_c/connection.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Drives many connections from one thread without polling idle ones.
+	   A connection is given dowork only when the socket behind its xio is readable/writable
+	   or when the deadline reported by connection_handle_deadlines expires.
+	   Connections added with fd -1 (socket not known) are polled every few milliseconds.
+	   All deadlines, including the idle/heartbeat timers of the connections, live in one timer wheel;
+	   connections still in the reactor when it is destroyed go back to their own deadline handling.
+	   connection_reactor_wake is the only function that can be called from another thread,
+	   it makes a blocked connection_reactor_dowork return. */
+	typedef struct CONNECTION_REACTOR_INSTANCE_TAG* CONNECTION_REACTOR_HANDLE;
+
+	MOCKABLE_FUNCTION(, CONNECTION_REACTOR_HANDLE, connection_reactor_create);
+	MOCKABLE_FUNCTION(, void, connection_reactor_destroy, CONNECTION_REACTOR_HANDLE, reactor);
+	MOCKABLE_FUNCTION(, int, connection_reactor_add_connection, CONNECTION_REACTOR_HANDLE, reactor, CONNECTION_HANDLE, connection, int, fd);
+	MOCKABLE_FUNCTION(, int, connection_reactor_remove_connection, CONNECTION_REACTOR_HANDLE, reactor, CONNECTION_HANDLE, connection);
+	MOCKABLE_FUNCTION(, int, connection_reactor_dowork, CONNECTION_REACTOR_HANDLE, reactor, uint32_t, max_wait_ms);
+	MOCKABLE_FUNCTION(, int, connection_reactor_wake, CONNECTION_REACTOR_HANDLE, reactor);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CONNECTION_REACTOR_H */
@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#include <cstdint>
+#include <cstddef>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Binary capture of raw frames, cheap enough to leave on where tracing is not.
+	   A capture either appends to a file or keeps the most recent frames in a fixed size ring that
+	   frame_capture_save writes out. Both produce the same format: an 8 byte "UAMQPCAP" magic and a 4 byte
+	   version, then one record per frame holding a 16 byte big endian header (ms since the capture was created, direction,
+	   frame type, channel, frame size) followed by the frame bytes, frame header included.
+	   A capture is not thread-safe, all frame codecs writing to it must run on the same thread. */
+	typedef struct FRAME_CAPTURE_INSTANCE_TAG* FRAME_CAPTURE_HANDLE;
+
+	typedef enum FRAME_CAPTURE_DIRECTION_TAG
+	{
+		FRAME_CAPTURE_DIRECTION_INBOUND,
+		FRAME_CAPTURE_DIRECTION_OUTBOUND
+	} FRAME_CAPTURE_DIRECTION;
+
+	typedef struct FRAME_CAPTURE_RECORD_TAG
+	{
+		uint64_t timestamp_ms;
+		FRAME_CAPTURE_DIRECTION direction;
+		uint8_t frame_type;
+		uint16_t channel;
+		const unsigned char* frame_bytes;
+		uint32_t frame_size;
+	} FRAME_CAPTURE_RECORD;
+
+	/* returning non-zero stops frame_capture_read_file */
+	typedef int(*ON_FRAME_CAPTURE_RECORD)(void* context, const FRAME_CAPTURE_RECORD* record);
+
+	MOCKABLE_FUNCTION(, FRAME_CAPTURE_HANDLE, frame_capture_create_file, const char*, file_name);
+	MOCKABLE_FUNCTION(, FRAME_CAPTURE_HANDLE, frame_capture_create_ring, size_t, capacity);
+	MOCKABLE_FUNCTION(, void, frame_capture_destroy, FRAME_CAPTURE_HANDLE, frame_capture);
+	/* frame_prefix holds the first 6 frame bytes (size, doff, type), frame_bytes the remaining frame_size - 6 */
+	MOCKABLE_FUNCTION(, int, frame_capture_add_frame, FRAME_CAPTURE_HANDLE, frame_capture, FRAME_CAPTURE_DIRECTION, direction, const unsigned char*, frame_prefix, const unsigned char*, frame_bytes, uint32_t, frame_size);
+	MOCKABLE_FUNCTION(, int, frame_capture_save, FRAME_CAPTURE_HANDLE, frame_capture, const char*, file_name);
+	MOCKABLE_FUNCTION(, int, frame_capture_read_file, const char*, file_name, ON_FRAME_CAPTURE_RECORD, on_frame_capture_record, void*, context);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FRAME_CAPTURE_H */
@@ -40,8 +40,28 @@ typedef enum LINK_DELIVERY_SETTLE_REASON_TAG
     LINK_DELIVERY_SETTLE_REASON_NOT_DELIVERED
 } LINK_DELIVERY_SETTLE_REASON;
 
+typedef struct LINK_STATISTICS_TAG
+{
+    uint64_t transfers_sent;
+    /* a delivery received in several frames counts once for each of them */
+    uint64_t transfer_frames_received;
+    /* link_transfer calls that returned LINK_TRANSFER_BUSY */
+    uint64_t transfer_busy_count;
+    uint32_t link_credit;
+    sequence_no delivery_count;
+    /* sent deliveries waiting for a disposition or for their send to complete */
+    uint32_t pending_delivery_count;
+    /* disposition frames sent, each one settling a range of deliveries when batching */
+    uint64_t dispositions_sent;
+    /* flow frames sent, each one granting credit when receiving */
+    uint64_t flows_sent;
+} LINK_STATISTICS;
+
 typedef void(*ON_DELIVERY_SETTLED)(void* context, delivery_number delivery_no, LINK_DELIVERY_SETTLE_REASON reason, AMQP_VALUE delivery_state);
 typedef AMQP_VALUE(*ON_TRANSFER_RECEIVED)(void* context, TRANSFER_HANDLE transfer, uint32_t payload_size, const unsigned char* payload_bytes);
+/* payload_bytes is one transfer frame of a delivery, more is false for its last one; the delivery state is only used when
+   returned for the last one. A delivery aborted by the sender ends with an aborted transfer and no payload. */
+typedef AMQP_VALUE(*ON_TRANSFER_CHUNK_RECEIVED)(void* context, TRANSFER_HANDLE transfer, uint32_t payload_size, const unsigned char* payload_bytes, bool more);
 typedef void(*ON_LINK_STATE_CHANGED)(void* context, LINK_STATE new_link_state, LINK_STATE previous_link_state);
 typedef void(*ON_LINK_FLOW_ON)(void* context);
 
@@ -56,14 +76,40 @@ MOCKABLE_FUNCTION(, int, link_set_initial_delivery_count, LINK_HANDLE, link, seq
 MOCKABLE_FUNCTION(, int, link_get_initial_delivery_count, LINK_HANDLE, link, sequence_no*, initial_delivery_count);
 MOCKABLE_FUNCTION(, int, link_set_max_message_size, LINK_HANDLE, link, uint64_t, max_message_size);
 MOCKABLE_FUNCTION(, int, link_get_max_message_size, LINK_HANDLE, link, uint64_t*, max_message_size);
+/* Sender side: the share of the session window this link gets against the other links of the session that are kept
+   waiting for it, see session_set_link_endpoint_weight */
+MOCKABLE_FUNCTION(, int, link_set_scheduling_weight, LINK_HANDLE, link, uint32_t, weight);
 MOCKABLE_FUNCTION(, int, link_get_peer_max_message_size, LINK_HANDLE, link, uint64_t*, peer_max_message_size);
 MOCKABLE_FUNCTION(, int, link_set_attach_properties, LINK_HANDLE, link, fields, attach_properties);
 MOCKABLE_FUNCTION(, int, link_get_name, LINK_HANDLE, link, const char**, link_name);
+MOCKABLE_FUNCTION(, int, link_get_statistics, LINK_HANDLE, link, LINK_STATISTICS*, statistics);
 MOCKABLE_FUNCTION(, int, link_get_received_message_id, LINK_HANDLE, link, delivery_number*, message_id);
 MOCKABLE_FUNCTION(, int, link_send_disposition, LINK_HANDLE, link, delivery_number, message_number, AMQP_VALUE, delivery_state);
+/* merges dispositions of consecutive deliveries, a batch older than max_delay goes out on the next transfer frame or link_dowork */
+MOCKABLE_FUNCTION(, int, link_set_disposition_batching, LINK_HANDLE, link, uint32_t, max_batch_count, milliseconds, max_delay);
+MOCKABLE_FUNCTION(, int, link_flush_dispositions, LINK_HANDLE, link);
+/* sends the batched dispositions once they are older than the batching max_delay, the application calls it next to connection_dowork */
+MOCKABLE_FUNCTION(, void, link_dowork, LINK_HANDLE, link);
+/* Receiver side: the link grants prefetch_count credit when it attaches and tops it back up to prefetch_count once it
+   falls under refill_threshold (default 10000 and 5000), so the sender is not left waiting for a flow. With
+   max_prefetched_bytes (0: no limit) the credit, and the threshold with it, is lowered so that the deliveries it allows,
+   at the average size received so far, stay within that many bytes. */
+MOCKABLE_FUNCTION(, int, link_set_credit_policy, LINK_HANDLE, link, uint32_t, prefetch_count, uint32_t, refill_threshold, uint64_t, max_prefetched_bytes);
+/* Receiver side: when set, the transfers received are passed to on_transfer_chunk_received frame by frame, with the
+   callback_context given to link_attach, instead of being reassembled into one payload for on_transfer_received, so a
+   delivery never has to fit in memory. NULL goes back to reassembling. Cannot be changed in the middle of a delivery. */
+MOCKABLE_FUNCTION(, int, link_set_on_transfer_chunk_received, LINK_HANDLE, link, ON_TRANSFER_CHUNK_RECEIVED, on_transfer_chunk_received);
 MOCKABLE_FUNCTION(, int, link_attach, LINK_HANDLE, link, ON_TRANSFER_RECEIVED, on_transfer_received, ON_LINK_STATE_CHANGED, on_link_state_changed, ON_LINK_FLOW_ON, on_link_flow_on, void*, callback_context);
 MOCKABLE_FUNCTION(, int, link_detach, LINK_HANDLE, link, bool, close);
 MOCKABLE_FUNCTION(, LINK_TRANSFER_RESULT, link_transfer, LINK_HANDLE, handle, message_format, message_format, PAYLOAD*, payloads, size_t, payload_count, ON_DELIVERY_SETTLED, on_delivery_settled, void*, callback_context);
+/* Sender side: sends a delivery a frame at a time, for payloads produced as they are sent. more is true for all frames but
+   the last one, whose send settles the delivery like link_transfer does; each frame can carry at most what
+   link_get_transfer_frame_payload_size gives. Only the first frame takes credit, but any of them is BUSY when the session
+   window is full, to be retried with the same payload. link_transfer is BUSY until the delivery is done or aborted with
+   link_abort_transfer. */
+MOCKABLE_FUNCTION(, LINK_TRANSFER_RESULT, link_transfer_frame, LINK_HANDLE, link, message_format, message_format, PAYLOAD*, payloads, size_t, payload_count, bool, more, ON_DELIVERY_SETTLED, on_delivery_settled, void*, callback_context);
+MOCKABLE_FUNCTION(, int, link_get_transfer_frame_payload_size, LINK_HANDLE, link, uint32_t*, payload_size);
+MOCKABLE_FUNCTION(, int, link_abort_transfer, LINK_HANDLE, link);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,52 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef MEMORY_PAIR_IO_H
+#define MEMORY_PAIR_IO_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/xio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Two IOs joined back to back in memory, for running a client and a server in one process without sockets.
+	   Bytes sent on one end are copied into a ring buffer (which grows if the peer falls behind) and are indicated
+	   on the other end from its dowork. Closing or destroying one end is reported as an IO error on the other one
+	   once it has drained the bytes sent before the close.
+	   Both ends and the pair must be used from the same thread. The pair stays alive until it and both ends are destroyed. */
+	typedef struct MEMORY_PAIR_INSTANCE_TAG* MEMORY_PAIR_HANDLE;
+
+	typedef enum MEMORY_PAIR_END_TAG
+	{
+		MEMORY_PAIR_END_FIRST,
+		MEMORY_PAIR_END_SECOND
+	} MEMORY_PAIR_END;
+
+	typedef struct MEMORYPAIRIO_CONFIG_TAG
+	{
+		MEMORY_PAIR_HANDLE memory_pair;
+		MEMORY_PAIR_END end;
+	} MEMORYPAIRIO_CONFIG;
+
+	MOCKABLE_FUNCTION(, MEMORY_PAIR_HANDLE, memorypairio_create_pair, size_t, initial_buffer_size);
+	MOCKABLE_FUNCTION(, void, memorypairio_destroy_pair, MEMORY_PAIR_HANDLE, memory_pair);
+
+	MOCKABLE_FUNCTION(, CONCRETE_IO_HANDLE, memorypairio_create, void*, io_create_parameters);
+	MOCKABLE_FUNCTION(, void, memorypairio_destroy, CONCRETE_IO_HANDLE, memory_pair_io);
+	MOCKABLE_FUNCTION(, int, memorypairio_open, CONCRETE_IO_HANDLE, memory_pair_io, ON_IO_OPEN_COMPLETE, on_io_open_complete, void*, on_io_open_complete_context, ON_BYTES_RECEIVED, on_bytes_received, void*, on_bytes_received_context, ON_IO_ERROR, on_io_error, void*, on_io_error_context);
+	MOCKABLE_FUNCTION(, int, memorypairio_close, CONCRETE_IO_HANDLE, memory_pair_io, ON_IO_CLOSE_COMPLETE, on_io_close_complete, void*, callback_context);
+	MOCKABLE_FUNCTION(, int, memorypairio_send, CONCRETE_IO_HANDLE, memory_pair_io, const void*, buffer, size_t, size, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
+	MOCKABLE_FUNCTION(, void, memorypairio_dowork, CONCRETE_IO_HANDLE, memory_pair_io);
+	MOCKABLE_FUNCTION(, int, memorypairio_setoption, CONCRETE_IO_HANDLE, memory_pair_io, const char*, optionName, const void*, value);
+
+	MOCKABLE_FUNCTION(, const IO_INTERFACE_DESCRIPTION*, memorypairio_get_interface_description);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MEMORY_PAIR_IO_H */
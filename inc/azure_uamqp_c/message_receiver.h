@@ -28,11 +28,22 @@ extern "C" {
 
 	typedef struct MESSAGE_RECEIVER_INSTANCE_TAG* MESSAGE_RECEIVER_HANDLE;
 	typedef AMQP_VALUE (*ON_MESSAGE_RECEIVED)(const void* context, MESSAGE_HANDLE message);
+	typedef void(*ON_MESSAGE_SECTIONS_RECEIVED)(const void* context, MESSAGE_HANDLE message);
+	typedef void(*ON_MESSAGE_BODY_DATA_RECEIVED)(const void* context, uint32_t data_section_index, const unsigned char* bytes, size_t length);
+	typedef AMQP_VALUE(*ON_STREAMED_MESSAGE_RECEIVED)(const void* context, MESSAGE_HANDLE message);
 	typedef void(*ON_MESSAGE_RECEIVER_STATE_CHANGED)(const void* context, MESSAGE_RECEIVER_STATE new_state, MESSAGE_RECEIVER_STATE previous_state);
 
 	MOCKABLE_FUNCTION(, MESSAGE_RECEIVER_HANDLE, messagereceiver_create, LINK_HANDLE, link, ON_MESSAGE_RECEIVER_STATE_CHANGED, on_message_receiver_state_changed, void*, context);
 	MOCKABLE_FUNCTION(, void, messagereceiver_destroy, MESSAGE_RECEIVER_HANDLE, message_receiver);
 	MOCKABLE_FUNCTION(, int, messagereceiver_open, MESSAGE_RECEIVER_HANDLE, message_receiver, ON_MESSAGE_RECEIVED, on_message_received, void*, callback_context);
+	/* Receives messages without holding a whole message in memory: the data sections of the body are passed to
+	   on_message_body_data_received (optional) piece by piece as the transfer frames arrive, and are not added to the
+	   message. on_message_sections_received (optional) gets the message with the header, annotations, properties and
+	   application properties before the first body bytes, and on_streamed_message_received gets it once the delivery is
+	   complete, with the footer and any amqp-value body added, and returns the delivery state like ON_MESSAGE_RECEIVED.
+	   The messages are only valid during the calls. A message whose delivery the sender aborts is not completed,
+	   the body bytes received since its on_message_sections_received are to be dropped. */
+	MOCKABLE_FUNCTION(, int, messagereceiver_open_streaming, MESSAGE_RECEIVER_HANDLE, message_receiver, ON_MESSAGE_SECTIONS_RECEIVED, on_message_sections_received, ON_MESSAGE_BODY_DATA_RECEIVED, on_message_body_data_received, ON_STREAMED_MESSAGE_RECEIVED, on_streamed_message_received, void*, callback_context);
 	MOCKABLE_FUNCTION(, int, messagereceiver_close, MESSAGE_RECEIVER_HANDLE, message_receiver);
     MOCKABLE_FUNCTION(, int, messagereceiver_get_link_name, MESSAGE_RECEIVER_HANDLE, message_receiver, const char**, link_name);
     MOCKABLE_FUNCTION(, int, messagereceiver_get_received_message_id, MESSAGE_RECEIVER_HANDLE, message_receiver, delivery_number*, message_number);
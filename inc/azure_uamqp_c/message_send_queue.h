@@ -0,0 +1,34 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef MESSAGE_SEND_QUEUE_H
+#define MESSAGE_SEND_QUEUE_H
+
+#include "azure_uamqp_c/message.h"
+#include "azure_uamqp_c/message_sender.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Thread-safe send submission for a message sender that lives on an I/O thread.
+	   messagesendqueue_submit can be called from any thread: it takes ownership of the message, queues it
+	   and signals the wake fd. The I/O thread polls the fd and calls messagesendqueue_dowork, which hands the
+	   queued messages to messagesender_send. Send completions are called on the I/O thread unless an executor
+	   is given, in which case the executor is handed each completion to run wherever it wants. */
+	typedef struct MESSAGE_SEND_QUEUE_INSTANCE_TAG* MESSAGE_SEND_QUEUE_HANDLE;
+	typedef void(*ON_MESSAGE_SEND_COMPLETE_EXECUTE)(void* executor_context, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context, MESSAGE_SEND_RESULT send_result);
+
+	MOCKABLE_FUNCTION(, MESSAGE_SEND_QUEUE_HANDLE, messagesendqueue_create, MESSAGE_SENDER_HANDLE, message_sender, ON_MESSAGE_SEND_COMPLETE_EXECUTE, on_message_send_complete_execute, void*, executor_context);
+	MOCKABLE_FUNCTION(, void, messagesendqueue_destroy, MESSAGE_SEND_QUEUE_HANDLE, message_send_queue);
+	MOCKABLE_FUNCTION(, int, messagesendqueue_get_wake_fd, MESSAGE_SEND_QUEUE_HANDLE, message_send_queue);
+	MOCKABLE_FUNCTION(, int, messagesendqueue_submit, MESSAGE_SEND_QUEUE_HANDLE, message_send_queue, MESSAGE_HANDLE, message, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context);
+	MOCKABLE_FUNCTION(, void, messagesendqueue_dowork, MESSAGE_SEND_QUEUE_HANDLE, message_send_queue);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MESSAGE_SEND_QUEUE_H */
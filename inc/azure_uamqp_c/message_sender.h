@@ -33,12 +33,26 @@ extern "C" {
     typedef struct MESSAGE_SENDER_INSTANCE_TAG* MESSAGE_SENDER_HANDLE;
     typedef void(*ON_MESSAGE_SEND_COMPLETE)(void* context, MESSAGE_SEND_RESULT send_result);
     typedef void(*ON_MESSAGE_SENDER_STATE_CHANGED)(void* context, MESSAGE_SENDER_STATE new_state, MESSAGE_SENDER_STATE previous_state);
+    /* fills buffer with up to size bytes of the body and sets bytes_read, returns non-zero on error */
+    typedef int(*ON_MESSAGE_BODY_READ)(void* context, unsigned char* buffer, size_t size, size_t* bytes_read);
 
     MOCKABLE_FUNCTION(, MESSAGE_SENDER_HANDLE, messagesender_create, LINK_HANDLE, link, ON_MESSAGE_SENDER_STATE_CHANGED, on_message_sender_state_changed, void*, context);
     MOCKABLE_FUNCTION(, void, messagesender_destroy, MESSAGE_SENDER_HANDLE, message_sender);
     MOCKABLE_FUNCTION(, int, messagesender_open, MESSAGE_SENDER_HANDLE, message_sender);
     MOCKABLE_FUNCTION(, int, messagesender_close, MESSAGE_SENDER_HANDLE, message_sender);
     MOCKABLE_FUNCTION(, int, messagesender_send, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE, message, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context);
+    /* Sends message, which has no body, with a body_length bytes data section read from on_message_body_read as the session
+       window allows, a frame at a time, so that only one frame of it is held in memory. A read error, or the body ending
+       early, aborts the delivery and completes the message with MESSAGE_SEND_ERROR. */
+    MOCKABLE_FUNCTION(, int, messagesender_send_streamed, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE, message, uint32_t, body_length, ON_MESSAGE_BODY_READ, on_message_body_read, void*, body_read_context, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context);
+    /* Sends message, which has no body, with a data section for each of the body_data_count entries of body_data. Their bytes
+       are not copied: they have to stay valid and unchanged until on_message_send_complete is called, or until this fails. */
+    MOCKABLE_FUNCTION(, int, messagesender_send_borrowed_data, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE, message, const BINARY_DATA*, body_data, size_t, body_data_count, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context);
+    /* At most once: on a link sending settled, sends message with nothing kept to report its completion, and no callback.
+       When the link is busy it is queued, in order with the other messages, and forgotten once sent. */
+    MOCKABLE_FUNCTION(, int, messagesender_send_presettled, MESSAGE_SENDER_HANDLE, message_sender, MESSAGE_HANDLE, message);
+    /* messages queued for the link or waiting for their completion, what a pre-settled producer can pace itself on */
+    MOCKABLE_FUNCTION(, int, messagesender_get_pending_message_count, MESSAGE_SENDER_HANDLE, message_sender, size_t*, message_count);
     MOCKABLE_FUNCTION(, void, messagesender_set_trace, MESSAGE_SENDER_HANDLE, message_sender, bool, traceOn);
 
 #ifdef __cplusplus
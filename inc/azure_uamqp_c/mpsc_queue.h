@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Intrusive lock-free queue with many producers and a single consumer.
+	   Items embed an MPSC_QUEUE_ITEM as their first member. Pushing is safe from any thread,
+	   popping only from the consumer thread; a pop may return NULL while a push is half way through,
+	   so producers have to wake the consumer after pushing. */
+	typedef struct MPSC_QUEUE_ITEM_TAG
+	{
+		struct MPSC_QUEUE_ITEM_TAG* next;
+	} MPSC_QUEUE_ITEM;
+
+	typedef struct MPSC_QUEUE_TAG
+	{
+		MPSC_QUEUE_ITEM* head;
+		MPSC_QUEUE_ITEM* tail;
+		MPSC_QUEUE_ITEM stub;
+	} MPSC_QUEUE;
+
+	MOCKABLE_FUNCTION(, void, mpsc_queue_init, MPSC_QUEUE*, queue);
+	MOCKABLE_FUNCTION(, void, mpsc_queue_push, MPSC_QUEUE*, queue, MPSC_QUEUE_ITEM*, item);
+	MOCKABLE_FUNCTION(, MPSC_QUEUE_ITEM*, mpsc_queue_pop, MPSC_QUEUE*, queue);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MPSC_QUEUE_H */
@@ -37,6 +37,25 @@ extern "C" {
 		SESSION_SEND_TRANSFER_BUSY
 	} SESSION_SEND_TRANSFER_RESULT;
 
+	typedef struct SESSION_STATISTICS_TAG
+	{
+		uint64_t transfers_sent;
+		/* transfers that needed more than one frame */
+		uint64_t split_transfers_sent;
+		uint64_t transfer_frames_sent;
+		/* a delivery received in several frames counts once for each of them */
+		uint64_t transfer_frames_received;
+		/* session_send_transfer calls that returned SESSION_SEND_TRANSFER_BUSY */
+		uint64_t send_transfer_busy_count;
+		/* flow frames sent, for the session alone or for a link */
+		uint64_t flows_sent;
+		uint32_t incoming_window;
+		uint32_t outgoing_window;
+		uint32_t remote_incoming_window;
+		uint32_t remote_outgoing_window;
+		uint32_t link_endpoint_count;
+	} SESSION_STATISTICS;
+
 	typedef void(*LINK_ENDPOINT_FRAME_RECEIVED_CALLBACK)(void* context, AMQP_VALUE performative, uint32_t frame_payload_size, const unsigned char* payload_bytes);
 	typedef void(*ON_SESSION_STATE_CHANGED)(void* context, SESSION_STATE new_session_state, SESSION_STATE previous_session_state);
 	typedef void(*ON_SESSION_FLOW_ON)(void* context);
@@ -44,23 +63,38 @@ extern "C" {
 
 	MOCKABLE_FUNCTION(, SESSION_HANDLE, session_create, CONNECTION_HANDLE, connection, ON_LINK_ATTACHED, on_link_attached, void*, callback_context);
 	MOCKABLE_FUNCTION(, SESSION_HANDLE, session_create_from_endpoint, CONNECTION_HANDLE, connection, ENDPOINT_HANDLE, connection_endpoint, ON_LINK_ATTACHED, on_link_attached, void*, callback_context);
+	/* Until session_set_incoming_window fixes it, the incoming window is sized from the transfer rate: it aims at holding
+	   100 ms of transfers (64 to 1048576 of them, 1024 at begin), and at most max_incoming_window_bytes (default 16 MB) of
+	   transfers of the average size received so far. Either way the window is reopened once half of it is used, and
+	   topped up in every link flow. */
 	MOCKABLE_FUNCTION(, int, session_set_incoming_window, SESSION_HANDLE, session, uint32_t, incoming_window);
+	MOCKABLE_FUNCTION(, int, session_set_incoming_window_budget, SESSION_HANDLE, session, uint64_t, max_incoming_window_bytes);
 	MOCKABLE_FUNCTION(, int, session_get_incoming_window, SESSION_HANDLE, session, uint32_t*, incoming_window);
 	MOCKABLE_FUNCTION(, int, session_set_outgoing_window, SESSION_HANDLE, session, uint32_t, outgoing_window);
 	MOCKABLE_FUNCTION(, int, session_get_outgoing_window, SESSION_HANDLE, session, uint32_t*, outgoing_window);
 	MOCKABLE_FUNCTION(, int, session_set_handle_max, SESSION_HANDLE, session, handle, handle_max);
 	MOCKABLE_FUNCTION(, int, session_get_handle_max, SESSION_HANDLE, session, handle*, handle_max);
+	MOCKABLE_FUNCTION(, int, session_get_statistics, SESSION_HANDLE, session, SESSION_STATISTICS*, statistics);
 	MOCKABLE_FUNCTION(, void, session_destroy, SESSION_HANDLE, session);
 	MOCKABLE_FUNCTION(, int, session_begin, SESSION_HANDLE, session);
 	MOCKABLE_FUNCTION(, int, session_end, SESSION_HANDLE, session, const char*, condition_value, const char*, description);
 	MOCKABLE_FUNCTION(, LINK_ENDPOINT_HANDLE, session_create_link_endpoint, SESSION_HANDLE, session, const char*, name);
 	MOCKABLE_FUNCTION(, void, session_destroy_link_endpoint, LINK_ENDPOINT_HANDLE, link_endpoint);
 	MOCKABLE_FUNCTION(, int, session_start_link_endpoint, LINK_ENDPOINT_HANDLE, link_endpoint, ON_ENDPOINT_FRAME_RECEIVED, frame_received_callback, ON_SESSION_STATE_CHANGED, on_session_state_changed, ON_SESSION_FLOW_ON, on_session_flow_on, void*, context);
+	/* When the remote incoming window reopens while several links are waiting for it, each gets a share proportional to
+	   its weight (default 1) */
+	MOCKABLE_FUNCTION(, int, session_set_link_endpoint_weight, LINK_ENDPOINT_HANDLE, link_endpoint, uint32_t, weight);
 	MOCKABLE_FUNCTION(, int, session_send_flow, LINK_ENDPOINT_HANDLE, link_endpoint, FLOW_HANDLE, flow);
 	MOCKABLE_FUNCTION(, int, session_send_attach, LINK_ENDPOINT_HANDLE, link_endpoint, ATTACH_HANDLE, attach);
 	MOCKABLE_FUNCTION(, int, session_send_disposition, LINK_ENDPOINT_HANDLE, link_endpoint, DISPOSITION_HANDLE, disposition);
 	MOCKABLE_FUNCTION(, int, session_send_detach, LINK_ENDPOINT_HANDLE, link_endpoint, DETACH_HANDLE, detach);
 	MOCKABLE_FUNCTION(, SESSION_SEND_TRANSFER_RESULT, session_send_transfer, LINK_ENDPOINT_HANDLE, link_endpoint, TRANSFER_HANDLE, transfer, PAYLOAD*, payloads, size_t, payload_count, delivery_number*, delivery_id, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
+	/* Sends a delivery a frame at a time: a transfer with the more flag set on all but the last frame. The first frame
+	   carries the delivery tag and takes a new delivery id, the following ones reuse it. Each frame needs a slot of the
+	   remote incoming window (BUSY otherwise), except an aborted one, and its payload must fit in the remote max frame
+	   size, which session_get_transfer_frame_payload_size accounts for. */
+	MOCKABLE_FUNCTION(, int, session_get_transfer_frame_payload_size, LINK_ENDPOINT_HANDLE, link_endpoint, TRANSFER_HANDLE, transfer, uint32_t*, payload_size);
+	MOCKABLE_FUNCTION(, SESSION_SEND_TRANSFER_RESULT, session_send_transfer_frame, LINK_ENDPOINT_HANDLE, link_endpoint, TRANSFER_HANDLE, transfer, PAYLOAD*, payloads, size_t, payload_count, delivery_number*, delivery_id, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
 
 #ifdef __cplusplus
 }
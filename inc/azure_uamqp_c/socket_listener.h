@@ -4,6 +4,7 @@
 #ifndef SOCKETLISTENER_H
 #define SOCKETLISTENER_H
 
+#include <stdbool.h>
 #include "azure_c_shared_utility/xio.h"
 
 #ifdef __cplusplus
@@ -16,9 +17,18 @@ extern "C" {
 	typedef void(*ON_SOCKET_ACCEPTED)(void* context, const IO_INTERFACE_DESCRIPTION* interface_description, void* io_parameters);
 
 	MOCKABLE_FUNCTION(, SOCKET_LISTENER_HANDLE, socketlistener_create, int, port);
+	/* Listens on a Unix domain socket bound to socket_path instead of a TCP port. Any file already at socket_path is
+	   removed when the listener starts, and the socket file is removed again when it stops.
+	   Accepted sockets are handed out as socket IOs, exactly as for TCP. Not supported on Windows. */
+	MOCKABLE_FUNCTION(, SOCKET_LISTENER_HANDLE, socketlistener_create_unix, const char*, socket_path);
+	/* With reuse_port set, several listeners (typically one per worker thread) can be started on the same TCP port and
+	   the kernel spreads incoming connections between them. Must be called before socketlistener_start. */
+	MOCKABLE_FUNCTION(, int, socketlistener_set_reuse_port, SOCKET_LISTENER_HANDLE, socket_listener, bool, reuse_port);
 	MOCKABLE_FUNCTION(, void, socketlistener_destroy, SOCKET_LISTENER_HANDLE, socket_listener);
 	MOCKABLE_FUNCTION(, int, socketlistener_start, SOCKET_LISTENER_HANDLE, socket_listener, ON_SOCKET_ACCEPTED, on_socket_accepted, void*, callback_context);
 	MOCKABLE_FUNCTION(, int, socketlistener_stop, SOCKET_LISTENER_HANDLE, socket_listener);
+	/* Accepts every connection waiting in the queue, calling on_socket_accepted for each. The callback may stop the
+	   listener, but must not destroy it. */
 	MOCKABLE_FUNCTION(, void, socketlistener_dowork, SOCKET_LISTENER_HANDLE, socket_listener);
 
 #ifdef __cplusplus
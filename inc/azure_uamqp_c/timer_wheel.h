@@ -0,0 +1,39 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include "azure_c_shared_utility/tickcounter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Hierarchical timer wheel with millisecond resolution.
+	   Scheduling, rescheduling and cancelling a timer are O(1); timer_wheel_advance fires the expired timers
+	   and timer_wheel_get_time_to_next_expiry tells how long the caller can sleep.
+	   timer_wheel_schedule_after counts from the time the wheel was last advanced to (or created at), for owners with their own
+	   tick counter: a delay d scheduled after timer_wheel_advance(now) fires at now + d. */
+	typedef struct TIMER_WHEEL_INSTANCE_TAG* TIMER_WHEEL_HANDLE;
+	typedef struct TIMER_WHEEL_TIMER_INSTANCE_TAG* TIMER_WHEEL_TIMER_HANDLE;
+	typedef void(*ON_TIMER_EXPIRED)(void* context);
+
+	MOCKABLE_FUNCTION(, TIMER_WHEEL_HANDLE, timer_wheel_create, tickcounter_ms_t, current_ms);
+	MOCKABLE_FUNCTION(, void, timer_wheel_destroy, TIMER_WHEEL_HANDLE, timer_wheel);
+	MOCKABLE_FUNCTION(, TIMER_WHEEL_TIMER_HANDLE, timer_wheel_create_timer, TIMER_WHEEL_HANDLE, timer_wheel, ON_TIMER_EXPIRED, on_timer_expired, void*, context);
+	MOCKABLE_FUNCTION(, void, timer_wheel_destroy_timer, TIMER_WHEEL_TIMER_HANDLE, timer);
+	MOCKABLE_FUNCTION(, int, timer_wheel_schedule, TIMER_WHEEL_TIMER_HANDLE, timer, tickcounter_ms_t, expiry_ms);
+	MOCKABLE_FUNCTION(, int, timer_wheel_schedule_after, TIMER_WHEEL_TIMER_HANDLE, timer, tickcounter_ms_t, delay_ms);
+	MOCKABLE_FUNCTION(, void, timer_wheel_cancel, TIMER_WHEEL_TIMER_HANDLE, timer);
+	MOCKABLE_FUNCTION(, uint64_t, timer_wheel_get_time_to_next_expiry, TIMER_WHEEL_HANDLE, timer_wheel, tickcounter_ms_t, current_ms);
+	MOCKABLE_FUNCTION(, int, timer_wheel_advance, TIMER_WHEEL_HANDLE, timer_wheel, tickcounter_ms_t, current_ms);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* TIMER_WHEEL_H */
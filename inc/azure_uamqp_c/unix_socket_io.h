@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef UNIX_SOCKET_IO_H
+#define UNIX_SOCKET_IO_H
+
+#include "azure_c_shared_utility/xio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Client side of a Unix domain socket, the counterpart of socketlistener_create_unix.
+	   Open connects to socket_path and hands the connected socket to a socket IO, so sends, receives and close
+	   behave exactly like a TCP socket IO. Each open makes a new connection. */
+	typedef struct UNIXSOCKETIO_CONFIG_TAG
+	{
+		const char* socket_path;
+	} UNIXSOCKETIO_CONFIG;
+
+	MOCKABLE_FUNCTION(, CONCRETE_IO_HANDLE, unixsocketio_create, void*, io_create_parameters);
+	MOCKABLE_FUNCTION(, void, unixsocketio_destroy, CONCRETE_IO_HANDLE, unix_socket_io);
+	MOCKABLE_FUNCTION(, int, unixsocketio_open, CONCRETE_IO_HANDLE, unix_socket_io, ON_IO_OPEN_COMPLETE, on_io_open_complete, void*, on_io_open_complete_context, ON_BYTES_RECEIVED, on_bytes_received, void*, on_bytes_received_context, ON_IO_ERROR, on_io_error, void*, on_io_error_context);
+	MOCKABLE_FUNCTION(, int, unixsocketio_close, CONCRETE_IO_HANDLE, unix_socket_io, ON_IO_CLOSE_COMPLETE, on_io_close_complete, void*, callback_context);
+	MOCKABLE_FUNCTION(, int, unixsocketio_send, CONCRETE_IO_HANDLE, unix_socket_io, const void*, buffer, size_t, size, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
+	MOCKABLE_FUNCTION(, void, unixsocketio_dowork, CONCRETE_IO_HANDLE, unix_socket_io);
+	MOCKABLE_FUNCTION(, int, unixsocketio_setoption, CONCRETE_IO_HANDLE, unix_socket_io, const char*, optionName, const void*, value);
+
+	MOCKABLE_FUNCTION(, const IO_INTERFACE_DESCRIPTION*, unixsocketio_get_interface_description);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* UNIX_SOCKET_IO_H */
@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef URING_SOCKET_IO_H
+#define URING_SOCKET_IO_H
+
+#include <stdint.h>
+#include "azure_c_shared_utility/xio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Linux only. A socket IO whose receives and sends are io_uring operations instead of recv/send syscalls.
+	   IOs created on the same context share one ring: uringsocketio_context_dowork submits everything they queued
+	   since the last call with a single io_uring_enter and then dispatches the completions (bytes received, sends
+	   completed, errors) to the IOs. The dowork of such an IO does nothing; only the context dowork makes progress.
+	   An IO created with a NULL context gets a ring of its own, driven by its own dowork.
+	   Receives go into buffers registered with the ring (receive_buffer_count of receive_buffer_size bytes), one per
+	   open IO; IOs opened once all of them are taken receive into a buffer of their own with a plain recv.
+	   A context and its IOs must be used from one thread, and the IOs must be destroyed before the context. Destroying
+	   the context cancels what destroyed IOs still have in flight and blocks until the kernel has given it back. */
+	typedef struct URING_SOCKET_IO_CONTEXT_INSTANCE_TAG* URING_SOCKET_IO_CONTEXT_HANDLE;
+
+	typedef struct URINGSOCKETIO_CONFIG_TAG
+	{
+		URING_SOCKET_IO_CONTEXT_HANDLE context;
+		const char* hostname;
+		int port;
+		/* an already connected socket (int*), as in SOCKETIO_CONFIG; hostname and port are then not used */
+		void* accepted_socket;
+	} URINGSOCKETIO_CONFIG;
+
+	MOCKABLE_FUNCTION(, URING_SOCKET_IO_CONTEXT_HANDLE, uringsocketio_context_create, uint32_t, queue_depth, uint32_t, receive_buffer_count, uint32_t, receive_buffer_size);
+	MOCKABLE_FUNCTION(, void, uringsocketio_context_destroy, URING_SOCKET_IO_CONTEXT_HANDLE, context);
+	/* max_wait_ms > 0 blocks until at least one completion arrives or the time runs out (kernels without
+	   IORING_FEAT_EXT_ARG do not wait) */
+	MOCKABLE_FUNCTION(, int, uringsocketio_context_dowork, URING_SOCKET_IO_CONTEXT_HANDLE, context, uint32_t, max_wait_ms);
+
+	MOCKABLE_FUNCTION(, CONCRETE_IO_HANDLE, uringsocketio_create, void*, io_create_parameters);
+	MOCKABLE_FUNCTION(, void, uringsocketio_destroy, CONCRETE_IO_HANDLE, uring_socket_io);
+	MOCKABLE_FUNCTION(, int, uringsocketio_open, CONCRETE_IO_HANDLE, uring_socket_io, ON_IO_OPEN_COMPLETE, on_io_open_complete, void*, on_io_open_complete_context, ON_BYTES_RECEIVED, on_bytes_received, void*, on_bytes_received_context, ON_IO_ERROR, on_io_error, void*, on_io_error_context);
+	MOCKABLE_FUNCTION(, int, uringsocketio_close, CONCRETE_IO_HANDLE, uring_socket_io, ON_IO_CLOSE_COMPLETE, on_io_close_complete, void*, callback_context);
+	MOCKABLE_FUNCTION(, int, uringsocketio_send, CONCRETE_IO_HANDLE, uring_socket_io, const void*, buffer, size_t, size, ON_SEND_COMPLETE, on_send_complete, void*, callback_context);
+	MOCKABLE_FUNCTION(, void, uringsocketio_dowork, CONCRETE_IO_HANDLE, uring_socket_io);
+	MOCKABLE_FUNCTION(, int, uringsocketio_setoption, CONCRETE_IO_HANDLE, uring_socket_io, const char*, optionName, const void*, value);
+
+	MOCKABLE_FUNCTION(, const IO_INTERFACE_DESCRIPTION*, uringsocketio_get_interface_description);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* URING_SOCKET_IO_H */
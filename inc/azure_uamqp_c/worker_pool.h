@@ -0,0 +1,33 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stddef.h>
+#include "azure_uamqp_c/connection_reactor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+	/* Runs N worker threads, each driving its own connection reactor.
+	   A connection and everything created on top of it (sessions, links, senders, receivers) belongs to one worker:
+	   it is created, used and destroyed only from work items running on that worker, so the stack stays single-threaded per shard.
+	   worker_pool_post is the only call that can be made from any thread; it hands the context over to the worker
+	   through a lock-free queue. Work posted before worker_pool_destroy still runs before the threads exit. */
+	typedef struct WORKER_POOL_INSTANCE_TAG* WORKER_POOL_HANDLE;
+	typedef void(*ON_WORKER_POOL_WORK)(void* context, CONNECTION_REACTOR_HANDLE reactor);
+
+	MOCKABLE_FUNCTION(, WORKER_POOL_HANDLE, worker_pool_create, size_t, worker_count);
+	MOCKABLE_FUNCTION(, void, worker_pool_destroy, WORKER_POOL_HANDLE, worker_pool);
+	MOCKABLE_FUNCTION(, size_t, worker_pool_get_worker_count, WORKER_POOL_HANDLE, worker_pool);
+	MOCKABLE_FUNCTION(, int, worker_pool_post, WORKER_POOL_HANDLE, worker_pool, size_t, worker_index, ON_WORKER_POOL_WORK, on_work, void*, context);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* WORKER_POOL_H */
@@ -4,10 +4,12 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
 #include "azure_uamqp_c/amqpvalue_to_string.h"
 #include "azure_uamqp_c/amqpvalue.h"
 
@@ -16,654 +18,672 @@
 #define snprintf _snprintf
 #endif
 
-static int string_concat(char** string, const char* to_concat)
+#define INITIAL_STRING_CAPACITY 64
+#define TRUNCATION_MARKER "..."
+#define TRUNCATION_MARKER_LENGTH (sizeof(TRUNCATION_MARKER) - 1)
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+/* Appends to either a heap buffer that grows geometrically or a fixed caller buffer.
+   Once max_length would be exceeded the output is cut, ends with TRUNCATION_MARKER and further appends are ignored. */
+typedef struct STRING_WRITER_TAG
+{
+	char* buffer;
+	size_t length;
+	size_t capacity;
+	size_t max_length;
+	bool can_grow;
+	bool is_truncated;
+} STRING_WRITER;
+
+static int string_writer_reserve(STRING_WRITER* writer, size_t needed_capacity)
 {
 	int result;
 
-	if ((string == NULL) ||
-		(to_concat == NULL))
+	if (needed_capacity <= writer->capacity)
+	{
+		result = 0;
+	}
+	else if (!writer->can_grow)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		char* new_string;
+		size_t new_capacity = (writer->capacity == 0) ? INITIAL_STRING_CAPACITY : writer->capacity;
+		char* new_buffer;
+
+		while (new_capacity < needed_capacity)
+		{
+			new_capacity *= 2;
+		}
 
-		size_t length = strlen(to_concat) + 1;
-		size_t src_length;
+		/* a bounded string never needs more than max_length characters and the terminator */
+		if ((writer->max_length != 0) &&
+			(new_capacity > writer->max_length + 1))
+		{
+			new_capacity = writer->max_length + 1;
+		}
 
-		if (*string != NULL)
+		new_buffer = (char*)realloc(writer->buffer, new_capacity);
+		if (new_buffer == NULL)
 		{
-			src_length = strlen(*string);
+			LogError("Cannot grow string to %u bytes", (unsigned int)new_capacity);
+			result = __FAILURE__;
 		}
 		else
 		{
-			src_length = 0;
+			writer->buffer = new_buffer;
+			writer->capacity = new_capacity;
+			result = 0;
 		}
+	}
 
-		length += src_length;
+	return result;
+}
+
+static int string_writer_append(STRING_WRITER* writer, const char* chars, size_t count)
+{
+	int result;
+
+	if (writer->is_truncated)
+	{
+		result = 0;
+	}
+	else if ((writer->max_length != 0) &&
+		(count > writer->max_length - writer->length))
+	{
+		size_t kept_length = (writer->max_length > TRUNCATION_MARKER_LENGTH) ? writer->max_length - TRUNCATION_MARKER_LENGTH : 0;
 
-		new_string = (char*)realloc(*string, length);
-		if (new_string == NULL)
+		if (string_writer_reserve(writer, writer->max_length + 1) != 0)
 		{
 			result = __FAILURE__;
 		}
 		else
 		{
-			*string = new_string;
-			(void)strcpy(*string + src_length, to_concat);
+			/* keep what fits before the marker, the marker may also cut into earlier output */
+			if (writer->length < kept_length)
+			{
+				(void)memcpy(writer->buffer + writer->length, chars, kept_length - writer->length);
+			}
+
+			writer->length = kept_length;
+			(void)memcpy(writer->buffer + writer->length, TRUNCATION_MARKER, writer->max_length - kept_length);
+			writer->length = writer->max_length;
+			writer->is_truncated = true;
 			result = 0;
 		}
 	}
+	else if (string_writer_reserve(writer, writer->length + count + 1) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		(void)memcpy(writer->buffer + writer->length, chars, count);
+		writer->length += count;
+		result = 0;
+	}
 
 	return result;
 }
 
-char* amqpvalue_to_string(AMQP_VALUE amqp_value)
+static int string_writer_append_string(STRING_WRITER* writer, const char* string)
+{
+	return string_writer_append(writer, string, strlen(string));
+}
+
+static int string_writer_append_formatted(STRING_WRITER* writer, int formatted_length, const char* formatted)
 {
-	char* result = NULL;
+	int result;
 
-	if (amqp_value != NULL)
+	if (formatted_length < 0)
 	{
-		AMQP_TYPE amqp_type = amqpvalue_get_type(amqp_value);
-		switch (amqp_type)
-		{
-		default:
-			result = NULL;
-			break;
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = string_writer_append(writer, formatted, (size_t)formatted_length);
+	}
 
-		case AMQP_TYPE_NULL:
-			if (string_concat(&result, "NULL") != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			break;
-		case AMQP_TYPE_BOOL:
+	return result;
+}
+
+static int string_writer_append_hex(STRING_WRITER* writer, const unsigned char* bytes, size_t count, const char* separator)
+{
+	int result = 0;
+	size_t separator_length = strlen(separator);
+	size_t i;
+
+	for (i = 0; (i < count) && (result == 0) && (!writer->is_truncated); i++)
+	{
+		char hex[2];
+
+		hex[0] = hex_digits[bytes[i] >> 4];
+		hex[1] = hex_digits[bytes[i] & 0x0F];
+
+		if (((i > 0) && (string_writer_append(writer, separator, separator_length) != 0)) ||
+			(string_writer_append(writer, hex, sizeof(hex)) != 0))
 		{
-			bool value;
-			if ((amqpvalue_get_boolean(amqp_value, &value) != 0) ||
-				(string_concat(&result, (value == true) ? "true" : "false") != 0))
-			{
-				free(result);
-				result = NULL;
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_UBYTE:
+	}
+
+	return result;
+}
+
+static int string_writer_append_value(STRING_WRITER* writer, AMQP_VALUE amqp_value);
+
+static int string_writer_append_items(STRING_WRITER* writer, AMQP_VALUE amqp_value, uint32_t count, AMQP_VALUE(*get_item)(AMQP_VALUE value, uint32_t index))
+{
+	int result;
+
+	if (string_writer_append(writer, "{", 1) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		uint32_t i;
+
+		result = 0;
+
+		for (i = 0; (i < count) && (result == 0) && (!writer->is_truncated); i++)
 		{
-			char str_value[4];
-			uint8_t value;
-			if (amqpvalue_get_ubyte(amqp_value, &value) != 0)
+			AMQP_VALUE item = get_item(amqp_value, i);
+			if (item == NULL)
 			{
-				free(result);
-				result = NULL;
+				result = __FAILURE__;
 			}
 			else
 			{
-				unsigned int uint_value = value;
-				if ((sprintf(str_value, "%u", uint_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
+				if (((i > 0) && (string_writer_append(writer, ",", 1) != 0)) ||
+					(string_writer_append_value(writer, item) != 0))
 				{
-					free(result);
-					result = NULL;
+					result = __FAILURE__;
 				}
+
+				amqpvalue_destroy(item);
 			}
-			break;
 		}
-		case AMQP_TYPE_USHORT:
+
+		if ((result == 0) &&
+			(string_writer_append(writer, "}", 1) != 0))
 		{
-			char str_value[6];
-			uint16_t value;
-			if (amqpvalue_get_ushort(amqp_value, &value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				unsigned int uint_value = value;
-				if ((sprintf(str_value, "%u", uint_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_UINT:
+	}
+
+	return result;
+}
+
+static AMQP_VALUE get_list_item(AMQP_VALUE value, uint32_t index)
+{
+	return amqpvalue_get_list_item(value, index);
+}
+
+static AMQP_VALUE get_array_item(AMQP_VALUE value, uint32_t index)
+{
+	return amqpvalue_get_array_item(value, index);
+}
+
+static int string_writer_append_map(STRING_WRITER* writer, AMQP_VALUE amqp_value, uint32_t count)
+{
+	int result;
+
+	if (string_writer_append(writer, "{", 1) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		uint32_t i;
+
+		result = 0;
+
+		for (i = 0; (i < count) && (result == 0) && (!writer->is_truncated); i++)
 		{
-			char str_value[11];
-			uint32_t value;
-			if (amqpvalue_get_uint(amqp_value, &value) != 0)
+			AMQP_VALUE key;
+			AMQP_VALUE value;
+
+			if (amqpvalue_get_map_key_value_pair(amqp_value, i, &key, &value) != 0)
 			{
-				free(result);
-				result = NULL;
+				result = __FAILURE__;
 			}
 			else
 			{
-				unsigned long uint_value = value;
-				if ((sprintf(str_value, "%lu", uint_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
+				if (((i > 0) && (string_writer_append(writer, ",", 1) != 0)) ||
+					(string_writer_append(writer, "[", 1) != 0) ||
+					(string_writer_append_value(writer, key) != 0) ||
+					(string_writer_append(writer, ":", 1) != 0) ||
+					(string_writer_append_value(writer, value) != 0) ||
+					(string_writer_append(writer, "]", 1) != 0))
 				{
-					free(result);
-					result = NULL;
+					result = __FAILURE__;
 				}
+
+				amqpvalue_destroy(key);
+				amqpvalue_destroy(value);
 			}
-			break;
 		}
-		case AMQP_TYPE_ULONG:
+
+		if ((result == 0) &&
+			(string_writer_append(writer, "}", 1) != 0))
 		{
-			char str_value[21];
-			uint64_t value;
-			if (amqpvalue_get_ulong(amqp_value, &value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				unsigned long long uint_value = value;
-				if ((sprintf(str_value, "%llu", uint_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_BYTE:
+	}
+
+	return result;
+}
+
+static int string_writer_append_value(STRING_WRITER* writer, AMQP_VALUE amqp_value)
+{
+	int result;
+	char str_value[32];
+
+	switch (amqpvalue_get_type(amqp_value))
+	{
+	default:
+		result = __FAILURE__;
+		break;
+
+	case AMQP_TYPE_NULL:
+		result = string_writer_append(writer, "NULL", 4);
+		break;
+	case AMQP_TYPE_BOOL:
+	{
+		bool value;
+		if (amqpvalue_get_boolean(amqp_value, &value) != 0)
 		{
-			char str_value[5];
-			uint8_t value;
-			if (amqpvalue_get_ubyte(amqp_value, &value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				int int_value = value;
-				if ((sprintf(str_value, "%d", int_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_SHORT:
+		else
 		{
-			char str_value[7];
-			uint16_t value;
-			if (amqpvalue_get_ushort(amqp_value, &value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				int int_value = value;
-				if ((sprintf(str_value, "%d", int_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = string_writer_append_string(writer, (value == true) ? "true" : "false");
 		}
-		case AMQP_TYPE_INT:
+		break;
+	}
+	case AMQP_TYPE_UBYTE:
+	{
+		uint8_t value;
+		if (amqpvalue_get_ubyte(amqp_value, &value) != 0)
 		{
-			char str_value[12];
-			int32_t value;
-			if (amqpvalue_get_int(amqp_value, &value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				unsigned long int_value = value;
-				if ((sprintf(str_value, "%ld", int_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_LONG:
+		else
 		{
-			char str_value[21];
-			uint64_t value;
-			if (amqpvalue_get_ulong(amqp_value, &value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				long long int_value = value;
-				if ((sprintf(str_value, "%lld", int_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%u", (unsigned int)value), str_value);
 		}
-		case AMQP_TYPE_FLOAT:
+		break;
+	}
+	case AMQP_TYPE_USHORT:
+	{
+		uint16_t value;
+		if (amqpvalue_get_ushort(amqp_value, &value) != 0)
 		{
-			float float_value;
-			if (amqpvalue_get_float(amqp_value, &float_value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				char str_value[25];
-				if ((snprintf(str_value, sizeof(str_value), "%.02f", float_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-				if (string_concat(&result, str_value) != 0)
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_DOUBLE:
+		else
 		{
-			double double_value;
-			if (amqpvalue_get_double(amqp_value, &double_value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				char str_value[25];
-				if ((snprintf(str_value, sizeof(str_value), "%.02lf", double_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-				if (string_concat(&result, str_value) != 0)
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%u", (unsigned int)value), str_value);
 		}
-		case AMQP_TYPE_CHAR:
+		break;
+	}
+	case AMQP_TYPE_UINT:
+	{
+		uint32_t value;
+		if (amqpvalue_get_uint(amqp_value, &value) != 0)
 		{
-			uint32_t char_code;
-			if (amqpvalue_get_char(amqp_value, &char_code) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				char str_value[25];
-				if ((snprintf(str_value, sizeof(str_value), "U%02X%02X%02X%02X", char_code >> 24, (char_code >> 16) & 0xFF, (char_code >> 8) & 0xFF, char_code & 0xFF) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-				if (string_concat(&result, str_value) != 0)
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_TIMESTAMP:
+		else
 		{
-			char str_value[21];
-			int64_t value;
-			if (amqpvalue_get_timestamp(amqp_value, &value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				long long int_value = value;
-				if ((sprintf(str_value, "%lld", int_value) < 0) ||
-					(string_concat(&result, str_value) != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%lu", (unsigned long)value), str_value);
 		}
-		case AMQP_TYPE_UUID:
-			break;
-		case AMQP_TYPE_BINARY:
+		break;
+	}
+	case AMQP_TYPE_ULONG:
+	{
+		uint64_t value;
+		if (amqpvalue_get_ulong(amqp_value, &value) != 0)
 		{
-			amqp_binary binary_value;
-			if (amqpvalue_get_binary(amqp_value, &binary_value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				if (string_concat(&result, "<") != 0)
-				{
-					free(result);
-					result = NULL;
-				}
-				else
-				{
-					uint64_t i;
-
-					for (i = 0; i < binary_value.length; i++)
-					{
-						char str_value[4];
-						if ((snprintf(str_value, sizeof(str_value), "%s%02X", (i > 0) ? " " : "", ((unsigned char*)binary_value.bytes)[i]) < 0) ||
-							(string_concat(&result, str_value) != 0))
-						{
-							break;
-						}
-					}
-
-					if (i < binary_value.length)
-					{
-						free(result);
-						result = NULL;
-					}
-					else if (string_concat(&result, ">") != 0)
-					{
-						free(result);
-						result = NULL;
-					}
-				}
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_STRING:
+		else
 		{
-			const char* string_value;
-			if (amqpvalue_get_string(amqp_value, &string_value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				if (string_concat(&result, string_value) != 0)
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%llu", (unsigned long long)value), str_value);
 		}
-		case AMQP_TYPE_SYMBOL:
+		break;
+	}
+	case AMQP_TYPE_BYTE:
+	{
+		char value;
+		if (amqpvalue_get_byte(amqp_value, &value) != 0)
 		{
-			const char* string_value;
-			if (amqpvalue_get_symbol(amqp_value, &string_value) != 0)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				if (string_concat(&result, string_value) != 0)
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = __FAILURE__;
 		}
-		case AMQP_TYPE_LIST:
+		else
 		{
-			uint32_t count;
-			if ((amqpvalue_get_list_item_count(amqp_value, &count) != 0) ||
-				(string_concat(&result, "{") != 0))
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				size_t i;
-				for (i = 0; i < count; i++)
-				{
-					AMQP_VALUE item = amqpvalue_get_list_item(amqp_value, i);
-					if (item == NULL)
-					{
-						break;
-					}
-					else
-					{
-						char* item_string = amqpvalue_to_string(item);
-						if (item_string == NULL)
-						{
-							amqpvalue_destroy(item);
-							break;
-						}
-						else
-						{
-							if ((i > 0) && (string_concat(&result, ",") != 0))
-							{
-								free(result);
-								result = NULL;
-								break;
-							}
-							else if (string_concat(&result, item_string) != 0)
-							{
-								free(result);
-								result = NULL;
-								break;
-							}
-
-							free(item_string);
-						}
-
-						amqpvalue_destroy(item);
-					}
-				}
-
-				if ((i < count) ||
-					(string_concat(&result, "}") != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%d", (int)(signed char)value), str_value);
 		}
-		case AMQP_TYPE_MAP:
+		break;
+	}
+	case AMQP_TYPE_SHORT:
+	{
+		int16_t value;
+		if (amqpvalue_get_short(amqp_value, &value) != 0)
 		{
-			uint32_t count;
-			if ((amqpvalue_get_map_pair_count(amqp_value, &count) != 0) ||
-				(string_concat(&result, "{") != 0))
-			{
-				free(result);
-				result = NULL;
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%d", (int)value), str_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_INT:
+	{
+		int32_t value;
+		if (amqpvalue_get_int(amqp_value, &value) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%ld", (long)value), str_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_LONG:
+	{
+		int64_t value;
+		if (amqpvalue_get_long(amqp_value, &value) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%lld", (long long)value), str_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_FLOAT:
+	{
+		float value;
+		if (amqpvalue_get_float(amqp_value, &value) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%.02f", value), str_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_DOUBLE:
+	{
+		double value;
+		if (amqpvalue_get_double(amqp_value, &value) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%.02lf", value), str_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_CHAR:
+	{
+		uint32_t char_code;
+		if (amqpvalue_get_char(amqp_value, &char_code) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "U%02X%02X%02X%02X",
+				(unsigned int)(char_code >> 24), (unsigned int)((char_code >> 16) & 0xFF), (unsigned int)((char_code >> 8) & 0xFF), (unsigned int)(char_code & 0xFF)), str_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_TIMESTAMP:
+	{
+		int64_t value;
+		if (amqpvalue_get_timestamp(amqp_value, &value) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_formatted(writer, snprintf(str_value, sizeof(str_value), "%lld", (long long)value), str_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_UUID:
+	{
+		uuid value;
+		if (amqpvalue_get_uuid(amqp_value, &value) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			/* 8-4-4-4-12 */
+			if ((string_writer_append_hex(writer, value, 4, "") != 0) ||
+				(string_writer_append(writer, "-", 1) != 0) ||
+				(string_writer_append_hex(writer, value + 4, 2, "") != 0) ||
+				(string_writer_append(writer, "-", 1) != 0) ||
+				(string_writer_append_hex(writer, value + 6, 2, "") != 0) ||
+				(string_writer_append(writer, "-", 1) != 0) ||
+				(string_writer_append_hex(writer, value + 8, 2, "") != 0) ||
+				(string_writer_append(writer, "-", 1) != 0) ||
+				(string_writer_append_hex(writer, value + 10, 6, "") != 0))
+			{
+				result = __FAILURE__;
 			}
 			else
 			{
-				uint32_t i;
-				for (i = 0; i < count; i++)
-				{
-					AMQP_VALUE key;
-					AMQP_VALUE value;
-					if (amqpvalue_get_map_key_value_pair(amqp_value, i, &key, &value) != 0)
-					{
-						break;
-					}
-					else
-					{
-						char* key_string = amqpvalue_to_string(key);
-						if (key_string == NULL)
-						{
-							amqpvalue_destroy(key);
-							amqpvalue_destroy(value);
-							break;
-						}
-						else
-						{
-							char* value_string = amqpvalue_to_string(value);
-							if (key_string == NULL)
-							{
-								free(key_string);
-								amqpvalue_destroy(key);
-								amqpvalue_destroy(value);
-								break;
-							}
-							else
-							{
-								if (((i > 0) && (string_concat(&result, ",") != 0)) ||
-									(string_concat(&result, "[") != 0) ||
-									(string_concat(&result, key_string) != 0) ||
-									(string_concat(&result, ":") != 0) ||
-									(string_concat(&result, value_string) != 0) ||
-									(string_concat(&result, "]") != 0))
-								{
-									free(key_string);
-									free(value_string);
-									amqpvalue_destroy(key);
-									amqpvalue_destroy(value);
-									break;
-								}
-
-								free(value_string);
-							}
-
-							free(key_string);
-						}
-
-						amqpvalue_destroy(key);
-						amqpvalue_destroy(value);
-					}
-				}
-
-				if ((i < count) ||
-					(string_concat(&result, "}") != 0))
-				{
-					free(result);
-					result = NULL;
-				}
+				result = 0;
 			}
-			break;
 		}
-		case AMQP_TYPE_ARRAY:
+		break;
+	}
+	case AMQP_TYPE_BINARY:
+	{
+		amqp_binary binary_value;
+		if (amqpvalue_get_binary(amqp_value, &binary_value) != 0)
 		{
-			uint32_t count;
-			if ((amqpvalue_get_array_item_count(amqp_value, &count) != 0) ||
-				(string_concat(&result, "{") != 0))
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				uint32_t i;
-				for (i = 0; i < count; i++)
-				{
-					AMQP_VALUE item = amqpvalue_get_array_item(amqp_value, i);
-					if (item == NULL)
-					{
-						break;
-					}
-					else
-					{
-						char* item_string = amqpvalue_to_string(item);
-						if (item_string == NULL)
-						{
-							amqpvalue_destroy(item);
-							break;
-						}
-						else
-						{
-							if ((i > 0) && (string_concat(&result, ",") != 0))
-							{
-								free(result);
-								result = NULL;
-								break;
-							}
-							else if (string_concat(&result, item_string) != 0)
-							{
-								free(result);
-								result = NULL;
-								break;
-							}
-
-							free(item_string);
-						}
-
-						amqpvalue_destroy(item);
-					}
-				}
+			result = __FAILURE__;
+		}
+		else if ((string_writer_append(writer, "<", 1) != 0) ||
+			(string_writer_append_hex(writer, (const unsigned char*)binary_value.bytes, binary_value.length, " ") != 0) ||
+			(string_writer_append(writer, ">", 1) != 0))
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+		break;
+	}
+	case AMQP_TYPE_STRING:
+	{
+		const char* string_value;
+		if (amqpvalue_get_string(amqp_value, &string_value) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_string(writer, string_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_SYMBOL:
+	{
+		const char* string_value;
+		if (amqpvalue_get_symbol(amqp_value, &string_value) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_string(writer, string_value);
+		}
+		break;
+	}
+	case AMQP_TYPE_LIST:
+	{
+		uint32_t count;
+		if (amqpvalue_get_list_item_count(amqp_value, &count) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_items(writer, amqp_value, count, get_list_item);
+		}
+		break;
+	}
+	case AMQP_TYPE_MAP:
+	{
+		uint32_t count;
+		if (amqpvalue_get_map_pair_count(amqp_value, &count) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_map(writer, amqp_value, count);
+		}
+		break;
+	}
+	case AMQP_TYPE_ARRAY:
+	{
+		uint32_t count;
+		if (amqpvalue_get_array_item_count(amqp_value, &count) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = string_writer_append_items(writer, amqp_value, count, get_array_item);
+		}
+		break;
+	}
+	case AMQP_TYPE_COMPOSITE:
+	case AMQP_TYPE_DESCRIBED:
+	{
+		AMQP_VALUE described_value = amqpvalue_get_inplace_described_value(amqp_value);
+		if ((described_value == NULL) ||
+			(string_writer_append(writer, "* ", 2) != 0) ||
+			(string_writer_append_value(writer, described_value) != 0))
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+		break;
+	}
+	}
 
-				if ((i < count) ||
-					(string_concat(&result, "}") != 0))
-				{
-					free(result);
-					result = NULL;
-				}
-			}
-			break;
+	return result;
+}
+
+static char* format_value(AMQP_VALUE amqp_value, size_t max_length)
+{
+	char* result;
+
+	if (amqp_value == NULL)
+	{
+		result = NULL;
+	}
+	else
+	{
+		STRING_WRITER writer;
+
+		writer.buffer = NULL;
+		writer.length = 0;
+		writer.capacity = 0;
+		writer.max_length = max_length;
+		writer.can_grow = true;
+		writer.is_truncated = false;
+
+		if ((string_writer_append_value(&writer, amqp_value) != 0) ||
+			(string_writer_reserve(&writer, writer.length + 1) != 0))
+		{
+			free(writer.buffer);
+			result = NULL;
 		}
-		case AMQP_TYPE_COMPOSITE:
-		case AMQP_TYPE_DESCRIBED:
+		else
 		{
-			AMQP_VALUE described_value = amqpvalue_get_inplace_described_value(amqp_value);
-			if (described_value == NULL)
-			{
-				free(result);
-				result = NULL;
-			}
-			else
-			{
-				if (string_concat(&result, "* ") != 0)
-				{
-					free(result);
-					result = NULL;
-				}
-				else
-				{
-					char* described_value_string = amqpvalue_to_string(described_value);
-					if (described_value_string == NULL)
-					{
-						free(result);
-						result = NULL;
-					}
-					else
-					{
-						if (string_concat(&result, described_value_string) != 0)
-						{
-							free(result);
-							result = NULL;
-						}
-
-						free(described_value_string);
-					}
-				}
-			}
-			break;
+			writer.buffer[writer.length] = '\0';
+			result = writer.buffer;
 		}
+	}
+
+	return result;
+}
+
+char* amqpvalue_to_string(AMQP_VALUE amqp_value)
+{
+	return format_value(amqp_value, 0);
+}
+
+char* amqpvalue_to_string_bounded(AMQP_VALUE amqp_value, size_t max_length)
+{
+	char* result;
+
+	if (max_length == 0)
+	{
+		LogError("Zero max_length");
+		result = NULL;
+	}
+	else
+	{
+		result = format_value(amqp_value, max_length);
+	}
+
+	return result;
+}
+
+int amqpvalue_to_string_buffer(AMQP_VALUE amqp_value, char* buffer, size_t buffer_size)
+{
+	int result;
+
+	if ((amqp_value == NULL) ||
+		(buffer == NULL) ||
+		(buffer_size < 2))
+	{
+		LogError("Bad arguments: amqp_value = %p, buffer = %p, buffer_size = %u",
+			amqp_value, buffer, (unsigned int)buffer_size);
+		result = __FAILURE__;
+	}
+	else
+	{
+		STRING_WRITER writer;
+
+		writer.buffer = buffer;
+		writer.length = 0;
+		writer.capacity = buffer_size;
+		writer.max_length = buffer_size - 1;
+		writer.can_grow = false;
+		writer.is_truncated = false;
+
+		if (string_writer_append_value(&writer, amqp_value) != 0)
+		{
+			buffer[0] = '\0';
+			result = __FAILURE__;
+		}
+		else
+		{
+			buffer[writer.length] = '\0';
+			result = 0;
 		}
 	}
 
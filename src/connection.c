@@ -39,6 +39,19 @@ typedef struct ENDPOINT_INSTANCE_TAG
     CONNECTION_HANDLE connection;
 } ENDPOINT_INSTANCE;
 
+typedef struct SEND_COMPLETION_TAG
+{
+    ON_SEND_COMPLETE on_send_complete;
+    void* callback_context;
+} SEND_COMPLETION;
+
+/* completions of the frames that went out in one coalesced xio_send, allocated together with the completions */
+typedef struct COALESCED_SEND_TAG
+{
+    size_t completion_count;
+    SEND_COMPLETION completions[1];
+} COALESCED_SEND;
+
 typedef struct CONNECTION_INSTANCE_TAG
 {
     XIO_HANDLE io;
@@ -56,6 +69,16 @@ typedef struct CONNECTION_INSTANCE_TAG
     ON_SEND_COMPLETE on_send_complete;
     void* on_send_complete_callback_context;
 
+    /* send coalescing, disabled when max_coalesced_bytes is 0 */
+    unsigned char* coalesce_buffer;
+    size_t coalesced_byte_count;
+    SEND_COMPLETION* coalesced_completions;
+    size_t coalesced_completion_count;
+    size_t coalesced_completion_capacity;
+    uint32_t max_coalesced_bytes;
+    milliseconds max_coalescing_delay;
+    tickcounter_ms_t first_coalesced_byte_time;
+
     ON_NEW_ENDPOINT on_new_endpoint;
     void* on_new_endpoint_callback_context;
 
@@ -72,12 +95,54 @@ typedef struct CONNECTION_INSTANCE_TAG
     tickcounter_ms_t last_frame_received_time;
     tickcounter_ms_t last_frame_sent_time;
 
+    /* idle/heartbeat timers and the timer flushing bytes coalesced outside connection_dowork, only used once a timer wheel is attached */
+    TIMER_WHEEL_TIMER_HANDLE idle_timer;
+    TIMER_WHEEL_TIMER_HANDLE heartbeat_timer;
+    TIMER_WHEEL_TIMER_HANDLE flush_timer;
+
+#ifndef UAMQP_NO_STATISTICS
+    CONNECTION_STATISTICS statistics;
+#endif
+
     unsigned int is_underlying_io_open : 1;
     unsigned int idle_timeout_specified : 1;
     unsigned int is_remote_frame_received : 1;
     unsigned int is_trace_on : 1;
+    unsigned int is_flushing_coalesced_bytes : 1;
+    unsigned int is_idle_timeout_expired : 1;
+    unsigned int is_in_dowork : 1;
 } CONNECTION_INSTANCE;
 
+#ifndef UAMQP_NO_STATISTICS
+static void count_performative(uint64_t* performative_counts, uint64_t descriptor_code)
+{
+    if ((descriptor_code >= AMQP_OPEN) &&
+        (descriptor_code <= AMQP_CLOSE))
+    {
+        performative_counts[descriptor_code - AMQP_OPEN]++;
+    }
+}
+
+/* the frames received are classified by the dispatch anyway, outgoing ones only come in as a value */
+static void count_outgoing_performative(CONNECTION_HANDLE connection, AMQP_VALUE performative)
+{
+    AMQP_VALUE descriptor = amqpvalue_get_inplace_descriptor(performative);
+    uint64_t descriptor_code;
+
+    if ((descriptor != NULL) &&
+        (amqpvalue_get_ulong(descriptor, &descriptor_code) == 0))
+    {
+        count_performative(connection->statistics.performatives_sent, descriptor_code);
+    }
+}
+
+#define COUNT_PERFORMATIVE(performative_counts, descriptor_code) count_performative(performative_counts, descriptor_code)
+#define COUNT_OUTGOING_PERFORMATIVE(connection, performative) count_outgoing_performative(connection, performative)
+#else
+#define COUNT_PERFORMATIVE(performative_counts, descriptor_code)
+#define COUNT_OUTGOING_PERFORMATIVE(connection, performative)
+#endif
+
 /* Codes_SRS_CONNECTION_01_258: [on_connection_state_changed shall be invoked whenever the connection state changes.]*/
 static void connection_set_state(CONNECTION_HANDLE connection, CONNECTION_STATE connection_state)
 {
@@ -195,14 +260,12 @@ static void log_incoming_frame(AMQP_VALUE performative)
 	}
 	else
 	{
-		char* performative_as_string;
+		char performative_as_string[TRACE_STRING_BUFFER_SIZE];
         LOG(AZ_LOG_TRACE, 0, "<- ");
         LOG(AZ_LOG_TRACE, 0, (char*)get_frame_type_as_string(descriptor));
-        performative_as_string = NULL;
-        LOG(AZ_LOG_TRACE, LOG_LINE, (performative_as_string = amqpvalue_to_string(performative)));
-        if (performative_as_string != NULL)
+        if (amqpvalue_to_string_buffer(performative, performative_as_string, sizeof(performative_as_string)) == 0)
         {
-            free(performative_as_string);
+            LOG(AZ_LOG_TRACE, LOG_LINE, "%s", performative_as_string);
         }
     }
 #endif
@@ -220,23 +283,215 @@ static void log_outgoing_frame(AMQP_VALUE performative)
 	}
 	else
 	{
-		char* performative_as_string;
+		char performative_as_string[TRACE_STRING_BUFFER_SIZE];
 		LOG(AZ_LOG_TRACE, 0, "-> ");
         LOG(AZ_LOG_TRACE, 0, (char*)get_frame_type_as_string(descriptor));
-        performative_as_string = NULL;
-        LOG(AZ_LOG_TRACE, LOG_LINE, (performative_as_string = amqpvalue_to_string(performative)));
-        if (performative_as_string != NULL)
+        if (amqpvalue_to_string_buffer(performative, performative_as_string, sizeof(performative_as_string)) == 0)
         {
-            free(performative_as_string);
+            LOG(AZ_LOG_TRACE, LOG_LINE, "%s", performative_as_string);
         }
     }
 #endif
 }
 
+static void indicate_send_complete(const SEND_COMPLETION* completions, size_t completion_count, IO_SEND_RESULT send_result)
+{
+    size_t i;
+
+    for (i = 0; i < completion_count; i++)
+    {
+        completions[i].on_send_complete(completions[i].callback_context, send_result);
+    }
+}
+
+static void on_coalesced_send_complete(void* context, IO_SEND_RESULT send_result)
+{
+    COALESCED_SEND* coalesced_send = (COALESCED_SEND*)context;
+
+    indicate_send_complete(coalesced_send->completions, coalesced_send->completion_count, send_result);
+    free(coalesced_send);
+}
+
+static int flush_coalesced_bytes(CONNECTION_HANDLE connection)
+{
+    int result;
+
+    /* a flush from a completion fired by the flush itself (close, heartbeat, flush) finds the buffer already with the io */
+    if ((connection->coalesced_byte_count == 0) ||
+        connection->is_flushing_coalesced_bytes)
+    {
+        result = 0;
+    }
+    else
+    {
+        COALESCED_SEND* coalesced_send = NULL;
+        size_t byte_count = connection->coalesced_byte_count;
+        size_t completion_count = connection->coalesced_completion_count;
+
+        connection->coalesced_byte_count = 0;
+        connection->coalesced_completion_count = 0;
+
+        if (connection->flush_timer != NULL)
+        {
+            timer_wheel_cancel(connection->flush_timer);
+        }
+
+        if ((completion_count > 0) &&
+            ((coalesced_send = (COALESCED_SEND*)malloc(sizeof(COALESCED_SEND) + (sizeof(SEND_COMPLETION) * (completion_count - 1)))) == NULL))
+        {
+            LogError("Cannot allocate memory for the coalesced send completions");
+            /* frames encoded from these completions must not overwrite the ones still being indicated */
+            connection->is_flushing_coalesced_bytes = 1;
+            indicate_send_complete(connection->coalesced_completions, completion_count, IO_SEND_ERROR);
+            connection->is_flushing_coalesced_bytes = 0;
+            result = __FAILURE__;
+        }
+        else
+        {
+            int send_result;
+
+            if (coalesced_send != NULL)
+            {
+                coalesced_send->completion_count = completion_count;
+                (void)memcpy(coalesced_send->completions, connection->coalesced_completions, sizeof(SEND_COMPLETION) * completion_count);
+            }
+
+            /* completions can fire from within xio_send and encode new frames, those bypass the buffer while it is in use */
+            connection->is_flushing_coalesced_bytes = 1;
+            send_result = xio_send(connection->io, connection->coalesce_buffer, byte_count, (coalesced_send == NULL) ? NULL : on_coalesced_send_complete, coalesced_send);
+            connection->is_flushing_coalesced_bytes = 0;
+
+            if (send_result != 0)
+            {
+                LogError("Cannot send coalesced bytes");
+                if (coalesced_send != NULL)
+                {
+                    indicate_send_complete(coalesced_send->completions, coalesced_send->completion_count, IO_SEND_ERROR);
+                    free(coalesced_send);
+                }
+
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int coalesce_bytes(CONNECTION_HANDLE connection, const unsigned char* bytes, size_t length, bool encode_complete)
+{
+    int result;
+    ON_SEND_COMPLETE on_send_complete = encode_complete ? connection->on_send_complete : NULL;
+
+    if (connection->is_flushing_coalesced_bytes)
+    {
+        /* encoded from a completion fired by the flush itself, the buffered bytes are already with the io */
+        result = xio_send(connection->io, bytes, length, on_send_complete, connection->on_send_complete_callback_context);
+    }
+    else if (length >= connection->max_coalesced_bytes)
+    {
+        /* large chunks are not copied, whatever is buffered ahead of them goes out first */
+        if (flush_coalesced_bytes(connection) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else if (xio_send(connection->io, bytes, length, on_send_complete, connection->on_send_complete_callback_context) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    else if ((connection->coalesced_byte_count + length > connection->max_coalesced_bytes) &&
+        (flush_coalesced_bytes(connection) != 0))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((on_send_complete != NULL) &&
+            (connection->coalesced_completion_count == connection->coalesced_completion_capacity))
+        {
+            size_t new_capacity = (connection->coalesced_completion_capacity == 0) ? 16 : connection->coalesced_completion_capacity * 2;
+            SEND_COMPLETION* new_completions = (SEND_COMPLETION*)realloc(connection->coalesced_completions, sizeof(SEND_COMPLETION) * new_capacity);
+            if (new_completions != NULL)
+            {
+                connection->coalesced_completions = new_completions;
+                connection->coalesced_completion_capacity = new_capacity;
+            }
+        }
+
+        if ((on_send_complete != NULL) &&
+            (connection->coalesced_completion_count == connection->coalesced_completion_capacity))
+        {
+            LogError("Cannot allocate memory for the send completion");
+            result = __FAILURE__;
+        }
+        else if ((connection->coalesced_byte_count == 0) &&
+            (connection->max_coalescing_delay > 0) &&
+            (tickcounter_get_current_ms(connection->tick_counter, &connection->first_coalesced_byte_time) != 0))
+        {
+            LogError("Could not get tick counter value");
+            result = __FAILURE__;
+        }
+        else
+        {
+            (void)memcpy(connection->coalesce_buffer + connection->coalesced_byte_count, bytes, length);
+            connection->coalesced_byte_count += length;
+
+            /* outside of its own dowork, e.g. for a frame forwarded from another connection of the same reactor, nothing
+               may run this connection for a long time, so the timer wheel gets to flush the bytes */
+            if ((connection->coalesced_byte_count == length) &&
+                (!connection->is_in_dowork) &&
+                (connection->flush_timer != NULL))
+            {
+                (void)timer_wheel_schedule_after(connection->flush_timer, connection->max_coalescing_delay);
+            }
+
+            if (on_send_complete != NULL)
+            {
+                connection->coalesced_completions[connection->coalesced_completion_count].on_send_complete = on_send_complete;
+                connection->coalesced_completions[connection->coalesced_completion_count].callback_context = connection->on_send_complete_callback_context;
+                connection->coalesced_completion_count++;
+            }
+
+            if (connection->coalesced_byte_count == connection->max_coalesced_bytes)
+            {
+                result = flush_coalesced_bytes(connection);
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
 static void on_bytes_encoded(void* context, const unsigned char* bytes, size_t length, bool encode_complete)
 {
     CONNECTION_HANDLE connection = (CONNECTION_HANDLE)context;
-    if (xio_send(connection->io, bytes, length, encode_complete ? connection->on_send_complete : NULL, connection->on_send_complete_callback_context) != 0)
+    int result;
+
+    AMQP_STATISTICS_ADD(connection->statistics.bytes_sent, length);
+
+    if (connection->max_coalesced_bytes == 0)
+    {
+        result = xio_send(connection->io, bytes, length, encode_complete ? connection->on_send_complete : NULL, connection->on_send_complete_callback_context);
+    }
+    else
+    {
+        result = coalesce_bytes(connection, bytes, length, encode_complete);
+    }
+
+    if (result != 0)
     {
 		LogError("Cannot send encoded bytes");
 
@@ -389,6 +644,9 @@ static int send_open_frame(CONNECTION_HANDLE connection)
                             log_outgoing_frame(open_performative_value);
                         }
 
+                        AMQP_STATISTICS_INCREMENT(connection->statistics.frames_sent);
+                        COUNT_PERFORMATIVE(connection->statistics.performatives_sent, AMQP_OPEN);
+
                         /* Codes_SRS_CONNECTION_01_046: [OPEN SENT In this state the connection headers have been exchanged. An open frame has been sent to the peer but no open frame has yet been received.] */
                         connection_set_state(connection, CONNECTION_STATE_OPEN_SENT);
                         result = 0;
@@ -445,6 +703,11 @@ static int send_close_frame(CONNECTION_HANDLE connection, ERROR_HANDLE error_han
 					LogError("amqp_frame_codec_encode_frame failed");
 					result = __FAILURE__;
                 }
+                else if (flush_coalesced_bytes(connection) != 0)
+                {
+					LogError("Cannot send coalesced bytes ahead of CLOSE");
+					result = __FAILURE__;
+                }
                 else
                 {
                     if (connection->is_trace_on == 1)
@@ -452,6 +715,9 @@ static int send_close_frame(CONNECTION_HANDLE connection, ERROR_HANDLE error_han
                         log_outgoing_frame(close_performative_value);
                     }
 
+                    AMQP_STATISTICS_INCREMENT(connection->statistics.frames_sent);
+                    COUNT_PERFORMATIVE(connection->statistics.performatives_sent, AMQP_CLOSE);
+
                     result = 0;
                 }
 
@@ -517,6 +783,149 @@ static void close_connection_with_error(CONNECTION_HANDLE connection, const char
     }
 }
 
+static int send_empty_frame(CONNECTION_HANDLE connection, tickcounter_ms_t current_ms)
+{
+    int result;
+
+    connection->on_send_complete = NULL;
+    if (amqp_frame_codec_encode_empty_frame(connection->amqp_frame_codec, 0, on_bytes_encoded, connection) != 0)
+    {
+        LogError("Encoding the empty frame failed");
+        /* close connection */
+        close_connection_with_error(connection, "amqp:internal-error", "Cannot send empty frame");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (connection->is_trace_on == 1)
+        {
+            LOG(AZ_LOG_TRACE, LOG_LINE, "-> Empty frame");
+        }
+
+        AMQP_STATISTICS_INCREMENT(connection->statistics.frames_sent);
+        AMQP_STATISTICS_INCREMENT(connection->statistics.empty_frames_sent);
+
+        connection->last_frame_sent_time = current_ms;
+        result = 0;
+    }
+
+    return result;
+}
+
+/* The timers are not moved on every frame: when one expires it checks the last frame times
+   and either acts or re-arms itself for the remaining time. */
+static void on_idle_timer_expired(void* context)
+{
+    CONNECTION_HANDLE connection = (CONNECTION_HANDLE)context;
+    tickcounter_ms_t current_ms;
+
+    if (tickcounter_get_current_ms(connection->tick_counter, &current_ms) != 0)
+    {
+        LogError("Could not get tick counter value");
+        close_connection_with_error(connection, "amqp:internal-error", "Could not get tick count");
+    }
+    else if (connection->idle_timeout_specified && (connection->idle_timeout != 0))
+    {
+        uint64_t time_since_last_received = current_ms - connection->last_frame_received_time;
+        if (time_since_last_received < connection->idle_timeout)
+        {
+            (void)timer_wheel_schedule_after(connection->idle_timer, connection->idle_timeout - time_since_last_received);
+        }
+        else
+        {
+            connection->is_idle_timeout_expired = 1;
+
+            /* close connection */
+            close_connection_with_error(connection, "amqp:internal-error", "No frame received for the idle timeout");
+        }
+    }
+}
+
+static void on_heartbeat_timer_expired(void* context)
+{
+    CONNECTION_HANDLE connection = (CONNECTION_HANDLE)context;
+    tickcounter_ms_t current_ms;
+
+    if (tickcounter_get_current_ms(connection->tick_counter, &current_ms) != 0)
+    {
+        LogError("Could not get tick counter value");
+        close_connection_with_error(connection, "amqp:internal-error", "Could not get tick count");
+    }
+    else if ((!connection->is_idle_timeout_expired) &&
+        (connection->remote_idle_timeout != 0))
+    {
+        uint64_t remote_idle_timeout = (connection->remote_idle_timeout / 2);
+        uint64_t time_since_last_sent = current_ms - connection->last_frame_sent_time;
+
+        if (time_since_last_sent < remote_idle_timeout)
+        {
+            (void)timer_wheel_schedule_after(connection->heartbeat_timer, remote_idle_timeout - time_since_last_sent);
+        }
+        else if (send_empty_frame(connection, current_ms) == 0)
+        {
+            /* nothing else is going out on an idle connection, so there is nothing to wait for */
+            if (flush_coalesced_bytes(connection) != 0)
+            {
+                LogError("Sending the coalesced bytes failed");
+                close_connection_with_error(connection, "amqp:internal-error", "Cannot send coalesced bytes");
+            }
+            else if (connection->heartbeat_timer != NULL)
+            {
+                (void)timer_wheel_schedule_after(connection->heartbeat_timer, remote_idle_timeout);
+            }
+        }
+    }
+}
+
+static void on_flush_timer_expired(void* context)
+{
+    CONNECTION_HANDLE connection = (CONNECTION_HANDLE)context;
+
+    if (flush_coalesced_bytes(connection) != 0)
+    {
+        LogError("Sending the coalesced bytes failed");
+        close_connection_with_error(connection, "amqp:internal-error", "Cannot send coalesced bytes");
+    }
+}
+
+static void arm_idle_timers(CONNECTION_HANDLE connection)
+{
+    if (connection->idle_timer != NULL)
+    {
+        /* firing right away lets the expiry handlers compute the remaining time */
+        if (connection->idle_timeout_specified && (connection->idle_timeout != 0))
+        {
+            (void)timer_wheel_schedule_after(connection->idle_timer, 0);
+        }
+
+        if (connection->remote_idle_timeout != 0)
+        {
+            (void)timer_wheel_schedule_after(connection->heartbeat_timer, 0);
+        }
+    }
+}
+
+static void destroy_timers(CONNECTION_HANDLE connection)
+{
+    if (connection->idle_timer != NULL)
+    {
+        timer_wheel_destroy_timer(connection->idle_timer);
+        connection->idle_timer = NULL;
+    }
+
+    if (connection->heartbeat_timer != NULL)
+    {
+        timer_wheel_destroy_timer(connection->heartbeat_timer);
+        connection->heartbeat_timer = NULL;
+    }
+
+    if (connection->flush_timer != NULL)
+    {
+        timer_wheel_destroy_timer(connection->flush_timer);
+        connection->flush_timer = NULL;
+    }
+}
+
 static ENDPOINT_INSTANCE* find_session_endpoint_by_outgoing_channel(CONNECTION_HANDLE connection, uint16_t outgoing_channel)
 {
     uint32_t i;
@@ -658,6 +1067,8 @@ static void connection_on_bytes_received(void* context, const unsigned char* buf
 {
     size_t i;
 
+    AMQP_STATISTICS_ADD(((CONNECTION_HANDLE)context)->statistics.bytes_received, size);
+
     for (i = 0; i < size; i++)
     {
         if (connection_byte_received((CONNECTION_HANDLE)context, buffer[i]) != 0)
@@ -747,6 +1158,9 @@ static void on_empty_amqp_frame_received(void* context, uint16_t channel)
     {
         LOG(AZ_LOG_TRACE, LOG_LINE, "<- Empty frame");
     }
+
+    AMQP_STATISTICS_INCREMENT(connection->statistics.frames_received);
+    AMQP_STATISTICS_INCREMENT(connection->statistics.empty_frames_received);
     if (tickcounter_get_current_ms(connection->tick_counter, &connection->last_frame_received_time) != 0)
     {
 		LogError("Cannot get tickcounter value");
@@ -759,6 +1173,8 @@ static void on_amqp_frame_received(void* context, uint16_t channel, AMQP_VALUE p
 
 	(void)channel;
 
+    AMQP_STATISTICS_INCREMENT(connection->statistics.frames_received);
+
     if (tickcounter_get_current_ms(connection->tick_counter, &connection->last_frame_received_time) != 0)
     {
 		LogError("Cannot get tickcounter value");
@@ -789,6 +1205,8 @@ static void on_amqp_frame_received(void* context, uint16_t channel, AMQP_VALUE p
 
                     if (is_open_type_by_descriptor(descriptor))
                     {
+                        COUNT_PERFORMATIVE(connection->statistics.performatives_received, AMQP_OPEN);
+
                         if (channel != 0)
                         {
 							/* Codes_SRS_CONNECTION_01_006: [The open frame can only be sent on channel 0.] */
@@ -817,6 +1235,7 @@ static void on_amqp_frame_received(void* context, uint16_t channel, AMQP_VALUE p
                             else
                             {
                                 (void)open_get_idle_time_out(open_handle, &connection->remote_idle_timeout);
+                                arm_idle_timers(connection);
                                 if ((open_get_max_frame_size(open_handle, &connection->remote_max_frame_size) != 0) ||
                                     /* Codes_SRS_CONNECTION_01_167: [Both peers MUST accept frames of up to 512 (MIN-MAX-FRAME-SIZE) octets.] */
                                     (connection->remote_max_frame_size < 512))
@@ -855,6 +1274,8 @@ static void on_amqp_frame_received(void* context, uint16_t channel, AMQP_VALUE p
                     }
                     else if (is_close_type_by_descriptor(descriptor))
                     {
+                        COUNT_PERFORMATIVE(connection->statistics.performatives_received, AMQP_CLOSE);
+
                         /* Codes_SRS_CONNECTION_01_012: [A close frame MAY be received on any channel up to the maximum channel number negotiated in open.] */
                         /* Codes_SRS_CONNECTION_01_242: [The connection module shall accept CLOSE frames even if they have extra payload bytes besides the Close performative.] */
 
@@ -916,6 +1337,7 @@ static void on_amqp_frame_received(void* context, uint16_t channel, AMQP_VALUE p
                     else
                     {
                         amqpvalue_get_ulong(descriptor, &performative_ulong);
+                        COUNT_PERFORMATIVE(connection->statistics.performatives_received, performative_ulong);
 
                         switch (performative_ulong)
                         {
@@ -1167,6 +1589,24 @@ CONNECTION_HANDLE connection_create2(XIO_HANDLE xio, const char* hostname, const
                                 result->is_underlying_io_open = 0;
                                 result->remote_max_frame_size = 512;
                                 result->is_trace_on = 0;
+                                result->is_flushing_coalesced_bytes = 0;
+                                result->is_idle_timeout_expired = 0;
+                                result->idle_timer = NULL;
+                                result->heartbeat_timer = NULL;
+                                result->flush_timer = NULL;
+                                result->is_in_dowork = 0;
+#ifndef UAMQP_NO_STATISTICS
+                                (void)memset(&result->statistics, 0, sizeof(result->statistics));
+#endif
+
+                                result->coalesce_buffer = NULL;
+                                result->coalesced_byte_count = 0;
+                                result->coalesced_completions = NULL;
+                                result->coalesced_completion_count = 0;
+                                result->coalesced_completion_capacity = 0;
+                                result->max_coalesced_bytes = 0;
+                                result->max_coalescing_delay = 0;
+                                result->first_coalesced_byte_time = 0;
 
                                 /* Mark that settings have not yet been set by the user */
                                 result->idle_timeout_specified = 0;
@@ -1223,10 +1663,23 @@ void connection_destroy(CONNECTION_HANDLE connection)
             (void)connection_close(connection, NULL, NULL);
         }
 
+        destroy_timers(connection);
         amqp_frame_codec_destroy(connection->amqp_frame_codec);
         frame_codec_destroy(connection->frame_codec);
         tickcounter_destroy(connection->tick_counter);
 
+        /* frames that were never handed to the io are cancelled */
+        indicate_send_complete(connection->coalesced_completions, connection->coalesced_completion_count, IO_SEND_CANCELLED);
+        if (connection->coalesced_completions != NULL)
+        {
+            free(connection->coalesced_completions);
+        }
+
+        if (connection->coalesce_buffer != NULL)
+        {
+            free(connection->coalesce_buffer);
+        }
+
         free(connection->host_name);
         free(connection->container_id);
 
@@ -1490,6 +1943,7 @@ int connection_set_idle_timeout(CONNECTION_HANDLE connection, milliseconds idle_
             /* Codes_SRS_CONNECTION_01_166: [If connection_set_idle_timeout fails, the previous idle_timeout setting shall be retained.] */
             connection->idle_timeout = idle_timeout;
             connection->idle_timeout_specified = true;
+            arm_idle_timers(connection);
 
             /* Codes_SRS_CONNECTION_01_160: [On success connection_set_idle_timeout shall return 0.] */
             result = 0;
@@ -1548,6 +2002,7 @@ uint64_t connection_handle_deadlines(CONNECTION_HANDLE connection)
 {
     uint64_t local_deadline = (uint64_t )-1;
     uint64_t remote_deadline = (uint64_t)-1;
+    uint64_t flush_deadline = (uint64_t)-1;
 
 	if (connection == NULL)
 	{
@@ -1564,7 +2019,15 @@ uint64_t connection_handle_deadlines(CONNECTION_HANDLE connection)
         }
         else
         {
-            if (connection->idle_timeout_specified && (connection->idle_timeout != 0))
+            if (connection->idle_timer != NULL)
+            {
+                /* idle and heartbeat are handled by the timer wheel, only report an expired idle timeout */
+                if (connection->is_idle_timeout_expired)
+                {
+                    local_deadline = 0;
+                }
+            }
+            else if (connection->idle_timeout_specified && (connection->idle_timeout != 0))
             {
                 /* Calculate time until configured idle timeout expires */
 
@@ -1582,7 +2045,7 @@ uint64_t connection_handle_deadlines(CONNECTION_HANDLE connection)
                 }
             }
 
-            if (local_deadline != 0 && connection->remote_idle_timeout != 0)
+            if ((connection->idle_timer == NULL) && (local_deadline != 0) && (connection->remote_idle_timeout != 0))
             {
                 /* Calculate time until remote idle timeout expires */
 
@@ -1593,31 +2056,52 @@ uint64_t connection_handle_deadlines(CONNECTION_HANDLE connection)
                 {
                     remote_deadline = remote_idle_timeout - time_since_last_sent;
                 }
-                else
+                else if (send_empty_frame(connection, current_ms) == 0)
                 {
-                    connection->on_send_complete = NULL;
-                    if (amqp_frame_codec_encode_empty_frame(connection->amqp_frame_codec, 0, on_bytes_encoded, connection) != 0)
+                    remote_deadline = remote_idle_timeout;
+                }
+            }
+
+            if ((local_deadline != 0) &&
+                (connection->coalesced_byte_count > 0))
+            {
+                if (connection->max_coalescing_delay == 0)
+                {
+                    /* connection_dowork sends them at its end, outside of it there is nothing to wait for */
+                    if ((!connection->is_in_dowork) &&
+                        (flush_coalesced_bytes(connection) != 0))
                     {
-						LogError("Encoding the empty frame failed");
-						/* close connection */
-						close_connection_with_error(connection, "amqp:internal-error", "Cannot send empty frame");
+                        LogError("Sending the coalesced bytes failed");
+                        close_connection_with_error(connection, "amqp:internal-error", "Cannot send coalesced bytes");
+                        local_deadline = 0;
                     }
-                    else
-                    {
-                        if (connection->is_trace_on == 1)
-                        {
-                            LOG(AZ_LOG_TRACE, LOG_LINE, "-> Empty frame");
-                        }
+                }
+                else
+                {
+                    /* Calculate time until the coalesced bytes have to be sent */
 
-                        connection->last_frame_sent_time = current_ms;
+                    uint64_t time_since_first_coalesced = current_ms - connection->first_coalesced_byte_time;
 
-                        remote_deadline = remote_idle_timeout;
+                    if (time_since_first_coalesced < connection->max_coalescing_delay)
+                    {
+                        flush_deadline = connection->max_coalescing_delay - time_since_first_coalesced;
+                    }
+                    else if (flush_coalesced_bytes(connection) != 0)
+                    {
+                        LogError("Sending the coalesced bytes failed");
+                        close_connection_with_error(connection, "amqp:internal-error", "Cannot send coalesced bytes");
+                        local_deadline = 0;
                     }
                 }
             }
         }
     }
 
+    if (flush_deadline < remote_deadline)
+    {
+        remote_deadline = flush_deadline;
+    }
+
     /* Return the shorter of each deadline, or 0 to indicate connection closed */
     return local_deadline > remote_deadline ? remote_deadline : local_deadline;
 }
@@ -1631,11 +2115,23 @@ void connection_dowork(CONNECTION_HANDLE connection)
 	}
 	else
 	{
+        connection->is_in_dowork = 1;
+
         if (connection_handle_deadlines(connection) > 0)
         {
             /* Codes_SRS_CONNECTION_01_076: [connection_dowork shall schedule the underlying IO interface to do its work by calling xio_dowork.] */
             xio_dowork(connection->io);
+
+            /* without a delay threshold everything encoded during this cycle goes out in one send */
+            if ((connection->max_coalescing_delay == 0) &&
+                (flush_coalesced_bytes(connection) != 0))
+            {
+                LogError("Sending the coalesced bytes failed");
+                close_connection_with_error(connection, "amqp:internal-error", "Cannot send coalesced bytes");
+            }
         }
+
+        connection->is_in_dowork = 0;
     }
 }
 
@@ -1853,6 +2349,9 @@ int connection_encode_frame(ENDPOINT_HANDLE endpoint, const AMQP_VALUE performat
                     log_outgoing_frame(performative);
                 }
 
+                AMQP_STATISTICS_INCREMENT(connection->statistics.frames_sent);
+                COUNT_OUTGOING_PERFORMATIVE(connection, performative);
+
                 if (tickcounter_get_current_ms(connection->tick_counter, &connection->last_frame_sent_time) != 0)
                 {
 					LogError("Getting tick counter value failed");
@@ -1870,6 +2369,170 @@ int connection_encode_frame(ENDPOINT_HANDLE endpoint, const AMQP_VALUE performat
     return result;
 }
 
+int connection_set_send_coalescing(CONNECTION_HANDLE connection, uint32_t max_coalesced_bytes, milliseconds max_coalescing_delay)
+{
+    int result;
+
+    if (connection == NULL)
+    {
+		LogError("NULL connection");
+		result = __FAILURE__;
+    }
+    else if (flush_coalesced_bytes(connection) != 0)
+    {
+		LogError("Cannot send the bytes coalesced so far");
+		result = __FAILURE__;
+    }
+    else
+    {
+        unsigned char* new_coalesce_buffer;
+
+        if (max_coalesced_bytes == 0)
+        {
+            new_coalesce_buffer = NULL;
+        }
+        else
+        {
+            new_coalesce_buffer = (unsigned char*)malloc(max_coalesced_bytes);
+        }
+
+        if ((max_coalesced_bytes > 0) && (new_coalesce_buffer == NULL))
+        {
+			LogError("Cannot allocate memory for the coalesce buffer");
+			result = __FAILURE__;
+        }
+        else
+        {
+            if (connection->coalesce_buffer != NULL)
+            {
+                free(connection->coalesce_buffer);
+            }
+
+            connection->coalesce_buffer = new_coalesce_buffer;
+            connection->max_coalesced_bytes = max_coalesced_bytes;
+            connection->max_coalescing_delay = max_coalescing_delay;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int connection_set_timer_wheel(CONNECTION_HANDLE connection, TIMER_WHEEL_HANDLE timer_wheel)
+{
+    int result;
+
+    if (connection == NULL)
+    {
+		LogError("NULL connection");
+		result = __FAILURE__;
+    }
+    else
+    {
+        destroy_timers(connection);
+
+        if (timer_wheel == NULL)
+        {
+            /* back to computing the deadlines in connection_handle_deadlines */
+            result = 0;
+        }
+        else
+        {
+            connection->idle_timer = timer_wheel_create_timer(timer_wheel, on_idle_timer_expired, connection);
+            if (connection->idle_timer == NULL)
+            {
+				LogError("Cannot create the idle timer");
+				result = __FAILURE__;
+            }
+            else
+            {
+                connection->heartbeat_timer = timer_wheel_create_timer(timer_wheel, on_heartbeat_timer_expired, connection);
+                if (connection->heartbeat_timer == NULL)
+                {
+					LogError("Cannot create the heartbeat timer");
+					destroy_timers(connection);
+					result = __FAILURE__;
+                }
+                else
+                {
+                    connection->flush_timer = timer_wheel_create_timer(timer_wheel, on_flush_timer_expired, connection);
+                    if (connection->flush_timer == NULL)
+                    {
+                        LogError("Cannot create the flush timer");
+                        destroy_timers(connection);
+                        result = __FAILURE__;
+                    }
+                    else
+                    {
+                        arm_idle_timers(connection);
+
+                        /* bytes coalesced before the wheel was attached are not waiting for a dowork any longer */
+                        if (connection->coalesced_byte_count > 0)
+                        {
+                            (void)timer_wheel_schedule_after(connection->flush_timer, connection->max_coalescing_delay);
+                        }
+
+                        result = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+int connection_set_frame_capture(CONNECTION_HANDLE connection, FRAME_CAPTURE_HANDLE frame_capture)
+{
+    int result;
+
+    if (connection == NULL)
+    {
+		LogError("NULL connection");
+		result = __FAILURE__;
+    }
+    else
+    {
+        /* frames are captured raw by the frame codec, a NULL frame_capture stops capturing */
+        if (frame_codec_set_capture(connection->frame_codec, frame_capture) != 0)
+        {
+			LogError("Cannot set the frame capture on the frame codec");
+			result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int connection_get_statistics(CONNECTION_HANDLE connection, CONNECTION_STATISTICS* statistics)
+{
+    int result;
+
+    if ((connection == NULL) ||
+        (statistics == NULL))
+    {
+		LogError("Bad arguments: connection = %p, statistics = %p",
+			connection, statistics);
+		result = __FAILURE__;
+    }
+    else
+    {
+#ifndef UAMQP_NO_STATISTICS
+        *statistics = connection->statistics;
+        result = 0;
+#else
+		LogError("Statistics are not compiled in");
+		result = __FAILURE__;
+#endif
+    }
+
+    return result;
+}
+
 void connection_set_trace(CONNECTION_HANDLE connection, bool trace_on)
 {
     /* Codes_SRS_CONNECTION_07_002: [If connection is NULL then connection_set_trace shall do nothing.] */
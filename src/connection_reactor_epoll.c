@@ -0,0 +1,545 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_uamqp_c/timer_wheel.h"
+#include "azure_uamqp_c/connection_reactor.h"
+
+#define MAX_EVENTS_PER_WAIT 256
+#define UNKNOWN_FD_POLL_INTERVAL_MS 10
+
+struct CONNECTION_REACTOR_INSTANCE_TAG;
+
+typedef struct REACTOR_CONNECTION_TAG
+{
+	struct CONNECTION_REACTOR_INSTANCE_TAG* reactor;
+	CONNECTION_HANDLE connection;
+	int fd;
+	TIMER_WHEEL_TIMER_HANDLE deadline_timer;
+	struct REACTOR_CONNECTION_TAG* next_ready;
+	unsigned int is_ready : 1;
+	unsigned int is_removed : 1;
+} REACTOR_CONNECTION;
+
+typedef struct CONNECTION_REACTOR_INSTANCE_TAG
+{
+	int epoll_fd;
+	/* registered with a NULL data pointer, written by connection_reactor_wake from any thread */
+	int wake_fd;
+	TICK_COUNTER_HANDLE tick_counter;
+	TIMER_WHEEL_HANDLE timer_wheel;
+	REACTOR_CONNECTION** connections;
+	size_t connection_count;
+	size_t connection_capacity;
+	/* connections that need a dowork, either readable/writable or with an expired deadline */
+	REACTOR_CONNECTION* first_ready;
+	struct epoll_event events[MAX_EVENTS_PER_WAIT];
+	unsigned int is_in_dowork : 1;
+	unsigned int has_removed_connections : 1;
+} CONNECTION_REACTOR_INSTANCE;
+
+static int get_current_ms(CONNECTION_REACTOR_INSTANCE* reactor, tickcounter_ms_t* current_ms)
+{
+	int result;
+
+	if (tickcounter_get_current_ms(reactor->tick_counter, current_ms) != 0)
+	{
+		LogError("Could not get tick counter value");
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
+static void mark_connection_ready(REACTOR_CONNECTION* reactor_connection)
+{
+	if ((!reactor_connection->is_ready) &&
+		(!reactor_connection->is_removed))
+	{
+		reactor_connection->is_ready = 1;
+		reactor_connection->next_ready = reactor_connection->reactor->first_ready;
+		reactor_connection->reactor->first_ready = reactor_connection;
+	}
+}
+
+static void on_deadline_timer_expired(void* context)
+{
+	mark_connection_ready((REACTOR_CONNECTION*)context);
+}
+
+static void free_removed_connections(CONNECTION_REACTOR_INSTANCE* reactor)
+{
+	REACTOR_CONNECTION** ready_link = &reactor->first_ready;
+	size_t i = 0;
+
+	while (*ready_link != NULL)
+	{
+		if ((*ready_link)->is_removed)
+		{
+			*ready_link = (*ready_link)->next_ready;
+		}
+		else
+		{
+			ready_link = &(*ready_link)->next_ready;
+		}
+	}
+
+	while (i < reactor->connection_count)
+	{
+		if (reactor->connections[i]->is_removed)
+		{
+			free(reactor->connections[i]);
+			reactor->connection_count--;
+			reactor->connections[i] = reactor->connections[reactor->connection_count];
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	reactor->has_removed_connections = 0;
+}
+
+CONNECTION_REACTOR_HANDLE connection_reactor_create(void)
+{
+	CONNECTION_REACTOR_INSTANCE* result = (CONNECTION_REACTOR_INSTANCE*)malloc(sizeof(CONNECTION_REACTOR_INSTANCE));
+	if (result == NULL)
+	{
+		LogError("Cannot allocate memory for the connection reactor");
+	}
+	else
+	{
+		result->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (result->epoll_fd == -1)
+		{
+			LogError("epoll_create1 failed, errno = %d", errno);
+			free(result);
+			result = NULL;
+		}
+		else
+		{
+			tickcounter_ms_t current_ms;
+			struct epoll_event event;
+
+			event.events = EPOLLIN;
+			event.data.ptr = NULL;
+
+			result->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (result->wake_fd == -1)
+			{
+				LogError("eventfd failed, errno = %d", errno);
+				(void)close(result->epoll_fd);
+				free(result);
+				result = NULL;
+			}
+			else if (epoll_ctl(result->epoll_fd, EPOLL_CTL_ADD, result->wake_fd, &event) != 0)
+			{
+				LogError("epoll_ctl failed adding the wake fd, errno = %d", errno);
+				(void)close(result->wake_fd);
+				(void)close(result->epoll_fd);
+				free(result);
+				result = NULL;
+			}
+			else if ((result->tick_counter = tickcounter_create()) == NULL)
+			{
+				LogError("Cannot create tick counter");
+				(void)close(result->wake_fd);
+				(void)close(result->epoll_fd);
+				free(result);
+				result = NULL;
+			}
+			else if (get_current_ms(result, &current_ms) != 0)
+			{
+				tickcounter_destroy(result->tick_counter);
+				(void)close(result->wake_fd);
+				(void)close(result->epoll_fd);
+				free(result);
+				result = NULL;
+			}
+			else
+			{
+				result->timer_wheel = timer_wheel_create(current_ms);
+				if (result->timer_wheel == NULL)
+				{
+					LogError("Cannot create the timer wheel");
+					tickcounter_destroy(result->tick_counter);
+					(void)close(result->wake_fd);
+					(void)close(result->epoll_fd);
+					free(result);
+					result = NULL;
+				}
+				else
+				{
+					result->connections = NULL;
+					result->connection_count = 0;
+					result->connection_capacity = 0;
+					result->first_ready = NULL;
+					result->is_in_dowork = 0;
+					result->has_removed_connections = 0;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+void connection_reactor_destroy(CONNECTION_REACTOR_HANDLE reactor)
+{
+	if (reactor == NULL)
+	{
+		LogError("NULL reactor");
+	}
+	else
+	{
+		size_t i;
+
+		/* the connections themselves are owned by the caller, they only get their deadlines back */
+		for (i = 0; i < reactor->connection_count; i++)
+		{
+			if (!reactor->connections[i]->is_removed)
+			{
+				(void)connection_set_timer_wheel(reactor->connections[i]->connection, NULL);
+				timer_wheel_destroy_timer(reactor->connections[i]->deadline_timer);
+			}
+
+			free(reactor->connections[i]);
+		}
+
+		if (reactor->connections != NULL)
+		{
+			free(reactor->connections);
+		}
+
+		timer_wheel_destroy(reactor->timer_wheel);
+		tickcounter_destroy(reactor->tick_counter);
+		(void)close(reactor->wake_fd);
+		(void)close(reactor->epoll_fd);
+		free(reactor);
+	}
+}
+
+int connection_reactor_add_connection(CONNECTION_REACTOR_HANDLE reactor, CONNECTION_HANDLE connection, int fd)
+{
+	int result;
+
+	if ((reactor == NULL) ||
+		(connection == NULL))
+	{
+		LogError("Bad arguments: reactor = %p, connection = %p",
+			reactor, connection);
+		result = __FAILURE__;
+	}
+	else
+	{
+		if (reactor->connection_count == reactor->connection_capacity)
+		{
+			size_t new_capacity = (reactor->connection_capacity == 0) ? 16 : reactor->connection_capacity * 2;
+			REACTOR_CONNECTION** new_connections = (REACTOR_CONNECTION**)realloc(reactor->connections, sizeof(REACTOR_CONNECTION*) * new_capacity);
+			if (new_connections != NULL)
+			{
+				reactor->connections = new_connections;
+				reactor->connection_capacity = new_capacity;
+			}
+		}
+
+		if (reactor->connection_count == reactor->connection_capacity)
+		{
+			LogError("Cannot grow the reactor connection array");
+			result = __FAILURE__;
+		}
+		else
+		{
+			REACTOR_CONNECTION* reactor_connection = (REACTOR_CONNECTION*)malloc(sizeof(REACTOR_CONNECTION));
+			if (reactor_connection == NULL)
+			{
+				LogError("Cannot allocate memory for the reactor connection");
+				result = __FAILURE__;
+			}
+			else
+			{
+				reactor_connection->reactor = reactor;
+				reactor_connection->connection = connection;
+				reactor_connection->fd = fd;
+				reactor_connection->next_ready = NULL;
+				reactor_connection->is_ready = 0;
+				reactor_connection->is_removed = 0;
+
+				reactor_connection->deadline_timer = timer_wheel_create_timer(reactor->timer_wheel, on_deadline_timer_expired, reactor_connection);
+				if (reactor_connection->deadline_timer == NULL)
+				{
+					LogError("Cannot create the deadline timer");
+					free(reactor_connection);
+					result = __FAILURE__;
+				}
+				else if (connection_set_timer_wheel(connection, reactor->timer_wheel) != 0)
+				{
+					LogError("Cannot attach the timer wheel to the connection");
+					timer_wheel_destroy_timer(reactor_connection->deadline_timer);
+					free(reactor_connection);
+					result = __FAILURE__;
+				}
+				else
+				{
+					if (fd != -1)
+					{
+						struct epoll_event event;
+
+						/* edge triggered: socketio drains the socket and its pending sends on each dowork */
+						event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+						event.data.ptr = reactor_connection;
+						if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+						{
+							LogError("epoll_ctl failed adding fd %d, errno = %d", fd, errno);
+							(void)connection_set_timer_wheel(connection, NULL);
+							timer_wheel_destroy_timer(reactor_connection->deadline_timer);
+							free(reactor_connection);
+							reactor_connection = NULL;
+						}
+					}
+
+					if (reactor_connection == NULL)
+					{
+						result = __FAILURE__;
+					}
+					else
+					{
+						reactor->connections[reactor->connection_count++] = reactor_connection;
+
+						/* the first dowork opens the io, so it is due right away */
+						mark_connection_ready(reactor_connection);
+						result = 0;
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+int connection_reactor_remove_connection(CONNECTION_REACTOR_HANDLE reactor, CONNECTION_HANDLE connection)
+{
+	int result;
+
+	if ((reactor == NULL) ||
+		(connection == NULL))
+	{
+		LogError("Bad arguments: reactor = %p, connection = %p",
+			reactor, connection);
+		result = __FAILURE__;
+	}
+	else
+	{
+		size_t i;
+
+		for (i = 0; i < reactor->connection_count; i++)
+		{
+			if ((reactor->connections[i]->connection == connection) &&
+				(!reactor->connections[i]->is_removed))
+			{
+				break;
+			}
+		}
+
+		if (i == reactor->connection_count)
+		{
+			LogError("Connection %p is not in the reactor", connection);
+			result = __FAILURE__;
+		}
+		else
+		{
+			REACTOR_CONNECTION* reactor_connection = reactor->connections[i];
+
+			if ((reactor_connection->fd != -1) &&
+				(epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, reactor_connection->fd, NULL) != 0))
+			{
+				/* the fd may already be closed by the io, which removes it from the epoll set anyway */
+				LogInfo("epoll_ctl failed removing fd %d, errno = %d", reactor_connection->fd, errno);
+			}
+
+			(void)connection_set_timer_wheel(connection, NULL);
+			timer_wheel_destroy_timer(reactor_connection->deadline_timer);
+			reactor_connection->deadline_timer = NULL;
+
+			/* events already fetched by a running dowork may still point at this entry */
+			reactor_connection->is_removed = 1;
+			reactor->has_removed_connections = 1;
+			if (!reactor->is_in_dowork)
+			{
+				free_removed_connections(reactor);
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+int connection_reactor_dowork(CONNECTION_REACTOR_HANDLE reactor, uint32_t max_wait_ms)
+{
+	int result;
+
+	if (reactor == NULL)
+	{
+		LogError("NULL reactor");
+		result = __FAILURE__;
+	}
+	else
+	{
+		tickcounter_ms_t current_ms;
+
+		if (get_current_ms(reactor, &current_ms) != 0)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			uint64_t wait_ms = max_wait_ms;
+			int event_count;
+
+			if (reactor->first_ready != NULL)
+			{
+				wait_ms = 0;
+			}
+			else
+			{
+				uint64_t time_to_next_expiry = timer_wheel_get_time_to_next_expiry(reactor->timer_wheel, current_ms);
+				if (time_to_next_expiry < wait_ms)
+				{
+					wait_ms = time_to_next_expiry;
+				}
+			}
+
+			event_count = epoll_wait(reactor->epoll_fd, reactor->events, MAX_EVENTS_PER_WAIT, (int)wait_ms);
+			if ((event_count < 0) && (errno != EINTR))
+			{
+				LogError("epoll_wait failed, errno = %d", errno);
+				result = __FAILURE__;
+			}
+			else if (get_current_ms(reactor, &current_ms) != 0)
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				REACTOR_CONNECTION* reactor_connection;
+				int i;
+
+				reactor->is_in_dowork = 1;
+
+				for (i = 0; i < event_count; i++)
+				{
+					if (reactor->events[i].data.ptr == NULL)
+					{
+						uint64_t wake_count;
+
+						/* only resets the eventfd, the wake itself just ends the wait */
+						(void)read(reactor->wake_fd, &wake_count, sizeof(wake_count));
+					}
+					else
+					{
+						mark_connection_ready((REACTOR_CONNECTION*)reactor->events[i].data.ptr);
+					}
+				}
+
+				/* fires the idle/heartbeat timers of the connections and marks the ones with an expired deadline */
+				(void)timer_wheel_advance(reactor->timer_wheel, current_ms);
+
+				/* connections marked from callbacks get their dowork on the next call */
+				reactor_connection = reactor->first_ready;
+				reactor->first_ready = NULL;
+
+				while (reactor_connection != NULL)
+				{
+					REACTOR_CONNECTION* next_ready = reactor_connection->next_ready;
+
+					reactor_connection->is_ready = 0;
+					if (!reactor_connection->is_removed)
+					{
+						connection_dowork(reactor_connection->connection);
+					}
+
+					if (!reactor_connection->is_removed)
+					{
+						/* 0 means the connection is closed, only readiness wakes it up from now on */
+						uint64_t time_to_deadline = connection_handle_deadlines(reactor_connection->connection);
+
+						/* without a socket to watch the connection has to be polled */
+						if ((reactor_connection->fd == -1) &&
+							((time_to_deadline == 0) || (time_to_deadline > UNKNOWN_FD_POLL_INTERVAL_MS)))
+						{
+							time_to_deadline = UNKNOWN_FD_POLL_INTERVAL_MS;
+						}
+
+						if ((time_to_deadline == 0) ||
+							(time_to_deadline == (uint64_t)-1))
+						{
+							timer_wheel_cancel(reactor_connection->deadline_timer);
+						}
+						else
+						{
+							(void)timer_wheel_schedule(reactor_connection->deadline_timer, current_ms + time_to_deadline);
+						}
+					}
+
+					reactor_connection = next_ready;
+				}
+
+				reactor->is_in_dowork = 0;
+				if (reactor->has_removed_connections)
+				{
+					free_removed_connections(reactor);
+				}
+
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+int connection_reactor_wake(CONNECTION_REACTOR_HANDLE reactor)
+{
+	int result;
+
+	if (reactor == NULL)
+	{
+		LogError("NULL reactor");
+		result = __FAILURE__;
+	}
+	else
+	{
+		uint64_t wake_count = 1;
+
+		/* EAGAIN means the counter is saturated, the reactor is woken up anyway */
+		if ((write(reactor->wake_fd, &wake_count, sizeof(wake_count)) != (ssize_t)sizeof(wake_count)) &&
+			(errno != EAGAIN))
+		{
+			LogError("Cannot write to the wake fd, errno = %d", errno);
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
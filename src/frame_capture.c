@@ -0,0 +1,445 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_uamqp_c/frame_capture.h"
+
+#define FRAME_PREFIX_SIZE 6
+#define RECORD_HEADER_SIZE 16
+#define CAPTURE_VERSION 1
+
+static const unsigned char capture_magic[] = { 'U', 'A', 'M', 'Q', 'P', 'C', 'A', 'P' };
+
+typedef struct FRAME_CAPTURE_INSTANCE_TAG
+{
+	TICK_COUNTER_HANDLE tick_counter;
+
+	/* file capture */
+	FILE* file;
+
+	/* ring capture, whole records are dropped from the oldest end to make room */
+	unsigned char* ring;
+	size_t ring_capacity;
+	size_t ring_oldest;
+	size_t ring_used;
+} FRAME_CAPTURE_INSTANCE;
+
+static void encode_uint32(unsigned char* bytes, uint32_t value)
+{
+	bytes[0] = (unsigned char)(value >> 24);
+	bytes[1] = (unsigned char)(value >> 16);
+	bytes[2] = (unsigned char)(value >> 8);
+	bytes[3] = (unsigned char)value;
+}
+
+static uint32_t decode_uint32(const unsigned char* bytes)
+{
+	return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static int write_file_header(FILE* file)
+{
+	int result;
+	unsigned char version[4];
+
+	encode_uint32(version, CAPTURE_VERSION);
+	if ((fwrite(capture_magic, sizeof(capture_magic), 1, file) != 1) ||
+		(fwrite(version, sizeof(version), 1, file) != 1))
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
+static void ring_write(FRAME_CAPTURE_INSTANCE* frame_capture, size_t position, const unsigned char* bytes, size_t length)
+{
+	size_t first_part = frame_capture->ring_capacity - position;
+
+	if (first_part >= length)
+	{
+		(void)memcpy(frame_capture->ring + position, bytes, length);
+	}
+	else
+	{
+		(void)memcpy(frame_capture->ring + position, bytes, first_part);
+		(void)memcpy(frame_capture->ring, bytes + first_part, length - first_part);
+	}
+}
+
+static void ring_read(FRAME_CAPTURE_INSTANCE* frame_capture, size_t position, unsigned char* bytes, size_t length)
+{
+	size_t first_part = frame_capture->ring_capacity - position;
+
+	if (first_part >= length)
+	{
+		(void)memcpy(bytes, frame_capture->ring + position, length);
+	}
+	else
+	{
+		(void)memcpy(bytes, frame_capture->ring + position, first_part);
+		(void)memcpy(bytes + first_part, frame_capture->ring, length - first_part);
+	}
+}
+
+static void ring_add_record(FRAME_CAPTURE_INSTANCE* frame_capture, const unsigned char* record_header, const unsigned char* frame_prefix, const unsigned char* frame_bytes, uint32_t frame_size)
+{
+	size_t record_size = RECORD_HEADER_SIZE + (size_t)frame_size;
+	size_t position;
+
+	while (frame_capture->ring_capacity - frame_capture->ring_used < record_size)
+	{
+		unsigned char oldest_header[RECORD_HEADER_SIZE];
+		size_t oldest_size;
+
+		ring_read(frame_capture, frame_capture->ring_oldest, oldest_header, sizeof(oldest_header));
+		oldest_size = RECORD_HEADER_SIZE + decode_uint32(oldest_header + 12);
+		frame_capture->ring_oldest = (frame_capture->ring_oldest + oldest_size) % frame_capture->ring_capacity;
+		frame_capture->ring_used -= oldest_size;
+	}
+
+	position = (frame_capture->ring_oldest + frame_capture->ring_used) % frame_capture->ring_capacity;
+	ring_write(frame_capture, position, record_header, RECORD_HEADER_SIZE);
+	position = (position + RECORD_HEADER_SIZE) % frame_capture->ring_capacity;
+	ring_write(frame_capture, position, frame_prefix, FRAME_PREFIX_SIZE);
+	position = (position + FRAME_PREFIX_SIZE) % frame_capture->ring_capacity;
+	ring_write(frame_capture, position, frame_bytes, frame_size - FRAME_PREFIX_SIZE);
+	frame_capture->ring_used += record_size;
+}
+
+static FRAME_CAPTURE_INSTANCE* create_frame_capture(void)
+{
+	FRAME_CAPTURE_INSTANCE* result = (FRAME_CAPTURE_INSTANCE*)malloc(sizeof(FRAME_CAPTURE_INSTANCE));
+	if (result == NULL)
+	{
+		LogError("Cannot allocate memory for the frame capture");
+	}
+	else
+	{
+		result->tick_counter = tickcounter_create();
+		if (result->tick_counter == NULL)
+		{
+			LogError("Cannot create tick counter");
+			free(result);
+			result = NULL;
+		}
+		else
+		{
+			result->file = NULL;
+			result->ring = NULL;
+			result->ring_capacity = 0;
+			result->ring_oldest = 0;
+			result->ring_used = 0;
+		}
+	}
+
+	return result;
+}
+
+FRAME_CAPTURE_HANDLE frame_capture_create_file(const char* file_name)
+{
+	FRAME_CAPTURE_INSTANCE* result;
+
+	if (file_name == NULL)
+	{
+		LogError("NULL file_name");
+		result = NULL;
+	}
+	else
+	{
+		result = create_frame_capture();
+		if (result != NULL)
+		{
+			result->file = fopen(file_name, "wb");
+			if (result->file == NULL)
+			{
+				LogError("Cannot open capture file %s", file_name);
+				tickcounter_destroy(result->tick_counter);
+				free(result);
+				result = NULL;
+			}
+			else if (write_file_header(result->file) != 0)
+			{
+				LogError("Cannot write capture file header");
+				(void)fclose(result->file);
+				tickcounter_destroy(result->tick_counter);
+				free(result);
+				result = NULL;
+			}
+		}
+	}
+
+	return result;
+}
+
+FRAME_CAPTURE_HANDLE frame_capture_create_ring(size_t capacity)
+{
+	FRAME_CAPTURE_INSTANCE* result;
+
+	if (capacity < RECORD_HEADER_SIZE + 8)
+	{
+		LogError("Ring capacity %u is too small for a single frame", (unsigned int)capacity);
+		result = NULL;
+	}
+	else
+	{
+		result = create_frame_capture();
+		if (result != NULL)
+		{
+			result->ring = (unsigned char*)malloc(capacity);
+			if (result->ring == NULL)
+			{
+				LogError("Cannot allocate memory for the capture ring");
+				tickcounter_destroy(result->tick_counter);
+				free(result);
+				result = NULL;
+			}
+			else
+			{
+				result->ring_capacity = capacity;
+			}
+		}
+	}
+
+	return result;
+}
+
+void frame_capture_destroy(FRAME_CAPTURE_HANDLE frame_capture)
+{
+	if (frame_capture == NULL)
+	{
+		LogError("NULL frame_capture");
+	}
+	else
+	{
+		if ((frame_capture->file != NULL) &&
+			(fclose(frame_capture->file) != 0))
+		{
+			LogError("Cannot close the capture file");
+		}
+
+		if (frame_capture->ring != NULL)
+		{
+			free(frame_capture->ring);
+		}
+
+		tickcounter_destroy(frame_capture->tick_counter);
+		free(frame_capture);
+	}
+}
+
+int frame_capture_add_frame(FRAME_CAPTURE_HANDLE frame_capture, FRAME_CAPTURE_DIRECTION direction, const unsigned char* frame_prefix, const unsigned char* frame_bytes, uint32_t frame_size)
+{
+	int result;
+
+	if ((frame_capture == NULL) ||
+		(frame_prefix == NULL) ||
+		(frame_size < FRAME_PREFIX_SIZE + 2) ||
+		(frame_bytes == NULL))
+	{
+		LogError("Bad arguments: frame_capture = %p, frame_prefix = %p, frame_bytes = %p, frame_size = %u",
+			frame_capture, frame_prefix, frame_bytes, (unsigned int)frame_size);
+		result = __FAILURE__;
+	}
+	else
+	{
+		unsigned char record_header[RECORD_HEADER_SIZE];
+		tickcounter_ms_t current_ms;
+
+		if (tickcounter_get_current_ms(frame_capture->tick_counter, &current_ms) != 0)
+		{
+			current_ms = 0;
+		}
+
+		encode_uint32(record_header, (uint32_t)((uint64_t)current_ms >> 32));
+		encode_uint32(record_header + 4, (uint32_t)current_ms);
+		record_header[8] = (unsigned char)direction;
+		/* the type byte comes from the frame header, the channel is the start of its type specific bytes */
+		record_header[9] = frame_prefix[5];
+		record_header[10] = frame_bytes[0];
+		record_header[11] = frame_bytes[1];
+		encode_uint32(record_header + 12, frame_size);
+
+		if (frame_capture->file != NULL)
+		{
+			if ((fwrite(record_header, sizeof(record_header), 1, frame_capture->file) != 1) ||
+				(fwrite(frame_prefix, FRAME_PREFIX_SIZE, 1, frame_capture->file) != 1) ||
+				(fwrite(frame_bytes, frame_size - FRAME_PREFIX_SIZE, 1, frame_capture->file) != 1))
+			{
+				LogError("Cannot write frame to the capture file");
+				result = __FAILURE__;
+			}
+			else
+			{
+				result = 0;
+			}
+		}
+		else if (RECORD_HEADER_SIZE + (size_t)frame_size > frame_capture->ring_capacity)
+		{
+			LogError("Frame of %u bytes does not fit in the capture ring", (unsigned int)frame_size);
+			result = __FAILURE__;
+		}
+		else
+		{
+			ring_add_record(frame_capture, record_header, frame_prefix, frame_bytes, frame_size);
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+int frame_capture_save(FRAME_CAPTURE_HANDLE frame_capture, const char* file_name)
+{
+	int result;
+
+	if ((frame_capture == NULL) ||
+		(file_name == NULL))
+	{
+		LogError("Bad arguments: frame_capture = %p, file_name = %p",
+			frame_capture, file_name);
+		result = __FAILURE__;
+	}
+	else if (frame_capture->ring == NULL)
+	{
+		LogError("Only a ring capture can be saved");
+		result = __FAILURE__;
+	}
+	else
+	{
+		FILE* file = fopen(file_name, "wb");
+		if (file == NULL)
+		{
+			LogError("Cannot open capture file %s", file_name);
+			result = __FAILURE__;
+		}
+		else
+		{
+			size_t first_part = frame_capture->ring_capacity - frame_capture->ring_oldest;
+			if (first_part > frame_capture->ring_used)
+			{
+				first_part = frame_capture->ring_used;
+			}
+
+			if ((write_file_header(file) != 0) ||
+				((first_part > 0) && (fwrite(frame_capture->ring + frame_capture->ring_oldest, first_part, 1, file) != 1)) ||
+				((frame_capture->ring_used > first_part) && (fwrite(frame_capture->ring, frame_capture->ring_used - first_part, 1, file) != 1)))
+			{
+				LogError("Cannot write capture file %s", file_name);
+				result = __FAILURE__;
+			}
+			else
+			{
+				result = 0;
+			}
+
+			if (fclose(file) != 0)
+			{
+				LogError("Cannot close capture file %s", file_name);
+				result = __FAILURE__;
+			}
+		}
+	}
+
+	return result;
+}
+
+int frame_capture_read_file(const char* file_name, ON_FRAME_CAPTURE_RECORD on_frame_capture_record, void* context)
+{
+	int result;
+
+	if ((file_name == NULL) ||
+		(on_frame_capture_record == NULL))
+	{
+		LogError("Bad arguments: file_name = %p, on_frame_capture_record = %p",
+			file_name, on_frame_capture_record);
+		result = __FAILURE__;
+	}
+	else
+	{
+		FILE* file = fopen(file_name, "rb");
+		if (file == NULL)
+		{
+			LogError("Cannot open capture file %s", file_name);
+			result = __FAILURE__;
+		}
+		else
+		{
+			unsigned char file_header[sizeof(capture_magic) + 4];
+
+			if ((fread(file_header, sizeof(file_header), 1, file) != 1) ||
+				(memcmp(file_header, capture_magic, sizeof(capture_magic)) != 0) ||
+				(decode_uint32(file_header + sizeof(capture_magic)) != CAPTURE_VERSION))
+			{
+				LogError("%s is not a frame capture", file_name);
+				result = __FAILURE__;
+			}
+			else
+			{
+				unsigned char* frame_buffer = NULL;
+				uint32_t frame_buffer_size = 0;
+				unsigned char record_header[RECORD_HEADER_SIZE];
+
+				result = 0;
+
+				/* the buffer is reused across records, it only ever grows to the largest frame */
+				while (fread(record_header, sizeof(record_header), 1, file) == 1)
+				{
+					FRAME_CAPTURE_RECORD record;
+
+					record.timestamp_ms = ((uint64_t)decode_uint32(record_header) << 32) | decode_uint32(record_header + 4);
+					record.direction = (record_header[8] == FRAME_CAPTURE_DIRECTION_OUTBOUND) ? FRAME_CAPTURE_DIRECTION_OUTBOUND : FRAME_CAPTURE_DIRECTION_INBOUND;
+					record.frame_type = record_header[9];
+					record.channel = (uint16_t)((record_header[10] << 8) | record_header[11]);
+					record.frame_size = decode_uint32(record_header + 12);
+
+					if (record.frame_size > frame_buffer_size)
+					{
+						unsigned char* new_frame_buffer = (unsigned char*)realloc(frame_buffer, record.frame_size);
+						if (new_frame_buffer == NULL)
+						{
+							LogError("Cannot allocate memory for a frame of %u bytes", (unsigned int)record.frame_size);
+							result = __FAILURE__;
+							break;
+						}
+
+						frame_buffer = new_frame_buffer;
+						frame_buffer_size = record.frame_size;
+					}
+
+					if (fread(frame_buffer, record.frame_size, 1, file) != 1)
+					{
+						LogError("Truncated record in capture file %s", file_name);
+						result = __FAILURE__;
+						break;
+					}
+
+					record.frame_bytes = frame_buffer;
+					if (on_frame_capture_record(context, &record) != 0)
+					{
+						break;
+					}
+				}
+
+				if (frame_buffer != NULL)
+				{
+					free(frame_buffer);
+				}
+			}
+
+			(void)fclose(file);
+		}
+	}
+
+	return result;
+}
@@ -50,6 +50,9 @@ typedef struct FRAME_CODEC_INSTANCE_TAG
 	ON_FRAME_CODEC_ERROR on_frame_codec_error;
 	void* on_frame_codec_error_callback_context;
 
+	/* optional raw frame capture, only frames of subscribed types are captured on receive */
+	FRAME_CAPTURE_HANDLE frame_capture;
+
 	/* configuration */
 	uint32_t max_frame_size;
 } FRAME_CODEC_INSTANCE;
@@ -72,6 +75,24 @@ static bool find_subscription_by_frame_type(LIST_ITEM_HANDLE list_item, const vo
 	return result;
 }
 
+static void capture_received_frame(FRAME_CODEC_INSTANCE* frame_codec_data)
+{
+	/* the size, doff and type bytes were consumed by the decoder, the rest of the frame is in receive_frame_bytes */
+	unsigned char frame_prefix[6];
+
+	frame_prefix[0] = (frame_codec_data->receive_frame_size >> 24) & 0xFF;
+	frame_prefix[1] = (frame_codec_data->receive_frame_size >> 16) & 0xFF;
+	frame_prefix[2] = (frame_codec_data->receive_frame_size >> 8) & 0xFF;
+	frame_prefix[3] = frame_codec_data->receive_frame_size & 0xFF;
+	frame_prefix[4] = frame_codec_data->receive_frame_doff;
+	frame_prefix[5] = frame_codec_data->receive_frame_type;
+
+	if (frame_capture_add_frame(frame_codec_data->frame_capture, FRAME_CAPTURE_DIRECTION_INBOUND, frame_prefix, frame_codec_data->receive_frame_bytes, frame_codec_data->receive_frame_size) != 0)
+	{
+		LogError("Cannot capture received frame");
+	}
+}
+
 FRAME_CODEC_HANDLE frame_codec_create(ON_FRAME_CODEC_ERROR on_frame_codec_error, void* callback_context)
 {
 	FRAME_CODEC_INSTANCE* result;
@@ -100,6 +121,7 @@ FRAME_CODEC_HANDLE frame_codec_create(ON_FRAME_CODEC_ERROR on_frame_codec_error,
 			result->receive_frame_pos = 0;
 			result->receive_frame_size = 0;
 			result->receive_frame_bytes = NULL;
+			result->frame_capture = NULL;
 			result->subscription_list = singlylinkedlist_create();
 
 			/* Codes_SRS_FRAME_CODEC_01_082: [The initial max_frame_size_shall be 512.] */
@@ -355,6 +377,11 @@ int frame_codec_receive_bytes(FRAME_CODEC_HANDLE frame_codec, const unsigned cha
 					{
 						if (frame_codec_data->receive_frame_subscription != NULL)
 						{
+							if (frame_codec_data->frame_capture != NULL)
+							{
+								capture_received_frame(frame_codec_data);
+							}
+
 							/* Codes_SRS_FRAME_CODEC_01_031: [When a complete frame is successfully decoded it shall be indicated to the upper layer by invoking the on_frame_received passed to frame_codec_subscribe.] */
 							/* Codes_SRS_FRAME_CODEC_01_032: [Besides passing the frame information, the callback_context value passed to frame_codec_data_subscribe shall be passed to the on_frame_received function.] */
 							/* Codes_SRS_FRAME_CODEC_01_005: [This is an extension point defined for future expansion.] */
@@ -400,6 +427,11 @@ int frame_codec_receive_bytes(FRAME_CODEC_HANDLE frame_codec, const unsigned cha
 				{
 					if (frame_codec_data->receive_frame_subscription != NULL)
 					{
+						if (frame_codec_data->frame_capture != NULL)
+						{
+							capture_received_frame(frame_codec_data);
+						}
+
 						/* Codes_SRS_FRAME_CODEC_01_031: [When a complete frame is successfully decoded it shall be indicated to the upper layer by invoking the on_frame_received passed to frame_codec_subscribe.] */
 						/* Codes_SRS_FRAME_CODEC_01_032: [Besides passing the frame information, the callback_context value passed to frame_codec_data_subscribe shall be passed to the on_frame_received function.] */
 						/* Codes_SRS_FRAME_CODEC_01_005: [This is an extension point defined for future expansion.] */
@@ -678,6 +710,12 @@ int frame_codec_encode_frame(FRAME_CODEC_HANDLE frame_codec, uint8_t type, const
                         current_pos += payloads[i].length;
                     }
 
+                    if ((frame_codec_data->frame_capture != NULL) &&
+                        (frame_capture_add_frame(frame_codec_data->frame_capture, FRAME_CAPTURE_DIRECTION_OUTBOUND, encoded_frame, encoded_frame + sizeof(frame_header), (uint32_t)frame_size) != 0))
+                    {
+                        LogError("Cannot capture encoded frame");
+                    }
+
                     /* Codes_SRS_FRAME_CODEC_01_088: [Encoded bytes shall be passed to the `on_bytes_encoded` callback in a single call, while setting the `encode complete` argument to true.] */
                     on_bytes_encoded(callback_context, encoded_frame, frame_size, true);
 
@@ -692,3 +730,22 @@ int frame_codec_encode_frame(FRAME_CODEC_HANDLE frame_codec, uint8_t type, const
 
 	return result;
 }
+
+int frame_codec_set_capture(FRAME_CODEC_HANDLE frame_codec, FRAME_CAPTURE_HANDLE frame_capture)
+{
+	int result;
+
+	if (frame_codec == NULL)
+	{
+		LogError("NULL frame_codec");
+		result = __FAILURE__;
+	}
+	else
+	{
+		/* a NULL frame_capture stops capturing */
+		frame_codec->frame_capture = frame_capture;
+		result = 0;
+	}
+
+	return result;
+}
@@ -13,16 +13,21 @@
 #include "azure_uamqp_c/amqp_frame_codec.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
 
 #define DEFAULT_LINK_CREDIT 10000
+#define DEFAULT_LINK_CREDIT_REFILL_THRESHOLD (DEFAULT_LINK_CREDIT / 2)
+#define MIN_PENDING_DELIVERY_CAPACITY 16
+/* larger credit windows are not preallocated, the ring grows once they are actually used */
+#define MAX_PREALLOCATED_PENDING_DELIVERIES 65536
 
+/* a slot of the pending delivery ring */
 typedef struct DELIVERY_INSTANCE_TAG
 {
-	delivery_number delivery_id;
 	ON_DELIVERY_SETTLED on_delivery_settled;
 	void* callback_context;
-	void* link;
+	delivery_number delivery_id;
+	bool is_pending;
 } DELIVERY_INSTANCE;
 
 typedef struct LINK_INSTANCE_TAG
@@ -35,7 +40,21 @@ typedef struct LINK_INSTANCE_TAG
 	handle handle;
 	LINK_ENDPOINT_HANDLE link_endpoint;
 	char* name;
-	SINGLYLINKEDLIST_HANDLE pending_deliveries;
+	/* Sent deliveries waiting for a disposition (or, when sending settled, for their send to complete), in a ring in
+	   the order of the link's delivery count: the nth one after the first pending delivery is in slot
+	   (first_pending_slot + n) % capacity. Delivery ids are session wide, so deliveries of other links on the session
+	   would leave holes in a ring indexed by them; instead each slot keeps its id, and as the ids grow with the position
+	   a disposition's first..last range is found by a binary search. */
+	DELIVERY_INSTANCE* pending_deliveries;
+	uint32_t pending_delivery_capacity;
+	uint32_t first_pending_slot;
+	/* slots from the first pending delivery to the last one, settled ones included */
+	uint32_t pending_delivery_span;
+	/* a settled send that completed from inside session_send_transfer, before the delivery had a slot */
+	bool is_transfer_in_progress;
+	bool is_transfer_send_complete;
+	/* a delivery sent a frame at a time, see link_transfer_frame */
+	bool is_sending_multi_frame_delivery;
 	sequence_no delivery_count;
 	role role;
 	ON_LINK_STATE_CHANGED on_link_state_changed;
@@ -48,13 +67,38 @@ typedef struct LINK_INSTANCE_TAG
 	uint64_t max_message_size;
 	uint64_t peer_max_message_size;
 	uint32_t link_credit;
+	/* receiver credit policy, see link_set_credit_policy */
+	uint32_t prefetch_count;
+	uint32_t credit_refill_threshold;
+	uint64_t max_prefetched_bytes;
+	/* moving average of the size of the deliveries received, for the byte budget */
+	uint32_t average_delivery_size;
 	uint32_t available;
     fields attach_properties;
     bool is_underlying_session_begun;
     bool is_closed;
+    /* chunks of a multi frame delivery, reassembled in a buffer grown geometrically */
     unsigned char* received_payload;
     uint32_t received_payload_size;
+    uint32_t received_payload_capacity;
+    bool is_receiving_multi_frame_delivery;
+    /* streaming receive, see link_set_on_transfer_chunk_received */
+    ON_TRANSFER_CHUNK_RECEIVED on_transfer_chunk_received;
+    uint64_t streamed_payload_size;
     delivery_number received_delivery_id;
+
+    /* disposition batching, disabled when max_disposition_batch_count is 0 or 1 */
+    uint32_t max_disposition_batch_count;
+    milliseconds max_disposition_delay;
+    TICK_COUNTER_HANDLE disposition_tick_counter;
+    AMQP_VALUE batched_delivery_state;
+    delivery_number batched_first;
+    delivery_number batched_last;
+    uint32_t batched_count;
+    tickcounter_ms_t batch_start_time;
+#ifndef UAMQP_NO_STATISTICS
+    LINK_STATISTICS statistics;
+#endif
 } LINK_INSTANCE;
 
 static void set_link_state(LINK_INSTANCE* link_instance, LINK_STATE link_state)
@@ -68,30 +112,183 @@ static void set_link_state(LINK_INSTANCE* link_instance, LINK_STATE link_state)
 	}
 }
 
+static DELIVERY_INSTANCE* get_pending_delivery(LINK_INSTANCE* link, uint32_t offset)
+{
+	return &link->pending_deliveries[(link->first_pending_slot + offset) % link->pending_delivery_capacity];
+}
+
+static int ensure_pending_delivery_capacity(LINK_INSTANCE* link, uint32_t capacity)
+{
+	int result;
+
+	if (capacity <= link->pending_delivery_capacity)
+	{
+		result = 0;
+	}
+	else
+	{
+		uint32_t new_capacity = (link->pending_delivery_capacity == 0) ? MIN_PENDING_DELIVERY_CAPACITY : link->pending_delivery_capacity;
+		DELIVERY_INSTANCE* new_pending_deliveries;
+
+		while ((new_capacity < capacity) &&
+			(new_capacity <= UINT32_MAX / 2))
+		{
+			new_capacity *= 2;
+		}
+
+		new_pending_deliveries = (new_capacity < capacity) ? NULL : (DELIVERY_INSTANCE*)calloc(new_capacity, sizeof(DELIVERY_INSTANCE));
+		if (new_pending_deliveries == NULL)
+		{
+			LogError("Cannot allocate memory for %u pending deliveries", (unsigned int)capacity);
+			result = __FAILURE__;
+		}
+		else
+		{
+			uint32_t i;
+
+			/* unwrapped, the first pending delivery goes to slot 0 */
+			for (i = 0; i < link->pending_delivery_span; i++)
+			{
+				new_pending_deliveries[i] = *get_pending_delivery(link, i);
+			}
+
+			free(link->pending_deliveries);
+			link->pending_deliveries = new_pending_deliveries;
+			link->pending_delivery_capacity = new_capacity;
+			link->first_pending_slot = 0;
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+/* the link's deliveries are added in the order it sent them, which is the order of their delivery ids */
+static int add_pending_delivery(LINK_INSTANCE* link, delivery_number delivery_id, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+{
+	int result;
+
+	if (ensure_pending_delivery_capacity(link, link->pending_delivery_span + 1) != 0)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		DELIVERY_INSTANCE* delivery_instance = get_pending_delivery(link, link->pending_delivery_span);
+		delivery_instance->on_delivery_settled = on_delivery_settled;
+		delivery_instance->callback_context = callback_context;
+		delivery_instance->delivery_id = delivery_id;
+		delivery_instance->is_pending = true;
+		link->pending_delivery_span++;
+
+		AMQP_STATISTICS_INCREMENT(link->statistics.pending_delivery_count);
+		result = 0;
+	}
+
+	return result;
+}
+
+/* drops the empty slots in front of the first pending delivery */
+static void trim_pending_deliveries(LINK_INSTANCE* link)
+{
+	while ((link->pending_delivery_span > 0) &&
+		(!get_pending_delivery(link, 0)->is_pending))
+	{
+		link->first_pending_slot = (link->first_pending_slot + 1) % link->pending_delivery_capacity;
+		link->pending_delivery_span--;
+	}
+}
+
+static void settle_pending_delivery(LINK_INSTANCE* link, uint32_t offset, LINK_DELIVERY_SETTLE_REASON reason, AMQP_VALUE delivery_state)
+{
+	/* copied out first, the callback may send and so grow the ring */
+	DELIVERY_INSTANCE delivery_instance = *get_pending_delivery(link, offset);
+
+	get_pending_delivery(link, offset)->is_pending = false;
+	AMQP_STATISTICS_DECREMENT(link->statistics.pending_delivery_count);
+
+	if (delivery_instance.on_delivery_settled != NULL)
+	{
+		delivery_instance.on_delivery_settled(delivery_instance.callback_context, delivery_instance.delivery_id, reason, delivery_state);
+	}
+}
+
+/* Offset of the first slot whose delivery id is not before delivery_id, pending_delivery_span when there is none.
+   RFC-1982 serial number arithmetic: ids are compared by their distance from the first slot's id, taken modulo 2^32,
+   so ids wrapping past 0 keep their order. */
+static uint32_t find_pending_delivery(LINK_INSTANCE* link, delivery_number delivery_id)
+{
+	delivery_number first_delivery_id = get_pending_delivery(link, 0)->delivery_id;
+	int32_t target = (int32_t)(delivery_id - first_delivery_id);
+	uint32_t low = 0;
+	uint32_t high = link->pending_delivery_span;
+
+	if (target > 0)
+	{
+		while (low < high)
+		{
+			uint32_t middle = low + ((high - low) / 2);
+
+			if ((uint32_t)(get_pending_delivery(link, middle)->delivery_id - first_delivery_id) < (uint32_t)target)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+	}
+
+	return low;
+}
+
+/* O(log(pending deliveries) + the link's deliveries in first..last) */
+static void settle_pending_deliveries(LINK_INSTANCE* link, delivery_number first, delivery_number last, AMQP_VALUE delivery_state)
+{
+	if (link->pending_delivery_span > 0)
+	{
+		/* the span is only read here, deliveries sent from the callbacks are not part of the range */
+		uint32_t span = link->pending_delivery_span;
+		uint32_t offset;
+
+		/* settling does not move the slots, a callback growing the ring only unwraps it */
+		for (offset = find_pending_delivery(link, first);
+			(offset < span) && ((int32_t)(get_pending_delivery(link, offset)->delivery_id - last) <= 0);
+			offset++)
+		{
+			if (get_pending_delivery(link, offset)->is_pending)
+			{
+				settle_pending_delivery(link, offset, LINK_DELIVERY_SETTLE_REASON_DISPOSITION_RECEIVED, delivery_state);
+			}
+		}
+
+		trim_pending_deliveries(link);
+	}
+}
+
 static void remove_all_pending_deliveries(LINK_INSTANCE* link, bool indicate_settled)
 {
-    if (link->pending_deliveries != NULL)
-    {
-        LIST_ITEM_HANDLE item = singlylinkedlist_get_head_item(link->pending_deliveries);
-        while (item != NULL)
-        {
-            LIST_ITEM_HANDLE next_item = singlylinkedlist_get_next_item(item);
-            DELIVERY_INSTANCE* delivery_instance = (DELIVERY_INSTANCE*)singlylinkedlist_item_get_value(item);
-            if (delivery_instance != NULL)
-            {
-                if (indicate_settled && (delivery_instance->on_delivery_settled != NULL))
-                {
-                    delivery_instance->on_delivery_settled(delivery_instance->callback_context, delivery_instance->delivery_id, LINK_DELIVERY_SETTLE_REASON_NOT_DELIVERED, NULL);
-                }
-                free(delivery_instance);
-            }
+	uint32_t offset;
 
-            item = next_item;
-        }
+	for (offset = 0; offset < link->pending_delivery_span; offset++)
+	{
+		DELIVERY_INSTANCE* delivery_instance = get_pending_delivery(link, offset);
+		if (delivery_instance->is_pending)
+		{
+			if (indicate_settled)
+			{
+				settle_pending_delivery(link, offset, LINK_DELIVERY_SETTLE_REASON_NOT_DELIVERED, NULL);
+			}
+			else
+			{
+				delivery_instance->is_pending = false;
+				AMQP_STATISTICS_DECREMENT(link->statistics.pending_delivery_count);
+			}
+		}
+	}
 
-        singlylinkedlist_destroy(link->pending_deliveries);
-        link->pending_deliveries = NULL;
-    }
+	link->pending_delivery_span = 0;
 }
 
 static int send_flow(LINK_INSTANCE* link)
@@ -119,6 +316,7 @@ static int send_flow(LINK_INSTANCE* link)
 			}
 			else
 			{
+				AMQP_STATISTICS_INCREMENT(link->statistics.flows_sent);
 				result = 0;
 			}
 		}
@@ -129,18 +327,18 @@ static int send_flow(LINK_INSTANCE* link)
 	return result;
 }
 
-static int send_disposition(LINK_INSTANCE* link_instance, delivery_number delivery_number, AMQP_VALUE delivery_state)
+static int send_disposition(LINK_INSTANCE* link_instance, delivery_number first, delivery_number last, AMQP_VALUE delivery_state)
 {
 	int result;
 
-	DISPOSITION_HANDLE disposition = disposition_create(link_instance->role, delivery_number);
+	DISPOSITION_HANDLE disposition = disposition_create(link_instance->role, first);
 	if (disposition == NULL)
 	{
 		result = __FAILURE__;
 	}
 	else
 	{
-		if ((disposition_set_last(disposition, delivery_number) != 0) ||
+		if ((disposition_set_last(disposition, last) != 0) ||
 			(disposition_set_settled(disposition, true) != 0) ||
 			((delivery_state != NULL) && (disposition_set_state(disposition, delivery_state) != 0)))
 		{
@@ -154,6 +352,7 @@ static int send_disposition(LINK_INSTANCE* link_instance, delivery_number delive
 			}
 			else
 			{
+				AMQP_STATISTICS_INCREMENT(link_instance->statistics.dispositions_sent);
 				result = 0;
 			}
 		}
@@ -164,6 +363,258 @@ static int send_disposition(LINK_INSTANCE* link_instance, delivery_number delive
 	return result;
 }
 
+static int flush_dispositions(LINK_INSTANCE* link_instance)
+{
+	int result;
+
+	if (link_instance->batched_count == 0)
+	{
+		result = 0;
+	}
+	else
+	{
+		result = send_disposition(link_instance, link_instance->batched_first, link_instance->batched_last, link_instance->batched_delivery_state);
+
+		amqpvalue_destroy(link_instance->batched_delivery_state);
+		link_instance->batched_delivery_state = NULL;
+		link_instance->batched_count = 0;
+	}
+
+	return result;
+}
+
+static bool is_disposition_batch_expired(LINK_INSTANCE* link_instance)
+{
+	bool result;
+	tickcounter_ms_t current_ms;
+
+	/* the tick counter outlives a delay set back to 0, which means no time limit */
+	if ((link_instance->batched_count == 0) ||
+		(link_instance->max_disposition_delay == 0) ||
+		(link_instance->disposition_tick_counter == NULL))
+	{
+		result = false;
+	}
+	else if (tickcounter_get_current_ms(link_instance->disposition_tick_counter, &current_ms) != 0)
+	{
+		LogError("Could not get tick counter value");
+		result = true;
+	}
+	else
+	{
+		result = (current_ms - link_instance->batch_start_time >= link_instance->max_disposition_delay);
+	}
+
+	return result;
+}
+
+/* delivery states are described values, which amqpvalue_are_equal does not compare */
+static bool are_delivery_states_equal(AMQP_VALUE delivery_state1, AMQP_VALUE delivery_state2)
+{
+	bool result;
+	AMQP_VALUE descriptor1 = amqpvalue_get_inplace_descriptor(delivery_state1);
+	AMQP_VALUE descriptor2 = amqpvalue_get_inplace_descriptor(delivery_state2);
+
+	if ((descriptor1 == NULL) ||
+		(descriptor2 == NULL))
+	{
+		result = amqpvalue_are_equal(delivery_state1, delivery_state2);
+	}
+	else
+	{
+		result = amqpvalue_are_equal(descriptor1, descriptor2) &&
+			amqpvalue_are_equal(amqpvalue_get_inplace_described_value(delivery_state1), amqpvalue_get_inplace_described_value(delivery_state2));
+	}
+
+	return result;
+}
+
+/* Consecutive deliveries settled with the same outcome go out as one first..last disposition. The batch is sent when it
+   is full, when a delivery does not extend it, and when it is older than the delay (checked whenever the link is used). */
+static int queue_disposition(LINK_INSTANCE* link_instance, delivery_number delivery_id, AMQP_VALUE delivery_state)
+{
+	int result;
+
+	if (link_instance->max_disposition_batch_count <= 1)
+	{
+		result = send_disposition(link_instance, delivery_id, delivery_id, delivery_state);
+	}
+	else
+	{
+		int flush_result = 0;
+
+		/* the batch is gone even when sending it fails, the delivery then starts a new one */
+		if ((link_instance->batched_count > 0) &&
+			((delivery_id != link_instance->batched_last + 1) ||
+			 (delivery_id < link_instance->batched_first) ||
+			 (!are_delivery_states_equal(delivery_state, link_instance->batched_delivery_state))))
+		{
+			flush_result = flush_dispositions(link_instance);
+		}
+
+		if (link_instance->batched_count > 0)
+		{
+			link_instance->batched_last = delivery_id;
+			link_instance->batched_count++;
+
+			if ((link_instance->batched_count >= link_instance->max_disposition_batch_count) ||
+				is_disposition_batch_expired(link_instance))
+			{
+				result = flush_dispositions(link_instance);
+			}
+			else
+			{
+				result = 0;
+			}
+		}
+		else if ((link_instance->disposition_tick_counter != NULL) &&
+			(tickcounter_get_current_ms(link_instance->disposition_tick_counter, &link_instance->batch_start_time) != 0))
+		{
+			LogError("Could not get tick counter value");
+			result = send_disposition(link_instance, delivery_id, delivery_id, delivery_state);
+		}
+		else
+		{
+			link_instance->batched_delivery_state = amqpvalue_clone(delivery_state);
+			if (link_instance->batched_delivery_state == NULL)
+			{
+				LogError("Cannot clone delivery state, sending it unbatched");
+				result = send_disposition(link_instance, delivery_id, delivery_id, delivery_state);
+			}
+			else
+			{
+				link_instance->batched_first = delivery_id;
+				link_instance->batched_last = delivery_id;
+				link_instance->batched_count = 1;
+				result = 0;
+			}
+		}
+
+		if (flush_result != 0)
+		{
+			LogError("Cannot send the batched dispositions");
+			result = __FAILURE__;
+		}
+	}
+
+	return result;
+}
+
+/* the prefetch count, lowered so that a credit's worth of average sized deliveries fits in the byte budget */
+static uint32_t get_credit_window(LINK_INSTANCE* link_instance)
+{
+	uint32_t result = link_instance->prefetch_count;
+
+	if ((link_instance->max_prefetched_bytes > 0) &&
+		(link_instance->average_delivery_size > 0))
+	{
+		uint64_t budget_window = link_instance->max_prefetched_bytes / link_instance->average_delivery_size;
+
+		if (budget_window < result)
+		{
+			/* at least one, or nothing larger than the budget would ever be received */
+			result = (budget_window == 0) ? 1 : (uint32_t)budget_window;
+		}
+	}
+
+	return result;
+}
+
+/* tops the credit up once it has fallen under the refill threshold, rather than when it runs out, so that the flow reaches
+   the sender before it has to stop; the threshold shrinks with the window when the byte budget lowers it */
+static void refill_credit(LINK_INSTANCE* link_instance)
+{
+	uint32_t credit_window = get_credit_window(link_instance);
+	uint32_t refill_threshold = (uint32_t)(((uint64_t)link_instance->credit_refill_threshold * credit_window) / link_instance->prefetch_count);
+
+	if (((link_instance->link_credit == 0) || (link_instance->link_credit < refill_threshold)) &&
+		(credit_window > link_instance->link_credit))
+	{
+		link_instance->link_credit = credit_window;
+		if (send_flow(link_instance) != 0)
+		{
+			LogError("Cannot send flow");
+		}
+	}
+}
+
+static void update_average_delivery_size(LINK_INSTANCE* link_instance, uint64_t delivery_size)
+{
+	if (delivery_size > UINT32_MAX)
+	{
+		delivery_size = UINT32_MAX;
+	}
+
+	if (link_instance->average_delivery_size == 0)
+	{
+		link_instance->average_delivery_size = (uint32_t)delivery_size;
+	}
+	else
+	{
+		/* weight 1/8, a few large deliveries only move it gradually */
+		link_instance->average_delivery_size = (uint32_t)((int64_t)link_instance->average_delivery_size + (((int64_t)delivery_size - (int64_t)link_instance->average_delivery_size) / 8));
+	}
+}
+
+/* makes room for one more chunk of a multi frame delivery; the capacity doubles so that a large message costs a few
+   reallocs rather than one per frame, and it does not grow past the max message size, which bounds the delivery */
+static int ensure_received_payload_capacity(LINK_INSTANCE* link_instance, uint32_t payload_size)
+{
+	int result;
+
+	if (payload_size > UINT32_MAX - link_instance->received_payload_size)
+	{
+		LogError("Received payload too large");
+		result = __FAILURE__;
+	}
+	else
+	{
+		uint32_t needed = link_instance->received_payload_size + payload_size;
+
+		if (needed <= link_instance->received_payload_capacity)
+		{
+			result = 0;
+		}
+		else
+		{
+			/* the first chunk is followed by at least another one of about the same size */
+			uint64_t new_capacity = (link_instance->received_payload_capacity == 0) ? (uint64_t)needed * 2 : (uint64_t)link_instance->received_payload_capacity;
+			unsigned char* new_received_payload;
+
+			while (new_capacity < needed)
+			{
+				new_capacity *= 2;
+			}
+
+			if ((link_instance->max_message_size > 0) &&
+				(new_capacity > link_instance->max_message_size) &&
+				(needed <= link_instance->max_message_size))
+			{
+				new_capacity = link_instance->max_message_size;
+			}
+
+			if (new_capacity > UINT32_MAX)
+			{
+				new_capacity = UINT32_MAX;
+			}
+
+			new_received_payload = (unsigned char*)realloc(link_instance->received_payload, (size_t)new_capacity);
+			if (new_received_payload == NULL)
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				link_instance->received_payload = new_received_payload;
+				link_instance->received_payload_capacity = (uint32_t)new_capacity;
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
 static int send_detach(LINK_INSTANCE* link_instance, bool close, ERROR_HANDLE error_handle)
 {
 	int result;
@@ -291,7 +742,7 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 				{
 					if (link_instance->role == role_receiver)
 					{
-						link_instance->link_credit = DEFAULT_LINK_CREDIT;
+						link_instance->link_credit = get_credit_window(link_instance);
 						send_flow(link_instance);
 					}
 					else
@@ -332,6 +783,11 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 				else
 				{
 					link_instance->link_credit = rcv_delivery_count + rcv_link_credit - link_instance->delivery_count;
+
+					/* slots for the whole credit window, so that sending it does not allocate; failing here only means
+					   the ring grows later */
+					(void)ensure_pending_delivery_capacity(link_instance, (link_instance->link_credit < MAX_PREALLOCATED_PENDING_DELIVERIES) ? link_instance->link_credit : MAX_PREALLOCATED_PENDING_DELIVERIES);
+
 					if (link_instance->link_credit > 0)
 					{
 						link_instance->on_link_flow_on(link_instance->callback_context);
@@ -344,90 +800,148 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 	}
 	else if (is_transfer_type_by_descriptor(descriptor))
 	{
-		if (link_instance->on_transfer_received != NULL)
+		AMQP_STATISTICS_INCREMENT(link_instance->statistics.transfer_frames_received);
+
+		/* frames that settle nothing (continuations, deferred outcomes) still send a batch that is due */
+		if (is_disposition_batch_expired(link_instance) &&
+			(flush_dispositions(link_instance) != 0))
+		{
+			LogError("Cannot send the batched dispositions");
+		}
+
+		if ((link_instance->on_transfer_received != NULL) ||
+			(link_instance->on_transfer_chunk_received != NULL))
 		{
 			TRANSFER_HANDLE transfer_handle;
 			if (amqpvalue_get_transfer(performative, &transfer_handle) == 0)
 			{
-				AMQP_VALUE delivery_state;
+				AMQP_VALUE delivery_state = NULL;
                 bool more;
+                bool aborted;
 				bool is_error;
 
-				link_instance->link_credit--;
-				link_instance->delivery_count++;
-				if (link_instance->link_credit == 0)
+				/* credit and the delivery count are per delivery, not per transfer frame */
+				if (!link_instance->is_receiving_multi_frame_delivery)
 				{
-					link_instance->link_credit = DEFAULT_LINK_CREDIT;
-					send_flow(link_instance);
-				}
-
-				more = false;
+					if (link_instance->link_credit > 0)
+					{
+						link_instance->link_credit--;
+					}
+
+					link_instance->delivery_count++;
+					refill_credit(link_instance);
+				}
+
+				more = false;
 				/* Attempt to get more flag, default to false */
 				(void)transfer_get_more(transfer_handle, &more);
+				aborted = false;
+				(void)transfer_get_aborted(transfer_handle, &aborted);
 				is_error = false;
 
                 if (transfer_get_delivery_id(transfer_handle, &link_instance->received_delivery_id) != 0)
                 {
                     /* is this not a continuation transfer? */
-                    if (link_instance->received_payload_size == 0)
+                    if (!link_instance->is_receiving_multi_frame_delivery)
                     {
                         LogError("Could not get the delivery Id from the transfer performative");
                         is_error = true;
                     }
                 }
                     
-                if (!is_error)
+                if (!is_error && aborted)
                 {
-                    /* If this is a continuation transfer or if this is the first chunk of a multi frame transfer */
-                    if ((link_instance->received_payload_size > 0) || more)
+                    /* the sender gave up on the delivery, what was received of it is dropped and it gets no disposition */
+                    if (link_instance->on_transfer_chunk_received != NULL)
                     {
-                        unsigned char* new_received_payload = (unsigned char*)realloc(link_instance->received_payload, link_instance->received_payload_size + payload_size);
-                        if (new_received_payload == NULL)
-                        {
-                            LogError("Could not allocate memory for the received payload");
-                        }
-                        else
+                        delivery_state = link_instance->on_transfer_chunk_received(link_instance->callback_context, transfer_handle, 0, NULL, false);
+                        if (delivery_state != NULL)
                         {
-                            link_instance->received_payload = new_received_payload;
-                            (void)memcpy(link_instance->received_payload + link_instance->received_payload_size, payload_bytes, payload_size);
-                            link_instance->received_payload_size += payload_size;
+                            amqpvalue_destroy(delivery_state);
                         }
                     }
 
-                    if (!more)
+                    free(link_instance->received_payload);
+                    link_instance->received_payload = NULL;
+                    link_instance->received_payload_size = 0;
+                    link_instance->received_payload_capacity = 0;
+                    link_instance->streamed_payload_size = 0;
+                    link_instance->is_receiving_multi_frame_delivery = false;
+                }
+                else if (!is_error)
+                {
+                    if (link_instance->on_transfer_chunk_received != NULL)
                     {
-                        const unsigned char* indicate_payload_bytes;
-                        uint32_t indicate_payload_size;
-
-                        /* if no previously stored chunks then simply report the current payload */
-                        if (link_instance->received_payload_size > 0)
+                        /* streaming, each chunk is handed over as it arrives and nothing is kept */
+                        link_instance->streamed_payload_size += payload_size;
+                        if (!more)
                         {
-                            indicate_payload_size = link_instance->received_payload_size;
-                            indicate_payload_bytes = link_instance->received_payload;
+                            update_average_delivery_size(link_instance, link_instance->streamed_payload_size);
+                            link_instance->streamed_payload_size = 0;
                         }
-                        else
+
+                        delivery_state = link_instance->on_transfer_chunk_received(link_instance->callback_context, transfer_handle, payload_size, payload_bytes, more);
+                    }
+                    else
+                    {
+                        /* If this is a continuation transfer or if this is the first chunk of a multi frame transfer */
+                        if (link_instance->is_receiving_multi_frame_delivery || more)
                         {
-                            indicate_payload_size = payload_size;
-                            indicate_payload_bytes = payload_bytes;
+                            if (ensure_received_payload_capacity(link_instance, payload_size) != 0)
+                            {
+                                LogError("Could not allocate memory for the received payload");
+                            }
+                            else
+                            {
+                                (void)memcpy(link_instance->received_payload + link_instance->received_payload_size, payload_bytes, payload_size);
+                                link_instance->received_payload_size += payload_size;
+                            }
                         }
 
-                        delivery_state = link_instance->on_transfer_received(link_instance->callback_context, transfer_handle, indicate_payload_size, indicate_payload_bytes);
-
-                        if (link_instance->received_payload_size > 0)
+                        if (!more)
                         {
-                            free(link_instance->received_payload);
-                            link_instance->received_payload = NULL;
-                            link_instance->received_payload_size = 0;
+                            const unsigned char* indicate_payload_bytes;
+                            uint32_t indicate_payload_size;
+
+                            /* if no previously stored chunks then simply report the current payload */
+                            if (link_instance->received_payload_size > 0)
+                            {
+                                indicate_payload_size = link_instance->received_payload_size;
+                                indicate_payload_bytes = link_instance->received_payload;
+                            }
+                            else
+                            {
+                                indicate_payload_size = payload_size;
+                                indicate_payload_bytes = payload_bytes;
+                            }
+
+                            update_average_delivery_size(link_instance, indicate_payload_size);
+
+                            delivery_state = link_instance->on_transfer_received(link_instance->callback_context, transfer_handle, indicate_payload_size, indicate_payload_bytes);
+
+                            if (link_instance->received_payload_size > 0)
+                            {
+                                free(link_instance->received_payload);
+                                link_instance->received_payload = NULL;
+                                link_instance->received_payload_size = 0;
+                                link_instance->received_payload_capacity = 0;
+                            }
                         }
+                    }
 
-                        if (delivery_state != NULL)
+                    link_instance->is_receiving_multi_frame_delivery = more;
+
+                    if (delivery_state != NULL)
+                    {
+                        if (!more)
                         {
-                            if (send_disposition(link_instance, link_instance->received_delivery_id, delivery_state) != 0)
+                            if (queue_disposition(link_instance, link_instance->received_delivery_id, delivery_state) != 0)
                             {
                                 LogError("Cannot send disposition frame");
                             }
-                            amqpvalue_destroy(delivery_state);
                         }
+
+                        amqpvalue_destroy(delivery_state);
                     }
                 }
 
@@ -468,46 +982,15 @@ static void link_frame_received(void* context, AMQP_VALUE performative, uint32_t
 
                 if (settled)
                 {
-                    LIST_ITEM_HANDLE pending_delivery = singlylinkedlist_get_head_item(link_instance->pending_deliveries);
-                    while (pending_delivery != NULL)
+                    AMQP_VALUE delivery_state;
+
+                    if (disposition_get_state(disposition, &delivery_state) != 0)
                     {
-                        LIST_ITEM_HANDLE next_pending_delivery = singlylinkedlist_get_next_item(pending_delivery);
-                        DELIVERY_INSTANCE* delivery_instance = (DELIVERY_INSTANCE*)singlylinkedlist_item_get_value(pending_delivery);
-                        if (delivery_instance == NULL)
-                        {
-                            /* error */
-                            break;
-                        }
-                        else
-                        {
-                            if ((delivery_instance->delivery_id >= first) && (delivery_instance->delivery_id <= last))
-                            {
-                                AMQP_VALUE delivery_state;
-                                if (disposition_get_state(disposition, &delivery_state) != 0)
-                                {
-                                    /* error */
-                                }
-                                else
-                                {
-                                    delivery_instance->on_delivery_settled(delivery_instance->callback_context, delivery_instance->delivery_id, LINK_DELIVERY_SETTLE_REASON_DISPOSITION_RECEIVED, delivery_state);
-                                    free(delivery_instance);
-                                    if (singlylinkedlist_remove(link_instance->pending_deliveries, pending_delivery) != 0)
-                                    {
-                                        /* error */
-                                        break;
-                                    }
-                                    else
-                                    {
-                                        pending_delivery = next_pending_delivery;
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                pending_delivery = next_pending_delivery;
-                            }
-                        }
+                        /* a settlement without an outcome */
+                        delivery_state = NULL;
                     }
+
+                    settle_pending_deliveries(link_instance, first, last, delivery_state);
                 }
 			}
 
@@ -598,15 +1081,19 @@ static void on_session_flow_on(void* context)
 
 static void on_send_complete(void* context, IO_SEND_RESULT send_result)
 {
-	LIST_ITEM_HANDLE delivery_instance_list_item = (LIST_ITEM_HANDLE)context;
-	DELIVERY_INSTANCE* delivery_instance = (DELIVERY_INSTANCE*)singlylinkedlist_item_get_value(delivery_instance_list_item);
-	LINK_INSTANCE* link_instance = (LINK_INSTANCE*)delivery_instance->link;
+	LINK_INSTANCE* link_instance = (LINK_INSTANCE*)context;
     (void)send_result;
-	if (link_instance->snd_settle_mode == sender_settle_mode_settled)
+
+	/* only passed for settled transfers, whose sends complete in order: this is the first pending delivery, unless it
+	   is the one being sent, which has no slot yet */
+	if (link_instance->pending_delivery_span > 0)
+	{
+		settle_pending_delivery(link_instance, 0, LINK_DELIVERY_SETTLE_REASON_SETTLED, NULL);
+		trim_pending_deliveries(link_instance);
+	}
+	else if (link_instance->is_transfer_in_progress)
 	{
-		delivery_instance->on_delivery_settled(delivery_instance->callback_context, delivery_instance->delivery_id, LINK_DELIVERY_SETTLE_REASON_SETTLED, NULL);
-		free(delivery_instance);
-		(void)singlylinkedlist_remove(link_instance->pending_deliveries, delivery_instance_list_item);
+		link_instance->is_transfer_send_complete = true;
 	}
 }
 
@@ -631,23 +1118,38 @@ LINK_HANDLE link_create(SESSION_HANDLE session, const char* name, role role, AMQ
 		result->is_underlying_session_begun = false;
         result->is_closed = false;
         result->attach_properties = NULL;
+#ifndef UAMQP_NO_STATISTICS
+        (void)memset(&result->statistics, 0, sizeof(result->statistics));
+#endif
         result->received_payload = NULL;
         result->received_payload_size = 0;
+        result->received_payload_capacity = 0;
+        result->is_receiving_multi_frame_delivery = false;
+        result->on_transfer_chunk_received = NULL;
+        result->streamed_payload_size = 0;
         result->received_delivery_id = 0;
+        result->max_disposition_batch_count = 0;
+        result->max_disposition_delay = 0;
+        result->disposition_tick_counter = NULL;
+        result->batched_delivery_state = NULL;
+        result->batched_count = 0;
+        result->pending_deliveries = NULL;
+        result->pending_delivery_capacity = 0;
+        result->first_pending_slot = 0;
+        result->pending_delivery_span = 0;
+        result->is_transfer_in_progress = false;
+        result->is_transfer_send_complete = false;
+        result->is_sending_multi_frame_delivery = false;
+        result->prefetch_count = DEFAULT_LINK_CREDIT;
+        result->credit_refill_threshold = DEFAULT_LINK_CREDIT_REFILL_THRESHOLD;
+        result->max_prefetched_bytes = 0;
+        result->average_delivery_size = 0;
 
-		result->pending_deliveries = singlylinkedlist_create();
-		if (result->pending_deliveries == NULL)
-		{
-			free(result);
-			result = NULL;
-		}
-		else
 		{
             size_t name_length = strlen(name);
 			result->name = (char*)malloc(name_length + 1);
 			if (result->name == NULL)
 			{
-				singlylinkedlist_destroy(result->pending_deliveries);
 				free(result);
 				result = NULL;
 			}
@@ -661,7 +1163,6 @@ LINK_HANDLE link_create(SESSION_HANDLE session, const char* name, role role, AMQ
 				result->link_endpoint = session_create_link_endpoint(session, name);
 				if (result->link_endpoint == NULL)
 				{
-					singlylinkedlist_destroy(result->pending_deliveries);
 					free(result->name);
 					free(result);
 					result = NULL;
@@ -691,9 +1192,32 @@ LINK_HANDLE link_create_from_endpoint(SESSION_HANDLE session, LINK_ENDPOINT_HAND
 		result->is_underlying_session_begun = false;
         result->is_closed = false;
         result->attach_properties = NULL;
+#ifndef UAMQP_NO_STATISTICS
+        (void)memset(&result->statistics, 0, sizeof(result->statistics));
+#endif
         result->received_payload = NULL;
         result->received_payload_size = 0;
+        result->received_payload_capacity = 0;
+        result->is_receiving_multi_frame_delivery = false;
+        result->on_transfer_chunk_received = NULL;
+        result->streamed_payload_size = 0;
         result->received_delivery_id = 0;
+        result->max_disposition_batch_count = 0;
+        result->max_disposition_delay = 0;
+        result->disposition_tick_counter = NULL;
+        result->batched_delivery_state = NULL;
+        result->batched_count = 0;
+        result->pending_deliveries = NULL;
+        result->pending_delivery_capacity = 0;
+        result->first_pending_slot = 0;
+        result->pending_delivery_span = 0;
+        result->is_transfer_in_progress = false;
+        result->is_transfer_send_complete = false;
+        result->is_sending_multi_frame_delivery = false;
+        result->prefetch_count = DEFAULT_LINK_CREDIT;
+        result->credit_refill_threshold = DEFAULT_LINK_CREDIT_REFILL_THRESHOLD;
+        result->max_prefetched_bytes = 0;
+        result->average_delivery_size = 0;
         result->source = amqpvalue_clone(target);
 		result->target = amqpvalue_clone(source);
 		if (role == role_sender)
@@ -705,19 +1229,11 @@ LINK_HANDLE link_create_from_endpoint(SESSION_HANDLE session, LINK_ENDPOINT_HAND
 			result->role = role_sender;
 		}
 
-		result->pending_deliveries = singlylinkedlist_create();
-		if (result->pending_deliveries == NULL)
-		{
-			free(result);
-			result = NULL;
-		}
-		else
 		{
             size_t name_length = strlen(name);
 			result->name = (char*)malloc(name_length + 1);
 			if (result->name == NULL)
 			{
-				singlylinkedlist_destroy(result->pending_deliveries);
 				free(result);
 				result = NULL;
 			}
@@ -742,6 +1258,23 @@ void link_destroy(LINK_HANDLE link)
 
         link->on_link_state_changed = NULL;
         (void)link_detach(link, true);
+
+        /* left over when the link was not attached anymore */
+        if (link->batched_delivery_state != NULL)
+        {
+            amqpvalue_destroy(link->batched_delivery_state);
+        }
+
+        if (link->disposition_tick_counter != NULL)
+        {
+            tickcounter_destroy(link->disposition_tick_counter);
+        }
+
+        if (link->pending_deliveries != NULL)
+        {
+            free(link->pending_deliveries);
+        }
+
         session_destroy_link_endpoint(link->link_endpoint);
 		amqpvalue_destroy(link->source);
 		amqpvalue_destroy(link->target);
@@ -888,6 +1421,28 @@ int link_set_max_message_size(LINK_HANDLE link, uint64_t max_message_size)
 	return result;
 }
 
+int link_set_scheduling_weight(LINK_HANDLE link, uint32_t weight)
+{
+	int result;
+
+	if (link == NULL)
+	{
+		LogError("NULL link");
+		result = __FAILURE__;
+	}
+	else if (session_set_link_endpoint_weight(link->link_endpoint, weight) != 0)
+	{
+		LogError("Cannot set the link endpoint weight");
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
 int link_get_max_message_size(LINK_HANDLE link, uint64_t* max_message_size)
 {
 	int result;
@@ -989,6 +1544,9 @@ int link_attach(LINK_HANDLE link, ON_TRANSFER_RECEIVED on_transfer_received, ON_
 				else
 				{
                     link->received_payload_size = 0;
+                    link->is_receiving_multi_frame_delivery = false;
+                    link->streamed_payload_size = 0;
+                    link->is_sending_multi_frame_delivery = false;
 
 					result = 0;
 				}
@@ -1031,7 +1589,12 @@ int link_detach(LINK_HANDLE link, bool close)
             break;
 
         case LINK_STATE_ATTACHED:
-            /* Send detach and wait for remote to respond */
+            /* Send detach and wait for remote to respond, after the settlements the remote is still waiting for */
+            if (flush_dispositions(link) != 0)
+            {
+                LogError("Cannot send the batched dispositions");
+            }
+
             if (send_detach(link, close, NULL) != 0)
             {
                 result = __FAILURE__;
@@ -1074,8 +1637,10 @@ LINK_TRANSFER_RESULT link_transfer(LINK_HANDLE link, message_format message_form
 		{
 			result = LINK_TRANSFER_ERROR;
 		}
-		else if (link->link_credit == 0)
+		else if ((link->link_credit == 0) ||
+			link->is_sending_multi_frame_delivery)
 		{
+			AMQP_STATISTICS_INCREMENT(link->statistics.transfer_busy_count);
 			result = LINK_TRANSFER_BUSY;
 		}
 		else
@@ -1114,66 +1679,294 @@ LINK_TRANSFER_RESULT link_transfer(LINK_HANDLE link, message_format message_form
 				}
 				else
 				{
-					AMQP_VALUE transfer_value = amqpvalue_create_transfer(transfer);
+					delivery_number delivery_id;
+					/* a settled transfer nobody waits for is fire and forget: no slot, no send completion */
+					bool is_tracked = !settled || (on_delivery_settled != NULL);
+					bool was_transfer_in_progress = link->is_transfer_in_progress;
+					bool was_transfer_send_complete = link->is_transfer_send_complete;
 
-					if (transfer_value == NULL)
+					link->is_transfer_in_progress = settled && is_tracked;
+					link->is_transfer_send_complete = false;
+
+					/* here we should feed data to the transfer frame */
+					switch (session_send_transfer(link->link_endpoint, transfer, payloads, payload_count, &delivery_id, (settled && is_tracked) ? on_send_complete : NULL, link))
 					{
+					default:
+					case SESSION_SEND_TRANSFER_ERROR:
 						result = LINK_TRANSFER_ERROR;
-					}
-					else
-					{
-						DELIVERY_INSTANCE* pending_delivery = (DELIVERY_INSTANCE*)malloc(sizeof(DELIVERY_INSTANCE));
-						if (pending_delivery == NULL)
+						break;
+
+					case SESSION_SEND_TRANSFER_BUSY:
+						AMQP_STATISTICS_INCREMENT(link->statistics.transfer_busy_count);
+						result = LINK_TRANSFER_BUSY;
+						break;
+
+					case SESSION_SEND_TRANSFER_OK:
+						link->delivery_count = delivery_count;
+						link->link_credit--;
+						AMQP_STATISTICS_INCREMENT(link->statistics.transfers_sent);
+
+						if (!is_tracked)
+						{
+							result = LINK_TRANSFER_OK;
+						}
+						else if (link->is_transfer_send_complete)
 						{
+							/* sent and settled already, there is nothing to wait for */
+							if (on_delivery_settled != NULL)
+							{
+								on_delivery_settled(callback_context, delivery_id, LINK_DELIVERY_SETTLE_REASON_SETTLED, NULL);
+							}
+
+							result = LINK_TRANSFER_OK;
+						}
+						else if (add_pending_delivery(link, delivery_id, on_delivery_settled, callback_context) != 0)
+						{
+							LogError("Cannot track delivery %u, its settlement would not be reported", (unsigned int)delivery_id);
 							result = LINK_TRANSFER_ERROR;
 						}
 						else
 						{
-							LIST_ITEM_HANDLE delivery_instance_list_item;
-							pending_delivery->on_delivery_settled = on_delivery_settled;
-							pending_delivery->callback_context = callback_context;
-							pending_delivery->link = link;
-							delivery_instance_list_item = singlylinkedlist_add(link->pending_deliveries, pending_delivery);
+							result = LINK_TRANSFER_OK;
+						}
+						break;
+					}
 
-							if (delivery_instance_list_item == NULL)
-							{
-								free(pending_delivery);
-								result = LINK_TRANSFER_ERROR;
-							}
-							else
-							{
-								/* here we should feed data to the transfer frame */
-								switch (session_send_transfer(link->link_endpoint, transfer, payloads, payload_count, &pending_delivery->delivery_id, (settled) ? on_send_complete : NULL, delivery_instance_list_item))
-								{
-								default:
-								case SESSION_SEND_TRANSFER_ERROR:
-									singlylinkedlist_remove(link->pending_deliveries, delivery_instance_list_item);
-									free(pending_delivery);
-									result = LINK_TRANSFER_ERROR;
-									break;
-
-								case SESSION_SEND_TRANSFER_BUSY:
-									/* Ensure we remove from list again since sender will attempt to transfer again on flow on */
-									singlylinkedlist_remove(link->pending_deliveries, delivery_instance_list_item);
-									free(pending_delivery);
-									result = LINK_TRANSFER_BUSY;
-									break;
-
-								case SESSION_SEND_TRANSFER_OK:
-									link->delivery_count = delivery_count;
-									link->link_credit--;
-									result = LINK_TRANSFER_OK;
-									break;
-								}
-							}
+					link->is_transfer_in_progress = was_transfer_in_progress;
+					link->is_transfer_send_complete = was_transfer_send_complete;
+				}
+
+				transfer_destroy(transfer);
+			}
+		}
+	}
+
+	return result;
+}
+
+static TRANSFER_HANDLE create_first_frame_transfer(LINK_INSTANCE* link, message_format message_format)
+{
+	TRANSFER_HANDLE result = transfer_create(0);
+	if (result == NULL)
+	{
+		LogError("Cannot create transfer");
+	}
+	else
+	{
+		sequence_no delivery_count = link->delivery_count + 1;
+		unsigned char delivery_tag_bytes[sizeof(delivery_count)];
+		delivery_tag delivery_tag;
+
+		(void)memcpy(delivery_tag_bytes, &delivery_count, sizeof(delivery_count));
+
+		delivery_tag.bytes = &delivery_tag_bytes;
+		delivery_tag.length = sizeof(delivery_tag_bytes);
+
+		if ((transfer_set_delivery_tag(result, delivery_tag) != 0) ||
+			(transfer_set_message_format(result, message_format) != 0) ||
+			(transfer_set_settled(result, link->snd_settle_mode != sender_settle_mode_unsettled) != 0))
+		{
+			LogError("Cannot set the transfer fields");
+			transfer_destroy(result);
+			result = NULL;
+		}
+	}
+
+	return result;
+}
+
+int link_get_transfer_frame_payload_size(LINK_HANDLE link, uint32_t* payload_size)
+{
+	int result;
+
+	if ((link == NULL) ||
+		(payload_size == NULL))
+	{
+		LogError("Bad arguments: link = %p, payload_size = %p", link, payload_size);
+		result = __FAILURE__;
+	}
+	else
+	{
+		/* the first frame is the largest one, it carries the delivery tag and the widest message format encoding */
+		TRANSFER_HANDLE transfer = create_first_frame_transfer(link, UINT32_MAX);
+		if (transfer == NULL)
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			if (session_get_transfer_frame_payload_size(link->link_endpoint, transfer, payload_size) != 0)
+			{
+				LogError("Cannot get the transfer frame payload size");
+				result = __FAILURE__;
+			}
+			else
+			{
+				result = 0;
+			}
+
+			transfer_destroy(transfer);
+		}
+	}
+
+	return result;
+}
+
+LINK_TRANSFER_RESULT link_transfer_frame(LINK_HANDLE link, message_format message_format, PAYLOAD* payloads, size_t payload_count, bool more, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+{
+	LINK_TRANSFER_RESULT result;
+
+	if (link == NULL)
+	{
+		LogError("NULL link");
+		result = LINK_TRANSFER_ERROR;
+	}
+	else if ((link->role != role_sender) ||
+		(link->link_state != LINK_STATE_ATTACHED))
+	{
+		LogError("Link is not an attached sender");
+		result = LINK_TRANSFER_ERROR;
+	}
+	else if (!link->is_sending_multi_frame_delivery &&
+		(link->link_credit == 0))
+	{
+		/* only the first frame needs credit */
+		AMQP_STATISTICS_INCREMENT(link->statistics.transfer_busy_count);
+		result = LINK_TRANSFER_BUSY;
+	}
+	else
+	{
+		TRANSFER_HANDLE transfer = link->is_sending_multi_frame_delivery ? transfer_create(0) : create_first_frame_transfer(link, message_format);
+		if (transfer == NULL)
+		{
+			result = LINK_TRANSFER_ERROR;
+		}
+		else if (transfer_set_more(transfer, more) != 0)
+		{
+			LogError("Cannot set the more flag");
+			transfer_destroy(transfer);
+			result = LINK_TRANSFER_ERROR;
+		}
+		else
+		{
+			bool settled = (link->snd_settle_mode != sender_settle_mode_unsettled);
+			/* as in link_transfer, a settled delivery nobody waits for is fire and forget */
+			bool is_tracked = !settled || (on_delivery_settled != NULL);
+			delivery_number delivery_id;
+			bool was_transfer_in_progress = link->is_transfer_in_progress;
+			bool was_transfer_send_complete = link->is_transfer_send_complete;
+
+			/* the send of a settled delivery completing is what settles it, that is its last frame */
+			link->is_transfer_in_progress = settled && is_tracked && !more;
+			link->is_transfer_send_complete = false;
+
+			switch (session_send_transfer_frame(link->link_endpoint, transfer, payloads, payload_count, &delivery_id, (settled && is_tracked && !more) ? on_send_complete : NULL, link))
+			{
+			default:
+			case SESSION_SEND_TRANSFER_ERROR:
+				LogError("Cannot send transfer frame");
+				result = LINK_TRANSFER_ERROR;
+				break;
+
+			case SESSION_SEND_TRANSFER_BUSY:
+				AMQP_STATISTICS_INCREMENT(link->statistics.transfer_busy_count);
+				result = LINK_TRANSFER_BUSY;
+				break;
+
+			case SESSION_SEND_TRANSFER_OK:
+				if (!link->is_sending_multi_frame_delivery)
+				{
+					link->delivery_count++;
+					link->link_credit--;
+				}
+
+				link->is_sending_multi_frame_delivery = more;
+
+				if (more)
+				{
+					result = LINK_TRANSFER_OK;
+				}
+				else
+				{
+					AMQP_STATISTICS_INCREMENT(link->statistics.transfers_sent);
+
+					if (!is_tracked)
+					{
+						result = LINK_TRANSFER_OK;
+					}
+					else if (link->is_transfer_send_complete)
+					{
+						if (on_delivery_settled != NULL)
+						{
+							on_delivery_settled(callback_context, delivery_id, LINK_DELIVERY_SETTLE_REASON_SETTLED, NULL);
 						}
 
-						amqpvalue_destroy(transfer_value);
+						result = LINK_TRANSFER_OK;
+					}
+					else if (add_pending_delivery(link, delivery_id, on_delivery_settled, callback_context) != 0)
+					{
+						LogError("Cannot track delivery %u, its settlement would not be reported", (unsigned int)delivery_id);
+						result = LINK_TRANSFER_ERROR;
+					}
+					else
+					{
+						result = LINK_TRANSFER_OK;
 					}
 				}
+				break;
+			}
 
-				transfer_destroy(transfer);
+			link->is_transfer_in_progress = was_transfer_in_progress;
+			link->is_transfer_send_complete = was_transfer_send_complete;
+
+			transfer_destroy(transfer);
+		}
+	}
+
+	return result;
+}
+
+int link_abort_transfer(LINK_HANDLE link)
+{
+	int result;
+
+	if (link == NULL)
+	{
+		LogError("NULL link");
+		result = __FAILURE__;
+	}
+	else if (!link->is_sending_multi_frame_delivery)
+	{
+		LogError("No delivery is being sent");
+		result = __FAILURE__;
+	}
+	else
+	{
+		TRANSFER_HANDLE transfer = transfer_create(0);
+		if (transfer == NULL)
+		{
+			LogError("Cannot create transfer");
+			result = __FAILURE__;
+		}
+		else
+		{
+			delivery_number delivery_id;
+
+			if ((transfer_set_more(transfer, false) != 0) ||
+				(transfer_set_aborted(transfer, true) != 0) ||
+				(transfer_set_settled(transfer, true) != 0) ||
+				(session_send_transfer_frame(link->link_endpoint, transfer, NULL, 0, &delivery_id, NULL, NULL) != SESSION_SEND_TRANSFER_OK))
+			{
+				LogError("Cannot send the aborted transfer");
+				result = __FAILURE__;
 			}
+			else
+			{
+				link->is_sending_multi_frame_delivery = false;
+				result = 0;
+			}
+
+			transfer_destroy(transfer);
 		}
 	}
 
@@ -1197,6 +1990,33 @@ int link_get_name(LINK_HANDLE link, const char** link_name)
     return result;
 }
 
+int link_get_statistics(LINK_HANDLE link, LINK_STATISTICS* statistics)
+{
+    int result;
+
+    if ((link == NULL) ||
+        (statistics == NULL))
+    {
+        LogError("Bad arguments: link = %p, statistics = %p",
+            link, statistics);
+        result = __FAILURE__;
+    }
+    else
+    {
+#ifndef UAMQP_NO_STATISTICS
+        *statistics = link->statistics;
+        statistics->link_credit = link->link_credit;
+        statistics->delivery_count = link->delivery_count;
+        result = 0;
+#else
+        LogError("Statistics are not compiled in");
+        result = __FAILURE__;
+#endif
+    }
+
+    return result;
+}
+
 int link_get_received_message_id(LINK_HANDLE link, delivery_number* message_id)
 {
     int result;
@@ -1223,7 +2043,7 @@ int link_send_disposition(LINK_HANDLE link, delivery_number message_id, AMQP_VAL
 	}
 	else
     {
-	    result = send_disposition(link, message_id, delivery_state);
+	    result = queue_disposition(link, message_id, delivery_state);
         if ( result != 0)
         {
             LogError("Cannot send disposition frame");
@@ -1232,3 +2052,145 @@ int link_send_disposition(LINK_HANDLE link, delivery_number message_id, AMQP_VAL
     }
     return result;
 }
+
+int link_set_disposition_batching(LINK_HANDLE link, uint32_t max_batch_count, milliseconds max_delay)
+{
+    int result;
+
+    if (link == NULL)
+    {
+        LogError("NULL link");
+        result = __FAILURE__;
+    }
+    else if (flush_dispositions(link) != 0)
+    {
+        LogError("Cannot send the dispositions batched so far");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((max_batch_count > 1) &&
+            (max_delay > 0) &&
+            (link->disposition_tick_counter == NULL))
+        {
+            link->disposition_tick_counter = tickcounter_create();
+        }
+
+        if ((max_batch_count > 1) &&
+            (max_delay > 0) &&
+            (link->disposition_tick_counter == NULL))
+        {
+            LogError("Cannot create tick counter");
+            result = __FAILURE__;
+        }
+        else
+        {
+            link->max_disposition_batch_count = max_batch_count;
+            link->max_disposition_delay = max_delay;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int link_flush_dispositions(LINK_HANDLE link)
+{
+    int result;
+
+    if (link == NULL)
+    {
+        LogError("NULL link");
+        result = __FAILURE__;
+    }
+    else if (flush_dispositions(link) != 0)
+    {
+        LogError("Cannot send the batched dispositions");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+void link_dowork(LINK_HANDLE link)
+{
+    if (link == NULL)
+    {
+        LogError("NULL link");
+    }
+    else if (is_disposition_batch_expired(link) &&
+        (flush_dispositions(link) != 0))
+    {
+        LogError("Cannot send the batched dispositions");
+    }
+}
+
+int link_set_credit_policy(LINK_HANDLE link, uint32_t prefetch_count, uint32_t refill_threshold, uint64_t max_prefetched_bytes)
+{
+    int result;
+
+    if ((link == NULL) ||
+        (prefetch_count == 0) ||
+        (refill_threshold > prefetch_count))
+    {
+        LogError("Bad arguments: link = %p, prefetch_count = %u, refill_threshold = %u",
+            link, (unsigned int)prefetch_count, (unsigned int)refill_threshold);
+        result = __FAILURE__;
+    }
+    else
+    {
+        link->prefetch_count = prefetch_count;
+        link->credit_refill_threshold = refill_threshold;
+        link->max_prefetched_bytes = max_prefetched_bytes;
+
+        /* an attached receiver announces the new window right away, also when it is smaller */
+        if ((link->role == role_receiver) &&
+            (link->link_state == LINK_STATE_ATTACHED))
+        {
+            link->link_credit = get_credit_window(link);
+            if (send_flow(link) != 0)
+            {
+                LogError("Cannot send flow");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int link_set_on_transfer_chunk_received(LINK_HANDLE link, ON_TRANSFER_CHUNK_RECEIVED on_transfer_chunk_received)
+{
+    int result;
+
+    if (link == NULL)
+    {
+        LogError("NULL link");
+        result = __FAILURE__;
+    }
+    else if (link->is_receiving_multi_frame_delivery)
+    {
+        /* the chunks received so far went the other way */
+        LogError("Cannot switch the receive mode in the middle of a delivery");
+        result = __FAILURE__;
+    }
+    else
+    {
+        link->on_transfer_chunk_received = on_transfer_chunk_received;
+        result = 0;
+    }
+
+    return result;
+}
@@ -0,0 +1,490 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/memory_pair_io.h"
+
+#define DEFAULT_BUFFER_SIZE 65536
+
+typedef enum IO_STATE_TAG
+{
+	IO_STATE_NOT_OPEN,
+	IO_STATE_OPEN,
+	IO_STATE_ERROR
+} IO_STATE;
+
+/* what one end looks like to the other one */
+typedef enum END_STATE_TAG
+{
+	END_STATE_IDLE,
+	END_STATE_OPEN,
+	END_STATE_CLOSED
+} END_STATE;
+
+typedef struct MEMORY_RING_TAG
+{
+	unsigned char* bytes;
+	size_t capacity;
+	size_t read_position;
+	size_t used;
+} MEMORY_RING;
+
+typedef struct MEMORY_PAIR_INSTANCE_TAG
+{
+	/* rings[end] holds the bytes sent towards end */
+	MEMORY_RING rings[2];
+	END_STATE end_states[2];
+	bool is_end_created[2];
+	size_t ref_count;
+} MEMORY_PAIR_INSTANCE;
+
+typedef struct MEMORY_PAIR_IO_INSTANCE_TAG
+{
+	MEMORY_PAIR_INSTANCE* memory_pair;
+	MEMORY_PAIR_END end;
+	IO_STATE io_state;
+	ON_BYTES_RECEIVED on_bytes_received;
+	ON_IO_ERROR on_io_error;
+	void* on_bytes_received_context;
+	void* on_io_error_context;
+} MEMORY_PAIR_IO_INSTANCE;
+
+static MEMORY_PAIR_END get_peer_end(MEMORY_PAIR_END end)
+{
+	return (end == MEMORY_PAIR_END_FIRST) ? MEMORY_PAIR_END_SECOND : MEMORY_PAIR_END_FIRST;
+}
+
+static int ring_init(MEMORY_RING* ring, size_t capacity)
+{
+	int result;
+
+	ring->bytes = (unsigned char*)malloc(capacity);
+	if (ring->bytes == NULL)
+	{
+		LogError("Cannot allocate %u bytes for the ring", (unsigned int)capacity);
+		result = __FAILURE__;
+	}
+	else
+	{
+		ring->capacity = capacity;
+		ring->read_position = 0;
+		ring->used = 0;
+		result = 0;
+	}
+
+	return result;
+}
+
+static int ring_write(MEMORY_RING* ring, const unsigned char* bytes, size_t size)
+{
+	int result;
+
+	if (size > ring->capacity - ring->used)
+	{
+		/* grow and unwrap, the new capacity is at least double so this is amortized O(1) per byte */
+		size_t new_capacity = ring->capacity * 2;
+		unsigned char* new_bytes;
+
+		while (new_capacity - ring->used < size)
+		{
+			new_capacity *= 2;
+		}
+
+		new_bytes = (unsigned char*)malloc(new_capacity);
+		if (new_bytes == NULL)
+		{
+			LogError("Cannot grow the ring to %u bytes", (unsigned int)new_capacity);
+			result = __FAILURE__;
+		}
+		else
+		{
+			size_t first_part = ring->capacity - ring->read_position;
+			if (first_part > ring->used)
+			{
+				first_part = ring->used;
+			}
+
+			(void)memcpy(new_bytes, ring->bytes + ring->read_position, first_part);
+			(void)memcpy(new_bytes + first_part, ring->bytes, ring->used - first_part);
+			free(ring->bytes);
+
+			ring->bytes = new_bytes;
+			ring->capacity = new_capacity;
+			ring->read_position = 0;
+			result = 0;
+		}
+	}
+	else
+	{
+		result = 0;
+	}
+
+	if (result == 0)
+	{
+		size_t write_position = (ring->read_position + ring->used) % ring->capacity;
+		size_t first_part = ring->capacity - write_position;
+		if (first_part > size)
+		{
+			first_part = size;
+		}
+
+		(void)memcpy(ring->bytes + write_position, bytes, first_part);
+		(void)memcpy(ring->bytes, bytes + first_part, size - first_part);
+		ring->used += size;
+	}
+
+	return result;
+}
+
+static void release_memory_pair(MEMORY_PAIR_INSTANCE* memory_pair)
+{
+	memory_pair->ref_count--;
+	if (memory_pair->ref_count == 0)
+	{
+		free(memory_pair->rings[0].bytes);
+		free(memory_pair->rings[1].bytes);
+		free(memory_pair);
+	}
+}
+
+static void indicate_error(MEMORY_PAIR_IO_INSTANCE* memory_pair_io_instance)
+{
+	memory_pair_io_instance->io_state = IO_STATE_ERROR;
+	if (memory_pair_io_instance->on_io_error != NULL)
+	{
+		memory_pair_io_instance->on_io_error(memory_pair_io_instance->on_io_error_context);
+	}
+}
+
+MEMORY_PAIR_HANDLE memorypairio_create_pair(size_t initial_buffer_size)
+{
+	MEMORY_PAIR_INSTANCE* result = (MEMORY_PAIR_INSTANCE*)malloc(sizeof(MEMORY_PAIR_INSTANCE));
+	if (result == NULL)
+	{
+		LogError("Cannot allocate memory for the memory pair");
+	}
+	else
+	{
+		size_t buffer_size = (initial_buffer_size == 0) ? DEFAULT_BUFFER_SIZE : initial_buffer_size;
+
+		if (ring_init(&result->rings[0], buffer_size) != 0)
+		{
+			free(result);
+			result = NULL;
+		}
+		else if (ring_init(&result->rings[1], buffer_size) != 0)
+		{
+			free(result->rings[0].bytes);
+			free(result);
+			result = NULL;
+		}
+		else
+		{
+			result->end_states[0] = END_STATE_IDLE;
+			result->end_states[1] = END_STATE_IDLE;
+			result->is_end_created[0] = false;
+			result->is_end_created[1] = false;
+			result->ref_count = 1;
+		}
+	}
+
+	return result;
+}
+
+void memorypairio_destroy_pair(MEMORY_PAIR_HANDLE memory_pair)
+{
+	if (memory_pair == NULL)
+	{
+		LogError("NULL memory_pair");
+	}
+	else
+	{
+		release_memory_pair(memory_pair);
+	}
+}
+
+CONCRETE_IO_HANDLE memorypairio_create(void* io_create_parameters)
+{
+	MEMORY_PAIR_IO_INSTANCE* result;
+	MEMORYPAIRIO_CONFIG* memory_pair_io_config = (MEMORYPAIRIO_CONFIG*)io_create_parameters;
+
+	if ((memory_pair_io_config == NULL) ||
+		(memory_pair_io_config->memory_pair == NULL) ||
+		((memory_pair_io_config->end != MEMORY_PAIR_END_FIRST) && (memory_pair_io_config->end != MEMORY_PAIR_END_SECOND)))
+	{
+		LogError("Bad memory pair IO configuration");
+		result = NULL;
+	}
+	else if (memory_pair_io_config->memory_pair->is_end_created[memory_pair_io_config->end])
+	{
+		LogError("An IO was already created for this end of the memory pair");
+		result = NULL;
+	}
+	else
+	{
+		result = (MEMORY_PAIR_IO_INSTANCE*)malloc(sizeof(MEMORY_PAIR_IO_INSTANCE));
+		if (result == NULL)
+		{
+			LogError("Cannot allocate memory for the memory pair IO");
+		}
+		else
+		{
+			result->memory_pair = memory_pair_io_config->memory_pair;
+			result->end = memory_pair_io_config->end;
+			result->io_state = IO_STATE_NOT_OPEN;
+			result->on_bytes_received = NULL;
+			result->on_io_error = NULL;
+			result->on_bytes_received_context = NULL;
+			result->on_io_error_context = NULL;
+
+			result->memory_pair->is_end_created[result->end] = true;
+			result->memory_pair->ref_count++;
+		}
+	}
+
+	return result;
+}
+
+void memorypairio_destroy(CONCRETE_IO_HANDLE memory_pair_io)
+{
+	if (memory_pair_io != NULL)
+	{
+		MEMORY_PAIR_IO_INSTANCE* memory_pair_io_instance = (MEMORY_PAIR_IO_INSTANCE*)memory_pair_io;
+
+		if (memory_pair_io_instance->io_state != IO_STATE_NOT_OPEN)
+		{
+			(void)memorypairio_close(memory_pair_io, NULL, NULL);
+		}
+
+		/* the peer sees a destroyed end as closed, even one that never opened */
+		memory_pair_io_instance->memory_pair->end_states[memory_pair_io_instance->end] = END_STATE_CLOSED;
+		memory_pair_io_instance->memory_pair->is_end_created[memory_pair_io_instance->end] = false;
+		release_memory_pair(memory_pair_io_instance->memory_pair);
+		free(memory_pair_io_instance);
+	}
+}
+
+int memorypairio_open(CONCRETE_IO_HANDLE memory_pair_io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+	int result;
+
+	if ((memory_pair_io == NULL) ||
+		(on_bytes_received == NULL))
+	{
+		LogError("Bad arguments: memory_pair_io = %p, on_bytes_received = %p",
+			memory_pair_io, on_bytes_received);
+		result = __FAILURE__;
+	}
+	else
+	{
+		MEMORY_PAIR_IO_INSTANCE* memory_pair_io_instance = (MEMORY_PAIR_IO_INSTANCE*)memory_pair_io;
+
+		if (memory_pair_io_instance->io_state != IO_STATE_NOT_OPEN)
+		{
+			LogError("Memory pair IO already open");
+			result = __FAILURE__;
+		}
+		else
+		{
+			memory_pair_io_instance->on_bytes_received = on_bytes_received;
+			memory_pair_io_instance->on_bytes_received_context = on_bytes_received_context;
+			memory_pair_io_instance->on_io_error = on_io_error;
+			memory_pair_io_instance->on_io_error_context = on_io_error_context;
+			memory_pair_io_instance->io_state = IO_STATE_OPEN;
+			memory_pair_io_instance->memory_pair->end_states[memory_pair_io_instance->end] = END_STATE_OPEN;
+
+			/* there is nothing to connect, bytes the peer already sent are indicated from the next dowork */
+			if (on_io_open_complete != NULL)
+			{
+				on_io_open_complete(on_io_open_complete_context, IO_OPEN_OK);
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+int memorypairio_close(CONCRETE_IO_HANDLE memory_pair_io, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+	int result;
+
+	if (memory_pair_io == NULL)
+	{
+		LogError("NULL memory_pair_io");
+		result = __FAILURE__;
+	}
+	else
+	{
+		MEMORY_PAIR_IO_INSTANCE* memory_pair_io_instance = (MEMORY_PAIR_IO_INSTANCE*)memory_pair_io;
+
+		if (memory_pair_io_instance->io_state == IO_STATE_NOT_OPEN)
+		{
+			LogError("Memory pair IO not open");
+			result = __FAILURE__;
+		}
+		else
+		{
+			/* like a socket, whatever was not read yet is dropped */
+			memory_pair_io_instance->memory_pair->rings[memory_pair_io_instance->end].used = 0;
+			memory_pair_io_instance->memory_pair->end_states[memory_pair_io_instance->end] = END_STATE_CLOSED;
+			memory_pair_io_instance->io_state = IO_STATE_NOT_OPEN;
+
+			if (on_io_close_complete != NULL)
+			{
+				on_io_close_complete(callback_context);
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+int memorypairio_send(CONCRETE_IO_HANDLE memory_pair_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	int result;
+
+	if ((memory_pair_io == NULL) ||
+		(buffer == NULL) ||
+		(size == 0))
+	{
+		LogError("Bad arguments: memory_pair_io = %p, buffer = %p, size = %u",
+			memory_pair_io, buffer, (unsigned int)size);
+		result = __FAILURE__;
+	}
+	else
+	{
+		MEMORY_PAIR_IO_INSTANCE* memory_pair_io_instance = (MEMORY_PAIR_IO_INSTANCE*)memory_pair_io;
+		MEMORY_PAIR_END peer_end = get_peer_end(memory_pair_io_instance->end);
+
+		if (memory_pair_io_instance->io_state != IO_STATE_OPEN)
+		{
+			LogError("Memory pair IO not open");
+			result = __FAILURE__;
+		}
+		else if ((memory_pair_io_instance->memory_pair->end_states[peer_end] != END_STATE_CLOSED) &&
+			(ring_write(&memory_pair_io_instance->memory_pair->rings[peer_end], (const unsigned char*)buffer, size) != 0))
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			/* the bytes are owned by the ring now, which is as far as a socket send would take them.
+			   As with a socket whose peer just closed, bytes sent to a closed end are dropped and the close shows up as an error from dowork */
+			if (on_send_complete != NULL)
+			{
+				on_send_complete(callback_context, IO_SEND_OK);
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+void memorypairio_dowork(CONCRETE_IO_HANDLE memory_pair_io)
+{
+	if (memory_pair_io != NULL)
+	{
+		MEMORY_PAIR_IO_INSTANCE* memory_pair_io_instance = (MEMORY_PAIR_IO_INSTANCE*)memory_pair_io;
+		MEMORY_RING* ring = &memory_pair_io_instance->memory_pair->rings[memory_pair_io_instance->end];
+
+		/* only the peer writes to this ring and it does not run from our callbacks, so the ring cannot move under us;
+		   the state is still rechecked since the callback may close this end */
+		while ((memory_pair_io_instance->io_state == IO_STATE_OPEN) &&
+			(ring->used > 0))
+		{
+			const unsigned char* chunk = ring->bytes + ring->read_position;
+			size_t chunk_size = ring->capacity - ring->read_position;
+			if (chunk_size > ring->used)
+			{
+				chunk_size = ring->used;
+			}
+
+			ring->read_position = (ring->read_position + chunk_size) % ring->capacity;
+			ring->used -= chunk_size;
+
+			memory_pair_io_instance->on_bytes_received(memory_pair_io_instance->on_bytes_received_context, chunk, chunk_size);
+		}
+
+		if ((memory_pair_io_instance->io_state == IO_STATE_OPEN) &&
+			(memory_pair_io_instance->memory_pair->end_states[get_peer_end(memory_pair_io_instance->end)] == END_STATE_CLOSED))
+		{
+			LogError("The other end of the memory pair was closed");
+			indicate_error(memory_pair_io_instance);
+		}
+	}
+}
+
+int memorypairio_setoption(CONCRETE_IO_HANDLE memory_pair_io, const char* optionName, const void* value)
+{
+	int result;
+
+	(void)value;
+
+	if ((memory_pair_io == NULL) ||
+		(optionName == NULL))
+	{
+		LogError("Bad arguments: memory_pair_io = %p, optionName = %p",
+			memory_pair_io, optionName);
+		result = __FAILURE__;
+	}
+	else
+	{
+		LogError("Unknown option %s", optionName);
+		result = __FAILURE__;
+	}
+
+	return result;
+}
+
+static void* memorypairio_CloneOption(const char* name, const void* value)
+{
+	(void)name;
+	(void)value;
+	return NULL;
+}
+
+static void memorypairio_DestroyOption(const char* name, const void* value)
+{
+	(void)name;
+	(void)value;
+}
+
+static OPTIONHANDLER_HANDLE memorypairio_retrieveoptions(CONCRETE_IO_HANDLE handle)
+{
+	OPTIONHANDLER_HANDLE result;
+	(void)handle;
+	result = OptionHandler_Create(memorypairio_CloneOption, memorypairio_DestroyOption, memorypairio_setoption);
+	if (result == NULL)
+	{
+		LogError("unable to OptionHandler_Create");
+	}
+	return result;
+}
+
+static const IO_INTERFACE_DESCRIPTION memory_pair_io_interface_description =
+{
+	memorypairio_retrieveoptions,
+	memorypairio_create,
+	memorypairio_destroy,
+	memorypairio_open,
+	memorypairio_close,
+	memorypairio_send,
+	memorypairio_dowork,
+	memorypairio_setoption
+};
+
+const IO_INTERFACE_DESCRIPTION* memorypairio_get_interface_description(void)
+{
+	return &memory_pair_io_interface_description;
+}
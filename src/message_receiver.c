@@ -2,13 +2,57 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
 #include "azure_uamqp_c/message_receiver.h"
 #include "azure_uamqp_c/amqpvalue.h"
 #include "azure_uamqp_c/amqp_definitions.h"
 
+/* descriptor codes of the message sections */
+#define HEADER_SECTION_CODE 0x70
+#define DATA_SECTION_CODE 0x75
+#define AMQP_SEQUENCE_SECTION_CODE 0x76
+#define AMQP_VALUE_SECTION_CODE 0x77
+#define FOOTER_SECTION_CODE 0x78
+#define UNKNOWN_SECTION_CODE UINT64_MAX
+
+/* enough for the constructor and descriptor of any section (the longest symbol is amqp:application-properties:map)
+   and the constructor and size of its value */
+#define MAX_SECTION_HEADER_SIZE 64
+
+typedef struct SECTION_SYMBOL_TAG
+{
+	const char* symbol;
+	uint64_t code;
+} SECTION_SYMBOL;
+
+static const SECTION_SYMBOL section_symbols[] =
+{
+	{ "amqp:header:list", HEADER_SECTION_CODE },
+	{ "amqp:delivery-annotations:map", 0x71 },
+	{ "amqp:message-annotations:map", 0x72 },
+	{ "amqp:properties:list", 0x73 },
+	{ "amqp:application-properties:map", 0x74 },
+	{ "amqp:data:binary", DATA_SECTION_CODE },
+	{ "amqp:amqp-sequence:list", AMQP_SEQUENCE_SECTION_CODE },
+	{ "amqp:amqp-value:*", AMQP_VALUE_SECTION_CODE },
+	{ "amqp:footer:map", FOOTER_SECTION_CODE }
+};
+
+typedef enum STREAM_DECODE_STATE_TAG
+{
+	/* collecting the first bytes of a section, up to the size of its value */
+	STREAM_DECODE_STATE_SECTION_HEADER,
+	/* a section other than data, fed to the value decoder */
+	STREAM_DECODE_STATE_SECTION_VALUE,
+	/* the bytes of a data section, handed to the application */
+	STREAM_DECODE_STATE_DATA
+} STREAM_DECODE_STATE;
+
 typedef struct MESSAGE_RECEIVER_INSTANCE_TAG
 {
 	LINK_HANDLE link;
@@ -19,6 +63,21 @@ typedef struct MESSAGE_RECEIVER_INSTANCE_TAG
 	const void* callback_context;
 	MESSAGE_HANDLE decoded_message;
 	bool decode_error;
+	bool is_value_decoded;
+
+	/* streaming receive, see messagereceiver_open_streaming */
+	ON_MESSAGE_SECTIONS_RECEIVED on_message_sections_received;
+	ON_MESSAGE_BODY_DATA_RECEIVED on_message_body_data_received;
+	ON_STREAMED_MESSAGE_RECEIVED on_streamed_message_received;
+	AMQPVALUE_DECODER_HANDLE stream_decoder;
+	STREAM_DECODE_STATE stream_decode_state;
+	unsigned char section_header[MAX_SECTION_HEADER_SIZE];
+	size_t section_header_size;
+	bool is_section_size_known;
+	uint32_t section_bytes_left;
+	uint32_t data_section_index;
+	bool are_sections_indicated;
+	bool is_stream_error;
 } MESSAGE_RECEIVER_INSTANCE;
 
 static void set_message_receiver_state(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance, MESSAGE_RECEIVER_STATE new_state)
@@ -37,6 +96,8 @@ static void decode_message_value_callback(void* context, AMQP_VALUE decoded_valu
 	MESSAGE_HANDLE decoded_message = message_receiver_instance->decoded_message;
 	AMQP_VALUE descriptor = amqpvalue_get_inplace_descriptor(decoded_value);
 
+	message_receiver_instance->is_value_decoded = true;
+
 	if (is_application_properties_type_by_descriptor(descriptor))
 	{
 		if (message_set_application_properties(decoded_message, decoded_value) != 0)
@@ -197,6 +258,7 @@ static AMQP_VALUE on_transfer_received(void* context, TRANSFER_HANDLE transfer,
 				}
 
 				amqpvalue_decoder_destroy(amqpvalue_decoder);
+				message_receiver_instance->decoded_message = NULL;
 			}
 
 			message_destroy(message);
@@ -206,6 +268,459 @@ static AMQP_VALUE on_transfer_received(void* context, TRANSFER_HANDLE transfer,
 	return result;
 }
 
+/* the size of an encoded primitive value from its first bytes: the constructor and size field, and what follows them.
+   Returns 0, 1 when more bytes are needed to tell, or __FAILURE__ for a described value or an invalid constructor */
+static int get_encoded_value_size(const unsigned char* bytes, size_t size, size_t* header_size, uint32_t* content_size)
+{
+	int result;
+
+	if (size == 0)
+	{
+		result = 1;
+	}
+	else
+	{
+		switch (bytes[0] >> 4)
+		{
+		default:
+			result = __FAILURE__;
+			break;
+
+		case 0x4:
+		case 0x5:
+		case 0x6:
+		case 0x7:
+		case 0x8:
+		case 0x9:
+		{
+			/* fixed width: 0, 1, 2, 4, 8 and 16 bytes */
+			static const uint32_t fixed_widths[] = { 0, 1, 2, 4, 8, 16 };
+			*header_size = 1;
+			*content_size = fixed_widths[(bytes[0] >> 4) - 0x4];
+			result = 0;
+			break;
+		}
+
+		case 0xA:
+		case 0xC:
+		case 0xE:
+			if (size < 2)
+			{
+				result = 1;
+			}
+			else
+			{
+				*header_size = 2;
+				*content_size = bytes[1];
+				result = 0;
+			}
+			break;
+
+		case 0xB:
+		case 0xD:
+		case 0xF:
+			if (size < 5)
+			{
+				result = 1;
+			}
+			else
+			{
+				*header_size = 5;
+				*content_size = ((uint32_t)bytes[1] << 24) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 8) | (uint32_t)bytes[4];
+				result = 0;
+			}
+			break;
+		}
+	}
+
+	return result;
+}
+
+static uint64_t get_section_code(const unsigned char* descriptor_bytes, size_t descriptor_header_size, uint32_t descriptor_content_size)
+{
+	uint64_t result = UNKNOWN_SECTION_CODE;
+	const unsigned char* content = descriptor_bytes + descriptor_header_size;
+
+	switch (descriptor_bytes[0])
+	{
+	default:
+		break;
+
+	case 0x44: /* ulong0 */
+		result = 0;
+		break;
+
+	case 0x53: /* smallulong */
+		result = content[0];
+		break;
+
+	case 0x80: /* ulong */
+	{
+		size_t i;
+		result = 0;
+		for (i = 0; i < 8; i++)
+		{
+			result = (result << 8) | content[i];
+		}
+		break;
+	}
+
+	case 0xA3: /* sym8 */
+	case 0xB3: /* sym32 */
+	{
+		size_t i;
+		for (i = 0; i < sizeof(section_symbols) / sizeof(section_symbols[0]); i++)
+		{
+			if ((strlen(section_symbols[i].symbol) == descriptor_content_size) &&
+				(memcmp(section_symbols[i].symbol, content, descriptor_content_size) == 0))
+			{
+				result = section_symbols[i].code;
+				break;
+			}
+		}
+		break;
+	}
+	}
+
+	return result;
+}
+
+/* parses the section_header bytes collected so far: the described constructor, the descriptor and the constructor and
+   size of the value. Returns 0 once they are all there, 1 when more bytes are needed, __FAILURE__ when not a section.
+   The size of a value that is itself described is not known from its constructor. */
+static int parse_section_header(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance, uint64_t* section_code, unsigned char* value_constructor, size_t* header_size, uint32_t* content_size)
+{
+	int result;
+	const unsigned char* bytes = message_receiver_instance->section_header;
+	size_t size = message_receiver_instance->section_header_size;
+	size_t descriptor_header_size;
+	uint32_t descriptor_content_size;
+
+	if (bytes[0] != 0x00)
+	{
+		result = __FAILURE__;
+	}
+	else if ((result = get_encoded_value_size(bytes + 1, size - 1, &descriptor_header_size, &descriptor_content_size)) == 0)
+	{
+		size_t value_offset = 1 + descriptor_header_size + descriptor_content_size;
+
+		if (size <= value_offset)
+		{
+			result = 1;
+		}
+		else
+		{
+			*section_code = get_section_code(bytes + 1, descriptor_header_size, descriptor_content_size);
+			*value_constructor = bytes[value_offset];
+
+			if (bytes[value_offset] == 0x00)
+			{
+				message_receiver_instance->is_section_size_known = false;
+				*header_size = value_offset + 1;
+				*content_size = 0;
+			}
+			else
+			{
+				size_t value_header_size;
+
+				message_receiver_instance->is_section_size_known = true;
+				result = get_encoded_value_size(bytes + value_offset, size - value_offset, &value_header_size, content_size);
+				*header_size = value_offset + value_header_size;
+			}
+		}
+	}
+
+	return result;
+}
+
+static void indicate_message_sections(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance)
+{
+	if (!message_receiver_instance->are_sections_indicated)
+	{
+		message_receiver_instance->are_sections_indicated = true;
+		if (message_receiver_instance->on_message_sections_received != NULL)
+		{
+			message_receiver_instance->on_message_sections_received(message_receiver_instance->callback_context, message_receiver_instance->decoded_message);
+		}
+	}
+}
+
+static void end_section(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance)
+{
+	message_receiver_instance->stream_decode_state = STREAM_DECODE_STATE_SECTION_HEADER;
+	message_receiver_instance->section_header_size = 0;
+}
+
+static int start_section(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance, uint64_t section_code, unsigned char value_constructor, size_t header_size, uint32_t content_size)
+{
+	int result;
+	MESSAGE_BODY_TYPE body_type;
+
+	/* what precedes the body is complete once the body or the footer starts */
+	if ((section_code >= DATA_SECTION_CODE) &&
+		(section_code <= FOOTER_SECTION_CODE))
+	{
+		indicate_message_sections(message_receiver_instance);
+	}
+
+	if (section_code == DATA_SECTION_CODE)
+	{
+		if ((message_get_body_type(message_receiver_instance->decoded_message, &body_type) != 0) ||
+			(body_type != MESSAGE_BODY_TYPE_NONE) ||
+			!message_receiver_instance->is_section_size_known ||
+			((value_constructor != 0xA0) && (value_constructor != 0xB0)))
+		{
+			LogError("Bad data section");
+			result = __FAILURE__;
+		}
+		else
+		{
+			message_receiver_instance->section_bytes_left = content_size;
+			if (content_size == 0)
+			{
+				message_receiver_instance->data_section_index++;
+				end_section(message_receiver_instance);
+			}
+			else
+			{
+				message_receiver_instance->stream_decode_state = STREAM_DECODE_STATE_DATA;
+			}
+
+			result = 0;
+		}
+	}
+	else if ((message_receiver_instance->data_section_index > 0) &&
+		((section_code == AMQP_VALUE_SECTION_CODE) || (section_code == AMQP_SEQUENCE_SECTION_CODE)))
+	{
+		LogError("Body section after data sections");
+		result = __FAILURE__;
+	}
+	else
+	{
+		message_receiver_instance->is_value_decoded = false;
+
+		if ((amqpvalue_decode_bytes(message_receiver_instance->stream_decoder, message_receiver_instance->section_header, header_size) != 0) ||
+			message_receiver_instance->decode_error)
+		{
+			LogError("Cannot decode message section");
+			result = __FAILURE__;
+		}
+		else
+		{
+			message_receiver_instance->section_bytes_left = content_size;
+			if (message_receiver_instance->is_section_size_known && (content_size == 0))
+			{
+				end_section(message_receiver_instance);
+			}
+			else
+			{
+				message_receiver_instance->stream_decode_state = STREAM_DECODE_STATE_SECTION_VALUE;
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static int decode_stream_bytes(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance, const unsigned char* bytes, size_t size)
+{
+	int result = 0;
+
+	while ((result == 0) &&
+		(size > 0))
+	{
+		switch (message_receiver_instance->stream_decode_state)
+		{
+		default:
+			result = __FAILURE__;
+			break;
+
+		case STREAM_DECODE_STATE_SECTION_HEADER:
+			if (message_receiver_instance->section_header_size == MAX_SECTION_HEADER_SIZE)
+			{
+				LogError("Message section header too long");
+				result = __FAILURE__;
+			}
+			else
+			{
+				uint64_t section_code;
+				unsigned char value_constructor;
+				size_t header_size;
+				uint32_t content_size;
+				int parse_result;
+
+				message_receiver_instance->section_header[message_receiver_instance->section_header_size++] = bytes[0];
+				bytes++;
+				size--;
+
+				parse_result = parse_section_header(message_receiver_instance, &section_code, &value_constructor, &header_size, &content_size);
+				if (parse_result == 0)
+				{
+					result = start_section(message_receiver_instance, section_code, value_constructor, header_size, content_size);
+				}
+				else if (parse_result != 1)
+				{
+					LogError("Not a message section");
+					result = __FAILURE__;
+				}
+			}
+			break;
+
+		case STREAM_DECODE_STATE_DATA:
+		{
+			size_t to_indicate = (size < message_receiver_instance->section_bytes_left) ? size : message_receiver_instance->section_bytes_left;
+
+			if (message_receiver_instance->on_message_body_data_received != NULL)
+			{
+				message_receiver_instance->on_message_body_data_received(message_receiver_instance->callback_context, message_receiver_instance->data_section_index, bytes, to_indicate);
+			}
+
+			bytes += to_indicate;
+			size -= to_indicate;
+			message_receiver_instance->section_bytes_left -= (uint32_t)to_indicate;
+
+			if (message_receiver_instance->section_bytes_left == 0)
+			{
+				message_receiver_instance->data_section_index++;
+				end_section(message_receiver_instance);
+			}
+			break;
+		}
+
+		case STREAM_DECODE_STATE_SECTION_VALUE:
+		{
+			/* without a known size the decoder is fed a byte at a time, so that it does not run into the next section */
+			size_t to_decode = !message_receiver_instance->is_section_size_known ? 1 :
+				(size < message_receiver_instance->section_bytes_left) ? size : message_receiver_instance->section_bytes_left;
+
+			if ((amqpvalue_decode_bytes(message_receiver_instance->stream_decoder, bytes, to_decode) != 0) ||
+				message_receiver_instance->decode_error)
+			{
+				LogError("Cannot decode message section");
+				result = __FAILURE__;
+			}
+			else
+			{
+				bytes += to_decode;
+				size -= to_decode;
+
+				if (message_receiver_instance->is_section_size_known)
+				{
+					message_receiver_instance->section_bytes_left -= (uint32_t)to_decode;
+					if (message_receiver_instance->section_bytes_left == 0)
+					{
+						end_section(message_receiver_instance);
+					}
+				}
+				else if (message_receiver_instance->is_value_decoded)
+				{
+					end_section(message_receiver_instance);
+				}
+			}
+			break;
+		}
+		}
+	}
+
+	return result;
+}
+
+static void end_streamed_message(MESSAGE_RECEIVER_INSTANCE* message_receiver_instance)
+{
+	if (message_receiver_instance->stream_decoder != NULL)
+	{
+		amqpvalue_decoder_destroy(message_receiver_instance->stream_decoder);
+		message_receiver_instance->stream_decoder = NULL;
+	}
+
+	if (message_receiver_instance->decoded_message != NULL)
+	{
+		message_destroy(message_receiver_instance->decoded_message);
+		message_receiver_instance->decoded_message = NULL;
+	}
+
+	message_receiver_instance->is_stream_error = false;
+}
+
+static AMQP_VALUE on_transfer_chunk_received(void* context, TRANSFER_HANDLE transfer, uint32_t payload_size, const unsigned char* payload_bytes, bool more)
+{
+	AMQP_VALUE result = NULL;
+	MESSAGE_RECEIVER_INSTANCE* message_receiver_instance = (MESSAGE_RECEIVER_INSTANCE*)context;
+	bool aborted = false;
+
+	(void)transfer_get_aborted(transfer, &aborted);
+
+	if (aborted)
+	{
+		/* the sender gave up on the message, whatever was indicated of it is all there will be */
+		end_streamed_message(message_receiver_instance);
+	}
+	/* first chunk of a delivery */
+	else if ((message_receiver_instance->stream_decoder == NULL) &&
+		!message_receiver_instance->is_stream_error)
+	{
+		message_receiver_instance->decoded_message = message_create();
+		if (message_receiver_instance->decoded_message == NULL)
+		{
+			message_receiver_instance->is_stream_error = true;
+		}
+		else
+		{
+			message_receiver_instance->stream_decoder = amqpvalue_decoder_create(decode_message_value_callback, message_receiver_instance);
+			if (message_receiver_instance->stream_decoder == NULL)
+			{
+				message_receiver_instance->is_stream_error = true;
+			}
+			else
+			{
+				message_receiver_instance->decode_error = false;
+				message_receiver_instance->stream_decode_state = STREAM_DECODE_STATE_SECTION_HEADER;
+				message_receiver_instance->section_header_size = 0;
+				message_receiver_instance->data_section_index = 0;
+				message_receiver_instance->are_sections_indicated = false;
+			}
+		}
+
+		if (message_receiver_instance->is_stream_error)
+		{
+			set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
+		}
+	}
+
+	if (!aborted &&
+		!message_receiver_instance->is_stream_error &&
+		(payload_size > 0) &&
+		(decode_stream_bytes(message_receiver_instance, payload_bytes, payload_size) != 0))
+	{
+		message_receiver_instance->is_stream_error = true;
+		set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
+	}
+
+	if (!more && !aborted)
+	{
+		if (!message_receiver_instance->is_stream_error)
+		{
+			if ((message_receiver_instance->stream_decode_state != STREAM_DECODE_STATE_SECTION_HEADER) ||
+				(message_receiver_instance->section_header_size > 0))
+			{
+				LogError("Delivery ended in the middle of a message section");
+				set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
+			}
+			else
+			{
+				indicate_message_sections(message_receiver_instance);
+				result = message_receiver_instance->on_streamed_message_received(message_receiver_instance->callback_context, message_receiver_instance->decoded_message);
+			}
+		}
+
+		end_streamed_message(message_receiver_instance);
+	}
+
+	return result;
+}
+
 static void on_link_state_changed(void* context, LINK_STATE new_link_state, LINK_STATE previous_link_state)
 {
 	MESSAGE_RECEIVER_INSTANCE* message_receiver_instance = (MESSAGE_RECEIVER_INSTANCE*)context;
@@ -253,6 +768,12 @@ MESSAGE_RECEIVER_HANDLE messagereceiver_create(LINK_HANDLE link, ON_MESSAGE_RECE
 		result->on_message_receiver_state_changed = on_message_receiver_state_changed;
 		result->on_message_receiver_state_changed_context = context;
 		result->message_receiver_state = MESSAGE_RECEIVER_STATE_IDLE;
+		result->decoded_message = NULL;
+		result->on_message_sections_received = NULL;
+		result->on_message_body_data_received = NULL;
+		result->on_streamed_message_received = NULL;
+		result->stream_decoder = NULL;
+		result->is_stream_error = false;
 	}
 
 	return result;
@@ -263,6 +784,7 @@ void messagereceiver_destroy(MESSAGE_RECEIVER_HANDLE message_receiver)
 	if (message_receiver != NULL)
 	{
 		(void)messagereceiver_close(message_receiver);
+		end_streamed_message(message_receiver);
 		free(message_receiver);
 	}
 }
@@ -282,7 +804,8 @@ int messagereceiver_open(MESSAGE_RECEIVER_HANDLE message_receiver, ON_MESSAGE_RE
 		if (message_receiver_instance->message_receiver_state == MESSAGE_RECEIVER_STATE_IDLE)
 		{
 			set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_OPENING);
-			if (link_attach(message_receiver_instance->link, on_transfer_received, on_link_state_changed, NULL, message_receiver_instance) != 0)
+			if ((link_set_on_transfer_chunk_received(message_receiver_instance->link, NULL) != 0) ||
+				(link_attach(message_receiver_instance->link, on_transfer_received, on_link_state_changed, NULL, message_receiver_instance) != 0))
 			{
 				result = __FAILURE__;
 				set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
@@ -304,6 +827,51 @@ int messagereceiver_open(MESSAGE_RECEIVER_HANDLE message_receiver, ON_MESSAGE_RE
 	return result;
 }
 
+int messagereceiver_open_streaming(MESSAGE_RECEIVER_HANDLE message_receiver, ON_MESSAGE_SECTIONS_RECEIVED on_message_sections_received, ON_MESSAGE_BODY_DATA_RECEIVED on_message_body_data_received, ON_STREAMED_MESSAGE_RECEIVED on_streamed_message_received, void* callback_context)
+{
+	int result;
+
+	if ((message_receiver == NULL) ||
+		(on_streamed_message_received == NULL))
+	{
+		LogError("Bad arguments: message_receiver = %p, on_streamed_message_received = %p",
+			message_receiver, on_streamed_message_received);
+		result = __FAILURE__;
+	}
+	else
+	{
+		MESSAGE_RECEIVER_INSTANCE* message_receiver_instance = (MESSAGE_RECEIVER_INSTANCE*)message_receiver;
+
+		if (message_receiver_instance->message_receiver_state == MESSAGE_RECEIVER_STATE_IDLE)
+		{
+			/* set before the attach, transfers can arrive as soon as the link is attached */
+			message_receiver_instance->on_message_received = NULL;
+			message_receiver_instance->on_message_sections_received = on_message_sections_received;
+			message_receiver_instance->on_message_body_data_received = on_message_body_data_received;
+			message_receiver_instance->on_streamed_message_received = on_streamed_message_received;
+			message_receiver_instance->callback_context = callback_context;
+
+			set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_OPENING);
+			if ((link_set_on_transfer_chunk_received(message_receiver_instance->link, on_transfer_chunk_received) != 0) ||
+				(link_attach(message_receiver_instance->link, on_transfer_received, on_link_state_changed, NULL, message_receiver_instance) != 0))
+			{
+				result = __FAILURE__;
+				set_message_receiver_state(message_receiver_instance, MESSAGE_RECEIVER_STATE_ERROR);
+			}
+			else
+			{
+				result = 0;
+			}
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
 int messagereceiver_close(MESSAGE_RECEIVER_HANDLE message_receiver)
 {
 	int result;
@@ -0,0 +1,216 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/mpsc_queue.h"
+#include "azure_uamqp_c/message_send_queue.h"
+
+typedef struct SUBMITTED_SEND_TAG
+{
+	MPSC_QUEUE_ITEM queue_item;
+	MESSAGE_HANDLE message;
+	ON_MESSAGE_SEND_COMPLETE on_message_send_complete;
+	void* callback_context;
+
+	/* copied from the queue so that completions arriving after messagesendqueue_destroy still work */
+	ON_MESSAGE_SEND_COMPLETE_EXECUTE on_message_send_complete_execute;
+	void* executor_context;
+} SUBMITTED_SEND;
+
+typedef struct MESSAGE_SEND_QUEUE_INSTANCE_TAG
+{
+	MESSAGE_SENDER_HANDLE message_sender;
+	ON_MESSAGE_SEND_COMPLETE_EXECUTE on_message_send_complete_execute;
+	void* executor_context;
+	MPSC_QUEUE send_queue;
+	int wake_fd;
+
+	/* set by the first submitter after the I/O thread last looked at the queue, so that only one wake is sent */
+	int is_wake_pending;
+} MESSAGE_SEND_QUEUE_INSTANCE;
+
+static void complete_submitted_send(SUBMITTED_SEND* submitted_send, MESSAGE_SEND_RESULT send_result)
+{
+	if (submitted_send->on_message_send_complete != NULL)
+	{
+		if (submitted_send->on_message_send_complete_execute != NULL)
+		{
+			submitted_send->on_message_send_complete_execute(submitted_send->executor_context, submitted_send->on_message_send_complete, submitted_send->callback_context, send_result);
+		}
+		else
+		{
+			submitted_send->on_message_send_complete(submitted_send->callback_context, send_result);
+		}
+	}
+
+	free(submitted_send);
+}
+
+static void on_submitted_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	complete_submitted_send((SUBMITTED_SEND*)context, send_result);
+}
+
+MESSAGE_SEND_QUEUE_HANDLE messagesendqueue_create(MESSAGE_SENDER_HANDLE message_sender, ON_MESSAGE_SEND_COMPLETE_EXECUTE on_message_send_complete_execute, void* executor_context)
+{
+	MESSAGE_SEND_QUEUE_INSTANCE* result;
+
+	if (message_sender == NULL)
+	{
+		LogError("NULL message_sender");
+		result = NULL;
+	}
+	else
+	{
+		result = (MESSAGE_SEND_QUEUE_INSTANCE*)malloc(sizeof(MESSAGE_SEND_QUEUE_INSTANCE));
+		if (result == NULL)
+		{
+			LogError("Cannot allocate memory for the message send queue");
+		}
+		else
+		{
+			result->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (result->wake_fd == -1)
+			{
+				LogError("eventfd failed, errno = %d", errno);
+				free(result);
+				result = NULL;
+			}
+			else
+			{
+				result->message_sender = message_sender;
+				result->on_message_send_complete_execute = on_message_send_complete_execute;
+				result->executor_context = executor_context;
+				result->is_wake_pending = 0;
+				mpsc_queue_init(&result->send_queue);
+			}
+		}
+	}
+
+	return result;
+}
+
+void messagesendqueue_destroy(MESSAGE_SEND_QUEUE_HANDLE message_send_queue)
+{
+	if (message_send_queue == NULL)
+	{
+		LogError("NULL message_send_queue");
+	}
+	else
+	{
+		SUBMITTED_SEND* submitted_send;
+
+		/* messages that never reached the sender are failed, the ones it already has complete through it */
+		while ((submitted_send = (SUBMITTED_SEND*)mpsc_queue_pop(&message_send_queue->send_queue)) != NULL)
+		{
+			message_destroy(submitted_send->message);
+			complete_submitted_send(submitted_send, MESSAGE_SEND_ERROR);
+		}
+
+		(void)close(message_send_queue->wake_fd);
+		free(message_send_queue);
+	}
+}
+
+int messagesendqueue_get_wake_fd(MESSAGE_SEND_QUEUE_HANDLE message_send_queue)
+{
+	int result;
+
+	if (message_send_queue == NULL)
+	{
+		LogError("NULL message_send_queue");
+		result = -1;
+	}
+	else
+	{
+		result = message_send_queue->wake_fd;
+	}
+
+	return result;
+}
+
+int messagesendqueue_submit(MESSAGE_SEND_QUEUE_HANDLE message_send_queue, MESSAGE_HANDLE message, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
+{
+	int result;
+
+	if ((message_send_queue == NULL) ||
+		(message == NULL))
+	{
+		LogError("Bad arguments: message_send_queue = %p, message = %p",
+			message_send_queue, message);
+		result = __FAILURE__;
+	}
+	else
+	{
+		SUBMITTED_SEND* submitted_send = (SUBMITTED_SEND*)malloc(sizeof(SUBMITTED_SEND));
+		if (submitted_send == NULL)
+		{
+			LogError("Cannot allocate memory for the submitted send");
+			result = __FAILURE__;
+		}
+		else
+		{
+			submitted_send->message = message;
+			submitted_send->on_message_send_complete = on_message_send_complete;
+			submitted_send->callback_context = callback_context;
+			submitted_send->on_message_send_complete_execute = message_send_queue->on_message_send_complete_execute;
+			submitted_send->executor_context = message_send_queue->executor_context;
+			mpsc_queue_push(&message_send_queue->send_queue, &submitted_send->queue_item);
+
+			if (__atomic_exchange_n(&message_send_queue->is_wake_pending, 1, __ATOMIC_SEQ_CST) == 0)
+			{
+				uint64_t one = 1;
+
+				/* EAGAIN means the counter is already non-zero, which wakes the I/O thread just as well */
+				if ((write(message_send_queue->wake_fd, &one, sizeof(one)) != (ssize_t)sizeof(one)) &&
+					(errno != EAGAIN))
+				{
+					/* the message is queued, it goes out on the next messagesendqueue_dowork */
+					LogError("Cannot signal the wake fd, errno = %d", errno);
+				}
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+void messagesendqueue_dowork(MESSAGE_SEND_QUEUE_HANDLE message_send_queue)
+{
+	if (message_send_queue == NULL)
+	{
+		LogError("NULL message_send_queue");
+	}
+	else
+	{
+		uint64_t counter;
+		SUBMITTED_SEND* submitted_send;
+
+		/* reset the fd before draining, a submit racing with the drain either is seen here or signals again */
+		(void)read(message_send_queue->wake_fd, &counter, sizeof(counter));
+		__atomic_store_n(&message_send_queue->is_wake_pending, 0, __ATOMIC_SEQ_CST);
+
+		while ((submitted_send = (SUBMITTED_SEND*)mpsc_queue_pop(&message_send_queue->send_queue)) != NULL)
+		{
+			MESSAGE_HANDLE message = submitted_send->message;
+
+			/* messagesender_send keeps its own clone when it has to queue, so the submitted message can go right away */
+			if (messagesender_send(message_send_queue->message_sender, message, on_submitted_send_complete, submitted_send) != 0)
+			{
+				LogError("messagesender_send failed");
+				complete_submitted_send(submitted_send, MESSAGE_SEND_ERROR);
+			}
+
+			message_destroy(message);
+		}
+	}
+}
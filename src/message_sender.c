@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -10,6 +11,19 @@
 #include "azure_uamqp_c/message_sender.h"
 #include "azure_uamqp_c/amqpvalue_to_string.h"
 
+/* frames of a streamed body are read into a buffer of at most this size, whatever the peer's max frame size */
+#define MAX_STREAM_FRAME_SIZE (64 * 1024)
+/* descriptor codes of the sections whose described value is written by hand rather than built as an AMQP value */
+#define APPLICATION_PROPERTIES_SECTION_DESCRIPTOR 0x74
+#define DATA_SECTION_DESCRIPTOR 0x75
+#define AMQP_VALUE_SECTION_DESCRIPTOR 0x77
+/* messages are encoded into a buffer kept by the sender, grown as needed and released after growing past the maximum;
+   the bytes of data sections are not copied there but passed to the link as payloads of their own */
+#define INITIAL_ENCODE_BUFFER_SIZE 256
+#define MAX_POOLED_ENCODE_BUFFER_SIZE (64 * 1024)
+/* completed messages kept for reuse by the next sends */
+#define MAX_FREE_MESSAGE_COUNT 256
+
 typedef enum MESSAGE_SEND_STATE_TAG
 {
     MESSAGE_SEND_STATE_NOT_SENT,
@@ -23,74 +37,261 @@ typedef enum SEND_ONE_MESSAGE_RESULT_TAG
     SEND_ONE_MESSAGE_BUSY
 } SEND_ONE_MESSAGE_RESULT;
 
+struct MESSAGE_LIST_TAG;
+
 typedef struct MESSAGE_WITH_CALLBACK_TAG
 {
+    /* links of the list the message is in, NULL when it is in none */
+    struct MESSAGE_LIST_TAG* list;
+    struct MESSAGE_WITH_CALLBACK_TAG* previous;
+    struct MESSAGE_WITH_CALLBACK_TAG* next;
     MESSAGE_HANDLE message;
     ON_MESSAGE_SEND_COMPLETE on_message_send_complete;
     void* context;
     MESSAGE_SENDER_HANDLE message_sender;
     MESSAGE_SEND_STATE message_send_state;
+    /* see messagesender_send_presettled, forgotten once handed to the link */
+    bool is_presettled;
+    /* see messagesender_send_borrowed_data: a copy of the caller's descriptions of the body, whose bytes stay the caller's */
+    BINARY_DATA* body_data;
+    size_t body_data_count;
+    /* streamed body, see messagesender_send_streamed: the encoded sections before the body are sent first, then the
+       body is read a frame at a time; a frame refused by the link stays in stream_frame to be sent again */
+    ON_MESSAGE_BODY_READ on_message_body_read;
+    void* body_read_context;
+    message_format message_format;
+    unsigned char* stream_prefix;
+    size_t stream_prefix_length;
+    size_t stream_prefix_offset;
+    uint32_t stream_body_remaining;
+    unsigned char* stream_frame;
+    size_t stream_frame_size;
+    size_t stream_frame_length;
+    bool is_stream_started;
 } MESSAGE_WITH_CALLBACK;
 
+typedef struct MESSAGE_LIST_TAG
+{
+    MESSAGE_WITH_CALLBACK* first;
+    MESSAGE_WITH_CALLBACK* last;
+} MESSAGE_LIST;
+
+typedef struct ENCODE_BUFFER_TAG
+{
+    unsigned char* bytes;
+    size_t size;
+    size_t length;
+} ENCODE_BUFFER;
+
 typedef struct MESSAGE_SENDER_INSTANCE_TAG
 {
     LINK_HANDLE link;
+    /* messages waiting for the link, sent in order from the first one, and messages sent and waiting to be settled;
+       a message is moved or removed in constant time */
+    MESSAGE_LIST unsent_messages;
+    MESSAGE_LIST sent_messages;
     size_t message_count;
-    MESSAGE_WITH_CALLBACK** messages;
+    /* singly linked through next */
+    MESSAGE_WITH_CALLBACK* free_messages;
+    size_t free_message_count;
+    ENCODE_BUFFER encode_buffer;
+    /* the payloads a message is handed to the link in, grown as needed */
+    PAYLOAD* payloads;
+    size_t payload_capacity;
     MESSAGE_SENDER_STATE message_sender_state;
     ON_MESSAGE_SENDER_STATE_CHANGED on_message_sender_state_changed;
     void* on_message_sender_state_changed_context;
     unsigned int is_trace_on : 1;
 } MESSAGE_SENDER_INSTANCE;
 
-static void remove_pending_message_by_index(MESSAGE_SENDER_INSTANCE* message_sender_instance, size_t index)
+static void unlink_message(MESSAGE_WITH_CALLBACK* message_with_callback)
 {
-    MESSAGE_WITH_CALLBACK** new_messages;
+    MESSAGE_LIST* list = message_with_callback->list;
 
-    if (message_sender_instance->messages[index]->message != NULL)
+    if (message_with_callback->previous == NULL)
     {
-        message_destroy(message_sender_instance->messages[index]->message);
-        message_sender_instance->messages[index]->message = NULL;
+        list->first = message_with_callback->next;
+    }
+    else
+    {
+        message_with_callback->previous->next = message_with_callback->next;
     }
 
-    free(message_sender_instance->messages[index]);
+    if (message_with_callback->next == NULL)
+    {
+        list->last = message_with_callback->previous;
+    }
+    else
+    {
+        message_with_callback->next->previous = message_with_callback->previous;
+    }
+
+    message_with_callback->list = NULL;
+    message_with_callback->previous = NULL;
+    message_with_callback->next = NULL;
+}
 
-    if (message_sender_instance->message_count - index > 1)
+static void append_message(MESSAGE_LIST* list, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    message_with_callback->list = list;
+    message_with_callback->previous = list->last;
+    message_with_callback->next = NULL;
+
+    if (list->last == NULL)
     {
-        (void)memmove(&message_sender_instance->messages[index], &message_sender_instance->messages[index + 1], sizeof(MESSAGE_WITH_CALLBACK*) * (message_sender_instance->message_count - index - 1));
+        list->first = message_with_callback;
     }
+    else
+    {
+        list->last->next = message_with_callback;
+    }
+
+    list->last = message_with_callback;
+}
 
-    message_sender_instance->message_count--;
+static void prepend_message(MESSAGE_LIST* list, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    message_with_callback->list = list;
+    message_with_callback->previous = NULL;
+    message_with_callback->next = list->first;
 
-    if (message_sender_instance->message_count > 0)
+    if (list->first == NULL)
     {
-        new_messages = (MESSAGE_WITH_CALLBACK**)realloc(message_sender_instance->messages, sizeof(MESSAGE_WITH_CALLBACK*) * (message_sender_instance->message_count));
-        if (new_messages != NULL)
-        {
-            message_sender_instance->messages = new_messages;
-        }
+        list->last = message_with_callback;
     }
     else
     {
-        free(message_sender_instance->messages);
-        message_sender_instance->messages = NULL;
+        list->first->previous = message_with_callback;
     }
+
+    list->first = message_with_callback;
 }
 
-static void remove_pending_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+/* moves a queued message to the list of its new state: a message refused by the link goes back to the head of the
+   unsent messages, where it was taken from */
+static void set_message_send_state(MESSAGE_WITH_CALLBACK* message_with_callback, MESSAGE_SEND_STATE message_send_state)
 {
-    size_t i;
+    message_with_callback->message_send_state = message_send_state;
 
-    for (i = 0; i < message_sender_instance->message_count; i++)
+    if (message_with_callback->list != NULL)
     {
-        if (message_sender_instance->messages[i] == message_with_callback)
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_with_callback->message_sender;
+
+        unlink_message(message_with_callback);
+        if (message_send_state == MESSAGE_SEND_STATE_PENDING)
         {
-            remove_pending_message_by_index(message_sender_instance, i);
-            break;
+            append_message(&message_sender_instance->sent_messages, message_with_callback);
+        }
+        else
+        {
+            prepend_message(&message_sender_instance->unsent_messages, message_with_callback);
         }
     }
 }
 
+static void init_message_with_callback(MESSAGE_WITH_CALLBACK* message_with_callback, MESSAGE_SENDER_INSTANCE* message_sender_instance)
+{
+    message_with_callback->list = NULL;
+    message_with_callback->previous = NULL;
+    message_with_callback->next = NULL;
+    message_with_callback->message = NULL;
+    message_with_callback->on_message_send_complete = NULL;
+    message_with_callback->context = NULL;
+    message_with_callback->message_sender = message_sender_instance;
+    message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+    message_with_callback->is_presettled = false;
+    message_with_callback->body_data = NULL;
+    message_with_callback->body_data_count = 0;
+    message_with_callback->on_message_body_read = NULL;
+    message_with_callback->body_read_context = NULL;
+    message_with_callback->stream_prefix = NULL;
+    message_with_callback->stream_prefix_length = 0;
+    message_with_callback->stream_prefix_offset = 0;
+    message_with_callback->stream_body_remaining = 0;
+    message_with_callback->stream_frame = NULL;
+    message_with_callback->stream_frame_size = 0;
+    message_with_callback->stream_frame_length = 0;
+    message_with_callback->is_stream_started = false;
+}
+
+/* a message taken from the free ones if any, to be queued with queue_message */
+static MESSAGE_WITH_CALLBACK* create_message_with_callback(MESSAGE_SENDER_INSTANCE* message_sender_instance)
+{
+    MESSAGE_WITH_CALLBACK* result = message_sender_instance->free_messages;
+
+    if (result != NULL)
+    {
+        message_sender_instance->free_messages = result->next;
+        message_sender_instance->free_message_count--;
+    }
+    else
+    {
+        result = (MESSAGE_WITH_CALLBACK*)malloc(sizeof(MESSAGE_WITH_CALLBACK));
+    }
+
+    if (result == NULL)
+    {
+        LogError("Cannot allocate memory for the message");
+    }
+    else
+    {
+        init_message_with_callback(result, message_sender_instance);
+    }
+
+    return result;
+}
+
+static void free_message_stream(MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    free(message_with_callback->stream_prefix);
+    message_with_callback->stream_prefix = NULL;
+    free(message_with_callback->stream_frame);
+    message_with_callback->stream_frame = NULL;
+}
+
+/* for a message that is in no list */
+static void destroy_message_with_callback(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    if (message_with_callback->message != NULL)
+    {
+        message_destroy(message_with_callback->message);
+        message_with_callback->message = NULL;
+    }
+
+    free(message_with_callback->body_data);
+    message_with_callback->body_data = NULL;
+
+    free_message_stream(message_with_callback);
+
+    if (message_sender_instance->free_message_count < MAX_FREE_MESSAGE_COUNT)
+    {
+        message_with_callback->next = message_sender_instance->free_messages;
+        message_sender_instance->free_messages = message_with_callback;
+        message_sender_instance->free_message_count++;
+    }
+    else
+    {
+        free(message_with_callback);
+    }
+}
+
+static void queue_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    append_message((message_with_callback->message_send_state == MESSAGE_SEND_STATE_PENDING) ? &message_sender_instance->sent_messages : &message_sender_instance->unsent_messages, message_with_callback);
+    message_sender_instance->message_count++;
+}
+
+static void remove_pending_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    if (message_with_callback->list != NULL)
+    {
+        unlink_message(message_with_callback);
+        message_sender_instance->message_count--;
+    }
+
+    destroy_message_with_callback(message_sender_instance, message_with_callback);
+}
+
 static void on_delivery_settled(void* context, delivery_number delivery_no, LINK_DELIVERY_SETTLE_REASON reason, AMQP_VALUE delivery_state)
 {
     MESSAGE_WITH_CALLBACK* message_with_callback = (MESSAGE_WITH_CALLBACK*)context;
@@ -138,12 +339,125 @@ static void on_delivery_settled(void* context, delivery_number delivery_no, LINK
     remove_pending_message(message_sender_instance, message_with_callback);
 }
 
-static int encode_bytes(void* context, const unsigned char* bytes, size_t length)
+static void reset_encode_buffer(ENCODE_BUFFER* encode_buffer)
 {
-    PAYLOAD* payload = (PAYLOAD*)context;
-    (void)memcpy((unsigned char*)payload->bytes + payload->length, bytes, length);
-    payload->length += length;
-    return 0;
+    /* a buffer grown by an unusually large message is not kept for all the small ones after it */
+    if (encode_buffer->size > MAX_POOLED_ENCODE_BUFFER_SIZE)
+    {
+        free(encode_buffer->bytes);
+        encode_buffer->bytes = NULL;
+        encode_buffer->size = 0;
+    }
+
+    encode_buffer->length = 0;
+}
+
+static int reserve_encode_buffer(ENCODE_BUFFER* encode_buffer, size_t needed_size)
+{
+    int result;
+
+    if (needed_size <= encode_buffer->size)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t new_size = (encode_buffer->size == 0) ? INITIAL_ENCODE_BUFFER_SIZE : encode_buffer->size;
+        unsigned char* new_bytes;
+
+        while (new_size < needed_size)
+        {
+            new_size = (new_size > SIZE_MAX / 2) ? needed_size : new_size * 2;
+        }
+
+        new_bytes = (unsigned char*)realloc(encode_buffer->bytes, new_size);
+        if (new_bytes == NULL)
+        {
+            LogError("Cannot grow the encode buffer to %u bytes", (unsigned int)new_size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            encode_buffer->bytes = new_bytes;
+            encode_buffer->size = new_size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int append_encoded_bytes(void* context, const unsigned char* bytes, size_t length)
+{
+    int result;
+    ENCODE_BUFFER* encode_buffer = (ENCODE_BUFFER*)context;
+
+    if ((encode_buffer->length + length < length) ||
+        (reserve_encode_buffer(encode_buffer, encode_buffer->length + length) != 0))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(encode_buffer->bytes + encode_buffer->length, bytes, length);
+        encode_buffer->length += length;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int encode_section_descriptor(ENCODE_BUFFER* encode_buffer, unsigned char descriptor)
+{
+    /* the smallulong encoding of the section's descriptor code */
+    unsigned char descriptor_bytes[3];
+    descriptor_bytes[0] = 0x00;
+    descriptor_bytes[1] = 0x53;
+    descriptor_bytes[2] = descriptor;
+
+    return append_encoded_bytes(encode_buffer, descriptor_bytes, sizeof(descriptor_bytes));
+}
+
+static size_t get_data_section_header_length(size_t length)
+{
+    /* the descriptor, then the binary constructor and length that encode_data_section_header picks */
+    return (length <= 255) ? 5 : 8;
+}
+
+static int encode_data_section_header(ENCODE_BUFFER* encode_buffer, uint32_t length)
+{
+    int result;
+
+    if (encode_section_descriptor(encode_buffer, DATA_SECTION_DESCRIPTOR) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        unsigned char binary_header[5];
+        size_t binary_header_length;
+
+        /* the same vbin8 or vbin32 choice amqpvalue_encode makes for a binary */
+        if (length <= 255)
+        {
+            binary_header[0] = 0xA0;
+            binary_header[1] = (unsigned char)length;
+            binary_header_length = 2;
+        }
+        else
+        {
+            binary_header[0] = 0xB0;
+            binary_header[1] = (unsigned char)(length >> 24);
+            binary_header[2] = (unsigned char)(length >> 16);
+            binary_header[3] = (unsigned char)(length >> 8);
+            binary_header[4] = (unsigned char)length;
+            binary_header_length = 5;
+        }
+
+        result = append_encoded_bytes(encode_buffer, binary_header, binary_header_length);
+    }
+
+    return result;
 }
 
 static void log_message_chunk(MESSAGE_SENDER_INSTANCE* message_sender_instance, const char* name, AMQP_VALUE value)
@@ -155,313 +469,503 @@ static void log_message_chunk(MESSAGE_SENDER_INSTANCE* message_sender_instance,
 #else
     if (xlogging_get_log_function() != NULL && message_sender_instance->is_trace_on == 1)
     {
-        char* value_as_string = NULL;
+        char value_as_string[TRACE_STRING_BUFFER_SIZE];
         LOG(AZ_LOG_TRACE, 0, "%s", name);
-        LOG(AZ_LOG_TRACE, 0, "%s", (value_as_string = amqpvalue_to_string(value)));
-        if (value_as_string != NULL)
+        if (amqpvalue_to_string_buffer(value, value_as_string, sizeof(value_as_string)) == 0)
         {
-            free(value_as_string);
+            LOG(AZ_LOG_TRACE, 0, "%s", value_as_string);
         }
     }
 #endif
 }
 
-static SEND_ONE_MESSAGE_RESULT send_one_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback, MESSAGE_HANDLE message)
+/* appends the header, message annotations, properties and application properties of the message, whichever it has */
+static int encode_message_sections(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_HANDLE message, ENCODE_BUFFER* encode_buffer)
 {
-    SEND_ONE_MESSAGE_RESULT result;
-
-    size_t encoded_size;
-    size_t total_encoded_size = 0;
-    MESSAGE_BODY_TYPE message_body_type;
-    message_format message_format;
-
-    if ((message_get_body_type(message, &message_body_type) != 0) ||
-        (message_get_message_format(message, &message_format) != 0))
+    int result;
+    HEADER_HANDLE header = NULL;
+    AMQP_VALUE msg_annotations = NULL;
+    PROPERTIES_HANDLE properties = NULL;
+    AMQP_VALUE application_properties = NULL;
+
+    if ((message_get_header(message, &header) != 0) ||
+        (message_get_message_annotations(message, &msg_annotations) != 0) ||
+        (message_get_properties(message, &properties) != 0) ||
+        (message_get_application_properties(message, &application_properties) != 0))
     {
-        result = SEND_ONE_MESSAGE_ERROR;
+        LogError("Cannot get the message sections");
+        result = __FAILURE__;
     }
     else
     {
-        // header
-        HEADER_HANDLE header;
-        AMQP_VALUE header_amqp_value;
-        PROPERTIES_HANDLE properties;
-        AMQP_VALUE properties_amqp_value;
-        AMQP_VALUE application_properties;
-        AMQP_VALUE application_properties_value;
-        AMQP_VALUE body_amqp_value = NULL;
-        size_t body_data_count = 0;
-        AMQP_VALUE msg_annotations = NULL;
-
-        message_get_header(message, &header);
-        header_amqp_value = amqpvalue_create_header(header);
+        result = 0;
+
         if (header != NULL)
         {
-            amqpvalue_get_encoded_size(header_amqp_value, &encoded_size);
-            total_encoded_size += encoded_size;
+            /* a clone of the header's composite value, which only takes a reference */
+            AMQP_VALUE header_amqp_value = amqpvalue_create_header(header);
+            if ((header_amqp_value == NULL) ||
+                (amqpvalue_encode(header_amqp_value, append_encoded_bytes, encode_buffer) != 0))
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                log_message_chunk(message_sender_instance, "Header:", header_amqp_value);
+            }
+
+            if (header_amqp_value != NULL)
+            {
+                amqpvalue_destroy(header_amqp_value);
+            }
+        }
+
+        if ((result == 0) && (msg_annotations != NULL))
+        {
+            if (amqpvalue_encode(msg_annotations, append_encoded_bytes, encode_buffer) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                log_message_chunk(message_sender_instance, "Message Annotations:", msg_annotations);
+            }
+        }
+
+        if ((result == 0) && (properties != NULL))
+        {
+            AMQP_VALUE properties_amqp_value = amqpvalue_create_properties(properties);
+            if ((properties_amqp_value == NULL) ||
+                (amqpvalue_encode(properties_amqp_value, append_encoded_bytes, encode_buffer) != 0))
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                log_message_chunk(message_sender_instance, "Properties:", properties_amqp_value);
+            }
+
+            if (properties_amqp_value != NULL)
+            {
+                amqpvalue_destroy(properties_amqp_value);
+            }
         }
 
-        // message annotations
-        if ((message_get_message_annotations(message, &msg_annotations) == 0) &&
-            (msg_annotations != NULL))
+        if ((result == 0) && (application_properties != NULL))
         {
-            amqpvalue_get_encoded_size(msg_annotations, &encoded_size);
-            total_encoded_size += encoded_size;
+            /* the map is encoded after its descriptor rather than wrapped in a described value first */
+            if ((encode_section_descriptor(encode_buffer, APPLICATION_PROPERTIES_SECTION_DESCRIPTOR) != 0) ||
+                (amqpvalue_encode(application_properties, append_encoded_bytes, encode_buffer) != 0))
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                log_message_chunk(message_sender_instance, "Application properties:", application_properties);
+            }
         }
 
-        // properties
-        message_get_properties(message, &properties);
-        properties_amqp_value = amqpvalue_create_properties(properties);
-        if (properties != NULL)
+        if (result != 0)
         {
-            amqpvalue_get_encoded_size(properties_amqp_value, &encoded_size);
-            total_encoded_size += encoded_size;
+            LogError("Cannot encode the message sections");
         }
+    }
+
+    if (header != NULL)
+    {
+        header_destroy(header);
+    }
+    if (msg_annotations != NULL)
+    {
+        amqpvalue_destroy(msg_annotations);
+    }
+    if (properties != NULL)
+    {
+        properties_destroy(properties);
+    }
+    if (application_properties != NULL)
+    {
+        amqpvalue_destroy(application_properties);
+    }
+
+    return result;
+}
+
+static int encode_message_body_value(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_HANDLE message, ENCODE_BUFFER* encode_buffer)
+{
+    int result;
+    AMQP_VALUE message_body_amqp_value;
+
+    if ((message_get_body_amqp_value_in_place(message, &message_body_amqp_value) != 0) ||
+        (encode_section_descriptor(encode_buffer, AMQP_VALUE_SECTION_DESCRIPTOR) != 0) ||
+        (amqpvalue_encode(message_body_amqp_value, append_encoded_bytes, encode_buffer) != 0))
+    {
+        LogError("Cannot encode the message body");
+        result = __FAILURE__;
+    }
+    else
+    {
+        log_message_chunk(message_sender_instance, "Body - amqp value:", message_body_amqp_value);
+        result = 0;
+    }
+
+    return result;
+}
 
-        // application properties
-        message_get_application_properties(message, &application_properties);
-        if (application_properties != NULL)
+/* a data section of the body, from the caller's descriptions when body_data is given and from the message otherwise */
+static int get_body_data_section(MESSAGE_HANDLE message, const BINARY_DATA* body_data, size_t index, BINARY_DATA* binary_data)
+{
+    int result;
+
+    if (body_data != NULL)
+    {
+        *binary_data = body_data[index];
+        result = 0;
+    }
+    else
+    {
+        result = message_get_body_amqp_data_in_place(message, index, binary_data);
+    }
+
+    return result;
+}
+
+static int reserve_payloads(MESSAGE_SENDER_INSTANCE* message_sender_instance, size_t payload_count)
+{
+    int result;
+
+    if (payload_count <= message_sender_instance->payload_capacity)
+    {
+        result = 0;
+    }
+    else
+    {
+        PAYLOAD* new_payloads = (PAYLOAD*)realloc(message_sender_instance->payloads, payload_count * sizeof(PAYLOAD));
+        if (new_payloads == NULL)
         {
-            application_properties_value = amqpvalue_create_application_properties(application_properties);
-            amqpvalue_get_encoded_size(application_properties_value, &encoded_size);
-            total_encoded_size += encoded_size;
+            LogError("Cannot allocate memory for %u payloads", (unsigned int)payload_count);
+            result = __FAILURE__;
         }
         else
         {
-            application_properties_value = NULL;
+            message_sender_instance->payloads = new_payloads;
+            message_sender_instance->payload_capacity = payload_count;
+            result = 0;
         }
+    }
 
-        result = SEND_ONE_MESSAGE_OK;
+    return result;
+}
+
+/* Appends the header of each data section to the encoded sections and lays out the payloads: the encoded bytes, cut
+   wherever a section's body goes, and the bodies themselves, pointing at the memory they are in */
+static int encode_body_data(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_HANDLE message, const BINARY_DATA* body_data, size_t body_data_count, size_t* payload_count)
+{
+    int result = 0;
+    ENCODE_BUFFER* encode_buffer = &message_sender_instance->encode_buffer;
+    size_t header_offset = encode_buffer->length;
+    size_t i;
+
+    /* all the headers are encoded before any payload points into the buffer, which can move as it grows */
+    for (i = 0; (result == 0) && (i < body_data_count); i++)
+    {
+        BINARY_DATA binary_data;
 
-        // body - amqp data
-        switch (message_body_type)
+        if ((get_body_data_section(message, body_data, i, &binary_data) != 0) ||
+            (binary_data.length > UINT32_MAX) ||
+            (encode_data_section_header(encode_buffer, (uint32_t)binary_data.length) != 0))
         {
-            default:
-                result = SEND_ONE_MESSAGE_ERROR;
-                break;
+            result = __FAILURE__;
+        }
+    }
 
-            case MESSAGE_BODY_TYPE_VALUE:
-            {
-                AMQP_VALUE message_body_amqp_value;
-                if (message_get_body_amqp_value_in_place(message, &message_body_amqp_value) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
-                else
-                {
-                    body_amqp_value = amqpvalue_create_amqp_value(message_body_amqp_value);
-                    if ((body_amqp_value == NULL) ||
-                        (amqpvalue_get_encoded_size(body_amqp_value, &encoded_size) != 0))
-                    {
-                        result = SEND_ONE_MESSAGE_ERROR;
-                    }
-                    else
-                    {
-                        total_encoded_size += encoded_size;
-                    }
-                }
+    /* the encoded bytes before the first body, then at most a body and a header for each section */
+    if ((result != 0) ||
+        (reserve_payloads(message_sender_instance, (body_data_count == 0) ? 1 : body_data_count * 2) != 0))
+    {
+        LogError("Cannot encode the message body");
+        result = __FAILURE__;
+    }
+    else
+    {
+        PAYLOAD* payloads = message_sender_instance->payloads;
+        size_t count = 1;
+        bool is_last_payload_encoded = true;
 
-                break;
-            }
+        payloads[0].bytes = encode_buffer->bytes;
+        payloads[0].length = header_offset;
+
+        for (i = 0; i < body_data_count; i++)
+        {
+            BINARY_DATA binary_data;
+            size_t header_length;
 
-            case MESSAGE_BODY_TYPE_DATA:
+            (void)get_body_data_section(message, body_data, i, &binary_data);
+            header_length = get_data_section_header_length(binary_data.length);
+
+            /* a header right after other encoded bytes, with no body between them, goes in the same payload */
+            if (is_last_payload_encoded)
             {
-                BINARY_DATA binary_data;
-                size_t i;
+                payloads[count - 1].length += header_length;
+            }
+            else
+            {
+                payloads[count].bytes = encode_buffer->bytes + header_offset;
+                payloads[count].length = header_length;
+                count++;
+            }
 
-                if (message_get_body_amqp_data_count(message, &body_data_count) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
-                else
-                {
-                    for (i = 0; i < body_data_count; i++)
-                    {
-                        if (message_get_body_amqp_data_in_place(message, i, &binary_data) != 0)
-                        {
-                            result = SEND_ONE_MESSAGE_ERROR;
-                        }
-                        else
-                        {
-							AMQP_VALUE body_amqp_data;
-                            amqp_binary binary_value;
-                            binary_value.bytes = binary_data.bytes;
-                            binary_value.length = (uint32_t)binary_data.length;
-                            body_amqp_data = amqpvalue_create_data(binary_value);
-                            if (body_amqp_data == NULL)
-                            {
-                                result = SEND_ONE_MESSAGE_ERROR;
-                            }
-                            else
-                            {
-                                if (amqpvalue_get_encoded_size(body_amqp_data, &encoded_size) != 0)
-                                {
-                                    result = SEND_ONE_MESSAGE_ERROR;
-                                }
-                                else
-                                {
-                                    total_encoded_size += encoded_size;
-                                }
-
-                                amqpvalue_destroy(body_amqp_data);
-                            }
-                        }
-                    }
-                }
-                break;
+            header_offset += header_length;
+
+            if (binary_data.length == 0)
+            {
+                is_last_payload_encoded = true;
+            }
+            else
+            {
+                payloads[count].bytes = binary_data.bytes;
+                payloads[count].length = binary_data.length;
+                count++;
+                is_last_payload_encoded = false;
             }
         }
 
-        if (result == 0)
+        *payload_count = count;
+    }
+
+    return result;
+}
+
+/* body_data, when given, is the body of message, which then has none of its own */
+static SEND_ONE_MESSAGE_RESULT send_one_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback, MESSAGE_HANDLE message, const BINARY_DATA* body_data, size_t body_data_count)
+{
+    SEND_ONE_MESSAGE_RESULT result;
+    MESSAGE_BODY_TYPE message_body_type;
+    message_format message_format;
+    ENCODE_BUFFER* encode_buffer = &message_sender_instance->encode_buffer;
+    PAYLOAD payload;
+    PAYLOAD* payloads = &payload;
+    size_t payload_count = 1;
+
+    reset_encode_buffer(encode_buffer);
+
+    if ((message_get_body_type(message, &message_body_type) != 0) ||
+        (message_get_message_format(message, &message_format) != 0) ||
+        (encode_message_sections(message_sender_instance, message, encode_buffer) != 0))
+    {
+        result = SEND_ONE_MESSAGE_ERROR;
+    }
+    else if ((body_data != NULL) ||
+        (message_body_type == MESSAGE_BODY_TYPE_DATA))
+    {
+        if (((body_data == NULL) && (message_get_body_amqp_data_count(message, &body_data_count) != 0)) ||
+            (encode_body_data(message_sender_instance, message, body_data, body_data_count, &payload_count) != 0))
         {
-            void* data_bytes = malloc(total_encoded_size);
-            PAYLOAD payload;
-            payload.bytes = (const unsigned char*)data_bytes;
-            payload.length = 0;
+            result = SEND_ONE_MESSAGE_ERROR;
+        }
+        else
+        {
+            payloads = message_sender_instance->payloads;
             result = SEND_ONE_MESSAGE_OK;
+        }
+    }
+    else if ((message_body_type != MESSAGE_BODY_TYPE_VALUE) ||
+        (encode_message_body_value(message_sender_instance, message, encode_buffer) != 0))
+    {
+        LogError("Cannot encode the message body");
+        result = SEND_ONE_MESSAGE_ERROR;
+    }
+    else
+    {
+        payload.bytes = encode_buffer->bytes;
+        payload.length = encode_buffer->length;
+        result = SEND_ONE_MESSAGE_OK;
+    }
 
-            if (header != NULL)
-            {
-                if (amqpvalue_encode(header_amqp_value, encode_bytes, &payload) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
+    if (result == SEND_ONE_MESSAGE_OK)
+    {
+        /* the frame codec copies the payloads before link_transfer returns, so the buffers are free for the next message
+           even when a send complete callback sends again from inside link_transfer */
+        set_message_send_state(message_with_callback, MESSAGE_SEND_STATE_PENDING);
+        switch (link_transfer(message_sender_instance->link, message_format, payloads, payload_count, (message_with_callback->is_presettled) ? NULL : on_delivery_settled, message_with_callback))
+        {
+        default:
+        case LINK_TRANSFER_ERROR:
+            result = SEND_ONE_MESSAGE_ERROR;
+            break;
 
-                log_message_chunk(message_sender_instance, "Header:", header_amqp_value);
-            }
+        case LINK_TRANSFER_BUSY:
+            set_message_send_state(message_with_callback, MESSAGE_SEND_STATE_NOT_SENT);
+            result = SEND_ONE_MESSAGE_BUSY;
+            break;
 
-            if ((result == SEND_ONE_MESSAGE_OK) && (msg_annotations != NULL))
-            {
-                if (amqpvalue_encode(msg_annotations, encode_bytes, &payload) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
+        case LINK_TRANSFER_OK:
+            result = SEND_ONE_MESSAGE_OK;
+            break;
+        }
+    }
 
-                log_message_chunk(message_sender_instance, "Message Annotations:", msg_annotations);
-            }
+    return result;
+}
 
-            if ((result == SEND_ONE_MESSAGE_OK) && (properties != NULL))
-            {
-                if (amqpvalue_encode(properties_amqp_value, encode_bytes, &payload) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
+static int read_stream_frame(MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    int result = 0;
 
-                log_message_chunk(message_sender_instance, "Properties:", properties_amqp_value);
-            }
+    if (message_with_callback->stream_prefix_offset < message_with_callback->stream_prefix_length)
+    {
+        size_t prefix_bytes = message_with_callback->stream_prefix_length - message_with_callback->stream_prefix_offset;
+        if (prefix_bytes > message_with_callback->stream_frame_size)
+        {
+            prefix_bytes = message_with_callback->stream_frame_size;
+        }
 
-            if ((result == SEND_ONE_MESSAGE_OK) && (application_properties != NULL))
-            {
-                if (amqpvalue_encode(application_properties_value, encode_bytes, &payload) != 0)
-                {
-                    result = SEND_ONE_MESSAGE_ERROR;
-                }
+        (void)memcpy(message_with_callback->stream_frame, message_with_callback->stream_prefix + message_with_callback->stream_prefix_offset, prefix_bytes);
+        message_with_callback->stream_frame_length = prefix_bytes;
+        message_with_callback->stream_prefix_offset += prefix_bytes;
 
-                log_message_chunk(message_sender_instance, "Application properties:", application_properties_value);
-            }
+        if (message_with_callback->stream_prefix_offset == message_with_callback->stream_prefix_length)
+        {
+            free(message_with_callback->stream_prefix);
+            message_with_callback->stream_prefix = NULL;
+        }
+    }
 
-            if (result == SEND_ONE_MESSAGE_OK)
-            {
-                switch (message_body_type)
-                {
-                default:
-                    result = SEND_ONE_MESSAGE_ERROR;
-                    break;
+    while ((result == 0) &&
+        (message_with_callback->stream_body_remaining > 0) &&
+        (message_with_callback->stream_frame_length < message_with_callback->stream_frame_size))
+    {
+        size_t read_size = message_with_callback->stream_frame_size - message_with_callback->stream_frame_length;
+        size_t bytes_read = 0;
 
-                case MESSAGE_BODY_TYPE_VALUE:
-                {
-                    if (amqpvalue_encode(body_amqp_value, encode_bytes, &payload) != 0)
-                    {
-                        result = SEND_ONE_MESSAGE_ERROR;
-                    }
+        if (read_size > message_with_callback->stream_body_remaining)
+        {
+            read_size = message_with_callback->stream_body_remaining;
+        }
 
-                    log_message_chunk(message_sender_instance, "Body - amqp value:", body_amqp_value);
-                    break;
-                }
-                case MESSAGE_BODY_TYPE_DATA:
-                {
-                    BINARY_DATA binary_data;
-                    size_t i;
+        if (message_with_callback->on_message_body_read(message_with_callback->body_read_context, message_with_callback->stream_frame + message_with_callback->stream_frame_length, read_size, &bytes_read) != 0)
+        {
+            LogError("Cannot read the message body");
+            result = __FAILURE__;
+        }
+        else if ((bytes_read == 0) ||
+            (bytes_read > read_size))
+        {
+            LogError("Message body ended with %u bytes missing", (unsigned int)message_with_callback->stream_body_remaining);
+            result = __FAILURE__;
+        }
+        else
+        {
+            message_with_callback->stream_frame_length += bytes_read;
+            message_with_callback->stream_body_remaining -= (uint32_t)bytes_read;
+        }
+    }
+
+    return result;
+}
+
+static SEND_ONE_MESSAGE_RESULT send_streamed_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_WITH_CALLBACK* message_with_callback)
+{
+    SEND_ONE_MESSAGE_RESULT result;
+    bool is_sent = false;
+
+    if (message_with_callback->stream_frame == NULL)
+    {
+        uint32_t frame_size;
+
+        if (link_get_transfer_frame_payload_size(message_sender_instance->link, &frame_size) != 0)
+        {
+            LogError("Cannot get the transfer frame payload size");
+            result = SEND_ONE_MESSAGE_ERROR;
+        }
+        else
+        {
+            message_with_callback->stream_frame_size = (frame_size > MAX_STREAM_FRAME_SIZE) ? MAX_STREAM_FRAME_SIZE : frame_size;
+            message_with_callback->stream_frame_length = 0;
+            message_with_callback->stream_frame = (unsigned char*)malloc(message_with_callback->stream_frame_size);
+            if (message_with_callback->stream_frame == NULL)
+            {
+                LogError("Cannot allocate memory for the message body frame");
+                result = SEND_ONE_MESSAGE_ERROR;
+            }
+            else
+            {
+                result = SEND_ONE_MESSAGE_OK;
+            }
+        }
+    }
+    else
+    {
+        result = SEND_ONE_MESSAGE_OK;
+    }
+
+    /* frames are read and sent until the session window or the body runs out */
+    while ((result == SEND_ONE_MESSAGE_OK) && !is_sent)
+    {
+        if ((message_with_callback->stream_frame_length == 0) &&
+            (read_stream_frame(message_with_callback) != 0))
+        {
+            result = SEND_ONE_MESSAGE_ERROR;
+        }
+        else
+        {
+            bool more = (message_with_callback->stream_prefix_offset < message_with_callback->stream_prefix_length) ||
+                (message_with_callback->stream_body_remaining > 0);
+            unsigned char* frame = message_with_callback->stream_frame;
+            PAYLOAD payload;
 
-                    for (i = 0; i < body_data_count; i++)
-                    {
-                        if (message_get_body_amqp_data_in_place(message, i, &binary_data) != 0)
-                        {
-                            result = SEND_ONE_MESSAGE_ERROR;
-                        }
-                        else
-                        {
-							AMQP_VALUE body_amqp_data;
-                            amqp_binary binary_value;
-                            binary_value.bytes = binary_data.bytes;
-                            binary_value.length = (uint32_t)binary_data.length;
-                            body_amqp_data = amqpvalue_create_data(binary_value);
-                            if (body_amqp_data == NULL)
-                            {
-                                result = SEND_ONE_MESSAGE_ERROR;
-                            }
-                            else
-                            {
-                                if (amqpvalue_encode(body_amqp_data, encode_bytes, &payload) != 0)
-                                {
-                                    result = SEND_ONE_MESSAGE_ERROR;
-                                    break;
-                                }
-
-                                amqpvalue_destroy(body_amqp_data);
-                            }
-                        }
-                    }
-                    break;
-                }
-                }
+            payload.bytes = frame;
+            payload.length = message_with_callback->stream_frame_length;
+
+            if (!more)
+            {
+                /* the last frame can settle the message and free it before link_transfer_frame returns */
+                message_with_callback->stream_frame = NULL;
+                set_message_send_state(message_with_callback, MESSAGE_SEND_STATE_PENDING);
             }
 
-            if (result == SEND_ONE_MESSAGE_OK)
+            switch (link_transfer_frame(message_sender_instance->link, message_with_callback->message_format, &payload, 1, more, on_delivery_settled, message_with_callback))
             {
-                message_with_callback->message_send_state = MESSAGE_SEND_STATE_PENDING;
-                switch (link_transfer(message_sender_instance->link, message_format, &payload, 1, on_delivery_settled, message_with_callback))
+            default:
+            case LINK_TRANSFER_ERROR:
+                if (!more)
                 {
-                default:
-                case LINK_TRANSFER_ERROR:
-                    result = SEND_ONE_MESSAGE_ERROR;
-                    break;
-
-                case LINK_TRANSFER_BUSY:
-                    message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
-                    result = SEND_ONE_MESSAGE_BUSY;
-                    break;
-
-                case LINK_TRANSFER_OK:
-                    result = SEND_ONE_MESSAGE_OK;
-                    break;
+                    message_with_callback->stream_frame = frame;
                 }
-            }
+                result = SEND_ONE_MESSAGE_ERROR;
+                break;
 
-            free(data_bytes);
+            case LINK_TRANSFER_BUSY:
+                if (!more)
+                {
+                    message_with_callback->stream_frame = frame;
+                    set_message_send_state(message_with_callback, MESSAGE_SEND_STATE_NOT_SENT);
+                }
+                result = SEND_ONE_MESSAGE_BUSY;
+                break;
 
-            if (body_amqp_value != NULL)
-            {
-                amqpvalue_destroy(body_amqp_value);
+            case LINK_TRANSFER_OK:
+                if (more)
+                {
+                    message_with_callback->stream_frame_length = 0;
+                    message_with_callback->is_stream_started = true;
+                }
+                else
+                {
+                    /* message_with_callback may be gone already */
+                    free(frame);
+                    is_sent = true;
+                }
+                break;
             }
         }
+    }
 
-        if (application_properties != NULL)
-        {
-            amqpvalue_destroy(application_properties);
-        }
-        if (application_properties_value != NULL)
-        {
-            amqpvalue_destroy(application_properties_value);
-        }
-        if (properties_amqp_value != NULL)
-        {
-            amqpvalue_destroy(properties_amqp_value);
-        }
-        if (properties != NULL)
-        {
-            properties_destroy(properties);
-        }
+    if ((result == SEND_ONE_MESSAGE_ERROR) &&
+        message_with_callback->is_stream_started &&
+        (link_abort_transfer(message_sender_instance->link) != 0))
+    {
+        LogError("Cannot abort the message delivery");
     }
 
     return result;
@@ -469,38 +973,46 @@ static SEND_ONE_MESSAGE_RESULT send_one_message(MESSAGE_SENDER_INSTANCE* message
 
 static void send_all_pending_messages(MESSAGE_SENDER_INSTANCE* message_sender_instance)
 {
-    size_t i;
+    bool is_link_busy = false;
 
-    for (i = 0; i < message_sender_instance->message_count; i++)
+    while (!is_link_busy &&
+        (message_sender_instance->unsent_messages.first != NULL))
     {
-        if (message_sender_instance->messages[i]->message_send_state == MESSAGE_SEND_STATE_NOT_SENT)
+        MESSAGE_WITH_CALLBACK* message_with_callback = message_sender_instance->unsent_messages.first;
+        /* a tracked message can be settled and gone by the time the send returns */
+        bool is_presettled = message_with_callback->is_presettled;
+        SEND_ONE_MESSAGE_RESULT send_result = (message_with_callback->on_message_body_read != NULL) ?
+            send_streamed_message(message_sender_instance, message_with_callback) :
+            send_one_message(message_sender_instance, message_with_callback, message_with_callback->message, message_with_callback->body_data, message_with_callback->body_data_count);
+
+        switch (send_result)
         {
-            switch (send_one_message(message_sender_instance, message_sender_instance->messages[i], message_sender_instance->messages[i]->message))
-            {
-            default:
-            case SEND_ONE_MESSAGE_ERROR:
-            {
-                ON_MESSAGE_SEND_COMPLETE on_message_send_complete = message_sender_instance->messages[i]->on_message_send_complete;
-                void* context = message_sender_instance->messages[i]->context;
-                remove_pending_message_by_index(message_sender_instance, i);
-
-                if (on_message_send_complete != NULL)
-                {
-                    on_message_send_complete(context, MESSAGE_SEND_ERROR);
-                }
+        default:
+        case SEND_ONE_MESSAGE_ERROR:
+        {
+            ON_MESSAGE_SEND_COMPLETE on_message_send_complete = message_with_callback->on_message_send_complete;
+            void* context = message_with_callback->context;
+            remove_pending_message(message_sender_instance, message_with_callback);
 
-                i = message_sender_instance->message_count;
-                break;
+            if (on_message_send_complete != NULL)
+            {
+                on_message_send_complete(context, MESSAGE_SEND_ERROR);
             }
-            case SEND_ONE_MESSAGE_BUSY:
-                i = message_sender_instance->message_count + 1;
-                break;
 
-            case SEND_ONE_MESSAGE_OK:
-                break;
-            }
+            /* the rest is left for the next flow, the callback may have changed everything */
+            is_link_busy = true;
+            break;
+        }
+        case SEND_ONE_MESSAGE_BUSY:
+            is_link_busy = true;
+            break;
 
-            i--;
+        case SEND_ONE_MESSAGE_OK:
+            if (is_presettled)
+            {
+                remove_pending_message(message_sender_instance, message_with_callback);
+            }
+            break;
         }
     }
 }
@@ -517,25 +1029,36 @@ static void set_message_sender_state(MESSAGE_SENDER_INSTANCE* message_sender_ins
 
 static void indicate_all_messages_as_error(MESSAGE_SENDER_INSTANCE* message_sender_instance)
 {
+    /* taken off the sender first, the callbacks may send again */
+    MESSAGE_WITH_CALLBACK* lists[2];
     size_t i;
 
-    for (i = 0; i < message_sender_instance->message_count; i++)
+    lists[0] = message_sender_instance->sent_messages.first;
+    lists[1] = message_sender_instance->unsent_messages.first;
+    message_sender_instance->sent_messages.first = NULL;
+    message_sender_instance->sent_messages.last = NULL;
+    message_sender_instance->unsent_messages.first = NULL;
+    message_sender_instance->unsent_messages.last = NULL;
+    message_sender_instance->message_count = 0;
+
+    for (i = 0; i < 2; i++)
     {
-        if (message_sender_instance->messages[i]->on_message_send_complete != NULL)
+        while (lists[i] != NULL)
         {
-            message_sender_instance->messages[i]->on_message_send_complete(message_sender_instance->messages[i]->context, MESSAGE_SEND_ERROR);
-        }
+            MESSAGE_WITH_CALLBACK* message_with_callback = lists[i];
+            lists[i] = message_with_callback->next;
 
-        message_destroy(message_sender_instance->messages[i]->message);
-        free(message_sender_instance->messages[i]);
-    }
+            message_with_callback->list = NULL;
+            message_with_callback->previous = NULL;
+            message_with_callback->next = NULL;
 
-    if (message_sender_instance->messages != NULL)
-    {
-        message_sender_instance->message_count = 0;
+            if (message_with_callback->on_message_send_complete != NULL)
+            {
+                message_with_callback->on_message_send_complete(message_with_callback->context, MESSAGE_SEND_ERROR);
+            }
 
-        free(message_sender_instance->messages);
-        message_sender_instance->messages = NULL;
+            destroy_message_with_callback(message_sender_instance, message_with_callback);
+        }
     }
 }
 
@@ -590,8 +1113,18 @@ MESSAGE_SENDER_HANDLE messagesender_create(LINK_HANDLE link, ON_MESSAGE_SENDER_S
     MESSAGE_SENDER_INSTANCE* result = (MESSAGE_SENDER_INSTANCE*)malloc(sizeof(MESSAGE_SENDER_INSTANCE));
     if (result != NULL)
     {
-        result->messages = NULL;
+        result->unsent_messages.first = NULL;
+        result->unsent_messages.last = NULL;
+        result->sent_messages.first = NULL;
+        result->sent_messages.last = NULL;
         result->message_count = 0;
+        result->free_messages = NULL;
+        result->free_message_count = 0;
+        result->encode_buffer.bytes = NULL;
+        result->encode_buffer.size = 0;
+        result->encode_buffer.length = 0;
+        result->payloads = NULL;
+        result->payload_capacity = 0;
         result->link = link;
         result->on_message_sender_state_changed = on_message_sender_state_changed;
         result->on_message_sender_state_changed_context = context;
@@ -612,6 +1145,15 @@ void messagesender_destroy(MESSAGE_SENDER_HANDLE message_sender)
 
         indicate_all_messages_as_error(message_sender_instance);
 
+        while (message_sender_instance->free_messages != NULL)
+        {
+            MESSAGE_WITH_CALLBACK* message_with_callback = message_sender_instance->free_messages;
+            message_sender_instance->free_messages = message_with_callback->next;
+            free(message_with_callback);
+        }
+
+        free(message_sender_instance->encode_buffer.bytes);
+        free(message_sender_instance->payloads);
         free(message_sender);
     }
 }
@@ -685,6 +1227,106 @@ int messagesender_close(MESSAGE_SENDER_HANDLE message_sender)
     return result;
 }
 
+/* what a message waiting for the link needs once the caller has returned */
+static int keep_message(MESSAGE_WITH_CALLBACK* message_with_callback, MESSAGE_HANDLE message, const BINARY_DATA* body_data, size_t body_data_count)
+{
+    int result;
+
+    message_with_callback->message = message_clone(message);
+    if (message_with_callback->message == NULL)
+    {
+        LogError("Cannot clone message");
+        result = __FAILURE__;
+    }
+    else if (body_data == NULL)
+    {
+        result = 0;
+    }
+    else if ((message_with_callback->body_data = (BINARY_DATA*)malloc(body_data_count * sizeof(BINARY_DATA))) == NULL)
+    {
+        LogError("Cannot allocate memory for the body data");
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(message_with_callback->body_data, body_data, body_data_count * sizeof(BINARY_DATA));
+        message_with_callback->body_data_count = body_data_count;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int send_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_HANDLE message, const BINARY_DATA* body_data, size_t body_data_count, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
+{
+    int result;
+
+    if (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_ERROR)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        MESSAGE_WITH_CALLBACK* message_with_callback = create_message_with_callback(message_sender_instance);
+        if (message_with_callback == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            message_with_callback->on_message_send_complete = on_message_send_complete;
+            message_with_callback->context = callback_context;
+
+            /* sent right away unless it has to wait behind others */
+            if ((message_sender_instance->message_sender_state != MESSAGE_SENDER_STATE_OPEN) ||
+                (message_sender_instance->unsent_messages.first != NULL))
+            {
+                if (keep_message(message_with_callback, message, body_data, body_data_count) != 0)
+                {
+                    destroy_message_with_callback(message_sender_instance, message_with_callback);
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    queue_message(message_sender_instance, message_with_callback);
+                    result = 0;
+                }
+            }
+            else
+            {
+                queue_message(message_sender_instance, message_with_callback);
+
+                switch (send_one_message(message_sender_instance, message_with_callback, message, body_data, body_data_count))
+                {
+                default:
+                case SEND_ONE_MESSAGE_ERROR:
+                    remove_pending_message(message_sender_instance, message_with_callback);
+                    result = __FAILURE__;
+                    break;
+
+                case SEND_ONE_MESSAGE_BUSY:
+                    if (keep_message(message_with_callback, message, body_data, body_data_count) != 0)
+                    {
+                        remove_pending_message(message_sender_instance, message_with_callback);
+                        result = __FAILURE__;
+                    }
+                    else
+                    {
+                        result = 0;
+                    }
+                    break;
+
+                case SEND_ONE_MESSAGE_OK:
+                    result = 0;
+                    break;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 int messagesender_send(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
 {
     int result;
@@ -695,93 +1337,235 @@ int messagesender_send(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE mess
         result = __FAILURE__;
     }
     else
+    {
+        result = send_message((MESSAGE_SENDER_INSTANCE*)message_sender, message, NULL, 0, on_message_send_complete, callback_context);
+    }
+
+    return result;
+}
+
+int messagesender_send_borrowed_data(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, const BINARY_DATA* body_data, size_t body_data_count, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
+{
+    int result;
+    MESSAGE_BODY_TYPE message_body_type;
+
+    if ((message_sender == NULL) ||
+        (message == NULL) ||
+        (body_data == NULL) ||
+        (body_data_count == 0))
+    {
+        LogError("Bad arguments: message_sender = %p, message = %p, body_data = %p, body_data_count = %u",
+            message_sender, message, body_data, (unsigned int)body_data_count);
+        result = __FAILURE__;
+    }
+    else if ((message_get_body_type(message, &message_body_type) != 0) ||
+        (message_body_type != MESSAGE_BODY_TYPE_NONE))
+    {
+        LogError("The body of a message sent with borrowed data is given by body_data only");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = send_message((MESSAGE_SENDER_INSTANCE*)message_sender, message, body_data, body_data_count, on_message_send_complete, callback_context);
+    }
+
+    return result;
+}
+
+static int queue_presettled_message(MESSAGE_SENDER_INSTANCE* message_sender_instance, MESSAGE_HANDLE message)
+{
+    int result;
+    MESSAGE_WITH_CALLBACK* message_with_callback = create_message_with_callback(message_sender_instance);
+
+    if (message_with_callback == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        message_with_callback->message = message_clone(message);
+        if (message_with_callback->message == NULL)
+        {
+            LogError("Cannot clone message");
+            destroy_message_with_callback(message_sender_instance, message_with_callback);
+            result = __FAILURE__;
+        }
+        else
+        {
+            message_with_callback->is_presettled = true;
+            queue_message(message_sender_instance, message_with_callback);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int messagesender_send_presettled(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message)
+{
+    int result;
+    sender_settle_mode snd_settle_mode;
+
+    if ((message_sender == NULL) ||
+        (message == NULL))
+    {
+        LogError("Bad arguments: message_sender = %p, message = %p", message_sender, message);
+        result = __FAILURE__;
+    }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+
+        if ((link_get_snd_settle_mode(message_sender_instance->link, &snd_settle_mode) != 0) ||
+            (snd_settle_mode != sender_settle_mode_settled))
+        {
+            LogError("Pre-settled messages need a link sending settled");
+            result = __FAILURE__;
+        }
+        else if (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_ERROR)
+        {
+            LogError("Message sender is in error");
+            result = __FAILURE__;
+        }
+        else if ((message_sender_instance->message_sender_state != MESSAGE_SENDER_STATE_OPEN) ||
+            (message_sender_instance->unsent_messages.first != NULL))
+        {
+            /* behind messages still waiting for the link */
+            result = queue_presettled_message(message_sender_instance, message);
+        }
+        else
+        {
+            /* nothing refers to it once the link has it, it can live on the stack */
+            MESSAGE_WITH_CALLBACK message_with_callback;
+
+            init_message_with_callback(&message_with_callback, message_sender_instance);
+            message_with_callback.is_presettled = true;
+
+            switch (send_one_message(message_sender_instance, &message_with_callback, message, NULL, 0))
+            {
+            default:
+            case SEND_ONE_MESSAGE_ERROR:
+                LogError("Cannot send message");
+                result = __FAILURE__;
+                break;
+
+            case SEND_ONE_MESSAGE_BUSY:
+                result = queue_presettled_message(message_sender_instance, message);
+                break;
+
+            case SEND_ONE_MESSAGE_OK:
+                result = 0;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+int messagesender_get_pending_message_count(MESSAGE_SENDER_HANDLE message_sender, size_t* message_count)
+{
+    int result;
+
+    if ((message_sender == NULL) ||
+        (message_count == NULL))
+    {
+        LogError("Bad arguments: message_sender = %p, message_count = %p", message_sender, message_count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
+        *message_count = message_sender_instance->message_count;
+        result = 0;
+    }
+
+    return result;
+}
+
+int messagesender_send_streamed(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, uint32_t body_length, ON_MESSAGE_BODY_READ on_message_body_read, void* body_read_context, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
+{
+    int result;
+    MESSAGE_BODY_TYPE message_body_type;
+
+    if ((message_sender == NULL) ||
+        (message == NULL) ||
+        (on_message_body_read == NULL))
+    {
+        LogError("Bad arguments: message_sender = %p, message = %p, on_message_body_read = %p",
+            message_sender, message, on_message_body_read);
+        result = __FAILURE__;
+    }
+    else if ((message_get_body_type(message, &message_body_type) != 0) ||
+        (message_body_type != MESSAGE_BODY_TYPE_NONE))
+    {
+        LogError("The body of a streamed message is given by on_message_body_read only");
+        result = __FAILURE__;
+    }
+    else
     {
         MESSAGE_SENDER_INSTANCE* message_sender_instance = (MESSAGE_SENDER_INSTANCE*)message_sender;
         if (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_ERROR)
         {
+            LogError("Message sender is in error");
             result = __FAILURE__;
         }
         else
         {
-            MESSAGE_WITH_CALLBACK* message_with_callback = (MESSAGE_WITH_CALLBACK*)malloc(sizeof(MESSAGE_WITH_CALLBACK));
+            MESSAGE_WITH_CALLBACK* message_with_callback = create_message_with_callback(message_sender_instance);
             if (message_with_callback == NULL)
             {
                 result = __FAILURE__;
             }
             else
             {
-                MESSAGE_WITH_CALLBACK** new_messages = (MESSAGE_WITH_CALLBACK**)realloc(message_sender_instance->messages, sizeof(MESSAGE_WITH_CALLBACK*) * (message_sender_instance->message_count + 1));
-                if (new_messages == NULL)
+                /* the sections and the header of the single data section holding the body, whose bytes follow;
+                   kept by the message until they are sent, so they are not encoded into the sender's buffer */
+                ENCODE_BUFFER stream_prefix;
+
+                message_with_callback->on_message_send_complete = on_message_send_complete;
+                message_with_callback->context = callback_context;
+                message_with_callback->on_message_body_read = on_message_body_read;
+                message_with_callback->body_read_context = body_read_context;
+                message_with_callback->stream_body_remaining = body_length;
+
+                stream_prefix.bytes = NULL;
+                stream_prefix.size = 0;
+                stream_prefix.length = 0;
+
+                if ((message_get_message_format(message, &message_with_callback->message_format) != 0) ||
+                    (encode_message_sections(message_sender_instance, message, &stream_prefix) != 0) ||
+                    (encode_data_section_header(&stream_prefix, body_length) != 0))
                 {
-                    free(message_with_callback);
+                    LogError("Cannot encode the message");
+                    free(stream_prefix.bytes);
+                    destroy_message_with_callback(message_sender_instance, message_with_callback);
                     result = __FAILURE__;
                 }
                 else
                 {
-                    result = 0;
+                    message_with_callback->stream_prefix = stream_prefix.bytes;
+                    message_with_callback->stream_prefix_length = stream_prefix.length;
+
+                    queue_message(message_sender_instance, message_with_callback);
 
-                    message_sender_instance->messages = new_messages;
-                    if (message_sender_instance->message_sender_state != MESSAGE_SENDER_STATE_OPEN)
+                    /* the body is only started once the messages queued before it are out */
+                    if ((message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_OPEN) &&
+                        (message_sender_instance->unsent_messages.first == message_with_callback) &&
+                        (send_streamed_message(message_sender_instance, message_with_callback) == SEND_ONE_MESSAGE_ERROR))
                     {
-                        message_with_callback->message = message_clone(message);
-                        if (message_with_callback->message == NULL)
-                        {
-                            free(message_with_callback);
-                            result = __FAILURE__;
-                        }
-
-                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
+                        remove_pending_message(message_sender_instance, message_with_callback);
+                        result = __FAILURE__;
                     }
                     else
                     {
-                        message_with_callback->message = NULL;
-                        message_with_callback->message_send_state = MESSAGE_SEND_STATE_PENDING;
-                    }
-
-                    if (result == 0)
-                    {
-                        message_with_callback->on_message_send_complete = on_message_send_complete;
-                        message_with_callback->context = callback_context;
-                        message_with_callback->message_sender = message_sender_instance;
-
-                        message_sender_instance->messages[message_sender_instance->message_count] = message_with_callback;
-                        message_sender_instance->message_count++;
-
-                        if (message_sender_instance->message_sender_state == MESSAGE_SENDER_STATE_OPEN)
-                        {
-                            switch (send_one_message(message_sender_instance, message_with_callback, message))
-                            {
-                            default:
-                            case SEND_ONE_MESSAGE_ERROR:
-                            
-                                remove_pending_message_by_index(message_sender_instance, message_sender_instance->message_count - 1);
-                                result = __FAILURE__;
-                                break;
-
-                            case SEND_ONE_MESSAGE_BUSY:
-                                message_with_callback->message = message_clone(message);
-                                if (message_with_callback->message == NULL)
-                                {
-                                    free(message_with_callback);
-                                    result = __FAILURE__;
-                                }
-                                else
-                                {
-                                    message_with_callback->message_send_state = MESSAGE_SEND_STATE_NOT_SENT;
-                                    result = 0;
-                                }
-                                break;
-
-                            case SEND_ONE_MESSAGE_OK:
-                                result = 0;
-                                break;
-                            }
-                        }
+                        result = 0;
                     }
                 }
             }
         }
     }
+
     return result;
 }
 
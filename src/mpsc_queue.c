@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/mpsc_queue.h"
+
+/* producers swap their item into head and then link it behind the previous one, only the consumer touches tail */
+
+void mpsc_queue_init(MPSC_QUEUE* queue)
+{
+	if (queue == NULL)
+	{
+		LogError("NULL queue");
+	}
+	else
+	{
+		queue->stub.next = NULL;
+		queue->head = &queue->stub;
+		queue->tail = &queue->stub;
+	}
+}
+
+void mpsc_queue_push(MPSC_QUEUE* queue, MPSC_QUEUE_ITEM* item)
+{
+	if ((queue == NULL) ||
+		(item == NULL))
+	{
+		LogError("Bad arguments: queue = %p, item = %p",
+			queue, item);
+	}
+	else
+	{
+		MPSC_QUEUE_ITEM* previous;
+
+		__atomic_store_n(&item->next, NULL, __ATOMIC_RELAXED);
+		previous = __atomic_exchange_n(&queue->head, item, __ATOMIC_ACQ_REL);
+		__atomic_store_n(&previous->next, item, __ATOMIC_RELEASE);
+	}
+}
+
+MPSC_QUEUE_ITEM* mpsc_queue_pop(MPSC_QUEUE* queue)
+{
+	MPSC_QUEUE_ITEM* result = NULL;
+
+	if (queue == NULL)
+	{
+		LogError("NULL queue");
+	}
+	else
+	{
+		MPSC_QUEUE_ITEM* tail = queue->tail;
+		MPSC_QUEUE_ITEM* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+		if (tail == &queue->stub)
+		{
+			if (next != NULL)
+			{
+				queue->tail = next;
+				tail = next;
+				next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+			}
+			else
+			{
+				/* empty */
+				tail = NULL;
+			}
+		}
+
+		if (tail != NULL)
+		{
+			if (next != NULL)
+			{
+				queue->tail = next;
+				result = tail;
+			}
+			else if (tail == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+			{
+				/* last item, put the stub back behind it so that it can be taken out */
+				mpsc_queue_push(queue, &queue->stub);
+				next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+				if (next != NULL)
+				{
+					queue->tail = next;
+					result = tail;
+				}
+			}
+			else
+			{
+				/* a producer is half way through a push */
+			}
+		}
+	}
+
+	return result;
+}
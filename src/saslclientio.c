@@ -276,14 +276,12 @@ static void log_incoming_frame(AMQP_VALUE performative)
         AMQP_VALUE descriptor = amqpvalue_get_inplace_descriptor(performative);
         if (descriptor != NULL)
         {
-			char* performative_as_string;
+			char performative_as_string[TRACE_STRING_BUFFER_SIZE];
             LOG(AZ_LOG_TRACE, 0, "<- ");
             LOG(AZ_LOG_TRACE, 0, (char*)get_frame_type_as_string(descriptor));
-            performative_as_string = NULL;
-            LOG(AZ_LOG_TRACE, LOG_LINE, (performative_as_string = amqpvalue_to_string(performative)));
-            if (performative_as_string != NULL)
+            if (amqpvalue_to_string_buffer(performative, performative_as_string, sizeof(performative_as_string)) == 0)
             {
-                free(performative_as_string);
+                LOG(AZ_LOG_TRACE, LOG_LINE, "%s", performative_as_string);
             }
         }
     }
@@ -300,14 +298,12 @@ static void log_outgoing_frame(AMQP_VALUE performative)
         AMQP_VALUE descriptor = amqpvalue_get_inplace_descriptor(performative);
         if (descriptor != NULL)
         {
-			char* performative_as_string;
+			char performative_as_string[TRACE_STRING_BUFFER_SIZE];
             LOG(AZ_LOG_TRACE, 0, "-> ");
             LOG(AZ_LOG_TRACE, 0, (char*)get_frame_type_as_string(descriptor));
-            performative_as_string = NULL;
-            LOG(AZ_LOG_TRACE, LOG_LINE, (performative_as_string = amqpvalue_to_string(performative)));
-            if (performative_as_string != NULL)
+            if (amqpvalue_to_string_buffer(performative, performative_as_string, sizeof(performative_as_string)) == 0)
             {
-                free(performative_as_string);
+                LOG(AZ_LOG_TRACE, LOG_LINE, "%s", performative_as_string);
             }
         }
     }
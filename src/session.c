@@ -8,10 +8,28 @@
 #include "azure_uamqp_c/session.h"
 #include "azure_uamqp_c/connection.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#define MIN_LINK_ENDPOINT_CAPACITY 4
+#define MIN_NAME_BUCKET_COUNT 8
+#define MIN_INPUT_HANDLE_TABLE_SIZE 16
+/* Remote handles above this value are not indexed and are looked up by scanning the link endpoints */
+#define MAX_INDEXED_INPUT_HANDLE 0xFFFF
+#define UNASSIGNED_INPUT_HANDLE 0xFFFFFFFF
+/* incoming window sizing used until session_set_incoming_window is called */
+#define INITIAL_ADAPTIVE_INCOMING_WINDOW 1024
+#define MIN_ADAPTIVE_INCOMING_WINDOW 64
+#define MAX_ADAPTIVE_INCOMING_WINDOW 1048576
+/* the window is sized to hold the transfers received in this long */
+#define ADAPTIVE_INCOMING_WINDOW_PERIOD 100 // ms
+#define DEFAULT_MAX_INCOMING_WINDOW_BYTES (16 * 1024 * 1024)
+/* transfers a link of weight 1 is handed per scheduling round when the remote incoming window reopens */
+#define LINK_SCHEDULING_QUANTUM 16
 
 typedef struct LINK_ENDPOINT_INSTANCE_TAG
 {
 	char* name;
+	uint32_t name_hash;
 	handle input_handle;
 	handle output_handle;
 	ON_ENDPOINT_FRAME_RECEIVED frame_received_callback;
@@ -19,6 +37,15 @@ typedef struct LINK_ENDPOINT_INSTANCE_TAG
 	ON_SESSION_FLOW_ON on_session_flow_on;
 	void* callback_context;
 	SESSION_HANDLE session;
+	struct LINK_ENDPOINT_INSTANCE_TAG* next_by_name;
+	/* share of the remote incoming window, see schedule_link_endpoints */
+	uint32_t weight;
+	int64_t deficit;
+	/* a transfer was refused for lack of window or deficit */
+	bool is_waiting_for_window;
+	/* a delivery sent a frame at a time, see session_send_transfer_frame */
+	bool is_sending_delivery;
+	delivery_number sending_delivery_id;
 } LINK_ENDPOINT_INSTANCE;
 
 typedef struct SESSION_INSTANCE_TAG
@@ -29,8 +56,19 @@ typedef struct SESSION_INSTANCE_TAG
 	SESSION_STATE previous_session_state;
 	CONNECTION_HANDLE connection;
 	ENDPOINT_HANDLE endpoint;
+	/* link endpoints sorted by output handle */
 	LINK_ENDPOINT_INSTANCE** link_endpoints;
 	uint32_t link_endpoint_count;
+	uint32_t link_endpoint_capacity;
+
+	/* link endpoints indexed by the handle the peer assigned in its ATTACH */
+	LINK_ENDPOINT_INSTANCE** input_handle_table;
+	uint32_t input_handle_table_size;
+	uint32_t unindexed_input_handle_count;
+
+	/* link endpoints hashed by link name, chained through next_by_name */
+	LINK_ENDPOINT_INSTANCE** name_buckets;
+	uint32_t name_bucket_count;
 
 	ON_LINK_ATTACHED on_link_attached;
 	void* on_link_attached_callback_context;
@@ -40,10 +78,27 @@ typedef struct SESSION_INSTANCE_TAG
 	transfer_number next_incoming_id;
     uint32_t desired_incoming_window;
 	uint32_t incoming_window;
+	/* the desired incoming window follows the transfer rate, within the byte budget */
+	bool is_incoming_window_adaptive;
+	uint64_t max_incoming_window_bytes;
+	uint32_t average_transfer_size;
+	/* created with the first refill of an adaptive window */
+	TICK_COUNTER_HANDLE tick_counter;
+	tickcounter_ms_t last_incoming_window_refill_ms;
+	bool is_last_incoming_window_refill_set;
 	uint32_t outgoing_window;
 	handle handle_max;
 	uint32_t remote_incoming_window;
 	uint32_t remote_outgoing_window;
+	/* transfers are charged to the link deficits while the reopened window is being handed out */
+	bool is_scheduling_link_endpoints;
+	uint32_t next_scheduled_link_endpoint;
+	/* deficits are only enforced while other links are waiting, a link alone sends what the window allows */
+	uint32_t waiting_link_endpoint_count;
+#ifndef UAMQP_NO_STATISTICS
+	/* only the counters are kept here, the windows are read when the statistics are asked for */
+	SESSION_STATISTICS statistics;
+#endif
 	int is_underlying_connection_open : 1;
 } SESSION_INSTANCE;
 
@@ -188,6 +243,153 @@ static int send_begin(SESSION_INSTANCE* session_instance)
 	return result;
 }
 
+static uint32_t get_adaptive_incoming_window(SESSION_INSTANCE* session_instance, tickcounter_ms_t current_ms)
+{
+	uint32_t result = session_instance->desired_incoming_window;
+	uint32_t consumed = session_instance->desired_incoming_window - session_instance->incoming_window;
+
+	if (session_instance->is_last_incoming_window_refill_set && (consumed > 0))
+	{
+		tickcounter_ms_t elapsed_ms = current_ms - session_instance->last_incoming_window_refill_ms;
+		uint64_t period_window = ((uint64_t)consumed * ADAPTIVE_INCOMING_WINDOW_PERIOD) / ((elapsed_ms == 0) ? 1 : elapsed_ms);
+
+		/* at most doubled or halved per refill, so that one burst or pause does not swing it */
+		if (period_window > (uint64_t)result * 2)
+		{
+			period_window = (uint64_t)result * 2;
+		}
+		else if (period_window < result / 2)
+		{
+			period_window = result / 2;
+		}
+
+		if (period_window > MAX_ADAPTIVE_INCOMING_WINDOW)
+		{
+			period_window = MAX_ADAPTIVE_INCOMING_WINDOW;
+		}
+		else if (period_window < MIN_ADAPTIVE_INCOMING_WINDOW)
+		{
+			period_window = MIN_ADAPTIVE_INCOMING_WINDOW;
+		}
+
+		result = (uint32_t)period_window;
+	}
+
+	if (session_instance->average_transfer_size > 0)
+	{
+		uint64_t budget_window = session_instance->max_incoming_window_bytes / session_instance->average_transfer_size;
+
+		if (budget_window < result)
+		{
+			result = (budget_window == 0) ? 1 : (uint32_t)budget_window;
+		}
+	}
+
+	return result;
+}
+
+/* reopens the incoming window, resizing it first when it is adaptive */
+static void refill_incoming_window(SESSION_INSTANCE* session_instance)
+{
+	if (session_instance->is_incoming_window_adaptive)
+	{
+		tickcounter_ms_t current_ms;
+
+		if ((session_instance->tick_counter == NULL) &&
+			((session_instance->tick_counter = tickcounter_create()) == NULL))
+		{
+			LogError("Cannot create tick counter, the incoming window keeps its size");
+		}
+		else if (tickcounter_get_current_ms(session_instance->tick_counter, &current_ms) != 0)
+		{
+			LogError("Cannot get tick counter value, the incoming window keeps its size");
+		}
+		else
+		{
+			session_instance->desired_incoming_window = get_adaptive_incoming_window(session_instance, current_ms);
+			session_instance->last_incoming_window_refill_ms = current_ms;
+			session_instance->is_last_incoming_window_refill_set = true;
+		}
+	}
+
+	session_instance->incoming_window = session_instance->desired_incoming_window;
+}
+
+static void set_link_endpoint_waiting(SESSION_INSTANCE* session_instance, LINK_ENDPOINT_INSTANCE* link_endpoint, bool is_waiting)
+{
+	if (link_endpoint->is_waiting_for_window != is_waiting)
+	{
+		link_endpoint->is_waiting_for_window = is_waiting;
+		if (is_waiting)
+		{
+			session_instance->waiting_link_endpoint_count++;
+		}
+		else
+		{
+			session_instance->waiting_link_endpoint_count--;
+		}
+	}
+}
+
+/* Hands a reopened remote incoming window to the links by deficit round robin, so that the links visited first cannot take
+   all of it every time. Each round visits every link, starting after the last one visited, adds weight times the quantum
+   to its deficit and lets it send; a transfer is refused once the deficit is spent while other links wait, and a link that
+   stops without being refused had nothing more to send and loses what is left. Rounds go on while the window lasts and links were refused. */
+static void schedule_link_endpoints(SESSION_INSTANCE* session_instance)
+{
+	bool is_any_link_endpoint_waiting = true;
+
+	session_instance->is_scheduling_link_endpoints = true;
+
+	while ((session_instance->remote_incoming_window > 0) &&
+		is_any_link_endpoint_waiting)
+	{
+		uint32_t visited_count;
+
+		is_any_link_endpoint_waiting = false;
+
+		/* the count is read again each time, a callback can remove link endpoints */
+		for (visited_count = 0; (visited_count < session_instance->link_endpoint_count) && (session_instance->remote_incoming_window > 0); visited_count++)
+		{
+			LINK_ENDPOINT_INSTANCE* link_endpoint;
+
+			if (session_instance->next_scheduled_link_endpoint >= session_instance->link_endpoint_count)
+			{
+				session_instance->next_scheduled_link_endpoint = 0;
+			}
+
+			link_endpoint = session_instance->link_endpoints[session_instance->next_scheduled_link_endpoint];
+			session_instance->next_scheduled_link_endpoint++;
+
+			if (link_endpoint->on_session_flow_on != NULL)
+			{
+				int64_t quantum = (int64_t)link_endpoint->weight * LINK_SCHEDULING_QUANTUM;
+
+				/* what a link could not spend because the window closed is kept, up to one more visit */
+				link_endpoint->deficit += quantum;
+				if (link_endpoint->deficit > 2 * quantum)
+				{
+					link_endpoint->deficit = 2 * quantum;
+				}
+
+				set_link_endpoint_waiting(session_instance, link_endpoint, false);
+				link_endpoint->on_session_flow_on(link_endpoint->callback_context);
+
+				if (link_endpoint->is_waiting_for_window)
+				{
+					is_any_link_endpoint_waiting = true;
+				}
+				else
+				{
+					link_endpoint->deficit = 0;
+				}
+			}
+		}
+	}
+
+	session_instance->is_scheduling_link_endpoints = false;
+}
+
 static int send_flow(SESSION_INSTANCE* session)
 {
 	int result;
@@ -224,6 +426,7 @@ static int send_flow(SESSION_INSTANCE* session)
 					}
 					else
 					{
+						AMQP_STATISTICS_INCREMENT(session->statistics.flows_sent);
 						result = 0;
 					}
 
@@ -238,56 +441,268 @@ static int send_flow(SESSION_INSTANCE* session)
 	return result;
 }
 
+static uint32_t get_name_hash(const char* name)
+{
+	/* FNV-1a */
+	uint32_t result = 2166136261u;
+
+	while (*name != '\0')
+	{
+		result ^= (unsigned char)*name;
+		result *= 16777619u;
+		name++;
+	}
+
+	return result;
+}
+
 static LINK_ENDPOINT_INSTANCE* find_link_endpoint_by_name(SESSION_INSTANCE* session, const char* name)
 {
-	uint32_t i;
 	LINK_ENDPOINT_INSTANCE* result;
 
-	for (i = 0; i < session->link_endpoint_count; i++)
+	if (session->name_bucket_count == 0)
 	{
-		if (strcmp(session->link_endpoints[i]->name, name) == 0)
+		result = NULL;
+	}
+	else
+	{
+		uint32_t name_hash = get_name_hash(name);
+
+		result = session->name_buckets[name_hash & (session->name_bucket_count - 1)];
+		while ((result != NULL) &&
+			((result->name_hash != name_hash) || (strcmp(result->name, name) != 0)))
 		{
-			break;
+			result = result->next_by_name;
 		}
 	}
 
-	if (i == session->link_endpoint_count)
+	return result;
+}
+
+static void add_link_endpoint_to_name_buckets(LINK_ENDPOINT_INSTANCE** name_buckets, uint32_t name_bucket_count, LINK_ENDPOINT_INSTANCE* link_endpoint)
+{
+	/* append so that for duplicate names the oldest link endpoint keeps being found first */
+	LINK_ENDPOINT_INSTANCE** current = &name_buckets[link_endpoint->name_hash & (name_bucket_count - 1)];
+	while (*current != NULL)
 	{
-		result = NULL;
+		current = &(*current)->next_by_name;
+	}
+
+	link_endpoint->next_by_name = NULL;
+	*current = link_endpoint;
+}
+
+static void remove_link_endpoint_from_name_buckets(SESSION_INSTANCE* session, LINK_ENDPOINT_INSTANCE* link_endpoint)
+{
+	if (session->name_bucket_count > 0)
+	{
+		LINK_ENDPOINT_INSTANCE** current = &session->name_buckets[link_endpoint->name_hash & (session->name_bucket_count - 1)];
+		while ((*current != NULL) && (*current != link_endpoint))
+		{
+			current = &(*current)->next_by_name;
+		}
+
+		if (*current != NULL)
+		{
+			*current = link_endpoint->next_by_name;
+		}
+
+		link_endpoint->next_by_name = NULL;
+	}
+}
+
+static int ensure_name_bucket_capacity(SESSION_INSTANCE* session, uint32_t link_endpoint_count)
+{
+	int result;
+
+	/* keep the load factor at or below 3/4 */
+	if ((session->name_bucket_count > 0) &&
+		(link_endpoint_count <= session->name_bucket_count - (session->name_bucket_count / 4)))
+	{
+		result = 0;
 	}
 	else
 	{
-		result = session->link_endpoints[i];
+		uint32_t new_bucket_count = (session->name_bucket_count == 0) ? MIN_NAME_BUCKET_COUNT : session->name_bucket_count * 2;
+		LINK_ENDPOINT_INSTANCE** new_name_buckets = (LINK_ENDPOINT_INSTANCE**)malloc(sizeof(LINK_ENDPOINT_INSTANCE*) * new_bucket_count);
+		if (new_name_buckets == NULL)
+		{
+			LogError("Cannot allocate memory for link endpoint name buckets");
+			result = __FAILURE__;
+		}
+		else
+		{
+			uint32_t i;
+
+			for (i = 0; i < new_bucket_count; i++)
+			{
+				new_name_buckets[i] = NULL;
+			}
+
+			for (i = 0; i < session->link_endpoint_count; i++)
+			{
+				add_link_endpoint_to_name_buckets(new_name_buckets, new_bucket_count, session->link_endpoints[i]);
+			}
+
+			if (session->name_buckets != NULL)
+			{
+				free(session->name_buckets);
+			}
+
+			session->name_buckets = new_name_buckets;
+			session->name_bucket_count = new_bucket_count;
+			result = 0;
+		}
 	}
 
 	return result;
 }
 
-static LINK_ENDPOINT_INSTANCE* find_link_endpoint_by_input_handle(SESSION_INSTANCE* session, handle input_handle)
+static bool is_input_handle_indexed(SESSION_INSTANCE* session, LINK_ENDPOINT_INSTANCE* link_endpoint)
 {
-	uint32_t i;
-	LINK_ENDPOINT_INSTANCE* result;
+	return (link_endpoint->input_handle < session->input_handle_table_size) &&
+		(session->input_handle_table[link_endpoint->input_handle] == link_endpoint);
+}
 
-	for (i = 0; i < session->link_endpoint_count; i++)
+static void clear_link_endpoint_input_handle(SESSION_INSTANCE* session, LINK_ENDPOINT_INSTANCE* link_endpoint)
+{
+	if (link_endpoint->input_handle != UNASSIGNED_INPUT_HANDLE)
 	{
-		if (session->link_endpoints[i]->input_handle == input_handle)
+		if (is_input_handle_indexed(session, link_endpoint))
+		{
+			session->input_handle_table[link_endpoint->input_handle] = NULL;
+		}
+		else
+		{
+			session->unindexed_input_handle_count--;
+		}
+
+		link_endpoint->input_handle = UNASSIGNED_INPUT_HANDLE;
+	}
+}
+
+static void set_link_endpoint_input_handle(SESSION_INSTANCE* session, LINK_ENDPOINT_INSTANCE* link_endpoint, handle input_handle)
+{
+	clear_link_endpoint_input_handle(session, link_endpoint);
+	link_endpoint->input_handle = input_handle;
+
+	if (input_handle == UNASSIGNED_INPUT_HANDLE)
+	{
+		/* nothing to index */
+	}
+	else if (input_handle > MAX_INDEXED_INPUT_HANDLE)
+	{
+		session->unindexed_input_handle_count++;
+	}
+	else
+	{
+		if (input_handle >= session->input_handle_table_size)
+		{
+			uint32_t new_table_size = (session->input_handle_table_size == 0) ? MIN_INPUT_HANDLE_TABLE_SIZE : session->input_handle_table_size;
+			LINK_ENDPOINT_INSTANCE** new_input_handle_table;
+
+			while (new_table_size <= input_handle)
+			{
+				new_table_size *= 2;
+			}
+
+			new_input_handle_table = (LINK_ENDPOINT_INSTANCE**)realloc(session->input_handle_table, sizeof(LINK_ENDPOINT_INSTANCE*) * new_table_size);
+			if (new_input_handle_table == NULL)
+			{
+				/* lookups for this handle fall back to scanning the link endpoints */
+				LogError("Cannot grow the input handle table, handle %u is not indexed", (unsigned int)input_handle);
+			}
+			else
+			{
+				uint32_t i;
+
+				for (i = session->input_handle_table_size; i < new_table_size; i++)
+				{
+					new_input_handle_table[i] = NULL;
+				}
+
+				session->input_handle_table = new_input_handle_table;
+				session->input_handle_table_size = new_table_size;
+			}
+		}
+
+		if (input_handle >= session->input_handle_table_size)
 		{
-			break;
+			session->unindexed_input_handle_count++;
+		}
+		else
+		{
+			if (session->input_handle_table[input_handle] != NULL)
+			{
+				/* the peer reused a handle still held by another link endpoint, the newest attach owns it */
+				session->unindexed_input_handle_count++;
+			}
+
+			session->input_handle_table[input_handle] = link_endpoint;
 		}
 	}
+}
+
+static LINK_ENDPOINT_INSTANCE* find_link_endpoint_by_input_handle(SESSION_INSTANCE* session, handle input_handle)
+{
+	LINK_ENDPOINT_INSTANCE* result;
 
-	if (i == session->link_endpoint_count)
+	if ((input_handle < session->input_handle_table_size) &&
+		(session->input_handle_table[input_handle] != NULL))
+	{
+		result = session->input_handle_table[input_handle];
+	}
+	else if (session->unindexed_input_handle_count == 0)
 	{
 		result = NULL;
 	}
 	else
 	{
-		result = session->link_endpoints[i];
+		uint32_t i;
+
+		for (i = 0; i < session->link_endpoint_count; i++)
+		{
+			if (session->link_endpoints[i]->input_handle == input_handle)
+			{
+				break;
+			}
+		}
+
+		if (i == session->link_endpoint_count)
+		{
+			result = NULL;
+		}
+		else
+		{
+			result = session->link_endpoints[i];
+		}
 	}
 
 	return result;
 }
 
+static uint32_t find_link_endpoint_index_by_output_handle(SESSION_INSTANCE* session, handle output_handle)
+{
+	/* binary search, link_endpoints is sorted by output handle */
+	uint32_t low = 0;
+	uint32_t high = session->link_endpoint_count;
+
+	while (low < high)
+	{
+		uint32_t middle = low + ((high - low) / 2);
+		if (session->link_endpoints[middle]->output_handle < output_handle)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
 static void on_connection_state_changed(void* context, CONNECTION_STATE new_connection_state, CONNECTION_STATE previous_connection_state)
 {
 	SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)context;
@@ -373,6 +788,7 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 			role role;
 			AMQP_VALUE source;
 			AMQP_VALUE target;
+			handle input_handle;
 
 			if ((attach_get_name(attach_handle, &name) != 0) ||
 				(attach_get_role(attach_handle, &role) != 0) ||
@@ -394,12 +810,14 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 						{
 							end_session_with_error(session_instance, "amqp:internal-error", "Cannot create link endpoint");
 						}
-                        else if (attach_get_handle(attach_handle, &new_link_endpoint->input_handle) != 0)
+                        else if (attach_get_handle(attach_handle, &input_handle) != 0)
                         {
                             end_session_with_error(session_instance, "amqp:decode-error", "Cannot get input handle from ATTACH frame");
                         }
                         else
 						{
+							set_link_endpoint_input_handle(session_instance, new_link_endpoint, input_handle);
+
 							if (!session_instance->on_link_attached(session_instance->on_link_attached_callback_context, new_link_endpoint, name, role, source, target))
 							{
 								session_destroy_link_endpoint(new_link_endpoint);
@@ -417,12 +835,13 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 				}
 				else
 				{
-					if (attach_get_handle(attach_handle, &link_endpoint->input_handle) != 0)
+					if (attach_get_handle(attach_handle, &input_handle) != 0)
 					{
 						end_session_with_error(session_instance, "amqp:decode-error", "Cannot get input handle from ATTACH frame");
 					}
 					else
 					{
+						set_link_endpoint_input_handle(session_instance, link_endpoint, input_handle);
 						link_endpoint->frame_received_callback(link_endpoint->callback_context, performative, payload_size, payload_bytes);
 					}
 				}
@@ -499,7 +918,6 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 			else
 			{
 				LINK_ENDPOINT_INSTANCE* link_endpoint_instance = NULL;
-				size_t i;
 
 				session_instance->remote_incoming_window = flow_next_incoming_id + flow_incoming_window - session_instance->next_outgoing_id;
 
@@ -512,20 +930,13 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 
 				if (link_endpoint_instance != NULL)
 				{
+					/* what the link sends because of its own flow is charged to it as well */
+					session_instance->is_scheduling_link_endpoints = true;
 					link_endpoint_instance->frame_received_callback(link_endpoint_instance->callback_context, performative, payload_size, payload_bytes);
+					session_instance->is_scheduling_link_endpoints = false;
 				}
 
-				i = 0;
-				while ((session_instance->remote_incoming_window > 0) && (i < session_instance->link_endpoint_count))
-				{
-					/* notify the caller that it can send here */
-					if (session_instance->link_endpoints[i]->on_session_flow_on != NULL)
-					{
-						session_instance->link_endpoints[i]->on_session_flow_on(session_instance->link_endpoints[i]->callback_context);
-					}
-
-					i++;
-				}
+				schedule_link_endpoints(session_instance);
 			}
 		}
 	}
@@ -533,6 +944,8 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 	{
 		TRANSFER_HANDLE transfer_handle;
 
+		AMQP_STATISTICS_INCREMENT(session_instance->statistics.transfer_frames_received);
+
 		if (amqpvalue_get_transfer(performative, &transfer_handle) != 0)
 		{
 			end_session_with_error(session_instance, "amqp:decode-error", "Cannot decode TRANSFER frame");
@@ -557,6 +970,15 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 				session_instance->remote_outgoing_window--;
 				session_instance->incoming_window--;
 
+				if (session_instance->average_transfer_size == 0)
+				{
+					session_instance->average_transfer_size = payload_size;
+				}
+				else
+				{
+					session_instance->average_transfer_size = (uint32_t)((int64_t)session_instance->average_transfer_size + (((int64_t)payload_size - (int64_t)session_instance->average_transfer_size) / 8));
+				}
+
 				link_endpoint = find_link_endpoint_by_input_handle(session_instance, remote_handle);
 				if (link_endpoint == NULL)
 				{
@@ -567,10 +989,15 @@ static void on_frame_received(void* context, AMQP_VALUE performative, uint32_t p
 					link_endpoint->frame_received_callback(link_endpoint->callback_context, performative, payload_size, payload_bytes);
 				}
 
-				if (session_instance->incoming_window == 0)
+				/* reopened at half the window, not once it is closed, so that the flow reaches the peer before it has to stop;
+				   link flows sent in between carry the session window as well */
+				if (session_instance->incoming_window <= session_instance->desired_incoming_window / 2)
 				{
-                    session_instance->incoming_window = session_instance->desired_incoming_window;
-					send_flow(session_instance);
+					refill_incoming_window(session_instance);
+					if (send_flow(session_instance) != 0)
+					{
+						LogError("Cannot send flow");
+					}
 				}
 			}
 		}
@@ -631,23 +1058,41 @@ SESSION_HANDLE session_create(CONNECTION_HANDLE connection, ON_LINK_ATTACHED on_
 			result->connection = connection;
 			result->link_endpoints = NULL;
 			result->link_endpoint_count = 0;
+			result->link_endpoint_capacity = 0;
+			result->input_handle_table = NULL;
+			result->input_handle_table_size = 0;
+			result->unindexed_input_handle_count = 0;
+			result->name_buckets = NULL;
+			result->name_bucket_count = 0;
 			result->handle_max = 4294967295u;
 
 			/* Codes_SRS_SESSION_01_057: [The delivery ids shall be assigned starting at 0.] */
 			/* Codes_SRS_SESSION_01_017: [The nextoutgoing-id MAY be initialized to an arbitrary value ] */
 			result->next_outgoing_id = 0;
 
-            result->desired_incoming_window = 1;
-            result->incoming_window = 1;
+            result->desired_incoming_window = INITIAL_ADAPTIVE_INCOMING_WINDOW;
+            result->incoming_window = INITIAL_ADAPTIVE_INCOMING_WINDOW;
+			result->is_incoming_window_adaptive = true;
+			result->max_incoming_window_bytes = DEFAULT_MAX_INCOMING_WINDOW_BYTES;
+			result->average_transfer_size = 0;
+			result->tick_counter = NULL;
+			result->last_incoming_window_refill_ms = 0;
+			result->is_last_incoming_window_refill_set = false;
 			result->outgoing_window = 1;
 			result->handle_max = 4294967295u;
 			result->remote_incoming_window = 0;
 			result->remote_outgoing_window = 0;
+			result->is_scheduling_link_endpoints = false;
+			result->next_scheduled_link_endpoint = 0;
+			result->waiting_link_endpoint_count = 0;
 			result->previous_session_state = SESSION_STATE_UNMAPPED;
 			result->is_underlying_connection_open = UNDERLYING_CONNECTION_NOT_OPEN;
 			result->session_state = SESSION_STATE_UNMAPPED;
 			result->on_link_attached = on_link_attached;
 			result->on_link_attached_callback_context = callback_context;
+#ifndef UAMQP_NO_STATISTICS
+			(void)memset(&result->statistics, 0, sizeof(result->statistics));
+#endif
 
 			/* Codes_SRS_SESSION_01_032: [session_create shall create a new session endpoint by calling connection_create_endpoint.] */
 			result->endpoint = connection_create_endpoint(connection);
@@ -683,21 +1128,39 @@ SESSION_HANDLE session_create_from_endpoint(CONNECTION_HANDLE connection, ENDPOI
 			result->connection = connection;
 			result->link_endpoints = NULL;
 			result->link_endpoint_count = 0;
+			result->link_endpoint_capacity = 0;
+			result->input_handle_table = NULL;
+			result->input_handle_table_size = 0;
+			result->unindexed_input_handle_count = 0;
+			result->name_buckets = NULL;
+			result->name_bucket_count = 0;
 			result->handle_max = 4294967295u;
 
 			result->next_outgoing_id = 0;
 
-            result->desired_incoming_window = 1;
-            result->incoming_window = 1;
+            result->desired_incoming_window = INITIAL_ADAPTIVE_INCOMING_WINDOW;
+            result->incoming_window = INITIAL_ADAPTIVE_INCOMING_WINDOW;
+			result->is_incoming_window_adaptive = true;
+			result->max_incoming_window_bytes = DEFAULT_MAX_INCOMING_WINDOW_BYTES;
+			result->average_transfer_size = 0;
+			result->tick_counter = NULL;
+			result->last_incoming_window_refill_ms = 0;
+			result->is_last_incoming_window_refill_set = false;
 			result->outgoing_window = 1;
 			result->handle_max = 4294967295u;
 			result->remote_incoming_window = 0;
 			result->remote_outgoing_window = 0;
+			result->is_scheduling_link_endpoints = false;
+			result->next_scheduled_link_endpoint = 0;
+			result->waiting_link_endpoint_count = 0;
 			result->previous_session_state = SESSION_STATE_UNMAPPED;
 			result->is_underlying_connection_open = UNDERLYING_CONNECTION_NOT_OPEN;
 			result->session_state = SESSION_STATE_UNMAPPED;
 			result->on_link_attached = on_link_attached;
 			result->on_link_attached_callback_context = callback_context;
+#ifndef UAMQP_NO_STATISTICS
+			(void)memset(&result->statistics, 0, sizeof(result->statistics));
+#endif
 
 			result->endpoint = endpoint;
 			session_set_state(result, SESSION_STATE_UNMAPPED);
@@ -724,6 +1187,21 @@ void session_destroy(SESSION_HANDLE session)
 			free(session_instance->link_endpoints);
 		}
 
+		if (session_instance->input_handle_table != NULL)
+		{
+			free(session_instance->input_handle_table);
+		}
+
+		if (session_instance->name_buckets != NULL)
+		{
+			free(session_instance->name_buckets);
+		}
+
+		if (session_instance->tick_counter != NULL)
+		{
+			tickcounter_destroy(session_instance->tick_counter);
+		}
+
 		free(session);
 	}
 }
@@ -844,6 +1322,30 @@ int session_set_incoming_window(SESSION_HANDLE session, uint32_t incoming_window
 
 		session_instance->desired_incoming_window = incoming_window;
         session_instance->incoming_window = incoming_window;
+		session_instance->is_incoming_window_adaptive = false;
+
+		result = 0;
+	}
+
+	return result;
+}
+
+int session_set_incoming_window_budget(SESSION_HANDLE session, uint64_t max_incoming_window_bytes)
+{
+	int result;
+
+	if ((session == NULL) ||
+		(max_incoming_window_bytes == 0))
+	{
+		LogError("Bad arguments: session = %p, max_incoming_window_bytes = %llu",
+			session, (unsigned long long)max_incoming_window_bytes);
+		result = __FAILURE__;
+	}
+	else
+	{
+		SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)session;
+
+		session_instance->max_incoming_window_bytes = max_incoming_window_bytes;
 
 		result = 0;
 	}
@@ -954,6 +1456,39 @@ int session_get_handle_max(SESSION_HANDLE session, handle* handle_max)
 	return result;
 }
 
+int session_get_statistics(SESSION_HANDLE session, SESSION_STATISTICS* statistics)
+{
+	int result;
+
+	if ((session == NULL) ||
+		(statistics == NULL))
+	{
+		LogError("Bad arguments: session = %p, statistics = %p",
+			session, statistics);
+		result = __FAILURE__;
+	}
+	else
+	{
+#ifndef UAMQP_NO_STATISTICS
+		SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)session;
+
+		*statistics = session_instance->statistics;
+		statistics->incoming_window = session_instance->incoming_window;
+		statistics->outgoing_window = session_instance->outgoing_window;
+		statistics->remote_incoming_window = session_instance->remote_incoming_window;
+		statistics->remote_outgoing_window = session_instance->remote_outgoing_window;
+		statistics->link_endpoint_count = session_instance->link_endpoint_count;
+
+		result = 0;
+#else
+		LogError("Statistics are not compiled in");
+		result = __FAILURE__;
+#endif
+	}
+
+	return result;
+}
+
 LINK_ENDPOINT_HANDLE session_create_link_endpoint(SESSION_HANDLE session, const char* name)
 {
 	LINK_ENDPOINT_INSTANCE* result;
@@ -978,14 +1513,24 @@ LINK_ENDPOINT_HANDLE session_create_link_endpoint(SESSION_HANDLE session, const
 			size_t i;
             size_t name_length;
 
-			for (i = 0; i < session_instance->link_endpoint_count; i++)
+			if ((session_instance->link_endpoint_count == 0) ||
+				(session_instance->link_endpoints[session_instance->link_endpoint_count - 1]->output_handle == session_instance->link_endpoint_count - 1))
 			{
-				if (session_instance->link_endpoints[i]->output_handle > selected_handle)
+				/* no gaps in the used handles, the next handle goes at the end */
+				selected_handle = session_instance->link_endpoint_count;
+				i = session_instance->link_endpoint_count;
+			}
+			else
+			{
+				for (i = 0; i < session_instance->link_endpoint_count; i++)
 				{
-					break;
-				}
+					if (session_instance->link_endpoints[i]->output_handle > selected_handle)
+					{
+						break;
+					}
 
-				selected_handle++;
+					selected_handle++;
+				}
 			}
 
 			result->on_session_state_changed = NULL;
@@ -993,7 +1538,13 @@ LINK_ENDPOINT_HANDLE session_create_link_endpoint(SESSION_HANDLE session, const
 			result->frame_received_callback = NULL;
 			result->callback_context = NULL;
 			result->output_handle = selected_handle;
-			result->input_handle = 0xFFFFFFFF;
+			result->input_handle = UNASSIGNED_INPUT_HANDLE;
+			result->next_by_name = NULL;
+			result->weight = 1;
+			result->deficit = 0;
+			result->is_waiting_for_window = false;
+			result->is_sending_delivery = false;
+			result->sending_delivery_id = 0;
             name_length = strlen(name);
 			result->name = (char*)malloc(name_length + 1);
 			if (result->name == NULL)
@@ -1004,29 +1555,46 @@ LINK_ENDPOINT_HANDLE session_create_link_endpoint(SESSION_HANDLE session, const
 			}
 			else
 			{
-				LINK_ENDPOINT_INSTANCE** new_link_endpoints;
 				(void)memcpy(result->name, name, name_length + 1);
+				result->name_hash = get_name_hash(name);
 				result->session = session;
 
-				new_link_endpoints = (LINK_ENDPOINT_INSTANCE**)realloc(session_instance->link_endpoints, sizeof(LINK_ENDPOINT_INSTANCE*) * (session_instance->link_endpoint_count + 1));
-				if (new_link_endpoints == NULL)
+				if (session_instance->link_endpoint_count == session_instance->link_endpoint_capacity)
+				{
+					uint32_t new_capacity = (session_instance->link_endpoint_capacity == 0) ? MIN_LINK_ENDPOINT_CAPACITY : session_instance->link_endpoint_capacity * 2;
+					LINK_ENDPOINT_INSTANCE** new_link_endpoints = (LINK_ENDPOINT_INSTANCE**)realloc(session_instance->link_endpoints, sizeof(LINK_ENDPOINT_INSTANCE*) * new_capacity);
+					if (new_link_endpoints != NULL)
+					{
+						session_instance->link_endpoints = new_link_endpoints;
+						session_instance->link_endpoint_capacity = new_capacity;
+					}
+				}
+
+				if (session_instance->link_endpoint_count == session_instance->link_endpoint_capacity)
 				{
 					/* Codes_SRS_SESSION_01_045: [If allocating memory for the link endpoint fails, session_create_link_endpoint shall fail and return NULL.] */
                     free(result->name);
 					free(result);
 					result = NULL;
 				}
+				else if (ensure_name_bucket_capacity(session_instance, session_instance->link_endpoint_count + 1) != 0)
+				{
+					/* Codes_SRS_SESSION_01_045: [If allocating memory for the link endpoint fails, session_create_link_endpoint shall fail and return NULL.] */
+					free(result->name);
+					free(result);
+					result = NULL;
+				}
 				else
 				{
-					session_instance->link_endpoints = new_link_endpoints;
-
-					if (session_instance->link_endpoint_count - selected_handle > 0)
+					if (session_instance->link_endpoint_count - i > 0)
 					{
-						(void)memmove(&session_instance->link_endpoints[selected_handle + 1], &session_instance->link_endpoints[selected_handle], (session_instance->link_endpoint_count - selected_handle) * sizeof(LINK_ENDPOINT_INSTANCE*));
+						(void)memmove(&session_instance->link_endpoints[i + 1], &session_instance->link_endpoints[i], (session_instance->link_endpoint_count - i) * sizeof(LINK_ENDPOINT_INSTANCE*));
 					}
 
-					session_instance->link_endpoints[selected_handle] = result;
+					session_instance->link_endpoints[i] = result;
 					session_instance->link_endpoint_count++;
+
+					add_link_endpoint_to_name_buckets(session_instance->name_buckets, session_instance->name_bucket_count, result);
 				}
 			}
 		}
@@ -1042,41 +1610,24 @@ void session_destroy_link_endpoint(LINK_ENDPOINT_HANDLE link_endpoint)
 	{
 		LINK_ENDPOINT_INSTANCE* endpoint_instance = (LINK_ENDPOINT_INSTANCE*)link_endpoint;
 		SESSION_INSTANCE* session_instance = endpoint_instance->session;
-		uint64_t i;
+		uint32_t i;
 
 		/* Codes_SRS_SESSION_01_049: [session_destroy_link_endpoint shall free all resources associated with the endpoint.] */
-		for (i = 0; i < session_instance->link_endpoint_count; i++)
-		{
-			if (session_instance->link_endpoints[i] == link_endpoint)
-			{
-				break;
-			}
-		}
-
-		if (i < session_instance->link_endpoint_count)
+		i = find_link_endpoint_index_by_output_handle(session_instance, endpoint_instance->output_handle);
+		if ((i < session_instance->link_endpoint_count) &&
+			(session_instance->link_endpoints[i] == endpoint_instance))
 		{
-			LINK_ENDPOINT_INSTANCE** new_endpoints;
-
+			/* the array is kept at its capacity and only released in session_destroy */
 			if (i < (session_instance->link_endpoint_count - 1))
 			{
-				(void)memmove(&session_instance->link_endpoints[i], &session_instance->link_endpoints[i + 1], (session_instance->link_endpoint_count - (uint32_t)i - 1) * sizeof(LINK_ENDPOINT_INSTANCE*));
+				(void)memmove(&session_instance->link_endpoints[i], &session_instance->link_endpoints[i + 1], (session_instance->link_endpoint_count - i - 1) * sizeof(LINK_ENDPOINT_INSTANCE*));
 			}
 
 			session_instance->link_endpoint_count--;
+			set_link_endpoint_waiting(session_instance, endpoint_instance, false);
 
-			if (session_instance->link_endpoint_count == 0)
-			{
-				free(session_instance->link_endpoints);
-				session_instance->link_endpoints = NULL;
-			}
-			else
-			{
-				new_endpoints = (LINK_ENDPOINT_INSTANCE**)realloc(session_instance->link_endpoints, sizeof(LINK_ENDPOINT_INSTANCE*) * session_instance->link_endpoint_count);
-				if (new_endpoints != NULL)
-				{
-					session_instance->link_endpoints = new_endpoints;
-				}
-			}
+			remove_link_endpoint_from_name_buckets(session_instance, endpoint_instance);
+			clear_link_endpoint_input_handle(session_instance, endpoint_instance);
 		}
 
 		if (endpoint_instance->name != NULL)
@@ -1088,6 +1639,28 @@ void session_destroy_link_endpoint(LINK_ENDPOINT_HANDLE link_endpoint)
 	}
 }
 
+int session_set_link_endpoint_weight(LINK_ENDPOINT_HANDLE link_endpoint, uint32_t weight)
+{
+	int result;
+
+	if ((link_endpoint == NULL) ||
+		(weight == 0))
+	{
+		LogError("Bad arguments: link_endpoint = %p, weight = %u", link_endpoint, (unsigned int)weight);
+		result = __FAILURE__;
+	}
+	else
+	{
+		LINK_ENDPOINT_INSTANCE* link_endpoint_instance = (LINK_ENDPOINT_INSTANCE*)link_endpoint;
+
+		link_endpoint_instance->weight = weight;
+
+		result = 0;
+	}
+
+	return result;
+}
+
 int session_start_link_endpoint(LINK_ENDPOINT_HANDLE link_endpoint, ON_ENDPOINT_FRAME_RECEIVED frame_received_callback, ON_SESSION_STATE_CHANGED on_session_state_changed, ON_SESSION_FLOW_ON on_session_flow_on, void* context)
 {
 	int result;
@@ -1168,6 +1741,12 @@ int session_send_flow(LINK_ENDPOINT_HANDLE link_endpoint, FLOW_HANDLE flow)
 
 		if (result == 0)
 		{
+			/* the session window rides along, topped up, so that it rarely needs a flow of its own */
+			if (session_instance->incoming_window < session_instance->desired_incoming_window)
+			{
+				refill_incoming_window(session_instance);
+			}
+
             if ((flow_set_next_incoming_id(flow, session_instance->next_incoming_id) != 0) ||
                 (flow_set_incoming_window(flow, session_instance->incoming_window) != 0) ||
                 (flow_set_next_outgoing_id(flow, session_instance->next_outgoing_id) != 0) ||
@@ -1191,6 +1770,7 @@ int session_send_flow(LINK_ENDPOINT_HANDLE link_endpoint, FLOW_HANDLE flow)
 					}
 					else
 					{
+						AMQP_STATISTICS_INCREMENT(session_instance->statistics.flows_sent);
 						result = 0;
 					}
 
@@ -1367,8 +1947,14 @@ SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_end
             }
             else
             {
-                if (session_instance->remote_incoming_window == 0)
+                if ((session_instance->remote_incoming_window == 0) ||
+                    (session_instance->is_scheduling_link_endpoints &&
+                        (link_endpoint_instance->deficit <= 0) &&
+                        (session_instance->waiting_link_endpoint_count > (link_endpoint_instance->is_waiting_for_window ? 1u : 0u))))
                 {
+                    /* the link is handed a share of the window when it reopens */
+                    set_link_endpoint_waiting(session_instance, link_endpoint_instance, true);
+                    AMQP_STATISTICS_INCREMENT(session_instance->statistics.send_transfer_busy_count);
                     result = SESSION_SEND_TRANSFER_BUSY;
                 }
                 else
@@ -1429,6 +2015,13 @@ SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_end
                                         session_instance->next_outgoing_id++;
                                         session_instance->remote_incoming_window--;
                                         session_instance->outgoing_window--;
+                                        if (session_instance->is_scheduling_link_endpoints)
+                                        {
+                                            link_endpoint_instance->deficit--;
+                                        }
+
+                                        AMQP_STATISTICS_INCREMENT(session_instance->statistics.transfers_sent);
+                                        AMQP_STATISTICS_INCREMENT(session_instance->statistics.transfer_frames_sent);
 
                                         /* Codes_SRS_SESSION_01_053: [On success, session_send_transfer shall return 0.] */
                                         result = SESSION_SEND_TRANSFER_OK;
@@ -1528,7 +2121,8 @@ SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_end
                                             transfer_frame_payload_count++;
                                         }
 
-                                        if (connection_encode_frame(session_instance->endpoint, multi_transfer_amqp_value, transfer_frame_payloads, transfer_frame_payload_count, on_send_complete, callback_context) != 0)
+                                        /* the delivery is sent once its last frame is, the callback is only passed with that one */
+                                        if (connection_encode_frame(session_instance->endpoint, multi_transfer_amqp_value, transfer_frame_payloads, transfer_frame_payload_count, more ? NULL : on_send_complete, callback_context) != 0)
                                         {
                                             free(transfer_frame_payloads);
                                             amqpvalue_destroy(multi_transfer_amqp_value);
@@ -1538,6 +2132,7 @@ SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_end
                                         free(transfer_frame_payloads);
                                         amqpvalue_destroy(multi_transfer_amqp_value);
                                         payload_size -= current_transfer_frame_payload_size;
+                                        AMQP_STATISTICS_INCREMENT(session_instance->statistics.transfer_frames_sent);
                                     }
 
                                     if (payload_size > 0)
@@ -1550,6 +2145,13 @@ SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_end
                                         session_instance->next_outgoing_id++;
                                         session_instance->remote_incoming_window--;
                                         session_instance->outgoing_window--;
+                                        if (session_instance->is_scheduling_link_endpoints)
+                                        {
+                                            link_endpoint_instance->deficit--;
+                                        }
+
+                                        AMQP_STATISTICS_INCREMENT(session_instance->statistics.transfers_sent);
+                                        AMQP_STATISTICS_INCREMENT(session_instance->statistics.split_transfers_sent);
 
                                         result = SESSION_SEND_TRANSFER_OK;
                                     }
@@ -1566,3 +2168,179 @@ SESSION_SEND_TRANSFER_RESULT session_send_transfer(LINK_ENDPOINT_HANDLE link_end
 
 	return result;
 }
+
+int session_get_transfer_frame_payload_size(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, uint32_t* payload_size)
+{
+	int result;
+
+	if ((link_endpoint == NULL) ||
+		(transfer == NULL) ||
+		(payload_size == NULL))
+	{
+		LogError("Bad arguments: link_endpoint = %p, transfer = %p, payload_size = %p",
+			link_endpoint, transfer, payload_size);
+		result = __FAILURE__;
+	}
+	else
+	{
+		LINK_ENDPOINT_INSTANCE* link_endpoint_instance = (LINK_ENDPOINT_INSTANCE*)link_endpoint;
+		SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)link_endpoint_instance->session;
+		AMQP_VALUE transfer_value;
+
+		/* as large as the performative gets: every delivery id encodes in 5 bytes from 256 on */
+		if ((transfer_set_handle(transfer, link_endpoint_instance->output_handle) != 0) ||
+			(transfer_set_delivery_id(transfer, UINT32_MAX) != 0) ||
+			(transfer_set_more(transfer, true) != 0) ||
+			((transfer_value = amqpvalue_create_transfer(transfer)) == NULL))
+		{
+			LogError("Cannot create transfer performative");
+			result = __FAILURE__;
+		}
+		else
+		{
+			uint32_t max_frame_size;
+			size_t encoded_size;
+
+			if ((connection_get_remote_max_frame_size(session_instance->connection, &max_frame_size) != 0) ||
+				(amqpvalue_get_encoded_size(transfer_value, &encoded_size) != 0))
+			{
+				LogError("Cannot get the frame size");
+				result = __FAILURE__;
+			}
+			else if (max_frame_size <= encoded_size + 8)
+			{
+				LogError("Max frame size %u leaves no room for a payload", (unsigned int)max_frame_size);
+				result = __FAILURE__;
+			}
+			else
+			{
+				*payload_size = max_frame_size - (uint32_t)encoded_size - 8;
+				result = 0;
+			}
+
+			amqpvalue_destroy(transfer_value);
+		}
+	}
+
+	return result;
+}
+
+SESSION_SEND_TRANSFER_RESULT session_send_transfer_frame(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, PAYLOAD* payloads, size_t payload_count, delivery_number* delivery_id, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	SESSION_SEND_TRANSFER_RESULT result;
+
+	if ((link_endpoint == NULL) ||
+		(transfer == NULL) ||
+		(delivery_id == NULL) ||
+		((payloads == NULL) && (payload_count > 0)))
+	{
+		LogError("Bad arguments: link_endpoint = %p, transfer = %p, delivery_id = %p, payloads = %p, payload_count = %u",
+			link_endpoint, transfer, delivery_id, payloads, (unsigned int)payload_count);
+		result = SESSION_SEND_TRANSFER_ERROR;
+	}
+	else
+	{
+		LINK_ENDPOINT_INSTANCE* link_endpoint_instance = (LINK_ENDPOINT_INSTANCE*)link_endpoint;
+		SESSION_INSTANCE* session_instance = (SESSION_INSTANCE*)link_endpoint_instance->session;
+		delivery_tag first_frame_delivery_tag;
+		/* the delivery tag is only carried by the first frame of a delivery */
+		bool is_first_frame = (transfer_get_delivery_tag(transfer, &first_frame_delivery_tag) == 0);
+		bool more = false;
+		bool aborted = false;
+
+		(void)transfer_get_more(transfer, &more);
+		(void)transfer_get_aborted(transfer, &aborted);
+
+		if (session_instance->session_state != SESSION_STATE_MAPPED)
+		{
+			result = SESSION_SEND_TRANSFER_ERROR;
+		}
+		else if (!is_first_frame && !link_endpoint_instance->is_sending_delivery)
+		{
+			LogError("Transfer frame without a delivery tag while no delivery is being sent");
+			result = SESSION_SEND_TRANSFER_ERROR;
+		}
+		else if (!aborted &&
+			((session_instance->remote_incoming_window == 0) ||
+			(session_instance->is_scheduling_link_endpoints &&
+				(link_endpoint_instance->deficit <= 0) &&
+				(session_instance->waiting_link_endpoint_count > (link_endpoint_instance->is_waiting_for_window ? 1u : 0u)))))
+		{
+			/* same as session_send_transfer, but checked for every frame; an abort is let through, it carries nothing */
+			set_link_endpoint_waiting(session_instance, link_endpoint_instance, true);
+			AMQP_STATISTICS_INCREMENT(session_instance->statistics.send_transfer_busy_count);
+			result = SESSION_SEND_TRANSFER_BUSY;
+		}
+		else
+		{
+			delivery_number frame_delivery_id = is_first_frame ? session_instance->next_outgoing_id : link_endpoint_instance->sending_delivery_id;
+			AMQP_VALUE transfer_value;
+
+			if ((transfer_set_handle(transfer, link_endpoint_instance->output_handle) != 0) ||
+				(transfer_set_delivery_id(transfer, frame_delivery_id) != 0) ||
+				((transfer_value = amqpvalue_create_transfer(transfer)) == NULL))
+			{
+				result = SESSION_SEND_TRANSFER_ERROR;
+			}
+			else
+			{
+				uint32_t max_frame_size;
+				size_t encoded_size;
+				size_t payload_size = 0;
+				size_t i;
+
+				for (i = 0; i < payload_count; i++)
+				{
+					payload_size += payloads[i].length;
+				}
+
+				if ((connection_get_remote_max_frame_size(session_instance->connection, &max_frame_size) != 0) ||
+					(amqpvalue_get_encoded_size(transfer_value, &encoded_size) != 0) ||
+					(encoded_size + 8 + payload_size > max_frame_size))
+				{
+					LogError("Transfer frame payload of %u bytes does not fit in the frame", (unsigned int)payload_size);
+					result = SESSION_SEND_TRANSFER_ERROR;
+				}
+				else if (connection_encode_frame(session_instance->endpoint, transfer_value, payloads, payload_count, on_send_complete, callback_context) != 0)
+				{
+					result = SESSION_SEND_TRANSFER_ERROR;
+				}
+				else
+				{
+					/* the delivery takes one id, its frames each take a slot of the window */
+					if (is_first_frame)
+					{
+						session_instance->next_outgoing_id++;
+					}
+
+					link_endpoint_instance->is_sending_delivery = more && !aborted;
+					link_endpoint_instance->sending_delivery_id = frame_delivery_id;
+					*delivery_id = frame_delivery_id;
+
+					if (session_instance->remote_incoming_window > 0)
+					{
+						session_instance->remote_incoming_window--;
+					}
+
+					session_instance->outgoing_window--;
+					if (session_instance->is_scheduling_link_endpoints)
+					{
+						link_endpoint_instance->deficit--;
+					}
+
+					AMQP_STATISTICS_INCREMENT(session_instance->statistics.transfer_frames_sent);
+					if (!more)
+					{
+						AMQP_STATISTICS_INCREMENT(session_instance->statistics.transfers_sent);
+					}
+
+					result = SESSION_SEND_TRANSFER_OK;
+				}
+
+				amqpvalue_destroy(transfer_value);
+			}
+		}
+	}
+
+	return result;
+}
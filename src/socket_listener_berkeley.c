@@ -1,9 +1,18 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+/* accept4 */
+#define _GNU_SOURCE
+#endif
+
+#include <stdbool.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -16,7 +25,10 @@
 typedef struct SOCKET_LISTENER_INSTANCE_TAG
 {
 	int port;
+	/* set for a Unix domain socket listener, NULL when listening on a TCP port */
+	char* socket_path;
 	int socket;
+	bool is_reuse_port;
 	ON_SOCKET_ACCEPTED on_socket_accepted;
 	void* callback_context;
 } SOCKET_LISTENER_INSTANCE;
@@ -27,6 +39,9 @@ SOCKET_LISTENER_HANDLE socketlistener_create(int port)
 	if (result != NULL)
 	{
 		result->port = port;
+		result->socket_path = NULL;
+		result->socket = -1;
+		result->is_reuse_port = false;
 		result->on_socket_accepted = NULL;
 		result->callback_context = NULL;
 	}
@@ -34,11 +49,101 @@ SOCKET_LISTENER_HANDLE socketlistener_create(int port)
 	return (SOCKET_LISTENER_HANDLE)result;
 }
 
+SOCKET_LISTENER_HANDLE socketlistener_create_unix(const char* socket_path)
+{
+	SOCKET_LISTENER_INSTANCE* result;
+
+	if (socket_path == NULL)
+	{
+		LogError("NULL socket_path");
+		result = NULL;
+	}
+	else if ((strlen(socket_path) == 0) ||
+		(strlen(socket_path) >= sizeof(((struct sockaddr_un*)0)->sun_path)))
+	{
+		LogError("Invalid socket path length: %u", (unsigned int)strlen(socket_path));
+		result = NULL;
+	}
+	else
+	{
+		result = (SOCKET_LISTENER_INSTANCE*)malloc(sizeof(SOCKET_LISTENER_INSTANCE));
+		if (result == NULL)
+		{
+			LogError("Cannot allocate memory for socket listener");
+		}
+		else
+		{
+			size_t socket_path_length = strlen(socket_path);
+
+			result->socket_path = (char*)malloc(socket_path_length + 1);
+			if (result->socket_path == NULL)
+			{
+				LogError("Cannot allocate memory for socket path");
+				free(result);
+				result = NULL;
+			}
+			else
+			{
+				(void)memcpy(result->socket_path, socket_path, socket_path_length + 1);
+				result->port = 0;
+				result->socket = -1;
+				result->is_reuse_port = false;
+				result->on_socket_accepted = NULL;
+				result->callback_context = NULL;
+			}
+		}
+	}
+
+	return (SOCKET_LISTENER_HANDLE)result;
+}
+
+int socketlistener_set_reuse_port(SOCKET_LISTENER_HANDLE socket_listener, bool reuse_port)
+{
+	int result;
+
+	if (socket_listener == NULL)
+	{
+		LogError("NULL socket_listener");
+		result = __FAILURE__;
+	}
+	else if (socket_listener->socket != -1)
+	{
+		LogError("SO_REUSEPORT must be set before the listener is started");
+		result = __FAILURE__;
+	}
+	else if (reuse_port && (socket_listener->socket_path != NULL))
+	{
+		/* every listener would unlink the socket file of the previous one */
+		LogError("SO_REUSEPORT is not supported for Unix domain socket listeners");
+		result = __FAILURE__;
+	}
+	else
+	{
+#ifdef SO_REUSEPORT
+		socket_listener->is_reuse_port = reuse_port;
+		result = 0;
+#else
+		if (reuse_port)
+		{
+			LogError("SO_REUSEPORT is not supported on this platform");
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+#endif
+	}
+
+	return result;
+}
+
 void socketlistener_destroy(SOCKET_LISTENER_HANDLE socket_listener)
 {
 	if (socket_listener != NULL)
 	{
 		socketlistener_stop(socket_listener);
+		free(socket_listener->socket_path);
 		free(socket_listener);
 	}
 }
@@ -56,7 +161,15 @@ int socketlistener_start(SOCKET_LISTENER_HANDLE socket_listener, ON_SOCKET_ACCEP
 	{
 		SOCKET_LISTENER_INSTANCE* socket_listener_instance = (SOCKET_LISTENER_INSTANCE*)socket_listener;
 
-		socket_listener_instance->socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (socket_listener_instance->socket_path != NULL)
+		{
+			socket_listener_instance->socket = socket(AF_UNIX, SOCK_STREAM, 0);
+		}
+		else
+		{
+			socket_listener_instance->socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		}
+
 		if (socket_listener_instance->socket == -1)
 		{
             LogError("Creating socket failed");
@@ -65,15 +178,37 @@ int socketlistener_start(SOCKET_LISTENER_HANDLE socket_listener, ON_SOCKET_ACCEP
 		else
 		{
             struct sockaddr_in sa;
+            struct sockaddr_un sa_unix;
+            const struct sockaddr* bind_address;
+            socklen_t bind_address_length;
 
 			socket_listener_instance->on_socket_accepted = on_socket_accepted;
 			socket_listener_instance->callback_context = callback_context;
 
-            sa.sin_family = AF_INET;
-            sa.sin_port = htons(socket_listener_instance->port);
-            sa.sin_addr.s_addr = htonl(INADDR_ANY);
+            if (socket_listener_instance->socket_path != NULL)
+            {
+                (void)memset(&sa_unix, 0, sizeof(sa_unix));
+                sa_unix.sun_family = AF_UNIX;
+                (void)strcpy(sa_unix.sun_path, socket_listener_instance->socket_path);
+
+                /* a socket file left behind by a previous run would make bind fail with EADDRINUSE */
+                (void)unlink(socket_listener_instance->socket_path);
+
+                bind_address = (const struct sockaddr*)&sa_unix;
+                bind_address_length = sizeof(sa_unix);
+            }
+            else
+            {
+                sa.sin_family = AF_INET;
+                sa.sin_port = htons(socket_listener_instance->port);
+                sa.sin_addr.s_addr = htonl(INADDR_ANY);
+
+                bind_address = (const struct sockaddr*)&sa;
+                bind_address_length = sizeof(sa);
+            }
 
             int flags;
+            int reuse_port = 1;
             if ((-1 == (flags = fcntl(socket_listener_instance->socket, F_GETFL, 0))) ||
                 (fcntl(socket_listener_instance->socket, F_SETFL, flags | O_NONBLOCK) == -1))
             {
@@ -82,7 +217,17 @@ int socketlistener_start(SOCKET_LISTENER_HANDLE socket_listener, ON_SOCKET_ACCEP
                 socket_listener_instance->socket = -1;
                 result = __FAILURE__;
             }
-            else if (bind(socket_listener_instance->socket, (const struct sockaddr*)&sa, sizeof(sa)) == -1)
+#ifdef SO_REUSEPORT
+            else if (socket_listener_instance->is_reuse_port &&
+                (setsockopt(socket_listener_instance->socket, SOL_SOCKET, SO_REUSEPORT, &reuse_port, sizeof(reuse_port)) == -1))
+            {
+                LogError("Failure: setting SO_REUSEPORT failed.");
+                (void)close(socket_listener_instance->socket);
+                socket_listener_instance->socket = -1;
+                result = __FAILURE__;
+            }
+#endif
+            else if (bind(socket_listener_instance->socket, bind_address, bind_address_length) == -1)
 			{
                 LogError("bind socket failed");
                 (void)close(socket_listener_instance->socket);
@@ -125,8 +270,16 @@ int socketlistener_stop(SOCKET_LISTENER_HANDLE socket_listener)
 		socket_listener_instance->on_socket_accepted = NULL;
 		socket_listener_instance->callback_context = NULL;
 
-		(void)close(socket_listener_instance->socket);
-		socket_listener_instance->socket = -1;
+		if (socket_listener_instance->socket != -1)
+		{
+			(void)close(socket_listener_instance->socket);
+			socket_listener_instance->socket = -1;
+
+			if (socket_listener_instance->socket_path != NULL)
+			{
+				(void)unlink(socket_listener_instance->socket_path);
+			}
+		}
 
 		result = 0;
 	}
@@ -134,27 +287,60 @@ int socketlistener_stop(SOCKET_LISTENER_HANDLE socket_listener)
 	return result;
 }
 
+/* Returns a non-blocking accepted socket, or -1 once the accept queue is empty (or accept failed) */
+static int accept_nonblocking(int listening_socket)
+{
+	int result;
+
+	/* a connection reset while waiting in the queue must not stop the queue from being drained */
+	do
+	{
+#ifdef __linux__
+		result = accept4(listening_socket, NULL, NULL, SOCK_NONBLOCK);
+#else
+		result = accept(listening_socket, NULL, NULL);
+#endif
+	} while ((result == -1) &&
+		((errno == EINTR) || (errno == ECONNABORTED)));
+
+#ifndef __linux__
+	if (result != -1)
+	{
+		int flags;
+		if ((-1 == (flags = fcntl(result, F_GETFL, 0))) ||
+			(fcntl(result, F_SETFL, flags | O_NONBLOCK) == -1))
+		{
+			LogError("Failure: fcntl failure on accepted socket.");
+			(void)close(result);
+			result = -1;
+		}
+	}
+#endif
+
+	return result;
+}
+
 void socketlistener_dowork(SOCKET_LISTENER_HANDLE socket_listener)
 {
 	if (socket_listener != NULL)
 	{
 		SOCKET_LISTENER_INSTANCE* socket_listener_instance = (SOCKET_LISTENER_INSTANCE*)socket_listener;
-		int accepted_socket = accept(socket_listener_instance->socket, NULL, NULL);
-		if (accepted_socket != -1)
+
+		/* drain the whole accept queue, the callback may stop the listener */
+		while (socket_listener_instance->socket != -1)
 		{
-            int flags;
-            if ((-1 == (flags = fcntl(accepted_socket, F_GETFL, 0))) ||
-                (fcntl(accepted_socket, F_SETFL, flags | O_NONBLOCK) == -1))
-            {
-                LogError("Failure: fcntl failure on accepted socket.");
-                close(accepted_socket);
-            }
-            else if (socket_listener_instance->on_socket_accepted != NULL)
+			int accepted_socket = accept_nonblocking(socket_listener_instance->socket);
+			if (accepted_socket == -1)
+			{
+				break;
+			}
+
+			if (socket_listener_instance->on_socket_accepted != NULL)
 			{
 				SOCKETIO_CONFIG socketio_config;
-                socketio_config.hostname = NULL;
-                socketio_config.port = socket_listener_instance->port;
-                socketio_config.accepted_socket = &accepted_socket;
+				socketio_config.hostname = NULL;
+				socketio_config.port = socket_listener_instance->port;
+				socketio_config.accepted_socket = &accepted_socket;
 				socket_listener_instance->on_socket_accepted(socket_listener_instance->callback_context, socketio_get_interface_description(), &socketio_config);
 			}
 			else
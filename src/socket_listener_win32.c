@@ -36,6 +36,37 @@ SOCKET_LISTENER_HANDLE socketlistener_create(int port)
 	return (SOCKET_LISTENER_HANDLE)result;
 }
 
+SOCKET_LISTENER_HANDLE socketlistener_create_unix(const char* socket_path)
+{
+	(void)socket_path;
+
+	LogError("Unix domain socket listeners are not supported on Windows");
+
+	return NULL;
+}
+
+int socketlistener_set_reuse_port(SOCKET_LISTENER_HANDLE socket_listener, bool reuse_port)
+{
+	int result;
+
+	if (socket_listener == NULL)
+	{
+		LogError("NULL socket_listener");
+		result = __FAILURE__;
+	}
+	else if (reuse_port)
+	{
+		LogError("SO_REUSEPORT is not supported on Windows");
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
 void socketlistener_destroy(SOCKET_LISTENER_HANDLE socket_listener)
 {
 	if (socket_listener != NULL)
@@ -143,14 +174,23 @@ void socketlistener_dowork(SOCKET_LISTENER_HANDLE socket_listener)
     }
     else
     {
-		SOCKET accepted_socket = accept(socket_listener->socket, NULL, NULL);
-		if (accepted_socket != INVALID_SOCKET)
+		/* drain the whole accept queue, the callback may stop the listener */
+		while ((socket_listener->socket != INVALID_SOCKET) &&
+			(socket_listener->on_socket_accepted != NULL))
 		{
-			SOCKETIO_CONFIG socketio_config;
-            socketio_config.hostname = NULL;
-            socketio_config.port = socket_listener->port;
-            socketio_config.accepted_socket = &accepted_socket;
-			socket_listener->on_socket_accepted(socket_listener->callback_context, socketio_get_interface_description(), &socketio_config);
+			SOCKET accepted_socket = accept(socket_listener->socket, NULL, NULL);
+			if (accepted_socket == INVALID_SOCKET)
+			{
+				break;
+			}
+			else
+			{
+				SOCKETIO_CONFIG socketio_config;
+				socketio_config.hostname = NULL;
+				socketio_config.port = socket_listener->port;
+				socketio_config.accepted_socket = &accepted_socket;
+				socket_listener->on_socket_accepted(socket_listener->callback_context, socketio_get_interface_description(), &socketio_config);
+			}
 		}
 	}
 }
@@ -0,0 +1,470 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/timer_wheel.h"
+
+/* 6 levels of 64 slots cover 2^36 ms (about 2 years), timers further out are parked in the top level and re-sorted when reached */
+#define WHEEL_BITS 6
+#define WHEEL_SLOT_COUNT (1 << WHEEL_BITS)
+#define WHEEL_SLOT_MASK ((tickcounter_ms_t)(WHEEL_SLOT_COUNT - 1))
+#define WHEEL_LEVEL_COUNT 6
+
+struct TIMER_WHEEL_INSTANCE_TAG;
+
+typedef struct TIMER_WHEEL_TIMER_INSTANCE_TAG
+{
+	struct TIMER_WHEEL_TIMER_INSTANCE_TAG* next;
+	struct TIMER_WHEEL_TIMER_INSTANCE_TAG* previous;
+	struct TIMER_WHEEL_INSTANCE_TAG* timer_wheel;
+	tickcounter_ms_t expiry_ms;
+	ON_TIMER_EXPIRED on_timer_expired;
+	void* context;
+	unsigned int level;
+	unsigned int slot;
+	unsigned int is_scheduled : 1;
+} TIMER_WHEEL_TIMER_INSTANCE;
+
+typedef struct TIMER_WHEEL_INSTANCE_TAG
+{
+	/* every timer expiring before current_ms has fired */
+	tickcounter_ms_t current_ms;
+	/* the time given to the last timer_wheel_advance, which timer_wheel_schedule_after counts from; current_ms runs
+	   one past it once the wheel has been advanced */
+	tickcounter_ms_t advanced_to_ms;
+	uint64_t occupied_slots[WHEEL_LEVEL_COUNT];
+	TIMER_WHEEL_TIMER_INSTANCE* slots[WHEEL_LEVEL_COUNT][WHEEL_SLOT_COUNT];
+} TIMER_WHEEL_INSTANCE;
+
+static int find_occupied_slot(uint64_t occupied_slots, unsigned int first_slot)
+{
+	int result = -1;
+	unsigned int i;
+
+	for (i = first_slot; i < WHEEL_SLOT_COUNT; i++)
+	{
+		if ((occupied_slots & ((uint64_t)1 << i)) != 0)
+		{
+			result = (int)i;
+			break;
+		}
+	}
+
+	return result;
+}
+
+static void link_timer(TIMER_WHEEL_INSTANCE* timer_wheel, TIMER_WHEEL_TIMER_INSTANCE* timer)
+{
+	/* a timer that is already due goes in the current slot and fires on the next advance */
+	tickcounter_ms_t expiry_ms = (timer->expiry_ms < timer_wheel->current_ms) ? timer_wheel->current_ms : timer->expiry_ms;
+	tickcounter_ms_t differing_bits = expiry_ms ^ timer_wheel->current_ms;
+	unsigned int level = 0;
+
+	/* the level is picked by the highest bits in which the expiry differs from the current time,
+	   so every timer in a level expires before any timer of the next level */
+	while ((level < WHEEL_LEVEL_COUNT - 1) &&
+		((differing_bits >> (WHEEL_BITS * (level + 1))) != 0))
+	{
+		level++;
+	}
+
+	timer->level = level;
+	timer->slot = (unsigned int)((expiry_ms >> (WHEEL_BITS * level)) & WHEEL_SLOT_MASK);
+	timer->previous = NULL;
+	timer->next = timer_wheel->slots[level][timer->slot];
+	if (timer->next != NULL)
+	{
+		timer->next->previous = timer;
+	}
+
+	timer_wheel->slots[level][timer->slot] = timer;
+	timer_wheel->occupied_slots[level] |= ((uint64_t)1 << timer->slot);
+}
+
+static void unlink_timer(TIMER_WHEEL_INSTANCE* timer_wheel, TIMER_WHEEL_TIMER_INSTANCE* timer)
+{
+	if (timer->previous == NULL)
+	{
+		timer_wheel->slots[timer->level][timer->slot] = timer->next;
+		if (timer->next == NULL)
+		{
+			timer_wheel->occupied_slots[timer->level] &= ~((uint64_t)1 << timer->slot);
+		}
+	}
+	else
+	{
+		timer->previous->next = timer->next;
+	}
+
+	if (timer->next != NULL)
+	{
+		timer->next->previous = timer->previous;
+	}
+
+	timer->next = NULL;
+	timer->previous = NULL;
+}
+
+static void cascade_timers(TIMER_WHEEL_INSTANCE* timer_wheel)
+{
+	unsigned int level;
+
+	/* on a level 0 boundary the matching slot of each higher level is spread over the lower levels */
+	for (level = 1; level < WHEEL_LEVEL_COUNT; level++)
+	{
+		unsigned int slot = (unsigned int)((timer_wheel->current_ms >> (WHEEL_BITS * level)) & WHEEL_SLOT_MASK);
+		TIMER_WHEEL_TIMER_INSTANCE* timer = timer_wheel->slots[level][slot];
+
+		timer_wheel->slots[level][slot] = NULL;
+		timer_wheel->occupied_slots[level] &= ~((uint64_t)1 << slot);
+
+		while (timer != NULL)
+		{
+			TIMER_WHEEL_TIMER_INSTANCE* next_timer = timer->next;
+			link_timer(timer_wheel, timer);
+			timer = next_timer;
+		}
+
+		if (slot != 0)
+		{
+			break;
+		}
+	}
+}
+
+static void expire_slot(TIMER_WHEEL_INSTANCE* timer_wheel, unsigned int slot, tickcounter_ms_t slot_time)
+{
+	TIMER_WHEEL_TIMER_INSTANCE* timer;
+
+	/* moving past the slot first makes timers scheduled from the callbacks land in later slots */
+	timer_wheel->current_ms = slot_time + 1;
+
+	while ((timer = timer_wheel->slots[0][slot]) != NULL)
+	{
+		unlink_timer(timer_wheel, timer);
+
+		if (timer->expiry_ms > slot_time)
+		{
+			/* parked beyond the wheel range, put it where it belongs now */
+			link_timer(timer_wheel, timer);
+		}
+		else
+		{
+			timer->is_scheduled = 0;
+			timer->on_timer_expired(timer->context);
+		}
+	}
+}
+
+TIMER_WHEEL_HANDLE timer_wheel_create(tickcounter_ms_t current_ms)
+{
+	TIMER_WHEEL_INSTANCE* result = (TIMER_WHEEL_INSTANCE*)malloc(sizeof(TIMER_WHEEL_INSTANCE));
+	if (result == NULL)
+	{
+		LogError("Cannot allocate memory for the timer wheel");
+	}
+	else
+	{
+		unsigned int level;
+		unsigned int slot;
+
+		result->current_ms = current_ms;
+		result->advanced_to_ms = current_ms;
+		for (level = 0; level < WHEEL_LEVEL_COUNT; level++)
+		{
+			result->occupied_slots[level] = 0;
+			for (slot = 0; slot < WHEEL_SLOT_COUNT; slot++)
+			{
+				result->slots[level][slot] = NULL;
+			}
+		}
+	}
+
+	return result;
+}
+
+void timer_wheel_destroy(TIMER_WHEEL_HANDLE timer_wheel)
+{
+	if (timer_wheel == NULL)
+	{
+		LogError("NULL timer_wheel");
+	}
+	else
+	{
+		unsigned int level;
+		unsigned int slot;
+
+		/* timers are owned by their creators, they only get detached here */
+		for (level = 0; level < WHEEL_LEVEL_COUNT; level++)
+		{
+			for (slot = 0; slot < WHEEL_SLOT_COUNT; slot++)
+			{
+				TIMER_WHEEL_TIMER_INSTANCE* timer = timer_wheel->slots[level][slot];
+				while (timer != NULL)
+				{
+					TIMER_WHEEL_TIMER_INSTANCE* next_timer = timer->next;
+					timer->is_scheduled = 0;
+					timer->timer_wheel = NULL;
+					timer->next = NULL;
+					timer->previous = NULL;
+					timer = next_timer;
+				}
+			}
+		}
+
+		free(timer_wheel);
+	}
+}
+
+TIMER_WHEEL_TIMER_HANDLE timer_wheel_create_timer(TIMER_WHEEL_HANDLE timer_wheel, ON_TIMER_EXPIRED on_timer_expired, void* context)
+{
+	TIMER_WHEEL_TIMER_INSTANCE* result;
+
+	if ((timer_wheel == NULL) ||
+		(on_timer_expired == NULL))
+	{
+		LogError("Bad arguments: timer_wheel = %p, on_timer_expired = %p",
+			timer_wheel, on_timer_expired);
+		result = NULL;
+	}
+	else
+	{
+		result = (TIMER_WHEEL_TIMER_INSTANCE*)malloc(sizeof(TIMER_WHEEL_TIMER_INSTANCE));
+		if (result == NULL)
+		{
+			LogError("Cannot allocate memory for the timer");
+		}
+		else
+		{
+			result->next = NULL;
+			result->previous = NULL;
+			result->timer_wheel = timer_wheel;
+			result->expiry_ms = 0;
+			result->on_timer_expired = on_timer_expired;
+			result->context = context;
+			result->level = 0;
+			result->slot = 0;
+			result->is_scheduled = 0;
+		}
+	}
+
+	return result;
+}
+
+void timer_wheel_destroy_timer(TIMER_WHEEL_TIMER_HANDLE timer)
+{
+	if (timer == NULL)
+	{
+		LogError("NULL timer");
+	}
+	else
+	{
+		timer_wheel_cancel(timer);
+		free(timer);
+	}
+}
+
+int timer_wheel_schedule(TIMER_WHEEL_TIMER_HANDLE timer, tickcounter_ms_t expiry_ms)
+{
+	int result;
+
+	if ((timer == NULL) ||
+		(timer->timer_wheel == NULL))
+	{
+		LogError("Bad arguments: timer = %p", timer);
+		result = __FAILURE__;
+	}
+	else
+	{
+		if (timer->is_scheduled)
+		{
+			unlink_timer(timer->timer_wheel, timer);
+		}
+
+		timer->expiry_ms = expiry_ms;
+		link_timer(timer->timer_wheel, timer);
+		timer->is_scheduled = 1;
+
+		result = 0;
+	}
+
+	return result;
+}
+
+int timer_wheel_schedule_after(TIMER_WHEEL_TIMER_HANDLE timer, tickcounter_ms_t delay_ms)
+{
+	int result;
+
+	if ((timer == NULL) ||
+		(timer->timer_wheel == NULL))
+	{
+		LogError("Bad arguments: timer = %p", timer);
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = timer_wheel_schedule(timer, timer->timer_wheel->advanced_to_ms + delay_ms);
+	}
+
+	return result;
+}
+
+void timer_wheel_cancel(TIMER_WHEEL_TIMER_HANDLE timer)
+{
+	if (timer == NULL)
+	{
+		LogError("NULL timer");
+	}
+	else if (timer->is_scheduled)
+	{
+		unlink_timer(timer->timer_wheel, timer);
+		timer->is_scheduled = 0;
+	}
+}
+
+uint64_t timer_wheel_get_time_to_next_expiry(TIMER_WHEEL_HANDLE timer_wheel, tickcounter_ms_t current_ms)
+{
+	uint64_t result = (uint64_t)-1;
+
+	if (timer_wheel == NULL)
+	{
+		LogError("NULL timer_wheel");
+	}
+	else
+	{
+		unsigned int level;
+
+		for (level = 0; (level < WHEEL_LEVEL_COUNT) && (result == (uint64_t)-1); level++)
+		{
+			unsigned int current_slot = (unsigned int)((timer_wheel->current_ms >> (WHEEL_BITS * level)) & WHEEL_SLOT_MASK);
+			int slot;
+			int last_slot;
+
+			if (level == WHEEL_LEVEL_COUNT - 1)
+			{
+				/* parked timers can sit anywhere in the top level */
+				slot = find_occupied_slot(timer_wheel->occupied_slots[level], 0);
+				last_slot = WHEEL_SLOT_COUNT - 1;
+			}
+			else
+			{
+				slot = find_occupied_slot(timer_wheel->occupied_slots[level], current_slot);
+				last_slot = slot;
+			}
+
+			if (slot >= 0)
+			{
+				tickcounter_ms_t expiry_ms;
+
+				if (level == 0)
+				{
+					expiry_ms = (timer_wheel->current_ms & ~WHEEL_SLOT_MASK) | (tickcounter_ms_t)slot;
+				}
+				else
+				{
+					TIMER_WHEEL_TIMER_INSTANCE* timer;
+
+					expiry_ms = timer_wheel->slots[level][slot]->expiry_ms;
+					for (; slot <= last_slot; slot++)
+					{
+						for (timer = timer_wheel->slots[level][slot]; timer != NULL; timer = timer->next)
+						{
+							if (timer->expiry_ms < expiry_ms)
+							{
+								expiry_ms = timer->expiry_ms;
+							}
+						}
+					}
+				}
+
+				result = (expiry_ms <= current_ms) ? 0 : (uint64_t)(expiry_ms - current_ms);
+			}
+		}
+	}
+
+	return result;
+}
+
+int timer_wheel_advance(TIMER_WHEEL_HANDLE timer_wheel, tickcounter_ms_t current_ms)
+{
+	int result;
+
+	if (timer_wheel == NULL)
+	{
+		LogError("NULL timer_wheel");
+		result = __FAILURE__;
+	}
+	else
+	{
+		/* set first so that timers rescheduled from the callbacks count from the time being advanced to */
+		if (current_ms > timer_wheel->advanced_to_ms)
+		{
+			timer_wheel->advanced_to_ms = current_ms;
+		}
+
+		while (timer_wheel->current_ms <= current_ms)
+		{
+			unsigned int current_slot = (unsigned int)(timer_wheel->current_ms & WHEEL_SLOT_MASK);
+			int slot;
+
+			/* skip straight to the next occupied slot, or to the next level 0 boundary */
+			slot = find_occupied_slot(timer_wheel->occupied_slots[0], current_slot);
+			if (slot < 0)
+			{
+				/* with the lower levels empty nothing can happen before the next boundary of the first occupied level */
+				unsigned int empty_level_count = 1;
+				tickcounter_ms_t next_boundary;
+
+				while ((empty_level_count < WHEEL_LEVEL_COUNT) &&
+					(timer_wheel->occupied_slots[empty_level_count] == 0))
+				{
+					empty_level_count++;
+				}
+
+				if (empty_level_count == WHEEL_LEVEL_COUNT)
+				{
+					next_boundary = current_ms + 1;
+				}
+				else
+				{
+					next_boundary = (timer_wheel->current_ms | (((tickcounter_ms_t)1 << (WHEEL_BITS * empty_level_count)) - 1)) + 1;
+				}
+
+				if (next_boundary > current_ms)
+				{
+					timer_wheel->current_ms = current_ms + 1;
+				}
+				else
+				{
+					timer_wheel->current_ms = next_boundary;
+				}
+			}
+			else
+			{
+				tickcounter_ms_t slot_time = (timer_wheel->current_ms & ~WHEEL_SLOT_MASK) | (tickcounter_ms_t)slot;
+				if (slot_time > current_ms)
+				{
+					timer_wheel->current_ms = current_ms + 1;
+				}
+				else
+				{
+					expire_slot(timer_wheel, (unsigned int)slot, slot_time);
+				}
+			}
+
+			/* cascading as soon as a boundary is reached keeps the next expiry lookup exact */
+			if ((timer_wheel->current_ms & WHEEL_SLOT_MASK) == 0)
+			{
+				cascade_timers(timer_wheel);
+			}
+		}
+
+		result = 0;
+	}
+
+	return result;
+}
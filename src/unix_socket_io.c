@@ -0,0 +1,346 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_uamqp_c/unix_socket_io.h"
+
+typedef struct UNIX_SOCKET_IO_INSTANCE_TAG
+{
+	char* socket_path;
+	XIO_HANDLE underlying_io;
+	bool is_open;
+} UNIX_SOCKET_IO_INSTANCE;
+
+static int connect_unix_socket(const char* socket_path)
+{
+	int result = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (result == -1)
+	{
+		LogError("Creating socket failed");
+	}
+	else
+	{
+		struct sockaddr_un sa;
+		int flags;
+
+		(void)memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		(void)strcpy(sa.sun_path, socket_path);
+
+		/* a local connect completes (or fails) immediately, so it is done blocking and the socket is switched to
+		   non-blocking afterwards, the way socket IO expects an accepted socket */
+		if (connect(result, (const struct sockaddr*)&sa, sizeof(sa)) == -1)
+		{
+			LogError("Cannot connect to %s", socket_path);
+			(void)close(result);
+			result = -1;
+		}
+		else if ((-1 == (flags = fcntl(result, F_GETFL, 0))) ||
+			(fcntl(result, F_SETFL, flags | O_NONBLOCK) == -1))
+		{
+			LogError("Failure: fcntl failure.");
+			(void)close(result);
+			result = -1;
+		}
+	}
+
+	return result;
+}
+
+CONCRETE_IO_HANDLE unixsocketio_create(void* io_create_parameters)
+{
+	UNIX_SOCKET_IO_INSTANCE* result;
+	UNIXSOCKETIO_CONFIG* unix_socket_io_config = (UNIXSOCKETIO_CONFIG*)io_create_parameters;
+
+	if ((unix_socket_io_config == NULL) ||
+		(unix_socket_io_config->socket_path == NULL))
+	{
+		LogError("NULL unix socket IO config or socket path");
+		result = NULL;
+	}
+	else if ((strlen(unix_socket_io_config->socket_path) == 0) ||
+		(strlen(unix_socket_io_config->socket_path) >= sizeof(((struct sockaddr_un*)0)->sun_path)))
+	{
+		LogError("Invalid socket path length: %u", (unsigned int)strlen(unix_socket_io_config->socket_path));
+		result = NULL;
+	}
+	else
+	{
+		result = (UNIX_SOCKET_IO_INSTANCE*)malloc(sizeof(UNIX_SOCKET_IO_INSTANCE));
+		if (result == NULL)
+		{
+			LogError("Cannot allocate memory for unix socket IO");
+		}
+		else
+		{
+			size_t socket_path_length = strlen(unix_socket_io_config->socket_path);
+
+			result->socket_path = (char*)malloc(socket_path_length + 1);
+			if (result->socket_path == NULL)
+			{
+				LogError("Cannot allocate memory for socket path");
+				free(result);
+				result = NULL;
+			}
+			else
+			{
+				(void)memcpy(result->socket_path, unix_socket_io_config->socket_path, socket_path_length + 1);
+				result->underlying_io = NULL;
+				result->is_open = false;
+			}
+		}
+	}
+
+	return result;
+}
+
+void unixsocketio_destroy(CONCRETE_IO_HANDLE unix_socket_io)
+{
+	if (unix_socket_io != NULL)
+	{
+		UNIX_SOCKET_IO_INSTANCE* unix_socket_io_instance = (UNIX_SOCKET_IO_INSTANCE*)unix_socket_io;
+
+		/* socket IO closes the socket when destroyed */
+		if (unix_socket_io_instance->underlying_io != NULL)
+		{
+			xio_destroy(unix_socket_io_instance->underlying_io);
+		}
+
+		free(unix_socket_io_instance->socket_path);
+		free(unix_socket_io_instance);
+	}
+}
+
+int unixsocketio_open(CONCRETE_IO_HANDLE unix_socket_io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+	int result;
+
+	if (unix_socket_io == NULL)
+	{
+		LogError("NULL unix_socket_io");
+		result = __FAILURE__;
+	}
+	else
+	{
+		UNIX_SOCKET_IO_INSTANCE* unix_socket_io_instance = (UNIX_SOCKET_IO_INSTANCE*)unix_socket_io;
+
+		if (unix_socket_io_instance->is_open)
+		{
+			LogError("Unix socket IO already open");
+			result = __FAILURE__;
+		}
+		else
+		{
+			int connected_socket;
+
+			/* the socket of a previous open has been closed, it cannot be reused */
+			if (unix_socket_io_instance->underlying_io != NULL)
+			{
+				xio_destroy(unix_socket_io_instance->underlying_io);
+				unix_socket_io_instance->underlying_io = NULL;
+			}
+
+			connected_socket = connect_unix_socket(unix_socket_io_instance->socket_path);
+			if (connected_socket == -1)
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				SOCKETIO_CONFIG socketio_config;
+				socketio_config.hostname = NULL;
+				socketio_config.port = 0;
+				socketio_config.accepted_socket = &connected_socket;
+
+				unix_socket_io_instance->underlying_io = xio_create(socketio_get_interface_description(), &socketio_config);
+				if (unix_socket_io_instance->underlying_io == NULL)
+				{
+					LogError("Cannot create socket IO");
+					(void)close(connected_socket);
+					result = __FAILURE__;
+				}
+				else
+				{
+					/* socket IO completes the open of an already connected socket from inside xio_open, and the
+					   open complete callback is allowed to send */
+					unix_socket_io_instance->is_open = true;
+
+					if (xio_open(unix_socket_io_instance->underlying_io, on_io_open_complete, on_io_open_complete_context, on_bytes_received, on_bytes_received_context, on_io_error, on_io_error_context) != 0)
+					{
+						LogError("Cannot open socket IO");
+						unix_socket_io_instance->is_open = false;
+						xio_destroy(unix_socket_io_instance->underlying_io);
+						unix_socket_io_instance->underlying_io = NULL;
+						result = __FAILURE__;
+					}
+					else
+					{
+						result = 0;
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+int unixsocketio_close(CONCRETE_IO_HANDLE unix_socket_io, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+	int result;
+
+	if (unix_socket_io == NULL)
+	{
+		LogError("NULL unix_socket_io");
+		result = __FAILURE__;
+	}
+	else
+	{
+		UNIX_SOCKET_IO_INSTANCE* unix_socket_io_instance = (UNIX_SOCKET_IO_INSTANCE*)unix_socket_io;
+
+		if (!unix_socket_io_instance->is_open)
+		{
+			LogError("Unix socket IO not open");
+			result = __FAILURE__;
+		}
+		else
+		{
+			unix_socket_io_instance->is_open = false;
+
+			if (xio_close(unix_socket_io_instance->underlying_io, on_io_close_complete, callback_context) != 0)
+			{
+				LogError("Cannot close socket IO");
+				result = __FAILURE__;
+			}
+			else
+			{
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+int unixsocketio_send(CONCRETE_IO_HANDLE unix_socket_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	int result;
+
+	if (unix_socket_io == NULL)
+	{
+		LogError("NULL unix_socket_io");
+		result = __FAILURE__;
+	}
+	else
+	{
+		UNIX_SOCKET_IO_INSTANCE* unix_socket_io_instance = (UNIX_SOCKET_IO_INSTANCE*)unix_socket_io;
+
+		if (!unix_socket_io_instance->is_open)
+		{
+			LogError("Unix socket IO not open");
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = xio_send(unix_socket_io_instance->underlying_io, buffer, size, on_send_complete, callback_context);
+		}
+	}
+
+	return result;
+}
+
+void unixsocketio_dowork(CONCRETE_IO_HANDLE unix_socket_io)
+{
+	if (unix_socket_io != NULL)
+	{
+		UNIX_SOCKET_IO_INSTANCE* unix_socket_io_instance = (UNIX_SOCKET_IO_INSTANCE*)unix_socket_io;
+
+		if (unix_socket_io_instance->is_open)
+		{
+			xio_dowork(unix_socket_io_instance->underlying_io);
+		}
+	}
+}
+
+int unixsocketio_setoption(CONCRETE_IO_HANDLE unix_socket_io, const char* optionName, const void* value)
+{
+	int result;
+
+	if (unix_socket_io == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		UNIX_SOCKET_IO_INSTANCE* unix_socket_io_instance = (UNIX_SOCKET_IO_INSTANCE*)unix_socket_io;
+
+		/* the socket IO only exists while open, and none of its TCP options apply to a Unix domain socket anyway */
+		if (unix_socket_io_instance->underlying_io == NULL)
+		{
+			LogError("Option %s cannot be set before the unix socket IO is opened", optionName);
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = xio_setoption(unix_socket_io_instance->underlying_io, optionName, value);
+		}
+	}
+
+	return result;
+}
+
+/*this function will clone an option given by name and value*/
+static void* unixsocketio_CloneOption(const char* name, const void* value)
+{
+	(void)name;
+	(void)value;
+	return NULL;
+}
+
+/*this function destroys an option previously created*/
+static void unixsocketio_DestroyOption(const char* name, const void* value)
+{
+	(void)name;
+	(void)value;
+}
+
+static OPTIONHANDLER_HANDLE unixsocketio_retrieveoptions(CONCRETE_IO_HANDLE handle)
+{
+	OPTIONHANDLER_HANDLE result;
+	(void)handle;
+	result = OptionHandler_Create(unixsocketio_CloneOption, unixsocketio_DestroyOption, unixsocketio_setoption);
+	if (result == NULL)
+	{
+		LogError("unable to OptionHandler_Create");
+	}
+
+	return result;
+}
+
+static const IO_INTERFACE_DESCRIPTION unix_socket_io_interface_description =
+{
+	unixsocketio_retrieveoptions,
+	unixsocketio_create,
+	unixsocketio_destroy,
+	unixsocketio_open,
+	unixsocketio_close,
+	unixsocketio_send,
+	unixsocketio_dowork,
+	unixsocketio_setoption
+};
+
+const IO_INTERFACE_DESCRIPTION* unixsocketio_get_interface_description(void)
+{
+	return &unix_socket_io_interface_description;
+}
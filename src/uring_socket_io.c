@@ -0,0 +1,1364 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/uring_socket_io.h"
+
+/* used for IOs created without a context */
+#define PRIVATE_QUEUE_DEPTH 8
+#define PRIVATE_RECEIVE_BUFFER_SIZE 65536
+/* the user_data of cancel submissions, their completions are not dispatched */
+#define CANCEL_USER_DATA 0
+/* how long free_context blocks at a time waiting for the operations of destroyed IOs to come back */
+#define CANCEL_WAIT_MS 100
+
+struct URING_SOCKET_IO_INSTANCE_TAG;
+struct URING_SOCKET_IO_CONTEXT_INSTANCE_TAG;
+
+typedef enum URING_OPERATION_TYPE_TAG
+{
+	URING_OPERATION_RECEIVE,
+	URING_OPERATION_SEND
+} URING_OPERATION_TYPE;
+
+/* the user_data of every submission points to one of these, embedded in the IO */
+typedef struct URING_OPERATION_TAG
+{
+	URING_OPERATION_TYPE type;
+	struct URING_SOCKET_IO_INSTANCE_TAG* uring_socket_io;
+	bool is_in_flight;
+} URING_OPERATION;
+
+typedef struct SEND_CALLBACK_TAG
+{
+	ON_SEND_COMPLETE on_send_complete;
+	void* context;
+} SEND_CALLBACK;
+
+/* Bytes given to send, with the callbacks to call once they are all sent.
+   One batch is in flight while the other one collects new sends, so the in flight bytes never move. */
+typedef struct SEND_BATCH_TAG
+{
+	unsigned char* bytes;
+	size_t size;
+	size_t capacity;
+	size_t sent;
+	SEND_CALLBACK* callbacks;
+	size_t callback_count;
+	size_t callback_capacity;
+	/* callbacks already called, so that closing from inside a callback does not call the others twice */
+	size_t completed_callback_count;
+} SEND_BATCH;
+
+typedef enum IO_STATE_TAG
+{
+	IO_STATE_NOT_OPEN,
+	IO_STATE_OPEN,
+	IO_STATE_ERROR
+} IO_STATE;
+
+typedef struct URING_SOCKET_IO_INSTANCE_TAG
+{
+	struct URING_SOCKET_IO_CONTEXT_INSTANCE_TAG* context;
+	bool is_context_owned;
+	char* hostname;
+	int port;
+	int socket;
+	IO_STATE io_state;
+	bool is_destroyed;
+	ON_BYTES_RECEIVED on_bytes_received;
+	void* on_bytes_received_context;
+	ON_IO_ERROR on_io_error;
+	void* on_io_error_context;
+	URING_OPERATION receive_operation;
+	URING_OPERATION send_operation;
+	/* index of the registered buffer receive_bytes points into, -1 for a buffer of this IO */
+	int receive_buffer_index;
+	unsigned char* receive_bytes;
+	SEND_BATCH send_batches[2];
+	size_t collecting_batch_index;
+	/* destroyed while operations were in flight, freed when the last one completes */
+	struct URING_SOCKET_IO_INSTANCE_TAG* next_zombie;
+} URING_SOCKET_IO_INSTANCE;
+
+typedef struct URING_SOCKET_IO_CONTEXT_INSTANCE_TAG
+{
+	int ring_fd;
+	bool has_ext_arg;
+	void* sq_ring;
+	size_t sq_ring_size;
+	void* cq_ring;
+	size_t cq_ring_size;
+	struct io_uring_sqe* sqes;
+	size_t sqes_size;
+	unsigned int* sq_head;
+	unsigned int* sq_tail;
+	unsigned int sq_mask;
+	unsigned int sq_entries;
+	unsigned int* sq_array;
+	unsigned int* cq_head;
+	unsigned int* cq_tail;
+	unsigned int cq_mask;
+	struct io_uring_cqe* cqes;
+	/* queued since the last io_uring_enter */
+	unsigned int to_submit;
+	unsigned char* receive_buffers;
+	uint32_t receive_buffer_count;
+	uint32_t receive_buffer_size;
+	bool are_receive_buffers_registered;
+	int* free_receive_buffers;
+	uint32_t free_receive_buffer_count;
+	URING_SOCKET_IO_INSTANCE* first_zombie;
+	/* a destroy from inside a completion callback is carried out once the dispatch loop is done */
+	bool is_dispatching;
+	bool is_destroy_pending;
+} URING_SOCKET_IO_CONTEXT_INSTANCE;
+
+static int uring_setup(unsigned int entries, struct io_uring_params* params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags, const void* arg, size_t arg_size)
+{
+	return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int uring_register(int ring_fd, unsigned int opcode, const void* arg, unsigned int arg_count)
+{
+	return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, arg_count);
+}
+
+static void unmap_rings(URING_SOCKET_IO_CONTEXT_INSTANCE* context)
+{
+	if (context->sqes != NULL)
+	{
+		(void)munmap(context->sqes, context->sqes_size);
+	}
+
+	if ((context->cq_ring != NULL) &&
+		(context->cq_ring != context->sq_ring))
+	{
+		(void)munmap(context->cq_ring, context->cq_ring_size);
+	}
+
+	if (context->sq_ring != NULL)
+	{
+		(void)munmap(context->sq_ring, context->sq_ring_size);
+	}
+}
+
+static int map_rings(URING_SOCKET_IO_CONTEXT_INSTANCE* context, const struct io_uring_params* params)
+{
+	int result;
+
+	context->sq_ring_size = params->sq_off.array + (params->sq_entries * sizeof(unsigned int));
+	context->cq_ring_size = params->cq_off.cqes + (params->cq_entries * sizeof(struct io_uring_cqe));
+	context->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+
+	/* with IORING_FEAT_SINGLE_MMAP both rings live in one mapping */
+	if ((params->features & IORING_FEAT_SINGLE_MMAP) != 0)
+	{
+		if (context->cq_ring_size > context->sq_ring_size)
+		{
+			context->sq_ring_size = context->cq_ring_size;
+		}
+		context->cq_ring_size = context->sq_ring_size;
+	}
+
+	context->sq_ring = mmap(NULL, context->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, context->ring_fd, IORING_OFF_SQ_RING);
+	if (context->sq_ring == MAP_FAILED)
+	{
+		LogError("Cannot map the submission ring");
+		context->sq_ring = NULL;
+		result = __FAILURE__;
+	}
+	else
+	{
+		if ((params->features & IORING_FEAT_SINGLE_MMAP) != 0)
+		{
+			context->cq_ring = context->sq_ring;
+		}
+		else
+		{
+			context->cq_ring = mmap(NULL, context->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, context->ring_fd, IORING_OFF_CQ_RING);
+			if (context->cq_ring == MAP_FAILED)
+			{
+				context->cq_ring = NULL;
+			}
+		}
+
+		if (context->cq_ring == NULL)
+		{
+			LogError("Cannot map the completion ring");
+			result = __FAILURE__;
+		}
+		else
+		{
+			context->sqes = (struct io_uring_sqe*)mmap(NULL, context->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, context->ring_fd, IORING_OFF_SQES);
+			if (context->sqes == MAP_FAILED)
+			{
+				LogError("Cannot map the submission queue entries");
+				context->sqes = NULL;
+				result = __FAILURE__;
+			}
+			else
+			{
+				unsigned char* sq_ring = (unsigned char*)context->sq_ring;
+				unsigned char* cq_ring = (unsigned char*)context->cq_ring;
+
+				context->sq_head = (unsigned int*)(sq_ring + params->sq_off.head);
+				context->sq_tail = (unsigned int*)(sq_ring + params->sq_off.tail);
+				context->sq_mask = *(unsigned int*)(sq_ring + params->sq_off.ring_mask);
+				context->sq_entries = *(unsigned int*)(sq_ring + params->sq_off.ring_entries);
+				context->sq_array = (unsigned int*)(sq_ring + params->sq_off.array);
+				context->cq_head = (unsigned int*)(cq_ring + params->cq_off.head);
+				context->cq_tail = (unsigned int*)(cq_ring + params->cq_off.tail);
+				context->cq_mask = *(unsigned int*)(cq_ring + params->cq_off.ring_mask);
+				context->cqes = (struct io_uring_cqe*)(cq_ring + params->cq_off.cqes);
+
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+static void register_receive_buffers(URING_SOCKET_IO_CONTEXT_INSTANCE* context)
+{
+	struct iovec* iovecs = (struct iovec*)malloc(sizeof(struct iovec) * context->receive_buffer_count);
+	if (iovecs == NULL)
+	{
+		LogError("Cannot allocate memory for the receive buffer iovecs");
+	}
+	else
+	{
+		uint32_t i;
+
+		for (i = 0; i < context->receive_buffer_count; i++)
+		{
+			iovecs[i].iov_base = context->receive_buffers + ((size_t)i * context->receive_buffer_size);
+			iovecs[i].iov_len = context->receive_buffer_size;
+		}
+
+		/* registration is charged to RLIMIT_MEMLOCK; without it the same buffers are used with plain recv */
+		if (uring_register(context->ring_fd, IORING_REGISTER_BUFFERS, iovecs, context->receive_buffer_count) != 0)
+		{
+			LogError("Cannot register receive buffers (errno %d), receiving without registered buffers", errno);
+		}
+		else
+		{
+			context->are_receive_buffers_registered = true;
+		}
+
+		free(iovecs);
+	}
+}
+
+static int submit_pending(URING_SOCKET_IO_CONTEXT_INSTANCE* context, unsigned int min_complete, uint32_t max_wait_ms)
+{
+	int result;
+	int enter_result;
+
+	if ((min_complete > 0) && context->has_ext_arg)
+	{
+		struct __kernel_timespec timeout;
+		struct io_uring_getevents_arg getevents_arg;
+
+		timeout.tv_sec = max_wait_ms / 1000;
+		timeout.tv_nsec = (long long)(max_wait_ms % 1000) * 1000000;
+		(void)memset(&getevents_arg, 0, sizeof(getevents_arg));
+		getevents_arg.ts = (uint64_t)(uintptr_t)&timeout;
+
+		enter_result = uring_enter(context->ring_fd, context->to_submit, min_complete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &getevents_arg, sizeof(getevents_arg));
+	}
+	else
+	{
+		enter_result = uring_enter(context->ring_fd, context->to_submit, 0, 0, NULL, 0);
+	}
+
+	if (enter_result >= 0)
+	{
+		context->to_submit -= (unsigned int)enter_result;
+		result = 0;
+	}
+	else if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY) || (errno == ETIME))
+	{
+		/* nothing lost, the entries are submitted by the next call */
+		result = 0;
+	}
+	else
+	{
+		LogError("io_uring_enter failed, errno %d", errno);
+		result = __FAILURE__;
+	}
+
+	return result;
+}
+
+static struct io_uring_sqe* get_sqe(URING_SOCKET_IO_CONTEXT_INSTANCE* context)
+{
+	struct io_uring_sqe* result;
+	unsigned int tail = *context->sq_tail;
+
+	if ((tail - __atomic_load_n(context->sq_head, __ATOMIC_ACQUIRE)) >= context->sq_entries)
+	{
+		/* ring full: submit what is queued now rather than waiting for the next dowork */
+		(void)submit_pending(context, 0, 0);
+	}
+
+	if ((tail - __atomic_load_n(context->sq_head, __ATOMIC_ACQUIRE)) >= context->sq_entries)
+	{
+		LogError("io_uring submission queue full");
+		result = NULL;
+	}
+	else
+	{
+		unsigned int index = tail & context->sq_mask;
+
+		result = &context->sqes[index];
+		(void)memset(result, 0, sizeof(struct io_uring_sqe));
+		context->sq_array[index] = index;
+	}
+
+	return result;
+}
+
+static void commit_sqe(URING_SOCKET_IO_CONTEXT_INSTANCE* context)
+{
+	__atomic_store_n(context->sq_tail, *context->sq_tail + 1, __ATOMIC_RELEASE);
+	context->to_submit++;
+}
+
+static int submit_receive(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance)
+{
+	int result;
+	URING_SOCKET_IO_CONTEXT_INSTANCE* context = uring_socket_io_instance->context;
+	struct io_uring_sqe* sqe = get_sqe(context);
+
+	if (sqe == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		sqe->fd = uring_socket_io_instance->socket;
+		sqe->addr = (uint64_t)(uintptr_t)uring_socket_io_instance->receive_bytes;
+		sqe->len = context->receive_buffer_size;
+		sqe->user_data = (uint64_t)(uintptr_t)&uring_socket_io_instance->receive_operation;
+
+		if ((uring_socket_io_instance->receive_buffer_index >= 0) &&
+			context->are_receive_buffers_registered)
+		{
+			sqe->opcode = IORING_OP_READ_FIXED;
+			sqe->buf_index = (uint16_t)uring_socket_io_instance->receive_buffer_index;
+		}
+		else
+		{
+			sqe->opcode = IORING_OP_RECV;
+		}
+
+		commit_sqe(context);
+		uring_socket_io_instance->receive_operation.is_in_flight = true;
+		result = 0;
+	}
+
+	return result;
+}
+
+static int submit_send(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance, SEND_BATCH* send_batch)
+{
+	int result;
+	struct io_uring_sqe* sqe = get_sqe(uring_socket_io_instance->context);
+
+	if (sqe == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = uring_socket_io_instance->socket;
+		sqe->addr = (uint64_t)(uintptr_t)(send_batch->bytes + send_batch->sent);
+		sqe->len = (uint32_t)(send_batch->size - send_batch->sent);
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->user_data = (uint64_t)(uintptr_t)&uring_socket_io_instance->send_operation;
+
+		commit_sqe(uring_socket_io_instance->context);
+		uring_socket_io_instance->send_operation.is_in_flight = true;
+		result = 0;
+	}
+
+	return result;
+}
+
+/* asks the kernel to complete operation right away, with -ECANCELED unless it was about to complete anyway */
+static int submit_cancel(URING_SOCKET_IO_CONTEXT_INSTANCE* context, URING_OPERATION* operation)
+{
+	int result;
+	struct io_uring_sqe* sqe = get_sqe(context);
+
+	if (sqe == NULL)
+	{
+		result = __FAILURE__;
+	}
+	else
+	{
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = (uint64_t)(uintptr_t)operation;
+		sqe->user_data = CANCEL_USER_DATA;
+
+		commit_sqe(context);
+		result = 0;
+	}
+
+	return result;
+}
+
+static SEND_BATCH* get_in_flight_batch(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance)
+{
+	return &uring_socket_io_instance->send_batches[1 - uring_socket_io_instance->collecting_batch_index];
+}
+
+static void complete_send_batch(SEND_BATCH* send_batch, IO_SEND_RESULT send_result)
+{
+	while (send_batch->completed_callback_count < send_batch->callback_count)
+	{
+		SEND_CALLBACK* send_callback = &send_batch->callbacks[send_batch->completed_callback_count++];
+		if (send_callback->on_send_complete != NULL)
+		{
+			send_callback->on_send_complete(send_callback->context, send_result);
+		}
+	}
+}
+
+static void reset_send_batch(SEND_BATCH* send_batch)
+{
+	send_batch->size = 0;
+	send_batch->sent = 0;
+	send_batch->callback_count = 0;
+	send_batch->completed_callback_count = 0;
+}
+
+/* the collecting batch goes in flight and the (empty) in flight batch starts collecting */
+static int start_send(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance)
+{
+	int result;
+	SEND_BATCH* send_batch = &uring_socket_io_instance->send_batches[uring_socket_io_instance->collecting_batch_index];
+
+	uring_socket_io_instance->collecting_batch_index = 1 - uring_socket_io_instance->collecting_batch_index;
+
+	if (submit_send(uring_socket_io_instance, send_batch) != 0)
+	{
+		LogError("Cannot submit send");
+		result = __FAILURE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	return result;
+}
+
+static void indicate_error(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance)
+{
+	uring_socket_io_instance->io_state = IO_STATE_ERROR;
+	if (uring_socket_io_instance->on_io_error != NULL)
+	{
+		uring_socket_io_instance->on_io_error(uring_socket_io_instance->on_io_error_context);
+	}
+}
+
+static void release_receive_buffer(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance)
+{
+	if (uring_socket_io_instance->receive_buffer_index >= 0)
+	{
+		URING_SOCKET_IO_CONTEXT_INSTANCE* context = uring_socket_io_instance->context;
+		context->free_receive_buffers[context->free_receive_buffer_count++] = uring_socket_io_instance->receive_buffer_index;
+	}
+	else
+	{
+		free(uring_socket_io_instance->receive_bytes);
+	}
+
+	uring_socket_io_instance->receive_buffer_index = -1;
+	uring_socket_io_instance->receive_bytes = NULL;
+}
+
+static int acquire_receive_buffer(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance)
+{
+	int result;
+	URING_SOCKET_IO_CONTEXT_INSTANCE* context = uring_socket_io_instance->context;
+
+	if (context->free_receive_buffer_count > 0)
+	{
+		uring_socket_io_instance->receive_buffer_index = context->free_receive_buffers[--context->free_receive_buffer_count];
+		uring_socket_io_instance->receive_bytes = context->receive_buffers + ((size_t)uring_socket_io_instance->receive_buffer_index * context->receive_buffer_size);
+		result = 0;
+	}
+	else
+	{
+		uring_socket_io_instance->receive_buffer_index = -1;
+		uring_socket_io_instance->receive_bytes = (unsigned char*)malloc(context->receive_buffer_size);
+		if (uring_socket_io_instance->receive_bytes == NULL)
+		{
+			LogError("Cannot allocate receive buffer");
+			result = __FAILURE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static void free_instance(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance)
+{
+	size_t i;
+
+	if (uring_socket_io_instance->receive_bytes != NULL)
+	{
+		release_receive_buffer(uring_socket_io_instance);
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		free(uring_socket_io_instance->send_batches[i].bytes);
+		free(uring_socket_io_instance->send_batches[i].callbacks);
+	}
+
+	free(uring_socket_io_instance->hostname);
+	free(uring_socket_io_instance);
+}
+
+/* frees a destroyed IO once none of its operations is in flight anymore */
+static void release_if_destroyed(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance)
+{
+	if ((uring_socket_io_instance->is_destroyed) &&
+		(!uring_socket_io_instance->receive_operation.is_in_flight) &&
+		(!uring_socket_io_instance->send_operation.is_in_flight))
+	{
+		URING_SOCKET_IO_INSTANCE** zombie = &uring_socket_io_instance->context->first_zombie;
+
+		while (*zombie != NULL)
+		{
+			if (*zombie == uring_socket_io_instance)
+			{
+				*zombie = uring_socket_io_instance->next_zombie;
+				break;
+			}
+
+			zombie = &(*zombie)->next_zombie;
+		}
+
+		free_instance(uring_socket_io_instance);
+	}
+}
+
+static void on_receive_complete(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance, int completion_result)
+{
+	/* the operation stays marked in flight during the callback so that a destroy from inside it does not free the IO */
+	if ((!uring_socket_io_instance->is_destroyed) &&
+		(uring_socket_io_instance->io_state == IO_STATE_OPEN) &&
+		(completion_result > 0))
+	{
+		uring_socket_io_instance->on_bytes_received(uring_socket_io_instance->on_bytes_received_context, uring_socket_io_instance->receive_bytes, (size_t)completion_result);
+	}
+
+	uring_socket_io_instance->receive_operation.is_in_flight = false;
+
+	if (uring_socket_io_instance->is_destroyed)
+	{
+		release_if_destroyed(uring_socket_io_instance);
+	}
+	else if (uring_socket_io_instance->io_state != IO_STATE_OPEN)
+	{
+		/* closed while the receive was in flight, the buffer could only be given back now */
+		if ((uring_socket_io_instance->io_state == IO_STATE_NOT_OPEN) &&
+			(uring_socket_io_instance->receive_bytes != NULL))
+		{
+			release_receive_buffer(uring_socket_io_instance);
+		}
+	}
+	else if ((completion_result > 0) ||
+		(completion_result == -EAGAIN) ||
+		(completion_result == -EINTR))
+	{
+		if (submit_receive(uring_socket_io_instance) != 0)
+		{
+			indicate_error(uring_socket_io_instance);
+		}
+	}
+	else
+	{
+		if (completion_result < 0)
+		{
+			LogError("Receive failed, error %d", -completion_result);
+		}
+
+		/* 0 is the peer closing the connection */
+		indicate_error(uring_socket_io_instance);
+	}
+}
+
+static void on_send_complete(URING_SOCKET_IO_INSTANCE* uring_socket_io_instance, int completion_result)
+{
+	SEND_BATCH* send_batch = get_in_flight_batch(uring_socket_io_instance);
+
+	if ((uring_socket_io_instance->is_destroyed) ||
+		(uring_socket_io_instance->io_state != IO_STATE_OPEN))
+	{
+		/* the callbacks were cancelled by close */
+		reset_send_batch(send_batch);
+		uring_socket_io_instance->send_operation.is_in_flight = false;
+		release_if_destroyed(uring_socket_io_instance);
+	}
+	else if ((completion_result > 0) &&
+		(send_batch->sent + (size_t)completion_result < send_batch->size))
+	{
+		send_batch->sent += (size_t)completion_result;
+		if (submit_send(uring_socket_io_instance, send_batch) != 0)
+		{
+			uring_socket_io_instance->send_operation.is_in_flight = false;
+			complete_send_batch(send_batch, IO_SEND_ERROR);
+			reset_send_batch(send_batch);
+			indicate_error(uring_socket_io_instance);
+		}
+	}
+	else if ((completion_result == -EAGAIN) ||
+		(completion_result == -EINTR))
+	{
+		if (submit_send(uring_socket_io_instance, send_batch) != 0)
+		{
+			uring_socket_io_instance->send_operation.is_in_flight = false;
+			complete_send_batch(send_batch, IO_SEND_ERROR);
+			reset_send_batch(send_batch);
+			indicate_error(uring_socket_io_instance);
+		}
+	}
+	else
+	{
+		bool is_sent = (completion_result > 0);
+
+		if (!is_sent)
+		{
+			LogError("Send failed, error %d", -completion_result);
+		}
+
+		complete_send_batch(send_batch, is_sent ? IO_SEND_OK : IO_SEND_ERROR);
+		reset_send_batch(send_batch);
+		uring_socket_io_instance->send_operation.is_in_flight = false;
+
+		if (uring_socket_io_instance->is_destroyed)
+		{
+			release_if_destroyed(uring_socket_io_instance);
+		}
+		else if (!is_sent)
+		{
+			indicate_error(uring_socket_io_instance);
+		}
+		else if ((uring_socket_io_instance->io_state == IO_STATE_OPEN) &&
+			(uring_socket_io_instance->send_batches[uring_socket_io_instance->collecting_batch_index].size > 0) &&
+			(start_send(uring_socket_io_instance) != 0))
+		{
+			indicate_error(uring_socket_io_instance);
+		}
+	}
+}
+
+static void process_completions(URING_SOCKET_IO_CONTEXT_INSTANCE* context)
+{
+	unsigned int head = *context->cq_head;
+
+	context->is_dispatching = true;
+
+	while (head != __atomic_load_n(context->cq_tail, __ATOMIC_ACQUIRE))
+	{
+		struct io_uring_cqe* cqe = &context->cqes[head & context->cq_mask];
+		URING_OPERATION* operation = (URING_OPERATION*)(uintptr_t)cqe->user_data;
+		int completion_result = cqe->res;
+
+		/* the entry is copied out, hand it back before calling anything that may submit */
+		head++;
+		__atomic_store_n(context->cq_head, head, __ATOMIC_RELEASE);
+
+		if (cqe->user_data == CANCEL_USER_DATA)
+		{
+			/* the cancelled operation has a completion of its own */
+		}
+		else if (operation->type == URING_OPERATION_RECEIVE)
+		{
+			on_receive_complete(operation->uring_socket_io, completion_result);
+		}
+		else
+		{
+			on_send_complete(operation->uring_socket_io, completion_result);
+		}
+	}
+
+	context->is_dispatching = false;
+}
+
+URING_SOCKET_IO_CONTEXT_HANDLE uringsocketio_context_create(uint32_t queue_depth, uint32_t receive_buffer_count, uint32_t receive_buffer_size)
+{
+	URING_SOCKET_IO_CONTEXT_INSTANCE* result;
+
+	if ((queue_depth == 0) ||
+		(receive_buffer_size == 0))
+	{
+		LogError("Invalid arguments: queue_depth = %u, receive_buffer_size = %u", (unsigned int)queue_depth, (unsigned int)receive_buffer_size);
+		result = NULL;
+	}
+	else
+	{
+		result = (URING_SOCKET_IO_CONTEXT_INSTANCE*)malloc(sizeof(URING_SOCKET_IO_CONTEXT_INSTANCE));
+		if (result == NULL)
+		{
+			LogError("Cannot allocate memory for io_uring context");
+		}
+		else
+		{
+			struct io_uring_params params;
+
+			(void)memset(result, 0, sizeof(URING_SOCKET_IO_CONTEXT_INSTANCE));
+			result->receive_buffer_count = receive_buffer_count;
+			result->receive_buffer_size = receive_buffer_size;
+
+			(void)memset(&params, 0, sizeof(params));
+			result->ring_fd = uring_setup(queue_depth, &params);
+			if (result->ring_fd < 0)
+			{
+				LogError("io_uring_setup failed, errno %d", errno);
+				free(result);
+				result = NULL;
+			}
+			else if (map_rings(result, &params) != 0)
+			{
+				unmap_rings(result);
+				(void)close(result->ring_fd);
+				free(result);
+				result = NULL;
+			}
+			else
+			{
+				result->has_ext_arg = ((params.features & IORING_FEAT_EXT_ARG) != 0);
+
+				if (receive_buffer_count > 0)
+				{
+					result->receive_buffers = (unsigned char*)malloc((size_t)receive_buffer_count * receive_buffer_size);
+					result->free_receive_buffers = (int*)malloc(sizeof(int) * receive_buffer_count);
+				}
+
+				if ((receive_buffer_count > 0) &&
+					((result->receive_buffers == NULL) || (result->free_receive_buffers == NULL)))
+				{
+					LogError("Cannot allocate receive buffers");
+					free(result->receive_buffers);
+					free(result->free_receive_buffers);
+					unmap_rings(result);
+					(void)close(result->ring_fd);
+					free(result);
+					result = NULL;
+				}
+				else
+				{
+					uint32_t i;
+
+					/* handed out from the end, so buffer 0 goes first */
+					for (i = 0; i < receive_buffer_count; i++)
+					{
+						result->free_receive_buffers[i] = (int)(receive_buffer_count - 1 - i);
+					}
+					result->free_receive_buffer_count = receive_buffer_count;
+
+					if (receive_buffer_count > 0)
+					{
+						register_receive_buffers(result);
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static void free_context(URING_SOCKET_IO_CONTEXT_INSTANCE* context)
+{
+	URING_SOCKET_IO_INSTANCE* zombie;
+	bool is_ring_usable = true;
+
+	/* Until its completion is reaped the kernel may still write into the receive buffer of an operation or read
+	   its send batch, so neither can be freed, nor the ring closed, before then. Shutting down a socket completes
+	   its operations, but not those of a descriptor that is not a socket, hence the cancels. */
+	for (zombie = context->first_zombie; zombie != NULL; zombie = zombie->next_zombie)
+	{
+		if (((zombie->receive_operation.is_in_flight) && (submit_cancel(context, &zombie->receive_operation) != 0)) ||
+			((zombie->send_operation.is_in_flight) && (submit_cancel(context, &zombie->send_operation) != 0)))
+		{
+			LogError("Cannot submit cancel, waiting for the operation to complete");
+		}
+	}
+
+	while ((context->first_zombie != NULL) &&
+		is_ring_usable)
+	{
+		if (submit_pending(context, 1, CANCEL_WAIT_MS) != 0)
+		{
+			is_ring_usable = false;
+		}
+		else
+		{
+			process_completions(context);
+		}
+	}
+
+	if (context->first_zombie != NULL)
+	{
+		/* freeing anything the kernel may still be using is worse than the leak */
+		LogError("Cannot reap the operations of destroyed IOs, leaking the io_uring context");
+	}
+	else
+	{
+		if (context->are_receive_buffers_registered)
+		{
+			(void)uring_register(context->ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+		}
+
+		unmap_rings(context);
+		(void)close(context->ring_fd);
+		free(context->receive_buffers);
+		free(context->free_receive_buffers);
+		free(context);
+	}
+}
+
+void uringsocketio_context_destroy(URING_SOCKET_IO_CONTEXT_HANDLE context)
+{
+	if (context != NULL)
+	{
+		if (context->is_dispatching)
+		{
+			context->is_destroy_pending = true;
+		}
+		else
+		{
+			free_context(context);
+		}
+	}
+}
+
+int uringsocketio_context_dowork(URING_SOCKET_IO_CONTEXT_HANDLE context, uint32_t max_wait_ms)
+{
+	int result;
+
+	if (context == NULL)
+	{
+		LogError("NULL context");
+		result = __FAILURE__;
+	}
+	else
+	{
+		bool has_completions = (*context->cq_head != __atomic_load_n(context->cq_tail, __ATOMIC_ACQUIRE));
+		unsigned int min_complete = ((max_wait_ms > 0) && (!has_completions)) ? 1 : 0;
+
+		/* the one syscall of the turn, for every IO of the context; skipped when there is nothing to do */
+		if (((context->to_submit > 0) || (min_complete > 0)) &&
+			(submit_pending(context, min_complete, max_wait_ms) != 0))
+		{
+			result = __FAILURE__;
+		}
+		else
+		{
+			process_completions(context);
+
+			if (context->is_destroy_pending)
+			{
+				free_context(context);
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+CONCRETE_IO_HANDLE uringsocketio_create(void* io_create_parameters)
+{
+	URING_SOCKET_IO_INSTANCE* result;
+	URINGSOCKETIO_CONFIG* uring_socket_io_config = (URINGSOCKETIO_CONFIG*)io_create_parameters;
+
+	if ((uring_socket_io_config == NULL) ||
+		((uring_socket_io_config->hostname == NULL) && (uring_socket_io_config->accepted_socket == NULL)))
+	{
+		LogError("Invalid io_uring socket IO config");
+		result = NULL;
+	}
+	else
+	{
+		result = (URING_SOCKET_IO_INSTANCE*)malloc(sizeof(URING_SOCKET_IO_INSTANCE));
+		if (result == NULL)
+		{
+			LogError("Cannot allocate memory for io_uring socket IO");
+		}
+		else
+		{
+			(void)memset(result, 0, sizeof(URING_SOCKET_IO_INSTANCE));
+			result->socket = -1;
+			result->receive_buffer_index = -1;
+			result->io_state = IO_STATE_NOT_OPEN;
+			result->receive_operation.type = URING_OPERATION_RECEIVE;
+			result->receive_operation.uring_socket_io = result;
+			result->send_operation.type = URING_OPERATION_SEND;
+			result->send_operation.uring_socket_io = result;
+
+			if (uring_socket_io_config->context != NULL)
+			{
+				result->context = uring_socket_io_config->context;
+			}
+			else
+			{
+				result->context = uringsocketio_context_create(PRIVATE_QUEUE_DEPTH, 1, PRIVATE_RECEIVE_BUFFER_SIZE);
+				result->is_context_owned = true;
+			}
+
+			if (result->context == NULL)
+			{
+				LogError("Cannot create io_uring context");
+				free(result);
+				result = NULL;
+			}
+			else if (uring_socket_io_config->accepted_socket != NULL)
+			{
+				result->socket = *(int*)uring_socket_io_config->accepted_socket;
+			}
+			else
+			{
+				size_t hostname_length = strlen(uring_socket_io_config->hostname);
+
+				result->port = uring_socket_io_config->port;
+				result->hostname = (char*)malloc(hostname_length + 1);
+				if (result->hostname == NULL)
+				{
+					LogError("Cannot allocate memory for hostname");
+					if (result->is_context_owned)
+					{
+						uringsocketio_context_destroy(result->context);
+					}
+					free(result);
+					result = NULL;
+				}
+				else
+				{
+					(void)memcpy(result->hostname, uring_socket_io_config->hostname, hostname_length + 1);
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static int connect_socket(const char* hostname, int port)
+{
+	int result;
+	struct addrinfo address_info_hints;
+	struct addrinfo* address_info;
+	char port_string[16];
+
+	(void)memset(&address_info_hints, 0, sizeof(address_info_hints));
+	address_info_hints.ai_family = AF_INET;
+	address_info_hints.ai_socktype = SOCK_STREAM;
+	(void)sprintf(port_string, "%d", port);
+
+	if (getaddrinfo(hostname, port_string, &address_info_hints, &address_info) != 0)
+	{
+		LogError("Cannot resolve %s", hostname);
+		result = -1;
+	}
+	else
+	{
+		result = socket(address_info->ai_family, address_info->ai_socktype, address_info->ai_protocol);
+		if (result == -1)
+		{
+			LogError("Creating socket failed");
+		}
+		else if (connect(result, address_info->ai_addr, address_info->ai_addrlen) != 0)
+		{
+			LogError("Cannot connect to %s:%d", hostname, port);
+			(void)close(result);
+			result = -1;
+		}
+
+		freeaddrinfo(address_info);
+	}
+
+	return result;
+}
+
+int uringsocketio_open(CONCRETE_IO_HANDLE uring_socket_io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+	int result;
+
+	if ((uring_socket_io == NULL) ||
+		(on_bytes_received == NULL))
+	{
+		LogError("Bad arguments: uring_socket_io = %p, on_bytes_received = %p", uring_socket_io, on_bytes_received);
+		result = __FAILURE__;
+	}
+	else
+	{
+		URING_SOCKET_IO_INSTANCE* uring_socket_io_instance = (URING_SOCKET_IO_INSTANCE*)uring_socket_io;
+
+		if (uring_socket_io_instance->io_state != IO_STATE_NOT_OPEN)
+		{
+			LogError("io_uring socket IO already open");
+			result = __FAILURE__;
+		}
+		else if ((uring_socket_io_instance->receive_operation.is_in_flight) ||
+			(uring_socket_io_instance->send_operation.is_in_flight))
+		{
+			LogError("Operations of the previous open are still completing");
+			result = __FAILURE__;
+		}
+		else
+		{
+			int flags;
+
+			if ((uring_socket_io_instance->socket == -1) &&
+				(uring_socket_io_instance->hostname != NULL))
+			{
+				uring_socket_io_instance->socket = connect_socket(uring_socket_io_instance->hostname, uring_socket_io_instance->port);
+			}
+
+			if (uring_socket_io_instance->socket == -1)
+			{
+				LogError("No socket to open");
+				result = __FAILURE__;
+			}
+			/* io_uring polls for readiness itself; on an O_NONBLOCK socket the fixed buffer read would complete with -EAGAIN */
+			else if ((-1 == (flags = fcntl(uring_socket_io_instance->socket, F_GETFL, 0))) ||
+				(fcntl(uring_socket_io_instance->socket, F_SETFL, flags & ~O_NONBLOCK) == -1))
+			{
+				LogError("Failure: fcntl failure.");
+				result = __FAILURE__;
+			}
+			else if ((uring_socket_io_instance->receive_bytes == NULL) &&
+				(acquire_receive_buffer(uring_socket_io_instance) != 0))
+			{
+				result = __FAILURE__;
+			}
+			else
+			{
+				uring_socket_io_instance->on_bytes_received = on_bytes_received;
+				uring_socket_io_instance->on_bytes_received_context = on_bytes_received_context;
+				uring_socket_io_instance->on_io_error = on_io_error;
+				uring_socket_io_instance->on_io_error_context = on_io_error_context;
+
+				if (submit_receive(uring_socket_io_instance) != 0)
+				{
+					LogError("Cannot submit the first receive");
+					result = __FAILURE__;
+				}
+				else
+				{
+					/* open before the callback, which is allowed to send */
+					uring_socket_io_instance->io_state = IO_STATE_OPEN;
+
+					if (on_io_open_complete != NULL)
+					{
+						on_io_open_complete(on_io_open_complete_context, IO_OPEN_OK);
+					}
+
+					result = 0;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+int uringsocketio_close(CONCRETE_IO_HANDLE uring_socket_io, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+	int result;
+
+	if (uring_socket_io == NULL)
+	{
+		LogError("NULL uring_socket_io");
+		result = __FAILURE__;
+	}
+	else
+	{
+		URING_SOCKET_IO_INSTANCE* uring_socket_io_instance = (URING_SOCKET_IO_INSTANCE*)uring_socket_io;
+
+		if (uring_socket_io_instance->io_state == IO_STATE_NOT_OPEN)
+		{
+			LogError("io_uring socket IO not open");
+			result = __FAILURE__;
+		}
+		else
+		{
+			SEND_BATCH* collecting_batch = &uring_socket_io_instance->send_batches[uring_socket_io_instance->collecting_batch_index];
+
+			uring_socket_io_instance->io_state = IO_STATE_NOT_OPEN;
+
+			/* makes the receive (and a send) in flight complete; the ring holds its own reference to the socket, so
+			   closing it right away is safe */
+			(void)shutdown(uring_socket_io_instance->socket, SHUT_RDWR);
+			(void)close(uring_socket_io_instance->socket);
+			uring_socket_io_instance->socket = -1;
+
+			if (!uring_socket_io_instance->receive_operation.is_in_flight)
+			{
+				release_receive_buffer(uring_socket_io_instance);
+			}
+
+			/* the in flight bytes stay put until their completion comes back, only the callbacks are done now */
+			complete_send_batch(get_in_flight_batch(uring_socket_io_instance), IO_SEND_CANCELLED);
+			complete_send_batch(collecting_batch, IO_SEND_CANCELLED);
+			reset_send_batch(collecting_batch);
+
+			if (on_io_close_complete != NULL)
+			{
+				on_io_close_complete(callback_context);
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+void uringsocketio_destroy(CONCRETE_IO_HANDLE uring_socket_io)
+{
+	if (uring_socket_io != NULL)
+	{
+		URING_SOCKET_IO_INSTANCE* uring_socket_io_instance = (URING_SOCKET_IO_INSTANCE*)uring_socket_io;
+		URING_SOCKET_IO_CONTEXT_INSTANCE* context = uring_socket_io_instance->context;
+		bool is_context_owned = uring_socket_io_instance->is_context_owned;
+
+		if (uring_socket_io_instance->io_state != IO_STATE_NOT_OPEN)
+		{
+			(void)uringsocketio_close(uring_socket_io, NULL, NULL);
+		}
+		else if (uring_socket_io_instance->socket != -1)
+		{
+			/* accepted but never opened */
+			(void)close(uring_socket_io_instance->socket);
+		}
+
+		uring_socket_io_instance->is_destroyed = true;
+		uring_socket_io_instance->on_bytes_received = NULL;
+		uring_socket_io_instance->on_io_error = NULL;
+
+		if ((uring_socket_io_instance->receive_operation.is_in_flight) ||
+			(uring_socket_io_instance->send_operation.is_in_flight))
+		{
+			uring_socket_io_instance->next_zombie = context->first_zombie;
+			context->first_zombie = uring_socket_io_instance;
+		}
+		else
+		{
+			free_instance(uring_socket_io_instance);
+		}
+
+		if (is_context_owned)
+		{
+			uringsocketio_context_destroy(context);
+		}
+	}
+}
+
+int uringsocketio_send(CONCRETE_IO_HANDLE uring_socket_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	int result;
+
+	if ((uring_socket_io == NULL) ||
+		(buffer == NULL) ||
+		(size == 0))
+	{
+		LogError("Bad arguments: uring_socket_io = %p, buffer = %p, size = %u", uring_socket_io, buffer, (unsigned int)size);
+		result = __FAILURE__;
+	}
+	else
+	{
+		URING_SOCKET_IO_INSTANCE* uring_socket_io_instance = (URING_SOCKET_IO_INSTANCE*)uring_socket_io;
+
+		if (uring_socket_io_instance->io_state != IO_STATE_OPEN)
+		{
+			LogError("io_uring socket IO not open");
+			result = __FAILURE__;
+		}
+		else
+		{
+			SEND_BATCH* send_batch = &uring_socket_io_instance->send_batches[uring_socket_io_instance->collecting_batch_index];
+
+			if (send_batch->size + size > send_batch->capacity)
+			{
+				size_t new_capacity = (send_batch->capacity == 0) ? 4096 : send_batch->capacity;
+				unsigned char* new_bytes;
+
+				while (new_capacity < send_batch->size + size)
+				{
+					new_capacity *= 2;
+				}
+
+				new_bytes = (unsigned char*)realloc(send_batch->bytes, new_capacity);
+				if (new_bytes != NULL)
+				{
+					send_batch->bytes = new_bytes;
+					send_batch->capacity = new_capacity;
+				}
+			}
+
+			if (send_batch->callback_count == send_batch->callback_capacity)
+			{
+				size_t new_callback_capacity = (send_batch->callback_capacity == 0) ? 16 : send_batch->callback_capacity * 2;
+				SEND_CALLBACK* new_callbacks = (SEND_CALLBACK*)realloc(send_batch->callbacks, sizeof(SEND_CALLBACK) * new_callback_capacity);
+				if (new_callbacks != NULL)
+				{
+					send_batch->callbacks = new_callbacks;
+					send_batch->callback_capacity = new_callback_capacity;
+				}
+			}
+
+			if ((send_batch->size + size > send_batch->capacity) ||
+				(send_batch->callback_count == send_batch->callback_capacity))
+			{
+				LogError("Cannot allocate memory for send");
+				result = __FAILURE__;
+			}
+			else
+			{
+				(void)memcpy(send_batch->bytes + send_batch->size, buffer, size);
+				send_batch->size += size;
+				send_batch->callbacks[send_batch->callback_count].on_send_complete = on_send_complete;
+				send_batch->callbacks[send_batch->callback_count].context = callback_context;
+				send_batch->callback_count++;
+
+				/* while a send is in flight the bytes wait in the collecting batch and go out together once it completes */
+				if ((!uring_socket_io_instance->send_operation.is_in_flight) &&
+					(start_send(uring_socket_io_instance) != 0))
+				{
+					/* the bytes are in the in flight batch now, taken back so that the caller sees nothing sent */
+					SEND_BATCH* failed_batch = get_in_flight_batch(uring_socket_io_instance);
+					failed_batch->size -= size;
+					failed_batch->callback_count--;
+					uring_socket_io_instance->collecting_batch_index = 1 - uring_socket_io_instance->collecting_batch_index;
+					result = __FAILURE__;
+				}
+				else
+				{
+					result = 0;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+void uringsocketio_dowork(CONCRETE_IO_HANDLE uring_socket_io)
+{
+	if (uring_socket_io != NULL)
+	{
+		URING_SOCKET_IO_INSTANCE* uring_socket_io_instance = (URING_SOCKET_IO_INSTANCE*)uring_socket_io;
+
+		/* a shared context is driven by its owner through uringsocketio_context_dowork */
+		if (uring_socket_io_instance->is_context_owned)
+		{
+			(void)uringsocketio_context_dowork(uring_socket_io_instance->context, 0);
+		}
+	}
+}
+
+int uringsocketio_setoption(CONCRETE_IO_HANDLE uring_socket_io, const char* optionName, const void* value)
+{
+	int result;
+
+	(void)value;
+
+	if ((uring_socket_io == NULL) ||
+		(optionName == NULL))
+	{
+		LogError("Bad arguments: uring_socket_io = %p, optionName = %p", uring_socket_io, optionName);
+		result = __FAILURE__;
+	}
+	else
+	{
+		LogError("Unknown option: %s", optionName);
+		result = __FAILURE__;
+	}
+
+	return result;
+}
+
+/*this function will clone an option given by name and value*/
+static void* uringsocketio_CloneOption(const char* name, const void* value)
+{
+	(void)name;
+	(void)value;
+	return NULL;
+}
+
+/*this function destroys an option previously created*/
+static void uringsocketio_DestroyOption(const char* name, const void* value)
+{
+	(void)name;
+	(void)value;
+}
+
+static OPTIONHANDLER_HANDLE uringsocketio_retrieveoptions(CONCRETE_IO_HANDLE handle)
+{
+	OPTIONHANDLER_HANDLE result;
+	(void)handle;
+	result = OptionHandler_Create(uringsocketio_CloneOption, uringsocketio_DestroyOption, uringsocketio_setoption);
+	if (result == NULL)
+	{
+		LogError("unable to OptionHandler_Create");
+	}
+
+	return result;
+}
+
+static const IO_INTERFACE_DESCRIPTION uring_socket_io_interface_description =
+{
+	uringsocketio_retrieveoptions,
+	uringsocketio_create,
+	uringsocketio_destroy,
+	uringsocketio_open,
+	uringsocketio_close,
+	uringsocketio_send,
+	uringsocketio_dowork,
+	uringsocketio_setoption
+};
+
+const IO_INTERFACE_DESCRIPTION* uringsocketio_get_interface_description(void)
+{
+	return &uring_socket_io_interface_description;
+}
@@ -0,0 +1,262 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_uamqp_c/mpsc_queue.h"
+#include "azure_uamqp_c/worker_pool.h"
+
+/* the reactor wait is also bounded by the connection deadlines, this only caps it */
+#define WORKER_MAX_WAIT_MS 1000
+
+typedef struct WORK_ITEM_TAG
+{
+	MPSC_QUEUE_ITEM queue_item;
+	ON_WORKER_POOL_WORK on_work;
+	void* context;
+} WORK_ITEM;
+
+typedef struct WORKER_TAG
+{
+	CONNECTION_REACTOR_HANDLE reactor;
+	THREAD_HANDLE thread;
+	MPSC_QUEUE work_queue;
+
+	/* set by the first producer after the worker last looked at the queue, so that only one wake is sent */
+	int is_wake_pending;
+	int is_stopping;
+	unsigned int is_thread_started : 1;
+} WORKER;
+
+typedef struct WORKER_POOL_INSTANCE_TAG
+{
+	WORKER** workers;
+	size_t worker_count;
+} WORKER_POOL_INSTANCE;
+
+static void run_posted_work(WORKER* worker)
+{
+	WORK_ITEM* work_item;
+
+	while ((work_item = (WORK_ITEM*)mpsc_queue_pop(&worker->work_queue)) != NULL)
+	{
+		work_item->on_work(work_item->context, worker->reactor);
+		free(work_item);
+	}
+}
+
+static int worker_thread(void* arg)
+{
+	WORKER* worker = (WORKER*)arg;
+	int is_stopping;
+
+	do
+	{
+		/* the stop flag is read before draining so that work posted before worker_pool_destroy still runs */
+		is_stopping = __atomic_load_n(&worker->is_stopping, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&worker->is_wake_pending, 0, __ATOMIC_SEQ_CST);
+		run_posted_work(worker);
+
+		if ((!is_stopping) &&
+			(connection_reactor_dowork(worker->reactor, WORKER_MAX_WAIT_MS) != 0))
+		{
+			LogError("connection_reactor_dowork failed");
+		}
+	} while (!is_stopping);
+
+	return 0;
+}
+
+static void destroy_workers(WORKER_POOL_INSTANCE* worker_pool)
+{
+	size_t i;
+
+	for (i = 0; i < worker_pool->worker_count; i++)
+	{
+		if (worker_pool->workers[i]->is_thread_started)
+		{
+			__atomic_store_n(&worker_pool->workers[i]->is_stopping, 1, __ATOMIC_RELEASE);
+			(void)connection_reactor_wake(worker_pool->workers[i]->reactor);
+		}
+	}
+
+	for (i = 0; i < worker_pool->worker_count; i++)
+	{
+		WORKER* worker = worker_pool->workers[i];
+		WORK_ITEM* work_item;
+
+		if (worker->is_thread_started)
+		{
+			int thread_result;
+
+			if (ThreadAPI_Join(worker->thread, &thread_result) != THREADAPI_OK)
+			{
+				LogError("Cannot join worker thread %u", (unsigned int)i);
+			}
+		}
+
+		/* only work posted from a worker to another one that already stopped can be left */
+		while ((work_item = (WORK_ITEM*)mpsc_queue_pop(&worker->work_queue)) != NULL)
+		{
+			LogError("Dropping work posted to stopped worker %u", (unsigned int)i);
+			free(work_item);
+		}
+
+		connection_reactor_destroy(worker->reactor);
+		free(worker);
+	}
+
+	free(worker_pool->workers);
+}
+
+WORKER_POOL_HANDLE worker_pool_create(size_t worker_count)
+{
+	WORKER_POOL_INSTANCE* result;
+
+	if (worker_count == 0)
+	{
+		LogError("Zero worker_count");
+		result = NULL;
+	}
+	else
+	{
+		result = (WORKER_POOL_INSTANCE*)malloc(sizeof(WORKER_POOL_INSTANCE));
+		if (result == NULL)
+		{
+			LogError("Cannot allocate memory for the worker pool");
+		}
+		else
+		{
+			result->workers = (WORKER**)malloc(sizeof(WORKER*) * worker_count);
+			if (result->workers == NULL)
+			{
+				LogError("Cannot allocate memory for the workers");
+				free(result);
+				result = NULL;
+			}
+			else
+			{
+				size_t i;
+
+				/* workers are allocated one by one to keep the queues of different threads apart */
+				result->worker_count = 0;
+				for (i = 0; i < worker_count; i++)
+				{
+					WORKER* worker = (WORKER*)malloc(sizeof(WORKER));
+					if (worker == NULL)
+					{
+						LogError("Cannot allocate memory for worker %u", (unsigned int)i);
+						break;
+					}
+
+					worker->reactor = connection_reactor_create();
+					if (worker->reactor == NULL)
+					{
+						LogError("Cannot create the reactor for worker %u", (unsigned int)i);
+						free(worker);
+						break;
+					}
+
+					mpsc_queue_init(&worker->work_queue);
+					worker->is_wake_pending = 0;
+					worker->is_stopping = 0;
+					worker->is_thread_started = 0;
+					result->workers[result->worker_count++] = worker;
+
+					if (ThreadAPI_Create(&worker->thread, worker_thread, worker) != THREADAPI_OK)
+					{
+						LogError("Cannot start worker thread %u", (unsigned int)i);
+						break;
+					}
+
+					worker->is_thread_started = 1;
+				}
+
+				if (i < worker_count)
+				{
+					destroy_workers(result);
+					free(result);
+					result = NULL;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+void worker_pool_destroy(WORKER_POOL_HANDLE worker_pool)
+{
+	if (worker_pool == NULL)
+	{
+		LogError("NULL worker_pool");
+	}
+	else
+	{
+		destroy_workers(worker_pool);
+		free(worker_pool);
+	}
+}
+
+size_t worker_pool_get_worker_count(WORKER_POOL_HANDLE worker_pool)
+{
+	size_t result;
+
+	if (worker_pool == NULL)
+	{
+		LogError("NULL worker_pool");
+		result = 0;
+	}
+	else
+	{
+		result = worker_pool->worker_count;
+	}
+
+	return result;
+}
+
+int worker_pool_post(WORKER_POOL_HANDLE worker_pool, size_t worker_index, ON_WORKER_POOL_WORK on_work, void* context)
+{
+	int result;
+
+	if ((worker_pool == NULL) ||
+		(on_work == NULL) ||
+		(worker_index >= worker_pool->worker_count))
+	{
+		LogError("Bad arguments: worker_pool = %p, on_work = %p, worker_index = %u",
+			worker_pool, on_work, (unsigned int)worker_index);
+		result = __FAILURE__;
+	}
+	else
+	{
+		WORK_ITEM* work_item = (WORK_ITEM*)malloc(sizeof(WORK_ITEM));
+		if (work_item == NULL)
+		{
+			LogError("Cannot allocate memory for the work item");
+			result = __FAILURE__;
+		}
+		else
+		{
+			WORKER* worker = worker_pool->workers[worker_index];
+
+			work_item->on_work = on_work;
+			work_item->context = context;
+			mpsc_queue_push(&worker->work_queue, &work_item->queue_item);
+
+			if ((__atomic_exchange_n(&worker->is_wake_pending, 1, __ATOMIC_SEQ_CST) == 0) &&
+				(connection_reactor_wake(worker->reactor) != 0))
+			{
+				/* the item is queued, it runs at the latest when the reactor wait times out */
+				LogError("Cannot wake worker %u", (unsigned int)worker_index);
+			}
+
+			result = 0;
+		}
+	}
+
+	return result;
+}
@@ -39,6 +39,7 @@ static void my_gballoc_free(void* ptr)
 #undef ENABLE_MOCKS
 
 #include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqpvalue_to_string.h"
 
 /* Requirements satisfied by the current implementation without any code:
 Tests_SRS_AMQPVALUE_01_270: [<encoding code="0x56" category="fixed" width="1" label="boolean with the octet 0x00 being false and octet 0x01 being true"/>]
@@ -14766,4 +14767,303 @@ TEST_FUNCTION(amqpvalue_decode_list_0xD0_256_null_items_not_enough_bytes_does_no
     amqpvalue_decoder_destroy(amqpvalue_decoder);
 }
 
+/* amqpvalue_to_string */
+
+TEST_FUNCTION(amqpvalue_to_string_formats_a_list_of_scalars)
+{
+    // arrange
+    AMQP_VALUE list = amqpvalue_create_list();
+    AMQP_VALUE item;
+    char* result;
+    item = amqpvalue_create_uint(42);
+    (void)amqpvalue_set_list_item(list, 0, item);
+    amqpvalue_destroy(item);
+    item = amqpvalue_create_string("abc");
+    (void)amqpvalue_set_list_item(list, 1, item);
+    amqpvalue_destroy(item);
+    item = amqpvalue_create_null();
+    (void)amqpvalue_set_list_item(list, 2, item);
+    amqpvalue_destroy(item);
+    item = amqpvalue_create_boolean(true);
+    (void)amqpvalue_set_list_item(list, 3, item);
+    amqpvalue_destroy(item);
+    item = amqpvalue_create_int(-7);
+    (void)amqpvalue_set_list_item(list, 4, item);
+    amqpvalue_destroy(item);
+
+    // act
+    result = amqpvalue_to_string(list);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "{42,abc,NULL,true,-7}", result);
+
+    // cleanup
+    free(result);
+    amqpvalue_destroy(list);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_formats_a_map_as_key_value_pairs)
+{
+    // arrange
+    AMQP_VALUE map = amqpvalue_create_map();
+    AMQP_VALUE key = amqpvalue_create_symbol("key");
+    AMQP_VALUE value = amqpvalue_create_ulong(5);
+    char* result;
+    (void)amqpvalue_set_map_value(map, key, value);
+    amqpvalue_destroy(key);
+    amqpvalue_destroy(value);
+
+    // act
+    result = amqpvalue_to_string(map);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "{[key:5]}", result);
+
+    // cleanup
+    free(result);
+    amqpvalue_destroy(map);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_formats_binary_as_space_separated_hex)
+{
+    // arrange
+    unsigned char bytes[] = { 0x01, 0xAB, 0xFF };
+    amqp_binary binary = { bytes, sizeof(bytes) };
+    AMQP_VALUE value = amqpvalue_create_binary(binary);
+    char* result;
+
+    // act
+    result = amqpvalue_to_string(value);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "<01 AB FF>", result);
+
+    // cleanup
+    free(result);
+    amqpvalue_destroy(value);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_formats_a_described_value_after_a_star)
+{
+    // arrange
+    AMQP_VALUE list = amqpvalue_create_list();
+    AMQP_VALUE item = amqpvalue_create_uint(1);
+    AMQP_VALUE described;
+    char* result;
+    (void)amqpvalue_set_list_item(list, 0, item);
+    amqpvalue_destroy(item);
+    described = amqpvalue_create_described(amqpvalue_create_ulong(0x10), list);
+
+    // act
+    result = amqpvalue_to_string(described);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "* {1}", result);
+
+    // cleanup
+    free(result);
+    amqpvalue_destroy(described);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_with_NULL_value_returns_NULL)
+{
+    // arrange
+
+    // act
+    char* result = amqpvalue_to_string(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+/* amqpvalue_to_string_bounded */
+
+TEST_FUNCTION(amqpvalue_to_string_bounded_cuts_a_longer_value_and_ends_it_with_the_marker)
+{
+    // arrange
+    AMQP_VALUE value = amqpvalue_create_string("0123456789");
+    char* result;
+
+    // act
+    result = amqpvalue_to_string_bounded(value, 8);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "01234...", result);
+
+    // cleanup
+    free(result);
+    amqpvalue_destroy(value);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_bounded_keeps_a_value_of_exactly_max_length)
+{
+    // arrange
+    AMQP_VALUE value = amqpvalue_create_string("0123456789");
+    char* result;
+
+    // act
+    result = amqpvalue_to_string_bounded(value, 10);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "0123456789", result);
+
+    // cleanup
+    free(result);
+    amqpvalue_destroy(value);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_bounded_shorter_than_the_marker_keeps_part_of_the_marker)
+{
+    // arrange
+    AMQP_VALUE value = amqpvalue_create_string("0123456789");
+    char* result;
+
+    // act
+    result = amqpvalue_to_string_bounded(value, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "..", result);
+
+    // cleanup
+    free(result);
+    amqpvalue_destroy(value);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_bounded_with_0_max_length_fails)
+{
+    // arrange
+    AMQP_VALUE value = amqpvalue_create_string("0123456789");
+    char* result;
+
+    // act
+    result = amqpvalue_to_string_bounded(value, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    amqpvalue_destroy(value);
+}
+
+/* amqpvalue_to_string_buffer */
+
+TEST_FUNCTION(amqpvalue_to_string_buffer_fills_an_exactly_fitting_buffer_without_allocating)
+{
+    // arrange
+    AMQP_VALUE value = amqpvalue_create_string("0123456789");
+    char buffer[11];
+    int result;
+    umock_c_reset_all_calls();
+
+    // act
+    result = amqpvalue_to_string_buffer(value, buffer, sizeof(buffer));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, "0123456789", buffer);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    amqpvalue_destroy(value);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_buffer_one_byte_short_cuts_the_value)
+{
+    // arrange
+    AMQP_VALUE value = amqpvalue_create_string("0123456789");
+    char buffer[10];
+    int result;
+
+    // act
+    result = amqpvalue_to_string_buffer(value, buffer, sizeof(buffer));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, "012345...", buffer);
+
+    // cleanup
+    amqpvalue_destroy(value);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_buffer_stops_formatting_a_list_once_it_is_cut)
+{
+    // arrange
+    AMQP_VALUE list = amqpvalue_create_list();
+    AMQP_VALUE item;
+    char buffer[12];
+    int result;
+    item = amqpvalue_create_string("abcdef");
+    (void)amqpvalue_set_list_item(list, 0, item);
+    amqpvalue_destroy(item);
+    item = amqpvalue_create_string("ghijkl");
+    (void)amqpvalue_set_list_item(list, 1, item);
+    amqpvalue_destroy(item);
+
+    // act
+    result = amqpvalue_to_string_buffer(list, buffer, sizeof(buffer));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, "{abcdef,...", buffer);
+
+    // cleanup
+    amqpvalue_destroy(list);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_buffer_cuts_a_large_value_to_a_trace_buffer)
+{
+    // arrange
+    char long_string[TRACE_STRING_BUFFER_SIZE * 2];
+    char buffer[TRACE_STRING_BUFFER_SIZE];
+    AMQP_VALUE value;
+    int result;
+    (void)memset(long_string, 'a', sizeof(long_string) - 1);
+    long_string[sizeof(long_string) - 1] = '\0';
+    value = amqpvalue_create_string(long_string);
+
+    // act
+    result = amqpvalue_to_string_buffer(value, buffer, sizeof(buffer));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, TRACE_STRING_BUFFER_SIZE - 1, strlen(buffer));
+    ASSERT_ARE_EQUAL(char_ptr, "...", buffer + TRACE_STRING_BUFFER_SIZE - 4);
+
+    // cleanup
+    amqpvalue_destroy(value);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_buffer_with_a_1_byte_buffer_fails)
+{
+    // arrange
+    AMQP_VALUE value = amqpvalue_create_string("0123456789");
+    char buffer[1];
+    int result;
+
+    // act
+    result = amqpvalue_to_string_buffer(value, buffer, sizeof(buffer));
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    amqpvalue_destroy(value);
+}
+
+TEST_FUNCTION(amqpvalue_to_string_buffer_with_NULL_buffer_fails)
+{
+    // arrange
+    AMQP_VALUE value = amqpvalue_create_string("0123456789");
+    int result;
+
+    // act
+    result = amqpvalue_to_string_buffer(value, NULL, 10);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    amqpvalue_destroy(value);
+}
+
 END_TEST_SUITE(amqpvalue_ut)
@@ -0,0 +1,475 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* Measures the CPU spent keeping idle AMQP connections alive:
+   first by calling connection_dowork on every connection in a loop, then by driving them from the connection reactor. */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_uamqp_c/socket_listener.h"
+#include "azure_uamqp_c/header_detect_io.h"
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/connection_reactor.h"
+
+#define IDLE_CONNECTION_COUNT 500
+#define TEST_PORT 5672
+#define MEASURE_TIME 5000 // ms
+#define SETUP_TIMEOUT 30000 // ms
+
+typedef struct TEST_CONNECTION_TAG
+{
+	CONNECTION_HANDLE connection;
+	XIO_HANDLE io;
+	XIO_HANDLE underlying_io;
+	int fd;
+} TEST_CONNECTION;
+
+static TEST_CONNECTION server_connections[IDLE_CONNECTION_COUNT];
+static size_t server_connection_count;
+static TEST_CONNECTION client_connections[IDLE_CONNECTION_COUNT];
+static size_t client_connection_count;
+static size_t opened_connection_count;
+
+static void on_connection_state_changed(void* context, CONNECTION_STATE new_connection_state, CONNECTION_STATE previous_connection_state)
+{
+	(void)context;
+	(void)previous_connection_state;
+
+	if (new_connection_state == CONNECTION_STATE_OPENED)
+	{
+		opened_connection_count++;
+	}
+}
+
+static void on_socket_accepted(void* context, const IO_INTERFACE_DESCRIPTION* interface_description, void* io_parameters)
+{
+	SOCKETIO_CONFIG* socketio_config = (SOCKETIO_CONFIG*)io_parameters;
+	HEADERDETECTIO_CONFIG header_detect_io_config;
+	TEST_CONNECTION* server_connection;
+
+	(void)context;
+
+	if (server_connection_count == IDLE_CONNECTION_COUNT)
+	{
+		LogError("Too many connections accepted");
+		(void)close(*(int*)socketio_config->accepted_socket);
+	}
+	else
+	{
+		server_connection = &server_connections[server_connection_count];
+		server_connection->fd = *(int*)socketio_config->accepted_socket;
+		server_connection->underlying_io = xio_create(interface_description, io_parameters);
+		if (server_connection->underlying_io == NULL)
+		{
+			LogError("Cannot create accepted socket IO");
+		}
+		else
+		{
+			header_detect_io_config.underlying_io = server_connection->underlying_io;
+			server_connection->io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config);
+			if (server_connection->io == NULL)
+			{
+				LogError("Cannot create header detect IO");
+				xio_destroy(server_connection->underlying_io);
+			}
+			else
+			{
+				server_connection->connection = connection_create2(server_connection->io, NULL, "server", NULL, NULL, on_connection_state_changed, NULL, NULL, NULL);
+				if (server_connection->connection == NULL)
+				{
+					LogError("Cannot create server connection");
+					xio_destroy(server_connection->io);
+					xio_destroy(server_connection->underlying_io);
+				}
+				else if (connection_listen(server_connection->connection) != 0)
+				{
+					LogError("Cannot listen on server connection");
+					connection_destroy(server_connection->connection);
+					xio_destroy(server_connection->io);
+					xio_destroy(server_connection->underlying_io);
+				}
+				else
+				{
+					server_connection_count++;
+				}
+			}
+		}
+	}
+}
+
+static int connect_client_socket(void)
+{
+	int result = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (result == -1)
+	{
+		LogError("Cannot create client socket");
+	}
+	else
+	{
+		struct sockaddr_in sa;
+		int flags;
+
+		(void)memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		sa.sin_port = htons(TEST_PORT);
+		sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		/* connect blocking so the socket can be handed to socketio already connected */
+		if ((connect(result, (const struct sockaddr*)&sa, sizeof(sa)) != 0) ||
+			(-1 == (flags = fcntl(result, F_GETFL, 0))) ||
+			(fcntl(result, F_SETFL, flags | O_NONBLOCK) == -1))
+		{
+			LogError("Cannot connect client socket");
+			(void)close(result);
+			result = -1;
+		}
+	}
+
+	return result;
+}
+
+static int create_client_connection(TEST_CONNECTION* client_connection)
+{
+	int result;
+
+	client_connection->fd = connect_client_socket();
+	if (client_connection->fd == -1)
+	{
+		result = __LINE__;
+	}
+	else
+	{
+		SOCKETIO_CONFIG socketio_config = { "localhost", TEST_PORT, NULL };
+		socketio_config.accepted_socket = &client_connection->fd;
+
+		client_connection->underlying_io = NULL;
+		client_connection->io = xio_create(socketio_get_interface_description(), &socketio_config);
+		if (client_connection->io == NULL)
+		{
+			LogError("Cannot create client IO");
+			(void)close(client_connection->fd);
+			result = __LINE__;
+		}
+		else
+		{
+			client_connection->connection = connection_create2(client_connection->io, "localhost", "client", NULL, NULL, on_connection_state_changed, NULL, NULL, NULL);
+			if (client_connection->connection == NULL)
+			{
+				LogError("Cannot create client connection");
+				xio_destroy(client_connection->io);
+				result = __LINE__;
+			}
+			else
+			{
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+static void dowork_all_connections(void)
+{
+	size_t i;
+
+	for (i = 0; i < client_connection_count; i++)
+	{
+		connection_dowork(client_connections[i].connection);
+	}
+
+	for (i = 0; i < server_connection_count; i++)
+	{
+		connection_dowork(server_connections[i].connection);
+	}
+}
+
+static double get_cpu_seconds(void)
+{
+	struct rusage usage;
+	double result;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		result = 0;
+	}
+	else
+	{
+		result = (double)usage.ru_utime.tv_sec + ((double)usage.ru_utime.tv_usec / 1000000) +
+			(double)usage.ru_stime.tv_sec + ((double)usage.ru_stime.tv_usec / 1000000);
+	}
+
+	return result;
+}
+
+static int measure_polling(TICK_COUNTER_HANDLE tick_counter, double* cpu_seconds, size_t* loop_count)
+{
+	int result;
+	tickcounter_ms_t start_ms;
+	tickcounter_ms_t current_ms;
+	double start_cpu = get_cpu_seconds();
+
+	*loop_count = 0;
+
+	if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+	{
+		result = __LINE__;
+	}
+	else
+	{
+		result = 0;
+
+		do
+		{
+			dowork_all_connections();
+			(*loop_count)++;
+
+			if (tickcounter_get_current_ms(tick_counter, &current_ms) != 0)
+			{
+				result = __LINE__;
+				break;
+			}
+		} while (current_ms - start_ms < MEASURE_TIME);
+
+		*cpu_seconds = get_cpu_seconds() - start_cpu;
+	}
+
+	return result;
+}
+
+static int measure_reactor(TICK_COUNTER_HANDLE tick_counter, double* cpu_seconds, size_t* loop_count)
+{
+	int result;
+	CONNECTION_REACTOR_HANDLE reactor = connection_reactor_create();
+
+	*loop_count = 0;
+
+	if (reactor == NULL)
+	{
+		LogError("Cannot create connection reactor");
+		result = __LINE__;
+	}
+	else
+	{
+		size_t i;
+
+		for (i = 0; i < client_connection_count; i++)
+		{
+			if (connection_reactor_add_connection(reactor, client_connections[i].connection, client_connections[i].fd) != 0)
+			{
+				break;
+			}
+		}
+
+		if (i < client_connection_count)
+		{
+			LogError("Cannot add client connection to the reactor");
+			result = __LINE__;
+		}
+		else
+		{
+			for (i = 0; i < server_connection_count; i++)
+			{
+				if (connection_reactor_add_connection(reactor, server_connections[i].connection, server_connections[i].fd) != 0)
+				{
+					break;
+				}
+			}
+
+			if (i < server_connection_count)
+			{
+				LogError("Cannot add server connection to the reactor");
+				result = __LINE__;
+			}
+			else
+			{
+				tickcounter_ms_t start_ms;
+				tickcounter_ms_t current_ms;
+				double start_cpu = get_cpu_seconds();
+
+				if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+				{
+					result = __LINE__;
+				}
+				else
+				{
+					result = 0;
+
+					do
+					{
+						if (connection_reactor_dowork(reactor, 1000) != 0)
+						{
+							result = __LINE__;
+							break;
+						}
+
+						(*loop_count)++;
+
+						if (tickcounter_get_current_ms(tick_counter, &current_ms) != 0)
+						{
+							result = __LINE__;
+							break;
+						}
+					} while (current_ms - start_ms < MEASURE_TIME);
+
+					*cpu_seconds = get_cpu_seconds() - start_cpu;
+				}
+			}
+		}
+
+		connection_reactor_destroy(reactor);
+	}
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		SOCKET_LISTENER_HANDLE socket_listener = socketlistener_create(TEST_PORT);
+		if (socket_listener == NULL)
+		{
+			LogError("Cannot create socket listener");
+			result = __LINE__;
+		}
+		else
+		{
+			if (socketlistener_start(socket_listener, on_socket_accepted, NULL) != 0)
+			{
+				LogError("socketlistener_start failed");
+				result = __LINE__;
+			}
+			else
+			{
+				TICK_COUNTER_HANDLE tick_counter = tickcounter_create();
+				if (tick_counter == NULL)
+				{
+					LogError("Cannot create tick counter");
+					result = __LINE__;
+				}
+				else
+				{
+					tickcounter_ms_t start_ms = 0;
+					tickcounter_ms_t current_ms = 0;
+
+					result = 0;
+
+					/* connect the clients one by one, accepting each so the listen backlog never fills up */
+					while (client_connection_count < IDLE_CONNECTION_COUNT)
+					{
+						size_t accepted_count = server_connection_count;
+
+						if (create_client_connection(&client_connections[client_connection_count]) != 0)
+						{
+							result = __LINE__;
+							break;
+						}
+
+						client_connection_count++;
+
+						while (server_connection_count == accepted_count)
+						{
+							socketlistener_dowork(socket_listener);
+						}
+					}
+
+					if ((result == 0) &&
+						(tickcounter_get_current_ms(tick_counter, &start_ms) != 0))
+					{
+						result = __LINE__;
+					}
+
+					/* exchange headers and OPEN frames until every connection is idle in OPENED */
+					while ((result == 0) &&
+						(opened_connection_count < client_connection_count + server_connection_count))
+					{
+						dowork_all_connections();
+
+						if (tickcounter_get_current_ms(tick_counter, &current_ms) != 0)
+						{
+							result = __LINE__;
+						}
+						else if (current_ms - start_ms > SETUP_TIMEOUT)
+						{
+							LogError("Only %u connections opened", (unsigned int)opened_connection_count);
+							result = __LINE__;
+						}
+					}
+
+					if (result == 0)
+					{
+						double polling_cpu_seconds = 0;
+						double reactor_cpu_seconds = 0;
+						size_t polling_loop_count;
+						size_t reactor_loop_count;
+
+						if (measure_polling(tick_counter, &polling_cpu_seconds, &polling_loop_count) != 0)
+						{
+							LogError("Measuring the polling loop failed");
+							result = __LINE__;
+						}
+						else if (measure_reactor(tick_counter, &reactor_cpu_seconds, &reactor_loop_count) != 0)
+						{
+							LogError("Measuring the reactor failed");
+							result = __LINE__;
+						}
+						else
+						{
+							LogInfo("%u idle connections for %u ms:", (unsigned int)(client_connection_count + server_connection_count), (unsigned int)MEASURE_TIME);
+							LogInfo("  polling: %.3f CPU seconds (%.1f%% of a core), %u loops",
+								polling_cpu_seconds, polling_cpu_seconds * 100000 / MEASURE_TIME, (unsigned int)polling_loop_count);
+							LogInfo("  reactor: %.3f CPU seconds (%.1f%% of a core), %u loops",
+								reactor_cpu_seconds, reactor_cpu_seconds * 100000 / MEASURE_TIME, (unsigned int)reactor_loop_count);
+						}
+					}
+
+					while (client_connection_count > 0)
+					{
+						client_connection_count--;
+						connection_destroy(client_connections[client_connection_count].connection);
+						xio_destroy(client_connections[client_connection_count].io);
+					}
+
+					while (server_connection_count > 0)
+					{
+						server_connection_count--;
+						connection_destroy(server_connections[server_connection_count].connection);
+						xio_destroy(server_connections[server_connection_count].io);
+						xio_destroy(server_connections[server_connection_count].underlying_io);
+					}
+
+					tickcounter_destroy(tick_counter);
+				}
+
+				(void)socketlistener_stop(socket_listener);
+			}
+
+			socketlistener_destroy(socket_listener);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}
@@ -39,6 +39,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_uamqp_c/amqp_frame_codec.h"
 #include "azure_uamqp_c/amqpvalue_to_string.h"
 #include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/timer_wheel.h"
 
 #undef ENABLE_MOCKS
 
@@ -67,8 +68,14 @@ static void my_gballoc_free(void* ptr)
 #define TEST_LIST_HANDLE				(SINGLYLINKEDLIST_HANDLE)0x4246
 #define TEST_OPEN_PERFORMATIVE			(AMQP_VALUE)0x4301
 #define TEST_CLOSE_PERFORMATIVE				(AMQP_VALUE)0x4302
+#define TEST_TIMER_WHEEL_HANDLE			(TIMER_WHEEL_HANDLE)0x4401
+#define TEST_IDLE_TIMER					(TIMER_WHEEL_TIMER_HANDLE)0x4402
+#define TEST_HEARTBEAT_TIMER			(TIMER_WHEEL_TIMER_HANDLE)0x4403
+#define TEST_FLUSH_TIMER				(TIMER_WHEEL_TIMER_HANDLE)0x4404
 #define TEST_CLOSE_DESCRIPTOR_AMQP_VALUE	(AMQP_VALUE)0x4303
 #define TEST_TRANSFER_PERFORMATIVE			(AMQP_VALUE)0x4304
+#define TEST_OPEN_HANDLE				(OPEN_HANDLE)0x4306
+#define TEST_FRAME_SIZE					8
 
 #define TEST_CONTEXT					(void*)(0x4242)
 
@@ -93,7 +100,21 @@ static AMQP_EMPTY_FRAME_RECEIVED_CALLBACK saved_empty_frame_received_callback;
 static AMQP_FRAME_CODEC_ERROR_CALLBACK saved_amqp_frame_codec_error_callback;
 static void* saved_amqp_frame_codec_callback_context;
 static void* saved_on_connection_state_changed_context;
+static ON_SEND_COMPLETE saved_on_send_complete;
+static void* saved_on_send_complete_context;
+static int xio_send_result;
+static size_t xio_send_call_count;
+static unsigned char encoded_frame_byte;
+static bool is_encoding_frame_bytes;
+static ENDPOINT_HANDLE dowork_endpoint;
+static size_t dowork_frame_count;
+static size_t created_timer_count;
+static ON_TIMER_EXPIRED saved_on_flush_timer_expired;
+static void* saved_on_flush_timer_expired_context;
 static CONNECTION_STATE saved_new_connection_state;
+static bool is_completing_xio_send_synchronously;
+static unsigned char last_sent_byte;
+static CONNECTION_HANDLE connection_to_close_on_send_complete;
 CONNECTION_STATE saved_previous_connection_state;
 
 static void stringify_bytes(const unsigned char* bytes, size_t byte_count, char* output_string)
@@ -123,6 +144,14 @@ MOCK_FUNCTION_WITH_CODE(, void, test_on_frame_received, void*, context, AMQP_VAL
 MOCK_FUNCTION_END();
 MOCK_FUNCTION_WITH_CODE(, void, test_on_connection_state_changed, void*, context, CONNECTION_STATE, new_connection_state, CONNECTION_STATE, previous_connection_state)
 MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_frame_send_complete, void*, context, IO_SEND_RESULT, send_result)
+    if (connection_to_close_on_send_complete != NULL)
+    {
+        CONNECTION_HANDLE connection = connection_to_close_on_send_complete;
+        connection_to_close_on_send_complete = NULL;
+        (void)connection_close(connection, NULL, NULL);
+    }
+MOCK_FUNCTION_END();
 
 static int my_xio_open(XIO_HANDLE io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
 {
@@ -137,6 +166,66 @@ static int my_xio_open(XIO_HANDLE io, ON_IO_OPEN_COMPLETE on_io_open_complete, v
     return 0;
 }
 
+static int my_xio_send(XIO_HANDLE io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)io;
+    if (size > 0)
+    {
+        last_sent_byte = ((const unsigned char*)buffer)[size - 1];
+    }
+    saved_on_send_complete = on_send_complete;
+    saved_on_send_complete_context = callback_context;
+    xio_send_call_count++;
+    if (is_completing_xio_send_synchronously &&
+        (xio_send_result == 0) &&
+        (on_send_complete != NULL))
+    {
+        on_send_complete(callback_context, IO_SEND_OK);
+    }
+    return xio_send_result;
+}
+
+/* encodes dowork_frame_count frames on dowork_endpoint, the way frames get encoded while the io delivers received bytes */
+static void my_xio_dowork(XIO_HANDLE io)
+{
+    size_t i;
+    (void)io;
+    for (i = 0; i < dowork_frame_count; i++)
+    {
+        (void)connection_encode_frame(dowork_endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)(i + 1));
+    }
+}
+
+/* the connection creates its idle, heartbeat and flush timers in that order */
+static TIMER_WHEEL_TIMER_HANDLE my_timer_wheel_create_timer(TIMER_WHEEL_HANDLE timer_wheel, ON_TIMER_EXPIRED on_timer_expired, void* context)
+{
+    (void)timer_wheel;
+    created_timer_count++;
+    if (created_timer_count == 3)
+    {
+        saved_on_flush_timer_expired = on_timer_expired;
+        saved_on_flush_timer_expired_context = context;
+    }
+    return (TIMER_WHEEL_TIMER_HANDLE)((uintptr_t)TEST_IDLE_TIMER + created_timer_count - 1);
+}
+
+/* when is_encoding_frame_bytes is set, each frame is encoded as TEST_FRAME_SIZE bytes of encoded_frame_byte, which then goes up by one */
+static int my_amqp_frame_codec_encode_frame(AMQP_FRAME_CODEC_HANDLE amqp_frame_codec, uint16_t channel, const AMQP_VALUE performative, const PAYLOAD* payloads, size_t payload_count, ON_BYTES_ENCODED on_bytes_encoded, void* callback_context)
+{
+    (void)amqp_frame_codec;
+    (void)channel;
+    (void)performative;
+    (void)payloads;
+    (void)payload_count;
+    if (is_encoding_frame_bytes)
+    {
+        unsigned char frame_bytes[TEST_FRAME_SIZE];
+        (void)memset(frame_bytes, encoded_frame_byte++, sizeof(frame_bytes));
+        on_bytes_encoded(callback_context, frame_bytes, sizeof(frame_bytes), true);
+    }
+    return 0;
+}
+
 static int my_frame_codec_receive_bytes(FRAME_CODEC_HANDLE frame_codec, const unsigned char* buffer, size_t size)
 {
     unsigned char* new_frame_codec_bytes = (unsigned char*)my_gballoc_realloc(frame_codec_bytes, frame_codec_byte_count + size);
@@ -219,6 +308,42 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
     ASSERT_FAIL(temp_str);
 }
 
+
+/* the performative of each frame sent is classified for the statistics */
+static void setup_count_outgoing_performative_expected_calls(AMQP_VALUE performative)
+{
+#ifndef UAMQP_NO_STATISTICS
+    STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(performative));
+    STRICT_EXPECTED_CALL(amqpvalue_get_ulong(TEST_DESCRIPTOR_AMQP_VALUE, IGNORED_PTR_ARG));
+#else
+    (void)performative;
+#endif
+}
+
+/* brings a connection to the OPENED state: the header exchange followed by the OPEN frames */
+static void open_connection(CONNECTION_HANDLE connection)
+{
+    const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
+    OPEN_HANDLE open_handle = TEST_OPEN_HANDLE;
+    uint32_t remote_max_frame_size = 512;
+
+    STRICT_EXPECTED_CALL(open_create(IGNORED_PTR_ARG))
+        .SetReturn(TEST_OPEN_HANDLE);
+    STRICT_EXPECTED_CALL(amqpvalue_create_open(TEST_OPEN_HANDLE))
+        .SetReturn(TEST_OPEN_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(amqpvalue_get_open(TEST_OPEN_PERFORMATIVE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_OPEN_handle(&open_handle, sizeof(open_handle));
+    STRICT_EXPECTED_CALL(open_get_max_frame_size(TEST_OPEN_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_max_frame_size_value(&remote_max_frame_size, sizeof(remote_max_frame_size));
+
+    (void)connection_open(connection);
+    saved_on_io_open_complete(saved_on_io_open_complete_context, IO_OPEN_OK);
+    saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
+    saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, NULL, 0);
+}
+
 BEGIN_TEST_SUITE(connection_ut)
 
 TEST_SUITE_INITIALIZE(suite_init)
@@ -240,19 +365,21 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(xio_create, TEST_IO_HANDLE);
     REGISTER_GLOBAL_MOCK_HOOK(xio_open, my_xio_open);
     REGISTER_GLOBAL_MOCK_RETURN(xio_close, 0);
-    REGISTER_GLOBAL_MOCK_RETURN(xio_send, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_send, my_xio_send);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_dowork, my_xio_dowork);
+    REGISTER_GLOBAL_MOCK_HOOK(timer_wheel_create_timer, my_timer_wheel_create_timer);
     REGISTER_GLOBAL_MOCK_HOOK(frame_codec_receive_bytes, my_frame_codec_receive_bytes);
     REGISTER_GLOBAL_MOCK_RETURN(frame_codec_create, TEST_FRAME_CODEC_HANDLE);
     REGISTER_GLOBAL_MOCK_RETURN(frame_codec_set_max_frame_size, 0);
     REGISTER_GLOBAL_MOCK_HOOK(amqp_frame_codec_create, my_amqp_frame_codec_create);
-    REGISTER_GLOBAL_MOCK_RETURN(amqp_frame_codec_encode_frame, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(amqp_frame_codec_encode_frame, my_amqp_frame_codec_encode_frame);
     REGISTER_GLOBAL_MOCK_RETURN(amqp_frame_codec_encode_empty_frame, 0);
     REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_ulong, my_amqpvalue_get_ulong);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_inplace_descriptor, TEST_DESCRIPTOR_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_string, 0);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_list_item, TEST_LIST_ITEM_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_inplace_described_value, TEST_DESCRIBED_AMQP_VALUE);
-    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_to_string, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_to_string_buffer, __LINE__);
     REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_create, TEST_LIST_HANDLE);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, my_singlylinkedlist_add);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, my_singlylinkedlist_find);
@@ -268,6 +395,15 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(AMQP_FRAME_CODEC_ERROR_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(AMQP_FRAME_CODEC_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TIMER_WHEEL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TIMER_WHEEL_TIMER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TIMER_EXPIRED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPEN_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_BYTES_ENCODED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IO_SEND_RESULT, int);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -290,6 +426,20 @@ TEST_FUNCTION_INITIALIZE(method_init)
     frame_codec_bytes = NULL;
     frame_codec_byte_count = 0;
     performative_ulong = 0x10;
+    saved_on_send_complete = NULL;
+    saved_on_send_complete_context = NULL;
+    xio_send_result = 0;
+    xio_send_call_count = 0;
+    encoded_frame_byte = 1;
+    is_encoding_frame_bytes = false;
+    dowork_endpoint = NULL;
+    dowork_frame_count = 0;
+    created_timer_count = 0;
+    saved_on_flush_timer_expired = NULL;
+    saved_on_flush_timer_expired_context = NULL;
+    is_completing_xio_send_synchronously = false;
+    last_sent_byte = 0;
+    connection_to_close_on_send_complete = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -1189,7 +1339,7 @@ TEST_FUNCTION(when_the_header_is_received_an_open_frame_is_sent_out)
     umock_c_reset_all_calls();
     const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(frame_codec_set_max_frame_size(TEST_FRAME_CODEC_HANDLE, 4294967295));
     STRICT_EXPECTED_CALL(open_create("1234"));
@@ -1361,7 +1511,7 @@ TEST_FUNCTION(when_no_hostname_is_specified_no_hostname_is_stamped_on_the_open_f
     umock_c_reset_all_calls();
     const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(frame_codec_set_max_frame_size(TEST_FRAME_CODEC_HANDLE, 4294967295));
     STRICT_EXPECTED_CALL(open_create("1234"));
@@ -1393,7 +1543,7 @@ TEST_FUNCTION(when_max_frame_size_has_been_specified_it_shall_be_set_in_the_open
     umock_c_reset_all_calls();
     const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(frame_codec_set_max_frame_size(TEST_FRAME_CODEC_HANDLE, 1024));
     STRICT_EXPECTED_CALL(open_create("1234"));
@@ -1453,7 +1603,7 @@ TEST_FUNCTION(when_channel_max_has_been_specified_it_shall_be_set_in_the_open_fr
     umock_c_reset_all_calls();
     const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(frame_codec_set_max_frame_size(TEST_FRAME_CODEC_HANDLE, 4294967295));
     STRICT_EXPECTED_CALL(open_create("1234"));
@@ -1514,7 +1664,7 @@ TEST_FUNCTION(when_idle_timeout_has_been_specified_it_shall_be_set_in_the_open_f
     umock_c_reset_all_calls();
     const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(frame_codec_set_max_frame_size(TEST_FRAME_CODEC_HANDLE, 4294967295));
     STRICT_EXPECTED_CALL(open_create("1234"));
@@ -1644,7 +1794,7 @@ TEST_FUNCTION(when_giving_the_bytes_to_frame_codec_fails_the_connection_is_close
     saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     EXPECTED_CALL(frame_codec_receive_bytes(TEST_FRAME_CODEC_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .ValidateArgument(1)
@@ -1903,7 +2053,7 @@ TEST_FUNCTION(when_an_open_frame_that_cannot_be_parsed_properly_is_received_the_
     saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_OPEN_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
@@ -1943,7 +2093,7 @@ TEST_FUNCTION(when_the_max_frame_size_cannot_be_retrieved_from_the_open_framethe
     saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_OPEN_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
@@ -1987,7 +2137,7 @@ TEST_FUNCTION(when_an_open_frame_with_max_frame_size_511_is_received_the_connect
     saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_OPEN_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
@@ -2031,7 +2181,7 @@ TEST_FUNCTION(when_an_open_frame_is_received_on_channel_1_the_connection_is_clos
     saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_OPEN_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
@@ -2068,7 +2218,7 @@ TEST_FUNCTION(when_the_frame_received_callback_is_called_with_a_NULL_performativ
     saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     /* we expect to close because of bad OPEN */
     STRICT_EXPECTED_CALL(error_create("amqp:internal-error"));
@@ -2166,7 +2316,7 @@ TEST_FUNCTION(when_a_close_frame_is_received_in_OPEN_SENT_a_CLOSE_is_sent)
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_CLOSE_PERFORMATIVE))
         .SetReturn(TEST_CLOSE_DESCRIPTOR_AMQP_VALUE);
@@ -2208,7 +2358,7 @@ TEST_FUNCTION(when_a_close_frame_is_sent_as_response_to_a_close_frame_and_creati
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_CLOSE_PERFORMATIVE))
         .SetReturn(TEST_CLOSE_DESCRIPTOR_AMQP_VALUE);
@@ -2247,7 +2397,7 @@ TEST_FUNCTION(when_a_close_frame_is_sent_as_response_to_a_close_frame_and_creati
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_CLOSE_PERFORMATIVE))
         .SetReturn(TEST_CLOSE_DESCRIPTOR_AMQP_VALUE);
@@ -2288,7 +2438,7 @@ TEST_FUNCTION(when_a_close_frame_is_sent_as_response_to_a_close_frame_and_sendin
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_CLOSE_PERFORMATIVE))
         .SetReturn(TEST_CLOSE_DESCRIPTOR_AMQP_VALUE);
@@ -2331,7 +2481,7 @@ TEST_FUNCTION(when_an_open_frame_is_received_in_open_the_connection_shall_be_clo
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_OPEN_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
@@ -2369,7 +2519,7 @@ TEST_FUNCTION(when_an_open_frame_is_received_in_the_DISCARDING_state_the_connect
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_OPEN_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
@@ -2427,7 +2577,7 @@ TEST_FUNCTION(when_a_CLOSE_frame_is_received_on_channel_1_it_is_still_valid)
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_CLOSE_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE))
@@ -2467,7 +2617,7 @@ TEST_FUNCTION(when_a_CLOSE_frame_with_1_byte_payload_is_received_it_is_still_val
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_CLOSE_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE))
@@ -2508,7 +2658,7 @@ TEST_FUNCTION(when_an_OPEN_frame_with_1_byte_payload_is_received_it_is_still_val
     saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_OPEN_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
@@ -2545,7 +2695,7 @@ TEST_FUNCTION(when_a_CLOSE_FRAME_is_received_on_a_channel_higher_than_the_max_ne
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_CLOSE_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE))
@@ -2922,7 +3072,7 @@ TEST_FUNCTION(connection_encode_frame_sends_the_frame)
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -2955,7 +3105,7 @@ TEST_FUNCTION(connection_encode_frame_with_1_payload_adds_the_bytes_to_the_frame
     unsigned char test_payload[] = { 0x42 };
     PAYLOAD payload = { test_payload, sizeof(test_payload) };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, &payload, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -2988,7 +3138,7 @@ TEST_FUNCTION(connection_encode_frame_with_1_payload_of_2_bytes_adds_the_bytes_t
     unsigned char test_payload[] = { 0x42, 0x43 };
     PAYLOAD payload = { test_payload, sizeof(test_payload) };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, &payload, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -3022,7 +3172,7 @@ TEST_FUNCTION(connection_encode_frame_with_2_payloads_of_1_byte_rach_adds_the_by
     unsigned char test_payload2[] = { 0x43 };
     PAYLOAD payloads[] = { { test_payload1, sizeof(test_payload1) }, { test_payload2, sizeof(test_payload2) } };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, payloads, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -3055,7 +3205,7 @@ TEST_FUNCTION(when_amqp_frame_codec_begin_encode_frame_fails_then_connection_enc
     unsigned char test_payload2[] = { 0x43 };
     PAYLOAD payloads[] = { { test_payload1, sizeof(test_payload1) }, { test_payload2, sizeof(test_payload2) } };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, payloads, 2, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(1);
@@ -3115,7 +3265,7 @@ TEST_FUNCTION(connection_encode_frame_after_close_has_been_received_fails)
     unsigned char test_payload2[] = { 0x43 };
     PAYLOAD payloads[] = { { test_payload1, sizeof(test_payload1) }, { test_payload2, sizeof(test_payload2) } };
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     // act
     int result = connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, payloads, 2, test_on_send_complete, (void*)0x4242);
@@ -3144,7 +3294,7 @@ TEST_FUNCTION(connection_encode_frame_with_a_second_endpoint_sends_on_channel_1)
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 1, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -3178,7 +3328,7 @@ TEST_FUNCTION(when_an_endpoint_is_destroyed_and_a_new_one_is_created_the_channel
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -3237,7 +3387,7 @@ TEST_FUNCTION(when_state_changes_to_HDR_EXCH_and_HDR_OPEN_SENT_all_endpoints_are
     saved_io_state_changed(saved_on_io_open_complete_context, IO_STATE_OPEN, IO_STATE_NOT_OPEN);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(frame_codec_set_max_frame_size(TEST_FRAME_CODEC_HANDLE, 4294967295));
     STRICT_EXPECTED_CALL(open_create("1234"));
@@ -3282,7 +3432,7 @@ TEST_FUNCTION(when_state_changes_to_OPENED_all_endpoints_are_notified)
     saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_OPEN_PERFORMATIVE));
     STRICT_EXPECTED_CALL(is_open_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
@@ -3322,7 +3472,7 @@ TEST_FUNCTION(when_state_changes_to_CLOSE_RCVD_and_END_SENT_all_endpoints_are_no
     saved_frame_received_callback(saved_amqp_frame_codec_callback_context, 0, TEST_OPEN_PERFORMATIVE, 0, 0);
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(amqpvalue_to_string(IGNORED_PTR_ARG)).IgnoreAllCalls();
+    EXPECTED_CALL(amqpvalue_to_string_buffer(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllCalls();
 
     STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_CLOSE_PERFORMATIVE))
         .SetReturn(TEST_CLOSE_DESCRIPTOR_AMQP_VALUE);
@@ -3429,4 +3579,579 @@ TEST_FUNCTION(connection_set_trace_succeeds)
     connection_destroy(connection);
 }
 
+/* connection_set_send_coalescing */
+
+TEST_FUNCTION(connection_set_send_coalescing_with_NULL_connection_fails)
+{
+    // arrange
+
+    // act
+    int result = connection_set_send_coalescing(NULL, 16384, 0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(connection_set_send_coalescing_allocates_the_coalesce_buffer)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(16384));
+
+    // act
+    result = connection_set_send_coalescing(connection, 16384, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_allocating_the_coalesce_buffer_fails_connection_set_send_coalescing_fails)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(16384))
+        .SetReturn(NULL);
+
+    // act
+    result = connection_set_send_coalescing(connection, 16384, 0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_set_send_coalescing_with_0_bytes_frees_the_coalesce_buffer)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    int result;
+    (void)connection_set_send_coalescing(connection, 16384, 0);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result = connection_set_send_coalescing(connection, 0, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_set_timer_wheel_with_NULL_connection_fails)
+{
+    // arrange
+
+    // act
+    int result = connection_set_timer_wheel(NULL, TEST_TIMER_WHEEL_HANDLE);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(connection_set_timer_wheel_creates_the_idle_heartbeat_and_flush_timers)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    int result;
+    (void)connection_set_idle_timeout(connection, 1000);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_IDLE_TIMER);
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_HEARTBEAT_TIMER);
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_FLUSH_TIMER);
+    STRICT_EXPECTED_CALL(timer_wheel_schedule_after(TEST_IDLE_TIMER, 0));
+
+    // act
+    result = connection_set_timer_wheel(connection, TEST_TIMER_WHEEL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_creating_the_heartbeat_timer_fails_connection_set_timer_wheel_fails)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_IDLE_TIMER);
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(timer_wheel_destroy_timer(TEST_IDLE_TIMER));
+
+    // act
+    result = connection_set_timer_wheel(connection, TEST_TIMER_WHEEL_HANDLE);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_creating_the_flush_timer_fails_connection_set_timer_wheel_fails)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_IDLE_TIMER);
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_HEARTBEAT_TIMER);
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(timer_wheel_destroy_timer(TEST_IDLE_TIMER));
+    STRICT_EXPECTED_CALL(timer_wheel_destroy_timer(TEST_HEARTBEAT_TIMER));
+
+    // act
+    result = connection_set_timer_wheel(connection, TEST_TIMER_WHEEL_HANDLE);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_destroy_destroys_the_idle_heartbeat_and_flush_timers)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_IDLE_TIMER);
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_HEARTBEAT_TIMER);
+    STRICT_EXPECTED_CALL(timer_wheel_create_timer(TEST_TIMER_WHEEL_HANDLE, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_timer_expired()
+        .SetReturn(TEST_FLUSH_TIMER);
+    (void)connection_set_timer_wheel(connection, TEST_TIMER_WHEEL_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(timer_wheel_destroy_timer(TEST_IDLE_TIMER));
+    STRICT_EXPECTED_CALL(timer_wheel_destroy_timer(TEST_HEARTBEAT_TIMER));
+    STRICT_EXPECTED_CALL(timer_wheel_destroy_timer(TEST_FLUSH_TIMER));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_destroy(TEST_AMQP_FRAME_CODEC_HANDLE));
+    STRICT_EXPECTED_CALL(frame_codec_destroy(TEST_FRAME_CODEC_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(test_tick_counter));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    connection_destroy(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* connection_get_statistics */
+
+TEST_FUNCTION(connection_get_statistics_with_NULL_connection_fails)
+{
+    // arrange
+    CONNECTION_STATISTICS statistics;
+
+    // act
+    int result = connection_get_statistics(NULL, &statistics);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(connection_get_statistics_with_NULL_statistics_fails)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = connection_get_statistics(connection, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(connection_get_statistics_counts_the_received_bytes)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    CONNECTION_STATISTICS statistics;
+    const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
+    (void)connection_open(connection);
+    saved_on_io_open_complete(saved_on_io_open_complete_context, IO_OPEN_OK);
+    saved_on_bytes_received(saved_on_bytes_received_context, amqp_header, sizeof(amqp_header));
+    umock_c_reset_all_calls();
+
+    // act
+    int result = connection_get_statistics(connection, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, (uint64_t)sizeof(amqp_header), statistics.bytes_received);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.frames_received);
+
+    // cleanup
+    connection_destroy(connection);
+}
+
+/* coalesced sends */
+
+TEST_FUNCTION(frames_encoded_in_one_dowork_go_out_in_a_single_xio_send)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    ENDPOINT_HANDLE endpoint;
+    const unsigned char expected_bytes[] =
+    {
+        1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2,
+        3, 3, 3, 3, 3, 3, 3, 3
+    };
+    open_connection(connection);
+    endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, NULL);
+    (void)connection_set_send_coalescing(connection, 1024, 0);
+    is_encoding_frame_bytes = true;
+    dowork_endpoint = endpoint;
+    dowork_frame_count = 3;
+    umock_c_reset_all_calls();
+    xio_send_call_count = 0;
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_dowork(TEST_IO_HANDLE));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_IO_HANDLE, IGNORED_PTR_ARG, sizeof(expected_bytes), IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ValidateArgumentBuffer(2, expected_bytes, sizeof(expected_bytes));
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, xio_send_call_count);
+
+    // cleanup
+    saved_on_send_complete(saved_on_send_complete_context, IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_a_coalesced_send_completes_each_frame_send_complete_is_called_in_order)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    ENDPOINT_HANDLE endpoint;
+    open_connection(connection);
+    endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, NULL);
+    (void)connection_set_send_coalescing(connection, 1024, 0);
+    is_encoding_frame_bytes = true;
+    dowork_endpoint = endpoint;
+    dowork_frame_count = 3;
+    connection_dowork(connection);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_frame_send_complete((void*)1, IO_SEND_OK));
+    STRICT_EXPECTED_CALL(test_on_frame_send_complete((void*)2, IO_SEND_OK));
+    STRICT_EXPECTED_CALL(test_on_frame_send_complete((void*)3, IO_SEND_OK));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    saved_on_send_complete(saved_on_send_complete_context, IO_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_a_coalesced_send_completes_with_an_error_each_frame_send_complete_gets_the_error)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    ENDPOINT_HANDLE endpoint;
+    open_connection(connection);
+    endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, NULL);
+    (void)connection_set_send_coalescing(connection, 1024, 0);
+    is_encoding_frame_bytes = true;
+    dowork_endpoint = endpoint;
+    dowork_frame_count = 2;
+    connection_dowork(connection);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_frame_send_complete((void*)1, IO_SEND_ERROR));
+    STRICT_EXPECTED_CALL(test_on_frame_send_complete((void*)2, IO_SEND_ERROR));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    saved_on_send_complete(saved_on_send_complete_context, IO_SEND_ERROR);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(a_frame_send_complete_closing_the_connection_from_inside_the_coalesced_send_does_not_send_the_buffer_again)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    ENDPOINT_HANDLE endpoint;
+    open_connection(connection);
+    endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, NULL);
+    (void)connection_set_send_coalescing(connection, 1024, 0);
+    is_encoding_frame_bytes = true;
+    dowork_endpoint = endpoint;
+    dowork_frame_count = 1;
+    is_completing_xio_send_synchronously = true;
+    connection_to_close_on_send_complete = connection;
+    umock_c_reset_all_calls();
+    xio_send_call_count = 0;
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, xio_send_call_count);
+    ASSERT_ARE_EQUAL(int, 2, (int)last_sent_byte);
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(when_the_coalesced_xio_send_fails_each_frame_send_complete_gets_an_error)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    ENDPOINT_HANDLE endpoint;
+    open_connection(connection);
+    endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, NULL);
+    (void)connection_set_send_coalescing(connection, 1024, 0);
+    is_encoding_frame_bytes = true;
+    dowork_endpoint = endpoint;
+    dowork_frame_count = 3;
+    umock_c_reset_all_calls();
+    xio_send_result = 1;
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_dowork(TEST_IO_HANDLE));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_IO_HANDLE, IGNORED_PTR_ARG, 3 * TEST_FRAME_SIZE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_on_frame_send_complete((void*)1, IO_SEND_ERROR));
+    STRICT_EXPECTED_CALL(test_on_frame_send_complete((void*)2, IO_SEND_ERROR));
+    STRICT_EXPECTED_CALL(test_on_frame_send_complete((void*)3, IO_SEND_ERROR));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(error_create("amqp:internal-error"));
+    STRICT_EXPECTED_CALL(xio_close(TEST_IO_HANDLE, NULL, NULL));
+    STRICT_EXPECTED_CALL(test_on_connection_state_changed(NULL, CONNECTION_STATE_END, CONNECTION_STATE_OPENED));
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(a_frame_encoded_outside_dowork_on_a_timer_wheel_is_sent_when_the_flush_timer_fires)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    ENDPOINT_HANDLE endpoint;
+    const unsigned char expected_bytes[] = { 1, 1, 1, 1, 1, 1, 1, 1 };
+    open_connection(connection);
+    endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, NULL);
+    (void)connection_set_send_coalescing(connection, 1024, 0);
+    (void)connection_set_timer_wheel(connection, TEST_TIMER_WHEEL_HANDLE);
+    is_encoding_frame_bytes = true;
+    umock_c_reset_all_calls();
+    xio_send_call_count = 0;
+
+    /* as for a frame forwarded from another connection of the same reactor, nothing runs this connection's dowork */
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(timer_wheel_schedule_after(TEST_FLUSH_TIMER, 0));
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)1);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, xio_send_call_count);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(timer_wheel_cancel(TEST_FLUSH_TIMER));
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_IO_HANDLE, IGNORED_PTR_ARG, sizeof(expected_bytes), IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ValidateArgumentBuffer(2, expected_bytes, sizeof(expected_bytes));
+
+    // act
+    saved_on_flush_timer_expired(saved_on_flush_timer_expired_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, xio_send_call_count);
+
+    // cleanup
+    saved_on_send_complete(saved_on_send_complete_context, IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(frames_encoded_in_dowork_on_a_timer_wheel_do_not_arm_the_flush_timer)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    ENDPOINT_HANDLE endpoint;
+    open_connection(connection);
+    endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, NULL);
+    (void)connection_set_send_coalescing(connection, 1024, 0);
+    (void)connection_set_timer_wheel(connection, TEST_TIMER_WHEEL_HANDLE);
+    is_encoding_frame_bytes = true;
+    dowork_endpoint = endpoint;
+    dowork_frame_count = 2;
+    umock_c_reset_all_calls();
+    xio_send_call_count = 0;
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_dowork(TEST_IO_HANDLE));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_frame_codec_encode_frame(TEST_AMQP_FRAME_CODEC_HANDLE, 0, TEST_TRANSFER_PERFORMATIVE, NULL, 0, IGNORED_PTR_ARG, connection))
+        .IgnoreArgument_on_bytes_encoded();
+    setup_count_outgoing_performative_expected_calls(TEST_TRANSFER_PERFORMATIVE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(test_tick_counter, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(timer_wheel_cancel(TEST_FLUSH_TIMER));
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_IO_HANDLE, IGNORED_PTR_ARG, 2 * TEST_FRAME_SIZE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    connection_dowork(connection);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, xio_send_call_count);
+
+    // cleanup
+    saved_on_send_complete(saved_on_send_complete_context, IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
+TEST_FUNCTION(without_a_timer_wheel_connection_handle_deadlines_sends_a_frame_encoded_outside_dowork)
+{
+    // arrange
+    CONNECTION_HANDLE connection = connection_create2(TEST_IO_HANDLE, "testhost", test_container_id, NULL, NULL, NULL, NULL, NULL, NULL);
+    ENDPOINT_HANDLE endpoint;
+    uint64_t result;
+    open_connection(connection);
+    endpoint = connection_create_endpoint(connection);
+    (void)connection_start_endpoint(endpoint, test_on_frame_received, test_on_connection_state_changed, NULL);
+    (void)connection_set_send_coalescing(connection, 1024, 0);
+    is_encoding_frame_bytes = true;
+    (void)connection_encode_frame(endpoint, TEST_TRANSFER_PERFORMATIVE, NULL, 0, test_on_frame_send_complete, (void*)1);
+    ASSERT_ARE_EQUAL(size_t, 0, xio_send_call_count);
+    umock_c_reset_all_calls();
+
+    // act
+    result = connection_handle_deadlines(connection);
+
+    // assert
+    ASSERT_IS_TRUE(result > 0);
+    ASSERT_ARE_EQUAL(size_t, 1, xio_send_call_count);
+
+    // cleanup
+    saved_on_send_complete(saved_on_send_complete_context, IO_SEND_OK);
+    connection_destroy_endpoint(endpoint);
+    connection_destroy(connection);
+}
+
 END_TEST_SUITE(connection_ut)
@@ -35,6 +35,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/frame_capture.h"
 
 #undef ENABLE_MOCKS
 
@@ -44,6 +45,7 @@ static void my_gballoc_free(void* ptr)
 #define TEST_LIST_HANDLE				(SINGLYLINKEDLIST_HANDLE)0x4246
 #define TEST_SUBSCRIPTION_ITEM			(void*)0x4247
 #define TEST_ERROR_CONTEXT				(void*)0x4248
+#define TEST_FRAME_CAPTURE				(FRAME_CAPTURE_HANDLE)0x424A
 #define TEST_LIST_ITEM_HANDLE			(LIST_ITEM_HANDLE)0x4249
 
 static const IO_INTERFACE_DESCRIPTION test_io_interface_description = { 0 };
@@ -205,6 +207,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_MATCH_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(FRAME_CAPTURE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(FRAME_CAPTURE_DIRECTION, int);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -2500,4 +2504,69 @@ TEST_FUNCTION(frame_codec_encode_frame_with_NULL_payloads_and_non_zero_payload_c
     frame_codec_destroy(frame_codec);
 }
 
+
+/* frame_codec_set_capture */
+
+TEST_FUNCTION(frame_codec_set_capture_with_NULL_frame_codec_fails)
+{
+    // arrange
+    int result;
+
+    // act
+    result = frame_codec_set_capture(NULL, TEST_FRAME_CAPTURE);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(frame_codec_encode_frame_with_a_capture_set_records_the_outbound_frame)
+{
+    // arrange
+    int result;
+    FRAME_CODEC_HANDLE frame_codec = frame_codec_create(test_frame_codec_decode_error, TEST_ERROR_CONTEXT);
+    (void)frame_codec_set_capture(frame_codec, TEST_FRAME_CAPTURE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(frame_capture_add_frame(TEST_FRAME_CAPTURE, FRAME_CAPTURE_DIRECTION_OUTBOUND, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 8));
+    STRICT_EXPECTED_CALL(test_on_bytes_encoded((void*)0x4242, IGNORED_PTR_ARG, IGNORED_NUM_ARG, true));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result = frame_codec_encode_frame(frame_codec, 0, NULL, 0, NULL, 0, test_on_bytes_encoded, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    frame_codec_destroy(frame_codec);
+}
+
+TEST_FUNCTION(frame_codec_set_capture_with_NULL_capture_stops_recording)
+{
+    // arrange
+    int result;
+    FRAME_CODEC_HANDLE frame_codec = frame_codec_create(test_frame_codec_decode_error, TEST_ERROR_CONTEXT);
+    (void)frame_codec_set_capture(frame_codec, TEST_FRAME_CAPTURE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(test_on_bytes_encoded((void*)0x4242, IGNORED_PTR_ARG, IGNORED_NUM_ARG, true));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result = frame_codec_set_capture(frame_codec, NULL);
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = frame_codec_encode_frame(frame_codec, 0, NULL, 0, NULL, 0, test_on_bytes_encoded, (void*)0x4242);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    frame_codec_destroy(frame_codec);
+}
+
 END_TEST_SUITE(frame_codec_ut)
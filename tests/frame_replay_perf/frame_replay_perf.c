@@ -0,0 +1,527 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* Replays the frames of a capture written by frame_capture, without any network in the way.
+   decode mode only runs the frames through the frame codec and the AMQP frame codec,
+   connection mode feeds them to a listening connection so that session, link and message receiver processing is included.
+   The recorded side should be the client: replay its outbound frames, or the inbound ones of a capture taken on a broker.
+
+   usage: frame_replay_perf <capture file> [decode|connection] [outbound|inbound] [iterations] */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_uamqp_c/frame_capture.h"
+#include "azure_uamqp_c/frame_codec.h"
+#include "azure_uamqp_c/header_detect_io.h"
+#include "azure_uamqp_c/amqp_frame_codec.h"
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/messaging.h"
+
+#define DEFAULT_ITERATIONS 1000
+
+static const unsigned char amqp_header[] = { 'A', 'M', 'Q', 'P', 0, 1, 0, 0 };
+
+typedef struct REPLAY_FRAMES_TAG
+{
+	FRAME_CAPTURE_DIRECTION direction;
+	unsigned char* bytes;
+	size_t size;
+	size_t capacity;
+	size_t frame_count;
+} REPLAY_FRAMES;
+
+typedef struct REPLAY_STATE_TAG
+{
+	size_t frames_decoded;
+	size_t messages_received;
+	bool is_error;
+	CONNECTION_HANDLE connection;
+	SESSION_HANDLE session;
+	LINK_HANDLE link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+} REPLAY_STATE;
+
+/* the replayed connection reads from the capture and writes to nowhere */
+typedef struct NULL_IO_INSTANCE_TAG
+{
+	ON_BYTES_RECEIVED on_bytes_received;
+	void* on_bytes_received_context;
+} NULL_IO_INSTANCE;
+
+/* the connection of the current iteration, replay_connection pushes the captured bytes through it */
+static NULL_IO_INSTANCE* current_null_io;
+
+static CONCRETE_IO_HANDLE null_io_create(void* io_create_parameters)
+{
+	NULL_IO_INSTANCE* result;
+
+	(void)io_create_parameters;
+
+	result = (NULL_IO_INSTANCE*)malloc(sizeof(NULL_IO_INSTANCE));
+	if (result == NULL)
+	{
+		LogError("Cannot allocate memory for the null IO");
+	}
+	else
+	{
+		result->on_bytes_received = NULL;
+		result->on_bytes_received_context = NULL;
+		current_null_io = result;
+	}
+
+	return result;
+}
+
+static void null_io_destroy(CONCRETE_IO_HANDLE null_io)
+{
+	free(null_io);
+}
+
+static int null_io_open(CONCRETE_IO_HANDLE null_io, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+	NULL_IO_INSTANCE* null_io_instance = (NULL_IO_INSTANCE*)null_io;
+
+	(void)on_io_error;
+	(void)on_io_error_context;
+
+	null_io_instance->on_bytes_received = on_bytes_received;
+	null_io_instance->on_bytes_received_context = on_bytes_received_context;
+	on_io_open_complete(on_io_open_complete_context, IO_OPEN_OK);
+
+	return 0;
+}
+
+static int null_io_close(CONCRETE_IO_HANDLE null_io, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+	(void)null_io;
+
+	if (on_io_close_complete != NULL)
+	{
+		on_io_close_complete(callback_context);
+	}
+
+	return 0;
+}
+
+static int null_io_send(CONCRETE_IO_HANDLE null_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	(void)null_io;
+	(void)buffer;
+	(void)size;
+
+	if (on_send_complete != NULL)
+	{
+		on_send_complete(callback_context, IO_SEND_OK);
+	}
+
+	return 0;
+}
+
+static void null_io_dowork(CONCRETE_IO_HANDLE null_io)
+{
+	(void)null_io;
+}
+
+static int null_io_setoption(CONCRETE_IO_HANDLE null_io, const char* option_name, const void* value)
+{
+	(void)null_io;
+	(void)option_name;
+	(void)value;
+
+	return 0;
+}
+
+static OPTIONHANDLER_HANDLE null_io_retrieveoptions(CONCRETE_IO_HANDLE null_io)
+{
+	(void)null_io;
+
+	return NULL;
+}
+
+static const IO_INTERFACE_DESCRIPTION null_io_interface_description =
+{
+	null_io_retrieveoptions,
+	null_io_create,
+	null_io_destroy,
+	null_io_open,
+	null_io_close,
+	null_io_send,
+	null_io_dowork,
+	null_io_setoption
+};
+
+static int on_frame_capture_record(void* context, const FRAME_CAPTURE_RECORD* record)
+{
+	REPLAY_FRAMES* replay_frames = (REPLAY_FRAMES*)context;
+	int result;
+
+	if (record->direction != replay_frames->direction)
+	{
+		result = 0;
+	}
+	else
+	{
+		if (replay_frames->size + record->frame_size > replay_frames->capacity)
+		{
+			size_t new_capacity = (replay_frames->capacity == 0) ? 65536 : replay_frames->capacity;
+			unsigned char* new_bytes;
+
+			while (new_capacity < replay_frames->size + record->frame_size)
+			{
+				new_capacity *= 2;
+			}
+
+			new_bytes = (unsigned char*)realloc(replay_frames->bytes, new_capacity);
+			if (new_bytes != NULL)
+			{
+				replay_frames->bytes = new_bytes;
+				replay_frames->capacity = new_capacity;
+			}
+		}
+
+		if (replay_frames->size + record->frame_size > replay_frames->capacity)
+		{
+			LogError("Cannot allocate memory for the replayed frames");
+			result = __LINE__;
+		}
+		else
+		{
+			(void)memcpy(replay_frames->bytes + replay_frames->size, record->frame_bytes, record->frame_size);
+			replay_frames->size += record->frame_size;
+			replay_frames->frame_count++;
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static void on_amqp_frame_received(void* context, uint16_t channel, AMQP_VALUE performative, const unsigned char* payload_bytes, uint32_t frame_payload_size)
+{
+	REPLAY_STATE* replay_state = (REPLAY_STATE*)context;
+
+	(void)channel;
+	(void)performative;
+	(void)payload_bytes;
+	(void)frame_payload_size;
+
+	replay_state->frames_decoded++;
+}
+
+static void on_amqp_empty_frame_received(void* context, uint16_t channel)
+{
+	REPLAY_STATE* replay_state = (REPLAY_STATE*)context;
+
+	(void)channel;
+
+	replay_state->frames_decoded++;
+}
+
+static void on_decode_error(void* context)
+{
+	REPLAY_STATE* replay_state = (REPLAY_STATE*)context;
+
+	replay_state->is_error = true;
+}
+
+static int replay_decode(const REPLAY_FRAMES* replay_frames, REPLAY_STATE* replay_state)
+{
+	int result;
+	FRAME_CODEC_HANDLE frame_codec = frame_codec_create(on_decode_error, replay_state);
+	if (frame_codec == NULL)
+	{
+		LogError("Cannot create frame codec");
+		result = __LINE__;
+	}
+	else
+	{
+		AMQP_FRAME_CODEC_HANDLE amqp_frame_codec = amqp_frame_codec_create(frame_codec, on_amqp_frame_received, on_amqp_empty_frame_received, on_decode_error, replay_state);
+		if (amqp_frame_codec == NULL)
+		{
+			LogError("Cannot create AMQP frame codec");
+			result = __LINE__;
+		}
+		else
+		{
+			if ((frame_codec_receive_bytes(frame_codec, replay_frames->bytes, replay_frames->size) != 0) ||
+				(replay_state->is_error))
+			{
+				LogError("Cannot decode the captured frames");
+				result = __LINE__;
+			}
+			else
+			{
+				result = 0;
+			}
+
+			amqp_frame_codec_destroy(amqp_frame_codec);
+		}
+
+		frame_codec_destroy(frame_codec);
+	}
+
+	return result;
+}
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	REPLAY_STATE* replay_state = (REPLAY_STATE*)context;
+
+	(void)message;
+
+	replay_state->messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	REPLAY_STATE* replay_state = (REPLAY_STATE*)context;
+	bool result;
+
+	if (replay_state->link != NULL)
+	{
+		LogError("Only the first link of a capture is replayed");
+		result = false;
+	}
+	else
+	{
+		replay_state->link = link_create_from_endpoint(replay_state->session, new_link_endpoint, name, role, source, target);
+		if (replay_state->link == NULL)
+		{
+			LogError("Cannot create link");
+			result = false;
+		}
+		else
+		{
+			replay_state->message_receiver = messagereceiver_create(replay_state->link, NULL, NULL);
+			if (replay_state->message_receiver == NULL)
+			{
+				LogError("Cannot create message receiver");
+				result = false;
+			}
+			else if (messagereceiver_open(replay_state->message_receiver, on_message_received, replay_state) != 0)
+			{
+				LogError("Cannot open message receiver");
+				result = false;
+			}
+			else
+			{
+				result = true;
+			}
+		}
+	}
+
+	return result;
+}
+
+static bool on_new_session_endpoint(void* context, ENDPOINT_HANDLE new_endpoint)
+{
+	REPLAY_STATE* replay_state = (REPLAY_STATE*)context;
+	bool result;
+
+	if (replay_state->session != NULL)
+	{
+		LogError("Only the first session of a capture is replayed");
+		result = false;
+	}
+	else
+	{
+		replay_state->session = session_create_from_endpoint(replay_state->connection, new_endpoint, on_new_link_attached, replay_state);
+		if (replay_state->session == NULL)
+		{
+			LogError("Cannot create session");
+			result = false;
+		}
+		else if ((session_set_incoming_window(replay_state->session, UINT32_MAX) != 0) ||
+			(session_begin(replay_state->session) != 0))
+		{
+			LogError("Cannot begin session");
+			result = false;
+		}
+		else
+		{
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+static int replay_connection(const REPLAY_FRAMES* replay_frames, REPLAY_STATE* replay_state)
+{
+	int result;
+	HEADERDETECTIO_CONFIG header_detect_io_config;
+	XIO_HANDLE header_detect_io;
+
+	/* a listening connection expects the protocol header to be consumed below it, as for an accepted socket */
+	header_detect_io_config.underlying_io = xio_create(&null_io_interface_description, NULL);
+	if (header_detect_io_config.underlying_io == NULL)
+	{
+		LogError("Cannot create null IO");
+		result = __LINE__;
+	}
+	else if ((header_detect_io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config)) == NULL)
+	{
+		LogError("Cannot create header detect IO");
+		xio_destroy(header_detect_io_config.underlying_io);
+		result = __LINE__;
+	}
+	else
+	{
+		replay_state->connection = connection_create(header_detect_io, NULL, "replay", on_new_session_endpoint, replay_state);
+		if (replay_state->connection == NULL)
+		{
+			LogError("Cannot create connection");
+			result = __LINE__;
+		}
+		else
+		{
+			if (connection_listen(replay_state->connection) != 0)
+			{
+				LogError("Cannot listen on connection");
+				result = __LINE__;
+			}
+			else
+			{
+				/* the capture starts after the protocol header, which frame_codec never sees; header detect IO consumes it here */
+				current_null_io->on_bytes_received(current_null_io->on_bytes_received_context, amqp_header, sizeof(amqp_header));
+				current_null_io->on_bytes_received(current_null_io->on_bytes_received_context, replay_frames->bytes, replay_frames->size);
+				result = 0;
+			}
+
+			if (replay_state->message_receiver != NULL)
+			{
+				messagereceiver_destroy(replay_state->message_receiver);
+			}
+
+			if (replay_state->link != NULL)
+			{
+				link_destroy(replay_state->link);
+			}
+
+			if (replay_state->session != NULL)
+			{
+				session_destroy(replay_state->session);
+			}
+
+			connection_destroy(replay_state->connection);
+		}
+
+		xio_destroy(header_detect_io);
+	}
+
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	int result;
+
+	if (argc < 2)
+	{
+		LogError("usage: %s <capture file> [decode|connection] [outbound|inbound] [iterations]", argv[0]);
+		result = __LINE__;
+	}
+	else if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		bool is_connection_mode = (argc > 2) && (strcmp(argv[2], "connection") == 0);
+		size_t iterations = (argc > 4) ? (size_t)strtoul(argv[4], NULL, 10) : DEFAULT_ITERATIONS;
+		REPLAY_FRAMES replay_frames;
+
+		replay_frames.direction = ((argc > 3) && (strcmp(argv[3], "inbound") == 0)) ? FRAME_CAPTURE_DIRECTION_INBOUND : FRAME_CAPTURE_DIRECTION_OUTBOUND;
+		replay_frames.bytes = NULL;
+		replay_frames.size = 0;
+		replay_frames.capacity = 0;
+		replay_frames.frame_count = 0;
+
+		/* load everything up front so that file reads stay out of the measurement */
+		if (frame_capture_read_file(argv[1], on_frame_capture_record, &replay_frames) != 0)
+		{
+			LogError("Cannot read capture file %s", argv[1]);
+			result = __LINE__;
+		}
+		else if (replay_frames.frame_count == 0)
+		{
+			LogError("No %s frames in %s", (replay_frames.direction == FRAME_CAPTURE_DIRECTION_INBOUND) ? "inbound" : "outbound", argv[1]);
+			result = __LINE__;
+		}
+		else
+		{
+			TICK_COUNTER_HANDLE tick_counter = tickcounter_create();
+			if (tick_counter == NULL)
+			{
+				LogError("Cannot create tick counter");
+				result = __LINE__;
+			}
+			else
+			{
+				tickcounter_ms_t start_ms = 0;
+				tickcounter_ms_t end_ms = 0;
+				size_t frames_decoded = 0;
+				size_t messages_received = 0;
+				size_t i;
+
+				result = 0;
+				(void)tickcounter_get_current_ms(tick_counter, &start_ms);
+
+				for (i = 0; i < iterations; i++)
+				{
+					REPLAY_STATE replay_state;
+
+					(void)memset(&replay_state, 0, sizeof(replay_state));
+					result = is_connection_mode ? replay_connection(&replay_frames, &replay_state) : replay_decode(&replay_frames, &replay_state);
+					if (result != 0)
+					{
+						break;
+					}
+
+					frames_decoded += replay_state.frames_decoded;
+					messages_received += replay_state.messages_received;
+				}
+
+				(void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+				if (result == 0)
+				{
+					double seconds = (end_ms > start_ms) ? (double)(end_ms - start_ms) / 1000.0 : 0.001;
+
+					LogInfo("%s replay of %u frames (%u bytes) x %u: %.0f frames/s, %.1f MB/s",
+						is_connection_mode ? "connection" : "decode",
+						(unsigned int)replay_frames.frame_count, (unsigned int)replay_frames.size, (unsigned int)iterations,
+						(double)(replay_frames.frame_count * iterations) / seconds,
+						(double)(replay_frames.size * iterations) / seconds / (1024.0 * 1024.0));
+
+					if (is_connection_mode)
+					{
+						LogInfo("  %u messages received", (unsigned int)messages_received);
+					}
+					else
+					{
+						LogInfo("  %u frames decoded", (unsigned int)frames_decoded);
+					}
+				}
+
+				tickcounter_destroy(tick_counter);
+			}
+		}
+
+		free(replay_frames.bytes);
+		platform_deinit();
+	}
+
+	return result;
+}
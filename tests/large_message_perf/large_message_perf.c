@@ -0,0 +1,443 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* The client sends MESSAGE_COUNT messages of MESSAGE_SIZE bytes over a memory pair to a server whose max frame size is
+   SERVER_MAX_FRAME_SIZE, so that each message arrives as a delivery of a few hundred transfer frames which the receiving
+   link reassembles. It is then repeated with the server receiving in streaming mode, where the body is handed over a
+   frame at a time instead, and with the client streaming the body out of a read callback or sending it without copying it
+   into the message, into either kind of receiver.
+   Fails when a message is not received whole or the exchange takes longer than TEST_TIMEOUT. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+#include "memory_pair_fixture/memory_pair_fixture.h"
+
+#define MESSAGE_SIZE (16 * 1024 * 1024)
+#define MESSAGE_COUNT 16
+#define OUTSTANDING_MESSAGE_COUNT 2
+#define SERVER_MAX_FRAME_SIZE (64 * 1024)
+#define TEST_TIMEOUT 60000 // ms
+
+typedef enum SEND_MODE_TAG
+{
+	SEND_MODE_COPIED,
+	SEND_MODE_BORROWED,
+	SEND_MODE_STREAMED
+} SEND_MODE;
+
+typedef struct SERVER_CONNECTED_CLIENT_TAG
+{
+	LINK_HANDLE link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+	bool is_streaming;
+	size_t messages_received;
+	bool is_message_truncated;
+	/* streaming: body bytes of the current message, and the most received in one piece */
+	size_t body_bytes_received;
+	size_t largest_body_chunk;
+} SERVER_CONNECTED_CLIENT;
+
+/* where a streamed send is in the body */
+typedef struct BODY_READER_TAG
+{
+	const unsigned char* body;
+	size_t offset;
+} BODY_READER;
+
+typedef struct CLIENT_TAG
+{
+	MEMORY_PAIR_FIXTURE fixture;
+	LINK_HANDLE link;
+	MESSAGE_SENDER_HANDLE message_sender;
+	unsigned char* body;
+	SEND_MODE send_mode;
+	BODY_READER body_readers[MESSAGE_COUNT];
+	size_t messages_sent;
+	size_t outstanding_message_count;
+	bool is_send_failed;
+	SERVER_CONNECTED_CLIENT server;
+} CLIENT;
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	BINARY_DATA binary_data;
+
+	if ((message_get_body_amqp_data_in_place(message, 0, &binary_data) != 0) ||
+		(binary_data.length != MESSAGE_SIZE) ||
+		(binary_data.bytes[MESSAGE_SIZE - 1] != (unsigned char)(MESSAGE_SIZE - 1)))
+	{
+		server_connected_client->is_message_truncated = true;
+	}
+
+	server_connected_client->messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static void on_message_body_data_received(const void* context, uint32_t data_section_index, const unsigned char* bytes, size_t length)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+
+	if ((data_section_index != 0) ||
+		(bytes[0] != (unsigned char)server_connected_client->body_bytes_received))
+	{
+		server_connected_client->is_message_truncated = true;
+	}
+
+	server_connected_client->body_bytes_received += length;
+	if (length > server_connected_client->largest_body_chunk)
+	{
+		server_connected_client->largest_body_chunk = length;
+	}
+}
+
+static AMQP_VALUE on_streamed_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	(void)message;
+
+	if (server_connected_client->body_bytes_received != MESSAGE_SIZE)
+	{
+		server_connected_client->is_message_truncated = true;
+	}
+
+	server_connected_client->body_bytes_received = 0;
+	server_connected_client->messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	CLIENT* client = (CLIENT*)context;
+	SERVER_CONNECTED_CLIENT* server_connected_client = &client->server;
+	bool result;
+
+	server_connected_client->link = memory_pair_fixture_create_receiver_link(&client->fixture, new_link_endpoint, name, role, source, target);
+	if (server_connected_client->link == NULL)
+	{
+		result = false;
+	}
+	else
+	{
+		server_connected_client->message_receiver = messagereceiver_create(server_connected_client->link, NULL, NULL);
+		if (server_connected_client->message_receiver == NULL)
+		{
+			LogError("Cannot create message receiver");
+			result = false;
+		}
+		else if ((server_connected_client->is_streaming) ?
+			(messagereceiver_open_streaming(server_connected_client->message_receiver, NULL, on_message_body_data_received, on_streamed_message_received, server_connected_client) != 0) :
+			(messagereceiver_open(server_connected_client->message_receiver, on_message_received, server_connected_client) != 0))
+		{
+			LogError("Cannot open message receiver");
+			result = false;
+		}
+		else
+		{
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	CLIENT* client = (CLIENT*)context;
+
+	if (send_result != MESSAGE_SEND_OK)
+	{
+		client->is_send_failed = true;
+	}
+
+	client->outstanding_message_count--;
+}
+
+static int on_message_body_read(void* context, unsigned char* buffer, size_t size, size_t* bytes_read)
+{
+	BODY_READER* body_reader = (BODY_READER*)context;
+
+	if (size > MESSAGE_SIZE - body_reader->offset)
+	{
+		size = MESSAGE_SIZE - body_reader->offset;
+	}
+
+	(void)memcpy(buffer, body_reader->body + body_reader->offset, size);
+	body_reader->offset += size;
+	*bytes_read = size;
+
+	return 0;
+}
+
+static int create_client(CLIENT* client)
+{
+	int result;
+
+	client->link = memory_pair_fixture_create_sender_link(&client->fixture, "sender-link", sender_settle_mode_settled);
+	if (client->link == NULL)
+	{
+		result = __LINE__;
+	}
+	else
+	{
+		client->message_sender = messagesender_create(client->link, NULL, NULL);
+		if ((client->message_sender == NULL) ||
+			(messagesender_open(client->message_sender) != 0))
+		{
+			LogError("Cannot open client message sender");
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static void destroy_client(CLIENT* client)
+{
+	if (client->message_sender != NULL)
+	{
+		messagesender_destroy(client->message_sender);
+	}
+
+	if (client->link != NULL)
+	{
+		link_destroy(client->link);
+	}
+
+	if (client->server.message_receiver != NULL)
+	{
+		messagereceiver_destroy(client->server.message_receiver);
+	}
+
+	if (client->server.link != NULL)
+	{
+		link_destroy(client->server.link);
+	}
+
+	memory_pair_fixture_destroy(&client->fixture);
+
+	free(client->body);
+}
+
+static int send_messages(CLIENT* client)
+{
+	int result = 0;
+
+	while ((result == 0) &&
+		(client->messages_sent < MESSAGE_COUNT) &&
+		(client->outstanding_message_count < OUTSTANDING_MESSAGE_COUNT))
+	{
+		MESSAGE_HANDLE message = message_create();
+		if (message == NULL)
+		{
+			LogError("Error creating message");
+			result = __LINE__;
+		}
+		else
+		{
+			BINARY_DATA binary_data;
+			BODY_READER* body_reader = &client->body_readers[client->messages_sent];
+
+			binary_data.bytes = client->body;
+			binary_data.length = MESSAGE_SIZE;
+			body_reader->body = client->body;
+			body_reader->offset = 0;
+
+			client->outstanding_message_count++;
+
+			switch (client->send_mode)
+			{
+			default:
+			case SEND_MODE_COPIED:
+				result = ((message_add_body_amqp_data(message, binary_data) != 0) ||
+					(messagesender_send(client->message_sender, message, on_message_send_complete, client) != 0)) ? __LINE__ : 0;
+				break;
+
+			case SEND_MODE_BORROWED:
+				/* the body stays in client->body, which outlives the exchange */
+				result = (messagesender_send_borrowed_data(client->message_sender, message, &binary_data, 1, on_message_send_complete, client) != 0) ? __LINE__ : 0;
+				break;
+
+			case SEND_MODE_STREAMED:
+				result = (messagesender_send_streamed(client->message_sender, message, MESSAGE_SIZE, on_message_body_read, body_reader, on_message_send_complete, client) != 0) ? __LINE__ : 0;
+				break;
+			}
+
+			if (result != 0)
+			{
+				client->outstanding_message_count--;
+				LogError("Error sending message");
+			}
+			else
+			{
+				client->messages_sent++;
+			}
+
+			message_destroy(message);
+		}
+	}
+
+	return result;
+}
+
+static int run_exchange(const char* description, SEND_MODE send_mode, bool is_streaming, TICK_COUNTER_HANDLE tick_counter)
+{
+	int result;
+	CLIENT client;
+	MEMORY_PAIR_FIXTURE_CONFIG fixture_config;
+
+	(void)memset(&client, 0, sizeof(client));
+	client.send_mode = send_mode;
+	client.server.is_streaming = is_streaming;
+
+	fixture_config.server_max_frame_size = SERVER_MAX_FRAME_SIZE;
+	fixture_config.server_incoming_window = 0;
+	fixture_config.on_server_link_attached = on_new_link_attached;
+	fixture_config.on_server_link_attached_context = &client;
+
+	client.body = (unsigned char*)malloc(MESSAGE_SIZE);
+	if (client.body == NULL)
+	{
+		LogError("Cannot allocate message body");
+		result = __LINE__;
+	}
+	else if (((result = memory_pair_fixture_create(&client.fixture, &fixture_config)) == 0) &&
+		((result = create_client(&client)) == 0))
+	{
+		tickcounter_ms_t start_ms = 0;
+		tickcounter_ms_t current_ms = 0;
+		size_t i;
+
+		for (i = 0; i < MESSAGE_SIZE; i++)
+		{
+			client.body[i] = (unsigned char)i;
+		}
+
+		if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+		{
+			LogError("Cannot get tick counter value");
+			result = __LINE__;
+		}
+
+		current_ms = start_ms;
+
+		while ((result == 0) &&
+			(client.server.messages_received < MESSAGE_COUNT))
+		{
+			connection_dowork(client.fixture.client_connection);
+
+			result = send_messages(&client);
+			if ((result == 0) &&
+				client.is_send_failed)
+			{
+				LogError("Message send failed");
+				result = __LINE__;
+			}
+
+			connection_dowork(client.fixture.server_connection);
+
+			if ((result == 0) &&
+				(tickcounter_get_current_ms(tick_counter, &current_ms) != 0))
+			{
+				LogError("Cannot get tick counter value");
+				result = __LINE__;
+			}
+			else if ((result == 0) &&
+				(current_ms - start_ms > TEST_TIMEOUT))
+			{
+				LogError("Only %u of %u messages received in %u ms", (unsigned int)client.server.messages_received, (unsigned int)MESSAGE_COUNT, (unsigned int)TEST_TIMEOUT);
+				result = __LINE__;
+			}
+		}
+
+		if (result == 0)
+		{
+			double elapsed_seconds = ((double)current_ms - start_ms) / 1000;
+
+			if (client.server.is_message_truncated)
+			{
+				LogError("A message was not received whole");
+				result = __LINE__;
+			}
+			else
+			{
+				LogInfo("%s: %u messages of %u bytes in %.2f s, %.1f MB/s", description,
+					(unsigned int)MESSAGE_COUNT, (unsigned int)MESSAGE_SIZE, elapsed_seconds,
+					(elapsed_seconds == 0) ? 0.0 : ((double)MESSAGE_COUNT * MESSAGE_SIZE) / (1024 * 1024) / elapsed_seconds);
+				if (is_streaming)
+				{
+					LogInfo("Largest piece of body received: %u bytes", (unsigned int)client.server.largest_body_chunk);
+				}
+			}
+		}
+	}
+
+	destroy_client(&client);
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		TICK_COUNTER_HANDLE tick_counter = tickcounter_create();
+		if (tick_counter == NULL)
+		{
+			LogError("Cannot create tick counter");
+			result = __LINE__;
+		}
+		else
+		{
+			result = run_exchange("Reassembled", SEND_MODE_COPIED, false, tick_counter);
+			if (result == 0)
+			{
+				result = run_exchange("Streamed", SEND_MODE_COPIED, true, tick_counter);
+			}
+			if (result == 0)
+			{
+				result = run_exchange("Borrowed body send, reassembled", SEND_MODE_BORROWED, false, tick_counter);
+			}
+			if (result == 0)
+			{
+				result = run_exchange("Borrowed body send, streamed", SEND_MODE_BORROWED, true, tick_counter);
+			}
+			if (result == 0)
+			{
+				result = run_exchange("Streamed send, reassembled", SEND_MODE_STREAMED, false, tick_counter);
+			}
+			if (result == 0)
+			{
+				result = run_exchange("Streamed send, streamed", SEND_MODE_STREAMED, true, tick_counter);
+			}
+
+			tickcounter_destroy(tick_counter);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}
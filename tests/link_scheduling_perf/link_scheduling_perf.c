@@ -0,0 +1,372 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* LINK_COUNT sender links share one session and always have messages waiting, while the receiving session only opens a
+   window of SERVER_INCOMING_WINDOW transfers at a time, so the links compete for the session window. The exchange runs
+   once with equal weights and once with link_weights, and fails when a link's share of the messages received is more
+   than SHARE_TOLERANCE away from its share of the weights. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+#include "memory_pair_fixture/memory_pair_fixture.h"
+
+#define LINK_COUNT 3
+#define OUTSTANDING_MESSAGE_COUNT 200
+#define SERVER_INCOMING_WINDOW 64
+#define TEST_RUNTIME 3000 // ms
+#define SHARE_TOLERANCE 0.03
+
+static const uint32_t equal_weights[LINK_COUNT] = { 1, 1, 1 };
+static const uint32_t link_weights[LINK_COUNT] = { 1, 1, 2 };
+
+typedef struct SERVER_LINK_TAG
+{
+	LINK_HANDLE link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+	size_t messages_received;
+} SERVER_LINK;
+
+typedef struct CLIENT_LINK_TAG
+{
+	LINK_HANDLE link;
+	MESSAGE_SENDER_HANDLE message_sender;
+	size_t outstanding_message_count;
+	bool is_send_failed;
+} CLIENT_LINK;
+
+typedef struct CLIENT_TAG
+{
+	MEMORY_PAIR_FIXTURE fixture;
+	CLIENT_LINK links[LINK_COUNT];
+	SERVER_LINK server_links[LINK_COUNT];
+} CLIENT;
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	SERVER_LINK* server_link = (SERVER_LINK*)context;
+	(void)message;
+
+	server_link->messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	CLIENT* client = (CLIENT*)context;
+	unsigned int link_index;
+	bool result;
+
+	/* the client names its links sender-link-<index> */
+	if ((sscanf(name, "sender-link-%u", &link_index) != 1) ||
+		(link_index >= LINK_COUNT))
+	{
+		LogError("Unexpected link name %s", name);
+		result = false;
+	}
+	else
+	{
+		SERVER_LINK* server_link = &client->server_links[link_index];
+
+		server_link->link = memory_pair_fixture_create_receiver_link(&client->fixture, new_link_endpoint, name, role, source, target);
+		if (server_link->link == NULL)
+		{
+			result = false;
+		}
+		else
+		{
+			server_link->message_receiver = messagereceiver_create(server_link->link, NULL, NULL);
+			if (server_link->message_receiver == NULL)
+			{
+				LogError("Cannot create message receiver");
+				result = false;
+			}
+			else if (messagereceiver_open(server_link->message_receiver, on_message_received, server_link) != 0)
+			{
+				LogError("Cannot open message receiver");
+				result = false;
+			}
+			else
+			{
+				result = true;
+			}
+		}
+	}
+
+	return result;
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	CLIENT_LINK* client_link = (CLIENT_LINK*)context;
+
+	if (send_result != MESSAGE_SEND_OK)
+	{
+		client_link->is_send_failed = true;
+	}
+
+	client_link->outstanding_message_count--;
+}
+
+static int create_client_link(CLIENT* client, size_t link_index, uint32_t weight)
+{
+	int result;
+	CLIENT_LINK* client_link = &client->links[link_index];
+	char link_name[32];
+
+	(void)sprintf(link_name, "sender-link-%u", (unsigned int)link_index);
+
+	client_link->link = memory_pair_fixture_create_sender_link(&client->fixture, link_name, sender_settle_mode_settled);
+	if (client_link->link == NULL)
+	{
+		result = __LINE__;
+	}
+	else if (link_set_scheduling_weight(client_link->link, weight) != 0)
+	{
+		LogError("Cannot set link scheduling weight");
+		result = __LINE__;
+	}
+	else
+	{
+		client_link->message_sender = messagesender_create(client_link->link, NULL, NULL);
+		if ((client_link->message_sender == NULL) ||
+			(messagesender_open(client_link->message_sender) != 0))
+		{
+			LogError("Cannot open client message sender");
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static int create_client(CLIENT* client, const uint32_t* weights)
+{
+	int result = 0;
+	size_t i;
+
+	for (i = 0; (result == 0) && (i < LINK_COUNT); i++)
+	{
+		result = create_client_link(client, i, weights[i]);
+	}
+
+	return result;
+}
+
+static void destroy_client(CLIENT* client)
+{
+	size_t i;
+
+	for (i = 0; i < LINK_COUNT; i++)
+	{
+		if (client->links[i].message_sender != NULL)
+		{
+			messagesender_destroy(client->links[i].message_sender);
+		}
+
+		if (client->links[i].link != NULL)
+		{
+			link_destroy(client->links[i].link);
+		}
+
+		if (client->server_links[i].message_receiver != NULL)
+		{
+			messagereceiver_destroy(client->server_links[i].message_receiver);
+		}
+
+		if (client->server_links[i].link != NULL)
+		{
+			link_destroy(client->server_links[i].link);
+		}
+	}
+
+	memory_pair_fixture_destroy(&client->fixture);
+}
+
+static int send_messages(CLIENT_LINK* client_link)
+{
+	int result = 0;
+
+	while ((result == 0) &&
+		(client_link->outstanding_message_count < OUTSTANDING_MESSAGE_COUNT))
+	{
+		MESSAGE_HANDLE message = message_create();
+		if (message == NULL)
+		{
+			LogError("Error creating message");
+			result = __LINE__;
+		}
+		else
+		{
+			unsigned char hello[] = { 'H', 'e', 'l', 'l', 'o' };
+			BINARY_DATA binary_data;
+
+			binary_data.bytes = hello;
+			binary_data.length = sizeof(hello);
+
+			client_link->outstanding_message_count++;
+
+			if ((message_add_body_amqp_data(message, binary_data) != 0) ||
+				(messagesender_send(client_link->message_sender, message, on_message_send_complete, client_link) != 0))
+			{
+				client_link->outstanding_message_count--;
+				LogError("Error sending message");
+				result = __LINE__;
+			}
+
+			message_destroy(message);
+		}
+	}
+
+	return result;
+}
+
+static int check_shares(const CLIENT* client, const uint32_t* weights, double elapsed_seconds)
+{
+	int result = 0;
+	size_t total_messages_received = 0;
+	uint32_t total_weight = 0;
+	size_t i;
+
+	for (i = 0; i < LINK_COUNT; i++)
+	{
+		total_messages_received += client->server_links[i].messages_received;
+		total_weight += weights[i];
+	}
+
+	LogInfo("%.0f messages/s over %u links", total_messages_received / elapsed_seconds, (unsigned int)LINK_COUNT);
+
+	for (i = 0; i < LINK_COUNT; i++)
+	{
+		double expected_share = (double)weights[i] / total_weight;
+		double share = (total_messages_received == 0) ? 0.0 : (double)client->server_links[i].messages_received / total_messages_received;
+
+		LogInfo("  link %u, weight %u: %u messages, %.1f%% of them (expected %.1f%%)",
+			(unsigned int)i, (unsigned int)weights[i], (unsigned int)client->server_links[i].messages_received,
+			share * 100, expected_share * 100);
+
+		if ((share < expected_share - SHARE_TOLERANCE) ||
+			(share > expected_share + SHARE_TOLERANCE))
+		{
+			LogError("Link %u got %.1f%% of the messages instead of %.1f%%", (unsigned int)i, share * 100, expected_share * 100);
+			result = __LINE__;
+		}
+	}
+
+	return result;
+}
+
+static int run_exchange(const uint32_t* weights, TICK_COUNTER_HANDLE tick_counter)
+{
+	int result;
+	CLIENT client;
+	MEMORY_PAIR_FIXTURE_CONFIG fixture_config;
+
+	(void)memset(&client, 0, sizeof(client));
+
+	fixture_config.server_max_frame_size = 0;
+	fixture_config.server_incoming_window = SERVER_INCOMING_WINDOW;
+	fixture_config.on_server_link_attached = on_new_link_attached;
+	fixture_config.on_server_link_attached_context = &client;
+
+	if (((result = memory_pair_fixture_create(&client.fixture, &fixture_config)) == 0) &&
+		((result = create_client(&client, weights)) == 0))
+	{
+		tickcounter_ms_t start_ms = 0;
+		tickcounter_ms_t current_ms = 0;
+
+		if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+		{
+			LogError("Cannot get tick counter value");
+			result = __LINE__;
+		}
+
+		current_ms = start_ms;
+
+		while ((result == 0) &&
+			(current_ms - start_ms <= TEST_RUNTIME))
+		{
+			size_t i;
+
+			connection_dowork(client.fixture.client_connection);
+
+			/* the links are always offered messages in the same order, the first one does not get more for it */
+			for (i = 0; (result == 0) && (i < LINK_COUNT); i++)
+			{
+				result = send_messages(&client.links[i]);
+				if ((result == 0) &&
+					client.links[i].is_send_failed)
+				{
+					LogError("Message send failed");
+					result = __LINE__;
+				}
+			}
+
+			connection_dowork(client.fixture.server_connection);
+
+			if ((result == 0) &&
+				(tickcounter_get_current_ms(tick_counter, &current_ms) != 0))
+			{
+				LogError("Cannot get tick counter value");
+				result = __LINE__;
+			}
+		}
+
+		if (result == 0)
+		{
+			result = check_shares(&client, weights, ((double)current_ms - start_ms) / 1000);
+		}
+	}
+
+	destroy_client(&client);
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		TICK_COUNTER_HANDLE tick_counter = tickcounter_create();
+		if (tick_counter == NULL)
+		{
+			LogError("Cannot create tick counter");
+			result = __LINE__;
+		}
+		else
+		{
+			result = run_exchange(equal_weights, tick_counter);
+			if (result == 0)
+			{
+				result = run_exchange(link_weights, tick_counter);
+			}
+
+			tickcounter_destroy(tick_counter);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}
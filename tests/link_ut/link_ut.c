@@ -0,0 +1,1481 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static size_t calloc_count;
+
+static void* my_gballoc_calloc(size_t nmemb, size_t size)
+{
+    calloc_count++;
+    return calloc(nmemb, size);
+}
+
+static size_t realloc_count;
+static size_t largest_realloc_size;
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    realloc_count++;
+    if (size > largest_realloc_size)
+    {
+        largest_realloc_size = size;
+    }
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/session.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/link.h"
+
+#define TEST_SESSION_HANDLE				(SESSION_HANDLE)0x4242
+#define TEST_LINK_ENDPOINT				(LINK_ENDPOINT_HANDLE)0x4243
+#define TEST_TICK_COUNTER				(TICK_COUNTER_HANDLE)0x4244
+#define TEST_DELIVERY_STATE				(AMQP_VALUE)0x4245
+#define TEST_CLONED_AMQP_VALUE			(AMQP_VALUE)0x4246
+#define TEST_DISPOSITION				(DISPOSITION_HANDLE)0x4247
+#define TEST_ATTACH						(ATTACH_HANDLE)0x4248
+#define TEST_FLOW						(FLOW_HANDLE)0x4249
+#define TEST_TRANSFER					(TRANSFER_HANDLE)0x424A
+#define TEST_PERFORMATIVE				(AMQP_VALUE)0x5000
+#define TEST_MAX_DISPOSITIONS			16
+#define TEST_MAX_SETTLED_DELIVERIES		16
+#define TEST_LINK_CREDIT				16
+#define TEST_MAX_RECEIVED_PAYLOAD_SIZE	1024
+#define TEST_MAX_FRAME_SIZE				512
+#define TEST_TRANSFER_FRAME_OVERHEAD	32
+
+typedef struct TEST_DISPOSITION_RANGE_TAG
+{
+    delivery_number first;
+    delivery_number last;
+} TEST_DISPOSITION_RANGE;
+
+static tickcounter_ms_t test_current_ms;
+static delivery_number test_disposition_first;
+static delivery_number test_disposition_last;
+static TEST_DISPOSITION_RANGE sent_dispositions[TEST_MAX_DISPOSITIONS];
+static size_t sent_disposition_count;
+static int test_send_disposition_result;
+
+typedef enum TEST_PERFORMATIVE_TYPE_TAG
+{
+    TEST_PERFORMATIVE_ATTACH,
+    TEST_PERFORMATIVE_FLOW,
+    TEST_PERFORMATIVE_DISPOSITION,
+    TEST_PERFORMATIVE_TRANSFER
+} TEST_PERFORMATIVE_TYPE;
+
+/* a sender link attached through the session callbacks it registered */
+typedef struct TEST_SENDER_LINK_TAG
+{
+    LINK_HANDLE link;
+    ON_ENDPOINT_FRAME_RECEIVED frame_received;
+    void* frame_received_context;
+    delivery_number settled_delivery_ids[TEST_MAX_SETTLED_DELIVERIES];
+    size_t settled_delivery_count;
+} TEST_SENDER_LINK;
+
+/* a receiver link attached through the session callbacks it registered, with the deliveries it indicated */
+typedef struct TEST_RECEIVER_LINK_TAG
+{
+    LINK_HANDLE link;
+    ON_ENDPOINT_FRAME_RECEIVED frame_received;
+    void* frame_received_context;
+    size_t delivery_count;
+    unsigned char received_payload[TEST_MAX_RECEIVED_PAYLOAD_SIZE];
+    uint32_t received_payload_size;
+    /* when streaming, the chunks passed so far and the more flag of the last one */
+    size_t chunk_count;
+    bool last_chunk_more;
+} TEST_RECEIVER_LINK;
+
+static TEST_PERFORMATIVE_TYPE test_performative_type;
+static ON_ENDPOINT_FRAME_RECEIVED saved_frame_received;
+static ON_SESSION_STATE_CHANGED saved_on_session_state_changed;
+static void* saved_link_endpoint_context;
+/* delivery ids are given out by the session, to all of its links */
+static delivery_number next_session_delivery_id;
+static delivery_number test_received_first;
+static delivery_number test_received_last;
+static sequence_no test_flow_delivery_count;
+static bool test_transfer_more;
+static bool test_transfer_aborted;
+static delivery_number test_transfer_delivery_id;
+static uint32_t test_sent_flow_link_credit;
+static sequence_no test_sent_flow_delivery_count;
+static size_t sent_flow_count;
+static ON_SEND_COMPLETE saved_transfer_frame_on_send_complete;
+static void* saved_transfer_frame_callback_context;
+static uint32_t test_flow_link_credit;
+/* the flags the link set on the transfer frame it is about to send */
+static bool test_sent_transfer_more;
+static bool test_sent_transfer_aborted;
+/* like the session, the frames after the first one of a delivery carry its delivery id */
+static bool is_session_sending_delivery;
+static delivery_number session_sending_delivery_id;
+static SESSION_SEND_TRANSFER_RESULT test_send_transfer_frame_result;
+static size_t sent_transfer_frame_count;
+static bool last_sent_transfer_frame_aborted;
+static message_format test_sent_message_format;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = test_current_ms;
+    return 0;
+}
+
+static DISPOSITION_HANDLE my_disposition_create(role role_value, delivery_number first_value)
+{
+    (void)role_value;
+    test_disposition_first = first_value;
+    test_disposition_last = first_value;
+    return TEST_DISPOSITION;
+}
+
+static int my_disposition_set_last(DISPOSITION_HANDLE disposition, delivery_number last_value)
+{
+    (void)disposition;
+    test_disposition_last = last_value;
+    return 0;
+}
+
+static int my_session_send_disposition(LINK_ENDPOINT_HANDLE link_endpoint, DISPOSITION_HANDLE disposition)
+{
+    (void)link_endpoint;
+    (void)disposition;
+    if (test_send_disposition_result == 0)
+    {
+        ASSERT_IS_TRUE(sent_disposition_count < TEST_MAX_DISPOSITIONS);
+        sent_dispositions[sent_disposition_count].first = test_disposition_first;
+        sent_dispositions[sent_disposition_count].last = test_disposition_last;
+        sent_disposition_count++;
+    }
+    return test_send_disposition_result;
+}
+
+static bool my_is_attach_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (test_performative_type == TEST_PERFORMATIVE_ATTACH);
+}
+
+static bool my_is_flow_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (test_performative_type == TEST_PERFORMATIVE_FLOW);
+}
+
+static bool my_is_disposition_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (test_performative_type == TEST_PERFORMATIVE_DISPOSITION);
+}
+
+static bool my_is_transfer_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (test_performative_type == TEST_PERFORMATIVE_TRANSFER);
+}
+
+static int my_amqpvalue_get_attach(AMQP_VALUE value, ATTACH_HANDLE* attach_handle)
+{
+    (void)value;
+    *attach_handle = TEST_ATTACH;
+    return 0;
+}
+
+static int my_amqpvalue_get_flow(AMQP_VALUE value, FLOW_HANDLE* flow_handle)
+{
+    (void)value;
+    *flow_handle = TEST_FLOW;
+    return 0;
+}
+
+static int my_flow_get_link_credit(FLOW_HANDLE flow, uint32_t* link_credit_value)
+{
+    (void)flow;
+    *link_credit_value = test_flow_link_credit;
+    return 0;
+}
+
+static int my_flow_get_delivery_count(FLOW_HANDLE flow, sequence_no* delivery_count_value)
+{
+    (void)flow;
+    *delivery_count_value = test_flow_delivery_count;
+    return 0;
+}
+
+static int my_flow_set_link_credit(FLOW_HANDLE flow, uint32_t link_credit_value)
+{
+    (void)flow;
+    test_sent_flow_link_credit = link_credit_value;
+    return 0;
+}
+
+static int my_flow_set_delivery_count(FLOW_HANDLE flow, sequence_no delivery_count_value)
+{
+    (void)flow;
+    test_sent_flow_delivery_count = delivery_count_value;
+    return 0;
+}
+
+static int my_session_send_flow(LINK_ENDPOINT_HANDLE link_endpoint, FLOW_HANDLE flow)
+{
+    (void)link_endpoint;
+    (void)flow;
+    sent_flow_count++;
+    return 0;
+}
+
+static int my_amqpvalue_get_transfer(AMQP_VALUE value, TRANSFER_HANDLE* transfer_handle)
+{
+    (void)value;
+    *transfer_handle = TEST_TRANSFER;
+    return 0;
+}
+
+static int my_transfer_get_more(TRANSFER_HANDLE transfer, bool* more_value)
+{
+    (void)transfer;
+    *more_value = test_transfer_more;
+    return 0;
+}
+
+static int my_transfer_set_more(TRANSFER_HANDLE transfer, bool more_value)
+{
+    (void)transfer;
+    test_sent_transfer_more = more_value;
+    return 0;
+}
+
+static int my_transfer_set_message_format(TRANSFER_HANDLE transfer, message_format message_format_value)
+{
+    (void)transfer;
+    test_sent_message_format = message_format_value;
+    return 0;
+}
+
+/* the room a transfer frame leaves for payload, the message format encodes as uint0, smalluint or uint */
+static uint32_t get_transfer_frame_payload_size(message_format message_format_value)
+{
+    uint32_t message_format_size = (message_format_value == 0) ? 1 : ((message_format_value <= 0xFF) ? 2 : 5);
+    return TEST_MAX_FRAME_SIZE - TEST_TRANSFER_FRAME_OVERHEAD - message_format_size;
+}
+
+static int my_session_get_transfer_frame_payload_size(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, uint32_t* payload_size)
+{
+    (void)link_endpoint;
+    (void)transfer;
+    *payload_size = get_transfer_frame_payload_size(test_sent_message_format);
+    return 0;
+}
+
+static int my_transfer_set_aborted(TRANSFER_HANDLE transfer, bool aborted_value)
+{
+    (void)transfer;
+    test_sent_transfer_aborted = aborted_value;
+    return 0;
+}
+
+static int my_transfer_get_aborted(TRANSFER_HANDLE transfer, bool* aborted_value)
+{
+    (void)transfer;
+    *aborted_value = test_transfer_aborted;
+    return 0;
+}
+
+static int my_transfer_get_delivery_id(TRANSFER_HANDLE transfer, delivery_number* delivery_id_value)
+{
+    (void)transfer;
+    *delivery_id_value = test_transfer_delivery_id;
+    return 0;
+}
+
+static int my_amqpvalue_get_disposition(AMQP_VALUE value, DISPOSITION_HANDLE* disposition_handle)
+{
+    (void)value;
+    *disposition_handle = TEST_DISPOSITION;
+    return 0;
+}
+
+static int my_disposition_get_first(DISPOSITION_HANDLE disposition, delivery_number* first_value)
+{
+    (void)disposition;
+    *first_value = test_received_first;
+    return 0;
+}
+
+static int my_disposition_get_last(DISPOSITION_HANDLE disposition, delivery_number* last_value)
+{
+    (void)disposition;
+    *last_value = test_received_last;
+    return 0;
+}
+
+static int my_disposition_get_settled(DISPOSITION_HANDLE disposition, bool* settled_value)
+{
+    (void)disposition;
+    *settled_value = true;
+    return 0;
+}
+
+static int my_disposition_get_state(DISPOSITION_HANDLE disposition, AMQP_VALUE* state_value)
+{
+    (void)disposition;
+    *state_value = TEST_DELIVERY_STATE;
+    return 0;
+}
+
+static int my_session_start_link_endpoint(LINK_ENDPOINT_HANDLE link_endpoint, ON_ENDPOINT_FRAME_RECEIVED frame_received_callback, ON_SESSION_STATE_CHANGED on_session_state_changed, ON_SESSION_FLOW_ON on_session_flow_on, void* context)
+{
+    (void)link_endpoint;
+    (void)on_session_flow_on;
+    saved_frame_received = frame_received_callback;
+    saved_on_session_state_changed = on_session_state_changed;
+    saved_link_endpoint_context = context;
+    return 0;
+}
+
+static SESSION_SEND_TRANSFER_RESULT my_session_send_transfer(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, PAYLOAD* payloads, size_t payload_count, delivery_number* delivery_id, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)link_endpoint;
+    (void)transfer;
+    (void)payloads;
+    (void)payload_count;
+    (void)on_send_complete;
+    (void)callback_context;
+    *delivery_id = next_session_delivery_id++;
+    return SESSION_SEND_TRANSFER_OK;
+}
+
+static SESSION_SEND_TRANSFER_RESULT my_session_send_transfer_frame(LINK_ENDPOINT_HANDLE link_endpoint, TRANSFER_HANDLE transfer, PAYLOAD* payloads, size_t payload_count, delivery_number* delivery_id, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    size_t payload_size = 0;
+    size_t i;
+    (void)link_endpoint;
+    (void)transfer;
+    for (i = 0; i < payload_count; i++)
+    {
+        payload_size += payloads[i].length;
+    }
+
+    if (payload_size > get_transfer_frame_payload_size(test_sent_message_format))
+    {
+        /* does not fit in the frame */
+        return SESSION_SEND_TRANSFER_ERROR;
+    }
+
+    if (test_send_transfer_frame_result == SESSION_SEND_TRANSFER_OK)
+    {
+        if (!is_session_sending_delivery)
+        {
+            session_sending_delivery_id = next_session_delivery_id++;
+        }
+        *delivery_id = session_sending_delivery_id;
+        is_session_sending_delivery = test_sent_transfer_more && !test_sent_transfer_aborted;
+        last_sent_transfer_frame_aborted = test_sent_transfer_aborted;
+        test_sent_transfer_aborted = false;
+        sent_transfer_frame_count++;
+        saved_transfer_frame_on_send_complete = on_send_complete;
+        saved_transfer_frame_callback_context = callback_context;
+    }
+    return test_send_transfer_frame_result;
+}
+
+static void test_on_link_flow_on(void* context)
+{
+    (void)context;
+}
+
+static void test_on_delivery_settled(void* context, delivery_number delivery_no, LINK_DELIVERY_SETTLE_REASON reason, AMQP_VALUE delivery_state)
+{
+    TEST_SENDER_LINK* test_sender_link = (TEST_SENDER_LINK*)context;
+    (void)reason;
+    (void)delivery_state;
+    ASSERT_IS_TRUE(test_sender_link->settled_delivery_count < TEST_MAX_SETTLED_DELIVERIES);
+    test_sender_link->settled_delivery_ids[test_sender_link->settled_delivery_count++] = delivery_no;
+}
+
+static AMQP_VALUE test_on_transfer_received(void* context, TRANSFER_HANDLE transfer, uint32_t payload_size, const unsigned char* payload_bytes)
+{
+    TEST_RECEIVER_LINK* test_receiver_link = (TEST_RECEIVER_LINK*)context;
+    (void)transfer;
+    ASSERT_IS_TRUE(payload_size <= TEST_MAX_RECEIVED_PAYLOAD_SIZE);
+    (void)memcpy(test_receiver_link->received_payload, payload_bytes, payload_size);
+    test_receiver_link->received_payload_size = payload_size;
+    test_receiver_link->delivery_count++;
+    return NULL;
+}
+
+/* appends the chunk to the received payload, which the last chunk of a delivery indicates */
+static AMQP_VALUE test_on_transfer_chunk_received(void* context, TRANSFER_HANDLE transfer, uint32_t payload_size, const unsigned char* payload_bytes, bool more)
+{
+    TEST_RECEIVER_LINK* test_receiver_link = (TEST_RECEIVER_LINK*)context;
+    (void)transfer;
+    ASSERT_IS_TRUE(test_receiver_link->received_payload_size + payload_size <= TEST_MAX_RECEIVED_PAYLOAD_SIZE);
+    if (payload_size > 0)
+    {
+        (void)memcpy(test_receiver_link->received_payload + test_receiver_link->received_payload_size, payload_bytes, payload_size);
+        test_receiver_link->received_payload_size += payload_size;
+    }
+    test_receiver_link->chunk_count++;
+    test_receiver_link->last_chunk_more = more;
+    if (!more)
+    {
+        test_receiver_link->delivery_count++;
+    }
+    return NULL;
+}
+
+static void receive_performative(TEST_SENDER_LINK* test_sender_link, TEST_PERFORMATIVE_TYPE performative_type)
+{
+    test_performative_type = performative_type;
+    test_sender_link->frame_received(test_sender_link->frame_received_context, TEST_PERFORMATIVE, 0, NULL);
+}
+
+static void receive_disposition(TEST_SENDER_LINK* test_sender_link, delivery_number first, delivery_number last)
+{
+    test_received_first = first;
+    test_received_last = last;
+    receive_performative(test_sender_link, TEST_PERFORMATIVE_DISPOSITION);
+}
+
+/* attaches the link and grants it test_flow_link_credit, TEST_LINK_CREDIT unless the test changed it */
+static void create_attached_sender_link(TEST_SENDER_LINK* test_sender_link, const char* name)
+{
+    test_sender_link->settled_delivery_count = 0;
+    test_sender_link->link = link_create(TEST_SESSION_HANDLE, name, role_sender, NULL, NULL);
+    ASSERT_IS_NOT_NULL(test_sender_link->link);
+    ASSERT_ARE_EQUAL(int, 0, link_attach(test_sender_link->link, NULL, NULL, test_on_link_flow_on, NULL));
+    test_sender_link->frame_received = saved_frame_received;
+    test_sender_link->frame_received_context = saved_link_endpoint_context;
+
+    saved_on_session_state_changed(saved_link_endpoint_context, SESSION_STATE_MAPPED, SESSION_STATE_BEGIN_SENT);
+    receive_performative(test_sender_link, TEST_PERFORMATIVE_ATTACH);
+    receive_performative(test_sender_link, TEST_PERFORMATIVE_FLOW);
+}
+
+static void transfer(TEST_SENDER_LINK* test_sender_link)
+{
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer(test_sender_link->link, 0, NULL, 0, test_on_delivery_settled, test_sender_link));
+}
+
+/* attaches the link with a credit window of prefetch_count, topped up once it falls under refill_threshold */
+static void create_attached_receiver_link(TEST_RECEIVER_LINK* test_receiver_link, uint32_t prefetch_count, uint32_t refill_threshold)
+{
+    test_receiver_link->delivery_count = 0;
+    test_receiver_link->received_payload_size = 0;
+    test_receiver_link->chunk_count = 0;
+    test_receiver_link->last_chunk_more = false;
+    test_receiver_link->link = link_create(TEST_SESSION_HANDLE, "receiver", role_receiver, NULL, NULL);
+    ASSERT_IS_NOT_NULL(test_receiver_link->link);
+    ASSERT_ARE_EQUAL(int, 0, link_set_credit_policy(test_receiver_link->link, prefetch_count, refill_threshold, 0));
+    ASSERT_ARE_EQUAL(int, 0, link_attach(test_receiver_link->link, test_on_transfer_received, NULL, NULL, test_receiver_link));
+    test_receiver_link->frame_received = saved_frame_received;
+    test_receiver_link->frame_received_context = saved_link_endpoint_context;
+
+    saved_on_session_state_changed(saved_link_endpoint_context, SESSION_STATE_MAPPED, SESSION_STATE_BEGIN_SENT);
+    test_performative_type = TEST_PERFORMATIVE_ATTACH;
+    test_receiver_link->frame_received(test_receiver_link->frame_received_context, TEST_PERFORMATIVE, 0, NULL);
+}
+
+static void receive_transfer(TEST_RECEIVER_LINK* test_receiver_link, delivery_number delivery_id, bool more, const unsigned char* payload_bytes, uint32_t payload_size)
+{
+    test_performative_type = TEST_PERFORMATIVE_TRANSFER;
+    test_transfer_delivery_id = delivery_id;
+    test_transfer_more = more;
+    test_receiver_link->frame_received(test_receiver_link->frame_received_context, TEST_PERFORMATIVE, payload_size, payload_bytes);
+}
+
+static LINK_HANDLE create_batching_receiver_link(uint32_t max_batch_count, milliseconds max_delay)
+{
+    LINK_HANDLE result = link_create(TEST_SESSION_HANDLE, "test_link", role_receiver, NULL, NULL);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, 0, link_set_disposition_batching(result, max_batch_count, max_delay));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(link_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, my_gballoc_calloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_clone, TEST_CLONED_AMQP_VALUE);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_are_equal, true);
+    REGISTER_GLOBAL_MOCK_RETURN(session_create_link_endpoint, TEST_LINK_ENDPOINT);
+    REGISTER_GLOBAL_MOCK_HOOK(session_send_disposition, my_session_send_disposition);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_create, my_disposition_create);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_set_last, my_disposition_set_last);
+    REGISTER_GLOBAL_MOCK_HOOK(session_start_link_endpoint, my_session_start_link_endpoint);
+    REGISTER_GLOBAL_MOCK_HOOK(session_send_transfer, my_session_send_transfer);
+    REGISTER_GLOBAL_MOCK_HOOK(session_send_transfer_frame, my_session_send_transfer_frame);
+    REGISTER_GLOBAL_MOCK_RETURN(attach_create, TEST_ATTACH);
+    REGISTER_GLOBAL_MOCK_RETURN(transfer_create, TEST_TRANSFER);
+    REGISTER_GLOBAL_MOCK_HOOK(is_attach_type_by_descriptor, my_is_attach_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_flow_type_by_descriptor, my_is_flow_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_disposition_type_by_descriptor, my_is_disposition_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_transfer_type_by_descriptor, my_is_transfer_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_attach, my_amqpvalue_get_attach);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_flow, my_amqpvalue_get_flow);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_get_link_credit, my_flow_get_link_credit);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_get_delivery_count, my_flow_get_delivery_count);
+    REGISTER_GLOBAL_MOCK_RETURN(flow_create, TEST_FLOW);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_set_link_credit, my_flow_set_link_credit);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_set_delivery_count, my_flow_set_delivery_count);
+    REGISTER_GLOBAL_MOCK_HOOK(session_send_flow, my_session_send_flow);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_transfer, my_amqpvalue_get_transfer);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_more, my_transfer_get_more);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_aborted, my_transfer_get_aborted);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_set_more, my_transfer_set_more);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_set_aborted, my_transfer_set_aborted);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_set_message_format, my_transfer_set_message_format);
+    REGISTER_GLOBAL_MOCK_HOOK(session_get_transfer_frame_payload_size, my_session_get_transfer_frame_payload_size);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_delivery_id, my_transfer_get_delivery_id);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_disposition, my_amqpvalue_get_disposition);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_get_first, my_disposition_get_first);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_get_last, my_disposition_get_last);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_get_settled, my_disposition_get_settled);
+    REGISTER_GLOBAL_MOCK_HOOK(disposition_get_state, my_disposition_get_state);
+
+    REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_ENDPOINT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DISPOSITION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ATTACH_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(FLOW_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_ENDPOINT_FRAME_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SESSION_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SESSION_FLOW_ON, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SESSION_SEND_TRANSFER_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(role, bool);
+    REGISTER_UMOCK_ALIAS_TYPE(delivery_number, uint32_t);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    test_current_ms = 0;
+    sent_disposition_count = 0;
+    test_send_disposition_result = 0;
+    calloc_count = 0;
+    next_session_delivery_id = 0;
+    test_flow_delivery_count = 0;
+    realloc_count = 0;
+    largest_realloc_size = 0;
+    sent_flow_count = 0;
+    test_transfer_aborted = false;
+    saved_transfer_frame_on_send_complete = NULL;
+    saved_transfer_frame_callback_context = NULL;
+    test_flow_link_credit = TEST_LINK_CREDIT;
+    test_sent_transfer_more = false;
+    test_sent_transfer_aborted = false;
+    is_session_sending_delivery = false;
+    test_send_transfer_frame_result = SESSION_SEND_TRANSFER_OK;
+    sent_transfer_frame_count = 0;
+    last_sent_transfer_frame_aborted = false;
+    test_sent_message_format = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* link_send_disposition */
+
+TEST_FUNCTION(link_send_disposition_without_batching_sends_each_disposition)
+{
+    // arrange
+    LINK_HANDLE link = create_batching_receiver_link(1, 0);
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 0, TEST_DELIVERY_STATE));
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 1, TEST_DELIVERY_STATE));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_dispositions[0].first);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_dispositions[0].last);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_dispositions[1].first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_dispositions[1].last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_send_disposition_sends_the_batch_once_it_holds_max_batch_count_deliveries)
+{
+    // arrange
+    LINK_HANDLE link = create_batching_receiver_link(3, 0);
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 0, TEST_DELIVERY_STATE));
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 1, TEST_DELIVERY_STATE));
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 2, TEST_DELIVERY_STATE));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_dispositions[0].first);
+    ASSERT_ARE_EQUAL(uint32_t, 2, sent_dispositions[0].last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_send_disposition_for_a_delivery_that_does_not_extend_the_batch_sends_the_batch)
+{
+    // arrange
+    LINK_HANDLE link = create_batching_receiver_link(10, 0);
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 0, TEST_DELIVERY_STATE));
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 1, TEST_DELIVERY_STATE));
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 3, TEST_DELIVERY_STATE));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_dispositions[0].first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_dispositions[0].last);
+
+    ASSERT_ARE_EQUAL(int, 0, link_flush_dispositions(link));
+    ASSERT_ARE_EQUAL(size_t, 2, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 3, sent_dispositions[1].first);
+    ASSERT_ARE_EQUAL(uint32_t, 3, sent_dispositions[1].last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_send_disposition_sends_the_batch_with_the_delivery_that_finds_it_older_than_max_delay)
+{
+    // arrange
+    LINK_HANDLE link = create_batching_receiver_link(10, 100);
+    test_current_ms = 1000;
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 0, TEST_DELIVERY_STATE));
+    test_current_ms = 1099;
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 1, TEST_DELIVERY_STATE));
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+    test_current_ms = 1100;
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 2, TEST_DELIVERY_STATE));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_dispositions[0].first);
+    ASSERT_ARE_EQUAL(uint32_t, 2, sent_dispositions[0].last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_send_disposition_queues_the_delivery_when_sending_the_batch_it_does_not_extend_fails)
+{
+    // arrange
+    LINK_HANDLE link = create_batching_receiver_link(10, 0);
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 0, TEST_DELIVERY_STATE));
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 1, TEST_DELIVERY_STATE));
+    test_send_disposition_result = 1;
+
+    // act
+    ASSERT_ARE_NOT_EQUAL(int, 0, link_send_disposition(link, 3, TEST_DELIVERY_STATE));
+
+    // assert
+    test_send_disposition_result = 0;
+    ASSERT_ARE_EQUAL(int, 0, link_flush_dispositions(link));
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 3, sent_dispositions[0].first);
+    ASSERT_ARE_EQUAL(uint32_t, 3, sent_dispositions[0].last);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(a_transfer_frame_that_settles_nothing_sends_the_batch_once_it_is_older_than_max_delay)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    const unsigned char payload_bytes[] = { 0x42 };
+    create_attached_receiver_link(&receiver, 16, 8);
+    ASSERT_ARE_EQUAL(int, 0, link_set_disposition_batching(receiver.link, 10, 100));
+    test_current_ms = 1000;
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(receiver.link, 0, TEST_DELIVERY_STATE));
+    test_current_ms = 1100;
+
+    // act
+    receive_transfer(&receiver, 1, true, payload_bytes, sizeof(payload_bytes));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_dispositions[0].first);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_dispositions[0].last);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+/* link_dowork */
+
+TEST_FUNCTION(link_dowork_sends_the_batch_once_it_is_older_than_max_delay)
+{
+    // arrange
+    LINK_HANDLE link = create_batching_receiver_link(10, 100);
+    test_current_ms = 1000;
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 0, TEST_DELIVERY_STATE));
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 1, TEST_DELIVERY_STATE));
+    test_current_ms = 1099;
+    link_dowork(link);
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+    test_current_ms = 1100;
+
+    // act
+    link_dowork(link);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sent_dispositions[0].first);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sent_dispositions[0].last);
+
+    /* nothing is left to send */
+    test_current_ms = 5000;
+    link_dowork(link);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_disposition_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_dowork_does_not_send_the_batch_when_max_delay_is_0)
+{
+    // arrange
+    LINK_HANDLE link = create_batching_receiver_link(10, 0);
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 0, TEST_DELIVERY_STATE));
+    test_current_ms = 1000000;
+
+    // act
+    link_dowork(link);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_dowork_does_not_send_the_batch_when_max_delay_was_set_back_to_0)
+{
+    // arrange
+    LINK_HANDLE link = create_batching_receiver_link(10, 100);
+    ASSERT_ARE_EQUAL(int, 0, link_set_disposition_batching(link, 10, 0));
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 0, TEST_DELIVERY_STATE));
+    test_current_ms = 1000000;
+
+    // act
+    link_dowork(link);
+    ASSERT_ARE_EQUAL(int, 0, link_send_disposition(link, 1, TEST_DELIVERY_STATE));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_dowork_with_NULL_link_does_not_crash)
+{
+    // arrange
+
+    // act
+    link_dowork(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, sent_disposition_count);
+}
+
+/* link_transfer */
+
+TEST_FUNCTION(deliveries_of_another_link_on_the_session_do_not_grow_the_pending_deliveries_of_a_link)
+{
+    // arrange
+    TEST_SENDER_LINK sender_1;
+    TEST_SENDER_LINK sender_2;
+    size_t i;
+    create_attached_sender_link(&sender_1, "sender_1");
+    create_attached_sender_link(&sender_2, "sender_2");
+
+    /* sender_1 holds delivery 0 unsettled while sender_2 goes through many more than the credit window */
+    transfer(&sender_1);
+    for (i = 0; i < TEST_LINK_CREDIT * 100; i++)
+    {
+        transfer(&sender_2);
+        receive_disposition(&sender_2, next_session_delivery_id - 1, next_session_delivery_id - 1);
+        sender_2.settled_delivery_count = 0;
+        test_flow_delivery_count = (sequence_no)(i + 1);
+        receive_performative(&sender_2, TEST_PERFORMATIVE_FLOW);
+    }
+    calloc_count = 0;
+
+    // act
+    transfer(&sender_1);
+
+    // assert
+    /* the second delivery goes in the slot after the first one, in the ring allocated for the credit */
+    ASSERT_ARE_EQUAL(size_t, 0, calloc_count);
+    receive_disposition(&sender_1, 0, next_session_delivery_id - 1);
+    ASSERT_ARE_EQUAL(size_t, 2, sender_1.settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sender_1.settled_delivery_ids[0]);
+    ASSERT_ARE_EQUAL(uint32_t, next_session_delivery_id - 1, sender_1.settled_delivery_ids[1]);
+    ASSERT_ARE_EQUAL(size_t, 0, sender_2.settled_delivery_count);
+
+    // cleanup
+    link_destroy(sender_1.link);
+    link_destroy(sender_2.link);
+}
+
+TEST_FUNCTION(a_disposition_settles_only_the_deliveries_of_its_link_in_its_range)
+{
+    // arrange
+    TEST_SENDER_LINK sender_1;
+    TEST_SENDER_LINK sender_2;
+    size_t i;
+    create_attached_sender_link(&sender_1, "sender_1");
+    create_attached_sender_link(&sender_2, "sender_2");
+
+    /* interleaved, and wrapping past 0: sender_1 gets 0xFFFFFFFC, 0xFFFFFFFE, 0, 2 and sender_2 the ids in between */
+    next_session_delivery_id = 0xFFFFFFFC;
+    for (i = 0; i < 4; i++)
+    {
+        transfer(&sender_1);
+        transfer(&sender_2);
+    }
+
+    // act
+    receive_disposition(&sender_1, 0xFFFFFFFD, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, sender_1.settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0xFFFFFFFE, sender_1.settled_delivery_ids[0]);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sender_1.settled_delivery_ids[1]);
+    ASSERT_ARE_EQUAL(size_t, 0, sender_2.settled_delivery_count);
+
+    /* the ones left on either side of the range are still pending */
+    receive_disposition(&sender_1, 0xFFFFFFFC, 3);
+    ASSERT_ARE_EQUAL(size_t, 4, sender_1.settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0xFFFFFFFC, sender_1.settled_delivery_ids[2]);
+    ASSERT_ARE_EQUAL(uint32_t, 2, sender_1.settled_delivery_ids[3]);
+
+    // cleanup
+    link_destroy(sender_1.link);
+    link_destroy(sender_2.link);
+}
+
+TEST_FUNCTION(a_disposition_for_deliveries_the_link_did_not_send_settles_nothing)
+{
+    // arrange
+    TEST_SENDER_LINK sender_1;
+    TEST_SENDER_LINK sender_2;
+    create_attached_sender_link(&sender_1, "sender_1");
+    create_attached_sender_link(&sender_2, "sender_2");
+    transfer(&sender_1);
+    transfer(&sender_2);
+    transfer(&sender_2);
+    transfer(&sender_1);
+
+    // act
+    receive_disposition(&sender_1, 1, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, sender_1.settled_delivery_count);
+
+    // cleanup
+    link_destroy(sender_1.link);
+    link_destroy(sender_2.link);
+}
+
+/* link_transfer_frame */
+
+TEST_FUNCTION(a_settled_delivery_sent_by_frames_without_on_delivery_settled_is_not_tracked)
+{
+    // arrange
+    TEST_SENDER_LINK sender;
+    LINK_TRANSFER_RESULT result;
+    create_attached_sender_link(&sender, "sender");
+    ASSERT_ARE_EQUAL(int, 0, link_set_snd_settle_mode(sender.link, sender_settle_mode_settled));
+    calloc_count = 0;
+
+    // act
+    result = link_transfer_frame(sender.link, 0, NULL, 0, false, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)result);
+    /* no send completion to wait for and no pending delivery slot */
+    ASSERT_IS_NULL(saved_transfer_frame_on_send_complete);
+    ASSERT_ARE_EQUAL(size_t, 0, calloc_count);
+
+    // cleanup
+    link_destroy(sender.link);
+}
+
+TEST_FUNCTION(the_send_completion_of_a_settled_delivery_sent_by_frames_after_an_untracked_one_settles_it)
+{
+    // arrange
+    TEST_SENDER_LINK sender;
+    create_attached_sender_link(&sender, "sender");
+    ASSERT_ARE_EQUAL(int, 0, link_set_snd_settle_mode(sender.link, sender_settle_mode_settled));
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, false, NULL, NULL));
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, false, test_on_delivery_settled, &sender));
+    ASSERT_IS_NOT_NULL(saved_transfer_frame_on_send_complete);
+    ASSERT_ARE_EQUAL(size_t, 0, sender.settled_delivery_count);
+
+    // act
+    saved_transfer_frame_on_send_complete(saved_transfer_frame_callback_context, IO_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sender.settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 1, sender.settled_delivery_ids[0]);
+
+    // cleanup
+    link_destroy(sender.link);
+}
+
+TEST_FUNCTION(a_delivery_sent_by_frames_takes_one_delivery_id_and_credit_only_on_its_first_frame)
+{
+    // arrange
+    TEST_SENDER_LINK sender;
+    test_flow_link_credit = 1;
+    create_attached_sender_link(&sender, "sender");
+
+    // act
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, true, test_on_delivery_settled, &sender));
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, true, test_on_delivery_settled, &sender));
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, false, test_on_delivery_settled, &sender));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, sent_transfer_frame_count);
+    ASSERT_ARE_EQUAL(uint32_t, 1, next_session_delivery_id);
+    /* the one credit went to the first frame, the next delivery has to wait for more */
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_BUSY, (int)link_transfer_frame(sender.link, 0, NULL, 0, false, test_on_delivery_settled, &sender));
+    receive_disposition(&sender, 0, 0);
+    ASSERT_ARE_EQUAL(size_t, 1, sender.settled_delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 0, sender.settled_delivery_ids[0]);
+
+    // cleanup
+    link_destroy(sender.link);
+}
+
+TEST_FUNCTION(link_transfer_while_a_delivery_is_being_sent_by_frames_is_busy)
+{
+    // arrange
+    TEST_SENDER_LINK sender;
+    LINK_TRANSFER_RESULT result;
+    create_attached_sender_link(&sender, "sender");
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, true, test_on_delivery_settled, &sender));
+
+    // act
+    result = link_transfer(sender.link, 0, NULL, 0, test_on_delivery_settled, &sender);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_BUSY, (int)result);
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, false, test_on_delivery_settled, &sender));
+    transfer(&sender);
+
+    // cleanup
+    link_destroy(sender.link);
+}
+
+TEST_FUNCTION(a_frame_the_session_is_busy_for_takes_no_credit_and_can_be_sent_again)
+{
+    // arrange
+    TEST_SENDER_LINK sender;
+    test_flow_link_credit = 1;
+    create_attached_sender_link(&sender, "sender");
+    test_send_transfer_frame_result = SESSION_SEND_TRANSFER_BUSY;
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_BUSY, (int)link_transfer_frame(sender.link, 0, NULL, 0, true, test_on_delivery_settled, &sender));
+    test_send_transfer_frame_result = SESSION_SEND_TRANSFER_OK;
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, true, test_on_delivery_settled, &sender));
+    test_send_transfer_frame_result = SESSION_SEND_TRANSFER_BUSY;
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_BUSY, (int)link_transfer_frame(sender.link, 0, NULL, 0, false, test_on_delivery_settled, &sender));
+    test_send_transfer_frame_result = SESSION_SEND_TRANSFER_OK;
+
+    // act
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, false, test_on_delivery_settled, &sender));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, sent_transfer_frame_count);
+    ASSERT_ARE_EQUAL(uint32_t, 1, next_session_delivery_id);
+    receive_disposition(&sender, 0, 0);
+    ASSERT_ARE_EQUAL(size_t, 1, sender.settled_delivery_count);
+
+    // cleanup
+    link_destroy(sender.link);
+}
+
+TEST_FUNCTION(a_first_frame_filled_to_the_reported_payload_size_with_a_non_zero_message_format_fits_in_the_frame)
+{
+    // arrange
+    TEST_SENDER_LINK sender;
+    unsigned char payload_bytes[TEST_MAX_FRAME_SIZE];
+    PAYLOAD payload;
+    uint32_t payload_size;
+    LINK_TRANSFER_RESULT result;
+    create_attached_sender_link(&sender, "sender");
+    ASSERT_ARE_EQUAL(int, 0, link_get_transfer_frame_payload_size(sender.link, &payload_size));
+    (void)memset(payload_bytes, 0x42, sizeof(payload_bytes));
+    payload.bytes = payload_bytes;
+    payload.length = payload_size;
+
+    // act
+    result = link_transfer_frame(sender.link, 0x80013700, &payload, 1, true, test_on_delivery_settled, &sender);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_transfer_frame_count);
+
+    // cleanup
+    link_destroy(sender.link);
+}
+
+/* link_abort_transfer */
+
+TEST_FUNCTION(link_abort_transfer_with_NULL_link_fails)
+{
+    // arrange
+
+    // act
+    int result = link_abort_transfer(NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(link_abort_transfer_when_no_delivery_is_being_sent_fails)
+{
+    // arrange
+    TEST_SENDER_LINK sender;
+    int result;
+    create_attached_sender_link(&sender, "sender");
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, false, test_on_delivery_settled, &sender));
+
+    // act
+    result = link_abort_transfer(sender.link);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_transfer_frame_count);
+
+    // cleanup
+    link_destroy(sender.link);
+}
+
+TEST_FUNCTION(link_abort_transfer_sends_an_aborted_last_frame_and_the_delivery_is_forgotten)
+{
+    // arrange
+    TEST_SENDER_LINK sender;
+    int result;
+    create_attached_sender_link(&sender, "sender");
+    ASSERT_ARE_EQUAL(int, (int)LINK_TRANSFER_OK, (int)link_transfer_frame(sender.link, 0, NULL, 0, true, test_on_delivery_settled, &sender));
+
+    // act
+    result = link_abort_transfer(sender.link);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 2, sent_transfer_frame_count);
+    ASSERT_IS_TRUE(last_sent_transfer_frame_aborted);
+    ASSERT_IS_FALSE(test_sent_transfer_more);
+    ASSERT_ARE_EQUAL(uint32_t, 1, next_session_delivery_id);
+    /* nothing is pending for it and the link can send again */
+    receive_disposition(&sender, 0, 0);
+    ASSERT_ARE_EQUAL(size_t, 0, sender.settled_delivery_count);
+    transfer(&sender);
+    ASSERT_ARE_EQUAL(uint32_t, 2, next_session_delivery_id);
+
+    // cleanup
+    link_destroy(sender.link);
+}
+
+/* receiving transfers */
+
+TEST_FUNCTION(the_frames_of_a_multi_frame_delivery_are_indicated_as_one_payload)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    const unsigned char frame_1[] = { 'a', 'b', 'c' };
+    const unsigned char frame_2[] = { 'd', 'e', 'f' };
+    const unsigned char frame_3[] = { 'g', 'h' };
+    create_attached_receiver_link(&receiver, TEST_LINK_CREDIT, 0);
+
+    // act
+    receive_transfer(&receiver, 0, true, frame_1, sizeof(frame_1));
+    receive_transfer(&receiver, 0, true, frame_2, sizeof(frame_2));
+    ASSERT_ARE_EQUAL(size_t, 0, receiver.delivery_count);
+    receive_transfer(&receiver, 0, false, frame_3, sizeof(frame_3));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, receiver.delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 8, receiver.received_payload_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(receiver.received_payload, "abcdefgh", 8));
+
+    /* the next delivery starts from an empty buffer */
+    receive_transfer(&receiver, 1, false, frame_3, sizeof(frame_3));
+    ASSERT_ARE_EQUAL(size_t, 2, receiver.delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 2, receiver.received_payload_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(receiver.received_payload, "gh", 2));
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+TEST_FUNCTION(the_buffer_of_a_multi_frame_delivery_doubles_up_to_the_max_message_size)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    unsigned char frame[100];
+    size_t i;
+    create_attached_receiver_link(&receiver, TEST_LINK_CREDIT, 0);
+    ASSERT_ARE_EQUAL(int, 0, link_set_max_message_size(receiver.link, 1000));
+    (void)memset(frame, 'x', sizeof(frame));
+    realloc_count = 0;
+    largest_realloc_size = 0;
+
+    // act
+    for (i = 0; i < 10; i++)
+    {
+        receive_transfer(&receiver, 0, (i < 9), frame, sizeof(frame));
+    }
+
+    // assert
+    /* 200, 400, 800 and then 1000 rather than 1600 */
+    ASSERT_ARE_EQUAL(size_t, 4, realloc_count);
+    ASSERT_ARE_EQUAL(size_t, 1000, largest_realloc_size);
+    ASSERT_ARE_EQUAL(size_t, 1, receiver.delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 1000, receiver.received_payload_size);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+TEST_FUNCTION(the_credit_of_a_receiver_link_is_taken_once_per_delivery_and_not_per_frame)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    const unsigned char frame[] = { 'a' };
+    create_attached_receiver_link(&receiver, 4, 3);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 4, test_sent_flow_link_credit);
+
+    // act
+    /* a delivery in 3 frames leaves 3 credits, which is not under the refill threshold */
+    receive_transfer(&receiver, 0, true, frame, sizeof(frame));
+    receive_transfer(&receiver, 0, true, frame, sizeof(frame));
+    receive_transfer(&receiver, 0, false, frame, sizeof(frame));
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    receive_transfer(&receiver, 1, false, frame, sizeof(frame));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 4, test_sent_flow_link_credit);
+    ASSERT_ARE_EQUAL(uint32_t, 2, test_sent_flow_delivery_count);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+/* link_set_credit_policy */
+
+TEST_FUNCTION(a_flow_goes_out_once_the_credit_falls_under_the_refill_threshold_and_not_before)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    const unsigned char payload[] = { 'a' };
+    delivery_number i;
+    create_attached_receiver_link(&receiver, 10, 5);
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 10, test_sent_flow_link_credit);
+
+    // act
+    /* 5 credits left is not under the threshold */
+    for (i = 0; i < 5; i++)
+    {
+        receive_transfer(&receiver, i, false, payload, sizeof(payload));
+    }
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    receive_transfer(&receiver, 5, false, payload, sizeof(payload));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 10, test_sent_flow_link_credit);
+    ASSERT_ARE_EQUAL(uint32_t, 6, test_sent_flow_delivery_count);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+TEST_FUNCTION(the_byte_budget_lowers_the_credit_window_and_the_refill_threshold_with_it)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    static unsigned char payload[100];
+    delivery_number i;
+    create_attached_receiver_link(&receiver, 10, 5);
+    ASSERT_ARE_EQUAL(int, 0, link_set_credit_policy(receiver.link, 10, 5, 500));
+    sent_flow_count = 0;
+
+    // act
+    /* at 100 bytes a delivery the window is 5 and the threshold 2, instead of 10 and 5 */
+    for (i = 0; i < 8; i++)
+    {
+        receive_transfer(&receiver, i, false, payload, sizeof(payload));
+    }
+    ASSERT_ARE_EQUAL(size_t, 0, sent_flow_count);
+    receive_transfer(&receiver, 8, false, payload, sizeof(payload));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 5, test_sent_flow_link_credit);
+    ASSERT_ARE_EQUAL(uint32_t, 9, test_sent_flow_delivery_count);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+TEST_FUNCTION(link_set_credit_policy_on_an_attached_receiver_link_sends_the_new_credit)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    int result;
+    create_attached_receiver_link(&receiver, 10, 5);
+
+    // act
+    result = link_set_credit_policy(receiver.link, 4, 2, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 2, sent_flow_count);
+    ASSERT_ARE_EQUAL(uint32_t, 4, test_sent_flow_link_credit);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+TEST_FUNCTION(link_set_credit_policy_with_NULL_link_fails)
+{
+    // arrange
+
+    // act
+    int result = link_set_credit_policy(NULL, 10, 5, 0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(link_set_credit_policy_with_prefetch_count_0_fails)
+{
+    // arrange
+    LINK_HANDLE link = link_create(TEST_SESSION_HANDLE, "receiver", role_receiver, NULL, NULL);
+    int result;
+
+    // act
+    result = link_set_credit_policy(link, 0, 0, 0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    link_destroy(link);
+}
+
+TEST_FUNCTION(link_set_credit_policy_with_a_refill_threshold_above_prefetch_count_fails)
+{
+    // arrange
+    LINK_HANDLE link = link_create(TEST_SESSION_HANDLE, "receiver", role_receiver, NULL, NULL);
+    int result;
+
+    // act
+    result = link_set_credit_policy(link, 10, 11, 0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    link_destroy(link);
+}
+
+/* link_set_on_transfer_chunk_received */
+
+TEST_FUNCTION(link_set_on_transfer_chunk_received_with_NULL_link_fails)
+{
+    // arrange
+
+    // act
+    int result = link_set_on_transfer_chunk_received(NULL, test_on_transfer_chunk_received);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(with_a_chunk_callback_each_frame_of_a_delivery_is_passed_as_it_arrives_and_none_is_kept)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    const unsigned char frame_1[] = { 'a', 'b', 'c' };
+    const unsigned char frame_2[] = { 'd', 'e' };
+    create_attached_receiver_link(&receiver, TEST_LINK_CREDIT, 0);
+    ASSERT_ARE_EQUAL(int, 0, link_set_on_transfer_chunk_received(receiver.link, test_on_transfer_chunk_received));
+    realloc_count = 0;
+
+    // act
+    receive_transfer(&receiver, 0, true, frame_1, sizeof(frame_1));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, receiver.chunk_count);
+    ASSERT_IS_TRUE(receiver.last_chunk_more);
+    ASSERT_ARE_EQUAL(uint32_t, 3, receiver.received_payload_size);
+    receive_transfer(&receiver, 0, false, frame_2, sizeof(frame_2));
+    ASSERT_ARE_EQUAL(size_t, 2, receiver.chunk_count);
+    ASSERT_IS_FALSE(receiver.last_chunk_more);
+    ASSERT_ARE_EQUAL(size_t, 1, receiver.delivery_count);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(receiver.received_payload, "abcde", 5));
+    /* the link reassembles nothing */
+    ASSERT_ARE_EQUAL(size_t, 0, realloc_count);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+TEST_FUNCTION(an_aborted_delivery_ends_with_an_empty_last_chunk_and_the_next_frame_starts_a_new_delivery)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    const unsigned char frame[] = { 'a' };
+    create_attached_receiver_link(&receiver, 4, 0);
+    ASSERT_ARE_EQUAL(int, 0, link_set_on_transfer_chunk_received(receiver.link, test_on_transfer_chunk_received));
+    receive_transfer(&receiver, 0, true, frame, sizeof(frame));
+    test_transfer_aborted = true;
+
+    // act
+    receive_transfer(&receiver, 0, false, NULL, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, receiver.chunk_count);
+    ASSERT_IS_FALSE(receiver.last_chunk_more);
+    ASSERT_ARE_EQUAL(uint32_t, 1, receiver.received_payload_size);
+
+    /* the receive mode can be changed again, the aborted delivery is over */
+    test_transfer_aborted = false;
+    ASSERT_ARE_EQUAL(int, 0, link_set_on_transfer_chunk_received(receiver.link, test_on_transfer_chunk_received));
+    receive_transfer(&receiver, 1, false, frame, sizeof(frame));
+    ASSERT_ARE_EQUAL(size_t, 3, receiver.chunk_count);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+TEST_FUNCTION(link_set_on_transfer_chunk_received_in_the_middle_of_a_delivery_fails)
+{
+    // arrange
+    TEST_RECEIVER_LINK receiver;
+    const unsigned char frame[] = { 'a' };
+    int result;
+    create_attached_receiver_link(&receiver, TEST_LINK_CREDIT, 0);
+    receive_transfer(&receiver, 0, true, frame, sizeof(frame));
+
+    // act
+    result = link_set_on_transfer_chunk_received(receiver.link, test_on_transfer_chunk_received);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    /* the delivery is still reassembled */
+    receive_transfer(&receiver, 0, false, frame, sizeof(frame));
+    ASSERT_ARE_EQUAL(size_t, 1, receiver.delivery_count);
+    ASSERT_ARE_EQUAL(uint32_t, 2, receiver.received_payload_size);
+    ASSERT_ARE_EQUAL(size_t, 0, receiver.chunk_count);
+
+    // cleanup
+    link_destroy(receiver.link);
+}
+
+END_TEST_SUITE(link_ut)
@@ -0,0 +1,746 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* Same exchange as local_client_server_tcp_perf, but client and server are joined by memory pair IOs:
+   no sockets and no syscalls, so the result is the cost of the codecs and the connection/session/link state machines.
+   It runs first with the server session window sized by the library, then with a window of 1, the old default, which
+   costs the receiver a session flow per transfer, and with the client sending pre-settled, untracked messages.
+   The exchange is then repeated with RECEIVE_LATENCY ms added to everything the client receives, with the receiver
+   granting LATENCY_PREFETCH_COUNT credit: first only refilled once it is used up, as links used to, which leaves the sender
+   waiting a round trip per credit window, then refilled under half the window. */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/memory_pair_io.h"
+#include "azure_uamqp_c/header_detect_io.h"
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+
+#define CLIENT_COUNT 1
+#define OUTSTANDING_MESSAGE_COUNT 100
+#define TEST_RUNTIME 5000 // ms
+#define RECEIVE_LATENCY 50 // ms
+#define LATENCY_PREFETCH_COUNT 10000
+/* for the runs with latency, large enough for the link credit, and not the session window, to be what the sender waits for */
+#define LATENCY_SERVER_INCOMING_WINDOW 1000000
+
+/* holds back the bytes received by the underlying IO for latency ms */
+typedef struct DELAYED_BYTES_TAG
+{
+	struct DELAYED_BYTES_TAG* next;
+	tickcounter_ms_t received_ms;
+	size_t size;
+	unsigned char bytes[];
+} DELAYED_BYTES;
+
+typedef struct LATENCY_IO_CONFIG_TAG
+{
+	XIO_HANDLE underlying_io;
+	tickcounter_ms_t latency;
+} LATENCY_IO_CONFIG;
+
+typedef struct LATENCY_IO_INSTANCE_TAG
+{
+	XIO_HANDLE underlying_io;
+	tickcounter_ms_t latency;
+	TICK_COUNTER_HANDLE tick_counter;
+	DELAYED_BYTES* first_delayed_bytes;
+	DELAYED_BYTES* last_delayed_bytes;
+	ON_BYTES_RECEIVED on_bytes_received;
+	void* on_bytes_received_context;
+} LATENCY_IO_INSTANCE;
+
+typedef struct CREDIT_POLICY_TAG
+{
+	uint32_t prefetch_count;
+	uint32_t refill_threshold;
+} CREDIT_POLICY;
+
+typedef struct SERVER_CONNECTED_CLIENT_TAG
+{
+	CONNECTION_HANDLE connection;
+	SESSION_HANDLE session;
+	LINK_HANDLE link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+	XIO_HANDLE io;
+	const CREDIT_POLICY* credit_policy;
+	/* 0: sized by the session */
+	uint32_t incoming_window;
+} SERVER_CONNECTED_CLIENT;
+
+typedef struct CLIENT_TAG
+{
+	MEMORY_PAIR_HANDLE memory_pair;
+	CONNECTION_HANDLE connection;
+	SESSION_HANDLE session;
+	LINK_HANDLE link;
+	MESSAGE_SENDER_HANDLE message_sender;
+	XIO_HANDLE io;
+	size_t outstanding_message_count;
+	/* messagesender_send_presettled, paced on the messages the sender has pending */
+	bool is_presettled;
+	SERVER_CONNECTED_CLIENT server;
+} CLIENT;
+
+static size_t total_messages_received;
+
+static void latencyio_free_delayed_bytes(LATENCY_IO_INSTANCE* latency_io)
+{
+	while (latency_io->first_delayed_bytes != NULL)
+	{
+		DELAYED_BYTES* delayed_bytes = latency_io->first_delayed_bytes;
+		latency_io->first_delayed_bytes = delayed_bytes->next;
+		free(delayed_bytes);
+	}
+
+	latency_io->last_delayed_bytes = NULL;
+}
+
+static void latencyio_on_underlying_io_bytes_received(void* context, const unsigned char* buffer, size_t size)
+{
+	LATENCY_IO_INSTANCE* latency_io = (LATENCY_IO_INSTANCE*)context;
+	DELAYED_BYTES* delayed_bytes = (DELAYED_BYTES*)malloc(sizeof(DELAYED_BYTES) + size);
+
+	if (delayed_bytes == NULL)
+	{
+		LogError("Cannot allocate delayed bytes");
+	}
+	else if (tickcounter_get_current_ms(latency_io->tick_counter, &delayed_bytes->received_ms) != 0)
+	{
+		LogError("Cannot get tick counter value");
+		free(delayed_bytes);
+	}
+	else
+	{
+		delayed_bytes->next = NULL;
+		delayed_bytes->size = size;
+		(void)memcpy(delayed_bytes->bytes, buffer, size);
+
+		if (latency_io->last_delayed_bytes == NULL)
+		{
+			latency_io->first_delayed_bytes = delayed_bytes;
+		}
+		else
+		{
+			latency_io->last_delayed_bytes->next = delayed_bytes;
+		}
+
+		latency_io->last_delayed_bytes = delayed_bytes;
+	}
+}
+
+static CONCRETE_IO_HANDLE latencyio_create(void* io_create_parameters)
+{
+	LATENCY_IO_CONFIG* config = (LATENCY_IO_CONFIG*)io_create_parameters;
+	LATENCY_IO_INSTANCE* result = (LATENCY_IO_INSTANCE*)malloc(sizeof(LATENCY_IO_INSTANCE));
+
+	if (result != NULL)
+	{
+		(void)memset(result, 0, sizeof(LATENCY_IO_INSTANCE));
+		result->underlying_io = config->underlying_io;
+		result->latency = config->latency;
+		result->tick_counter = tickcounter_create();
+		if (result->tick_counter == NULL)
+		{
+			free(result);
+			result = NULL;
+		}
+	}
+
+	return result;
+}
+
+static void latencyio_destroy(CONCRETE_IO_HANDLE handle)
+{
+	LATENCY_IO_INSTANCE* latency_io = (LATENCY_IO_INSTANCE*)handle;
+
+	latencyio_free_delayed_bytes(latency_io);
+	xio_destroy(latency_io->underlying_io);
+	tickcounter_destroy(latency_io->tick_counter);
+	free(latency_io);
+}
+
+static int latencyio_open(CONCRETE_IO_HANDLE handle, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+	LATENCY_IO_INSTANCE* latency_io = (LATENCY_IO_INSTANCE*)handle;
+
+	latency_io->on_bytes_received = on_bytes_received;
+	latency_io->on_bytes_received_context = on_bytes_received_context;
+
+	return xio_open(latency_io->underlying_io, on_io_open_complete, on_io_open_complete_context, latencyio_on_underlying_io_bytes_received, latency_io, on_io_error, on_io_error_context);
+}
+
+static int latencyio_close(CONCRETE_IO_HANDLE handle, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+	LATENCY_IO_INSTANCE* latency_io = (LATENCY_IO_INSTANCE*)handle;
+
+	latencyio_free_delayed_bytes(latency_io);
+
+	return xio_close(latency_io->underlying_io, on_io_close_complete, callback_context);
+}
+
+static int latencyio_send(CONCRETE_IO_HANDLE handle, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+	return xio_send(((LATENCY_IO_INSTANCE*)handle)->underlying_io, buffer, size, on_send_complete, callback_context);
+}
+
+static void latencyio_dowork(CONCRETE_IO_HANDLE handle)
+{
+	LATENCY_IO_INSTANCE* latency_io = (LATENCY_IO_INSTANCE*)handle;
+	tickcounter_ms_t current_ms;
+
+	xio_dowork(latency_io->underlying_io);
+
+	if ((latency_io->first_delayed_bytes != NULL) &&
+		(tickcounter_get_current_ms(latency_io->tick_counter, &current_ms) == 0))
+	{
+		while ((latency_io->first_delayed_bytes != NULL) &&
+			(current_ms - latency_io->first_delayed_bytes->received_ms >= latency_io->latency))
+		{
+			DELAYED_BYTES* delayed_bytes = latency_io->first_delayed_bytes;
+
+			latency_io->first_delayed_bytes = delayed_bytes->next;
+			if (latency_io->first_delayed_bytes == NULL)
+			{
+				latency_io->last_delayed_bytes = NULL;
+			}
+
+			latency_io->on_bytes_received(latency_io->on_bytes_received_context, delayed_bytes->bytes, delayed_bytes->size);
+			free(delayed_bytes);
+		}
+	}
+}
+
+static int latencyio_setoption(CONCRETE_IO_HANDLE handle, const char* optionName, const void* value)
+{
+	return xio_setoption(((LATENCY_IO_INSTANCE*)handle)->underlying_io, optionName, value);
+}
+
+static OPTIONHANDLER_HANDLE latencyio_retrieveoptions(CONCRETE_IO_HANDLE handle)
+{
+	(void)handle;
+	return NULL;
+}
+
+static const IO_INTERFACE_DESCRIPTION latency_io_interface_description =
+{
+	latencyio_retrieveoptions,
+	latencyio_create,
+	latencyio_destroy,
+	latencyio_open,
+	latencyio_close,
+	latencyio_send,
+	latencyio_dowork,
+	latencyio_setoption
+};
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	(void)context;
+	(void)message;
+
+	total_messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	bool result;
+
+	server_connected_client->link = link_create_from_endpoint(server_connected_client->session, new_link_endpoint, name, role, source, target);
+	if (server_connected_client->link == NULL)
+	{
+		LogError("Cannot create link");
+		result = false;
+	}
+	else if (link_set_rcv_settle_mode(server_connected_client->link, receiver_settle_mode_first) != 0)
+	{
+		LogError("Cannot set receiver settle mode");
+		result = false;
+	}
+	else if ((server_connected_client->credit_policy != NULL) &&
+		(link_set_credit_policy(server_connected_client->link, server_connected_client->credit_policy->prefetch_count, server_connected_client->credit_policy->refill_threshold, 0) != 0))
+	{
+		LogError("Cannot set credit policy");
+		result = false;
+	}
+	else
+	{
+		server_connected_client->message_receiver = messagereceiver_create(server_connected_client->link, NULL, NULL);
+		if (server_connected_client->message_receiver == NULL)
+		{
+			LogError("Cannot create message receiver");
+			result = false;
+		}
+		else if (messagereceiver_open(server_connected_client->message_receiver, on_message_received, NULL) != 0)
+		{
+			LogError("Cannot open message receiver");
+			result = false;
+		}
+		else
+		{
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+static bool on_new_session_endpoint(void* context, ENDPOINT_HANDLE new_endpoint)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	bool result;
+
+	server_connected_client->session = session_create_from_endpoint(server_connected_client->connection, new_endpoint, on_new_link_attached, server_connected_client);
+	if (server_connected_client->session == NULL)
+	{
+		LogError("Cannot create session");
+		result = false;
+	}
+	else if (((server_connected_client->incoming_window > 0) &&
+			(session_set_incoming_window(server_connected_client->session, server_connected_client->incoming_window) != 0)) ||
+		(session_begin(server_connected_client->session) != 0))
+	{
+		LogError("Cannot begin session");
+		result = false;
+	}
+	else
+	{
+		result = true;
+	}
+
+	return result;
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	CLIENT* client = (CLIENT*)context;
+
+	(void)send_result;
+
+	client->outstanding_message_count--;
+}
+
+static int create_server(CLIENT* client)
+{
+	int result;
+	MEMORYPAIRIO_CONFIG memory_pair_io_config;
+	HEADERDETECTIO_CONFIG header_detect_io_config;
+
+	memory_pair_io_config.memory_pair = client->memory_pair;
+	memory_pair_io_config.end = MEMORY_PAIR_END_SECOND;
+
+	/* as with an accepted socket, the header detect IO consumes the protocol header before the connection sees any bytes */
+	header_detect_io_config.underlying_io = xio_create(memorypairio_get_interface_description(), &memory_pair_io_config);
+	if (header_detect_io_config.underlying_io == NULL)
+	{
+		LogError("Cannot create server IO");
+		result = __LINE__;
+	}
+	else if ((client->server.io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config)) == NULL)
+	{
+		LogError("Cannot create header detect IO");
+		xio_destroy(header_detect_io_config.underlying_io);
+		result = __LINE__;
+	}
+	else
+	{
+		client->server.connection = connection_create(client->server.io, NULL, "1", on_new_session_endpoint, &client->server);
+		if (client->server.connection == NULL)
+		{
+			LogError("Cannot create server connection");
+			result = __LINE__;
+		}
+		else if (connection_listen(client->server.connection) != 0)
+		{
+			LogError("Cannot listen on server connection");
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static int create_client(CLIENT* client, tickcounter_ms_t receive_latency)
+{
+	int result;
+	MEMORYPAIRIO_CONFIG memory_pair_io_config;
+	XIO_HANDLE memory_pair_io;
+
+	memory_pair_io_config.memory_pair = client->memory_pair;
+	memory_pair_io_config.end = MEMORY_PAIR_END_FIRST;
+
+	memory_pair_io = xio_create(memorypairio_get_interface_description(), &memory_pair_io_config);
+	if (receive_latency == 0)
+	{
+		client->io = memory_pair_io;
+	}
+	else if (memory_pair_io != NULL)
+	{
+		LATENCY_IO_CONFIG latency_io_config;
+
+		latency_io_config.underlying_io = memory_pair_io;
+		latency_io_config.latency = receive_latency;
+
+		/* the latency IO destroys the memory pair IO with itself */
+		client->io = xio_create(&latency_io_interface_description, &latency_io_config);
+		if (client->io == NULL)
+		{
+			xio_destroy(memory_pair_io);
+		}
+	}
+
+	if (client->io == NULL)
+	{
+		LogError("Cannot create client IO");
+		result = __LINE__;
+	}
+	else
+	{
+		client->connection = connection_create(client->io, "localhost", "some", NULL, NULL);
+		if (client->connection == NULL)
+		{
+			LogError("Cannot create client connection");
+			result = __LINE__;
+		}
+		else
+		{
+			client->session = session_create(client->connection, NULL, NULL);
+			if (client->session == NULL)
+			{
+				LogError("Cannot create client session");
+				result = __LINE__;
+			}
+			else
+			{
+				AMQP_VALUE source = messaging_create_source("ingress");
+				AMQP_VALUE target = messaging_create_target("localhost/ingress");
+
+				client->link = link_create(client->session, "sender-link", role_sender, source, target);
+				amqpvalue_destroy(source);
+				amqpvalue_destroy(target);
+
+				if (client->link == NULL)
+				{
+					LogError("Cannot create client link");
+					result = __LINE__;
+				}
+				else if ((link_set_snd_settle_mode(client->link, sender_settle_mode_settled) != 0) ||
+					(link_set_max_message_size(client->link, 65536) != 0))
+				{
+					LogError("Cannot set link properties");
+					result = __LINE__;
+				}
+				else
+				{
+					client->message_sender = messagesender_create(client->link, NULL, NULL);
+					if (client->message_sender == NULL)
+					{
+						LogError("Cannot create client message sender");
+						result = __LINE__;
+					}
+					else if (messagesender_open(client->message_sender) != 0)
+					{
+						LogError("Cannot open client message sender");
+						result = __LINE__;
+					}
+					else
+					{
+						result = 0;
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static void destroy_client(CLIENT* client)
+{
+	if (client->message_sender != NULL)
+	{
+		messagesender_destroy(client->message_sender);
+	}
+
+	if (client->link != NULL)
+	{
+		link_destroy(client->link);
+	}
+
+	if (client->session != NULL)
+	{
+		session_destroy(client->session);
+	}
+
+	if (client->connection != NULL)
+	{
+		connection_destroy(client->connection);
+	}
+
+	if (client->io != NULL)
+	{
+		xio_destroy(client->io);
+	}
+
+	if (client->server.message_receiver != NULL)
+	{
+		messagereceiver_destroy(client->server.message_receiver);
+	}
+
+	if (client->server.link != NULL)
+	{
+		link_destroy(client->server.link);
+	}
+
+	if (client->server.session != NULL)
+	{
+		session_destroy(client->server.session);
+	}
+
+	if (client->server.connection != NULL)
+	{
+		connection_destroy(client->server.connection);
+	}
+
+	if (client->server.io != NULL)
+	{
+		xio_destroy(client->server.io);
+	}
+
+	memorypairio_destroy_pair(client->memory_pair);
+}
+
+static int send_messages(CLIENT* client)
+{
+	int result = 0;
+	size_t sent_count = 0;
+
+	/* pre-settled messages have no completion, what is outstanding is what the sender still holds */
+	if (client->is_presettled &&
+		(messagesender_get_pending_message_count(client->message_sender, &client->outstanding_message_count) != 0))
+	{
+		LogError("Cannot get the pending message count");
+		result = __LINE__;
+	}
+
+	/* settled sends complete right away, the count per call keeps one call from sending all the credit at once while the
+	   server does not get to run */
+	while ((result == 0) &&
+		(client->outstanding_message_count < OUTSTANDING_MESSAGE_COUNT) &&
+		(sent_count < OUTSTANDING_MESSAGE_COUNT))
+	{
+		MESSAGE_HANDLE message = message_create();
+
+		sent_count++;
+		if (message == NULL)
+		{
+			LogError("Error creating message");
+			result = __LINE__;
+		}
+		else
+		{
+			unsigned char hello[] = { 'H', 'e', 'l', 'l', 'o' };
+			BINARY_DATA binary_data;
+
+			binary_data.bytes = hello;
+			binary_data.length = sizeof(hello);
+
+			if (message_add_body_amqp_data(message, binary_data) != 0)
+			{
+				LogError("Error setting message body");
+				result = __LINE__;
+			}
+			else if (client->is_presettled)
+			{
+				if ((messagesender_send_presettled(client->message_sender, message) != 0) ||
+					(messagesender_get_pending_message_count(client->message_sender, &client->outstanding_message_count) != 0))
+				{
+					LogError("Error sending message");
+					result = __LINE__;
+				}
+			}
+			else
+			{
+				/* counted before sending, a settled send completes from inside messagesender_send */
+				client->outstanding_message_count++;
+
+				if (messagesender_send(client->message_sender, message, on_message_send_complete, client) != 0)
+				{
+					client->outstanding_message_count--;
+					LogError("Error sending message");
+					result = __LINE__;
+				}
+			}
+
+			message_destroy(message);
+		}
+	}
+
+	return result;
+}
+
+static int run_exchange(const char* description, bool is_presettled, tickcounter_ms_t receive_latency, uint32_t server_incoming_window, const CREDIT_POLICY* credit_policy)
+{
+	int result = 0;
+	CLIENT clients[CLIENT_COUNT];
+	size_t client_count;
+
+	total_messages_received = 0;
+
+	for (client_count = 0; client_count < CLIENT_COUNT; client_count++)
+	{
+		CLIENT* client = &clients[client_count];
+
+		(void)memset(client, 0, sizeof(CLIENT));
+		client->is_presettled = is_presettled;
+		client->server.credit_policy = credit_policy;
+		client->server.incoming_window = server_incoming_window;
+		client->memory_pair = memorypairio_create_pair(0);
+		if (client->memory_pair == NULL)
+		{
+			LogError("Cannot create memory pair");
+			result = __LINE__;
+			break;
+		}
+
+		result = create_server(client);
+		if (result == 0)
+		{
+			result = create_client(client, receive_latency);
+		}
+
+		if (result != 0)
+		{
+			destroy_client(client);
+			break;
+		}
+	}
+
+	if (result == 0)
+	{
+		TICK_COUNTER_HANDLE tick_counter = tickcounter_create();
+		if (tick_counter == NULL)
+		{
+			LogError("Cannot create tick counter");
+			result = __LINE__;
+		}
+		else
+		{
+			tickcounter_ms_t start_ms = 0;
+			tickcounter_ms_t current_ms = 0;
+
+			if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+			{
+				LogError("Cannot get tick counter value");
+				result = __LINE__;
+			}
+
+			current_ms = start_ms;
+
+			while ((result == 0) &&
+				(current_ms - start_ms <= TEST_RUNTIME))
+			{
+				size_t i;
+
+				for (i = 0; (i < client_count) && (result == 0); i++)
+				{
+					connection_dowork(clients[i].connection);
+					result = send_messages(&clients[i]);
+					connection_dowork(clients[i].server.connection);
+				}
+
+				if ((result == 0) &&
+					(tickcounter_get_current_ms(tick_counter, &current_ms) != 0))
+				{
+					LogError("Cannot get tick counter value");
+					result = __LINE__;
+				}
+			}
+
+			if (result == 0)
+			{
+				LINK_STATISTICS link_statistics;
+				SESSION_STATISTICS session_statistics;
+
+				LogInfo("%s:", description);
+				LogInfo("Received %u messages in %.2f seconds, %.0f messages/s",
+					(unsigned int)total_messages_received,
+					((double)current_ms - start_ms) / 1000,
+					total_messages_received / (((double)current_ms - start_ms) / 1000));
+
+				if ((link_get_statistics(clients[0].server.link, &link_statistics) == 0) &&
+					(session_get_statistics(clients[0].server.session, &session_statistics) == 0))
+				{
+					LogInfo("%u flow frames sent by the receiver, %u of them by the link",
+						(unsigned int)session_statistics.flows_sent, (unsigned int)link_statistics.flows_sent);
+				}
+			}
+
+			tickcounter_destroy(tick_counter);
+		}
+	}
+
+	while (client_count > 0)
+	{
+		client_count--;
+		destroy_client(&clients[client_count]);
+	}
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		CREDIT_POLICY refill_when_empty = { LATENCY_PREFETCH_COUNT, 0 };
+		CREDIT_POLICY refill_under_half = { LATENCY_PREFETCH_COUNT, LATENCY_PREFETCH_COUNT / 2 };
+
+		result = run_exchange("No added latency, session window sized by the session", false, 0, 0, NULL);
+		if (result == 0)
+		{
+			result = run_exchange("No added latency, session window of 1", false, 0, 1, NULL);
+		}
+
+		if (result == 0)
+		{
+			result = run_exchange("No added latency, pre-settled sends", true, 0, 0, NULL);
+		}
+
+		if (result == 0)
+		{
+			result = run_exchange("Receive latency, credit refilled once used up", false, RECEIVE_LATENCY, LATENCY_SERVER_INCOMING_WINDOW, &refill_when_empty);
+		}
+
+		if (result == 0)
+		{
+			result = run_exchange("Receive latency, credit refilled under half", false, RECEIVE_LATENCY, LATENCY_SERVER_INCOMING_WINDOW, &refill_under_half);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}
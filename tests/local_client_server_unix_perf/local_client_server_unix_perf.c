@@ -0,0 +1,524 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* Runs the same client/server exchange over TCP loopback and over a Unix domain socket and reports, for each,
+   the throughput with OUTSTANDING_MESSAGE_COUNT unsettled messages in flight and the round trip latency
+   (send to disposition) of LATENCY_SAMPLE_COUNT messages sent one at a time. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_uamqp_c/socket_listener.h"
+#include "azure_uamqp_c/unix_socket_io.h"
+#include "azure_uamqp_c/header_detect_io.h"
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+
+#define TEST_PORT 5674
+#define TEST_SOCKET_PATH "/tmp/uamqp_unix_perf.sock"
+#define OUTSTANDING_MESSAGE_COUNT 100
+#define THROUGHPUT_RUNTIME 3000 // ms
+#define LATENCY_SAMPLE_COUNT 20000
+#define SETUP_TIMEOUT 5000 // ms
+
+typedef struct SERVER_CONNECTED_CLIENT_TAG
+{
+	CONNECTION_HANDLE connection;
+	SESSION_HANDLE session;
+	LINK_HANDLE link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+	XIO_HANDLE io;
+	size_t messages_received;
+} SERVER_CONNECTED_CLIENT;
+
+typedef struct CLIENT_TAG
+{
+	CONNECTION_HANDLE connection;
+	SESSION_HANDLE session;
+	LINK_HANDLE link;
+	MESSAGE_SENDER_HANDLE message_sender;
+	XIO_HANDLE io;
+	size_t outstanding_message_count;
+	bool is_send_failed;
+
+	/* only used while measuring latency, when a single message is in flight */
+	uint64_t send_time_us;
+	uint64_t* latency_samples;
+	size_t latency_sample_count;
+	bool is_latency_send_pending;
+} CLIENT;
+
+typedef struct TEST_RUN_TAG
+{
+	SOCKET_LISTENER_HANDLE socket_listener;
+	SERVER_CONNECTED_CLIENT server;
+	CLIENT client;
+} TEST_RUN;
+
+static uint64_t get_time_us(void)
+{
+	struct timespec now;
+	(void)clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * 1000000) + ((uint64_t)now.tv_nsec / 1000);
+}
+
+static int compare_samples(const void* left, const void* right)
+{
+	uint64_t left_sample = *(const uint64_t*)left;
+	uint64_t right_sample = *(const uint64_t*)right;
+
+	return (left_sample < right_sample) ? -1 : ((left_sample > right_sample) ? 1 : 0);
+}
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	(void)message;
+
+	server_connected_client->messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	bool result;
+
+	server_connected_client->link = link_create_from_endpoint(server_connected_client->session, new_link_endpoint, name, role, source, target);
+	if (server_connected_client->link == NULL)
+	{
+		LogError("Cannot create link");
+		result = false;
+	}
+	else if (link_set_rcv_settle_mode(server_connected_client->link, receiver_settle_mode_first) != 0)
+	{
+		LogError("Cannot set receiver settle mode");
+		result = false;
+	}
+	else
+	{
+		server_connected_client->message_receiver = messagereceiver_create(server_connected_client->link, NULL, NULL);
+		if (server_connected_client->message_receiver == NULL)
+		{
+			LogError("Cannot create message receiver");
+			result = false;
+		}
+		else if (messagereceiver_open(server_connected_client->message_receiver, on_message_received, server_connected_client) != 0)
+		{
+			LogError("Cannot open message receiver");
+			result = false;
+		}
+		else
+		{
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+static bool on_new_session_endpoint(void* context, ENDPOINT_HANDLE new_endpoint)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	bool result;
+
+	server_connected_client->session = session_create_from_endpoint(server_connected_client->connection, new_endpoint, on_new_link_attached, server_connected_client);
+	if (server_connected_client->session == NULL)
+	{
+		LogError("Cannot create session");
+		result = false;
+	}
+	else if ((session_set_incoming_window(server_connected_client->session, 10000) != 0) ||
+		(session_begin(server_connected_client->session) != 0))
+	{
+		LogError("Cannot begin session");
+		result = false;
+	}
+	else
+	{
+		result = true;
+	}
+
+	return result;
+}
+
+static void on_socket_accepted(void* context, const IO_INTERFACE_DESCRIPTION* interface_description, void* io_parameters)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+
+	if (server_connected_client->io != NULL)
+	{
+		LogError("Only one client is expected");
+	}
+	else
+	{
+		HEADERDETECTIO_CONFIG header_detect_io_config;
+
+		header_detect_io_config.underlying_io = xio_create(interface_description, io_parameters);
+		if (header_detect_io_config.underlying_io == NULL)
+		{
+			LogError("Cannot create accepted socket IO");
+		}
+		else if ((server_connected_client->io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config)) == NULL)
+		{
+			LogError("Cannot create header detect IO");
+			xio_destroy(header_detect_io_config.underlying_io);
+		}
+		else
+		{
+			server_connected_client->connection = connection_create(server_connected_client->io, NULL, "1", on_new_session_endpoint, server_connected_client);
+			if (server_connected_client->connection == NULL)
+			{
+				LogError("Cannot create server connection");
+			}
+			else if (connection_listen(server_connected_client->connection) != 0)
+			{
+				LogError("Cannot listen on server connection");
+			}
+		}
+	}
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	CLIENT* client = (CLIENT*)context;
+
+	if (send_result != MESSAGE_SEND_OK)
+	{
+		client->is_send_failed = true;
+	}
+
+	if (client->is_latency_send_pending)
+	{
+		client->is_latency_send_pending = false;
+		client->latency_samples[client->latency_sample_count++] = get_time_us() - client->send_time_us;
+	}
+
+	client->outstanding_message_count--;
+}
+
+static int create_client(CLIENT* client, bool is_unix)
+{
+	int result;
+
+	if (is_unix)
+	{
+		UNIXSOCKETIO_CONFIG unix_socket_io_config;
+		unix_socket_io_config.socket_path = TEST_SOCKET_PATH;
+		client->io = xio_create(unixsocketio_get_interface_description(), &unix_socket_io_config);
+	}
+	else
+	{
+		SOCKETIO_CONFIG socketio_config = { "localhost", TEST_PORT, NULL };
+		client->io = xio_create(socketio_get_interface_description(), &socketio_config);
+	}
+
+	if (client->io == NULL)
+	{
+		LogError("Cannot create client IO");
+		result = __LINE__;
+	}
+	else
+	{
+		client->connection = connection_create(client->io, "localhost", "some", NULL, NULL);
+		if (client->connection == NULL)
+		{
+			LogError("Cannot create client connection");
+			result = __LINE__;
+		}
+		else
+		{
+			client->session = session_create(client->connection, NULL, NULL);
+			if (client->session == NULL)
+			{
+				LogError("Cannot create client session");
+				result = __LINE__;
+			}
+			else
+			{
+				AMQP_VALUE source = messaging_create_source("ingress");
+				AMQP_VALUE target = messaging_create_target("localhost/ingress");
+
+				client->link = link_create(client->session, "sender-link", role_sender, source, target);
+				amqpvalue_destroy(source);
+				amqpvalue_destroy(target);
+
+				/* unsettled, so that a send completes when the server's disposition comes back */
+				if ((client->link == NULL) ||
+					(link_set_snd_settle_mode(client->link, sender_settle_mode_unsettled) != 0))
+				{
+					LogError("Cannot create client link");
+					result = __LINE__;
+				}
+				else
+				{
+					client->message_sender = messagesender_create(client->link, NULL, NULL);
+					if ((client->message_sender == NULL) ||
+						(messagesender_open(client->message_sender) != 0))
+					{
+						LogError("Cannot open client message sender");
+						result = __LINE__;
+					}
+					else
+					{
+						result = 0;
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static void destroy_test_run(TEST_RUN* test_run)
+{
+	if (test_run->client.message_sender != NULL)
+	{
+		messagesender_destroy(test_run->client.message_sender);
+	}
+
+	if (test_run->client.link != NULL)
+	{
+		link_destroy(test_run->client.link);
+	}
+
+	if (test_run->client.session != NULL)
+	{
+		session_destroy(test_run->client.session);
+	}
+
+	if (test_run->client.connection != NULL)
+	{
+		connection_destroy(test_run->client.connection);
+	}
+
+	if (test_run->client.io != NULL)
+	{
+		xio_destroy(test_run->client.io);
+	}
+
+	if (test_run->server.message_receiver != NULL)
+	{
+		messagereceiver_destroy(test_run->server.message_receiver);
+	}
+
+	if (test_run->server.link != NULL)
+	{
+		link_destroy(test_run->server.link);
+	}
+
+	if (test_run->server.session != NULL)
+	{
+		session_destroy(test_run->server.session);
+	}
+
+	if (test_run->server.connection != NULL)
+	{
+		connection_destroy(test_run->server.connection);
+	}
+
+	/* header detect IO destroys the accepted socket IO under it */
+	if (test_run->server.io != NULL)
+	{
+		xio_destroy(test_run->server.io);
+	}
+
+	if (test_run->socket_listener != NULL)
+	{
+		socketlistener_destroy(test_run->socket_listener);
+	}
+}
+
+/* one turn of the loop: accept, client work, refill the client up to window messages, server work */
+static int run_once(TEST_RUN* test_run, size_t window)
+{
+	int result = 0;
+	CLIENT* client = &test_run->client;
+
+	socketlistener_dowork(test_run->socket_listener);
+	connection_dowork(client->connection);
+
+	while ((result == 0) &&
+		(client->outstanding_message_count < window))
+	{
+		MESSAGE_HANDLE message = message_create();
+		if (message == NULL)
+		{
+			LogError("Error creating message");
+			result = __LINE__;
+		}
+		else
+		{
+			unsigned char hello[] = { 'H', 'e', 'l', 'l', 'o' };
+			BINARY_DATA binary_data;
+
+			binary_data.bytes = hello;
+			binary_data.length = sizeof(hello);
+
+			client->outstanding_message_count++;
+
+			if (client->latency_samples != NULL)
+			{
+				client->send_time_us = get_time_us();
+				client->is_latency_send_pending = true;
+			}
+
+			if ((message_add_body_amqp_data(message, binary_data) != 0) ||
+				(messagesender_send(client->message_sender, message, on_message_send_complete, client) != 0))
+			{
+				client->outstanding_message_count--;
+				client->is_latency_send_pending = false;
+				LogError("Error sending message");
+				result = __LINE__;
+			}
+
+			message_destroy(message);
+		}
+	}
+
+	if (test_run->server.connection != NULL)
+	{
+		connection_dowork(test_run->server.connection);
+	}
+
+	if ((result == 0) &&
+		(client->is_send_failed))
+	{
+		LogError("Message send failed");
+		result = __LINE__;
+	}
+
+	return result;
+}
+
+static int run_transport(bool is_unix)
+{
+	int result;
+	TEST_RUN test_run;
+	const char* transport_name = is_unix ? "unix" : "tcp";
+
+	(void)memset(&test_run, 0, sizeof(test_run));
+
+	test_run.socket_listener = is_unix ? socketlistener_create_unix(TEST_SOCKET_PATH) : socketlistener_create(TEST_PORT);
+	if (test_run.socket_listener == NULL)
+	{
+		LogError("Cannot create %s socket listener", transport_name);
+		result = __LINE__;
+	}
+	else if (socketlistener_start(test_run.socket_listener, on_socket_accepted, &test_run.server) != 0)
+	{
+		LogError("Cannot start %s socket listener", transport_name);
+		result = __LINE__;
+	}
+	else if ((result = create_client(&test_run.client, is_unix)) == 0)
+	{
+		uint64_t start_us = get_time_us();
+		uint64_t current_us = start_us;
+
+		/* one message round trip makes sure the connection, session and link are up before measuring */
+		while ((result == 0) &&
+			(test_run.server.messages_received == 0))
+		{
+			result = run_once(&test_run, 1);
+			current_us = get_time_us();
+			if ((result == 0) &&
+				(current_us - start_us > (uint64_t)SETUP_TIMEOUT * 1000))
+			{
+				LogError("Timeout setting up the %s connection", transport_name);
+				result = __LINE__;
+			}
+		}
+
+		if (result == 0)
+		{
+			size_t messages_received_before = test_run.server.messages_received;
+
+			start_us = get_time_us();
+			current_us = start_us;
+
+			while ((result == 0) &&
+				(current_us - start_us <= (uint64_t)THROUGHPUT_RUNTIME * 1000))
+			{
+				result = run_once(&test_run, OUTSTANDING_MESSAGE_COUNT);
+				current_us = get_time_us();
+			}
+
+			if (result == 0)
+			{
+				double messages_per_second = (double)(test_run.server.messages_received - messages_received_before) / ((double)(current_us - start_us) / 1000000);
+
+				test_run.client.latency_samples = (uint64_t*)malloc(sizeof(uint64_t) * LATENCY_SAMPLE_COUNT);
+				if (test_run.client.latency_samples == NULL)
+				{
+					LogError("Cannot allocate latency samples");
+					result = __LINE__;
+				}
+				else
+				{
+					/* with a window of one the next send only happens once everything still in flight has completed */
+					while ((result == 0) &&
+						(test_run.client.latency_sample_count < LATENCY_SAMPLE_COUNT))
+					{
+						result = run_once(&test_run, 1);
+					}
+
+					if (result == 0)
+					{
+						size_t sample_count = test_run.client.latency_sample_count;
+
+						qsort(test_run.client.latency_samples, sample_count, sizeof(uint64_t), compare_samples);
+
+						LogInfo("%s: %.0f messages/s with %u in flight, round trip p50 %u us, p99 %u us, max %u us",
+							transport_name, messages_per_second, (unsigned int)OUTSTANDING_MESSAGE_COUNT,
+							(unsigned int)test_run.client.latency_samples[sample_count / 2],
+							(unsigned int)test_run.client.latency_samples[(sample_count * 99) / 100],
+							(unsigned int)test_run.client.latency_samples[sample_count - 1]);
+					}
+
+					/* the last turn may have sent one more message, its completion must not be recorded */
+					free(test_run.client.latency_samples);
+					test_run.client.latency_samples = NULL;
+					test_run.client.is_latency_send_pending = false;
+				}
+			}
+		}
+	}
+
+	destroy_test_run(&test_run);
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		result = run_transport(false);
+		if (result == 0)
+		{
+			result = run_transport(true);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}
@@ -0,0 +1,223 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/header_detect_io.h"
+#include "azure_uamqp_c/messaging.h"
+#include "memory_pair_fixture/memory_pair_fixture.h"
+
+static bool on_new_session_endpoint(void* context, ENDPOINT_HANDLE new_endpoint)
+{
+	MEMORY_PAIR_FIXTURE* fixture = (MEMORY_PAIR_FIXTURE*)context;
+	bool result;
+
+	fixture->server_session = session_create_from_endpoint(fixture->server_connection, new_endpoint, fixture->config.on_server_link_attached, fixture->config.on_server_link_attached_context);
+	if (fixture->server_session == NULL)
+	{
+		LogError("Cannot create session");
+		result = false;
+	}
+	else if (((fixture->config.server_incoming_window > 0) &&
+			(session_set_incoming_window(fixture->server_session, fixture->config.server_incoming_window) != 0)) ||
+		(session_begin(fixture->server_session) != 0))
+	{
+		LogError("Cannot begin session");
+		result = false;
+	}
+	else
+	{
+		result = true;
+	}
+
+	return result;
+}
+
+static int create_server(MEMORY_PAIR_FIXTURE* fixture)
+{
+	int result;
+	MEMORYPAIRIO_CONFIG memory_pair_io_config;
+	HEADERDETECTIO_CONFIG header_detect_io_config;
+
+	memory_pair_io_config.memory_pair = fixture->memory_pair;
+	memory_pair_io_config.end = MEMORY_PAIR_END_SECOND;
+
+	/* as with an accepted socket, the header detect IO consumes the protocol header before the connection sees any bytes */
+	header_detect_io_config.underlying_io = xio_create(memorypairio_get_interface_description(), &memory_pair_io_config);
+	if (header_detect_io_config.underlying_io == NULL)
+	{
+		LogError("Cannot create server IO");
+		result = __LINE__;
+	}
+	else if ((fixture->server_io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config)) == NULL)
+	{
+		LogError("Cannot create header detect IO");
+		xio_destroy(header_detect_io_config.underlying_io);
+		result = __LINE__;
+	}
+	else
+	{
+		fixture->server_connection = connection_create(fixture->server_io, NULL, "1", on_new_session_endpoint, fixture);
+		if (fixture->server_connection == NULL)
+		{
+			LogError("Cannot create server connection");
+			result = __LINE__;
+		}
+		else if (((fixture->config.server_max_frame_size > 0) &&
+				(connection_set_max_frame_size(fixture->server_connection, fixture->config.server_max_frame_size) != 0)) ||
+			(connection_listen(fixture->server_connection) != 0))
+		{
+			LogError("Cannot listen on server connection");
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static int create_client(MEMORY_PAIR_FIXTURE* fixture)
+{
+	int result;
+	MEMORYPAIRIO_CONFIG memory_pair_io_config;
+
+	memory_pair_io_config.memory_pair = fixture->memory_pair;
+	memory_pair_io_config.end = MEMORY_PAIR_END_FIRST;
+
+	fixture->client_io = xio_create(memorypairio_get_interface_description(), &memory_pair_io_config);
+	if (fixture->client_io == NULL)
+	{
+		LogError("Cannot create client IO");
+		result = __LINE__;
+	}
+	else
+	{
+		fixture->client_connection = connection_create(fixture->client_io, "localhost", "some", NULL, NULL);
+		if (fixture->client_connection == NULL)
+		{
+			LogError("Cannot create client connection");
+			result = __LINE__;
+		}
+		else
+		{
+			fixture->client_session = session_create(fixture->client_connection, NULL, NULL);
+			if (fixture->client_session == NULL)
+			{
+				LogError("Cannot create client session");
+				result = __LINE__;
+			}
+			else
+			{
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+int memory_pair_fixture_create(MEMORY_PAIR_FIXTURE* fixture, const MEMORY_PAIR_FIXTURE_CONFIG* config)
+{
+	int result;
+
+	(void)memset(fixture, 0, sizeof(MEMORY_PAIR_FIXTURE));
+	fixture->config = *config;
+
+	fixture->memory_pair = memorypairio_create_pair(0);
+	if (fixture->memory_pair == NULL)
+	{
+		LogError("Cannot create memory pair");
+		result = __LINE__;
+	}
+	else if ((result = create_server(fixture)) == 0)
+	{
+		result = create_client(fixture);
+	}
+
+	return result;
+}
+
+void memory_pair_fixture_destroy(MEMORY_PAIR_FIXTURE* fixture)
+{
+	if (fixture->client_session != NULL)
+	{
+		session_destroy(fixture->client_session);
+	}
+
+	if (fixture->client_connection != NULL)
+	{
+		connection_destroy(fixture->client_connection);
+	}
+
+	if (fixture->client_io != NULL)
+	{
+		xio_destroy(fixture->client_io);
+	}
+
+	if (fixture->server_session != NULL)
+	{
+		session_destroy(fixture->server_session);
+	}
+
+	if (fixture->server_connection != NULL)
+	{
+		connection_destroy(fixture->server_connection);
+	}
+
+	if (fixture->server_io != NULL)
+	{
+		xio_destroy(fixture->server_io);
+	}
+
+	if (fixture->memory_pair != NULL)
+	{
+		memorypairio_destroy_pair(fixture->memory_pair);
+	}
+}
+
+LINK_HANDLE memory_pair_fixture_create_sender_link(MEMORY_PAIR_FIXTURE* fixture, const char* name, sender_settle_mode snd_settle_mode)
+{
+	AMQP_VALUE source = messaging_create_source("ingress");
+	AMQP_VALUE target = messaging_create_target("localhost/ingress");
+	LINK_HANDLE result = link_create(fixture->client_session, name, role_sender, source, target);
+
+	amqpvalue_destroy(source);
+	amqpvalue_destroy(target);
+
+	if (result == NULL)
+	{
+		LogError("Cannot create client link");
+	}
+	else if (link_set_snd_settle_mode(result, snd_settle_mode) != 0)
+	{
+		LogError("Cannot set sender settle mode");
+		link_destroy(result);
+		result = NULL;
+	}
+
+	return result;
+}
+
+LINK_HANDLE memory_pair_fixture_create_receiver_link(MEMORY_PAIR_FIXTURE* fixture, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	LINK_HANDLE result = link_create_from_endpoint(fixture->server_session, new_link_endpoint, name, role, source, target);
+
+	if (result == NULL)
+	{
+		LogError("Cannot create link");
+	}
+	else if (link_set_rcv_settle_mode(result, receiver_settle_mode_first) != 0)
+	{
+		LogError("Cannot set receiver settle mode");
+		link_destroy(result);
+		result = NULL;
+	}
+
+	return result;
+}
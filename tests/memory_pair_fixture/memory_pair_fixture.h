@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef MEMORY_PAIR_FIXTURE_H
+#define MEMORY_PAIR_FIXTURE_H
+
+#include <stdint.h>
+#include "azure_c_shared_utility/xio.h"
+#include "azure_uamqp_c/memory_pair_io.h"
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/link.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* A client and a server joined by memory pair IOs, for the perf tests: each end has a connection and a session, the
+   server accepting the session the client begins and handing the links the client attaches to on_server_link_attached.
+   The caller runs both ends, with connection_dowork on client_connection and server_connection. */
+
+typedef struct MEMORY_PAIR_FIXTURE_CONFIG_TAG
+{
+	/* 0 leaves the library's value */
+	uint32_t server_max_frame_size;
+	uint32_t server_incoming_window;
+	ON_LINK_ATTACHED on_server_link_attached;
+	void* on_server_link_attached_context;
+} MEMORY_PAIR_FIXTURE_CONFIG;
+
+typedef struct MEMORY_PAIR_FIXTURE_TAG
+{
+	MEMORY_PAIR_FIXTURE_CONFIG config;
+	MEMORY_PAIR_HANDLE memory_pair;
+	XIO_HANDLE client_io;
+	CONNECTION_HANDLE client_connection;
+	SESSION_HANDLE client_session;
+	XIO_HANDLE server_io;
+	CONNECTION_HANDLE server_connection;
+	/* NULL until the client's begin is received */
+	SESSION_HANDLE server_session;
+} MEMORY_PAIR_FIXTURE;
+
+/* Returns 0 or the line it failed at; the fixture is then to be destroyed all the same. */
+extern int memory_pair_fixture_create(MEMORY_PAIR_FIXTURE* fixture, const MEMORY_PAIR_FIXTURE_CONFIG* config);
+/* The links created on the sessions are destroyed by the caller before. */
+extern void memory_pair_fixture_destroy(MEMORY_PAIR_FIXTURE* fixture);
+/* A client link sending to the server's ingress node. */
+extern LINK_HANDLE memory_pair_fixture_create_sender_link(MEMORY_PAIR_FIXTURE* fixture, const char* name, sender_settle_mode snd_settle_mode);
+/* For on_server_link_attached: the server end of a link the client attached, settling first. */
+extern LINK_HANDLE memory_pair_fixture_create_receiver_link(MEMORY_PAIR_FIXTURE* fixture, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MEMORY_PAIR_FIXTURE_H */
@@ -0,0 +1,434 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* An unsettled sender keeps OUTSTANDING_MESSAGE_COUNT copies of one message in flight to a receiver joined to it by memory pair IOs,
+   once for each of a few message shapes, and reports the throughput. When built with memory_trace it also reports how many
+   allocations each messagesender_send call makes, which covers encoding the message and handing it to the link, and fails
+   when that is more than MAX_ALLOCATIONS_PER_SEND. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "memory_pair_fixture/memory_pair_fixture.h"
+
+#define OUTSTANDING_MESSAGE_COUNT 1000
+#define TEST_RUNTIME 3000 // ms
+/* cloning the message and the transfer frame the link builds allocate on every send; the message sender itself
+   reuses its message and encode buffer once the first messages are settled */
+#define MAX_ALLOCATIONS_PER_SEND 48
+
+typedef enum MESSAGE_SHAPE_TAG
+{
+	MESSAGE_SHAPE_DATA,
+	MESSAGE_SHAPE_DATA_WITH_SECTIONS,
+	MESSAGE_SHAPE_VALUE
+} MESSAGE_SHAPE;
+
+typedef struct SERVER_CONNECTED_CLIENT_TAG
+{
+	LINK_HANDLE link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+	size_t messages_received;
+} SERVER_CONNECTED_CLIENT;
+
+typedef struct CLIENT_TAG
+{
+	MEMORY_PAIR_FIXTURE fixture;
+	LINK_HANDLE link;
+	MESSAGE_SENDER_HANDLE message_sender;
+	MESSAGE_HANDLE message;
+	size_t outstanding_message_count;
+	size_t messages_sent;
+	size_t allocation_count;
+	size_t messages_settled;
+	bool is_send_failed;
+	SERVER_CONNECTED_CLIENT server;
+} CLIENT;
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	(void)message;
+
+	server_connected_client->messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	CLIENT* client = (CLIENT*)context;
+	bool result;
+
+	client->server.link = memory_pair_fixture_create_receiver_link(&client->fixture, new_link_endpoint, name, role, source, target);
+	if (client->server.link == NULL)
+	{
+		result = false;
+	}
+	else
+	{
+		client->server.message_receiver = messagereceiver_create(client->server.link, NULL, NULL);
+		if (client->server.message_receiver == NULL)
+		{
+			LogError("Cannot create message receiver");
+			result = false;
+		}
+		else if (messagereceiver_open(client->server.message_receiver, on_message_received, &client->server) != 0)
+		{
+			LogError("Cannot open message receiver");
+			result = false;
+		}
+		else
+		{
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	CLIENT* client = (CLIENT*)context;
+
+	if (send_result != MESSAGE_SEND_OK)
+	{
+		client->is_send_failed = true;
+	}
+
+	client->outstanding_message_count--;
+	client->messages_settled++;
+}
+
+static int create_client(CLIENT* client)
+{
+	int result;
+
+	/* unsettled, so that every message needs a disposition from the receiver */
+	client->link = memory_pair_fixture_create_sender_link(&client->fixture, "sender-link", sender_settle_mode_unsettled);
+	if (client->link == NULL)
+	{
+		result = __LINE__;
+	}
+	else
+	{
+		client->message_sender = messagesender_create(client->link, NULL, NULL);
+		if ((client->message_sender == NULL) ||
+			(messagesender_open(client->message_sender) != 0))
+		{
+			LogError("Cannot open client message sender");
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static void destroy_client(CLIENT* client)
+{
+	if (client->message_sender != NULL)
+	{
+		messagesender_destroy(client->message_sender);
+	}
+
+	if (client->link != NULL)
+	{
+		link_destroy(client->link);
+	}
+
+	if (client->server.message_receiver != NULL)
+	{
+		messagereceiver_destroy(client->server.message_receiver);
+	}
+
+	if (client->server.link != NULL)
+	{
+		link_destroy(client->server.link);
+	}
+
+	memory_pair_fixture_destroy(&client->fixture);
+}
+
+static int add_message_sections(MESSAGE_HANDLE message)
+{
+	int result;
+	HEADER_HANDLE header = header_create();
+	PROPERTIES_HANDLE properties = properties_create();
+	AMQP_VALUE application_properties = amqpvalue_create_map();
+	AMQP_VALUE key = amqpvalue_create_string("key");
+	AMQP_VALUE value = amqpvalue_create_string("value");
+
+	if ((header == NULL) ||
+		(properties == NULL) ||
+		(application_properties == NULL) ||
+		(key == NULL) ||
+		(value == NULL) ||
+		(header_set_durable(header, true) != 0) ||
+		(properties_set_subject(properties, "hello") != 0) ||
+		(amqpvalue_set_map_value(application_properties, key, value) != 0) ||
+		(message_set_header(message, header) != 0) ||
+		(message_set_properties(message, properties) != 0) ||
+		(message_set_application_properties(message, application_properties) != 0))
+	{
+		LogError("Cannot set message sections");
+		result = __LINE__;
+	}
+	else
+	{
+		result = 0;
+	}
+
+	if (value != NULL)
+	{
+		amqpvalue_destroy(value);
+	}
+	if (key != NULL)
+	{
+		amqpvalue_destroy(key);
+	}
+	if (application_properties != NULL)
+	{
+		amqpvalue_destroy(application_properties);
+	}
+	if (properties != NULL)
+	{
+		properties_destroy(properties);
+	}
+	if (header != NULL)
+	{
+		header_destroy(header);
+	}
+
+	return result;
+}
+
+static MESSAGE_HANDLE create_message(MESSAGE_SHAPE message_shape)
+{
+	MESSAGE_HANDLE result = message_create();
+	if (result == NULL)
+	{
+		LogError("Error creating message");
+	}
+	else
+	{
+		int set_result;
+
+		if (message_shape == MESSAGE_SHAPE_VALUE)
+		{
+			AMQP_VALUE body = amqpvalue_create_string("Hello");
+			if (body == NULL)
+			{
+				set_result = __LINE__;
+			}
+			else
+			{
+				set_result = message_set_body_amqp_value(result, body);
+				amqpvalue_destroy(body);
+			}
+		}
+		else
+		{
+			unsigned char hello[] = { 'H', 'e', 'l', 'l', 'o' };
+			BINARY_DATA binary_data;
+
+			binary_data.bytes = hello;
+			binary_data.length = sizeof(hello);
+
+			set_result = message_add_body_amqp_data(result, binary_data);
+			if ((set_result == 0) &&
+				(message_shape == MESSAGE_SHAPE_DATA_WITH_SECTIONS))
+			{
+				set_result = add_message_sections(result);
+			}
+		}
+
+		if (set_result != 0)
+		{
+			LogError("Error setting message body");
+			message_destroy(result);
+			result = NULL;
+		}
+	}
+
+	return result;
+}
+
+static int send_messages(CLIENT* client)
+{
+	int result = 0;
+
+	while ((result == 0) &&
+		(client->outstanding_message_count < OUTSTANDING_MESSAGE_COUNT))
+	{
+#ifdef GB_MEASURE_MEMORY_FOR_THIS
+		size_t allocation_count = gballoc_getAllocationCount();
+#endif
+
+		client->outstanding_message_count++;
+
+		if (messagesender_send(client->message_sender, client->message, on_message_send_complete, client) != 0)
+		{
+			client->outstanding_message_count--;
+			LogError("Error sending message");
+			result = __LINE__;
+		}
+		else
+		{
+#ifdef GB_MEASURE_MEMORY_FOR_THIS
+			client->allocation_count += gballoc_getAllocationCount() - allocation_count;
+#endif
+			client->messages_sent++;
+		}
+	}
+
+	return result;
+}
+
+static int run_exchange(const char* description, MESSAGE_SHAPE message_shape, TICK_COUNTER_HANDLE tick_counter)
+{
+	int result;
+	CLIENT client;
+	MEMORY_PAIR_FIXTURE_CONFIG fixture_config;
+
+	(void)memset(&client, 0, sizeof(client));
+
+	fixture_config.server_max_frame_size = 0;
+	fixture_config.server_incoming_window = 10000;
+	fixture_config.on_server_link_attached = on_new_link_attached;
+	fixture_config.on_server_link_attached_context = &client;
+
+	client.message = create_message(message_shape);
+	if (client.message == NULL)
+	{
+		result = __LINE__;
+	}
+	else if (((result = memory_pair_fixture_create(&client.fixture, &fixture_config)) == 0) &&
+		((result = create_client(&client)) == 0))
+	{
+		tickcounter_ms_t start_ms = 0;
+		tickcounter_ms_t current_ms = 0;
+
+		if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+		{
+			LogError("Cannot get tick counter value");
+			result = __LINE__;
+		}
+
+		current_ms = start_ms;
+
+		while ((result == 0) &&
+			(current_ms - start_ms <= TEST_RUNTIME))
+		{
+			connection_dowork(client.fixture.client_connection);
+			result = send_messages(&client);
+			connection_dowork(client.fixture.server_connection);
+
+			if ((result == 0) &&
+				(client.is_send_failed))
+			{
+				LogError("Message send failed");
+				result = __LINE__;
+			}
+
+			if ((result == 0) &&
+				(tickcounter_get_current_ms(tick_counter, &current_ms) != 0))
+			{
+				LogError("Cannot get tick counter value");
+				result = __LINE__;
+			}
+		}
+
+		if (result == 0)
+		{
+#ifdef GB_MEASURE_MEMORY_FOR_THIS
+			double allocations_per_send = (client.messages_sent == 0) ? 0.0 : (double)client.allocation_count / (double)client.messages_sent;
+
+			LogInfo("%s: %.0f messages/s, %.1f allocations per send",
+				description,
+				client.messages_settled / (((double)current_ms - start_ms) / 1000),
+				allocations_per_send);
+
+			if (allocations_per_send > MAX_ALLOCATIONS_PER_SEND)
+			{
+				LogError("%s: %.1f allocations per send, more than %u", description, allocations_per_send, (unsigned int)MAX_ALLOCATIONS_PER_SEND);
+				result = __LINE__;
+			}
+#else
+			LogInfo("%s: %.0f messages/s",
+				description,
+				client.messages_settled / (((double)current_ms - start_ms) / 1000));
+#endif
+		}
+	}
+
+	destroy_client(&client);
+
+	if (client.message != NULL)
+	{
+		message_destroy(client.message);
+	}
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		TICK_COUNTER_HANDLE tick_counter;
+
+#ifdef GB_MEASURE_MEMORY_FOR_THIS
+		(void)gballoc_init();
+#endif
+
+		tick_counter = tickcounter_create();
+		if (tick_counter == NULL)
+		{
+			LogError("Cannot create tick counter");
+			result = __LINE__;
+		}
+		else
+		{
+			result = run_exchange("Data body", MESSAGE_SHAPE_DATA, tick_counter);
+			if (result == 0)
+			{
+				result = run_exchange("Data body, header, properties and application properties", MESSAGE_SHAPE_DATA_WITH_SECTIONS, tick_counter);
+			}
+			if (result == 0)
+			{
+				result = run_exchange("AMQP value body", MESSAGE_SHAPE_VALUE, tick_counter);
+			}
+
+			tickcounter_destroy(tick_counter);
+		}
+
+#ifdef GB_MEASURE_MEMORY_FOR_THIS
+		gballoc_deinit();
+#endif
+
+		platform_deinit();
+	}
+
+	return result;
+}
@@ -0,0 +1,657 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/message_receiver.h"
+
+#define TEST_LINK_HANDLE				(LINK_HANDLE)0x4242
+#define TEST_MESSAGE_HANDLE				(MESSAGE_HANDLE)0x4243
+#define TEST_DECODER_HANDLE				(AMQPVALUE_DECODER_HANDLE)0x4244
+#define TEST_DECODED_VALUE				(AMQP_VALUE)0x4245
+#define TEST_DESCRIPTOR					(AMQP_VALUE)0x4246
+#define TEST_DESCRIBED_VALUE			(AMQP_VALUE)0x4247
+#define TEST_HEADER_HANDLE				(HEADER_HANDLE)0x4248
+#define TEST_PROPERTIES_HANDLE			(PROPERTIES_HANDLE)0x4249
+#define TEST_TRANSFER_HANDLE			(TRANSFER_HANDLE)0x424A
+#define TEST_DELIVERY_STATE				(AMQP_VALUE)0x424B
+#define TEST_MAX_EVENTS					16
+#define TEST_MAX_DECODED_SECTIONS		4
+#define TEST_MAX_RECEIVED_BYTES			64
+
+/* what the application and the message saw, in order */
+typedef enum TEST_EVENT_TAG
+{
+    TEST_EVENT_HEADER_SET,
+    TEST_EVENT_PROPERTIES_SET,
+    TEST_EVENT_FOOTER_SET,
+    TEST_EVENT_SECTIONS_RECEIVED,
+    TEST_EVENT_BODY_DATA_RECEIVED,
+    TEST_EVENT_MESSAGE_RECEIVED
+} TEST_EVENT;
+
+/* a section the value decoder reports once it has been fed up to end_offset bytes since it was created */
+typedef struct TEST_DECODED_SECTION_TAG
+{
+    size_t end_offset;
+    uint64_t section_code;
+} TEST_DECODED_SECTION;
+
+static TEST_EVENT test_events[TEST_MAX_EVENTS];
+static size_t test_event_count;
+
+static ON_TRANSFER_CHUNK_RECEIVED saved_on_transfer_chunk_received;
+static void* saved_link_callback_context;
+static bool test_transfer_aborted;
+
+static ON_VALUE_DECODED saved_on_value_decoded;
+static void* saved_on_value_decoded_context;
+static TEST_DECODED_SECTION test_decoded_sections[TEST_MAX_DECODED_SECTIONS];
+static size_t test_decoded_section_count;
+static size_t next_decoded_section;
+static size_t decoded_byte_count;
+static uint64_t decoded_section_code;
+static size_t decoder_create_count;
+static size_t decoder_destroy_count;
+static size_t message_create_count;
+static size_t message_destroy_count;
+
+/* the body bytes, with the data section index of each */
+static unsigned char received_body_bytes[TEST_MAX_RECEIVED_BYTES];
+static uint32_t received_data_section_indexes[TEST_MAX_RECEIVED_BYTES];
+static size_t received_body_byte_count;
+static size_t body_data_call_count;
+
+static void add_test_event(TEST_EVENT test_event)
+{
+    ASSERT_IS_TRUE(test_event_count < TEST_MAX_EVENTS);
+    test_events[test_event_count++] = test_event;
+}
+
+static int my_link_set_on_transfer_chunk_received(LINK_HANDLE link, ON_TRANSFER_CHUNK_RECEIVED on_transfer_chunk_received)
+{
+    (void)link;
+    saved_on_transfer_chunk_received = on_transfer_chunk_received;
+    return 0;
+}
+
+static int my_link_attach(LINK_HANDLE link, ON_TRANSFER_RECEIVED on_transfer_received, ON_LINK_STATE_CHANGED on_link_state_changed, ON_LINK_FLOW_ON on_link_flow_on, void* callback_context)
+{
+    (void)link;
+    (void)on_transfer_received;
+    (void)on_link_state_changed;
+    (void)on_link_flow_on;
+    saved_link_callback_context = callback_context;
+    return 0;
+}
+
+static int my_transfer_get_aborted(TRANSFER_HANDLE transfer, bool* aborted_value)
+{
+    (void)transfer;
+    *aborted_value = test_transfer_aborted;
+    return 0;
+}
+
+static MESSAGE_HANDLE my_message_create(void)
+{
+    message_create_count++;
+    return TEST_MESSAGE_HANDLE;
+}
+
+static void my_message_destroy(MESSAGE_HANDLE message)
+{
+    (void)message;
+    message_destroy_count++;
+}
+
+static int my_message_get_body_type(MESSAGE_HANDLE message, MESSAGE_BODY_TYPE* body_type)
+{
+    (void)message;
+    *body_type = MESSAGE_BODY_TYPE_NONE;
+    return 0;
+}
+
+static int my_message_set_header(MESSAGE_HANDLE message, HEADER_HANDLE message_header)
+{
+    (void)message;
+    (void)message_header;
+    add_test_event(TEST_EVENT_HEADER_SET);
+    return 0;
+}
+
+static int my_message_set_properties(MESSAGE_HANDLE message, PROPERTIES_HANDLE properties)
+{
+    (void)message;
+    (void)properties;
+    add_test_event(TEST_EVENT_PROPERTIES_SET);
+    return 0;
+}
+
+static int my_message_set_footer(MESSAGE_HANDLE message, annotations footer)
+{
+    (void)message;
+    (void)footer;
+    add_test_event(TEST_EVENT_FOOTER_SET);
+    return 0;
+}
+
+static AMQPVALUE_DECODER_HANDLE my_amqpvalue_decoder_create(ON_VALUE_DECODED on_value_decoded, void* callback_context)
+{
+    saved_on_value_decoded = on_value_decoded;
+    saved_on_value_decoded_context = callback_context;
+    decoded_byte_count = 0;
+    next_decoded_section = 0;
+    decoder_create_count++;
+    return TEST_DECODER_HANDLE;
+}
+
+static void my_amqpvalue_decoder_destroy(AMQPVALUE_DECODER_HANDLE handle)
+{
+    (void)handle;
+    decoder_destroy_count++;
+}
+
+/* the sections are not decoded, each is reported once the decoder has been fed all of its bytes */
+static int my_amqpvalue_decode_bytes(AMQPVALUE_DECODER_HANDLE handle, const unsigned char* buffer, size_t size)
+{
+    (void)handle;
+    (void)buffer;
+    decoded_byte_count += size;
+
+    ASSERT_IS_TRUE(next_decoded_section < test_decoded_section_count);
+    ASSERT_IS_TRUE(decoded_byte_count <= test_decoded_sections[next_decoded_section].end_offset);
+    if (decoded_byte_count == test_decoded_sections[next_decoded_section].end_offset)
+    {
+        decoded_section_code = test_decoded_sections[next_decoded_section++].section_code;
+        saved_on_value_decoded(saved_on_value_decoded_context, TEST_DECODED_VALUE);
+    }
+
+    return 0;
+}
+
+static bool my_is_header_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (decoded_section_code == 0x70);
+}
+
+static bool my_is_properties_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (decoded_section_code == 0x73);
+}
+
+static bool my_is_footer_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (decoded_section_code == 0x78);
+}
+
+static int my_amqpvalue_get_header(AMQP_VALUE value, HEADER_HANDLE* header_handle)
+{
+    (void)value;
+    *header_handle = TEST_HEADER_HANDLE;
+    return 0;
+}
+
+static int my_amqpvalue_get_properties(AMQP_VALUE value, PROPERTIES_HANDLE* properties_handle)
+{
+    (void)value;
+    *properties_handle = TEST_PROPERTIES_HANDLE;
+    return 0;
+}
+
+static void test_on_message_sections_received(const void* context, MESSAGE_HANDLE message)
+{
+    (void)context;
+    ASSERT_ARE_EQUAL(void_ptr, TEST_MESSAGE_HANDLE, message);
+    add_test_event(TEST_EVENT_SECTIONS_RECEIVED);
+}
+
+static void test_on_message_body_data_received(const void* context, uint32_t data_section_index, const unsigned char* bytes, size_t length)
+{
+    size_t i;
+    (void)context;
+    ASSERT_IS_TRUE(received_body_byte_count + length <= TEST_MAX_RECEIVED_BYTES);
+    for (i = 0; i < length; i++)
+    {
+        received_body_bytes[received_body_byte_count] = bytes[i];
+        received_data_section_indexes[received_body_byte_count] = data_section_index;
+        received_body_byte_count++;
+    }
+    body_data_call_count++;
+
+    /* a body piece is one event however many pieces in a row */
+    if ((test_event_count == 0) ||
+        (test_events[test_event_count - 1] != TEST_EVENT_BODY_DATA_RECEIVED))
+    {
+        add_test_event(TEST_EVENT_BODY_DATA_RECEIVED);
+    }
+}
+
+static AMQP_VALUE test_on_streamed_message_received(const void* context, MESSAGE_HANDLE message)
+{
+    (void)context;
+    ASSERT_ARE_EQUAL(void_ptr, TEST_MESSAGE_HANDLE, message);
+    add_test_event(TEST_EVENT_MESSAGE_RECEIVED);
+    return TEST_DELIVERY_STATE;
+}
+
+static void add_decoded_section(size_t end_offset, uint64_t section_code)
+{
+    ASSERT_IS_TRUE(test_decoded_section_count < TEST_MAX_DECODED_SECTIONS);
+    test_decoded_sections[test_decoded_section_count].end_offset = end_offset;
+    test_decoded_sections[test_decoded_section_count].section_code = section_code;
+    test_decoded_section_count++;
+}
+
+static MESSAGE_RECEIVER_HANDLE create_streaming_message_receiver(void)
+{
+    MESSAGE_RECEIVER_HANDLE result = messagereceiver_create(TEST_LINK_HANDLE, NULL, NULL);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, 0, messagereceiver_open_streaming(result, test_on_message_sections_received, test_on_message_body_data_received, test_on_streamed_message_received, NULL));
+    ASSERT_IS_NOT_NULL(saved_on_transfer_chunk_received);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static AMQP_VALUE receive_chunk(const unsigned char* bytes, uint32_t size, bool more)
+{
+    return saved_on_transfer_chunk_received(saved_link_callback_context, TEST_TRANSFER_HANDLE, size, bytes, more);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(message_receiver_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(link_set_on_transfer_chunk_received, my_link_set_on_transfer_chunk_received);
+    REGISTER_GLOBAL_MOCK_HOOK(link_attach, my_link_attach);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_aborted, my_transfer_get_aborted);
+    REGISTER_GLOBAL_MOCK_HOOK(message_create, my_message_create);
+    REGISTER_GLOBAL_MOCK_HOOK(message_destroy, my_message_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_body_type, my_message_get_body_type);
+    REGISTER_GLOBAL_MOCK_HOOK(message_set_header, my_message_set_header);
+    REGISTER_GLOBAL_MOCK_HOOK(message_set_properties, my_message_set_properties);
+    REGISTER_GLOBAL_MOCK_HOOK(message_set_footer, my_message_set_footer);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_decoder_create, my_amqpvalue_decoder_create);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_decoder_destroy, my_amqpvalue_decoder_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_decode_bytes, my_amqpvalue_decode_bytes);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_inplace_descriptor, TEST_DESCRIPTOR);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_inplace_described_value, TEST_DESCRIBED_VALUE);
+    REGISTER_GLOBAL_MOCK_HOOK(is_header_type_by_descriptor, my_is_header_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_properties_type_by_descriptor, my_is_properties_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_footer_type_by_descriptor, my_is_footer_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_header, my_amqpvalue_get_header);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_properties, my_amqpvalue_get_properties);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(annotations, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HEADER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PROPERTIES_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_DECODER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_VALUE_DECODED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TRANSFER_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TRANSFER_CHUNK_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_FLOW_ON, void*);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    test_event_count = 0;
+    saved_on_transfer_chunk_received = NULL;
+    saved_link_callback_context = NULL;
+    test_transfer_aborted = false;
+    saved_on_value_decoded = NULL;
+    saved_on_value_decoded_context = NULL;
+    test_decoded_section_count = 0;
+    next_decoded_section = 0;
+    decoded_byte_count = 0;
+    decoded_section_code = 0;
+    decoder_create_count = 0;
+    decoder_destroy_count = 0;
+    message_create_count = 0;
+    message_destroy_count = 0;
+    received_body_byte_count = 0;
+    body_data_call_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* messagereceiver_open_streaming */
+
+TEST_FUNCTION(messagereceiver_open_streaming_with_NULL_message_receiver_fails)
+{
+    // arrange
+
+    // act
+    int result = messagereceiver_open_streaming(NULL, test_on_message_sections_received, test_on_message_body_data_received, test_on_streamed_message_received, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(messagereceiver_open_streaming_with_NULL_on_streamed_message_received_fails)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = messagereceiver_create(TEST_LINK_HANDLE, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    // act
+    result = messagereceiver_open_streaming(message_receiver, test_on_message_sections_received, test_on_message_body_data_received, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(messagereceiver_open_streaming_sets_the_chunk_callback_before_attaching_the_link)
+{
+    // arrange
+    MESSAGE_RECEIVER_HANDLE message_receiver = messagereceiver_create(TEST_LINK_HANDLE, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(link_set_on_transfer_chunk_received(TEST_LINK_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument_on_transfer_chunk_received();
+    STRICT_EXPECTED_CALL(link_attach(TEST_LINK_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, message_receiver))
+        .IgnoreArgument_on_transfer_received()
+        .IgnoreArgument_on_link_state_changed();
+
+    // act
+    result = messagereceiver_open_streaming(message_receiver, test_on_message_sections_received, test_on_message_body_data_received, test_on_streamed_message_received, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(saved_on_transfer_chunk_received);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+/* on_transfer_chunk_received */
+
+TEST_FUNCTION(a_vbin8_data_section_is_passed_to_the_application_and_the_message_completes_with_the_delivery)
+{
+    // arrange
+    static const unsigned char section[] = { 0x00, 0x53, 0x75, 0xA0, 0x03, 'a', 'b', 'c' };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+    AMQP_VALUE result;
+
+    // act
+    result = receive_chunk(section, sizeof(section), false);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DELIVERY_STATE, result);
+    ASSERT_ARE_EQUAL(size_t, 3, received_body_byte_count);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_body_bytes, "abc", 3));
+    ASSERT_ARE_EQUAL(uint32_t, 0, received_data_section_indexes[0]);
+    ASSERT_ARE_EQUAL(size_t, 3, test_event_count);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_SECTIONS_RECEIVED, (int)test_events[0]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_BODY_DATA_RECEIVED, (int)test_events[1]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_MESSAGE_RECEIVED, (int)test_events[2]);
+    /* data sections do not go through the value decoder */
+    ASSERT_ARE_EQUAL(size_t, 0, decoded_byte_count);
+    ASSERT_ARE_EQUAL(size_t, 1, message_destroy_count);
+    ASSERT_ARE_EQUAL(size_t, 1, decoder_destroy_count);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_vbin32_data_section_is_passed_to_the_application)
+{
+    // arrange
+    static const unsigned char section[] = { 0x00, 0x53, 0x75, 0xB0, 0x00, 0x00, 0x00, 0x03, 'a', 'b', 'c' };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+    AMQP_VALUE result;
+
+    // act
+    result = receive_chunk(section, sizeof(section), false);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DELIVERY_STATE, result);
+    ASSERT_ARE_EQUAL(size_t, 3, received_body_byte_count);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_body_bytes, "abc", 3));
+    ASSERT_ARE_EQUAL(size_t, 3, test_event_count);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_MESSAGE_RECEIVED, (int)test_events[2]);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(consecutive_data_sections_are_passed_with_their_index)
+{
+    // arrange
+    static const unsigned char sections[] =
+    {
+        0x00, 0x53, 0x75, 0xA0, 0x02, 'a', 'b',
+        0x00, 0x53, 0x75, 0xB0, 0x00, 0x00, 0x00, 0x01, 'c'
+    };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    (void)receive_chunk(sections, sizeof(sections), false);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, received_body_byte_count);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_body_bytes, "abc", 3));
+    ASSERT_ARE_EQUAL(uint32_t, 0, received_data_section_indexes[0]);
+    ASSERT_ARE_EQUAL(uint32_t, 0, received_data_section_indexes[1]);
+    ASSERT_ARE_EQUAL(uint32_t, 1, received_data_section_indexes[2]);
+    ASSERT_ARE_EQUAL(size_t, 2, body_data_call_count);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_section_header_split_across_frames_is_parsed_once_it_is_complete)
+{
+    // arrange
+    static const unsigned char frame_1[] = { 0x00, 0x53 };
+    static const unsigned char frame_2[] = { 0x75, 0xB0, 0x00, 0x00 };
+    static const unsigned char frame_3[] = { 0x00, 0x03, 'a' };
+    static const unsigned char frame_4[] = { 'b', 'c' };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+
+    // act
+    ASSERT_IS_NULL(receive_chunk(frame_1, sizeof(frame_1), true));
+    ASSERT_IS_NULL(receive_chunk(frame_2, sizeof(frame_2), true));
+    ASSERT_ARE_EQUAL(size_t, 0, test_event_count);
+    ASSERT_IS_NULL(receive_chunk(frame_3, sizeof(frame_3), true));
+    ASSERT_ARE_EQUAL(size_t, 1, received_body_byte_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DELIVERY_STATE, receive_chunk(frame_4, sizeof(frame_4), false));
+
+    // assert
+    /* one message for the whole delivery, the body handed over a frame at a time */
+    ASSERT_ARE_EQUAL(size_t, 1, message_create_count);
+    ASSERT_ARE_EQUAL(size_t, 1, decoder_create_count);
+    ASSERT_ARE_EQUAL(size_t, 2, body_data_call_count);
+    ASSERT_ARE_EQUAL(size_t, 3, received_body_byte_count);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(received_body_bytes, "abc", 3));
+    ASSERT_ARE_EQUAL(size_t, 3, test_event_count);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_MESSAGE_RECEIVED, (int)test_events[2]);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(the_header_and_properties_are_in_the_message_before_the_first_body_bytes)
+{
+    // arrange
+    static const unsigned char frame_1[] =
+    {
+        0x00, 0x53, 0x70, 0x45,
+        0x00, 0x53, 0x73, 0xC0, 0x02, 0x01, 0x40
+    };
+    static const unsigned char frame_2[] = { 0x00, 0x53, 0x75, 0xA0, 0x01, 'x' };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+    add_decoded_section(4, 0x70);
+    add_decoded_section(11, 0x73);
+
+    // act
+    (void)receive_chunk(frame_1, sizeof(frame_1), true);
+    (void)receive_chunk(frame_2, sizeof(frame_2), false);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 11, decoded_byte_count);
+    ASSERT_ARE_EQUAL(size_t, 5, test_event_count);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_HEADER_SET, (int)test_events[0]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_PROPERTIES_SET, (int)test_events[1]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_SECTIONS_RECEIVED, (int)test_events[2]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_BODY_DATA_RECEIVED, (int)test_events[3]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_MESSAGE_RECEIVED, (int)test_events[4]);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(a_footer_after_the_body_is_decoded_and_in_the_completed_message)
+{
+    // arrange
+    static const unsigned char sections[] =
+    {
+        0x00, 0x53, 0x75, 0xA0, 0x01, 'x',
+        0x00, 0x53, 0x78, 0xC1, 0x01, 0x00
+    };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+    add_decoded_section(6, 0x78);
+
+    // act
+    (void)receive_chunk(sections, sizeof(sections), false);
+
+    // assert
+    /* only the footer goes to the value decoder, and only up to its end */
+    ASSERT_ARE_EQUAL(size_t, 6, decoded_byte_count);
+    ASSERT_ARE_EQUAL(size_t, 1, received_body_byte_count);
+    ASSERT_ARE_EQUAL(size_t, 4, test_event_count);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_SECTIONS_RECEIVED, (int)test_events[0]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_BODY_DATA_RECEIVED, (int)test_events[1]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_FOOTER_SET, (int)test_events[2]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_MESSAGE_RECEIVED, (int)test_events[3]);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+TEST_FUNCTION(an_aborted_delivery_drops_the_partial_message_and_the_next_delivery_starts_over)
+{
+    // arrange
+    static const unsigned char frame_1[] = { 0x00, 0x53, 0x75, 0xA0, 0x03, 'a' };
+    static const unsigned char frame_2[] = { 0x00, 0x53, 0x75, 0xA0, 0x01, 'z' };
+    MESSAGE_RECEIVER_HANDLE message_receiver = create_streaming_message_receiver();
+    AMQP_VALUE result;
+    (void)receive_chunk(frame_1, sizeof(frame_1), true);
+    test_transfer_aborted = true;
+
+    // act
+    result = receive_chunk(NULL, 0, false);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 1, message_destroy_count);
+    ASSERT_ARE_EQUAL(size_t, 1, decoder_destroy_count);
+    ASSERT_ARE_EQUAL(size_t, 2, test_event_count);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_BODY_DATA_RECEIVED, (int)test_events[1]);
+
+    /* the next delivery is a new message, not the rest of the section cut short */
+    test_transfer_aborted = false;
+    received_body_byte_count = 0;
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DELIVERY_STATE, receive_chunk(frame_2, sizeof(frame_2), false));
+    ASSERT_ARE_EQUAL(size_t, 2, message_create_count);
+    ASSERT_ARE_EQUAL(size_t, 1, received_body_byte_count);
+    ASSERT_ARE_EQUAL(int, 'z', received_body_bytes[0]);
+    ASSERT_ARE_EQUAL(uint32_t, 0, received_data_section_indexes[0]);
+    ASSERT_ARE_EQUAL(int, (int)TEST_EVENT_MESSAGE_RECEIVED, (int)test_events[test_event_count - 1]);
+
+    // cleanup
+    messagereceiver_destroy(message_receiver);
+}
+
+END_TEST_SUITE(message_receiver_ut)
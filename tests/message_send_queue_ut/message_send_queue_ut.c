@@ -0,0 +1,460 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_uamqp_c/message.h"
+#include "azure_uamqp_c/message_sender.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/message_send_queue.h"
+
+#define TEST_MESSAGE_SENDER_HANDLE		(MESSAGE_SENDER_HANDLE)0x4242
+#define TEST_MESSAGE_1					(MESSAGE_HANDLE)0x4243
+#define TEST_MESSAGE_2					(MESSAGE_HANDLE)0x4244
+#define TEST_MESSAGE_3					(MESSAGE_HANDLE)0x4245
+#define TEST_CONTEXT					(void*)0x4444
+#define TEST_EXECUTOR_CONTEXT			(void*)0x4445
+#define TEST_MAX_SAVED_SEND_COUNT		4
+
+static ON_MESSAGE_SEND_COMPLETE saved_on_message_send_complete;
+static void* saved_callback_context;
+static void* saved_callback_contexts[TEST_MAX_SAVED_SEND_COUNT];
+static size_t saved_send_count;
+
+MOCK_FUNCTION_WITH_CODE(, void, test_on_message_send_complete, void*, context, MESSAGE_SEND_RESULT, send_result)
+MOCK_FUNCTION_END();
+MOCK_FUNCTION_WITH_CODE(, void, test_on_message_send_complete_execute, void*, executor_context, ON_MESSAGE_SEND_COMPLETE, on_message_send_complete, void*, callback_context, MESSAGE_SEND_RESULT, send_result)
+MOCK_FUNCTION_END();
+
+static int my_messagesender_send(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context)
+{
+    (void)message_sender;
+    (void)message;
+    saved_on_message_send_complete = on_message_send_complete;
+    saved_callback_context = callback_context;
+    if (saved_send_count < TEST_MAX_SAVED_SEND_COUNT)
+    {
+        saved_callback_contexts[saved_send_count++] = callback_context;
+    }
+    return 0;
+}
+
+/* what the I/O thread would read off the wake fd, 0 when nothing woke it */
+static uint64_t read_wake_counter(MESSAGE_SEND_QUEUE_HANDLE message_send_queue)
+{
+    uint64_t result;
+
+    if (read(messagesendqueue_get_wake_fd(message_send_queue), &result, sizeof(result)) != (ssize_t)sizeof(result))
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(message_send_queue_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(messagesender_send, my_messagesender_send);
+
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_SENDER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_MESSAGE_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_SEND_RESULT, int);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    saved_on_message_send_complete = NULL;
+    saved_callback_context = NULL;
+    saved_send_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* messagesendqueue_create */
+
+TEST_FUNCTION(messagesendqueue_create_allocates_the_queue_and_its_wake_fd)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+
+    // assert
+    ASSERT_IS_NOT_NULL(message_send_queue);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(messagesendqueue_get_wake_fd(message_send_queue) >= 0);
+    ASSERT_ARE_EQUAL(uint64_t, 0, read_wake_counter(message_send_queue));
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(messagesendqueue_create_with_NULL_message_sender_fails)
+{
+    // arrange
+
+    // act
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(NULL, NULL, NULL);
+
+    // assert
+    ASSERT_IS_NULL(message_send_queue);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(when_allocating_the_queue_fails_messagesendqueue_create_fails)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+
+    // assert
+    ASSERT_IS_NULL(message_send_queue);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* messagesendqueue_submit */
+
+TEST_FUNCTION(messagesendqueue_submit_queues_the_message_and_signals_the_wake_fd)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    result = messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 1, read_wake_counter(message_send_queue));
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(messagesendqueue_submit_signals_the_wake_fd_only_once_until_dowork)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+
+    // act
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_2, test_on_message_send_complete, TEST_CONTEXT);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_3, test_on_message_send_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 1, read_wake_counter(message_send_queue));
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(messagesendqueue_submit_after_dowork_signals_the_wake_fd_again)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+    messagesendqueue_dowork(message_send_queue);
+    saved_on_message_send_complete(saved_callback_context, MESSAGE_SEND_OK);
+
+    // act
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_2, test_on_message_send_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 1, read_wake_counter(message_send_queue));
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(messagesendqueue_submit_with_NULL_queue_fails)
+{
+    // arrange
+
+    // act
+    int result = messagesendqueue_submit(NULL, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(messagesendqueue_submit_with_NULL_message_fails)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    // act
+    result = messagesendqueue_submit(message_send_queue, NULL, test_on_message_send_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 0, read_wake_counter(message_send_queue));
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(when_allocating_the_submitted_send_fails_messagesendqueue_submit_fails)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    int result;
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    result = messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 0, read_wake_counter(message_send_queue));
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+/* messagesendqueue_dowork */
+
+TEST_FUNCTION(messagesendqueue_dowork_hands_the_submitted_messages_to_the_sender_in_order)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_2, test_on_message_send_complete, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, TEST_MESSAGE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_1));
+    STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, TEST_MESSAGE_2, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_2));
+
+    // act
+    messagesendqueue_dowork(message_send_queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 0, read_wake_counter(message_send_queue));
+
+    // cleanup
+    saved_on_message_send_complete(saved_callback_contexts[0], MESSAGE_SEND_OK);
+    saved_on_message_send_complete(saved_callback_contexts[1], MESSAGE_SEND_OK);
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(messagesendqueue_dowork_with_nothing_submitted_does_not_send)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    // act
+    messagesendqueue_dowork(message_send_queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(when_messagesender_send_fails_the_submitted_message_completes_with_an_error)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, TEST_MESSAGE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(test_on_message_send_complete(TEST_CONTEXT, MESSAGE_SEND_ERROR));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_1));
+
+    // act
+    messagesendqueue_dowork(message_send_queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+/* completions */
+
+TEST_FUNCTION(without_an_executor_the_send_completion_is_called_directly)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+    messagesendqueue_dowork(message_send_queue);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_message_send_complete(TEST_CONTEXT, MESSAGE_SEND_OK));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    saved_on_message_send_complete(saved_callback_context, MESSAGE_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(with_an_executor_the_send_completion_is_handed_to_the_executor)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, test_on_message_send_complete_execute, TEST_EXECUTOR_CONTEXT);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+    messagesendqueue_dowork(message_send_queue);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_message_send_complete_execute(TEST_EXECUTOR_CONTEXT, test_on_message_send_complete, TEST_CONTEXT, MESSAGE_SEND_ERROR));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    saved_on_message_send_complete(saved_callback_context, MESSAGE_SEND_ERROR);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    messagesendqueue_destroy(message_send_queue);
+}
+
+TEST_FUNCTION(a_completion_arriving_after_messagesendqueue_destroy_still_reaches_the_executor)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, test_on_message_send_complete_execute, TEST_EXECUTOR_CONTEXT);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, TEST_CONTEXT);
+    messagesendqueue_dowork(message_send_queue);
+    messagesendqueue_destroy(message_send_queue);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_on_message_send_complete_execute(TEST_EXECUTOR_CONTEXT, test_on_message_send_complete, TEST_CONTEXT, MESSAGE_SEND_OK));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    saved_on_message_send_complete(saved_callback_context, MESSAGE_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* messagesendqueue_destroy */
+
+TEST_FUNCTION(messagesendqueue_destroy_fails_the_messages_that_were_not_handed_to_the_sender)
+{
+    // arrange
+    MESSAGE_SEND_QUEUE_HANDLE message_send_queue = messagesendqueue_create(TEST_MESSAGE_SENDER_HANDLE, NULL, NULL);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_1, test_on_message_send_complete, (void*)1);
+    (void)messagesendqueue_submit(message_send_queue, TEST_MESSAGE_2, test_on_message_send_complete, (void*)2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_1));
+    STRICT_EXPECTED_CALL(test_on_message_send_complete((void*)1, MESSAGE_SEND_ERROR));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_2));
+    STRICT_EXPECTED_CALL(test_on_message_send_complete((void*)2, MESSAGE_SEND_ERROR));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    messagesendqueue_destroy(message_send_queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(messagesendqueue_destroy_with_NULL_queue_does_not_crash)
+{
+    // arrange
+
+    // act
+    messagesendqueue_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(message_send_queue_ut)
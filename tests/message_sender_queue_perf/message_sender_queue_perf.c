@@ -0,0 +1,286 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* An unsettled sender keeps a fixed number of messages queued in the message sender, connected to a receiver by memory pair IOs.
+   The receiver's link credit caps how many of them are on the wire, so the rest wait in the sender's unsent queue.
+   Running with a small and a large backlog shows whether the cost of queueing, sending and settling depends on the backlog size. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+#include "memory_pair_fixture/memory_pair_fixture.h"
+
+#define SMALL_OUTSTANDING_MESSAGE_COUNT 1000
+#define LARGE_OUTSTANDING_MESSAGE_COUNT 50000
+#define TEST_RUNTIME 3000 // ms
+
+typedef struct SERVER_CONNECTED_CLIENT_TAG
+{
+	LINK_HANDLE link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+	size_t messages_received;
+} SERVER_CONNECTED_CLIENT;
+
+typedef struct CLIENT_TAG
+{
+	MEMORY_PAIR_FIXTURE fixture;
+	LINK_HANDLE link;
+	MESSAGE_SENDER_HANDLE message_sender;
+	size_t max_outstanding_message_count;
+	size_t outstanding_message_count;
+	size_t messages_settled;
+	bool is_send_failed;
+	SERVER_CONNECTED_CLIENT server;
+} CLIENT;
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	(void)message;
+
+	server_connected_client->messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	CLIENT* client = (CLIENT*)context;
+	bool result;
+
+	client->server.link = memory_pair_fixture_create_receiver_link(&client->fixture, new_link_endpoint, name, role, source, target);
+	if (client->server.link == NULL)
+	{
+		result = false;
+	}
+	else
+	{
+		client->server.message_receiver = messagereceiver_create(client->server.link, NULL, NULL);
+		if (client->server.message_receiver == NULL)
+		{
+			LogError("Cannot create message receiver");
+			result = false;
+		}
+		else if (messagereceiver_open(client->server.message_receiver, on_message_received, &client->server) != 0)
+		{
+			LogError("Cannot open message receiver");
+			result = false;
+		}
+		else
+		{
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	CLIENT* client = (CLIENT*)context;
+
+	if (send_result != MESSAGE_SEND_OK)
+	{
+		client->is_send_failed = true;
+	}
+
+	client->outstanding_message_count--;
+	client->messages_settled++;
+}
+
+static int create_client(CLIENT* client)
+{
+	int result;
+
+	/* unsettled, so that every message needs a disposition from the receiver */
+	client->link = memory_pair_fixture_create_sender_link(&client->fixture, "sender-link", sender_settle_mode_unsettled);
+	if (client->link == NULL)
+	{
+		result = __LINE__;
+	}
+	else
+	{
+		client->message_sender = messagesender_create(client->link, NULL, NULL);
+		if ((client->message_sender == NULL) ||
+			(messagesender_open(client->message_sender) != 0))
+		{
+			LogError("Cannot open client message sender");
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static void destroy_client(CLIENT* client)
+{
+	if (client->message_sender != NULL)
+	{
+		messagesender_destroy(client->message_sender);
+	}
+
+	if (client->link != NULL)
+	{
+		link_destroy(client->link);
+	}
+
+	if (client->server.message_receiver != NULL)
+	{
+		messagereceiver_destroy(client->server.message_receiver);
+	}
+
+	if (client->server.link != NULL)
+	{
+		link_destroy(client->server.link);
+	}
+
+	memory_pair_fixture_destroy(&client->fixture);
+}
+
+static int send_messages(CLIENT* client)
+{
+	int result = 0;
+
+	while ((result == 0) &&
+		(client->outstanding_message_count < client->max_outstanding_message_count))
+	{
+		MESSAGE_HANDLE message = message_create();
+		if (message == NULL)
+		{
+			LogError("Error creating message");
+			result = __LINE__;
+		}
+		else
+		{
+			unsigned char hello[] = { 'H', 'e', 'l', 'l', 'o' };
+			BINARY_DATA binary_data;
+
+			binary_data.bytes = hello;
+			binary_data.length = sizeof(hello);
+
+			client->outstanding_message_count++;
+
+			if ((message_add_body_amqp_data(message, binary_data) != 0) ||
+				(messagesender_send(client->message_sender, message, on_message_send_complete, client) != 0))
+			{
+				client->outstanding_message_count--;
+				LogError("Error sending message");
+				result = __LINE__;
+			}
+
+			message_destroy(message);
+		}
+	}
+
+	return result;
+}
+
+static int run_exchange(size_t max_outstanding_message_count, TICK_COUNTER_HANDLE tick_counter)
+{
+	int result;
+	CLIENT client;
+	MEMORY_PAIR_FIXTURE_CONFIG fixture_config;
+
+	(void)memset(&client, 0, sizeof(client));
+	client.max_outstanding_message_count = max_outstanding_message_count;
+
+	fixture_config.server_max_frame_size = 0;
+	fixture_config.server_incoming_window = 10000;
+	fixture_config.on_server_link_attached = on_new_link_attached;
+	fixture_config.on_server_link_attached_context = &client;
+
+	if (((result = memory_pair_fixture_create(&client.fixture, &fixture_config)) == 0) &&
+		((result = create_client(&client)) == 0))
+	{
+		tickcounter_ms_t start_ms = 0;
+		tickcounter_ms_t current_ms = 0;
+
+		if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+		{
+			LogError("Cannot get tick counter value");
+			result = __LINE__;
+		}
+
+		current_ms = start_ms;
+
+		while ((result == 0) &&
+			(current_ms - start_ms <= TEST_RUNTIME))
+		{
+			connection_dowork(client.fixture.client_connection);
+			result = send_messages(&client);
+			connection_dowork(client.fixture.server_connection);
+
+			if ((result == 0) &&
+				(client.is_send_failed))
+			{
+				LogError("Message send failed");
+				result = __LINE__;
+			}
+
+			if ((result == 0) &&
+				(tickcounter_get_current_ms(tick_counter, &current_ms) != 0))
+			{
+				LogError("Cannot get tick counter value");
+				result = __LINE__;
+			}
+		}
+
+		if (result == 0)
+		{
+			LogInfo("%u messages outstanding: %.0f messages/s, %u messages settled",
+				(unsigned int)max_outstanding_message_count,
+				client.messages_settled / (((double)current_ms - start_ms) / 1000),
+				(unsigned int)client.messages_settled);
+		}
+	}
+
+	destroy_client(&client);
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		TICK_COUNTER_HANDLE tick_counter = tickcounter_create();
+		if (tick_counter == NULL)
+		{
+			LogError("Cannot create tick counter");
+			result = __LINE__;
+		}
+		else
+		{
+			result = run_exchange(SMALL_OUTSTANDING_MESSAGE_COUNT, tick_counter);
+			if (result == 0)
+			{
+				result = run_exchange(LARGE_OUTSTANDING_MESSAGE_COUNT, tick_counter);
+			}
+
+			tickcounter_destroy(tick_counter);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}
@@ -0,0 +1,1137 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+
+/* allocations still live, and all the allocations made */
+static size_t allocation_count;
+static size_t malloc_count;
+/* set to a pointer to find out whether it is freed */
+static void* watched_pointer;
+static bool is_watched_pointer_freed;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result = malloc(size);
+    if (result != NULL)
+    {
+        allocation_count++;
+        malloc_count++;
+    }
+    return result;
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if ((ptr == NULL) && (result != NULL))
+    {
+        allocation_count++;
+        malloc_count++;
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    if (ptr != NULL)
+    {
+        allocation_count--;
+        if (ptr == watched_pointer)
+        {
+            is_watched_pointer_freed = true;
+        }
+    }
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_uamqp_c/amqpvalue.h"
+#include "azure_uamqp_c/amqpvalue_to_string.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/message_sender.h"
+
+#define TEST_LINK_HANDLE				(LINK_HANDLE)0x4242
+#define TEST_APPLICATION_PROPERTIES		(AMQP_VALUE)0x4243
+#define TEST_BODY_AMQP_VALUE			(AMQP_VALUE)0x4244
+#define TEST_MESSAGE_COUNT				300
+#define TEST_MAX_FREE_MESSAGE_COUNT		256
+#define TEST_MAX_TRANSFERS				16
+#define TEST_MAX_COMPLETIONS			16
+#define TEST_MAX_RECORDED_BYTES			16
+#define TEST_LARGE_ENCODED_SIZE			(70 * 1024)
+
+/* a transfer or transfer frame handed to the link, with the first bytes of its payloads put back together */
+typedef struct TEST_TRANSFER_TAG
+{
+    bool more;
+    ON_DELIVERY_SETTLED on_delivery_settled;
+    void* callback_context;
+    size_t payload_count;
+    const unsigned char* first_payload_bytes;
+    const unsigned char* last_payload_bytes;
+    unsigned char bytes[TEST_MAX_RECORDED_BYTES];
+    size_t length;
+} TEST_TRANSFER;
+
+typedef struct TEST_COMPLETION_TAG
+{
+    size_t message_index;
+    MESSAGE_SEND_RESULT send_result;
+} TEST_COMPLETION;
+
+/* the messages are not real: each handle is the address of its index, which is also the single byte of its body */
+static unsigned char test_messages[TEST_MESSAGE_COUNT];
+static MESSAGE_BODY_TYPE test_body_type;
+/* when set, the body of all messages */
+static BINARY_DATA test_body;
+static AMQP_VALUE test_application_properties;
+/* what amqpvalue_encode writes for any value */
+static const unsigned char* test_encoded_value;
+static size_t test_encoded_value_length;
+static unsigned char test_large_encoded_value[TEST_LARGE_ENCODED_SIZE];
+
+/* the link refuses transfers once it has taken this many */
+static size_t test_transfer_budget;
+static size_t link_transfer_call_count;
+static TEST_TRANSFER test_transfers[TEST_MAX_TRANSFERS];
+static size_t test_transfer_count;
+static ON_LINK_STATE_CHANGED saved_on_link_state_changed;
+static ON_LINK_FLOW_ON saved_on_link_flow_on;
+static void* saved_link_callback_context;
+static sender_settle_mode test_snd_settle_mode;
+static uint32_t test_frame_payload_size;
+static size_t link_abort_transfer_call_count;
+
+/* the body of a streamed message: the reader gives up to readable bytes of it, then fails or reads nothing */
+static const unsigned char* test_stream_body;
+static size_t test_stream_body_readable;
+static size_t test_stream_body_offset;
+static bool test_stream_body_read_fails;
+static size_t test_stream_body_read_count;
+
+static TEST_COMPLETION test_completions[TEST_MAX_COMPLETIONS];
+static size_t test_completion_count;
+static MESSAGE_SENDER_HANDLE resending_message_sender;
+
+static MESSAGE_HANDLE get_test_message(size_t index)
+{
+    return (MESSAGE_HANDLE)&test_messages[index];
+}
+
+static size_t get_test_message_index(void* context)
+{
+    return (size_t)((unsigned char*)context - test_messages);
+}
+
+static MESSAGE_HANDLE my_message_clone(MESSAGE_HANDLE source_message)
+{
+    return source_message;
+}
+
+static int my_message_get_body_type(MESSAGE_HANDLE message, MESSAGE_BODY_TYPE* body_type)
+{
+    (void)message;
+    *body_type = test_body_type;
+    return 0;
+}
+
+static int my_message_get_message_format(MESSAGE_HANDLE message, uint32_t* message_format)
+{
+    (void)message;
+    *message_format = 0;
+    return 0;
+}
+
+static int my_message_get_body_amqp_data_count(MESSAGE_HANDLE message, size_t* count)
+{
+    (void)message;
+    *count = 1;
+    return 0;
+}
+
+static int my_message_get_body_amqp_data_in_place(MESSAGE_HANDLE message, size_t index, BINARY_DATA* amqp_data)
+{
+    (void)index;
+    if (test_body.bytes != NULL)
+    {
+        *amqp_data = test_body;
+    }
+    else
+    {
+        amqp_data->bytes = (const unsigned char*)message;
+        amqp_data->length = 1;
+    }
+    return 0;
+}
+
+static int my_message_get_body_amqp_value_in_place(MESSAGE_HANDLE message, AMQP_VALUE* body_amqp_value)
+{
+    (void)message;
+    *body_amqp_value = TEST_BODY_AMQP_VALUE;
+    return 0;
+}
+
+static int my_message_get_application_properties(MESSAGE_HANDLE message, AMQP_VALUE* application_properties)
+{
+    (void)message;
+    *application_properties = test_application_properties;
+    return 0;
+}
+
+static int my_amqpvalue_encode(AMQP_VALUE value, AMQPVALUE_ENCODER_OUTPUT encoder_output, void* context)
+{
+    (void)value;
+    return encoder_output(context, test_encoded_value, test_encoded_value_length);
+}
+
+static int my_link_attach(LINK_HANDLE link, ON_TRANSFER_RECEIVED on_transfer_received, ON_LINK_STATE_CHANGED on_link_state_changed, ON_LINK_FLOW_ON on_link_flow_on, void* callback_context)
+{
+    (void)link;
+    (void)on_transfer_received;
+    saved_on_link_state_changed = on_link_state_changed;
+    saved_on_link_flow_on = on_link_flow_on;
+    saved_link_callback_context = callback_context;
+    return 0;
+}
+
+static int my_link_get_snd_settle_mode(LINK_HANDLE link, sender_settle_mode* snd_settle_mode)
+{
+    (void)link;
+    *snd_settle_mode = test_snd_settle_mode;
+    return 0;
+}
+
+/* takes the transfer while the link has budget for it */
+static LINK_TRANSFER_RESULT record_transfer(PAYLOAD* payloads, size_t payload_count, bool more, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+{
+    LINK_TRANSFER_RESULT result;
+
+    link_transfer_call_count++;
+
+    if (test_transfer_count == test_transfer_budget)
+    {
+        result = LINK_TRANSFER_BUSY;
+    }
+    else
+    {
+        TEST_TRANSFER* test_transfer;
+        size_t i;
+
+        ASSERT_IS_TRUE(test_transfer_count < TEST_MAX_TRANSFERS);
+        test_transfer = &test_transfers[test_transfer_count++];
+        test_transfer->more = more;
+        test_transfer->on_delivery_settled = on_delivery_settled;
+        test_transfer->callback_context = callback_context;
+        test_transfer->payload_count = payload_count;
+        test_transfer->first_payload_bytes = payloads[0].bytes;
+        test_transfer->last_payload_bytes = payloads[payload_count - 1].bytes;
+        test_transfer->length = 0;
+
+        for (i = 0; i < payload_count; i++)
+        {
+            size_t j;
+            for (j = 0; j < payloads[i].length; j++)
+            {
+                if (test_transfer->length < TEST_MAX_RECORDED_BYTES)
+                {
+                    test_transfer->bytes[test_transfer->length] = payloads[i].bytes[j];
+                }
+                test_transfer->length++;
+            }
+        }
+
+        result = LINK_TRANSFER_OK;
+    }
+
+    return result;
+}
+
+static LINK_TRANSFER_RESULT my_link_transfer(LINK_HANDLE handle, message_format message_format, PAYLOAD* payloads, size_t payload_count, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+{
+    (void)handle;
+    (void)message_format;
+    return record_transfer(payloads, payload_count, false, on_delivery_settled, callback_context);
+}
+
+static int my_link_get_transfer_frame_payload_size(LINK_HANDLE link, uint32_t* payload_size)
+{
+    (void)link;
+    *payload_size = test_frame_payload_size;
+    return 0;
+}
+
+static LINK_TRANSFER_RESULT my_link_transfer_frame(LINK_HANDLE link, message_format message_format, PAYLOAD* payloads, size_t payload_count, bool more, ON_DELIVERY_SETTLED on_delivery_settled, void* callback_context)
+{
+    (void)link;
+    (void)message_format;
+    return record_transfer(payloads, payload_count, more, on_delivery_settled, callback_context);
+}
+
+static int my_link_abort_transfer(LINK_HANDLE link)
+{
+    (void)link;
+    link_abort_transfer_call_count++;
+    return 0;
+}
+
+static int test_on_message_body_read(void* context, unsigned char* buffer, size_t size, size_t* bytes_read)
+{
+    int result;
+    size_t readable = test_stream_body_readable - test_stream_body_offset;
+    (void)context;
+
+    test_stream_body_read_count++;
+
+    if ((readable == 0) && test_stream_body_read_fails)
+    {
+        result = 1;
+    }
+    else
+    {
+        if (size > readable)
+        {
+            size = readable;
+        }
+        (void)memcpy(buffer, test_stream_body + test_stream_body_offset, size);
+        test_stream_body_offset += size;
+        *bytes_read = size;
+        result = 0;
+    }
+
+    return result;
+}
+
+static void test_on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+    ASSERT_IS_TRUE(test_completion_count < TEST_MAX_COMPLETIONS);
+    test_completions[test_completion_count].message_index = get_test_message_index(context);
+    test_completions[test_completion_count].send_result = send_result;
+    test_completion_count++;
+}
+
+/* sends the message again, under the index that follows it */
+static void test_on_message_send_complete_resend(void* context, MESSAGE_SEND_RESULT send_result)
+{
+    test_on_message_send_complete(context, send_result);
+    ASSERT_ARE_EQUAL(int, 0, messagesender_send(resending_message_sender, get_test_message(get_test_message_index(context) + 1), test_on_message_send_complete, get_test_message(get_test_message_index(context) + 1)));
+}
+
+static int send_test_message(MESSAGE_SENDER_HANDLE message_sender, size_t index)
+{
+    return messagesender_send(message_sender, get_test_message(index), test_on_message_send_complete, get_test_message(index));
+}
+
+/* the body of a message is the byte at its handle, handed to the link where it is */
+static size_t get_transfer_message_index(size_t index)
+{
+    return get_test_message_index((void*)test_transfers[index].last_payload_bytes);
+}
+
+static void settle_transfer(size_t index)
+{
+    test_transfers[index].on_delivery_settled(test_transfers[index].callback_context, (delivery_number)index, LINK_DELIVERY_SETTLE_REASON_SETTLED, NULL);
+}
+
+static int send_test_streamed_message(MESSAGE_SENDER_HANDLE message_sender, size_t index, const char* body)
+{
+    test_body_type = MESSAGE_BODY_TYPE_NONE;
+    test_stream_body = (const unsigned char*)body;
+    test_stream_body_readable = strlen(body);
+    return messagesender_send_streamed(message_sender, get_test_message(index), (uint32_t)strlen(body), test_on_message_body_read, NULL, test_on_message_send_complete, get_test_message(index));
+}
+
+static void assert_transfer_bytes(size_t index, const unsigned char* expected_bytes, size_t expected_length)
+{
+    ASSERT_ARE_EQUAL(size_t, expected_length, test_transfers[index].length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected_bytes, test_transfers[index].bytes, expected_length));
+}
+
+static size_t get_pending_message_count(MESSAGE_SENDER_HANDLE message_sender)
+{
+    size_t result;
+    ASSERT_ARE_EQUAL(int, 0, messagesender_get_pending_message_count(message_sender, &result));
+    return result;
+}
+
+static MESSAGE_SENDER_HANDLE create_open_message_sender(void)
+{
+    MESSAGE_SENDER_HANDLE result = messagesender_create(TEST_LINK_HANDLE, NULL, NULL);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, 0, messagesender_open(result));
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_ATTACHED, LINK_STATE_HALF_ATTACHED_ATTACH_SENT);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(message_sender_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(message_clone, my_message_clone);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_body_type, my_message_get_body_type);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_message_format, my_message_get_message_format);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_body_amqp_data_count, my_message_get_body_amqp_data_count);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_body_amqp_data_in_place, my_message_get_body_amqp_data_in_place);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_body_amqp_value_in_place, my_message_get_body_amqp_value_in_place);
+    REGISTER_GLOBAL_MOCK_HOOK(message_get_application_properties, my_message_get_application_properties);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, my_amqpvalue_encode);
+    REGISTER_GLOBAL_MOCK_HOOK(link_attach, my_link_attach);
+    REGISTER_GLOBAL_MOCK_HOOK(link_transfer, my_link_transfer);
+    REGISTER_GLOBAL_MOCK_HOOK(link_get_snd_settle_mode, my_link_get_snd_settle_mode);
+    REGISTER_GLOBAL_MOCK_HOOK(link_get_transfer_frame_payload_size, my_link_get_transfer_frame_payload_size);
+    REGISTER_GLOBAL_MOCK_HOOK(link_transfer_frame, my_link_transfer_frame);
+    REGISTER_GLOBAL_MOCK_HOOK(link_abort_transfer, my_link_abort_transfer);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQP_VALUE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HEADER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PROPERTIES_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(AMQPVALUE_ENCODER_OUTPUT, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_TRANSFER_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_STATE_CHANGED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_FLOW_ON, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_DELIVERY_SETTLED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LINK_TRANSFER_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(message_format, uint32_t);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    allocation_count = 0;
+    malloc_count = 0;
+    watched_pointer = NULL;
+    is_watched_pointer_freed = false;
+    test_body_type = MESSAGE_BODY_TYPE_DATA;
+    test_body.bytes = NULL;
+    test_body.length = 0;
+    test_application_properties = NULL;
+    test_encoded_value = NULL;
+    test_encoded_value_length = 0;
+    test_transfer_budget = SIZE_MAX;
+    test_snd_settle_mode = sender_settle_mode_unsettled;
+    test_frame_payload_size = 8;
+    link_abort_transfer_call_count = 0;
+    test_stream_body = NULL;
+    test_stream_body_readable = 0;
+    test_stream_body_offset = 0;
+    test_stream_body_read_fails = false;
+    test_stream_body_read_count = 0;
+    link_transfer_call_count = 0;
+    test_transfer_count = 0;
+    test_completion_count = 0;
+    resending_message_sender = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* messagesender_send */
+
+TEST_FUNCTION(a_message_refused_by_the_link_is_sent_before_the_messages_queued_after_it)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_transfer_budget = 1;
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 1));
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 2));
+    test_transfer_budget = SIZE_MAX;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 0, get_transfer_message_index(0));
+    ASSERT_ARE_EQUAL(size_t, 1, get_transfer_message_index(1));
+    ASSERT_ARE_EQUAL(size_t, 2, get_transfer_message_index(2));
+    /* the message queued behind the refused one is not offered to the link before it */
+    ASSERT_ARE_EQUAL(size_t, 4, link_transfer_call_count);
+    ASSERT_ARE_EQUAL(size_t, 3, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_queued_message_refused_by_the_link_goes_back_to_the_head_of_the_queue)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_transfer_budget = 0;
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 1));
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 2));
+    test_transfer_budget = 1;
+    saved_on_link_flow_on(saved_link_callback_context);
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+    test_transfer_budget = SIZE_MAX;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 0, get_transfer_message_index(0));
+    ASSERT_ARE_EQUAL(size_t, 1, get_transfer_message_index(1));
+    ASSERT_ARE_EQUAL(size_t, 2, get_transfer_message_index(2));
+    ASSERT_ARE_EQUAL(size_t, 3, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(settling_a_message_sent_between_others_leaves_the_others_pending_in_order)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 1));
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 2));
+
+    // act
+    settle_transfer(1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 1, test_completions[0].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)test_completions[0].send_result);
+    ASSERT_ARE_EQUAL(size_t, 2, get_pending_message_count(message_sender));
+
+    /* the messages on both sides of the settled one are still linked to each other */
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_ERROR, LINK_STATE_ATTACHED);
+    ASSERT_ARE_EQUAL(size_t, 3, test_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 0, test_completions[1].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)test_completions[1].send_result);
+    ASSERT_ARE_EQUAL(size_t, 2, test_completions[2].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)test_completions[2].send_result);
+    ASSERT_ARE_EQUAL(size_t, 0, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_settled_message_is_reused_by_the_next_send)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    size_t settled_malloc_count;
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    settle_transfer(0);
+    settled_malloc_count = malloc_count;
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 1));
+    settle_transfer(1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, settled_malloc_count, malloc_count);
+    ASSERT_ARE_EQUAL(size_t, 2, test_completion_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+}
+
+TEST_FUNCTION(completed_messages_past_the_ones_kept_for_reuse_are_freed)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = messagesender_create(TEST_LINK_HANDLE, NULL, NULL);
+    size_t i;
+    ASSERT_IS_NOT_NULL(message_sender);
+    ASSERT_ARE_EQUAL(int, 0, messagesender_open(message_sender));
+    for (i = 0; i < TEST_MESSAGE_COUNT; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, messagesender_send(message_sender, get_test_message(i), NULL, NULL));
+    }
+    ASSERT_ARE_EQUAL(size_t, 1 + TEST_MESSAGE_COUNT, allocation_count);
+
+    // act
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_ERROR, LINK_STATE_HALF_ATTACHED_ATTACH_SENT);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1 + TEST_MAX_FREE_MESSAGE_COUNT, allocation_count);
+    ASSERT_ARE_EQUAL(size_t, 0, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+}
+
+TEST_FUNCTION(all_the_messages_kept_for_reuse_are_reused_before_allocating_again)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = messagesender_create(TEST_LINK_HANDLE, NULL, NULL);
+    size_t kept_malloc_count;
+    size_t i;
+    ASSERT_IS_NOT_NULL(message_sender);
+    ASSERT_ARE_EQUAL(int, 0, messagesender_open(message_sender));
+    for (i = 0; i < TEST_MAX_FREE_MESSAGE_COUNT; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, messagesender_send(message_sender, get_test_message(i), NULL, NULL));
+    }
+    ASSERT_ARE_EQUAL(int, 0, messagesender_close(message_sender));
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_DETACHED, LINK_STATE_HALF_ATTACHED_ATTACH_SENT);
+    kept_malloc_count = malloc_count;
+
+    // act
+    for (i = 0; i < TEST_MAX_FREE_MESSAGE_COUNT; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, messagesender_send(message_sender, get_test_message(i), NULL, NULL));
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, kept_malloc_count, malloc_count);
+    ASSERT_ARE_EQUAL(int, 0, messagesender_send(message_sender, get_test_message(i), NULL, NULL));
+    ASSERT_ARE_EQUAL(size_t, kept_malloc_count + 1, malloc_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+}
+
+/* messagesender_destroy */
+
+TEST_FUNCTION(messagesender_destroy_frees_the_pending_messages_the_kept_ones_and_the_encode_buffers)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 1));
+    settle_transfer(0);
+    test_transfer_budget = test_transfer_count;
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 2));
+
+    // act
+    messagesender_destroy(message_sender);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+    ASSERT_ARE_EQUAL(size_t, 3, test_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 1, test_completions[1].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)test_completions[1].send_result);
+    ASSERT_ARE_EQUAL(size_t, 2, test_completions[2].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)test_completions[2].send_result);
+}
+
+/* on_link_state_changed */
+
+TEST_FUNCTION(messages_sent_again_from_their_error_callback_when_the_link_detaches_stay_pending)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    resending_message_sender = message_sender;
+    ASSERT_ARE_EQUAL(int, 0, messagesender_send(message_sender, get_test_message(0), test_on_message_send_complete_resend, get_test_message(0)));
+    test_transfer_budget = 1;
+    ASSERT_ARE_EQUAL(int, 0, messagesender_send(message_sender, get_test_message(2), test_on_message_send_complete_resend, get_test_message(2)));
+    ASSERT_ARE_EQUAL(int, 0, messagesender_close(message_sender));
+
+    // act
+    saved_on_link_state_changed(saved_link_callback_context, LINK_STATE_DETACHED, LINK_STATE_ATTACHED);
+
+    // assert
+    /* the sent message first, then the unsent one, and none of the messages sent again from the callbacks */
+    ASSERT_ARE_EQUAL(size_t, 2, test_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 0, test_completions[0].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)test_completions[0].send_result);
+    ASSERT_ARE_EQUAL(size_t, 2, test_completions[1].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)test_completions[1].send_result);
+    ASSERT_ARE_EQUAL(size_t, 2, get_pending_message_count(message_sender));
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+
+    /* and they are still there to be completed */
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 4, test_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 1, test_completions[2].message_index);
+    ASSERT_ARE_EQUAL(size_t, 3, test_completions[3].message_index);
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+}
+
+/* encoding */
+
+TEST_FUNCTION(a_data_body_of_at_most_255_bytes_is_sent_after_a_data_section_descriptor_and_a_vbin8_header)
+{
+    // arrange
+    static const unsigned char body_bytes[] = { 'a', 'b', 'c' };
+    static const unsigned char expected_bytes[] = { 0x00, 0x53, 0x75, 0xA0, 0x03, 'a', 'b', 'c' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_body.bytes = body_bytes;
+    test_body.length = sizeof(body_bytes);
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected_bytes), test_transfers[0].length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected_bytes, test_transfers[0].bytes, sizeof(expected_bytes)));
+    /* the body is handed to the link where it is, not copied after the header */
+    ASSERT_ARE_EQUAL(size_t, 2, test_transfers[0].payload_count);
+    ASSERT_ARE_EQUAL(void_ptr, body_bytes, test_transfers[0].last_payload_bytes);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_data_body_of_more_than_255_bytes_is_sent_after_a_data_section_descriptor_and_a_vbin32_header)
+{
+    // arrange
+    static unsigned char body_bytes[256];
+    static const unsigned char expected_bytes[] = { 0x00, 0x53, 0x75, 0xB0, 0x00, 0x00, 0x01, 0x00 };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_body.bytes = body_bytes;
+    test_body.length = sizeof(body_bytes);
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected_bytes) + sizeof(body_bytes), test_transfers[0].length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected_bytes, test_transfers[0].bytes, sizeof(expected_bytes)));
+    ASSERT_ARE_EQUAL(void_ptr, body_bytes, test_transfers[0].last_payload_bytes);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(application_properties_are_sent_after_their_section_descriptor_and_before_the_body)
+{
+    // arrange
+    static const unsigned char encoded_map[] = { 0xC1, 0x01, 0x00 };
+    static const unsigned char expected_bytes[] = { 0x00, 0x53, 0x74, 0xC1, 0x01, 0x00, 0x00, 0x53, 0x75, 0xA0, 0x01, 0x00 };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_application_properties = TEST_APPLICATION_PROPERTIES;
+    test_encoded_value = encoded_map;
+    test_encoded_value_length = sizeof(encoded_map);
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected_bytes), test_transfers[0].length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected_bytes, test_transfers[0].bytes, sizeof(expected_bytes)));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(an_amqp_value_body_is_sent_after_an_amqp_value_section_descriptor)
+{
+    // arrange
+    static const unsigned char encoded_string[] = { 0xA1, 0x02, 'h', 'i' };
+    static const unsigned char expected_bytes[] = { 0x00, 0x53, 0x77, 0xA1, 0x02, 'h', 'i' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_body_type = MESSAGE_BODY_TYPE_VALUE;
+    test_encoded_value = encoded_string;
+    test_encoded_value_length = sizeof(encoded_string);
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfers[0].payload_count);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected_bytes), test_transfers[0].length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected_bytes, test_transfers[0].bytes, sizeof(expected_bytes)));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(an_encode_buffer_grown_past_64_KB_is_released_by_the_next_send)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_body_type = MESSAGE_BODY_TYPE_VALUE;
+    test_encoded_value = test_large_encoded_value;
+    test_encoded_value_length = sizeof(test_large_encoded_value);
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    ASSERT_ARE_EQUAL(size_t, 3 + sizeof(test_large_encoded_value), test_transfers[0].length);
+    watched_pointer = (void*)test_transfers[0].first_payload_bytes;
+    test_encoded_value_length = 1;
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 1));
+
+    // assert
+    ASSERT_IS_TRUE(is_watched_pointer_freed);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(an_encode_buffer_of_at_most_64_KB_is_kept_for_the_next_send)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_body_type = MESSAGE_BODY_TYPE_VALUE;
+    test_encoded_value = test_large_encoded_value;
+    test_encoded_value_length = 60 * 1024;
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    watched_pointer = (void*)test_transfers[0].first_payload_bytes;
+    test_encoded_value_length = 1;
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 1));
+
+    // assert
+    ASSERT_IS_FALSE(is_watched_pointer_freed);
+    ASSERT_ARE_EQUAL(void_ptr, watched_pointer, test_transfers[1].first_payload_bytes);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+/* messagesender_send_presettled */
+
+TEST_FUNCTION(messagesender_send_presettled_on_a_link_sending_unsettled_fails)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    int result;
+
+    // act
+    result = messagesender_send_presettled(message_sender, get_test_message(0));
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, link_transfer_call_count);
+    ASSERT_ARE_EQUAL(size_t, 0, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_presettled_message_taken_by_the_link_is_not_tracked)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    int result;
+    test_snd_settle_mode = sender_settle_mode_settled;
+
+    // act
+    result = messagesender_send_presettled(message_sender, get_test_message(0));
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 0, get_transfer_message_index(0));
+    /* the link has nothing to report back and the sender keeps nothing */
+    ASSERT_IS_NULL(test_transfers[0].on_delivery_settled);
+    ASSERT_ARE_EQUAL(size_t, 0, get_pending_message_count(message_sender));
+    ASSERT_ARE_EQUAL(size_t, 0, test_completion_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_presettled_message_refused_by_the_link_is_queued_and_forgotten_once_sent)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_snd_settle_mode = sender_settle_mode_settled;
+    test_transfer_budget = 0;
+    ASSERT_ARE_EQUAL(int, 0, messagesender_send_presettled(message_sender, get_test_message(0)));
+    ASSERT_ARE_EQUAL(size_t, 1, get_pending_message_count(message_sender));
+    test_transfer_budget = SIZE_MAX;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 0, get_transfer_message_index(0));
+    ASSERT_IS_NULL(test_transfers[0].on_delivery_settled);
+    ASSERT_ARE_EQUAL(size_t, 0, get_pending_message_count(message_sender));
+    ASSERT_ARE_EQUAL(size_t, 0, test_completion_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+}
+
+TEST_FUNCTION(a_presettled_message_is_not_sent_ahead_of_the_messages_waiting_for_the_link)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_snd_settle_mode = sender_settle_mode_settled;
+    test_transfer_budget = 0;
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    test_transfer_budget = SIZE_MAX;
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, messagesender_send_presettled(message_sender, get_test_message(1)));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 2, get_pending_message_count(message_sender));
+    saved_on_link_flow_on(saved_link_callback_context);
+    ASSERT_ARE_EQUAL(size_t, 2, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 0, get_transfer_message_index(0));
+    ASSERT_ARE_EQUAL(size_t, 1, get_transfer_message_index(1));
+    ASSERT_IS_NOT_NULL(test_transfers[0].on_delivery_settled);
+    ASSERT_IS_NULL(test_transfers[1].on_delivery_settled);
+    /* only the tracked message waits for its settlement */
+    ASSERT_ARE_EQUAL(size_t, 1, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+/* messagesender_send_streamed */
+
+TEST_FUNCTION(a_streamed_body_is_sent_in_frames_of_the_transfer_frame_payload_size_after_its_data_section_header)
+{
+    // arrange
+    static const unsigned char expected_frame_1[] = { 0x00, 0x53, 0x75, 0xA0, 0x06, 'a', 'b', 'c' };
+    static const unsigned char expected_frame_2[] = { 'd', 'e', 'f' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    int result;
+
+    // act
+    result = send_test_streamed_message(message_sender, 0, "abcdef");
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 2, test_transfer_count);
+    assert_transfer_bytes(0, expected_frame_1, sizeof(expected_frame_1));
+    ASSERT_IS_TRUE(test_transfers[0].more);
+    assert_transfer_bytes(1, expected_frame_2, sizeof(expected_frame_2));
+    ASSERT_IS_FALSE(test_transfers[1].more);
+    /* the frames are one delivery, settled once */
+    ASSERT_ARE_EQUAL(void_ptr, test_transfers[0].callback_context, test_transfers[1].callback_context);
+    ASSERT_ARE_EQUAL(size_t, 0, test_completion_count);
+    settle_transfer(1);
+    ASSERT_ARE_EQUAL(size_t, 1, test_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 0, test_completions[0].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)test_completions[0].send_result);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_streamed_message_refused_mid_delivery_is_resumed_from_on_link_flow_on_without_reading_the_refused_frame_again)
+{
+    // arrange
+    static const unsigned char expected_frame_2[] = { 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k' };
+    static const unsigned char expected_frame_3[] = { 'l', 'm', 'n' };
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_transfer_budget = 1;
+    ASSERT_ARE_EQUAL(int, 0, send_test_streamed_message(message_sender, 0, "abcdefghijklmn"));
+    ASSERT_ARE_EQUAL(size_t, 1, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 2, test_stream_body_read_count);
+    test_transfer_budget = SIZE_MAX;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, test_transfer_count);
+    assert_transfer_bytes(1, expected_frame_2, sizeof(expected_frame_2));
+    ASSERT_IS_TRUE(test_transfers[1].more);
+    assert_transfer_bytes(2, expected_frame_3, sizeof(expected_frame_3));
+    ASSERT_IS_FALSE(test_transfers[2].more);
+    ASSERT_ARE_EQUAL(size_t, 3, test_stream_body_read_count);
+    ASSERT_ARE_EQUAL(size_t, 0, link_abort_transfer_call_count);
+    settle_transfer(2);
+    ASSERT_ARE_EQUAL(size_t, 1, test_completion_count);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_OK, (int)test_completions[0].send_result);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_streamed_body_ending_short_after_its_first_frame_aborts_the_delivery_and_completes_the_message_with_an_error)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_transfer_budget = 1;
+    ASSERT_ARE_EQUAL(int, 0, send_test_streamed_message(message_sender, 0, "abcdefghijklmn"));
+    test_transfer_budget = SIZE_MAX;
+    /* the body ends after the second frame */
+    test_stream_body_readable = 11;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 1, link_abort_transfer_call_count);
+    ASSERT_ARE_EQUAL(size_t, 1, test_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 0, test_completions[0].message_index);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)test_completions[0].send_result);
+    ASSERT_ARE_EQUAL(size_t, 0, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_streamed_body_failing_to_read_after_its_first_frame_aborts_the_delivery_and_completes_the_message_with_an_error)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    test_transfer_budget = 1;
+    ASSERT_ARE_EQUAL(int, 0, send_test_streamed_message(message_sender, 0, "abcdefghijklmn"));
+    test_transfer_budget = SIZE_MAX;
+    test_stream_body_readable = 11;
+    test_stream_body_read_fails = true;
+
+    // act
+    saved_on_link_flow_on(saved_link_callback_context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 1, link_abort_transfer_call_count);
+    ASSERT_ARE_EQUAL(size_t, 1, test_completion_count);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_SEND_ERROR, (int)test_completions[0].send_result);
+    ASSERT_ARE_EQUAL(size_t, 0, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(a_streamed_body_failing_to_read_before_its_first_frame_fails_the_send_and_aborts_nothing)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    int result;
+    test_stream_body_read_fails = true;
+    test_body_type = MESSAGE_BODY_TYPE_NONE;
+    test_stream_body = (const unsigned char*)"abcdef";
+
+    // act
+    result = messagesender_send_streamed(message_sender, get_test_message(0), 6, test_on_message_body_read, NULL, test_on_message_send_complete, get_test_message(0));
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, test_transfer_count);
+    ASSERT_ARE_EQUAL(size_t, 0, link_abort_transfer_call_count);
+    /* the failed send is reported by its result, not by the callback */
+    ASSERT_ARE_EQUAL(size_t, 0, test_completion_count);
+    ASSERT_ARE_EQUAL(size_t, 0, get_pending_message_count(message_sender));
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+/* messagesender_get_pending_message_count */
+
+TEST_FUNCTION(messagesender_get_pending_message_count_with_NULL_message_sender_fails)
+{
+    // arrange
+    size_t message_count;
+
+    // act
+    int result = messagesender_get_pending_message_count(NULL, &message_count);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(messagesender_get_pending_message_count_with_NULL_message_count_fails)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+
+    // act
+    int result = messagesender_get_pending_message_count(message_sender, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+TEST_FUNCTION(messagesender_get_pending_message_count_counts_the_unsent_and_the_unsettled_messages)
+{
+    // arrange
+    MESSAGE_SENDER_HANDLE message_sender = create_open_message_sender();
+    size_t message_count;
+    int result;
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 0));
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 1));
+    test_transfer_budget = test_transfer_count;
+    ASSERT_ARE_EQUAL(int, 0, send_test_message(message_sender, 2));
+    settle_transfer(0);
+
+    // act
+    result = messagesender_get_pending_message_count(message_sender, &message_count);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 2, message_count);
+
+    // cleanup
+    messagesender_destroy(message_sender);
+}
+
+END_TEST_SUITE(message_sender_ut)
@@ -0,0 +1,335 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+#include "azure_uamqp_c/mpsc_queue.h"
+
+#define TEST_ITEM_COUNT					10
+#define TEST_PRODUCER_COUNT				4
+#define TEST_ITEMS_PER_PRODUCER			100000
+
+typedef struct TEST_ITEM_TAG
+{
+    MPSC_QUEUE_ITEM queue_item;
+    size_t producer;
+    size_t sequence;
+} TEST_ITEM;
+
+typedef struct TEST_PRODUCER_TAG
+{
+    pthread_t thread;
+    MPSC_QUEUE* queue;
+    size_t producer;
+} TEST_PRODUCER;
+
+static TEST_ITEM test_items[TEST_ITEM_COUNT];
+static TEST_ITEM test_producer_items[TEST_PRODUCER_COUNT][TEST_ITEMS_PER_PRODUCER];
+static volatile int start_producers;
+
+static void* test_producer_thread(void* context)
+{
+    TEST_PRODUCER* test_producer = (TEST_PRODUCER*)context;
+    size_t i;
+
+    while (!__atomic_load_n(&start_producers, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+
+    for (i = 0; i < TEST_ITEMS_PER_PRODUCER; i++)
+    {
+        TEST_ITEM* test_item = &test_producer_items[test_producer->producer][i];
+        test_item->producer = test_producer->producer;
+        test_item->sequence = i;
+        mpsc_queue_push(test_producer->queue, &test_item->queue_item);
+    }
+
+    return NULL;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(mpsc_queue_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    start_producers = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* mpsc_queue_init */
+
+TEST_FUNCTION(mpsc_queue_init_leaves_only_the_stub_in_the_queue)
+{
+    // arrange
+    MPSC_QUEUE queue;
+
+    // act
+    mpsc_queue_init(&queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, &queue.stub, queue.head);
+    ASSERT_ARE_EQUAL(void_ptr, &queue.stub, queue.tail);
+    ASSERT_IS_NULL(queue.stub.next);
+}
+
+TEST_FUNCTION(mpsc_queue_init_with_NULL_queue_does_not_crash)
+{
+    // arrange
+
+    // act
+    mpsc_queue_init(NULL);
+
+    // assert
+    // no explicit assert
+}
+
+/* mpsc_queue_pop */
+
+TEST_FUNCTION(mpsc_queue_pop_on_an_empty_queue_returns_NULL)
+{
+    // arrange
+    MPSC_QUEUE queue;
+    MPSC_QUEUE_ITEM* result;
+    mpsc_queue_init(&queue);
+
+    // act
+    result = mpsc_queue_pop(&queue);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(void_ptr, &queue.stub, queue.tail);
+}
+
+TEST_FUNCTION(mpsc_queue_pop_with_NULL_queue_returns_NULL)
+{
+    // arrange
+
+    // act
+    MPSC_QUEUE_ITEM* result = mpsc_queue_pop(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+TEST_FUNCTION(mpsc_queue_pop_returns_the_only_item_and_puts_the_stub_back)
+{
+    // arrange
+    MPSC_QUEUE queue;
+    MPSC_QUEUE_ITEM* result;
+    mpsc_queue_init(&queue);
+    mpsc_queue_push(&queue, &test_items[0].queue_item);
+
+    // act
+    result = mpsc_queue_pop(&queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[0].queue_item, result);
+    ASSERT_ARE_EQUAL(void_ptr, &queue.stub, queue.head);
+    ASSERT_ARE_EQUAL(void_ptr, &queue.stub, queue.tail);
+    ASSERT_IS_NULL(mpsc_queue_pop(&queue));
+}
+
+TEST_FUNCTION(mpsc_queue_pop_returns_the_items_in_the_order_they_were_pushed)
+{
+    // arrange
+    MPSC_QUEUE queue;
+    size_t i;
+    mpsc_queue_init(&queue);
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        mpsc_queue_push(&queue, &test_items[i].queue_item);
+    }
+
+    // act
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        MPSC_QUEUE_ITEM* result = mpsc_queue_pop(&queue);
+
+        // assert
+        ASSERT_ARE_EQUAL(void_ptr, &test_items[i].queue_item, result);
+    }
+
+    ASSERT_IS_NULL(mpsc_queue_pop(&queue));
+}
+
+TEST_FUNCTION(items_pushed_after_the_queue_was_drained_are_popped)
+{
+    // arrange
+    MPSC_QUEUE queue;
+    size_t i;
+    mpsc_queue_init(&queue);
+
+    // act
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        MPSC_QUEUE_ITEM* result;
+
+        mpsc_queue_push(&queue, &test_items[i].queue_item);
+        result = mpsc_queue_pop(&queue);
+
+        // assert
+        ASSERT_ARE_EQUAL(void_ptr, &test_items[i].queue_item, result);
+        ASSERT_IS_NULL(mpsc_queue_pop(&queue));
+    }
+}
+
+TEST_FUNCTION(an_item_pushed_while_the_last_one_is_popped_is_not_lost)
+{
+    // arrange
+    MPSC_QUEUE queue;
+    mpsc_queue_init(&queue);
+    mpsc_queue_push(&queue, &test_items[0].queue_item);
+    mpsc_queue_push(&queue, &test_items[1].queue_item);
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[0].queue_item, mpsc_queue_pop(&queue));
+
+    // act
+    mpsc_queue_push(&queue, &test_items[2].queue_item);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[1].queue_item, mpsc_queue_pop(&queue));
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[2].queue_item, mpsc_queue_pop(&queue));
+    ASSERT_IS_NULL(mpsc_queue_pop(&queue));
+}
+
+TEST_FUNCTION(mpsc_queue_pop_returns_NULL_while_a_push_is_half_way_through)
+{
+    // arrange
+    MPSC_QUEUE queue;
+    MPSC_QUEUE_ITEM* result;
+    mpsc_queue_init(&queue);
+    mpsc_queue_push(&queue, &test_items[0].queue_item);
+
+    /* a producer has swapped itself into head but not linked itself behind the previous item yet */
+    test_items[1].queue_item.next = NULL;
+    queue.head = &test_items[1].queue_item;
+
+    // act
+    result = mpsc_queue_pop(&queue);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    /* once the producer finishes both items come out */
+    test_items[0].queue_item.next = &test_items[1].queue_item;
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[0].queue_item, mpsc_queue_pop(&queue));
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[1].queue_item, mpsc_queue_pop(&queue));
+    ASSERT_IS_NULL(mpsc_queue_pop(&queue));
+}
+
+/* mpsc_queue_push */
+
+TEST_FUNCTION(mpsc_queue_push_with_NULL_queue_does_not_crash)
+{
+    // arrange
+
+    // act
+    mpsc_queue_push(NULL, &test_items[0].queue_item);
+
+    // assert
+    // no explicit assert
+}
+
+TEST_FUNCTION(mpsc_queue_push_with_NULL_item_leaves_the_queue_empty)
+{
+    // arrange
+    MPSC_QUEUE queue;
+    mpsc_queue_init(&queue);
+
+    // act
+    mpsc_queue_push(&queue, NULL);
+
+    // assert
+    ASSERT_IS_NULL(mpsc_queue_pop(&queue));
+}
+
+TEST_FUNCTION(items_pushed_by_several_producers_are_all_popped_in_each_producer_order)
+{
+    // arrange
+    MPSC_QUEUE queue;
+    TEST_PRODUCER test_producers[TEST_PRODUCER_COUNT];
+    size_t next_sequence[TEST_PRODUCER_COUNT] = { 0 };
+    size_t popped_count = 0;
+    size_t i;
+    mpsc_queue_init(&queue);
+
+    for (i = 0; i < TEST_PRODUCER_COUNT; i++)
+    {
+        test_producers[i].queue = &queue;
+        test_producers[i].producer = i;
+        ASSERT_ARE_EQUAL(int, 0, pthread_create(&test_producers[i].thread, NULL, test_producer_thread, &test_producers[i]));
+    }
+
+    // act
+    __atomic_store_n(&start_producers, 1, __ATOMIC_RELEASE);
+    while (popped_count < TEST_PRODUCER_COUNT * TEST_ITEMS_PER_PRODUCER)
+    {
+        TEST_ITEM* test_item = (TEST_ITEM*)mpsc_queue_pop(&queue);
+        if (test_item == NULL)
+        {
+            sched_yield();
+        }
+        else
+        {
+            // assert
+            ASSERT_ARE_EQUAL(size_t, next_sequence[test_item->producer], test_item->sequence);
+            next_sequence[test_item->producer]++;
+            popped_count++;
+        }
+    }
+
+    for (i = 0; i < TEST_PRODUCER_COUNT; i++)
+    {
+        (void)pthread_join(test_producers[i].thread, NULL);
+        ASSERT_ARE_EQUAL(size_t, TEST_ITEMS_PER_PRODUCER, next_sequence[i]);
+    }
+
+    ASSERT_IS_NULL(mpsc_queue_pop(&queue));
+}
+
+END_TEST_SUITE(mpsc_queue_ut)
@@ -365,7 +365,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(saslmechanism_get_init_bytes, 0);
     REGISTER_GLOBAL_MOCK_RETURN(saslmechanism_get_mechanism_name, test_mechanism);
     REGISTER_GLOBAL_MOCK_RETURN(saslmechanism_challenge, 0);
-    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_to_string, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_to_string_buffer, __LINE__);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_inplace_descriptor, test_descriptor_value);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_array_item_count, 0);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_array_item, test_sasl_server_mechanism);
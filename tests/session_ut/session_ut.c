@@ -11,6 +11,7 @@
 #include "testrunnerswitcher.h"
 #include "umock_c.h"
 #include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
 
 static void* my_gballoc_malloc(size_t size)
 {
@@ -30,6 +31,7 @@ static void my_gballoc_free(void* ptr)
 #define ENABLE_MOCKS
 
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xio.h"
 #include "azure_uamqp_c/amqp_definitions.h"
 #include "azure_uamqp_c/connection.h"
@@ -47,8 +49,16 @@ static void my_gballoc_free(void* ptr)
 #define TEST_CONTEXT					(void*)0x4444
 #define TEST_ATTACH_PERFORMATIVE		(AMQP_VALUE)0x5000
 #define TEST_BEGIN_PERFORMATIVE			(AMQP_VALUE)0x5001
+#define TEST_TRANSFER_PERFORMATIVE		(AMQP_VALUE)0x5002
+#define TEST_FLOW_PERFORMATIVE			(AMQP_VALUE)0x5003
+#define TEST_TRANSFER_AMQP_VALUE		(AMQP_VALUE)0x5004
+#define TEST_FLOW_HANDLE				(FLOW_HANDLE)0x5005
+#define TEST_TICK_COUNTER				(TICK_COUNTER_HANDLE)0x5006
+#define TEST_LINK_COUNT					10000
+#define TEST_SCHEDULED_LINK_COUNT		2
 
 static TRANSFER_HANDLE test_transfer_handle = (TRANSFER_HANDLE)0x6001;
+static ATTACH_HANDLE test_attach_handle = (ATTACH_HANDLE)0x6002;
 static ON_ENDPOINT_FRAME_RECEIVED saved_frame_received_callback;
 static ON_CONNECTION_STATE_CHANGED saved_connection_state_changed_callback;
 static void* saved_callback_context;
@@ -56,6 +66,30 @@ static uint32_t some_remote_max_frame_size = 512;
 
 static uint64_t performative_ulong;
 
+static AMQP_VALUE test_received_performative;
+static const char* test_attach_name;
+static handle test_performative_handle;
+static LINK_ENDPOINT_HANDLE test_link_endpoints[TEST_LINK_COUNT];
+static void* last_link_frame_received_context;
+static uint32_t test_incoming_window;
+/* the transfer frame being sent: a delivery tag marks the first frame of a delivery */
+static bool test_transfer_has_delivery_tag;
+static bool test_transfer_more;
+static bool test_transfer_aborted;
+static size_t test_transfer_encoded_size;
+static tickcounter_ms_t test_current_ms;
+/* the incoming window the session opened in its BEGIN and last sent in a session flow */
+static uint32_t sent_begin_incoming_window;
+static uint32_t sent_flow_incoming_window;
+static size_t sent_flow_count;
+
+/* a link that always has more to send, it sends until the session refuses a transfer */
+typedef struct TEST_SCHEDULED_LINK_TAG
+{
+    LINK_ENDPOINT_HANDLE link_endpoint;
+    size_t transfers_sent;
+} TEST_SCHEDULED_LINK;
+
 MOCK_FUNCTION_WITH_CODE(, void, test_frame_received_callback, void*, context, AMQP_VALUE, performative, uint32_t, frame_payload_size, const unsigned char*, payload_bytes)
 MOCK_FUNCTION_END();
 MOCK_FUNCTION_WITH_CODE(, void, test_on_session_state_changed, void*, context, SESSION_STATE, new_session_state, SESSION_STATE, previous_session_state)
@@ -72,6 +106,146 @@ static int my_amqpvalue_get_ulong(AMQP_VALUE value, uint64_t* ulong_value)
     return 0;
 }
 
+static bool my_is_attach_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (test_received_performative == TEST_ATTACH_PERFORMATIVE);
+}
+
+static bool my_is_transfer_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (test_received_performative == TEST_TRANSFER_PERFORMATIVE);
+}
+
+static bool my_is_begin_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (test_received_performative == TEST_BEGIN_PERFORMATIVE);
+}
+
+static bool my_is_flow_type_by_descriptor(AMQP_VALUE descriptor)
+{
+    (void)descriptor;
+    return (test_received_performative == TEST_FLOW_PERFORMATIVE);
+}
+
+static int my_begin_get_incoming_window(BEGIN_HANDLE begin, uint32_t* incoming_window_value)
+{
+    (void)begin;
+    *incoming_window_value = test_incoming_window;
+    return 0;
+}
+
+static int my_flow_get_incoming_window(FLOW_HANDLE flow, uint32_t* incoming_window_value)
+{
+    (void)flow;
+    *incoming_window_value = test_incoming_window;
+    return 0;
+}
+
+static int my_connection_get_remote_max_frame_size(CONNECTION_HANDLE connection, uint32_t* remote_max_frame_size)
+{
+    (void)connection;
+    *remote_max_frame_size = some_remote_max_frame_size;
+    return 0;
+}
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = test_current_ms;
+    return 0;
+}
+
+static BEGIN_HANDLE my_begin_create(transfer_number next_outgoing_id_value, uint32_t incoming_window_value, uint32_t outgoing_window_value)
+{
+    (void)next_outgoing_id_value;
+    (void)outgoing_window_value;
+    sent_begin_incoming_window = incoming_window_value;
+    return (BEGIN_HANDLE)0x6003;
+}
+
+static FLOW_HANDLE my_flow_create(uint32_t incoming_window_value, transfer_number next_outgoing_id_value, uint32_t outgoing_window_value)
+{
+    (void)next_outgoing_id_value;
+    (void)outgoing_window_value;
+    sent_flow_incoming_window = incoming_window_value;
+    sent_flow_count++;
+    return TEST_FLOW_HANDLE;
+}
+
+static int my_amqpvalue_get_encoded_size(AMQP_VALUE value, size_t* encoded_size)
+{
+    (void)value;
+    *encoded_size = test_transfer_encoded_size;
+    return 0;
+}
+
+static int my_transfer_get_delivery_tag(TRANSFER_HANDLE transfer, delivery_tag* delivery_tag_value)
+{
+    (void)transfer;
+    (void)delivery_tag_value;
+    return test_transfer_has_delivery_tag ? 0 : 1;
+}
+
+static int my_transfer_get_more(TRANSFER_HANDLE transfer, bool* more_value)
+{
+    (void)transfer;
+    *more_value = test_transfer_more;
+    return 0;
+}
+
+static int my_transfer_get_aborted(TRANSFER_HANDLE transfer, bool* aborted_value)
+{
+    (void)transfer;
+    *aborted_value = test_transfer_aborted;
+    return 0;
+}
+
+static int my_amqpvalue_get_attach(AMQP_VALUE value, ATTACH_HANDLE* attach_handle)
+{
+    (void)value;
+    *attach_handle = test_attach_handle;
+    return 0;
+}
+
+static int my_amqpvalue_get_transfer(AMQP_VALUE value, TRANSFER_HANDLE* transfer_handle)
+{
+    (void)value;
+    *transfer_handle = test_transfer_handle;
+    return 0;
+}
+
+static int my_attach_get_name(ATTACH_HANDLE attach, const char** name_value)
+{
+    (void)attach;
+    *name_value = test_attach_name;
+    return 0;
+}
+
+static int my_attach_get_handle(ATTACH_HANDLE attach, handle* handle_value)
+{
+    (void)attach;
+    *handle_value = test_performative_handle;
+    return 0;
+}
+
+static int my_transfer_get_handle(TRANSFER_HANDLE transfer, handle* handle_value)
+{
+    (void)transfer;
+    *handle_value = test_performative_handle;
+    return 0;
+}
+
+static void test_link_frame_received(void* context, AMQP_VALUE performative, uint32_t frame_payload_size, const unsigned char* payload_bytes)
+{
+    (void)performative;
+    (void)frame_payload_size;
+    (void)payload_bytes;
+    last_link_frame_received_context = context;
+}
+
 static int my_connection_start_endpoint(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_FRAME_RECEIVED frame_received_callback, ON_CONNECTION_STATE_CHANGED on_connection_state_changed, void* context)
 {
     (void)endpoint;
@@ -81,6 +255,133 @@ static int my_connection_start_endpoint(ENDPOINT_HANDLE endpoint, ON_ENDPOINT_FR
     return 0;
 }
 
+static void test_scheduled_link_on_flow_on(void* context)
+{
+    TEST_SCHEDULED_LINK* test_scheduled_link = (TEST_SCHEDULED_LINK*)context;
+    delivery_number delivery_id;
+
+    while (session_send_transfer(test_scheduled_link->link_endpoint, test_transfer_handle, NULL, 0, &delivery_id, NULL, NULL) == SESSION_SEND_TRANSFER_OK)
+    {
+        test_scheduled_link->transfers_sent++;
+    }
+}
+
+/* maps a session whose peer opened no incoming window yet, the links are refused a transfer and wait for one */
+static SESSION_HANDLE create_session_with_waiting_links(TEST_SCHEDULED_LINK* test_scheduled_links, const uint32_t* weights)
+{
+    SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+    char link_name[32];
+    size_t i;
+
+    ASSERT_ARE_EQUAL(int, 0, session_begin(session));
+    for (i = 0; i < TEST_SCHEDULED_LINK_COUNT; i++)
+    {
+        (void)sprintf(link_name, "link_%u", (unsigned int)i);
+        test_scheduled_links[i].link_endpoint = session_create_link_endpoint(session, link_name);
+        test_scheduled_links[i].transfers_sent = 0;
+        ASSERT_IS_NOT_NULL(test_scheduled_links[i].link_endpoint);
+        ASSERT_ARE_EQUAL(int, 0, session_set_link_endpoint_weight(test_scheduled_links[i].link_endpoint, weights[i]));
+        ASSERT_ARE_EQUAL(int, 0, session_start_link_endpoint(test_scheduled_links[i].link_endpoint, test_link_frame_received, NULL, test_scheduled_link_on_flow_on, &test_scheduled_links[i]));
+    }
+
+    saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
+    test_received_performative = TEST_BEGIN_PERFORMATIVE;
+    test_incoming_window = 0;
+    saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
+
+    for (i = 0; i < TEST_SCHEDULED_LINK_COUNT; i++)
+    {
+        test_scheduled_link_on_flow_on(&test_scheduled_links[i]);
+        ASSERT_ARE_EQUAL(size_t, 0, test_scheduled_links[i].transfers_sent);
+    }
+
+    umock_c_reset_all_calls();
+    return session;
+}
+
+static void receive_session_flow(uint32_t incoming_window)
+{
+    test_received_performative = TEST_FLOW_PERFORMATIVE;
+    test_incoming_window = incoming_window;
+    saved_frame_received_callback(saved_callback_context, TEST_FLOW_PERFORMATIVE, 0, NULL);
+}
+
+/* maps a session with one link endpoint, its peer opening an incoming window of incoming_window */
+static SESSION_HANDLE create_mapped_session(uint32_t incoming_window, LINK_ENDPOINT_HANDLE* link_endpoint)
+{
+    SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+
+    ASSERT_ARE_EQUAL(int, 0, session_begin(session));
+    *link_endpoint = session_create_link_endpoint(session, "1");
+    ASSERT_IS_NOT_NULL(*link_endpoint);
+    ASSERT_ARE_EQUAL(int, 0, session_start_link_endpoint(*link_endpoint, test_link_frame_received, NULL, NULL, NULL));
+
+    saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
+    test_received_performative = TEST_BEGIN_PERFORMATIVE;
+    test_incoming_window = incoming_window;
+    saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
+    test_received_performative = NULL;
+
+    umock_c_reset_all_calls();
+    return session;
+}
+
+static SESSION_SEND_TRANSFER_RESULT send_transfer_frame(LINK_ENDPOINT_HANDLE link_endpoint, bool is_first_frame, bool more, delivery_number* delivery_id)
+{
+    test_transfer_has_delivery_tag = is_first_frame;
+    test_transfer_more = more;
+    return session_send_transfer_frame(link_endpoint, test_transfer_handle, NULL, 0, delivery_id, NULL, NULL);
+}
+
+/* maps a session with one attached link endpoint, whose transfers the peer sends on handle 0 */
+static SESSION_HANDLE create_receiving_session(LINK_ENDPOINT_HANDLE* link_endpoint)
+{
+    SESSION_HANDLE session = create_mapped_session(0, link_endpoint);
+
+    test_received_performative = TEST_ATTACH_PERFORMATIVE;
+    test_attach_name = "1";
+    test_performative_handle = 0;
+    saved_frame_received_callback(saved_callback_context, TEST_ATTACH_PERFORMATIVE, 0, NULL);
+    test_received_performative = NULL;
+
+    umock_c_reset_all_calls();
+    sent_flow_count = 0;
+    return session;
+}
+
+static void receive_transfers(size_t count, uint32_t payload_size)
+{
+    size_t i;
+
+    test_received_performative = TEST_TRANSFER_PERFORMATIVE;
+    test_performative_handle = 0;
+    for (i = 0; i < count; i++)
+    {
+        saved_frame_received_callback(saved_callback_context, TEST_TRANSFER_PERFORMATIVE, payload_size, NULL);
+        umock_c_reset_all_calls();
+    }
+    test_received_performative = NULL;
+}
+
+static uint32_t get_incoming_window(SESSION_HANDLE session)
+{
+    uint32_t result;
+    ASSERT_ARE_EQUAL(int, 0, session_get_incoming_window(session, &result));
+    return result;
+}
+
+static void destroy_session_with_links(SESSION_HANDLE session, TEST_SCHEDULED_LINK* test_scheduled_links)
+{
+    size_t i;
+
+    test_received_performative = NULL;
+    for (i = 0; i < TEST_SCHEDULED_LINK_COUNT; i++)
+    {
+        session_destroy_link_endpoint(test_scheduled_links[i].link_endpoint);
+    }
+    session_destroy(session);
+}
+
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -107,6 +408,8 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     result = umocktypes_charptr_register_types();
     ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
@@ -117,18 +420,43 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_string, 0);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_list_item, TEST_LIST_ITEM_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_inplace_described_value, TEST_DESCRIBED_AMQP_VALUE);
-    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_get_encoded_size, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_encoded_size, my_amqpvalue_get_encoded_size);
     REGISTER_GLOBAL_MOCK_RETURN(connection_open, 0);
     REGISTER_GLOBAL_MOCK_RETURN(connection_close, 0);
     REGISTER_GLOBAL_MOCK_RETURN(connection_create_endpoint, TEST_ENDPOINT_HANDLE);
     REGISTER_GLOBAL_MOCK_RETURN(connection_endpoint_get_incoming_channel, 0);
     REGISTER_GLOBAL_MOCK_RETURN(connection_encode_frame, 0);
-    REGISTER_GLOBAL_MOCK_RETURN(connection_get_remote_max_frame_size, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(connection_get_remote_max_frame_size, my_connection_get_remote_max_frame_size);
     REGISTER_GLOBAL_MOCK_HOOK(connection_start_endpoint, my_connection_start_endpoint);
+    REGISTER_GLOBAL_MOCK_HOOK(is_attach_type_by_descriptor, my_is_attach_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_transfer_type_by_descriptor, my_is_transfer_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_attach, my_amqpvalue_get_attach);
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_get_transfer, my_amqpvalue_get_transfer);
+    REGISTER_GLOBAL_MOCK_HOOK(attach_get_name, my_attach_get_name);
+    REGISTER_GLOBAL_MOCK_HOOK(attach_get_handle, my_attach_get_handle);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_handle, my_transfer_get_handle);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_delivery_tag, my_transfer_get_delivery_tag);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_more, my_transfer_get_more);
+    REGISTER_GLOBAL_MOCK_HOOK(transfer_get_aborted, my_transfer_get_aborted);
+    REGISTER_GLOBAL_MOCK_HOOK(is_begin_type_by_descriptor, my_is_begin_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(is_flow_type_by_descriptor, my_is_flow_type_by_descriptor);
+    REGISTER_GLOBAL_MOCK_HOOK(begin_get_incoming_window, my_begin_get_incoming_window);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_get_incoming_window, my_flow_get_incoming_window);
+    REGISTER_GLOBAL_MOCK_HOOK(begin_create, my_begin_create);
+    REGISTER_GLOBAL_MOCK_HOOK(flow_create, my_flow_create);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_flow, (AMQP_VALUE)0x6005);
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_begin, (AMQP_VALUE)0x6004);
+    REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_transfer, TEST_TRANSFER_AMQP_VALUE);
+    /* a session flow, no link handle and no next-incoming-id */
+    REGISTER_GLOBAL_MOCK_RETURN(flow_get_handle, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(flow_get_next_incoming_id, 1);
 
     REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(CONNECTION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ENDPOINT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -147,6 +475,15 @@ TEST_FUNCTION_INITIALIZE(method_init)
     }
 
     umock_c_reset_all_calls();
+
+    test_transfer_has_delivery_tag = true;
+    test_transfer_more = false;
+    test_transfer_aborted = false;
+    test_transfer_encoded_size = 0;
+    test_current_ms = 0;
+    sent_begin_incoming_window = 0;
+    sent_flow_incoming_window = 0;
+    sent_flow_count = 0;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -296,6 +633,7 @@ TEST_FUNCTION(session_create_link_endpoint_creates_a_link_endpoint)
 	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
 	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
 	EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
 
 	// act
 	link_endpoint = session_create_link_endpoint(session, "1");
@@ -413,6 +751,86 @@ TEST_FUNCTION(when_reallocating_the_endpoint_array_for_the_link_endpoint_fails_t
 	session_destroy(session);
 }
 
+/* Tests_SRS_SESSION_01_045: [If allocating memory for the link endpoint fails, session_create_link_endpoint shall fail and return NULL.] */
+TEST_FUNCTION(when_allocating_the_link_name_index_fails_then_session_create_link_endpoint_fails)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	umock_c_reset_all_calls();
+
+	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+	EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.SetReturn(NULL);
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+	// act
+	link_endpoint = session_create_link_endpoint(session, "1");
+
+	// assert
+	ASSERT_IS_NULL(link_endpoint);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy(session);
+}
+
+/* Tests_SRS_SESSION_01_046: [An unused handle shall be assigned to the link endpoint.] */
+TEST_FUNCTION(frames_received_for_10000_attached_links_are_routed_to_the_link_endpoint_owning_the_handle)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	char link_name[32];
+	uint32_t i;
+
+	(void)session_begin(session);
+	for (i = 0; i < TEST_LINK_COUNT; i++)
+	{
+		(void)sprintf(link_name, "link_%u", (unsigned int)i);
+		test_link_endpoints[i] = session_create_link_endpoint(session, link_name);
+		ASSERT_IS_NOT_NULL(test_link_endpoints[i]);
+		(void)session_start_link_endpoint(test_link_endpoints[i], test_link_frame_received, NULL, NULL, test_link_endpoints[i]);
+	}
+
+	/* the peer hands out its handles in reverse order so they never match the local ones */
+	for (i = 0; i < TEST_LINK_COUNT; i++)
+	{
+		(void)sprintf(link_name, "link_%u", (unsigned int)i);
+		test_received_performative = TEST_ATTACH_PERFORMATIVE;
+		test_attach_name = link_name;
+		test_performative_handle = TEST_LINK_COUNT - 1 - i;
+		last_link_frame_received_context = NULL;
+		saved_frame_received_callback(saved_callback_context, TEST_ATTACH_PERFORMATIVE, 0, NULL);
+		ASSERT_ARE_EQUAL(void_ptr, test_link_endpoints[i], last_link_frame_received_context);
+		umock_c_reset_all_calls();
+	}
+
+	// act
+	for (i = 0; i < TEST_LINK_COUNT; i++)
+	{
+		test_received_performative = TEST_TRANSFER_PERFORMATIVE;
+		test_performative_handle = TEST_LINK_COUNT - 1 - i;
+		last_link_frame_received_context = NULL;
+		saved_frame_received_callback(saved_callback_context, TEST_TRANSFER_PERFORMATIVE, 0, NULL);
+
+		// assert
+		ASSERT_ARE_EQUAL(void_ptr, test_link_endpoints[i], last_link_frame_received_context);
+		umock_c_reset_all_calls();
+	}
+
+	// cleanup
+	test_received_performative = NULL;
+	test_attach_name = NULL;
+	for (i = 0; i < TEST_LINK_COUNT; i++)
+	{
+		session_destroy_link_endpoint(test_link_endpoints[i]);
+	}
+	session_destroy(session);
+}
+
 /* session_destroy_link_endpoint */
 
 /* Tests_SRS_SESSION_01_050: [If link_endpoint is NULL, session_destroy_link_endpoint shall do nothing.] */
@@ -435,7 +853,6 @@ TEST_FUNCTION(session_destroy_link_endpoint_frees_the_resources)
 	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
 	umock_c_reset_all_calls();
 
-	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 	EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
@@ -458,7 +875,6 @@ TEST_FUNCTION(session_destroy_link_endpoint_when_2_endpoints_are_there_frees_the
 	LINK_ENDPOINT_HANDLE link_endpoint2 = session_create_link_endpoint(session, "1");
 	umock_c_reset_all_calls();
 
-	EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
@@ -473,127 +889,278 @@ TEST_FUNCTION(session_destroy_link_endpoint_when_2_endpoints_are_there_frees_the
 	session_destroy(session);
 }
 
-/* session_send_transfer */
+/* session_get_statistics */
 
-#if 0
-/* Tests_SRS_SESSION_01_051: [session_send_transfer shall send a transfer frame with the performative indicated in the transfer argument.] */
-/* Tests_SRS_SESSION_01_053: [On success, session_send_transfer shall return 0.] */
-/* Tests_SRS_SESSION_01_055: [The encoding of the frame shall be done by calling connection_encode_frame and passing as arguments: the connection handle associated with the session, the transfer performative and the payload chunks passed to session_send_transfer.] */
-/* Tests_SRS_SESSION_01_057: [The delivery ids shall be assigned starting at 0.] */
-TEST_FUNCTION(session_transfer_sends_the_frame_to_the_connection)
+TEST_FUNCTION(session_get_statistics_with_NULL_session_fails)
 {
 	// arrange
-	int result;
-	delivery_number delivery_id;
-	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE);
-	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1", test_frame_received_callback, test_on_session_state_changed, test_on_flow_on, NULL);
-	saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
-	STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_BEGIN_PERFORMATIVE));
-	STRICT_EXPECTED_CALL(definition_mocks, is_begin_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
-	saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
-	umock_c_reset_all_calls();
+	SESSION_STATISTICS statistics;
 
-	STRICT_EXPECTED_CALL(definition_mocks, transfer_set_delivery_id(test_transfer_handle, 0));
-	STRICT_EXPECTED_CALL(definition_mocks, amqpvalue_create_transfer(test_transfer_handle));
-	STRICT_EXPECTED_CALL(connection_get_remote_max_frame_size(TEST_CONNECTION_HANDLE, IGNORED_PTR_ARG))
-		.CopyOutArgumentBuffer(2, &some_remote_max_frame_size, sizeof(some_remote_max_frame_size));
-	STRICT_EXPECTED_CALL(connection_encode_frame(TEST_ENDPOINT_HANDLE, test_transfer_amqp_value, NULL, 0, test_on_send_complete, (void*)0x4242));
-	STRICT_EXPECTED_CALL(amqpvalue_destroy(test_transfer_amqp_value));
+	// act
+	int result = session_get_statistics(NULL, &statistics);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(session_get_statistics_with_NULL_statistics_fails)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	umock_c_reset_all_calls();
 
 	// act
-	result = session_send_transfer(link_endpoint, test_transfer_handle, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+	int result = session_get_statistics(session, NULL);
 
 	// assert
-	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
 	// cleanup
-	session_destroy_link_endpoint(link_endpoint);
 	session_destroy(session);
 }
-#endif
 
-/* Tests_SRS_SESSION_01_054: [If link_endpoint or transfer is NULL, session_send_transfer shall fail and return a non-zero value.] */
-TEST_FUNCTION(session_transfer_with_NULL_transfer_fails)
+TEST_FUNCTION(session_get_statistics_reports_the_windows_and_link_endpoint_count)
 {
 	// arrange
-	int result;
-	delivery_number delivery_id;
 	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
 	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	SESSION_STATISTICS statistics;
+	(void)session_set_incoming_window(session, 42);
 	umock_c_reset_all_calls();
 
 	// act
-	result = session_send_transfer(link_endpoint, NULL, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+	int result = session_get_statistics(session, &statistics);
 
 	// assert
-	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(int, 0, result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(uint32_t, 42, statistics.incoming_window);
+	ASSERT_ARE_EQUAL(uint32_t, 1, statistics.outgoing_window);
+	ASSERT_ARE_EQUAL(uint32_t, 1, statistics.link_endpoint_count);
+	ASSERT_ARE_EQUAL(uint64_t, 0, statistics.transfers_sent);
+	ASSERT_ARE_EQUAL(uint64_t, 0, statistics.send_transfer_busy_count);
 
 	// cleanup
 	session_destroy_link_endpoint(link_endpoint);
 	session_destroy(session);
 }
 
-/* Tests_SRS_SESSION_01_054: [If link_endpoint or transfer is NULL, session_send_transfer shall fail and return a non-zero value.] */
-TEST_FUNCTION(session_transfer_with_NULL_link_endpoint_fails)
+/* session_set_link_endpoint_weight */
+
+TEST_FUNCTION(a_reopened_window_is_shared_by_the_waiting_links_in_proportion_to_their_weights)
 {
 	// arrange
+	TEST_SCHEDULED_LINK test_scheduled_links[TEST_SCHEDULED_LINK_COUNT];
+	const uint32_t weights[TEST_SCHEDULED_LINK_COUNT] = { 1, 3 };
+	SESSION_HANDLE session = create_session_with_waiting_links(test_scheduled_links, weights);
 
 	// act
-	delivery_number delivery_id;
-	int result = session_send_transfer(NULL, test_transfer_handle, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+	/* two rounds of 16 and 3 * 16 transfers */
+	receive_session_flow(128);
 
 	// assert
-	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(size_t, 32, test_scheduled_links[0].transfers_sent);
+	ASSERT_ARE_EQUAL(size_t, 96, test_scheduled_links[1].transfers_sent);
+
+	// cleanup
+	destroy_session_with_links(session, test_scheduled_links);
 }
 
-#if 0
-/* Tests_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
-TEST_FUNCTION(when_transfer_set_delivery_id_fails_then_session_transfer_fails)
+TEST_FUNCTION(each_link_of_weight_1_is_handed_a_quantum_of_16_transfers_per_round)
 {
 	// arrange
-	int result;
-	delivery_number delivery_id;
-	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE);
-	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1", test_frame_received_callback, test_on_session_state_changed, test_on_flow_on, NULL);
-	saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
-	STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_BEGIN_PERFORMATIVE));
-	STRICT_EXPECTED_CALL(definition_mocks, is_begin_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
-	saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
-	umock_c_reset_all_calls();
-
-	STRICT_EXPECTED_CALL(definition_mocks, transfer_set_delivery_id(test_transfer_handle, 0))
-		.SetReturn(1);
+	TEST_SCHEDULED_LINK test_scheduled_links[TEST_SCHEDULED_LINK_COUNT];
+	const uint32_t weights[TEST_SCHEDULED_LINK_COUNT] = { 1, 1 };
+	SESSION_HANDLE session = create_session_with_waiting_links(test_scheduled_links, weights);
 
 	// act
-	result = session_send_transfer(link_endpoint, test_transfer_handle, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+	/* the first link cannot take more than its quantum while the second one waits */
+	receive_session_flow(100);
 
 	// assert
-	ASSERT_ARE_NOT_EQUAL(int, 0, result);
-	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 16 * 3 + 4, test_scheduled_links[0].transfers_sent);
+	ASSERT_ARE_EQUAL(size_t, 16 * 3, test_scheduled_links[1].transfers_sent);
 
 	// cleanup
-	session_destroy_link_endpoint(link_endpoint);
-	session_destroy(session);
+	destroy_session_with_links(session, test_scheduled_links);
 }
 
-/* Tests_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
-TEST_FUNCTION(when_amqpvalue_create_transfer_fails_then_session_transfer_fails)
+TEST_FUNCTION(the_deficit_a_link_could_not_spend_when_the_window_closed_carries_over_to_the_next_window)
 {
 	// arrange
-	int result;
-	delivery_number delivery_id;
-	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE);
-	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1", test_frame_received_callback, test_on_session_state_changed, test_on_flow_on, NULL);
-	saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
-	STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_BEGIN_PERFORMATIVE));
-	STRICT_EXPECTED_CALL(definition_mocks, is_begin_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
-	saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
-	umock_c_reset_all_calls();
+	TEST_SCHEDULED_LINK test_scheduled_links[TEST_SCHEDULED_LINK_COUNT];
+	const uint32_t weights[TEST_SCHEDULED_LINK_COUNT] = { 1, 1 };
+	SESSION_HANDLE session = create_session_with_waiting_links(test_scheduled_links, weights);
+	/* 16 each, then the first link is left with 8 of its second quantum when the window closes */
+	receive_session_flow(40);
+	ASSERT_ARE_EQUAL(size_t, 24, test_scheduled_links[0].transfers_sent);
+	ASSERT_ARE_EQUAL(size_t, 16, test_scheduled_links[1].transfers_sent);
 
-	STRICT_EXPECTED_CALL(definition_mocks, transfer_set_delivery_id(test_transfer_handle, 0));
-	STRICT_EXPECTED_CALL(connection_get_remote_max_frame_size(TEST_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+	// act
+	/* the round goes on with the second link, and the first one sends its 8 on top of a fresh quantum */
+	receive_session_flow(40);
+
+	// assert
+	ASSERT_ARE_EQUAL(size_t, 24 + 24, test_scheduled_links[0].transfers_sent);
+	ASSERT_ARE_EQUAL(size_t, 16 + 16, test_scheduled_links[1].transfers_sent);
+
+	// cleanup
+	destroy_session_with_links(session, test_scheduled_links);
+}
+
+TEST_FUNCTION(session_set_link_endpoint_weight_with_weight_0_fails)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	umock_c_reset_all_calls();
+
+	// act
+	int result = session_set_link_endpoint_weight(link_endpoint, 0);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(session_set_link_endpoint_weight_with_NULL_link_endpoint_fails)
+{
+	// arrange
+
+	// act
+	int result = session_set_link_endpoint_weight(NULL, 1);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* session_send_transfer */
+
+#if 0
+/* Tests_SRS_SESSION_01_051: [session_send_transfer shall send a transfer frame with the performative indicated in the transfer argument.] */
+/* Tests_SRS_SESSION_01_053: [On success, session_send_transfer shall return 0.] */
+/* Tests_SRS_SESSION_01_055: [The encoding of the frame shall be done by calling connection_encode_frame and passing as arguments: the connection handle associated with the session, the transfer performative and the payload chunks passed to session_send_transfer.] */
+/* Tests_SRS_SESSION_01_057: [The delivery ids shall be assigned starting at 0.] */
+TEST_FUNCTION(session_transfer_sends_the_frame_to_the_connection)
+{
+	// arrange
+	int result;
+	delivery_number delivery_id;
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1", test_frame_received_callback, test_on_session_state_changed, test_on_flow_on, NULL);
+	saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
+	STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_BEGIN_PERFORMATIVE));
+	STRICT_EXPECTED_CALL(definition_mocks, is_begin_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
+	saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(definition_mocks, transfer_set_delivery_id(test_transfer_handle, 0));
+	STRICT_EXPECTED_CALL(definition_mocks, amqpvalue_create_transfer(test_transfer_handle));
+	STRICT_EXPECTED_CALL(connection_get_remote_max_frame_size(TEST_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+		.CopyOutArgumentBuffer(2, &some_remote_max_frame_size, sizeof(some_remote_max_frame_size));
+	STRICT_EXPECTED_CALL(connection_encode_frame(TEST_ENDPOINT_HANDLE, test_transfer_amqp_value, NULL, 0, test_on_send_complete, (void*)0x4242));
+	STRICT_EXPECTED_CALL(amqpvalue_destroy(test_transfer_amqp_value));
+
+	// act
+	result = session_send_transfer(link_endpoint, test_transfer_handle, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+#endif
+
+/* Tests_SRS_SESSION_01_054: [If link_endpoint or transfer is NULL, session_send_transfer shall fail and return a non-zero value.] */
+TEST_FUNCTION(session_transfer_with_NULL_transfer_fails)
+{
+	// arrange
+	int result;
+	delivery_number delivery_id;
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	umock_c_reset_all_calls();
+
+	// act
+	result = session_send_transfer(link_endpoint, NULL, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+/* Tests_SRS_SESSION_01_054: [If link_endpoint or transfer is NULL, session_send_transfer shall fail and return a non-zero value.] */
+TEST_FUNCTION(session_transfer_with_NULL_link_endpoint_fails)
+{
+	// arrange
+
+	// act
+	delivery_number delivery_id;
+	int result = session_send_transfer(NULL, test_transfer_handle, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+#if 0
+/* Tests_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
+TEST_FUNCTION(when_transfer_set_delivery_id_fails_then_session_transfer_fails)
+{
+	// arrange
+	int result;
+	delivery_number delivery_id;
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1", test_frame_received_callback, test_on_session_state_changed, test_on_flow_on, NULL);
+	saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
+	STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_BEGIN_PERFORMATIVE));
+	STRICT_EXPECTED_CALL(definition_mocks, is_begin_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
+	saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(definition_mocks, transfer_set_delivery_id(test_transfer_handle, 0))
+		.SetReturn(1);
+
+	// act
+	result = session_send_transfer(link_endpoint, test_transfer_handle, NULL, 0, &delivery_id, test_on_send_complete, (void*)0x4242);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+/* Tests_SRS_SESSION_01_058: [When any other error occurs, session_send_transfer shall fail and return a non-zero value.] */
+TEST_FUNCTION(when_amqpvalue_create_transfer_fails_then_session_transfer_fails)
+{
+	// arrange
+	int result;
+	delivery_number delivery_id;
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1", test_frame_received_callback, test_on_session_state_changed, test_on_flow_on, NULL);
+	saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
+	STRICT_EXPECTED_CALL(amqpvalue_get_inplace_descriptor(TEST_BEGIN_PERFORMATIVE));
+	STRICT_EXPECTED_CALL(definition_mocks, is_begin_type_by_descriptor(TEST_DESCRIPTOR_AMQP_VALUE));
+	saved_frame_received_callback(saved_callback_context, TEST_BEGIN_PERFORMATIVE, 0, NULL);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(definition_mocks, transfer_set_delivery_id(test_transfer_handle, 0));
+	STRICT_EXPECTED_CALL(connection_get_remote_max_frame_size(TEST_CONNECTION_HANDLE, IGNORED_PTR_ARG))
 		.CopyOutArgumentBuffer(2, &some_remote_max_frame_size, sizeof(some_remote_max_frame_size));
 	STRICT_EXPECTED_CALL(definition_mocks, amqpvalue_create_transfer(test_transfer_handle))
 		.SetReturn(NULL);
@@ -667,6 +1234,425 @@ TEST_FUNCTION(when_session_is_not_MAPPED_the_transfer_fails)
 	session_destroy(session);
 }
 
+/* session_send_transfer_frame */
+
+TEST_FUNCTION(the_frames_of_a_delivery_carry_the_delivery_id_of_its_first_frame)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_mapped_session(100, &link_endpoint);
+	delivery_number delivery_ids[4];
+
+	// act
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)send_transfer_frame(link_endpoint, true, true, &delivery_ids[0]));
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)send_transfer_frame(link_endpoint, false, true, &delivery_ids[1]));
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)send_transfer_frame(link_endpoint, false, false, &delivery_ids[2]));
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)send_transfer_frame(link_endpoint, true, false, &delivery_ids[3]));
+
+	// assert
+	ASSERT_ARE_EQUAL(uint32_t, 0, delivery_ids[0]);
+	ASSERT_ARE_EQUAL(uint32_t, 0, delivery_ids[1]);
+	ASSERT_ARE_EQUAL(uint32_t, 0, delivery_ids[2]);
+	ASSERT_ARE_EQUAL(uint32_t, 1, delivery_ids[3]);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(a_frame_without_a_delivery_tag_while_no_delivery_is_being_sent_fails)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_mapped_session(100, &link_endpoint);
+	delivery_number delivery_id;
+	SESSION_SEND_TRANSFER_RESULT result;
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)send_transfer_frame(link_endpoint, true, false, &delivery_id));
+
+	// act
+	result = send_transfer_frame(link_endpoint, false, false, &delivery_id);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_ERROR, (int)result);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(each_frame_of_a_delivery_takes_a_slot_of_the_remote_incoming_window)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_mapped_session(2, &link_endpoint);
+	delivery_number delivery_id;
+	SESSION_SEND_TRANSFER_RESULT result;
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)send_transfer_frame(link_endpoint, true, true, &delivery_id));
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)send_transfer_frame(link_endpoint, false, true, &delivery_id));
+
+	// act
+	result = send_transfer_frame(link_endpoint, false, false, &delivery_id);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_BUSY, (int)result);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(an_aborted_frame_is_sent_with_the_window_closed_and_ends_the_delivery)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_mapped_session(1, &link_endpoint);
+	delivery_number delivery_id = 42;
+	SESSION_SEND_TRANSFER_RESULT result;
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)send_transfer_frame(link_endpoint, true, true, &delivery_id));
+	test_transfer_aborted = true;
+
+	// act
+	result = send_transfer_frame(link_endpoint, false, false, &delivery_id);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)result);
+	ASSERT_ARE_EQUAL(uint32_t, 0, delivery_id);
+	test_transfer_aborted = false;
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_ERROR, (int)send_transfer_frame(link_endpoint, false, false, &delivery_id));
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(a_transfer_frame_whose_payload_does_not_fit_in_the_max_frame_size_fails)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_mapped_session(100, &link_endpoint);
+	unsigned char payload_bytes[512 - 20 - 8 + 1] = { 0 };
+	PAYLOAD payload;
+	delivery_number delivery_id;
+	SESSION_SEND_TRANSFER_RESULT result;
+	test_transfer_encoded_size = 20;
+	payload.bytes = payload_bytes;
+	payload.length = sizeof(payload_bytes);
+
+	// act
+	result = session_send_transfer_frame(link_endpoint, test_transfer_handle, &payload, 1, &delivery_id, NULL, NULL);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_ERROR, (int)result);
+	/* one byte less fits */
+	payload.length--;
+	ASSERT_ARE_EQUAL(int, (int)SESSION_SEND_TRANSFER_OK, (int)session_send_transfer_frame(link_endpoint, test_transfer_handle, &payload, 1, &delivery_id, NULL, NULL));
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+/* session_get_transfer_frame_payload_size */
+
+TEST_FUNCTION(session_get_transfer_frame_payload_size_leaves_room_for_the_largest_transfer_performative_and_the_frame_header)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	uint32_t payload_size;
+	int result;
+	test_transfer_encoded_size = 20;
+	umock_c_reset_all_calls();
+
+	// act
+	result = session_get_transfer_frame_payload_size(link_endpoint, test_transfer_handle, &payload_size);
+
+	// assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(uint32_t, 512 - 20 - 8, payload_size);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(session_get_transfer_frame_payload_size_when_the_max_frame_size_leaves_no_room_for_a_payload_fails)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	uint32_t payload_size;
+	int result;
+	test_transfer_encoded_size = 512 - 8;
+	umock_c_reset_all_calls();
+
+	// act
+	result = session_get_transfer_frame_payload_size(link_endpoint, test_transfer_handle, &payload_size);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(session_get_transfer_frame_payload_size_with_NULL_link_endpoint_fails)
+{
+	// arrange
+	uint32_t payload_size;
+
+	// act
+	int result = session_get_transfer_frame_payload_size(NULL, test_transfer_handle, &payload_size);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(session_get_transfer_frame_payload_size_with_NULL_payload_size_fails)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	LINK_ENDPOINT_HANDLE link_endpoint = session_create_link_endpoint(session, "1");
+	int result;
+	umock_c_reset_all_calls();
+
+	// act
+	result = session_get_transfer_frame_payload_size(link_endpoint, test_transfer_handle, NULL);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+/* incoming window */
+
+TEST_FUNCTION(the_begin_frame_opens_an_incoming_window_of_1024_transfers)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	(void)session_begin(session);
+
+	// act
+	saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
+
+	// assert
+	ASSERT_ARE_EQUAL(uint32_t, 1024, sent_begin_incoming_window);
+
+	// cleanup
+	session_destroy(session);
+}
+
+TEST_FUNCTION(the_begin_frame_opens_the_incoming_window_set_with_session_set_incoming_window)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	ASSERT_ARE_EQUAL(int, 0, session_set_incoming_window(session, 42));
+	(void)session_begin(session);
+
+	// act
+	saved_connection_state_changed_callback(saved_callback_context, CONNECTION_STATE_OPENED, CONNECTION_STATE_OPEN_SENT);
+
+	// assert
+	ASSERT_ARE_EQUAL(uint32_t, 42, sent_begin_incoming_window);
+
+	// cleanup
+	session_destroy(session);
+}
+
+TEST_FUNCTION(the_incoming_window_is_reopened_with_a_flow_once_half_of_it_is_used)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_receiving_session(&link_endpoint);
+	receive_transfers(511, 0);
+	ASSERT_ARE_EQUAL(size_t, 0, sent_flow_count);
+
+	// act
+	receive_transfers(1, 0);
+
+	// assert
+	ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+	/* no rate measured yet, the window keeps its size */
+	ASSERT_ARE_EQUAL(uint32_t, 1024, sent_flow_incoming_window);
+	ASSERT_ARE_EQUAL(uint32_t, 1024, get_incoming_window(session));
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(the_incoming_window_at_most_doubles_per_refill)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_receiving_session(&link_endpoint);
+	receive_transfers(512, 0);
+	test_current_ms = 1;
+
+	// act
+	/* 512 transfers in 1 ms would call for a window of 51200 */
+	receive_transfers(512, 0);
+
+	// assert
+	ASSERT_ARE_EQUAL(size_t, 2, sent_flow_count);
+	ASSERT_ARE_EQUAL(uint32_t, 2048, sent_flow_incoming_window);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(the_incoming_window_at_most_halves_per_refill)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_receiving_session(&link_endpoint);
+	receive_transfers(512, 0);
+	test_current_ms = 10000;
+
+	// act
+	/* 512 transfers in 10 s would call for a window of 5 */
+	receive_transfers(512, 0);
+
+	// assert
+	ASSERT_ARE_EQUAL(size_t, 2, sent_flow_count);
+	ASSERT_ARE_EQUAL(uint32_t, 512, sent_flow_incoming_window);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(the_incoming_window_does_not_shrink_below_64_transfers)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_receiving_session(&link_endpoint);
+	uint32_t expected_windows[] = { 512, 256, 128, 64, 64 };
+	size_t i;
+	receive_transfers(512, 0);
+
+	for (i = 0; i < sizeof(expected_windows) / sizeof(expected_windows[0]); i++)
+	{
+		// act
+		test_current_ms += 100000;
+		receive_transfers(get_incoming_window(session) / 2, 0);
+
+		// assert
+		ASSERT_ARE_EQUAL(uint32_t, expected_windows[i], sent_flow_incoming_window);
+	}
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(the_incoming_window_topped_up_by_link_flows_does_not_grow_past_1048576_transfers)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_receiving_session(&link_endpoint);
+	uint32_t expected_window = 1024;
+	receive_transfers(1, 0);
+	ASSERT_ARE_EQUAL(int, 0, session_send_flow(link_endpoint, TEST_FLOW_HANDLE));
+
+	// act
+	/* within the same ms, a 32nd of the window calls for more than twice its size */
+	while (expected_window < 1048576)
+	{
+		receive_transfers(expected_window / 32, 0);
+		ASSERT_ARE_EQUAL(int, 0, session_send_flow(link_endpoint, TEST_FLOW_HANDLE));
+		expected_window *= 2;
+
+		// assert
+		ASSERT_ARE_EQUAL(uint32_t, expected_window, get_incoming_window(session));
+	}
+
+	receive_transfers(1048576 / 32, 0);
+	ASSERT_ARE_EQUAL(int, 0, session_send_flow(link_endpoint, TEST_FLOW_HANDLE));
+	ASSERT_ARE_EQUAL(uint32_t, 1048576, get_incoming_window(session));
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(session_set_incoming_window_stops_the_incoming_window_from_adapting)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_receiving_session(&link_endpoint);
+	ASSERT_ARE_EQUAL(int, 0, session_set_incoming_window(session, 100));
+	receive_transfers(50, 0);
+	test_current_ms = 1;
+
+	// act
+	receive_transfers(50, 0);
+
+	// assert
+	ASSERT_ARE_EQUAL(size_t, 2, sent_flow_count);
+	ASSERT_ARE_EQUAL(uint32_t, 100, sent_flow_incoming_window);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+/* session_set_incoming_window_budget */
+
+TEST_FUNCTION(the_incoming_window_holds_at_most_the_budget_in_transfers_of_the_average_size)
+{
+	// arrange
+	LINK_ENDPOINT_HANDLE link_endpoint;
+	SESSION_HANDLE session = create_receiving_session(&link_endpoint);
+	ASSERT_ARE_EQUAL(int, 0, session_set_incoming_window_budget(session, 16 * 1024));
+
+	// act
+	receive_transfers(512, 1024);
+
+	// assert
+	/* below the 64 transfers the rate alone would keep */
+	ASSERT_ARE_EQUAL(size_t, 1, sent_flow_count);
+	ASSERT_ARE_EQUAL(uint32_t, 16, sent_flow_incoming_window);
+
+	// cleanup
+	session_destroy_link_endpoint(link_endpoint);
+	session_destroy(session);
+}
+
+TEST_FUNCTION(session_set_incoming_window_budget_with_NULL_session_fails)
+{
+	// arrange
+
+	// act
+	int result = session_set_incoming_window_budget(NULL, 16 * 1024);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(session_set_incoming_window_budget_with_0_bytes_fails)
+{
+	// arrange
+	SESSION_HANDLE session = session_create(TEST_CONNECTION_HANDLE, NULL, NULL);
+	int result;
+	umock_c_reset_all_calls();
+
+	// act
+	result = session_set_incoming_window_budget(session, 0);
+
+	// assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+	// cleanup
+	session_destroy(session);
+}
+
 /* on_connection_state_changed */
 
 #if 0
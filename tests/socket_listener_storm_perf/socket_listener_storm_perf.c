@@ -0,0 +1,267 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* Connection storm: STORM_CONNECTION_COUNT clients connect at once (as a fleet of devices does after an outage) and
+   the time until every connection is accepted is measured, with socketlistener_dowork called every DOWORK_PERIOD ms.
+   The storm is run against a single listener and then against one SO_REUSEPORT listener per worker thread. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_uamqp_c/socket_listener.h"
+
+#define TEST_PORT 5675
+#define STORM_CONNECTION_COUNT 400
+#define STORM_COUNT 5
+#define LISTENER_THREAD_COUNT 4
+#define DOWORK_PERIOD 1 // ms
+#define STORM_TIMEOUT 10000 // ms
+
+typedef struct LISTENER_THREAD_TAG
+{
+	SOCKET_LISTENER_HANDLE socket_listener;
+	THREAD_HANDLE thread;
+	size_t dowork_count;
+
+	/* written by the listener thread, read by the main thread */
+	size_t accepted_count;
+} LISTENER_THREAD;
+
+static size_t total_accepted_count;
+static volatile int is_storm_running;
+
+static uint64_t get_time_ms(void)
+{
+	struct timespec now;
+	(void)clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * 1000) + ((uint64_t)now.tv_nsec / 1000000);
+}
+
+static void on_socket_accepted(void* context, const IO_INTERFACE_DESCRIPTION* interface_description, void* io_parameters)
+{
+	LISTENER_THREAD* listener_thread = (LISTENER_THREAD*)context;
+	SOCKETIO_CONFIG* socketio_config = (SOCKETIO_CONFIG*)io_parameters;
+	struct linger linger_option;
+	(void)interface_description;
+
+	/* only the accept path is measured, the connection is dropped right away; with a reset rather than a FIN,
+	   so that no TIME_WAIT is left on the listening port to make the next bind fail */
+	linger_option.l_onoff = 1;
+	linger_option.l_linger = 0;
+	(void)setsockopt(*(int*)socketio_config->accepted_socket, SOL_SOCKET, SO_LINGER, &linger_option, sizeof(linger_option));
+	(void)close(*(int*)socketio_config->accepted_socket);
+
+	__atomic_store_n(&listener_thread->accepted_count, listener_thread->accepted_count + 1, __ATOMIC_RELAXED);
+	(void)__atomic_add_fetch(&total_accepted_count, 1, __ATOMIC_RELAXED);
+}
+
+static int listener_thread_func(void* arg)
+{
+	LISTENER_THREAD* listener_thread = (LISTENER_THREAD*)arg;
+
+	while (__atomic_load_n(&is_storm_running, __ATOMIC_RELAXED))
+	{
+		socketlistener_dowork(listener_thread->socket_listener);
+		listener_thread->dowork_count++;
+		ThreadAPI_Sleep(DOWORK_PERIOD);
+	}
+
+	return 0;
+}
+
+static int start_connect(void)
+{
+	int result = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (result == -1)
+	{
+		LogError("Cannot create client socket");
+	}
+	else
+	{
+		struct sockaddr_in sa;
+		int flags;
+
+		(void)memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		sa.sin_port = htons(TEST_PORT);
+		sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		/* the handshake is completed by the kernel, the connection then waits in the accept queue */
+		if ((-1 == (flags = fcntl(result, F_GETFL, 0))) ||
+			(fcntl(result, F_SETFL, flags | O_NONBLOCK) == -1) ||
+			((connect(result, (const struct sockaddr*)&sa, sizeof(sa)) != 0) && (errno != EINPROGRESS)))
+		{
+			LogError("Cannot connect client socket");
+			(void)close(result);
+			result = -1;
+		}
+	}
+
+	return result;
+}
+
+static int run_storms(size_t listener_count)
+{
+	int result = 0;
+	LISTENER_THREAD listener_threads[LISTENER_THREAD_COUNT];
+	size_t i;
+
+	(void)memset(listener_threads, 0, sizeof(listener_threads));
+
+	for (i = 0; i < listener_count; i++)
+	{
+		listener_threads[i].socket_listener = socketlistener_create(TEST_PORT);
+		if (listener_threads[i].socket_listener == NULL)
+		{
+			LogError("Cannot create socket listener");
+			result = __LINE__;
+			break;
+		}
+		else if (((listener_count > 1) && (socketlistener_set_reuse_port(listener_threads[i].socket_listener, true) != 0)) ||
+			(socketlistener_start(listener_threads[i].socket_listener, on_socket_accepted, &listener_threads[i]) != 0))
+		{
+			LogError("Cannot start socket listener");
+			result = __LINE__;
+			break;
+		}
+	}
+
+	if (result == 0)
+	{
+		int client_sockets[STORM_CONNECTION_COUNT];
+		uint64_t total_storm_ms = 0;
+		uint64_t worst_storm_ms = 0;
+		size_t storm;
+
+		for (storm = 0; (result == 0) && (storm < STORM_COUNT); storm++)
+		{
+			size_t client_count;
+			uint64_t start_ms;
+			uint64_t storm_ms;
+
+			__atomic_store_n(&total_accepted_count, 0, __ATOMIC_RELAXED);
+			__atomic_store_n(&is_storm_running, 1, __ATOMIC_RELAXED);
+
+			for (i = 0; i < listener_count; i++)
+			{
+				if (ThreadAPI_Create(&listener_threads[i].thread, listener_thread_func, &listener_threads[i]) != THREADAPI_OK)
+				{
+					LogError("Cannot create listener thread");
+					listener_threads[i].thread = NULL;
+					result = __LINE__;
+				}
+			}
+
+			start_ms = get_time_ms();
+
+			for (client_count = 0; (result == 0) && (client_count < STORM_CONNECTION_COUNT); client_count++)
+			{
+				client_sockets[client_count] = start_connect();
+				if (client_sockets[client_count] == -1)
+				{
+					result = __LINE__;
+					break;
+				}
+			}
+
+			while ((result == 0) &&
+				(__atomic_load_n(&total_accepted_count, __ATOMIC_RELAXED) < STORM_CONNECTION_COUNT))
+			{
+				if (get_time_ms() - start_ms > STORM_TIMEOUT)
+				{
+					LogError("Timeout, %u of %u connections accepted",
+						(unsigned int)__atomic_load_n(&total_accepted_count, __ATOMIC_RELAXED), (unsigned int)STORM_CONNECTION_COUNT);
+					result = __LINE__;
+				}
+				else
+				{
+					ThreadAPI_Sleep(1);
+				}
+			}
+
+			storm_ms = get_time_ms() - start_ms;
+
+			__atomic_store_n(&is_storm_running, 0, __ATOMIC_RELAXED);
+			for (i = 0; i < listener_count; i++)
+			{
+				if (listener_threads[i].thread != NULL)
+				{
+					int thread_result;
+					(void)ThreadAPI_Join(listener_threads[i].thread, &thread_result);
+					listener_threads[i].thread = NULL;
+				}
+			}
+
+			while (client_count > 0)
+			{
+				client_count--;
+				(void)close(client_sockets[client_count]);
+			}
+
+			total_storm_ms += storm_ms;
+			if (storm_ms > worst_storm_ms)
+			{
+				worst_storm_ms = storm_ms;
+			}
+		}
+
+		if (result == 0)
+		{
+			LogInfo("%u listener(s): %u connections accepted in %.1f ms on average, %u ms worst, over %u storms",
+				(unsigned int)listener_count, (unsigned int)STORM_CONNECTION_COUNT,
+				(double)total_storm_ms / STORM_COUNT, (unsigned int)worst_storm_ms, (unsigned int)STORM_COUNT);
+
+			for (i = 0; i < listener_count; i++)
+			{
+				LogInfo("  listener %u: %u accepted in %u dowork calls over all storms",
+					(unsigned int)i, (unsigned int)listener_threads[i].accepted_count, (unsigned int)listener_threads[i].dowork_count);
+			}
+		}
+	}
+
+	for (i = 0; i < listener_count; i++)
+	{
+		if (listener_threads[i].socket_listener != NULL)
+		{
+			socketlistener_destroy(listener_threads[i].socket_listener);
+		}
+	}
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		result = run_storms(1);
+		if (result == 0)
+		{
+			result = run_storms(LISTENER_THREAD_COUNT);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}
@@ -0,0 +1,508 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#endif
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/timer_wheel.h"
+
+#define TEST_CONTEXT					(void*)0x4444
+#define TEST_START_MS					1000
+#define TEST_TIMER_COUNT				100000
+
+static size_t expired_count;
+static void* last_expired_context;
+static TIMER_WHEEL_TIMER_HANDLE rescheduled_timer;
+static tickcounter_ms_t rescheduled_expiry_ms;
+static tickcounter_ms_t test_expiry_times[TEST_TIMER_COUNT];
+static TIMER_WHEEL_TIMER_HANDLE test_timers[TEST_TIMER_COUNT];
+static tickcounter_ms_t test_current_ms;
+static size_t early_expiry_count;
+
+static void test_on_timer_expired(void* context)
+{
+    expired_count++;
+    last_expired_context = context;
+
+    if (rescheduled_timer != NULL)
+    {
+        (void)timer_wheel_schedule(rescheduled_timer, rescheduled_expiry_ms);
+        rescheduled_timer = NULL;
+    }
+}
+
+static void test_on_many_timers_expired(void* context)
+{
+    size_t index = (size_t)context;
+
+    expired_count++;
+    if (test_expiry_times[index] > test_current_ms)
+    {
+        early_expiry_count++;
+    }
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(timer_wheel_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    expired_count = 0;
+    last_expired_context = NULL;
+    rescheduled_timer = NULL;
+    rescheduled_expiry_ms = 0;
+    early_expiry_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* timer_wheel_create */
+
+TEST_FUNCTION(timer_wheel_create_allocates_the_wheel)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    timer_wheel = timer_wheel_create(TEST_START_MS);
+
+    // assert
+    ASSERT_IS_NOT_NULL(timer_wheel);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(when_allocating_the_wheel_fails_timer_wheel_create_fails)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    timer_wheel = timer_wheel_create(TEST_START_MS);
+
+    // assert
+    ASSERT_IS_NULL(timer_wheel);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* timer_wheel_create_timer */
+
+TEST_FUNCTION(timer_wheel_create_timer_with_NULL_wheel_fails)
+{
+    // arrange
+
+    // act
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(NULL, test_on_timer_expired, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(timer);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(timer_wheel_create_timer_with_NULL_callback_fails)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer;
+    umock_c_reset_all_calls();
+
+    // act
+    timer = timer_wheel_create_timer(timer_wheel, NULL, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(timer);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    timer_wheel_destroy(timer_wheel);
+}
+
+/* timer_wheel_schedule */
+
+TEST_FUNCTION(timer_wheel_schedule_with_NULL_timer_fails)
+{
+    // arrange
+
+    // act
+    int result = timer_wheel_schedule(NULL, TEST_START_MS);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/* timer_wheel_advance */
+
+TEST_FUNCTION(a_timer_fires_when_its_expiry_time_is_reached_and_not_before)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    (void)timer_wheel_schedule(timer, TEST_START_MS + 10);
+
+    // act
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 9);
+    ASSERT_ARE_EQUAL(size_t, 0, expired_count);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 10);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, expired_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT, last_expired_context);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_timer_scheduled_in_the_past_fires_on_the_next_advance)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    (void)timer_wheel_schedule(timer, TEST_START_MS - 500);
+
+    // act
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, expired_count);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_cancelled_timer_does_not_fire)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    (void)timer_wheel_schedule(timer, TEST_START_MS + 10);
+
+    // act
+    timer_wheel_cancel(timer);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 100);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, expired_count);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(rescheduling_a_timer_moves_its_expiry)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    (void)timer_wheel_schedule(timer, TEST_START_MS + 10);
+
+    // act
+    (void)timer_wheel_schedule(timer, TEST_START_MS + 5000);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 4999);
+    ASSERT_ARE_EQUAL(size_t, 0, expired_count);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 5000);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, expired_count);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_timer_rescheduled_from_its_callback_fires_again)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    (void)timer_wheel_schedule(timer, TEST_START_MS + 10);
+    rescheduled_timer = timer;
+    rescheduled_expiry_ms = TEST_START_MS + 20;
+
+    // act
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 15);
+    ASSERT_ARE_EQUAL(size_t, 1, expired_count);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 20);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, expired_count);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(timers_in_higher_levels_cascade_down_and_fire_on_time)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    tickcounter_ms_t current_ms;
+
+    /* far enough to start out 3 levels up */
+    (void)timer_wheel_schedule(timer, TEST_START_MS + 300000);
+
+    // act
+    for (current_ms = TEST_START_MS; current_ms < TEST_START_MS + 300000; current_ms += 997)
+    {
+        (void)timer_wheel_advance(timer_wheel, current_ms);
+    }
+
+    ASSERT_ARE_EQUAL(size_t, 0, expired_count);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 300000);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, expired_count);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(a_timer_beyond_the_wheel_range_fires_on_time)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    tickcounter_ms_t expiry_ms = TEST_START_MS + ((tickcounter_ms_t)1 << 40);
+    (void)timer_wheel_schedule(timer, expiry_ms);
+
+    // act
+    (void)timer_wheel_advance(timer_wheel, expiry_ms - 1);
+    ASSERT_ARE_EQUAL(size_t, 0, expired_count);
+    (void)timer_wheel_advance(timer_wheel, expiry_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, expired_count);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+/* timer_wheel_schedule_after */
+
+TEST_FUNCTION(timer_wheel_schedule_after_counts_from_the_time_the_wheel_was_advanced_to)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 100);
+
+    // act
+    (void)timer_wheel_schedule_after(timer, 50);
+
+    // assert
+    ASSERT_IS_TRUE(timer_wheel_get_time_to_next_expiry(timer_wheel, TEST_START_MS + 100) == 50);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 149);
+    ASSERT_ARE_EQUAL(size_t, 0, expired_count);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 150);
+    ASSERT_ARE_EQUAL(size_t, 1, expired_count);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(timer_wheel_schedule_after_on_a_new_wheel_counts_from_its_creation_time)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+
+    // act
+    (void)timer_wheel_schedule_after(timer, 10);
+
+    // assert
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 9);
+    ASSERT_ARE_EQUAL(size_t, 0, expired_count);
+    (void)timer_wheel_advance(timer_wheel, TEST_START_MS + 10);
+    ASSERT_ARE_EQUAL(size_t, 1, expired_count);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer);
+    timer_wheel_destroy(timer_wheel);
+}
+
+/* timer_wheel_get_time_to_next_expiry */
+
+TEST_FUNCTION(timer_wheel_get_time_to_next_expiry_with_no_timers_returns_max)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    uint64_t result;
+
+    // act
+    result = timer_wheel_get_time_to_next_expiry(timer_wheel, TEST_START_MS);
+
+    // assert
+    ASSERT_IS_TRUE(result == (uint64_t)-1);
+
+    // cleanup
+    timer_wheel_destroy(timer_wheel);
+}
+
+TEST_FUNCTION(timer_wheel_get_time_to_next_expiry_returns_the_time_to_the_earliest_timer)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer_1 = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    TIMER_WHEEL_TIMER_HANDLE timer_2 = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    TIMER_WHEEL_TIMER_HANDLE timer_3 = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    uint64_t result;
+    (void)timer_wheel_schedule(timer_1, TEST_START_MS + 120000);
+    (void)timer_wheel_schedule(timer_2, TEST_START_MS + 4321);
+    (void)timer_wheel_schedule(timer_3, TEST_START_MS + 5000);
+
+    // act
+    result = timer_wheel_get_time_to_next_expiry(timer_wheel, TEST_START_MS + 21);
+
+    // assert
+    ASSERT_IS_TRUE(result == 4300);
+
+    // cleanup
+    timer_wheel_destroy_timer(timer_1);
+    timer_wheel_destroy_timer(timer_2);
+    timer_wheel_destroy_timer(timer_3);
+    timer_wheel_destroy(timer_wheel);
+}
+
+/* timer_wheel_destroy */
+
+TEST_FUNCTION(timers_outliving_the_wheel_can_still_be_destroyed)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    TIMER_WHEEL_TIMER_HANDLE timer = timer_wheel_create_timer(timer_wheel, test_on_timer_expired, TEST_CONTEXT);
+    (void)timer_wheel_schedule(timer, TEST_START_MS + 10);
+    timer_wheel_destroy(timer_wheel);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    timer_wheel_destroy_timer(timer);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, expired_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* timer_wheel_advance with many timers */
+
+TEST_FUNCTION(many_timers_all_fire_and_none_fires_early)
+{
+    // arrange
+    TIMER_WHEEL_HANDLE timer_wheel = timer_wheel_create(TEST_START_MS);
+    size_t i;
+    uint32_t seed = 42;
+
+    for (i = 0; i < TEST_TIMER_COUNT; i++)
+    {
+        /* spread over about 17 minutes so that every level below the top gets used */
+        seed = seed * 1103515245 + 12345;
+        test_expiry_times[i] = TEST_START_MS + (seed >> 12);
+        test_timers[i] = timer_wheel_create_timer(timer_wheel, test_on_many_timers_expired, (void*)i);
+        (void)timer_wheel_schedule(test_timers[i], test_expiry_times[i]);
+    }
+
+    // act
+    test_current_ms = TEST_START_MS;
+    while (expired_count < TEST_TIMER_COUNT)
+    {
+        uint64_t time_to_next_expiry = timer_wheel_get_time_to_next_expiry(timer_wheel, test_current_ms);
+        if (time_to_next_expiry == (uint64_t)-1)
+        {
+            break;
+        }
+
+        test_current_ms += (time_to_next_expiry == 0) ? 1 : time_to_next_expiry;
+        (void)timer_wheel_advance(timer_wheel, test_current_ms);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, TEST_TIMER_COUNT, expired_count);
+    ASSERT_ARE_EQUAL(size_t, 0, early_expiry_count);
+
+    // cleanup
+    for (i = 0; i < TEST_TIMER_COUNT; i++)
+    {
+        timer_wheel_destroy_timer(test_timers[i]);
+    }
+
+    timer_wheel_destroy(timer_wheel);
+}
+
+END_TEST_SUITE(timer_wheel_ut)
@@ -0,0 +1,577 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* CONNECTION_COUNT clients send to a local server over TCP loopback, each with OUTSTANDING_MESSAGE_COUNT unsettled
+   messages in flight, all driven from one thread. The run is done with socket IO on both sides and then with the
+   io_uring socket IO, all connections (client and server ends) sharing one context, and for each the throughput and
+   the CPU time (user + system) spent per message are reported. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_uamqp_c/socket_listener.h"
+#include "azure_uamqp_c/uring_socket_io.h"
+#include "azure_uamqp_c/header_detect_io.h"
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+
+#define TEST_PORT 5676
+#define CONNECTION_COUNT 8
+#define OUTSTANDING_MESSAGE_COUNT 100
+#define THROUGHPUT_RUNTIME 3000 // ms
+#define SETUP_TIMEOUT 5000 // ms
+#define URING_QUEUE_DEPTH 256
+#define URING_RECEIVE_BUFFER_SIZE 65536
+
+typedef struct SERVER_CONNECTED_CLIENT_TAG
+{
+	CONNECTION_HANDLE connection;
+	SESSION_HANDLE session;
+	LINK_HANDLE link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+	XIO_HANDLE io;
+	size_t messages_received;
+} SERVER_CONNECTED_CLIENT;
+
+typedef struct CLIENT_TAG
+{
+	CONNECTION_HANDLE connection;
+	SESSION_HANDLE session;
+	LINK_HANDLE link;
+	MESSAGE_SENDER_HANDLE message_sender;
+	XIO_HANDLE io;
+	size_t outstanding_message_count;
+	bool is_send_failed;
+} CLIENT;
+
+typedef struct TEST_RUN_TAG
+{
+	/* NULL when running over socket IO */
+	URING_SOCKET_IO_CONTEXT_HANDLE uring_context;
+	SOCKET_LISTENER_HANDLE socket_listener;
+	SERVER_CONNECTED_CLIENT servers[CONNECTION_COUNT];
+	size_t server_count;
+	CLIENT clients[CONNECTION_COUNT];
+} TEST_RUN;
+
+static uint64_t get_time_us(void)
+{
+	struct timespec now;
+	(void)clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * 1000000) + ((uint64_t)now.tv_nsec / 1000);
+}
+
+static uint64_t get_cpu_time_us(void)
+{
+	struct rusage usage;
+	(void)getrusage(RUSAGE_SELF, &usage);
+	return ((uint64_t)usage.ru_utime.tv_sec * 1000000) + (uint64_t)usage.ru_utime.tv_usec +
+		((uint64_t)usage.ru_stime.tv_sec * 1000000) + (uint64_t)usage.ru_stime.tv_usec;
+}
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	(void)message;
+
+	server_connected_client->messages_received++;
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	bool result;
+
+	server_connected_client->link = link_create_from_endpoint(server_connected_client->session, new_link_endpoint, name, role, source, target);
+	if (server_connected_client->link == NULL)
+	{
+		LogError("Cannot create link");
+		result = false;
+	}
+	else if (link_set_rcv_settle_mode(server_connected_client->link, receiver_settle_mode_first) != 0)
+	{
+		LogError("Cannot set receiver settle mode");
+		result = false;
+	}
+	else
+	{
+		server_connected_client->message_receiver = messagereceiver_create(server_connected_client->link, NULL, NULL);
+		if (server_connected_client->message_receiver == NULL)
+		{
+			LogError("Cannot create message receiver");
+			result = false;
+		}
+		else if (messagereceiver_open(server_connected_client->message_receiver, on_message_received, server_connected_client) != 0)
+		{
+			LogError("Cannot open message receiver");
+			result = false;
+		}
+		else
+		{
+			result = true;
+		}
+	}
+
+	return result;
+}
+
+static bool on_new_session_endpoint(void* context, ENDPOINT_HANDLE new_endpoint)
+{
+	SERVER_CONNECTED_CLIENT* server_connected_client = (SERVER_CONNECTED_CLIENT*)context;
+	bool result;
+
+	server_connected_client->session = session_create_from_endpoint(server_connected_client->connection, new_endpoint, on_new_link_attached, server_connected_client);
+	if (server_connected_client->session == NULL)
+	{
+		LogError("Cannot create session");
+		result = false;
+	}
+	else if ((session_set_incoming_window(server_connected_client->session, 10000) != 0) ||
+		(session_begin(server_connected_client->session) != 0))
+	{
+		LogError("Cannot begin session");
+		result = false;
+	}
+	else
+	{
+		result = true;
+	}
+
+	return result;
+}
+
+static void on_socket_accepted(void* context, const IO_INTERFACE_DESCRIPTION* interface_description, void* io_parameters)
+{
+	TEST_RUN* test_run = (TEST_RUN*)context;
+
+	if (test_run->server_count == CONNECTION_COUNT)
+	{
+		LogError("Only %u clients are expected", (unsigned int)CONNECTION_COUNT);
+	}
+	else
+	{
+		SERVER_CONNECTED_CLIENT* server_connected_client = &test_run->servers[test_run->server_count++];
+		HEADERDETECTIO_CONFIG header_detect_io_config;
+
+		if (test_run->uring_context != NULL)
+		{
+			/* the listener hands out socket IO parameters, the accepted socket is taken over by the io_uring socket IO */
+			URINGSOCKETIO_CONFIG uring_socket_io_config;
+
+			uring_socket_io_config.context = test_run->uring_context;
+			uring_socket_io_config.hostname = NULL;
+			uring_socket_io_config.port = 0;
+			uring_socket_io_config.accepted_socket = ((SOCKETIO_CONFIG*)io_parameters)->accepted_socket;
+			header_detect_io_config.underlying_io = xio_create(uringsocketio_get_interface_description(), &uring_socket_io_config);
+		}
+		else
+		{
+			header_detect_io_config.underlying_io = xio_create(interface_description, io_parameters);
+		}
+
+		if (header_detect_io_config.underlying_io == NULL)
+		{
+			LogError("Cannot create accepted socket IO");
+		}
+		else if ((server_connected_client->io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config)) == NULL)
+		{
+			LogError("Cannot create header detect IO");
+			xio_destroy(header_detect_io_config.underlying_io);
+		}
+		else
+		{
+			server_connected_client->connection = connection_create(server_connected_client->io, NULL, "1", on_new_session_endpoint, server_connected_client);
+			if (server_connected_client->connection == NULL)
+			{
+				LogError("Cannot create server connection");
+			}
+			else if (connection_listen(server_connected_client->connection) != 0)
+			{
+				LogError("Cannot listen on server connection");
+			}
+		}
+	}
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	CLIENT* client = (CLIENT*)context;
+
+	if (send_result != MESSAGE_SEND_OK)
+	{
+		client->is_send_failed = true;
+	}
+
+	client->outstanding_message_count--;
+}
+
+static int create_client(CLIENT* client, URING_SOCKET_IO_CONTEXT_HANDLE uring_context)
+{
+	int result;
+
+	if (uring_context != NULL)
+	{
+		URINGSOCKETIO_CONFIG uring_socket_io_config;
+
+		uring_socket_io_config.context = uring_context;
+		uring_socket_io_config.hostname = "localhost";
+		uring_socket_io_config.port = TEST_PORT;
+		uring_socket_io_config.accepted_socket = NULL;
+		client->io = xio_create(uringsocketio_get_interface_description(), &uring_socket_io_config);
+	}
+	else
+	{
+		SOCKETIO_CONFIG socketio_config = { "localhost", TEST_PORT, NULL };
+		client->io = xio_create(socketio_get_interface_description(), &socketio_config);
+	}
+
+	if (client->io == NULL)
+	{
+		LogError("Cannot create client IO");
+		result = __LINE__;
+	}
+	else
+	{
+		client->connection = connection_create(client->io, "localhost", "some", NULL, NULL);
+		if (client->connection == NULL)
+		{
+			LogError("Cannot create client connection");
+			result = __LINE__;
+		}
+		else
+		{
+			client->session = session_create(client->connection, NULL, NULL);
+			if (client->session == NULL)
+			{
+				LogError("Cannot create client session");
+				result = __LINE__;
+			}
+			else
+			{
+				AMQP_VALUE source = messaging_create_source("ingress");
+				AMQP_VALUE target = messaging_create_target("localhost/ingress");
+
+				client->link = link_create(client->session, "sender-link", role_sender, source, target);
+				amqpvalue_destroy(source);
+				amqpvalue_destroy(target);
+
+				if ((client->link == NULL) ||
+					(link_set_snd_settle_mode(client->link, sender_settle_mode_unsettled) != 0))
+				{
+					LogError("Cannot create client link");
+					result = __LINE__;
+				}
+				else
+				{
+					client->message_sender = messagesender_create(client->link, NULL, NULL);
+					if ((client->message_sender == NULL) ||
+						(messagesender_open(client->message_sender) != 0))
+					{
+						LogError("Cannot open client message sender");
+						result = __LINE__;
+					}
+					else
+					{
+						result = 0;
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static void destroy_test_run(TEST_RUN* test_run)
+{
+	size_t i;
+
+	for (i = 0; i < CONNECTION_COUNT; i++)
+	{
+		CLIENT* client = &test_run->clients[i];
+		SERVER_CONNECTED_CLIENT* server_connected_client = &test_run->servers[i];
+
+		if (client->message_sender != NULL)
+		{
+			messagesender_destroy(client->message_sender);
+		}
+
+		if (client->link != NULL)
+		{
+			link_destroy(client->link);
+		}
+
+		if (client->session != NULL)
+		{
+			session_destroy(client->session);
+		}
+
+		if (client->connection != NULL)
+		{
+			connection_destroy(client->connection);
+		}
+
+		if (client->io != NULL)
+		{
+			xio_destroy(client->io);
+		}
+
+		if (server_connected_client->message_receiver != NULL)
+		{
+			messagereceiver_destroy(server_connected_client->message_receiver);
+		}
+
+		if (server_connected_client->link != NULL)
+		{
+			link_destroy(server_connected_client->link);
+		}
+
+		if (server_connected_client->session != NULL)
+		{
+			session_destroy(server_connected_client->session);
+		}
+
+		if (server_connected_client->connection != NULL)
+		{
+			connection_destroy(server_connected_client->connection);
+		}
+
+		/* header detect IO destroys the accepted socket IO under it */
+		if (server_connected_client->io != NULL)
+		{
+			xio_destroy(server_connected_client->io);
+		}
+	}
+
+	if (test_run->socket_listener != NULL)
+	{
+		socketlistener_destroy(test_run->socket_listener);
+	}
+
+	/* after all the IOs on it */
+	if (test_run->uring_context != NULL)
+	{
+		uringsocketio_context_destroy(test_run->uring_context);
+	}
+}
+
+static size_t get_messages_received(const TEST_RUN* test_run)
+{
+	size_t result = 0;
+	size_t i;
+
+	for (i = 0; i < test_run->server_count; i++)
+	{
+		result += test_run->servers[i].messages_received;
+	}
+
+	return result;
+}
+
+/* one turn of the loop: accept, work on every connection, refill every client up to window messages */
+static int run_once(TEST_RUN* test_run, size_t window)
+{
+	int result = 0;
+	size_t i;
+
+	socketlistener_dowork(test_run->socket_listener);
+
+	/* with io_uring all sends queued during the previous turn go out here, with one syscall, together with
+	   collecting every completion */
+	if ((test_run->uring_context != NULL) &&
+		(uringsocketio_context_dowork(test_run->uring_context, 0) != 0))
+	{
+		LogError("io_uring context dowork failed");
+		result = __LINE__;
+	}
+
+	for (i = 0; (result == 0) && (i < CONNECTION_COUNT); i++)
+	{
+		CLIENT* client = &test_run->clients[i];
+
+		connection_dowork(client->connection);
+
+		while ((result == 0) &&
+			(client->outstanding_message_count < window))
+		{
+			MESSAGE_HANDLE message = message_create();
+			if (message == NULL)
+			{
+				LogError("Error creating message");
+				result = __LINE__;
+			}
+			else
+			{
+				unsigned char hello[] = { 'H', 'e', 'l', 'l', 'o' };
+				BINARY_DATA binary_data;
+
+				binary_data.bytes = hello;
+				binary_data.length = sizeof(hello);
+
+				client->outstanding_message_count++;
+
+				if ((message_add_body_amqp_data(message, binary_data) != 0) ||
+					(messagesender_send(client->message_sender, message, on_message_send_complete, client) != 0))
+				{
+					client->outstanding_message_count--;
+					LogError("Error sending message");
+					result = __LINE__;
+				}
+
+				message_destroy(message);
+			}
+		}
+
+		if ((result == 0) &&
+			(client->is_send_failed))
+		{
+			LogError("Message send failed");
+			result = __LINE__;
+		}
+	}
+
+	for (i = 0; i < test_run->server_count; i++)
+	{
+		if (test_run->servers[i].connection != NULL)
+		{
+			connection_dowork(test_run->servers[i].connection);
+		}
+	}
+
+	return result;
+}
+
+static int run_transport(bool is_uring)
+{
+	int result;
+	TEST_RUN test_run;
+	const char* transport_name = is_uring ? "io_uring socket IO" : "socket IO";
+
+	(void)memset(&test_run, 0, sizeof(test_run));
+
+	/* one registered receive buffer for each client and each server end */
+	if (is_uring &&
+		((test_run.uring_context = uringsocketio_context_create(URING_QUEUE_DEPTH, CONNECTION_COUNT * 2, URING_RECEIVE_BUFFER_SIZE)) == NULL))
+	{
+		LogError("Cannot create io_uring context");
+		result = __LINE__;
+	}
+	else if ((test_run.socket_listener = socketlistener_create(TEST_PORT)) == NULL)
+	{
+		LogError("Cannot create socket listener");
+		result = __LINE__;
+	}
+	else if (socketlistener_start(test_run.socket_listener, on_socket_accepted, &test_run) != 0)
+	{
+		LogError("Cannot start socket listener");
+		result = __LINE__;
+	}
+	else
+	{
+		size_t i;
+
+		result = 0;
+		for (i = 0; (result == 0) && (i < CONNECTION_COUNT); i++)
+		{
+			result = create_client(&test_run.clients[i], test_run.uring_context);
+		}
+
+		if (result == 0)
+		{
+			uint64_t start_us = get_time_us();
+			uint64_t current_us = start_us;
+			size_t ready_count = 0;
+
+			/* one message round trip on every connection makes sure they are all up before measuring */
+			while ((result == 0) &&
+				(ready_count < CONNECTION_COUNT))
+			{
+				result = run_once(&test_run, 1);
+
+				ready_count = 0;
+				for (i = 0; i < test_run.server_count; i++)
+				{
+					if (test_run.servers[i].messages_received > 0)
+					{
+						ready_count++;
+					}
+				}
+
+				current_us = get_time_us();
+				if ((result == 0) &&
+					(current_us - start_us > (uint64_t)SETUP_TIMEOUT * 1000))
+				{
+					LogError("Timeout setting up the connections, %u of %u ready", (unsigned int)ready_count, (unsigned int)CONNECTION_COUNT);
+					result = __LINE__;
+				}
+			}
+
+			if (result == 0)
+			{
+				size_t messages_received_before = get_messages_received(&test_run);
+				uint64_t cpu_start_us = get_cpu_time_us();
+
+				start_us = get_time_us();
+				current_us = start_us;
+
+				while ((result == 0) &&
+					(current_us - start_us <= (uint64_t)THROUGHPUT_RUNTIME * 1000))
+				{
+					result = run_once(&test_run, OUTSTANDING_MESSAGE_COUNT);
+					current_us = get_time_us();
+				}
+
+				if (result == 0)
+				{
+					size_t message_count = get_messages_received(&test_run) - messages_received_before;
+					uint64_t cpu_us = get_cpu_time_us() - cpu_start_us;
+
+					LogInfo("%s: %u connections, %.0f messages/s, %.2f us CPU per message",
+						transport_name, (unsigned int)CONNECTION_COUNT,
+						(double)message_count / ((double)(current_us - start_us) / 1000000),
+						(message_count == 0) ? 0.0 : (double)cpu_us / (double)message_count);
+				}
+			}
+		}
+	}
+
+	destroy_test_run(&test_run);
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		result = run_transport(false);
+		if (result == 0)
+		{
+			result = run_transport(true);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}
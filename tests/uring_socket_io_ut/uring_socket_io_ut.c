@@ -0,0 +1,307 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* These run against the kernel's io_uring: the ring, the pipes and the sockets are real, only the allocator is hooked
+   so that the tests can tell what is still allocated. */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+static size_t allocation_count;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result = malloc(size);
+    if (result != NULL)
+    {
+        allocation_count++;
+    }
+    return result;
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if ((ptr == NULL) && (result != NULL))
+    {
+        allocation_count++;
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    if (ptr != NULL)
+    {
+        allocation_count--;
+    }
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optionhandler.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_uamqp_c/uring_socket_io.h"
+
+#define TEST_QUEUE_DEPTH				8
+#define TEST_RECEIVE_BUFFER_SIZE		4096
+
+static size_t bytes_received_count;
+
+static void test_on_bytes_received(void* context, const unsigned char* buffer, size_t size)
+{
+    (void)context;
+    (void)buffer;
+    bytes_received_count += size;
+}
+
+static void test_on_io_error(void* context)
+{
+    (void)context;
+}
+
+/* an IO on the read end of a pipe: unlike a socket, nothing the IO does to the descriptor completes its receive */
+static CONCRETE_IO_HANDLE create_pipe_io(URING_SOCKET_IO_CONTEXT_HANDLE context, int* pipe_fds)
+{
+    CONCRETE_IO_HANDLE result;
+    URINGSOCKETIO_CONFIG config;
+
+    ASSERT_ARE_EQUAL(int, 0, pipe(pipe_fds));
+
+    config.context = context;
+    config.hostname = NULL;
+    config.port = 0;
+    config.accepted_socket = &pipe_fds[0];
+
+    result = uringsocketio_create(&config);
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, 0, uringsocketio_open(result, NULL, NULL, test_on_bytes_received, NULL, test_on_io_error, NULL));
+
+    return result;
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(uring_socket_io_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    /* writing to a pipe nobody reads anymore has to fail rather than kill the test */
+    (void)signal(SIGPIPE, SIG_IGN);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    allocation_count = 0;
+    bytes_received_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* uringsocketio_context_destroy */
+
+TEST_FUNCTION(uringsocketio_context_destroy_reaps_a_receive_closing_the_descriptor_does_not_complete)
+{
+    // arrange
+    URING_SOCKET_IO_CONTEXT_HANDLE context = uringsocketio_context_create(TEST_QUEUE_DEPTH, 1, TEST_RECEIVE_BUFFER_SIZE);
+    CONCRETE_IO_HANDLE uring_socket_io;
+    int pipe_fds[2];
+    ASSERT_IS_NOT_NULL(context);
+    uring_socket_io = create_pipe_io(context, pipe_fds);
+    ASSERT_ARE_EQUAL(int, 0, uringsocketio_context_dowork(context, 0));
+    uringsocketio_destroy(uring_socket_io);
+
+    // act
+    uringsocketio_context_destroy(context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+    /* the receive was given back by the kernel before destroy returned, so nothing reads the pipe anymore */
+    ASSERT_ARE_EQUAL(int, -1, (int)write(pipe_fds[1], "x", 1));
+    ASSERT_ARE_EQUAL(int, EPIPE, errno);
+    ASSERT_ARE_EQUAL(size_t, 0, bytes_received_count);
+
+    // cleanup
+    (void)close(pipe_fds[1]);
+}
+
+TEST_FUNCTION(uringsocketio_context_destroy_reaps_the_receives_of_several_destroyed_ios)
+{
+    // arrange
+    URING_SOCKET_IO_CONTEXT_HANDLE context = uringsocketio_context_create(TEST_QUEUE_DEPTH, 1, TEST_RECEIVE_BUFFER_SIZE);
+    CONCRETE_IO_HANDLE uring_socket_io_1;
+    CONCRETE_IO_HANDLE uring_socket_io_2;
+    int pipe_fds_1[2];
+    int pipe_fds_2[2];
+    ASSERT_IS_NOT_NULL(context);
+    /* the second IO finds no registered buffer left and receives into one of its own */
+    uring_socket_io_1 = create_pipe_io(context, pipe_fds_1);
+    uring_socket_io_2 = create_pipe_io(context, pipe_fds_2);
+    ASSERT_ARE_EQUAL(int, 0, uringsocketio_context_dowork(context, 0));
+    uringsocketio_destroy(uring_socket_io_1);
+    uringsocketio_destroy(uring_socket_io_2);
+
+    // act
+    uringsocketio_context_destroy(context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+    ASSERT_ARE_EQUAL(int, -1, (int)write(pipe_fds_1[1], "x", 1));
+    ASSERT_ARE_EQUAL(int, EPIPE, errno);
+
+    // cleanup
+    (void)close(pipe_fds_1[1]);
+    (void)close(pipe_fds_2[1]);
+}
+
+TEST_FUNCTION(uringsocketio_context_destroy_reaps_a_receive_submitted_but_not_entered_yet)
+{
+    // arrange
+    URING_SOCKET_IO_CONTEXT_HANDLE context = uringsocketio_context_create(TEST_QUEUE_DEPTH, 1, TEST_RECEIVE_BUFFER_SIZE);
+    CONCRETE_IO_HANDLE uring_socket_io;
+    int pipe_fds[2];
+    ASSERT_IS_NOT_NULL(context);
+    uring_socket_io = create_pipe_io(context, pipe_fds);
+    uringsocketio_destroy(uring_socket_io);
+
+    // act
+    uringsocketio_context_destroy(context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+    ASSERT_ARE_EQUAL(int, -1, (int)write(pipe_fds[1], "x", 1));
+    ASSERT_ARE_EQUAL(int, EPIPE, errno);
+
+    // cleanup
+    (void)close(pipe_fds[1]);
+}
+
+TEST_FUNCTION(destroying_an_io_with_its_own_ring_reaps_its_receive_before_closing_the_ring)
+{
+    // arrange
+    CONCRETE_IO_HANDLE uring_socket_io;
+    int pipe_fds[2];
+    uring_socket_io = create_pipe_io(NULL, pipe_fds);
+    uringsocketio_dowork(uring_socket_io);
+
+    // act
+    uringsocketio_destroy(uring_socket_io);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+    ASSERT_ARE_EQUAL(int, -1, (int)write(pipe_fds[1], "x", 1));
+    ASSERT_ARE_EQUAL(int, EPIPE, errno);
+
+    // cleanup
+    (void)close(pipe_fds[1]);
+}
+
+/* uringsocketio_destroy */
+
+TEST_FUNCTION(a_destroyed_io_is_freed_once_its_receive_completes)
+{
+    // arrange
+    URING_SOCKET_IO_CONTEXT_HANDLE context = uringsocketio_context_create(TEST_QUEUE_DEPTH, 1, TEST_RECEIVE_BUFFER_SIZE);
+    CONCRETE_IO_HANDLE uring_socket_io;
+    int pipe_fds[2];
+    size_t context_allocation_count;
+    ASSERT_IS_NOT_NULL(context);
+    context_allocation_count = allocation_count;
+    uring_socket_io = create_pipe_io(context, pipe_fds);
+    ASSERT_ARE_EQUAL(int, 0, uringsocketio_context_dowork(context, 0));
+    uringsocketio_destroy(uring_socket_io);
+    ASSERT_ARE_NOT_EQUAL(size_t, context_allocation_count, allocation_count);
+    ASSERT_ARE_EQUAL(int, 1, (int)write(pipe_fds[1], "x", 1));
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, uringsocketio_context_dowork(context, 1000));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, context_allocation_count, allocation_count);
+    /* the bytes of a destroyed IO are not handed to anyone */
+    ASSERT_ARE_EQUAL(size_t, 0, bytes_received_count);
+
+    // cleanup
+    uringsocketio_context_destroy(context);
+    (void)close(pipe_fds[1]);
+}
+
+TEST_FUNCTION(uringsocketio_context_destroy_reaps_a_receive_on_a_socket)
+{
+    // arrange
+    URING_SOCKET_IO_CONTEXT_HANDLE context = uringsocketio_context_create(TEST_QUEUE_DEPTH, 1, TEST_RECEIVE_BUFFER_SIZE);
+    CONCRETE_IO_HANDLE uring_socket_io;
+    URINGSOCKETIO_CONFIG config;
+    int socket_fds[2];
+    ASSERT_IS_NOT_NULL(context);
+    ASSERT_ARE_EQUAL(int, 0, socketpair(AF_UNIX, SOCK_STREAM, 0, socket_fds));
+    config.context = context;
+    config.hostname = NULL;
+    config.port = 0;
+    config.accepted_socket = &socket_fds[0];
+    uring_socket_io = uringsocketio_create(&config);
+    ASSERT_IS_NOT_NULL(uring_socket_io);
+    ASSERT_ARE_EQUAL(int, 0, uringsocketio_open(uring_socket_io, NULL, NULL, test_on_bytes_received, NULL, test_on_io_error, NULL));
+    ASSERT_ARE_EQUAL(int, 0, uringsocketio_context_dowork(context, 0));
+    uringsocketio_destroy(uring_socket_io);
+
+    // act
+    uringsocketio_context_destroy(context);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, allocation_count);
+
+    // cleanup
+    (void)close(socket_fds[1]);
+}
+
+END_TEST_SUITE(uring_socket_io_ut)
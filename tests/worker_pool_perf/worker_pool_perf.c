@@ -0,0 +1,706 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/* Measures message throughput of CLIENT_COUNT loopback client/server pairs while the number of worker threads
+   goes from 1 to the number of cores. Each pair (both connections and everything on top of them) lives on one worker. */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_uamqp_c/header_detect_io.h"
+#include "azure_uamqp_c/connection.h"
+#include "azure_uamqp_c/session.h"
+#include "azure_uamqp_c/link.h"
+#include "azure_uamqp_c/message_receiver.h"
+#include "azure_uamqp_c/message_sender.h"
+#include "azure_uamqp_c/messaging.h"
+#include "azure_uamqp_c/worker_pool.h"
+
+#define CLIENT_COUNT 64
+#define OUTSTANDING_MESSAGE_COUNT 16
+#define MEASURE_TIME 5000 // ms
+#define SETUP_TIMEOUT 30000 // ms
+
+typedef struct TEST_PAIR_TAG
+{
+	size_t worker_index;
+	int client_fd;
+	int server_fd;
+
+	/* client side */
+	XIO_HANDLE client_io;
+	CONNECTION_HANDLE client_connection;
+	SESSION_HANDLE client_session;
+	LINK_HANDLE client_link;
+	MESSAGE_SENDER_HANDLE message_sender;
+	MESSAGE_HANDLE message;
+	size_t outstanding_message_count;
+	bool is_refill_posted;
+
+	/* server side */
+	XIO_HANDLE server_underlying_io;
+	XIO_HANDLE server_io;
+	CONNECTION_HANDLE server_connection;
+	SESSION_HANDLE server_session;
+	LINK_HANDLE server_link;
+	MESSAGE_RECEIVER_HANDLE message_receiver;
+
+	bool is_stopping;
+
+	/* written by the worker, read by the main thread */
+	size_t received_message_count;
+	int is_failed;
+} TEST_PAIR;
+
+static WORKER_POOL_HANDLE worker_pool;
+static TEST_PAIR test_pairs[CLIENT_COUNT];
+static int test_port;
+
+static AMQP_VALUE on_message_received(const void* context, MESSAGE_HANDLE message)
+{
+	TEST_PAIR* test_pair = (TEST_PAIR*)context;
+	(void)message;
+
+	__atomic_store_n(&test_pair->received_message_count, test_pair->received_message_count + 1, __ATOMIC_RELAXED);
+
+	return messaging_delivery_accepted();
+}
+
+static bool on_new_link_attached(void* context, LINK_ENDPOINT_HANDLE new_link_endpoint, const char* name, role role, AMQP_VALUE source, AMQP_VALUE target)
+{
+	TEST_PAIR* test_pair = (TEST_PAIR*)context;
+	bool result;
+
+	test_pair->server_link = link_create_from_endpoint(test_pair->server_session, new_link_endpoint, name, role, source, target);
+	if (test_pair->server_link == NULL)
+	{
+		LogError("Cannot create link");
+		result = false;
+	}
+	else if ((link_set_rcv_settle_mode(test_pair->server_link, receiver_settle_mode_first) != 0) ||
+		((test_pair->message_receiver = messagereceiver_create(test_pair->server_link, NULL, NULL)) == NULL))
+	{
+		LogError("Cannot create message receiver");
+		link_destroy(test_pair->server_link);
+		test_pair->server_link = NULL;
+		result = false;
+	}
+	else if (messagereceiver_open(test_pair->message_receiver, on_message_received, test_pair) != 0)
+	{
+		LogError("Cannot open message receiver");
+		messagereceiver_destroy(test_pair->message_receiver);
+		test_pair->message_receiver = NULL;
+		link_destroy(test_pair->server_link);
+		test_pair->server_link = NULL;
+		result = false;
+	}
+	else
+	{
+		result = true;
+	}
+
+	return result;
+}
+
+static bool on_new_session_endpoint(void* context, ENDPOINT_HANDLE new_endpoint)
+{
+	TEST_PAIR* test_pair = (TEST_PAIR*)context;
+	bool result;
+
+	test_pair->server_session = session_create_from_endpoint(test_pair->server_connection, new_endpoint, on_new_link_attached, test_pair);
+	if (test_pair->server_session == NULL)
+	{
+		LogError("Cannot create session");
+		result = false;
+	}
+	else if ((session_set_incoming_window(test_pair->server_session, 10000) != 0) ||
+		(session_begin(test_pair->server_session) != 0))
+	{
+		LogError("Cannot begin session");
+		session_destroy(test_pair->server_session);
+		test_pair->server_session = NULL;
+		result = false;
+	}
+	else
+	{
+		result = true;
+	}
+
+	return result;
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result);
+
+static void send_messages(TEST_PAIR* test_pair)
+{
+	while ((!test_pair->is_stopping) &&
+		(test_pair->outstanding_message_count < OUTSTANDING_MESSAGE_COUNT))
+	{
+		if (messagesender_send(test_pair->message_sender, test_pair->message, on_message_send_complete, test_pair) != 0)
+		{
+			LogError("Error sending message");
+			__atomic_store_n(&test_pair->is_failed, 1, __ATOMIC_RELAXED);
+			break;
+		}
+
+		test_pair->outstanding_message_count++;
+	}
+}
+
+static void on_send_messages_work(void* context, CONNECTION_REACTOR_HANDLE reactor)
+{
+	TEST_PAIR* test_pair = (TEST_PAIR*)context;
+	(void)reactor;
+
+	test_pair->is_refill_posted = false;
+	send_messages(test_pair);
+}
+
+static void on_message_send_complete(void* context, MESSAGE_SEND_RESULT send_result)
+{
+	TEST_PAIR* test_pair = (TEST_PAIR*)context;
+	(void)send_result;
+
+	test_pair->outstanding_message_count--;
+
+	/* refill from a work item on the same worker instead of re-entering the sender from its own callback */
+	if ((!test_pair->is_stopping) &&
+		(!test_pair->is_refill_posted))
+	{
+		test_pair->is_refill_posted = true;
+		if (worker_pool_post(worker_pool, test_pair->worker_index, on_send_messages_work, test_pair) != 0)
+		{
+			LogError("Cannot post refill");
+			__atomic_store_n(&test_pair->is_failed, 1, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static int create_server(TEST_PAIR* test_pair, CONNECTION_REACTOR_HANDLE reactor)
+{
+	int result;
+	SOCKETIO_CONFIG socketio_config = { NULL, 0, NULL };
+	socketio_config.accepted_socket = &test_pair->server_fd;
+
+	test_pair->server_underlying_io = xio_create(socketio_get_interface_description(), &socketio_config);
+	if (test_pair->server_underlying_io == NULL)
+	{
+		LogError("Cannot create server socket IO");
+		result = __LINE__;
+	}
+	else
+	{
+		HEADERDETECTIO_CONFIG header_detect_io_config;
+		header_detect_io_config.underlying_io = test_pair->server_underlying_io;
+
+		test_pair->server_io = xio_create(headerdetectio_get_interface_description(), &header_detect_io_config);
+		if (test_pair->server_io == NULL)
+		{
+			LogError("Cannot create header detect IO");
+			result = __LINE__;
+		}
+		else
+		{
+			test_pair->server_connection = connection_create2(test_pair->server_io, NULL, "server", on_new_session_endpoint, test_pair, NULL, NULL, NULL, NULL);
+			if (test_pair->server_connection == NULL)
+			{
+				LogError("Cannot create server connection");
+				result = __LINE__;
+			}
+			else if ((connection_listen(test_pair->server_connection) != 0) ||
+				(connection_reactor_add_connection(reactor, test_pair->server_connection, test_pair->server_fd) != 0))
+			{
+				LogError("Cannot start server connection");
+				result = __LINE__;
+			}
+			else
+			{
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+static int create_client(TEST_PAIR* test_pair, CONNECTION_REACTOR_HANDLE reactor)
+{
+	int result;
+	SOCKETIO_CONFIG socketio_config = { "localhost", 0, NULL };
+	socketio_config.port = test_port;
+	socketio_config.accepted_socket = &test_pair->client_fd;
+
+	test_pair->client_io = xio_create(socketio_get_interface_description(), &socketio_config);
+	if (test_pair->client_io == NULL)
+	{
+		LogError("Cannot create client IO");
+		result = __LINE__;
+	}
+	else
+	{
+		test_pair->client_connection = connection_create2(test_pair->client_io, "localhost", "client", NULL, NULL, NULL, NULL, NULL, NULL);
+		if (test_pair->client_connection == NULL)
+		{
+			LogError("Cannot create client connection");
+			result = __LINE__;
+		}
+		else
+		{
+			test_pair->client_session = session_create(test_pair->client_connection, NULL, NULL);
+			if (test_pair->client_session == NULL)
+			{
+				LogError("Cannot create client session");
+				result = __LINE__;
+			}
+			else
+			{
+				AMQP_VALUE source = messaging_create_source("ingress");
+				AMQP_VALUE target = messaging_create_target("localhost/ingress");
+
+				test_pair->client_link = link_create(test_pair->client_session, "sender-link", role_sender, source, target);
+				amqpvalue_destroy(source);
+				amqpvalue_destroy(target);
+
+				if ((test_pair->client_link == NULL) ||
+					(link_set_snd_settle_mode(test_pair->client_link, sender_settle_mode_settled) != 0))
+				{
+					LogError("Cannot create client link");
+					result = __LINE__;
+				}
+				else
+				{
+					test_pair->message_sender = messagesender_create(test_pair->client_link, NULL, NULL);
+					if ((test_pair->message_sender == NULL) ||
+						(messagesender_open(test_pair->message_sender) != 0))
+					{
+						LogError("Cannot open client message sender");
+						result = __LINE__;
+					}
+					else if (connection_reactor_add_connection(reactor, test_pair->client_connection, test_pair->client_fd) != 0)
+					{
+						LogError("Cannot add client connection to the reactor");
+						result = __LINE__;
+					}
+					else
+					{
+						result = 0;
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+static void on_start_pair_work(void* context, CONNECTION_REACTOR_HANDLE reactor)
+{
+	TEST_PAIR* test_pair = (TEST_PAIR*)context;
+	unsigned char hello[] = { 'H', 'e', 'l', 'l', 'o' };
+	BINARY_DATA binary_data;
+
+	binary_data.bytes = hello;
+	binary_data.length = sizeof(hello);
+
+	/* the message is created on the worker: amqpvalue refcounts are not atomic, so it cannot be shared between workers */
+	test_pair->message = message_create();
+	if ((test_pair->message == NULL) ||
+		(message_add_body_amqp_data(test_pair->message, binary_data) != 0) ||
+		(create_server(test_pair, reactor) != 0) ||
+		(create_client(test_pair, reactor) != 0))
+	{
+		LogError("Cannot start pair");
+		__atomic_store_n(&test_pair->is_failed, 1, __ATOMIC_RELAXED);
+	}
+	else
+	{
+		send_messages(test_pair);
+	}
+}
+
+static void on_stop_pair_work(void* context, CONNECTION_REACTOR_HANDLE reactor)
+{
+	TEST_PAIR* test_pair = (TEST_PAIR*)context;
+
+	test_pair->is_stopping = true;
+
+	if (test_pair->client_connection != NULL)
+	{
+		(void)connection_reactor_remove_connection(reactor, test_pair->client_connection);
+	}
+
+	if (test_pair->server_connection != NULL)
+	{
+		(void)connection_reactor_remove_connection(reactor, test_pair->server_connection);
+	}
+
+	if (test_pair->message_sender != NULL)
+	{
+		messagesender_destroy(test_pair->message_sender);
+	}
+
+	if (test_pair->client_link != NULL)
+	{
+		link_destroy(test_pair->client_link);
+	}
+
+	if (test_pair->client_session != NULL)
+	{
+		session_destroy(test_pair->client_session);
+	}
+
+	if (test_pair->client_connection != NULL)
+	{
+		connection_destroy(test_pair->client_connection);
+	}
+
+	if (test_pair->client_io != NULL)
+	{
+		xio_destroy(test_pair->client_io);
+	}
+
+	if (test_pair->message != NULL)
+	{
+		message_destroy(test_pair->message);
+	}
+
+	if (test_pair->message_receiver != NULL)
+	{
+		messagereceiver_destroy(test_pair->message_receiver);
+	}
+
+	if (test_pair->server_link != NULL)
+	{
+		link_destroy(test_pair->server_link);
+	}
+
+	if (test_pair->server_session != NULL)
+	{
+		session_destroy(test_pair->server_session);
+	}
+
+	if (test_pair->server_connection != NULL)
+	{
+		connection_destroy(test_pair->server_connection);
+	}
+
+	if (test_pair->server_io != NULL)
+	{
+		xio_destroy(test_pair->server_io);
+	}
+
+	if (test_pair->server_underlying_io != NULL)
+	{
+		xio_destroy(test_pair->server_underlying_io);
+	}
+}
+
+static int set_non_blocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	return ((flags == -1) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)) ? __LINE__ : 0;
+}
+
+static int create_listen_socket(void)
+{
+	int result = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (result == -1)
+	{
+		LogError("Cannot create listen socket");
+	}
+	else
+	{
+		struct sockaddr_in sa;
+		socklen_t sa_length = sizeof(sa);
+
+		(void)memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		sa.sin_port = 0;
+		sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if ((bind(result, (const struct sockaddr*)&sa, sizeof(sa)) != 0) ||
+			(listen(result, CLIENT_COUNT) != 0) ||
+			(getsockname(result, (struct sockaddr*)&sa, &sa_length) != 0))
+		{
+			LogError("Cannot listen on loopback");
+			(void)close(result);
+			result = -1;
+		}
+		else
+		{
+			test_port = ntohs(sa.sin_port);
+		}
+	}
+
+	return result;
+}
+
+static int connect_pair(int listen_fd, TEST_PAIR* test_pair)
+{
+	int result;
+	struct sockaddr_in sa;
+
+	(void)memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons((unsigned short)test_port);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	test_pair->client_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (test_pair->client_fd == -1)
+	{
+		LogError("Cannot create client socket");
+		result = __LINE__;
+	}
+	else if (connect(test_pair->client_fd, (const struct sockaddr*)&sa, sizeof(sa)) != 0)
+	{
+		LogError("Cannot connect client socket");
+		(void)close(test_pair->client_fd);
+		result = __LINE__;
+	}
+	else
+	{
+		test_pair->server_fd = accept(listen_fd, NULL, NULL);
+		if (test_pair->server_fd == -1)
+		{
+			LogError("Cannot accept server socket");
+			(void)close(test_pair->client_fd);
+			result = __LINE__;
+		}
+		else if ((set_non_blocking(test_pair->client_fd) != 0) ||
+			(set_non_blocking(test_pair->server_fd) != 0))
+		{
+			LogError("Cannot make sockets non-blocking");
+			(void)close(test_pair->client_fd);
+			(void)close(test_pair->server_fd);
+			result = __LINE__;
+		}
+		else
+		{
+			result = 0;
+		}
+	}
+
+	return result;
+}
+
+static size_t get_received_message_count(void)
+{
+	size_t result = 0;
+	size_t i;
+
+	for (i = 0; i < CLIENT_COUNT; i++)
+	{
+		result += __atomic_load_n(&test_pairs[i].received_message_count, __ATOMIC_RELAXED);
+	}
+
+	return result;
+}
+
+static int wait_for_all_pairs(TICK_COUNTER_HANDLE tick_counter)
+{
+	int result;
+	tickcounter_ms_t start_ms;
+	tickcounter_ms_t current_ms;
+
+	if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+	{
+		result = __LINE__;
+	}
+	else
+	{
+		result = __LINE__;
+
+		do
+		{
+			size_t i;
+
+			for (i = 0; i < CLIENT_COUNT; i++)
+			{
+				if ((__atomic_load_n(&test_pairs[i].is_failed, __ATOMIC_RELAXED) != 0) ||
+					(__atomic_load_n(&test_pairs[i].received_message_count, __ATOMIC_RELAXED) == 0))
+				{
+					break;
+				}
+			}
+
+			if (i == CLIENT_COUNT)
+			{
+				result = 0;
+				break;
+			}
+
+			if (__atomic_load_n(&test_pairs[i].is_failed, __ATOMIC_RELAXED) != 0)
+			{
+				LogError("Pair %u failed", (unsigned int)i);
+				break;
+			}
+
+			ThreadAPI_Sleep(10);
+		} while ((tickcounter_get_current_ms(tick_counter, &current_ms) == 0) &&
+			(current_ms - start_ms < SETUP_TIMEOUT));
+	}
+
+	return result;
+}
+
+static int measure_throughput(int listen_fd, TICK_COUNTER_HANDLE tick_counter, size_t worker_count, double* messages_per_second)
+{
+	int result;
+	size_t pair_count;
+	size_t i;
+
+	(void)memset(test_pairs, 0, sizeof(test_pairs));
+
+	worker_pool = worker_pool_create(worker_count);
+	if (worker_pool == NULL)
+	{
+		LogError("Cannot create worker pool");
+		result = __LINE__;
+	}
+	else
+	{
+		for (i = 0; i < CLIENT_COUNT; i++)
+		{
+			test_pairs[i].worker_index = i % worker_count;
+			if (connect_pair(listen_fd, &test_pairs[i]) != 0)
+			{
+				break;
+			}
+
+			if (worker_pool_post(worker_pool, test_pairs[i].worker_index, on_start_pair_work, &test_pairs[i]) != 0)
+			{
+				(void)close(test_pairs[i].client_fd);
+				(void)close(test_pairs[i].server_fd);
+				break;
+			}
+		}
+
+		pair_count = i;
+
+		if (i < CLIENT_COUNT)
+		{
+			LogError("Cannot start pair %u", (unsigned int)i);
+			result = __LINE__;
+		}
+		else if (wait_for_all_pairs(tick_counter) != 0)
+		{
+			LogError("Not all pairs got to exchange messages");
+			result = __LINE__;
+		}
+		else
+		{
+			tickcounter_ms_t start_ms;
+			tickcounter_ms_t end_ms;
+			size_t start_count = get_received_message_count();
+
+			if (tickcounter_get_current_ms(tick_counter, &start_ms) != 0)
+			{
+				result = __LINE__;
+			}
+			else
+			{
+				ThreadAPI_Sleep(MEASURE_TIME);
+
+				if (tickcounter_get_current_ms(tick_counter, &end_ms) != 0)
+				{
+					result = __LINE__;
+				}
+				else
+				{
+					*messages_per_second = (double)(get_received_message_count() - start_count) * 1000 / (double)(end_ms - start_ms);
+					result = 0;
+				}
+			}
+		}
+
+		/* the pairs are torn down on their own workers, destroy waits for that */
+		for (i = 0; i < pair_count; i++)
+		{
+			(void)worker_pool_post(worker_pool, test_pairs[i].worker_index, on_stop_pair_work, &test_pairs[i]);
+		}
+
+		worker_pool_destroy(worker_pool);
+		worker_pool = NULL;
+	}
+
+	return result;
+}
+
+int main(void)
+{
+	int result;
+
+	if (platform_init() != 0)
+	{
+		LogError("platform_init failed");
+		result = __LINE__;
+	}
+	else
+	{
+		TICK_COUNTER_HANDLE tick_counter = tickcounter_create();
+		int listen_fd = create_listen_socket();
+
+		if ((tick_counter == NULL) ||
+			(listen_fd == -1))
+		{
+			LogError("Cannot set up the test");
+			result = __LINE__;
+		}
+		else
+		{
+			long core_count = sysconf(_SC_NPROCESSORS_ONLN);
+			size_t worker_count = 1;
+
+			if (core_count < 1)
+			{
+				core_count = 1;
+			}
+
+			result = 0;
+			while (result == 0)
+			{
+				double messages_per_second;
+
+				result = measure_throughput(listen_fd, tick_counter, worker_count, &messages_per_second);
+				if (result == 0)
+				{
+					LogInfo("%u clients on %u workers: %.0f messages/s",
+						(unsigned int)CLIENT_COUNT, (unsigned int)worker_count, messages_per_second);
+				}
+
+				if (worker_count >= (size_t)core_count)
+				{
+					break;
+				}
+
+				worker_count = (worker_count * 2 > (size_t)core_count) ? (size_t)core_count : worker_count * 2;
+			}
+		}
+
+		if (listen_fd != -1)
+		{
+			(void)close(listen_fd);
+		}
+
+		if (tick_counter != NULL)
+		{
+			tickcounter_destroy(tick_counter);
+		}
+
+		platform_deinit();
+	}
+
+	return result;
+}